@@ -0,0 +1,148 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_BENCH_HPP
+#define LINGO_BENCH_HPP
+
+// A minimal benchmark harness. A benchmark is a function that does
+// some number of operations. It is run repeatedly until enough time
+// has passed to measure it, and the time per operation is reported.
+//
+// A benchmark program runs the benchmarks whose names contain its
+// first argument, or all of them if there is none. Programs that
+// process input read it from the file named by the second argument,
+// if any (see generate.cpp).
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace bench
+{
+
+// The least time for which each benchmark is run, in seconds.
+constexpr double min_time = 0.5;
+
+
+// Keeps the compiler from discarding the computation of x.
+template<typename T>
+inline void
+keep(T const& x)
+{
+  asm volatile("" : : "g"(&x) : "memory");
+}
+
+
+// The filter given on the command line.
+inline char const*&
+filter()
+{
+  static char const* f = "";
+  return f;
+}
+
+
+// The input file given on the command line, or null.
+inline char const*&
+input()
+{
+  static char const* f = nullptr;
+  return f;
+}
+
+
+inline void
+init(int argc, char* argv[])
+{
+  if (argc > 1)
+    filter() = argv[1];
+  if (argc > 2)
+    input() = argv[2];
+}
+
+
+// Returns the text of the input file. Exits if it cannot be read.
+inline std::string
+read_input()
+{
+  std::ifstream f(input());
+  if (!f) {
+    std::fprintf(stderr, "cannot read '%s'\n", input());
+    std::exit(1);
+  }
+  std::stringstream ss;
+  ss << f.rdbuf();
+  return ss.str();
+}
+
+
+// Returns the number of lines in s.
+inline std::size_t
+count_lines(std::string const& s)
+{
+  std::size_t n = 0;
+  for (char c : s)
+    n += c == '\n';
+  return n ? n : 1;
+}
+
+
+// Discards the output written to std::cout while it is in scope,
+// so that programs that print their results are not timed writing
+// them. Reports are written with printf, and are not discarded.
+class Silence
+{
+public:
+  Silence()
+    : old_(std::cout.rdbuf(&null_))
+  { }
+
+  ~Silence()
+  {
+    std::cout.rdbuf(old_);
+  }
+
+private:
+  struct Null_buffer : std::streambuf
+  {
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(char const*, std::streamsize n) override { return n; }
+  };
+
+  Null_buffer     null_;
+  std::streambuf* old_;
+};
+
+
+// Run f, which does n operations, until at least min_time seconds
+// have passed (or it has been run max times), and report the time
+// per operation.
+template<typename F>
+void
+run(char const* name, std::size_t n, F f, std::size_t max = std::size_t(-1))
+{
+  if (!std::strstr(name, filter()))
+    return;
+  using Clock = std::chrono::steady_clock;
+  std::size_t reps = 0;
+  double t = 0;
+  Clock::time_point start = Clock::now();
+  do {
+    f();
+    ++reps;
+    t = std::chrono::duration<double>(Clock::now() - start).count();
+  } while (t < min_time && reps < max);
+  double ops = double(reps) * n;
+  std::printf("%-40s %12.2f ns/op %14.0f ops\n", name, t * 1e9 / ops, ops);
+}
+
+
+} // namespace bench
+
+#endif
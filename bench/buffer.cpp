@@ -0,0 +1,66 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "bench.hpp"
+
+#include "lingo/buffer.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lingo;
+
+
+int
+main(int argc, char* argv[])
+{
+  bench::init(argc, argv);
+
+  // About 1MB of text in lines of varying length.
+  std::string text;
+  for (int i = 0; text.size() < (1 << 20); ++i)
+    text += std::string(i % 80, 'x') + '\n';
+
+  // Each buffer takes a range of the source positions, which are
+  // never reused, so the number of buffers made is limited.
+  std::size_t const max = 500;
+  bench::run("buffer (1MB)", 1, [&]() {
+    Buffer buf(text);
+    bench::keep(buf);
+  }, max);
+
+  std::size_t const n = 100000;
+  std::minstd_rand rng(42);
+  std::vector<int> offs(n);
+  for (int& k : offs)
+    k = rng() % text.size();
+
+  Buffer buf(text);
+  bench::run("line_map.locus (random)", n, [&]() {
+    for (int k : offs)
+      bench::keep(buf.locus(k));
+  });
+
+  std::vector<int> sorted = offs;
+  std::sort(sorted.begin(), sorted.end());
+  bench::run("line_map.locus (sorted)", n, [&]() {
+    for (int k : sorted)
+      bench::keep(buf.locus(k));
+  });
+
+  std::vector<Locus> loci(n);
+  bench::run("line_map.resolve (sorted)", n, [&]() {
+    buf.resolve(sorted.data(), sorted.data() + n, loci.data());
+    bench::keep(loci);
+  });
+
+  // A fresh map is built lazily by the first query.
+  bench::run("line_map.locus (cold, end of text)", 1, [&]() {
+    Buffer b(text);
+    bench::keep(b.locus(text.size() - 1));
+  }, max);
+}
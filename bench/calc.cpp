@@ -0,0 +1,110 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "bench.hpp"
+
+#include "ast.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "parallel.hpp"
+
+#include "lingo/buffer.hpp"
+#include "lingo/character.hpp"
+#include "lingo/memory.hpp"
+#include "lingo/token.hpp"
+
+#include <deque>
+#include <sstream>
+#include <vector>
+
+using namespace lingo;
+using namespace calc;
+
+
+// A program of n lines, each an expression of 32 terms, such as
+// 1 + 2 * 3 - (4 - 5) / 6 ...
+String
+program(int n)
+{
+  String s;
+  for (int j = 0; j < n; ++j) {
+    s += std::to_string(j);
+    for (int i = 1; i < 32; ++i) {
+      String k = std::to_string((i + j) % 97 + 1);
+      switch ((i + j) % 4) {
+        case 0: s += " + " + k; break;
+        case 1: s += " - " + k + " * 3"; break;
+        case 2: s += " + (" + k + " - 7) / 2"; break;
+        case 3: s += " - -" + k + " % 5"; break;
+      }
+    }
+    s += '\n';
+  }
+  return s;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  bench::init(argc, argv);
+
+  // Each line is an expression, as in the interpreter.
+  String text = bench::input() ? bench::read_input() : program(1000);
+  std::deque<Buffer> bufs;
+  std::stringstream ss(text);
+  for (String line; std::getline(ss, line); )
+    if (!line.empty())
+      bufs.emplace_back(line);
+  std::size_t n = bufs.size();
+
+  bench::run("calc lex (lines)", n, [&]() {
+    for (Buffer& buf : bufs) {
+      Character_stream cs(buf);
+      Token_stream ts;
+      Lexer lex(cs, ts);
+      lex();
+      bench::keep(ts);
+    }
+  });
+
+  std::vector<Token_seq> toks;
+  for (Buffer& buf : bufs) {
+    Character_stream cs(buf);
+    Token_stream ts;
+    Lexer lex(cs, ts);
+    lex();
+    toks.push_back(ts.tokens());
+  }
+
+  bench::run("calc parse (lines)", n, [&]() {
+    Arena_factory nodes;
+    Arena_scope scope(nodes);
+    for (Token_seq const& t : toks) {
+      Token_stream ts(t);
+      Parser parse(ts);
+      bench::keep(parse());
+    }
+  });
+
+  Arena_factory nodes;
+  Arena_scope scope(nodes);
+  std::vector<Expr const*> exprs;
+  for (Token_seq const& t : toks) {
+    Token_stream ts(t);
+    Parser parse(ts);
+    exprs.push_back(parse());
+  }
+
+  bench::run("calc evaluate (lines)", n, [&]() {
+    for (Expr const* e : exprs)
+      bench::keep(evaluate(e));
+  });
+
+  bench::run("calc evaluate_in_parallel (lines)", n, [&]() {
+    for (Expr const* e : exprs)
+      bench::keep(evaluate_in_parallel(e));
+  });
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "bench.hpp"
+
+#include "lingo/buffer.hpp"
+#include "lingo/character.hpp"
+
+#include <string>
+
+using namespace lingo;
+
+
+int
+main(int argc, char* argv[])
+{
+  bench::init(argc, argv);
+
+  // About 1MB of words and numbers.
+  std::string text;
+  for (int i = 0; text.size() < (1 << 20); ++i)
+    text += "word_" + std::to_string(i) + " 12345\t(x + y)\n";
+  Buffer buf(text);
+  std::size_t n = text.size();
+
+  bench::run("character_stream.get", n, [&]() {
+    Character_stream cs(buf);
+    char c = 0;
+    while (!cs.eof())
+      c ^= cs.get();
+    bench::keep(c);
+  });
+
+  bench::run("character_stream.scan_while", n, [&]() {
+    Character_stream cs(buf);
+    while (!cs.eof()) {
+      cs.skip_while(space_class);
+      if (cs.eof())
+        break;
+      if (!cs.scan_while(identifier_class).size())
+        cs.get();
+    }
+  });
+
+  bench::run("character_stream.get_code_point", n, [&]() {
+    Character_stream cs(buf);
+    cs.check_utf8();
+    char32_t c = 0;
+    while (!cs.eof())
+      c ^= cs.get_code_point();
+    bench::keep(c);
+  });
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "bench.hpp"
+
+#include "lingo/unicode.hpp"
+
+#include <string>
+
+using namespace lingo;
+
+
+// Convert the text from one encoding to another, one block at a time.
+void
+convert(Character_set_converter& c, std::string const& s, std::string& out)
+{
+  char const* p = s.data();
+  char const* end = p + s.size();
+  out.resize(4 * s.size() + 16);
+  char* q = &out[0];
+  c.convert_bytes(p, end, p, q, q + out.size(), q);
+  c.reset();
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  bench::init(argc, argv);
+
+  // About 1MB of mixed ASCII and multi-byte UTF-8.
+  std::string text;
+  while (text.size() < (1 << 20))
+    text += "ascii text, \xc3\xa9t\xc3\xa9, \xe2\x88\x80x. \xf0\x9f\x98\x80\n";
+  std::size_t n = text.size();
+  std::string out;
+
+  Character_set_converter u8to32(UTF8_encoding, UTF32_encoding);
+  bench::run("convert utf-8 to utf-32 (bytes)", n, [&]() {
+    convert(u8to32, text, out);
+    bench::keep(out);
+  });
+
+  Character_set_converter u8to16(UTF8_encoding, UTF16_encoding);
+  bench::run("convert utf-8 to utf-16 (bytes)", n, [&]() {
+    convert(u8to16, text, out);
+    bench::keep(out);
+  });
+
+  std::string ascii(1 << 20, 'a');
+  Character_set_converter a8(ASCII_encoding, UTF8_encoding);
+  bench::run("convert ascii to utf-8 (bytes)", n, [&]() {
+    convert(a8, ascii, out);
+    bench::keep(out);
+  });
+}
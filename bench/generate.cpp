@@ -0,0 +1,451 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+// Generates large, syntactically valid programs for the calc, lambda,
+// and stlc examples.
+//
+//    generate <language> [options]
+//
+// The options are:
+//
+//    --size=n[K|M|G]   The approximate size of the program in bytes.
+//                      The default is 1M.
+//    --shape=s         The shape of the program (see below). The
+//                      default is wide.
+//    --depth=n         The nesting depth of deep programs. The
+//                      default is 1000.
+//    --length=n        The length of long literals. The default is
+//                      1000.
+//    --seed=n          The seed of the random number generator. The
+//                      default is 1.
+//
+// The shapes of programs are:
+//
+//    wide      Many short expressions.
+//    deep      Expressions nested to the given depth.
+//    names     Many distinct identifiers (or, in calc, literals).
+//    literals  Long literals (or, in lambda, identifiers).
+//
+// Programs are a sequence of lines, each of which is a complete
+// expression (in calc) or statement. A program is the same for a
+// given language, shape, and seed, and each program is a prefix of
+// any larger one, so that corpora can be reproduced.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+namespace
+{
+
+// -------------------------------------------------------------------------- //
+//                               Output
+
+// Accumulates the program, writing it to stdout in large blocks.
+struct Generator
+{
+  Generator(std::uint64_t size, std::uint32_t seed)
+    : size(size), written(0), rng(seed)
+  {
+    buf.reserve(block_size);
+  }
+
+  ~Generator() { flush(); }
+
+  static constexpr std::size_t block_size = 1 << 16;
+
+  // Returns true while the program is smaller than its size.
+  bool more() const { return written + buf.size() < size; }
+
+  void put(char c)               { buf += c; }
+  void put(char const* s)        { buf += s; }
+  void put(std::string const& s) { buf += s; }
+  void put(std::size_t n, char c) { buf.append(n, c); }
+
+  // End a line, writing the program if the block is full.
+  void line()
+  {
+    buf += '\n';
+    if (buf.size() >= block_size)
+      flush();
+  }
+
+  void flush()
+  {
+    std::fwrite(buf.data(), 1, buf.size(), stdout);
+    written += buf.size();
+    buf.clear();
+  }
+
+  // Returns a number in [0, n). The engine is fully specified by
+  // the standard, unlike the distributions, so programs are the same
+  // everywhere.
+  unsigned pick(unsigned n) { return rng() % n; }
+
+  std::string literal(std::size_t);
+  std::string name(std::uint64_t);
+  std::string word(std::size_t);
+
+  std::uint64_t size;
+  std::uint64_t written;
+  std::mt19937  rng;
+  std::string   buf;
+};
+
+
+// Returns a decimal literal of n digits.
+std::string
+Generator::literal(std::size_t n)
+{
+  std::string s(n, '0');
+  s[0] = '1' + pick(9);
+  for (std::size_t i = 1; i < n; ++i)
+    s[i] = '0' + pick(10);
+  return s;
+}
+
+
+// Returns the nth distinct name. Identifiers are spelled with
+// letters only.
+std::string
+Generator::name(std::uint64_t n)
+{
+  std::string s = "v";
+  do {
+    s += 'a' + n % 26;
+    n /= 26;
+  } while (n);
+  return s;
+}
+
+
+// Returns a random identifier of n letters.
+std::string
+Generator::word(std::size_t n)
+{
+  std::string s(n, 'a');
+  for (std::size_t i = 0; i < n; ++i)
+    s[i] = 'a' + pick(26);
+  return s;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                               Options
+
+struct Options
+{
+  char const*   lang = nullptr;
+  char const*   shape = "wide";
+  std::uint64_t size = 1 << 20;
+  std::uint64_t depth = 1000;
+  std::uint64_t length = 1000;
+  std::uint32_t seed = 1;
+};
+
+
+// Parse a number with an optional K, M, or G suffix. Returns false
+// if the number is invalid.
+bool
+parse_number(char const* s, std::uint64_t& n)
+{
+  char* end;
+  n = std::strtoull(s, &end, 10);
+  if (end == s)
+    return false;
+  switch (*end) {
+    case 'K': n <<= 10; ++end; break;
+    case 'M': n <<= 20; ++end; break;
+    case 'G': n <<= 30; ++end; break;
+  }
+  return *end == 0;
+}
+
+
+bool
+parse_options(int argc, char* argv[], Options& opts)
+{
+  for (int i = 1; i < argc; ++i) {
+    char const* a = argv[i];
+    std::uint64_t n;
+    if (std::strncmp(a, "--size=", 7) == 0) {
+      if (!parse_number(a + 7, opts.size))
+        return false;
+    } else if (std::strncmp(a, "--shape=", 8) == 0) {
+      opts.shape = a + 8;
+    } else if (std::strncmp(a, "--depth=", 8) == 0) {
+      if (!parse_number(a + 8, opts.depth) || opts.depth == 0)
+        return false;
+    } else if (std::strncmp(a, "--length=", 9) == 0) {
+      if (!parse_number(a + 9, opts.length) || opts.length == 0)
+        return false;
+    } else if (std::strncmp(a, "--seed=", 7) == 0) {
+      if (!parse_number(a + 7, n))
+        return false;
+      opts.seed = n;
+    } else if (a[0] != '-' && !opts.lang) {
+      opts.lang = a;
+    } else {
+      return false;
+    }
+  }
+  return opts.lang;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                                Calc
+
+// Binary operators whose right operands are never zero.
+char const* calc_ops[] = {" + ", " - ", " * ", " / ", " % "};
+
+
+void
+calc(Generator& g, Options const& opts)
+{
+  std::string shape = opts.shape;
+  std::uint64_t n = 0;
+  while (g.more()) {
+    if (shape == "wide") {
+      // A sequence of terms, such as 3 * 4 - 5 % 6.
+      g.put(std::to_string(g.pick(100)));
+      for (int i = 0; i < 32; ++i) {
+        g.put(calc_ops[g.pick(5)]);
+        g.put(std::to_string(1 + g.pick(99)));
+      }
+    } else if (shape == "deep") {
+      // A right-nested expression, such as (1 + (2 * -(3 - 4))).
+      // The operands of division could be zero, so it is not used.
+      for (std::uint64_t i = 0; i < opts.depth; ++i) {
+        g.put(std::to_string(1 + g.pick(9)));
+        g.put(calc_ops[g.pick(3)]);
+        g.put(g.pick(4) ? "(" : "-(");
+      }
+      g.put(std::to_string(1 + g.pick(9)));
+      g.put(opts.depth, ')');
+    } else if (shape == "names") {
+      // A sequence of distinct literals.
+      g.put(std::to_string(n++));
+      for (int i = 0; i < 32; ++i) {
+        g.put(calc_ops[g.pick(3)]);
+        g.put(std::to_string(n++));
+      }
+    } else {
+      // Calc lexes literals as unbounded integers, so they need not
+      // fit in an int.
+      g.put(g.literal(opts.length));
+      g.put(calc_ops[g.pick(5)]);
+      g.put(g.literal(opts.length));
+    }
+    g.line();
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+//                               Lambda
+
+char const* lambda_prelude[] = {
+  "true = \\a.\\b.a;",
+  "false = \\a.\\b.b;",
+  "and = \\p.\\q.p q p;",
+  "or = \\p.\\q.p p q;",
+  "not = \\p.p (\\a.\\b.b) (\\a.\\b.a);",
+};
+
+
+// Write a random boolean expression of the given depth.
+void
+lambda_bool(Generator& g, int depth)
+{
+  if (depth == 0) {
+    g.put(g.pick(2) ? "true" : "false");
+    return;
+  }
+  switch (g.pick(3)) {
+    case 0:
+      g.put("not (");
+      lambda_bool(g, depth - 1);
+      g.put(')');
+      break;
+    case 1:
+      g.put("and (");
+      lambda_bool(g, depth - 1);
+      g.put(") (");
+      lambda_bool(g, depth - 1);
+      g.put(')');
+      break;
+    case 2:
+      g.put("or (");
+      lambda_bool(g, depth - 1);
+      g.put(") ");
+      lambda_bool(g, 0);
+      break;
+  }
+}
+
+
+void
+lambda(Generator& g, Options const& opts)
+{
+  for (char const* s : lambda_prelude) {
+    g.put(s);
+    g.line();
+  }
+  std::string shape = opts.shape;
+  std::uint64_t n = 0;
+  while (g.more()) {
+    if (shape == "wide") {
+      lambda_bool(g, 3);
+      g.put(';');
+    } else if (shape == "deep") {
+      // not (not (... true)).
+      for (std::uint64_t i = 0; i < opts.depth; ++i)
+        g.put("not (");
+      g.put("true");
+      g.put(opts.depth, ')');
+      g.put(';');
+    } else if (shape == "names") {
+      // A definition with distinct names, and its use.
+      std::string f = g.name(n++);
+      std::string x = g.name(n++);
+      std::string y = g.name(n++);
+      g.put(f + " = \\" + x + ".\\" + y + "." + x + ";");
+      g.line();
+      g.put(f + " true false;");
+    } else {
+      // Lambda has no literals, so the names are long.
+      std::string f = g.word(opts.length);
+      g.put(f + " = \\a.\\b.b a;");
+      g.line();
+      g.put(f + " true false;");
+    }
+    g.line();
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+//                                STLC
+
+char const* stlc_prelude[] = {
+  "true : Bool;",
+  "false : Bool;",
+  "idb = \\x:Bool.x;",
+  "kb = \\x:Bool.\\y:Bool.x;",
+  "app = \\f:Bool->Bool.\\x:Bool.f x;",
+  "idz = \\x:Int.x;",
+};
+
+
+// Write a random expression of type Bool of the given depth.
+void
+stlc_bool(Generator& g, int depth)
+{
+  if (depth == 0) {
+    g.put(g.pick(2) ? "true" : "false");
+    return;
+  }
+  switch (g.pick(3)) {
+    case 0:
+      g.put("idb (");
+      stlc_bool(g, depth - 1);
+      g.put(')');
+      break;
+    case 1:
+      g.put("kb (");
+      stlc_bool(g, depth - 1);
+      g.put(") (");
+      stlc_bool(g, depth - 1);
+      g.put(')');
+      break;
+    case 2:
+      g.put("app idb (");
+      stlc_bool(g, depth - 1);
+      g.put(')');
+      break;
+  }
+}
+
+
+void
+stlc(Generator& g, Options const& opts)
+{
+  for (char const* s : stlc_prelude) {
+    g.put(s);
+    g.line();
+  }
+  std::string shape = opts.shape;
+  std::uint64_t n = 0;
+  while (g.more()) {
+    if (shape == "wide") {
+      stlc_bool(g, 3);
+      g.put(';');
+    } else if (shape == "deep") {
+      // idb (idb (... true)).
+      for (std::uint64_t i = 0; i < opts.depth; ++i)
+        g.put("idb (");
+      g.put("true");
+      g.put(opts.depth, ')');
+      g.put(';');
+    } else if (shape == "names") {
+      // A declaration of a distinct name, and its use.
+      std::string x = g.name(n++);
+      g.put(x + " : Bool;");
+      g.line();
+      g.put("kb " + x + " true;");
+    } else {
+      // Integer literals are declared like variables.
+      std::string z = g.literal(opts.length);
+      g.put(z + " : Int;");
+      g.line();
+      g.put("idz " + z + ";");
+    }
+    g.line();
+  }
+}
+
+
+void
+usage()
+{
+  std::fputs(
+    "usage: generate calc|lambda|stlc [--size=n[K|M|G]] "
+    "[--shape=wide|deep|names|literals] [--depth=n] [--length=n] [--seed=n]\n",
+    stderr);
+}
+
+} // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+  Options opts;
+  if (!parse_options(argc, argv, opts)) {
+    usage();
+    return 1;
+  }
+  std::string shape = opts.shape;
+  if (shape != "wide" && shape != "deep" && shape != "names" && shape != "literals") {
+    usage();
+    return 1;
+  }
+
+  Generator g(opts.size, opts.seed);
+  std::string lang = opts.lang;
+  if (lang == "calc")
+    calc(g, opts);
+  else if (lang == "lambda")
+    lambda(g, opts);
+  else if (lang == "stlc")
+    stlc(g, opts);
+  else {
+    usage();
+    return 1;
+  }
+  return 0;
+}
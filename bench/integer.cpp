@@ -0,0 +1,68 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "bench.hpp"
+
+#include "lingo/integer.hpp"
+
+#include <vector>
+
+using namespace lingo;
+
+
+int
+main(int argc, char* argv[])
+{
+  bench::init(argc, argv);
+
+  std::size_t const n = 100000;
+  std::vector<Integer> xs;
+  for (std::size_t i = 0; i < n; ++i)
+    xs.push_back(Integer(32, std::int64_t(i * 2654435761u % 100000 + 1), true));
+
+  bench::run("integer add (32-bit)", n, [&]() {
+    Integer s(32, 0, true);
+    for (Integer const& x : xs)
+      s = s + x;
+    bench::keep(s);
+  });
+
+  bench::run("integer mul (32-bit)", n, [&]() {
+    Integer s(32, 1, true);
+    for (Integer const& x : xs)
+      s = s * x;
+    bench::keep(s);
+  });
+
+  bench::run("integer div (32-bit)", n, [&]() {
+    Integer s(32, 0, true);
+    Integer k(32, 1 << 30, true);
+    for (Integer const& x : xs)
+      s = s + k / x;
+    bench::keep(s);
+  });
+
+  // Unbounded integers stay small until they overflow 64 bits.
+  std::vector<Integer> us;
+  for (Integer const& x : xs)
+    us.push_back(Integer(Integer::unbounded, x.gets(), true));
+
+  bench::run("integer add (unbounded, small)", n, [&]() {
+    Integer s(Integer::unbounded, 0, true);
+    for (Integer const& x : us)
+      s = s + x;
+    bench::keep(s);
+  });
+
+  bench::run("integer mul (unbounded, big)", n, [&]() {
+    Integer s(Integer::unbounded, 1, true);
+    for (std::size_t i = 0; i < n; ++i) {
+      s = s * us[i];
+      if (i % 64 == 63)
+        s = Integer(Integer::unbounded, 1, true);
+    }
+    bench::keep(s);
+  });
+}
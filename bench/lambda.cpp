@@ -0,0 +1,115 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "bench.hpp"
+
+#include "ast.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "evaluator.hpp"
+#include "machine.hpp"
+#include "bytecode.hpp"
+#include "debruijn.hpp"
+
+#include "lingo/buffer.hpp"
+#include "lingo/character.hpp"
+#include "lingo/memory.hpp"
+#include "lingo/token.hpp"
+
+using namespace lingo;
+using namespace calc;
+
+
+// The boolean operators, followed by n expressions that use them.
+String
+program(int n)
+{
+  String s =
+    "true = \\a.\\b.a;\n"
+    "false = \\a.\\b.b;\n"
+    "and = \\p.\\q.p q p;\n"
+    "or = \\p.\\q.p p q;\n"
+    "not = \\p.p (\\a.\\b.b) (\\a.\\b.a);\n";
+  for (int i = 0; i < n; ++i)
+    s += i % 2 ? "and true (or false (not false));\n" : "or (not true) (and true true);\n";
+  return s;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  bench::init(argc, argv);
+
+  String text = bench::input() ? bench::read_input() : program(5000);
+  std::size_t n = bench::count_lines(text);
+  Buffer buf(text);
+
+  bench::run("lambda lex (lines)", n, [&]() {
+    Character_stream cs(buf);
+    Token_stream ts;
+    Lexer lex(cs, ts);
+    lex();
+    bench::keep(ts);
+  });
+
+  Character_stream cs(buf);
+  Token_stream ts;
+  Lexer lex(cs, ts);
+  lex();
+  Token_seq toks = ts.tokens();
+
+  bench::run("lambda parse (lines)", n, [&]() {
+    Arena_factory nodes;
+    Arena_scope scope(nodes);
+    Token_stream ts(toks);
+    Parser parse(ts);
+    bench::keep(parse());
+  });
+
+  Arena_factory nodes;
+  Arena_scope scope(nodes);
+  Token_stream ets(toks);
+  Parser parse(ets);
+  Expr const* e = parse();
+
+  // The evaluators print the value of each item.
+  bench::Silence quiet;
+
+  bench::run("lambda evaluate (lines)", n, [&]() {
+    Arena_factory values;
+    Arena_scope scope(values);
+    Evaluator eval;
+    bench::keep(eval(e));
+  });
+
+  bench::run("lambda machine (lines)", n, [&]() {
+    Arena_factory values;
+    Arena_scope scope(values);
+    Machine eval;
+    bench::keep(eval(e));
+  });
+
+  bench::run("lambda machine, lazy (lines)", n, [&]() {
+    Arena_factory values;
+    Arena_scope scope(values);
+    Machine eval(true);
+    bench::keep(eval(e));
+  });
+
+  bench::run("lambda vm (lines)", n, [&]() {
+    Arena_factory values;
+    Arena_scope scope(values);
+    Vm eval;
+    bench::keep(eval(compile(e)));
+  });
+
+  // Normal forms are cached by term, so after the first run this
+  // measures lowering and the lookup of each item.
+  bench::run("lambda normalize, de Bruijn (lines)", n, [&]() {
+    Normalizer eval;
+    bench::keep(eval(e));
+  });
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "bench.hpp"
+
+#include "lingo/memory.hpp"
+
+using namespace lingo;
+
+
+// A collectable binary node.
+struct Cons : Gc_header
+{
+  Cons(Cons const* a, Cons const* b)
+    : first(a), second(b)
+  { }
+
+  Cons const* first;
+  Cons const* second;
+};
+
+
+int
+main(int argc, char* argv[])
+{
+  bench::init(argc, argv);
+
+  Collecting_factory& f = gc();
+  Collection_policy manual = f.policy();
+  manual.mode = manual_collection;
+  f.set_policy(manual);
+  std::size_t const n = 100000;
+
+  bench::run("collecting_factory.make", n, [&]() {
+    for (std::size_t i = 0; i < n; ++i)
+      bench::keep(f.make<Cons>(nullptr, nullptr));
+    f.collect();
+  });
+
+  // Half of the objects are reachable from a list.
+  bench::run("collecting_factory.collect (50% live)", n, [&]() {
+    Cons const* list = nullptr;
+    Reach r(list);
+    for (std::size_t i = 0; i < n; ++i) {
+      Cons* x = f.make<Cons>(nullptr, nullptr);
+      if (i % 2)
+        list = f.make<Cons>(x, list);
+    }
+    f.collect();
+  });
+  f.collect();
+
+  bench::run("arena_factory.make", n, [&]() {
+    Arena_factory a;
+    for (std::size_t i = 0; i < n; ++i)
+      bench::keep(a.make<Cons>(nullptr, nullptr));
+  });
+}
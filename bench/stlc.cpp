@@ -0,0 +1,85 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "bench.hpp"
+
+#include "ast.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "evaluator.hpp"
+
+#include "lingo/buffer.hpp"
+#include "lingo/character.hpp"
+#include "lingo/memory.hpp"
+#include "lingo/token.hpp"
+
+using namespace lingo;
+using namespace calc;
+
+
+// A few typed functions, followed by n expressions that use them.
+String
+program(int n)
+{
+  String s =
+    "true : Bool;\n"
+    "false : Bool;\n"
+    "idb = \\x:Bool.x;\n"
+    "kb = \\x:Bool.\\y:Bool.x;\n"
+    "app = \\f:Bool->Bool.\\x:Bool.f x;\n";
+  for (int i = 0; i < n; ++i)
+    s += i % 2 ? "app idb (kb true false);\n" : "kb (idb false) (app idb true);\n";
+  return s;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  bench::init(argc, argv);
+
+  String text = bench::input() ? bench::read_input() : program(5000);
+  std::size_t n = bench::count_lines(text);
+  Buffer buf(text);
+
+  bench::run("stlc lex (lines)", n, [&]() {
+    Character_stream cs(buf);
+    Token_stream ts;
+    Lexer lex(cs, ts);
+    lex();
+    bench::keep(ts);
+  });
+
+  Character_stream cs(buf);
+  Token_stream ts;
+  Lexer lex(cs, ts);
+  lex();
+  Token_seq toks = ts.tokens();
+
+  // Parsing includes type checking.
+  bench::run("stlc parse (lines)", n, [&]() {
+    Arena_factory nodes;
+    Arena_scope scope(nodes);
+    Token_stream ts(toks);
+    Parser parse(ts);
+    bench::keep(parse());
+  });
+
+  Arena_factory nodes;
+  Arena_scope scope(nodes);
+  Token_stream ets(toks);
+  Parser parse(ets);
+  Expr const* e = parse();
+
+  // The evaluators print the value of each item.
+  bench::Silence quiet;
+
+  bench::run("stlc evaluate (lines)", n, [&]() {
+    Arena_factory values;
+    Arena_scope scope(values);
+    Evaluator eval;
+    bench::keep(eval(e));
+  });
+}
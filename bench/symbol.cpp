@@ -0,0 +1,45 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "bench.hpp"
+
+#include "lingo/symbol.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace lingo;
+
+
+int
+main(int argc, char* argv[])
+{
+  bench::init(argc, argv);
+
+  std::size_t const n = 100000;
+  std::vector<std::string> names;
+  for (std::size_t i = 0; i < n; ++i)
+    names.push_back("identifier_" + std::to_string(i * 7919 % n));
+
+  bench::run("symbol_table.put (new)", n, [&]() {
+    Symbol_table syms;
+    for (std::string const& s : names)
+      bench::keep(syms.put_identifier(0, s));
+  });
+
+  Symbol_table syms;
+  for (std::string const& s : names)
+    syms.put_identifier(0, s);
+
+  bench::run("symbol_table.put (existing)", n, [&]() {
+    for (std::string const& s : names)
+      bench::keep(syms.put_identifier(0, s));
+  });
+
+  bench::run("symbol_table.get", n, [&]() {
+    for (std::string const& s : names)
+      bench::keep(syms.get(s));
+  });
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "bench.hpp"
+
+#include "lingo/symbol.hpp"
+#include "lingo/token.hpp"
+
+using namespace lingo;
+
+
+int
+main(int argc, char* argv[])
+{
+  bench::init(argc, argv);
+
+  Symbol_table syms;
+  Symbol const* a = syms.put_identifier(0, "a");
+  Symbol const* b = syms.put_identifier(1, "b");
+  std::size_t const n = 1000000;
+
+  bench::run("token_stream.put", n, [&]() {
+    Token_stream ts;
+    for (std::size_t i = 0; i < n; ++i)
+      ts.put(Token(Location(), i % 2 ? a : b));
+    bench::keep(ts);
+  });
+
+  Token_stream ts;
+  for (std::size_t i = 0; i < n; ++i)
+    ts.put(Token(Location(), i % 2 ? a : b));
+  Token_seq toks = ts.tokens();
+
+  bench::run("token_stream.peek/get", n, [&]() {
+    Token_stream s(toks);
+    int k = 0;
+    while (!s.eof()) {
+      k += s.peek().kind();
+      s.get();
+    }
+    bench::keep(k);
+  });
+
+  bench::run("token_stream.peek(2)", n, [&]() {
+    Token_stream s(toks);
+    int k = 0;
+    while (!s.eof()) {
+      k += s.peek(2).kind();
+      s.get();
+    }
+    bench::keep(k);
+  });
+}
@@ -5,6 +5,7 @@
 
 #include "lingo/memory.hpp"
 #include "lingo/error.hpp"
+#include "lingo/statistics.hpp"
 
 #include <iostream>
 
@@ -16,7 +17,7 @@ Int::span() const
 {
   std::stringstream ss;
   ss << val_;
-  return {loc_, Location(loc_.offset() + ss.str().size())};
+  return {loc_, Location::at(loc_.position() + ss.str().size())};
 }
 
 
@@ -68,12 +69,14 @@ struct Eval_fn
 
   Integer operator()(Div const* e)
   {
-    return evaluate(e->left()) / evaluate(e->right());
+    Integer x = evaluate(e->left());
+    return x / divisor(e);
   }
 
   Integer operator()(Mod const* e)
   {
-    return evaluate(e->left()) % evaluate(e->right());
+    Integer x = evaluate(e->left());
+    return x % divisor(e);
   }
 
   Integer operator()(Neg const* e)
@@ -85,13 +88,25 @@ struct Eval_fn
   {
     return evaluate(e->arg());
   }
+
+  // Returns the value of the right operand of e. Throws
+  // Division_by_zero if it is 0.
+  Integer divisor(Binary const* e)
+  {
+    Integer y = evaluate(e->right());
+    if (!y.truth_value())
+      throw Division_by_zero(e);
+    return y;
+  }
 };
 
 
-// Compute the integer evaluation of the expression.
+// Compute the integer evaluation of the expression. Each term
+// evaluated is a step. Throws Division_by_zero if a divisor is 0.
 Integer
 evaluate(Expr const* e)
 {
+  count_step();
   return apply(e, Eval_fn());
 }
 
@@ -168,25 +183,42 @@ needs_parens(Expr const* expr, Expr const* sub)
 }
 
 
+// The text of a subexpression, whose offsets are found while
+// printing an expression that contains it.
+struct Mark
+{
+  Expr const* expr;
+  int         first;
+  int         last;
+};
+
+
+void print(std::ostream&, Expr const*, Mark*);
+
+
 // Output streaming for nested sub-expressions.
 struct subexpr
 {
-  subexpr(Expr const* e, Expr const* s)
-    : e(e), s(s)
+  subexpr(Expr const* e, Expr const* s, Mark* m)
+    : e(e), s(s), m(m)
   { }
 
   Expr const* e;
   Expr const* s;
+  Mark*       m;
 };
 
 
 std::ostream&
 operator<<(std::ostream& os, subexpr sub)
 {
-  if (needs_parens(sub.e, sub.s))
-    os << '(' << *sub.s << ')';
-  else
-    os << *sub.s;
+  if (needs_parens(sub.e, sub.s)) {
+    os << '(';
+    print(os, sub.s, sub.m);
+    os << ')';
+  } else {
+    print(os, sub.s, sub.m);
+  }
   return os;
 }
 
@@ -220,6 +252,44 @@ operator<<(std::ostream& os, opname op)
 }
 
 
+void
+print(std::ostream& os, Binary const* e, Mark* m)
+{
+  os << subexpr(e, e->left(), m)
+     << ' ' << opname(e) << ' '
+     << subexpr(e, e->right(), m);
+}
+
+
+void
+print(std::ostream& os, Unary const* e, Mark* m)
+{
+  os << opname(e) << subexpr(e, e->arg(), m);
+}
+
+
+// Pretty print e. If e is the marked subexpression, record the
+// offsets of its text.
+void
+print(std::ostream& os, Expr const* e, Mark* m)
+{
+  struct Fn
+  {
+    void operator()(Int const* e) const { print(os, e); }
+    void operator()(Binary const* e) const { print(os, e, m); }
+    void operator()(Unary const* e) const { print(os, e, m); }
+
+    std::ostream& os;
+    Mark*         m;
+  };
+  if (m && m->expr == e)
+    m->first = os.tellp();
+  apply(e, Fn{os, m});
+  if (m && m->expr == e)
+    m->last = os.tellp();
+}
+
+
 } // namespace
 
 
@@ -233,17 +303,14 @@ print(std::ostream& os, Int const* e)
 void
 print(std::ostream& os, Binary const* e)
 {
-  os << subexpr(e, e->left())
-     << ' ' << opname(e) << ' '
-     << subexpr(e, e->right());
-
+  print(os, e, nullptr);
 }
 
 
 void
 print(std::ostream& os, Unary const* e)
 {
-  os << opname(e) << subexpr(e, e->arg());
+  print(os, e, nullptr);
 }
 
 
@@ -251,15 +318,22 @@ print(std::ostream& os, Unary const* e)
 void
 print(std::ostream& os, Expr const* e)
 {
-  struct Fn
-  {
-    void operator()(Int const* e) const { print(os, e); }
-    void operator()(Binary const* e) const { print(os, e); }
-    void operator()(Unary const* e) const { print(os, e); }
+  print(os, e, nullptr);
+}
 
-    std::ostream& os;
-  };
-  apply(e, Fn{os});
+
+// Pretty print the expression e, which contains the expression s.
+// The offsets of the text of s, relative to the start of the
+// output, are stored in first and last. This finds the region of
+// a subexpression without parsing the output.
+void
+print(std::ostream& os, Expr const* e, Expr const* s, int& first, int& last)
+{
+  std::ostream::pos_type start = os.tellp();
+  Mark m {s, 0, 0};
+  print(os, e, &m);
+  first = m.first - start;
+  last = m.last - start;
 }
 
 
@@ -275,46 +349,11 @@ operator<<(std::ostream& os, Expr const& e)
 // Debug printing
 
 
-namespace
-{
-
-struct Debug_fn
-{
-  Debug_fn(Printer& p)
-    : p(p)
-  { }
-
-  void operator()(Int const* e) const { debug(p, e); }
-  void operator()(Add const* e) const { debug(p, e); }
-  void operator()(Sub const* e) const { debug(p, e); }
-  void operator()(Mul const* e) const { debug(p, e); }
-  void operator()(Div const* e) const { debug(p, e); }
-  void operator()(Mod const* e) const { debug(p, e); }
-  void operator()(Neg const* e) const { debug(p, e); }
-  void operator()(Pos const* e) const { debug(p, e); }
-
-  Printer& p;
-};
-
-
-} // namespace
-
-
 // Emit a debug representation of the given expression.
 void
 debug(Printer& p, Expr const* e)
 {
-  if (!e) {
-    debug(p, "<null>");
-    return;
-  }
-
-  if (is_error_node(e)) {
-    debug(p, "<error>");
-    return;
-  }
-
-  apply(e, Debug_fn(p));
+  debug_tree<Expr_nodes>(p, e);
 }
 
 
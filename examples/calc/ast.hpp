@@ -4,12 +4,16 @@
 #ifndef CALC_HPP
 #define CALC_HPP
 
+#include <lingo/dispatch.hpp>
 #include <lingo/integer.hpp>
+#include <lingo/memory.hpp>
 #include <lingo/node.hpp>
 #include <lingo/token.hpp>
 #include <lingo/print.hpp>
 #include <lingo/debug.hpp>
 
+#include <stdexcept>
+
 namespace calc
 {
 
@@ -32,15 +36,30 @@ struct Visitor;
 //                                   Nodes
 
 
-// The base class of all terms in the core.
+// The base class of all terms in the core. The kind of each
+// term is stored with it, so that is, as, and cast can test its
+// dynamic type with an integer comparison. Each term also records
+// its size: the number of terms in the tree it roots.
 struct Expr
 {
-  Expr()
-    : loc_()
+  enum Kind
+  {
+    int_expr,
+    add_expr,
+    sub_expr,
+    mul_expr,
+    div_expr,
+    mod_expr,
+    neg_expr,
+    pos_expr
+  };
+
+  Expr(Kind k)
+    : kind_(k), loc_(), size_(1)
   { }
 
-  Expr(Location l)
-    : loc_(l)
+  Expr(Kind k, Location l, std::size_t n = 1)
+    : kind_(k), loc_(l), size_(n)
   { }
 
   virtual ~Expr()
@@ -48,10 +67,14 @@ struct Expr
 
   virtual void accept(Visitor&) const = 0;
 
+  Kind         kind() const     { return kind_; }
   Location     location() const { return loc_; }
   virtual Span span() const = 0;
+  std::size_t  size() const     { return size_; }
 
-  Location loc_;
+  Kind        kind_;
+  Location    loc_;
+  std::size_t size_;
 };
 
 
@@ -73,10 +96,15 @@ struct Visitor
 // expression contains the operator token and its operand.
 struct Unary : Expr
 {
-  Unary(Location loc, Expr const* e)
-    : Expr(loc), first(e)
+  Unary(Kind k, Location loc, Expr const* e)
+    : Expr(k, loc, 1 + e->size()), first(e)
   { }
 
+  static bool classof(Expr const* e)
+  {
+    return neg_expr <= e->kind() && e->kind() <= pos_expr;
+  }
+
   Span span() const;
 
   Expr const* arg() const { return first; }
@@ -89,10 +117,15 @@ struct Unary : Expr
 // expression contains the operator token and its two operands.
 struct Binary : Expr
 {
-  Binary(Location loc, Expr const* l, Expr const* r)
-    : Expr(loc), first(l), second(r)
+  Binary(Kind k, Location loc, Expr const* l, Expr const* r)
+    : Expr(k, loc, 1 + l->size() + r->size()), first(l), second(r)
   { }
 
+  static bool classof(Expr const* e)
+  {
+    return add_expr <= e->kind() && e->kind() <= mod_expr;
+  }
+
   Span span() const;
 
   Expr const* left() const { return first; }
@@ -107,9 +140,13 @@ struct Binary : Expr
 struct Int : Expr
 {
   Int(Location loc, Integer n)
-    : Expr(loc), val_(n)
+    : Expr(int_expr, loc), val_(n)
   { }
 
+  static constexpr Kind node_kind = int_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
+
   void accept(Visitor& v) const { v.visit(this); }
 
   Span span() const;
@@ -123,7 +160,13 @@ struct Int : Expr
 // Addition of numbers.
 struct Add : Binary
 {
-  using Binary::Binary;
+  Add(Location loc, Expr const* l, Expr const* r)
+    : Binary(add_expr, loc, l, r)
+  { }
+
+  static constexpr Kind node_kind = add_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { v.visit(this); }
 };
@@ -132,7 +175,13 @@ struct Add : Binary
 // Subtraction of numbers.
 struct Sub : Binary
 {
-  using Binary::Binary;
+  Sub(Location loc, Expr const* l, Expr const* r)
+    : Binary(sub_expr, loc, l, r)
+  { }
+
+  static constexpr Kind node_kind = sub_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { v.visit(this); }
 };
@@ -141,7 +190,13 @@ struct Sub : Binary
 // Multiplication of numbers.
 struct Mul : Binary
 {
-  using Binary::Binary;
+  Mul(Location loc, Expr const* l, Expr const* r)
+    : Binary(mul_expr, loc, l, r)
+  { }
+
+  static constexpr Kind node_kind = mul_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { v.visit(this); }
 };
@@ -150,7 +205,13 @@ struct Mul : Binary
 // Quotient of division of numbers.
 struct Div : Binary
 {
-  using Binary::Binary;
+  Div(Location loc, Expr const* l, Expr const* r)
+    : Binary(div_expr, loc, l, r)
+  { }
+
+  static constexpr Kind node_kind = div_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { v.visit(this); }
 };
@@ -159,7 +220,13 @@ struct Div : Binary
 // Remainder of division numubers.
 struct Mod : Binary
 {
-  using Binary::Binary;
+  Mod(Location loc, Expr const* l, Expr const* r)
+    : Binary(mod_expr, loc, l, r)
+  { }
+
+  static constexpr Kind node_kind = mod_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { v.visit(this); }
 };
@@ -168,7 +235,13 @@ struct Mod : Binary
 // Negation of numbers.
 struct Neg : Unary
 {
-  using Unary::Unary;
+  Neg(Location loc, Expr const* e)
+    : Unary(neg_expr, loc, e)
+  { }
+
+  static constexpr Kind node_kind = neg_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { v.visit(this); }
 };
@@ -177,7 +250,13 @@ struct Neg : Unary
 // Identity of numbers.
 struct Pos : Unary
 {
-  using Unary::Unary;
+  Pos(Location loc, Expr const* e)
+    : Unary(pos_expr, loc, e)
+  { }
+
+  static constexpr Kind node_kind = pos_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { v.visit(this); }
 };
@@ -203,40 +282,19 @@ constexpr bool is_binary()
 
 
 // -------------------------------------------------------------------------- //
-//                                Generic visitor
-
-// A parameterized visitor that dispatches to a function
-// object. F is the type of the function and T is its
-// return type.
-//
-// This class is never used directly. It is used only in
-// the apply function below.
-template<typename F, typename T>
-struct Basic_visitor : Visitor, Generic_visitor<F, T>
-{
-  Basic_visitor(F f)
-    : Generic_visitor<F, T>(f)
-  { }
+//                                  Dispatch
 
-  void visit(Int const* e) { this->invoke(e); }
-  void visit(Add const* e) { this->invoke(e); }
-  void visit(Sub const* e) { this->invoke(e); }
-  void visit(Mul const* e) { this->invoke(e); }
-  void visit(Div const* e) { this->invoke(e); }
-  void visit(Mod const* e) { this->invoke(e); }
-  void visit(Neg const* e) { this->invoke(e); }
-  void visit(Pos const* e) { this->invoke(e); }
-};
+// The concrete expressions, for dispatch.
+using Expr_nodes = Node_list<Int, Add, Sub, Mul, Div, Mod, Neg, Pos>;
 
 
-// Apply the function f to the type t.
+// Apply the function f to the expression e, switching on its kind.
 // The return type is that of the function object F.
 template<typename F, typename T = typename std::result_of<F(Int const*)>::type>
 inline T
 apply(Expr const* e, F fn)
 {
-  Basic_visitor<F, T> v(fn);
-  return accept(e, v);
+  return dispatch<Expr_nodes, Expr, F, T>(e, fn);
 }
 
 
@@ -246,6 +304,31 @@ apply(Expr const* e, F fn)
 Integer evaluate(Expr const*);
 
 
+// Thrown when the evaluation of a division or remainder, expr,
+// divides by zero.
+struct Division_by_zero : std::runtime_error
+{
+  Division_by_zero(Expr const* e)
+    : std::runtime_error("division by zero"), expr(e)
+  { }
+
+  Expr const* expr;
+};
+
+
+// -------------------------------------------------------------------------- //
+//                                 Allocation
+
+// Allocate a node in the current arena. Nodes are released when
+// the arena scope in which they were created ends.
+template<typename T, typename... Args>
+inline T*
+make(Args&&... args)
+{
+  return Arena_scope::current().make<T>(std::forward<Args>(args)...);
+}
+
+
 // -------------------------------------------------------------------------- //
 //                                  Facilities
 
@@ -254,6 +337,7 @@ void print(std::ostream&, Expr const*);
 void print(std::ostream&, Int const*);
 void print(std::ostream&, Unary const*);
 void print(std::ostream&, Binary const*);
+void print(std::ostream&, Expr const*, Expr const*, int&, int&);
 
 std::ostream& operator<<(std::ostream&, Expr const&);
 
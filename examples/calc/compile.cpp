@@ -0,0 +1,304 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "compile.hpp"
+#include "ast.hpp"
+
+#include <lingo/error.hpp>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace calc
+{
+
+namespace
+{
+
+// -------------------------------------------------------------------------- //
+//                               Code generation
+
+// Returns the width of the integers in e, or -1 if they differ, or
+// if an unbounded literal does not fit in 64 bits.
+struct Width_fn
+{
+  int operator()(Int const* e) const
+  {
+    return e->value().big() ? -1 : e->value().bits();
+  }
+
+  template<typename T>
+  typename std::enable_if<is_unary<T>(), int>::type
+  operator()(T const* e) const
+  {
+    return apply(e->arg(), *this);
+  }
+
+  template<typename T>
+  typename std::enable_if<is_binary<T>(), int>::type
+  operator()(T const* e) const
+  {
+    int w1 = apply(e->left(), *this);
+    int w2 = apply(e->right(), *this);
+    return w1 == w2 ? w1 : -1;
+  }
+};
+
+
+// Generates the instructions that compute the value of an
+// expression. Arithmetic wraps at the width of the operands,
+// as it does for Integer. Unbounded integers are computed in 64
+// bits, and arithmetic that overflows branches to the overflow
+// block. Division by zero branches to the error block.
+struct Gen_fn
+{
+  llvm::Value* operator()(Int const* e) const
+  {
+    return llvm::ConstantInt::get(b.getContext(), e->value().impl());
+  }
+
+  llvm::Value* operator()(Add const* e) const
+  {
+    return arith(llvm::Intrinsic::sadd_with_overflow, llvm::Instruction::Add, e);
+  }
+
+  llvm::Value* operator()(Sub const* e) const
+  {
+    return arith(llvm::Intrinsic::ssub_with_overflow, llvm::Instruction::Sub, e);
+  }
+
+  llvm::Value* operator()(Mul const* e) const
+  {
+    return arith(llvm::Intrinsic::smul_with_overflow, llvm::Instruction::Mul, e);
+  }
+
+  llvm::Value* operator()(Div const* e) const { return divide(e, true); }
+  llvm::Value* operator()(Mod const* e) const { return divide(e, false); }
+
+  llvm::Value* operator()(Neg const* e) const
+  {
+    return neg(gen(e->arg()));
+  }
+
+  llvm::Value* operator()(Pos const* e) const
+  {
+    return gen(e->arg());
+  }
+
+  llvm::Value* gen(Expr const* e) const { return apply(e, *this); }
+
+  llvm::Value* arith(llvm::Intrinsic::ID, llvm::Instruction::BinaryOps, Binary const*) const;
+  llvm::Value* arith(llvm::Intrinsic::ID, llvm::Instruction::BinaryOps, llvm::Value*, llvm::Value*) const;
+  llvm::Value* neg(llvm::Value*) const;
+  llvm::Value* divide(Binary const*, bool) const;
+
+  llvm::IRBuilder<>& b;
+  bool               checked;  // True if integers are unbounded
+  llvm::BasicBlock*  fail;     // Division by zero
+  llvm::BasicBlock*  overflow; // Unbounded overflow
+};
+
+
+llvm::Value*
+Gen_fn::arith(llvm::Intrinsic::ID id, llvm::Instruction::BinaryOps op, Binary const* e) const
+{
+  llvm::Value* x = gen(e->left());
+  llvm::Value* y = gen(e->right());
+  return arith(id, op, x, y);
+}
+
+
+// Apply the operation op to x and y. If integers are unbounded, the
+// intrinsic id computes the operation and checks for overflow.
+llvm::Value*
+Gen_fn::arith(llvm::Intrinsic::ID id, llvm::Instruction::BinaryOps op, llvm::Value* x, llvm::Value* y) const
+{
+  if (!checked)
+    return b.CreateBinOp(op, x, y);
+  llvm::Function* fn = b.GetInsertBlock()->getParent();
+  llvm::Function* f = llvm::Intrinsic::getDeclaration(fn->getParent(), id, {x->getType()});
+  llvm::Value* r = b.CreateCall(f, {x, y});
+  llvm::BasicBlock* ok = llvm::BasicBlock::Create(b.getContext(), "", fn);
+  b.CreateCondBr(b.CreateExtractValue(r, 1), overflow, ok);
+  b.SetInsertPoint(ok);
+  return b.CreateExtractValue(r, 0);
+}
+
+
+llvm::Value*
+Gen_fn::neg(llvm::Value* x) const
+{
+  llvm::Value* zero = llvm::ConstantInt::get(x->getType(), 0);
+  return arith(llvm::Intrinsic::ssub_with_overflow, llvm::Instruction::Sub, zero, x);
+}
+
+
+// Signed division and remainder. The hardware traps on the
+// division of the least integer by -1, which wraps (or overflows,
+// if unbounded), so that divisor is computed separately.
+llvm::Value*
+Gen_fn::divide(Binary const* e, bool quot) const
+{
+  llvm::Value* x = gen(e->left());
+  llvm::Value* y = gen(e->right());
+  llvm::Type* t = y->getType();
+  llvm::Function* fn = b.GetInsertBlock()->getParent();
+
+  llvm::BasicBlock* ok = llvm::BasicBlock::Create(b.getContext(), "", fn);
+  b.CreateCondBr(b.CreateICmpEQ(y, llvm::ConstantInt::get(t, 0)), fail, ok);
+  b.SetInsertPoint(ok);
+
+  llvm::BasicBlock* neg = llvm::BasicBlock::Create(b.getContext(), "", fn);
+  llvm::BasicBlock* div = llvm::BasicBlock::Create(b.getContext(), "", fn);
+  llvm::BasicBlock* done = llvm::BasicBlock::Create(b.getContext(), "", fn);
+  b.CreateCondBr(b.CreateICmpEQ(y, llvm::ConstantInt::getSigned(t, -1)), neg, div);
+
+  b.SetInsertPoint(neg);
+  llvm::Value* r1 = quot ? this->neg(x) : llvm::ConstantInt::get(t, 0);
+  llvm::BasicBlock* from = b.GetInsertBlock();
+  b.CreateBr(done);
+
+  b.SetInsertPoint(div);
+  llvm::Value* r2 = quot ? b.CreateSDiv(x, y) : b.CreateSRem(x, y);
+  b.CreateBr(done);
+
+  b.SetInsertPoint(done);
+  llvm::PHINode* r = b.CreatePHI(t, 2);
+  r->addIncoming(r1, from);
+  r->addIncoming(r2, div);
+  return r;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                                   JIT
+
+// Owns the compiled functions. Each expression is compiled into its
+// own module and engine, so that compiling one never invalidates
+// another.
+struct Jit
+{
+  Jit()
+  {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+  }
+
+  Compiled_fn compile(Expr const*, int);
+
+  llvm::LLVMContext                                   cxt;
+  std::vector<std::unique_ptr<llvm::ExecutionEngine>> engines;
+  std::unordered_map<String, Compiled_fn>             cache;
+};
+
+
+// Generate the function
+//
+//    int f(int64_t* out)
+//
+// for e, whose integers have w bits, or are unbounded if w is 0.
+Compiled_fn
+Jit::compile(Expr const* e, int w)
+{
+  std::unique_ptr<llvm::Module> mod(new llvm::Module("calc", cxt));
+  llvm::Type* i32 = llvm::Type::getInt32Ty(cxt);
+  llvm::Type* i64 = llvm::Type::getInt64Ty(cxt);
+  llvm::FunctionType* type = llvm::FunctionType::get(i32, {i64->getPointerTo()}, false);
+  llvm::Function* fn = llvm::Function::Create(type, llvm::Function::ExternalLinkage, "calc", mod.get());
+
+  llvm::IRBuilder<> b(cxt);
+  llvm::BasicBlock* entry = llvm::BasicBlock::Create(cxt, "", fn);
+  llvm::BasicBlock* fail = llvm::BasicBlock::Create(cxt, "", fn);
+  llvm::BasicBlock* overflow = llvm::BasicBlock::Create(cxt, "", fn);
+  b.SetInsertPoint(fail);
+  b.CreateRet(b.getInt32(compiled_div_zero));
+  b.SetInsertPoint(overflow);
+  b.CreateRet(b.getInt32(compiled_overflow));
+
+  b.SetInsertPoint(entry);
+  llvm::Value* r = Gen_fn{b, w == Integer::unbounded, fail, overflow}.gen(e);
+  if (r->getType() != i64)
+    r = b.CreateSExt(r, i64);
+  b.CreateStore(r, &*fn->arg_begin());
+  b.CreateRet(b.getInt32(compiled_value));
+  lingo_assert(!llvm::verifyFunction(*fn));
+
+  std::string msg;
+  llvm::ExecutionEngine* eng = llvm::EngineBuilder(std::move(mod))
+    .setErrorStr(&msg)
+    .setEngineKind(llvm::EngineKind::JIT)
+    .create();
+  if (!eng)
+    throw std::runtime_error(msg);
+  engines.emplace_back(eng);
+  return reinterpret_cast<Compiled_fn>(eng->getFunctionAddress("calc"));
+}
+
+
+Jit&
+jit()
+{
+  static Jit j;
+  return j;
+}
+
+} // namespace
+
+
+// Returns a native function that computes the value of e, or
+// nullptr if e has integers wider than 64 bits, or of different
+// widths. Compiled functions are cached by the text of the
+// expression, so a formula is compiled only once.
+Compiled_fn
+compile(Expr const* e)
+{
+  int w = apply(e, Width_fn());
+  if (w < 0 || w > 64)
+    return nullptr;
+  String key = to_string(e);
+  Compiled_fn& fn = jit().cache[key];
+  if (!fn)
+    fn = jit().compile(e, w);
+  return fn;
+}
+
+
+// Compute the value of e by compiling it, storing the result in n.
+// Expressions that cannot be compiled, or whose unbounded values
+// overflow 64 bits, are evaluated. Returns false, after diagnosing
+// the error, if e divides by zero.
+bool
+compile_eval(Expr const* e, Integer& n)
+{
+  Compiled_fn fn = compile(e);
+  std::int64_t r;
+  int s = fn ? fn(&r) : compiled_overflow;
+  if (s == compiled_div_zero) {
+    error(e->span(), "division by zero");
+    return false;
+  }
+  if (s == compiled_overflow) {
+    n = evaluate(e);
+    return true;
+  }
+  int w = apply(e, Width_fn());
+  if (w == Integer::unbounded)
+    n = Integer(Integer::unbounded, r, true);
+  else
+    n = llvm::APInt(w, r, true);
+  return true;
+}
+
+
+} // namespace calc
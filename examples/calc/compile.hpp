@@ -0,0 +1,37 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef CALC_COMPILE_HPP
+#define CALC_COMPILE_HPP
+
+#include <lingo/integer.hpp>
+
+#include <cstdint>
+
+namespace calc
+{
+
+struct Expr;
+
+
+// The outcome of a compiled expression.
+enum Compiled_status
+{
+  compiled_value,    // The value was computed
+  compiled_div_zero, // The expression divides by zero
+  compiled_overflow  // An unbounded value does not fit in 64 bits
+};
+
+
+// A compiled expression. The function stores the value of the
+// expression in its argument, and returns a Compiled_status.
+using Compiled_fn = int (*)(std::int64_t*);
+
+
+Compiled_fn compile(Expr const*);
+bool        compile_eval(Expr const*, lingo::Integer&);
+
+
+} // namespace calc
+
+#endif
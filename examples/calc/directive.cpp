@@ -4,8 +4,11 @@
 #include "directive.hpp"
 
 #include "lingo/error.hpp"
+#include "lingo/profile.hpp"
+#include "lingo/statistics.hpp"
 
 #include <iostream>
+#include <sstream>
 
 namespace calc
 {
@@ -40,9 +43,9 @@ evaluation_mode(Evaluation_mode m)
 void
 process_directive(Buffer const& buf)
 {
-  String const& str = buf.str();
+  String str = buf.str();
   std::size_t end = str.find_first_of(' ');
-  String dir = str.substr(1, end);
+  String dir = str.substr(1, end - 1);
 
   // TODO: Use a hash table.
   if (dir == "step") {
@@ -51,6 +54,30 @@ process_directive(Buffer const& buf)
   } else if (dir == "eval") {
     mode_ = eval_mode;
     note("evaluation mode set to 'eval'");
+  } else if (dir == "compile") {
+    mode_ = compile_mode;
+    note("evaluation mode set to 'compile'");
+  } else if (dir == "parallel") {
+    mode_ = parallel_mode;
+    note("evaluation mode set to 'parallel'");
+  } else if (dir == "stats") {
+    std::cout << evaluation_stats();
+  } else if (dir == "profile") {
+    // Built with -DLINGO_PROFILE=ON, the time spent in each region.
+    report_profile(std::cout);
+  } else if (dir == "budget") {
+    // :budget steps [seconds], where 0 is unlimited.
+    Evaluation_budget b;
+    std::istringstream ss(end == String::npos ? String() : str.substr(end));
+    ss >> b.steps;
+    if (ss && !ss.eof() && !(ss >> std::ws).eof())
+      ss >> b.seconds;
+    if (!ss) {
+      error("invalid budget");
+    } else {
+      evaluation_budget() = b;
+      note("evaluation budget set to {} steps and {} seconds", b.steps, b.seconds);
+    }
   } else {
     error("unknown directive '{}'", dir);
   }
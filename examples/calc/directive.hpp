@@ -9,8 +9,10 @@ namespace calc
 // The evaluation mode.
 enum Evaluation_mode
 {
-  step_mode,  // Show each evaluation.
-  eval_mode,  // Just show the result.
+  step_mode,    // Show each evaluation.
+  eval_mode,    // Just show the result.
+  compile_mode, // Compile to native code, and show the result.
+  parallel_mode // Evaluate on several threads, and show the result.
 };
 
 
@@ -34,6 +36,22 @@ is_step_mode()
 }
 
 
+// Returns true if the interpreter is in compile mode.
+inline bool
+is_compile_mode()
+{
+  return evaluation_mode() == compile_mode;
+}
+
+
+// Returns true if the interpreter is in parallel mode.
+inline bool
+is_parallel_mode()
+{
+  return evaluation_mode() == parallel_mode;
+}
+
+
 void process_directive(lingo::Buffer const&);
 
 
@@ -42,7 +60,7 @@ void process_directive(lingo::Buffer const&);
 inline bool
 contains_directive(lingo::Buffer const& buf)
 {
-  return buf.str()[0] == ':';
+  return *buf.begin() == ':';
 }
 
 
@@ -4,6 +4,8 @@
 #include "lexer.hpp"
 
 #include "lingo/error.hpp"
+#include "lingo/profile.hpp"
+#include "lingo/reserved.hpp"
 
 #include <cassert>
 #include <cctype>
@@ -22,19 +24,37 @@ Symbol_table symbols;
 // -------------------------------------------------------------------------- //
 // Tokens
 
+namespace
+{
+
+// The reserved spellings of the language. Punctuators are
+// recognized by this table, not by the symbol table.
+constexpr Reserved spellings[] = {
+  {"(", lparen_tok},
+  {")", rparen_tok},
+  {"+", plus_tok},
+  {"-", minus_tok},
+  {"*", star_tok},
+  {"/", slash_tok},
+  {"%", percent_tok},
+};
+
+constexpr auto tokens = make_reserved_table(spellings);
+
+Reserved_symbols<tokens.size()> reserved(tokens);
+
+} // namespace
+
+
 char const*
 get_spelling(Token_kind k)
 {
+  if (char const* s = tokens.spelling(k))
+    return s;
   switch (k) {
     case error_tok: return "<error>";
-    case lparen_tok: return "(";
-    case rparen_tok: return ")";
-    case plus_tok: return "+";
-    case minus_tok: return "-";
-    case star_tok: return "*";
-    case slash_tok: return "/";
-    case percent_tok: return "%";
     case integer_tok: return "<integer>";
+    default: break;
   }
   lingo_unreachable();
 }
@@ -44,10 +64,13 @@ get_spelling(Token_kind k)
 // Lexing
 
 
+// Consume the current character as part of the lexeme. The
+// characters of a lexeme are not copied; they are viewed in
+// the input buffer when the token is formed.
 void
 Lexer::save()
 {
-  str_.put(cs_.get());
+  cs_.ignore();
 }
 
 
@@ -59,6 +82,7 @@ Lexer::scan()
     space();
 
     loc_ = cs_.location();
+    cs_.start();
     switch (cs_.peek()) {
     case '\0': return eof();
     case '(': return symbol1();
@@ -91,8 +115,7 @@ Lexer::error()
 void
 Lexer::space()
 {
-  while (is_space(cs_.peek()))
-    cs_.ignore();
+  cs_.skip_while(space_class);
 }
 
 
@@ -124,8 +147,7 @@ Lexer::integer()
 {
   assert(is_decimal_digit(cs_.peek()));
   digit();
-  while (is_decimal_digit(cs_.peek()))
-    digit();
+  cs_.skip_while(digit_class);
   return on_integer();
 }
 
@@ -133,7 +155,10 @@ Lexer::integer()
 Token
 Lexer::on_symbol()
 {
-  Symbol const* sym = symbols.get(str_.take());
+  String_view str = cs_.lexeme();
+  Symbol const* sym = reserved.get(str);
+  if (!sym)
+    sym = symbols.get(str);
   return Token(loc_, sym);
 }
 
@@ -141,9 +166,18 @@ Lexer::on_symbol()
 Token
 Lexer::on_integer()
 {
-  String str = str_.take();
-  int n = string_to_int<int>(str, 10);
-  Symbol* sym = symbols.put_integer(integer_tok, str, n);
+  String_view str = cs_.lexeme();
+  if (Symbol const* sym = symbols.get(str))
+    return Token(loc_, sym);
+
+  // Literals of up to 18 digits fit in 64 bits. Longer ones are
+  // converted by GMP.
+  Integer n;
+  if (str.size() <= 18)
+    n = Integer(Integer::unbounded, string_to_int<std::uint64_t>(str.begin(), str.end(), 10), true);
+  else
+    n = Integer(Integer::unbounded, str.str(), 10);
+  Symbol* sym = symbols.put<Literal_sym>(integer_tok, str, n);
   return Token(loc_, sym);
 }
 
@@ -151,6 +185,7 @@ Lexer::on_integer()
 void
 Lexer::operator()()
 {
+  lingo_profile("lex");
   while (Token tok = scan())
     ts_.put(tok);
 }
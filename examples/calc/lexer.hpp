@@ -8,10 +8,13 @@
 // language and the machine used to recognize those tokens
 // in input source.
 
+#include <lingo/integer.hpp>
 #include <lingo/symbol.hpp>
 #include <lingo/token.hpp>
 #include <lingo/character.hpp>
 
+#include <climits>
+
 namespace calc
 {
 
@@ -29,6 +32,26 @@ using namespace lingo;
 extern Symbol_table symbols;
 
 
+// An integer literal, whose value is unbounded. The value of the
+// Integer_sym is that of the literal if it fits in an int, and 0
+// otherwise.
+struct Literal_sym : Integer_sym
+{
+  Literal_sym(int k, Integer const& n)
+    : Integer_sym(k, fits_int(n) ? n.gets() : 0), value_(n)
+  { }
+
+  Integer const& integer() const { return value_; }
+
+  static bool fits_int(Integer const& n)
+  {
+    return !n.big() && INT_MIN <= n.gets() && n.gets() <= INT_MAX;
+  }
+
+  Integer value_;
+};
+
+
 // -------------------------------------------------------------------------- //
 // Tokens
 
@@ -86,7 +109,6 @@ struct Lexer
 
   Character_stream& cs_;
   Token_stream&     ts_;
-  String_builder    str_;
   Location          loc_;
 };
 
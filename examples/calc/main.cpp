@@ -6,11 +6,18 @@
 #include "ast.hpp"
 #include "directive.hpp"
 #include "step.hpp"
+#include "compile.hpp"
+#include "parallel.hpp"
 
 #include "lingo/error.hpp"
 #include "lingo/memory.hpp"
 #include "lingo/io.hpp"
+#include "lingo/statistics.hpp"
+#include "lingo/profile.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 
 
@@ -18,83 +25,219 @@ using namespace lingo;
 using namespace calc;
 
 
-// Initialize the token set used by the language.
+std::istream&
+prompt(std::string& line)
+{
+  std::cout << "> ";
+  return getline(std::cin, line);
+}
+
+
+// Evaluate the expression in the current evaluation mode, and write
+// its value. Each expression is evaluated within the budget set by
+// the :budget directive.
 void
-init_tokens()
+evaluate_expr(Expr const* expr)
 {
-  symbols.put_symbol(lparen_tok, "(");
-  symbols.put_symbol(rparen_tok, ")");
-  symbols.put_symbol(plus_tok, "+");
-  symbols.put_symbol(minus_tok, "-");
-  symbols.put_symbol(star_tok, "*");
-  symbols.put_symbol(slash_tok, "/");
+  Evaluation_guard guard;
+  lingo_profile("evaluate");
+  if (is_step_mode())
+    step_eval(expr);
+  else if (is_compile_mode()) {
+    Integer n;
+    if (compile_eval(expr, n))
+      std::cout << expr << " == " << n << '\n';
+    else
+      reset_diagnostics();
+  }
+  else {
+    // The value is computed before anything is written, since
+    // evaluation may fail.
+    Integer n = is_parallel_mode() ? evaluate_in_parallel(expr) : evaluate(expr);
+    std::cout << expr << " == " << n << '\n';
+  }
 }
 
 
-std::istream&
-prompt(std::string& line)
+// Lex, parse, and evaluate a line. After an error, the diagnostics
+// are reset so that the next line can be processed.
+void
+process_line(Lexer& lex, Parser& parse)
 {
-  std::cout << "> ";
-  return getline(std::cin, line);
+  try {
+    // Transform characters into tokens.
+    {
+      Phase_timer t(evaluation_stats().lex_time);
+      lex();
+    }
+    if (error_count()) {
+      reset_diagnostics();
+      return;
+    }
+
+    // Transform tokens into abstract syntax.
+    Expr const* expr;
+    {
+      Phase_timer t(evaluation_stats().parse_time);
+      expr = parse();
+    }
+    if (error_count()) {
+      reset_diagnostics();
+      return;
+    }
+
+    // This isn't an error. It's essentially an empty
+    // sequence of tokens.
+    if (expr)
+      evaluate_expr(expr);
+  }
+  catch (Parse_error& err) {
+    // Clear the diagnostic count and resume
+    // taking input and parsing.
+    reset_diagnostics();
+  }
+  catch (Budget_exceeded& err) {
+    error("{}", err.what());
+    reset_diagnostics();
+  }
+  catch (Division_by_zero& err) {
+    error(err.expr->span(), "division by zero");
+    reset_diagnostics();
+  }
+}
+
+
+// Process each line of a block of input. The character and token
+// streams, the lexer, and the parser are reset for each line rather
+// than constructed, and the nodes of each line are released after
+// it is evaluated. As in the interactive loop, the diagnostics of a
+// line are written when it has been processed.
+void
+process_block(Buffer& buf, Token_stream& ts, Parser& parse, Arena_factory& nodes)
+{
+  Character_stream cs(buf, buf.begin(), buf.begin());
+  Lexer lex(cs, ts);
+  char const* p = buf.begin();
+  while (p != buf.end()) {
+    char const* q = std::find(p, buf.end(), '\n');
+    if (q != p && *p == ':') {
+      Buffer dir(String(p, q));
+      process_directive(dir);
+      flush_diagnostics();
+      reset_diagnostics();
+    } else if (q != p) {
+      cs.reset(p, q);
+      ts.clear();
+      process_line(lex, parse);
+      flush_diagnostics();
+      nodes.reset();
+    }
+    p = q == buf.end() ? q : q + 1;
+  }
+}
+
+
+// Evaluate each line of the input without prompting. Input is read
+// in large blocks, and each block (less its last, incomplete line)
+// is processed as a single chunk, whose locations are the lines of
+// the input.
+void
+batch(std::istream& is)
+{
+  constexpr std::size_t block_size = 1 << 20;
+
+  Token_stream ts;
+  Parser parse(ts);
+  Arena_factory nodes;
+  Arena_scope scope(nodes);
+  String text;
+  std::size_t origin = 0;
+  int line = 1;
+  while (is) {
+    std::size_t n = text.size();
+    text.resize(n + block_size);
+    is.read(&text[n], block_size);
+    text.resize(n + is.gcount());
+
+    // Keep the last line for the next block, unless the input is
+    // exhausted. A line may be longer than a block.
+    std::size_t end = is ? text.rfind('\n') + 1 : text.size();
+    if (end == 0)
+      continue;
+    String rest(text, end);
+    text.resize(end);
+    int lines = std::count(text.begin(), text.end(), '\n');
+    {
+      Chunk buf(std::move(text), origin, {line, 1}, 0);
+      process_block(buf, ts, parse, nodes);
+    }
+    origin += end;
+    line += lines;
+    text = std::move(rest);
+  }
 }
 
 
 int
-main()
+main(int argc, char* argv[])
 {
   init_colors();
-  init_tokens();
 
   evaluation_mode(eval_mode);
+
+  // With --batch, the lines of the given file (or of the standard
+  // input) are evaluated without prompting, and output is block
+  // buffered.
+  if (argc > 1) {
+    if (std::strcmp(argv[1], "--batch") != 0 || argc > 3) {
+      std::cerr << "usage: calc [--batch [input-file]]\n";
+      return -1;
+    }
+    buffer_output();
+    if (argc == 3) {
+      std::ifstream f(argv[2]);
+      if (!f) {
+        std::cerr << "error: cannot open '" << argv[2] << "'\n";
+        return 1;
+      }
+      batch(f);
+    } else {
+      batch(std::cin);
+    }
+    return 0;
+  }
+
   std::string line;
   while (prompt(line)) {
     if (line.empty())
       continue;
 
-    // Construct a buffer for the line.
-    Buffer buf(line);
+    // Construct a buffer for the line. The line is moved
+    // into the buffer, since it is read anew each iteration.
+    Buffer buf(std::move(line));
+
+    // Nodes created while processing the line are released
+    // at the end of the iteration.
+    Arena_factory nodes;
+    Arena_scope scope(nodes);
 
     // If the input contains a directive, then process
-    // that and continue.
+    // that and continue. Errors in a directive do not affect
+    // the next line.
     if (contains_directive(buf)) {
       process_directive(buf);
+      flush_diagnostics();
+      reset_diagnostics();
       continue;
     }
 
-    try {
-      Character_stream cs(buf);
-      Token_stream ts(buf);
-      Lexer lex(cs, ts);
-      Parser parse(ts);
+    Character_stream cs(buf);
+    Token_stream ts;
+    Lexer lex(cs, ts);
+    Parser parse(ts);
+    process_line(lex, parse);
 
-      // Transform characters into tokens.
-      lex();
-      if (error_count()) {
-        reset_diagnostics();
-        continue;
-      }
-
-      // Transform tokens into abstract syntax.
-      Expr const* expr = parse();
-      if (error_count()) {
-        reset_diagnostics();
-        continue;
-      }
-
-      // This isn't an error. It's essentially an empty
-      // sequence of tokens.
-      if (!expr)
-        continue;
-
-      if (is_step_mode())
-        step_eval(expr);
-      else
-        std::cout << expr << " == " << evaluate(expr) << '\n';
-    }
-    catch (Parse_error& err) {
-      // Clear the diagnostic count and resume
-      // taking input and parsing.
-      reset_diagnostics();
-    }
+    // Diagnostics are written before the line is released.
+    flush_diagnostics();
   }
 }
@@ -0,0 +1,221 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "parallel.hpp"
+#include "ast.hpp"
+
+#include <lingo/statistics.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace calc
+{
+
+namespace
+{
+
+// The evaluation of an operand by another worker.
+struct Task
+{
+  Task(Expr const* e)
+    : expr(e), done(false)
+  { }
+
+  Expr const*        expr;
+  Integer            value;
+  std::exception_ptr error;
+  std::atomic<bool>  done;
+};
+
+
+// Each worker pushes and pops its tasks at the back of its deque,
+// and other workers steal from the front, where the oldest (and so
+// largest) tasks are.
+struct Worker
+{
+  std::mutex        mutex;
+  std::deque<Task*> tasks;
+};
+
+
+// A pool of workers evaluating one expression. The tasks of a
+// worker are operands of the binary expressions it is evaluating,
+// so they live on its stack.
+struct Pool
+{
+  Pool(std::size_t n)
+    : workers(new Worker[n]), size(n), finished(false)
+  { }
+
+  Integer eval(std::size_t, Expr const*);
+  Integer eval(std::size_t, Binary const*);
+  bool    steal(std::size_t);
+  void    run(std::size_t);
+
+  std::unique_ptr<Worker[]> workers;
+  std::size_t               size;
+  std::atomic<bool>         finished;
+};
+
+
+Integer
+combine(Expr const* e, Integer const& x, Integer const& y)
+{
+  switch (e->kind()) {
+    case Expr::add_expr: return x + y;
+    case Expr::sub_expr: return x - y;
+    case Expr::mul_expr: return x * y;
+    case Expr::div_expr: return x / y;
+    case Expr::mod_expr: return x % y;
+    default: lingo_unreachable();
+  }
+}
+
+
+// Evaluate e on worker i. Small expressions are evaluated directly.
+Integer
+Pool::eval(std::size_t i, Expr const* e)
+{
+  if (e->size() < parallel_grain)
+    return evaluate(e);
+  if (Binary const* b = as<Binary>(e))
+    return eval(i, b);
+  Unary const* u = cast<Unary>(e);
+  Integer n = eval(i, u->arg());
+  return is<Neg>(u) ? -n : n;
+}
+
+
+// Evaluate the left operand of e, leaving the right for another
+// worker to steal. If no worker has taken it when the left operand
+// has been evaluated, this worker evaluates it. Otherwise, this
+// worker helps with other tasks until it is done.
+Integer
+Pool::eval(std::size_t i, Binary const* e)
+{
+  Worker& w = workers[i];
+  Task t(e->right());
+  {
+    std::lock_guard<std::mutex> lock(w.mutex);
+    w.tasks.push_back(&t);
+  }
+
+  // Reclaims the task if it has not been stolen. Returns false
+  // if it has.
+  auto reclaim = [&]() {
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (w.tasks.empty() || w.tasks.back() != &t)
+      return false;
+    w.tasks.pop_back();
+    return true;
+  };
+
+  // Waits for a stolen task to finish.
+  auto wait = [&]() {
+    while (!t.done.load(std::memory_order_acquire))
+      if (!steal(i))
+        std::this_thread::yield();
+  };
+
+  Integer x;
+  try {
+    x = eval(i, e->left());
+  } catch (...) {
+    if (!reclaim())
+      wait();
+    throw;
+  }
+  if (reclaim())
+    return combine(e, x, eval(i, t.expr));
+  wait();
+  if (t.error)
+    std::rethrow_exception(t.error);
+  return combine(e, x, t.value);
+}
+
+
+// Take the oldest task of another worker and evaluate it on worker
+// i. Returns false if there was none.
+bool
+Pool::steal(std::size_t i)
+{
+  for (std::size_t j = 1; j < size; ++j) {
+    Worker& v = workers[(i + j) % size];
+    Task* t = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(v.mutex);
+      if (!v.tasks.empty()) {
+        t = v.tasks.front();
+        v.tasks.pop_front();
+      }
+    }
+    if (t) {
+      try {
+        t->value = eval(i, t->expr);
+      } catch (...) {
+        t->error = std::current_exception();
+      }
+      t->done.store(true, std::memory_order_release);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// Steal tasks until the evaluation is finished.
+void
+Pool::run(std::size_t i)
+{
+  while (!finished.load(std::memory_order_acquire))
+    if (!steal(i))
+      std::this_thread::yield();
+}
+
+} // namespace
+
+
+// Evaluate e using n threads, or the number of hardware threads if
+// n is 0. The operands of large binary expressions are evaluated in
+// parallel; the result is that of evaluate. The steps of the workers
+// are charged to the current evaluation, and counted by this thread.
+Integer
+evaluate_in_parallel(Expr const* e, std::size_t n)
+{
+  if (n == 0)
+    n = std::max(1u, std::thread::hardware_concurrency());
+  if (n == 1 || e->size() < parallel_grain)
+    return evaluate(e);
+
+  Shared_evaluation shared;
+  Pool pool(n);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < n; ++i)
+    threads.emplace_back([&pool, &shared, i]() {
+      Shared_evaluation_guard guard(shared);
+      pool.run(i);
+    });
+  Integer r;
+  std::exception_ptr error;
+  try {
+    r = pool.eval(0, e);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  pool.finished = true;
+  for (std::thread& t : threads)
+    t.join();
+  if (error)
+    std::rethrow_exception(error);
+  return r;
+}
+
+
+} // namespace calc
@@ -0,0 +1,27 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef CALC_PARALLEL_HPP
+#define CALC_PARALLEL_HPP
+
+#include <lingo/integer.hpp>
+
+#include <cstddef>
+
+namespace calc
+{
+
+struct Expr;
+
+
+// Expressions with fewer terms than this are evaluated by a
+// single thread.
+constexpr std::size_t parallel_grain = 4096;
+
+
+lingo::Integer evaluate_in_parallel(Expr const*, std::size_t = 0);
+
+
+} // namespace calc
+
+#endif
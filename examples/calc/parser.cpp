@@ -6,6 +6,7 @@
 #include "ast.hpp"
 
 #include "lingo/error.hpp"
+#include "lingo/profile.hpp"
 
 #include <iostream>
 
@@ -32,6 +33,35 @@ token_spelling(Token_stream& ts)
 } // namespace
 
 
+// Precedences of the operators.
+enum
+{
+  additive_prec = 1,
+  multiplicative_prec,
+  unary_prec,
+};
+
+
+// Initialize the parser and its operator table.
+Parser::Parser(Token_stream& ts)
+  : ts_(ts)
+{
+  auto unary = [this](Token tok, Expr const* e) {
+    return on_unary(tok, e);
+  };
+  auto binary = [this](Token tok, Expr const* e1, Expr const* e2) {
+    return on_binary(tok, e1, e2);
+  };
+  ops_.prefix(plus_tok, unary_prec, unary);
+  ops_.prefix(minus_tok, unary_prec, unary);
+  ops_.binary(star_tok, multiplicative_prec, left_assoc, binary);
+  ops_.binary(slash_tok, multiplicative_prec, left_assoc, binary);
+  ops_.binary(percent_tok, multiplicative_prec, left_assoc, binary);
+  ops_.binary(plus_tok, additive_prec, left_assoc, binary);
+  ops_.binary(minus_tok, additive_prec, left_assoc, binary);
+}
+
+
 // Returns the first token of lookahead.
 Token_kind
 Parser::lookahead() const
@@ -54,10 +84,9 @@ Parser::match(Token_kind k)
   if (lookahead() == k)
     return ts_.get();
 
-  String msg = format("expected '{}' but got '{}'",
-                      get_spelling(k),
-                      token_spelling(ts_));
-  error(ts_.location(), msg);
+  error(ts_.location(), "expected '{}' but got '{}'",
+        get_spelling(k),
+        token_spelling(ts_));
   throw Parse_error("match");
 }
 
@@ -130,74 +159,24 @@ Parser::primary()
 }
 
 
-// Parse a unary epxression. A unary expressions is one
-// that begins with an operator and is followed by a
-// unary expression.
+// Parse a unary or binary expression. This is the top-level
+// entry point for the precedence parser.
 //
 //    unary-expression ::=
 //        primary-expression
 //      | unary-operator unary-expression.
-Expr const*
-Parser::unary()
-{
-  if (Token tok = match_if(plus_tok))
-    return on_unary(tok, unary());
-  if (Token tok = match_if(minus_tok))
-    return on_unary(tok, unary());
-  return primary();
-}
-
-
-// Parse a multiplicative expression.
 //
 //    multiplicative-expression ::=
 //        unary-expression
 //      | multiplicative-expression multiplicative-operator unary-expression
-Expr const*
-Parser::multiplicative()
-{
-  Expr const* e = unary();
-  while (true) {
-    if (Token tok = match_if(star_tok))
-      e = on_binary(tok, e, unary());
-    else if (Token tok = match_if(slash_tok))
-      e = on_binary(tok, e, unary());
-    else if (Token tok = match_if(percent_tok))
-      e = on_binary(tok, e, unary());
-    else
-      break;
-  }
-  return e;
-}
-
-
-// Parse an additive expression.
 //
 //    additive-expression ::=
 //        multiplicative-expression
 //      | additive-expression additive-operator multiplicative-expression
-Expr const*
-Parser::additive()
-{
-  Expr const* e = multiplicative();
-  while (true) {
-    if (Token tok = match_if(plus_tok))
-      e = on_binary(tok, e, multiplicative());
-    else if (Token tok = match_if(minus_tok))
-      e = on_binary(tok, e, multiplicative());
-    else
-      break;
-  }
-  return e;
-}
-
-
-// Parse a binary expression. This is the top-level entry point
-// for the binary precedence parser.
 inline Expr const*
 Parser::binary()
 {
-  return additive();
+  return ops_.parse(ts_, [this]() { return primary(); });
 }
 
 
@@ -215,7 +194,7 @@ Parser::expr()
 Expr const*
 Parser::on_int(Token tok)
 {
-  return new Int(tok.location(), tok.integer_symbol()->value());
+  return make<Int>(tok.location(), cast<Literal_sym>(tok.symbol())->integer());
 }
 
 
@@ -224,8 +203,8 @@ Parser::on_unary(Token tok, Expr const* e)
 {
   Location loc = tok.location();
   switch (tok.kind()) {
-    case plus_tok: return new Pos(loc, e);
-    case minus_tok: return new Neg(loc, e);
+    case plus_tok: return make<Pos>(loc, e);
+    case minus_tok: return make<Neg>(loc, e);
     default: break;
   }
   lingo_unreachable("invalid unary operator", tok.spelling());
@@ -237,11 +216,11 @@ Parser::on_binary(Token tok, Expr const* e1, Expr const* e2)
 {
   Location loc = tok.location();
   switch (tok.kind()) {
-    case plus_tok: return new Add(loc, e1, e2);
-    case minus_tok: return new Sub(loc, e1, e2);
-    case star_tok: return new Mul(loc, e1, e2);
-    case slash_tok: return new Div(loc, e1, e2);
-    case percent_tok: return new Mod(loc, e1, e2);
+    case plus_tok: return make<Add>(loc, e1, e2);
+    case minus_tok: return make<Sub>(loc, e1, e2);
+    case star_tok: return make<Mul>(loc, e1, e2);
+    case slash_tok: return make<Div>(loc, e1, e2);
+    case percent_tok: return make<Mod>(loc, e1, e2);
     default: break;
   }
   lingo_unreachable("invalid binary operator '{}'", tok.spelling());
@@ -251,6 +230,7 @@ Parser::on_binary(Token tok, Expr const* e1, Expr const* e2)
 Expr const*
 Parser::operator()()
 {
+  lingo_profile("parse");
   if (ts_.eof())
     return nullptr;
   return expr();
@@ -259,9 +239,9 @@ Parser::operator()()
 
 // Parse the given buffer.
 Expr const*
-parse(String const& str)
+parse(String str)
 {
-  Buffer buf(str);
+  Buffer buf(std::move(str));
   Character_stream cs(buf);
   Token_stream ts(buf);
   Lexer lex(cs, ts);
@@ -269,6 +249,7 @@ parse(String const& str)
 
   // Lex.
   lex();
+  flush_diagnostics();
   if (error_count()) {
     reset_diagnostics();
     return make_error_node<Expr>();
@@ -276,6 +257,7 @@ parse(String const& str)
 
   // Parse.
   Expr const* expr = parse();
+  flush_diagnostics();
   if (error_count()) {
     reset_diagnostics();
     return make_error_node<Expr>();
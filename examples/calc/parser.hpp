@@ -6,6 +6,8 @@
 
 #include "lexer.hpp"
 
+#include <lingo/precedence.hpp>
+
 namespace calc
 {
 
@@ -25,19 +27,17 @@ struct Parse_error : std::runtime_error
 // The parser is responsible for transforming a stream of tokens
 // into nodes. The parser owns a reference to the buffer for its
 // tokens. This supports the resolution of source code locations.
+//
+// Unary and binary expressions are parsed by a precedence
+// parser whose table holds the operators of the language.
 struct Parser
 {
-  Parser(Token_stream& ts)
-    : ts_(ts)
-  { }
+  Parser(Token_stream& ts);
 
   Expr const* operator()();
 
   Expr const* paren();
   Expr const* primary();
-  Expr const* unary();
-  Expr const* multiplicative();
-  Expr const* additive();
   Expr const* binary();
   Expr const* expr();
 
@@ -52,11 +52,12 @@ struct Parser
   Token      require(Token_kind);
   Token      accept();
 
-  Token_stream& ts_;
+  Token_stream&            ts_;
+  Precedence_parser<Expr> ops_;
 };
 
 
-Expr const* parse(String const&);
+Expr const* parse(String);
 
 
 } // namespace calc
@@ -3,11 +3,12 @@
 
 #include "step.hpp"
 #include "ast.hpp"
-#include "parser.hpp"
 
+#include <lingo/buffer.hpp>
 #include <lingo/error.hpp>
 
 #include <iostream>
+#include <sstream>
 
 namespace calc
 {
@@ -25,10 +26,10 @@ step_binary(T const* e)
   Expr const* e1 = e->left();
   Expr const* e2 = e->right();
   if (!is<Int>(e1))
-    return new T(loc, step(e1), e2);
+    return make<T>(loc, step(e1), e2);
   if (!is<Int>(e2))
-    return new T(loc, e1, step(e2));
-  return new Int(loc, evaluate(e));
+    return make<T>(loc, e1, step(e2));
+  return make<Int>(loc, evaluate(e));
 }
 
 
@@ -40,8 +41,8 @@ step_unary(T const* e)
   Location loc = e->location();
   Expr const* e0 = e->arg();
   if (!is<Int>(e0))
-    return new T(loc, step(e0));
-  return new Int(loc, evaluate(e));
+    return make<T>(loc, step(e0));
+  return make<Int>(loc, evaluate(e));
 }
 
 
@@ -119,20 +120,30 @@ next(Expr const* e)
 
 // Iterate through the evaluation of the expression, showing
 // which expressions are being evaluated.
+//
+// Each step prints the expression into a new buffer, finding the
+// text of the subexpression being evaluated as it goes, so that
+// diagnostics refer to the printed form. Only the path to the
+// evaluated subexpression is rebuilt by each step.
 Expr const*
 step_eval(Expr const* e)
 {
-  do {
-    // Reparse the input so that source locations line
-    // up in each printing.
-    e = parse(to_string(e));
-
-    // Select the sub-expression being evaluated.
-    note(next(e)->span(), "evaluating");
+  while (!is<Int>(e)) {
+    Expr const* s = next(e);
+    std::stringstream ss;
+    int first;
+    int last;
+    print(ss, e, s, first, last);
+    Buffer buf(ss.str());
+
+    // Select the sub-expression being evaluated. The note refers
+    // to buf, so it is written before buf is destroyed.
+    note(Region(&buf, first, last), "evaluating");
+    flush_diagnostics();
 
     // Perform that evaluation.
     e = step(e);
-  } while (!is<Int>(e));
+  }
   std::cout << *e << '\n';
   return e;
 }
@@ -6,11 +6,28 @@
 #include "lingo/memory.hpp"
 #include "lingo/error.hpp"
 
+#include <atomic>
 #include <iostream>
+#include <stdexcept>
 
 namespace calc
 {
 
+// -------------------------------------------------------------------------- //
+//                               Term scopes
+
+thread_local Term_scope* Term_scope::current_ = nullptr;
+
+
+// Returns a new index for the tables of a type of term.
+std::size_t
+Term_scope::next_index()
+{
+  static std::atomic<std::size_t> n(0);
+  return n++;
+}
+
+
 void
 print(std::ostream& os, Var const* e)
 {
@@ -78,4 +95,79 @@ operator<<(std::ostream& os, Expr const& e)
 }
 
 
+// -------------------------------------------------------------------------- //
+//                                Tree files
+
+namespace
+{
+
+Symbol const*
+read_name(Node_reader& r)
+{
+  Symbol const* s = r.read_symbol();
+  if (!s)
+    throw std::runtime_error("malformed tree file");
+  return s;
+}
+
+} // namespace
+
+
+void
+save_node_data(Node_writer& w, Var const* e)
+{
+  w.write_symbol(e->name());
+}
+
+
+void
+save_node_data(Node_writer& w, Ref const* e)
+{
+  w.write_symbol(e->name());
+}
+
+
+// Variables are distinct binders, so each is a new node.
+Var const*
+load_node(Node_reader& r, Var const*)
+{
+  return make<Var>(read_name(r));
+}
+
+
+Ref const*
+load_node(Node_reader& r, Ref const*)
+{
+  return cons<Ref>(read_name(r));
+}
+
+
+Def const*
+load_node(Node_reader&, Def const*, Var const* v, Expr const* e)
+{
+  return cons<Def>(v, e);
+}
+
+
+Abs const*
+load_node(Node_reader&, Abs const*, Var const* v, Expr const* e)
+{
+  return cons<Abs>(v, e);
+}
+
+
+App const*
+load_node(Node_reader&, App const*, Expr const* e1, Expr const* e2)
+{
+  return cons<App>(e1, e2);
+}
+
+
+Seq const*
+load_node(Node_reader&, Seq const*, Expr const* e1, Expr const* e2)
+{
+  return cons<Seq>(e1, e2);
+}
+
+
 } // namespace calc
@@ -4,10 +4,18 @@
 #ifndef CALC_AST_HPP
 #define CALC_AST_HPP
 
+#include "lingo/dispatch.hpp"
 #include "lingo/integer.hpp"
+#include "lingo/memory.hpp"
 #include "lingo/node.hpp"
 #include "lingo/token.hpp"
 #include "lingo/print.hpp"
+#include "lingo/serialize.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace calc
 {
@@ -22,6 +30,17 @@ struct App;
 struct Seq;
 struct Visitor;
 
+
+// Returns the bit of the variable v in the summary of the variables
+// referenced by a term (see Expr::vars). Addresses are mixed by a
+// multiplicative hash, so that nearby variables set different bits.
+inline std::uint64_t
+var_bit(Var const* v)
+{
+  std::uint64_t n = reinterpret_cast<std::uintptr_t>(v);
+  return std::uint64_t(1) << ((n * 0x9e3779b97f4a7c15ull) >> 58);
+}
+
 // -------------------------------------------------------------------------- //
 //                                   Nodes
 
@@ -34,14 +53,27 @@ struct Visitor;
 //          \x.e    -- abstractions
 //          e1 e2   -- applications
 //          e1 ; e2 -- sequences
+//
+// The kind of each term is stored with it, so that is, as, and
+// cast can test its dynamic type with an integer comparison.
 struct Expr
 {
-  Expr()
-    : loc_()
+  enum Kind
+  {
+    var_expr,
+    ref_expr,
+    def_expr,
+    abs_expr,
+    app_expr,
+    seq_expr
+  };
+
+  Expr(Kind k)
+    : kind_(k), loc_(), vars_()
   { }
 
-  Expr(Location l)
-    : loc_(l)
+  Expr(Kind k, Location l)
+    : kind_(k), loc_(l), vars_()
   { }
 
   virtual ~Expr()
@@ -49,10 +81,19 @@ struct Expr
 
   virtual void accept(Visitor&) const = 0;
 
+  Kind         kind() const     { return kind_; }
   Location     location() const { return loc_; }
   virtual Span span() const     { return {loc_, loc_}; }
 
-  Location loc_;
+  // Returns a summary of the variables referenced in the term: the
+  // union of their bits. This includes variables bound within the
+  // term. A term whose summary shares no bits with that of a set of
+  // variables references none of them.
+  std::uint64_t vars() const { return vars_; }
+
+  Kind          kind_;
+  Location      loc_;
+  std::uint64_t vars_;
 };
 
 
@@ -72,9 +113,13 @@ struct Visitor
 struct Var : Expr
 {
   Var(Symbol const* n)
-    : name_(n)
+    : Expr(var_expr), name_(n)
   { }
 
+  static constexpr Kind node_kind = var_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
+
   void accept(Visitor& v) const { return v.visit(this); }
 
   Symbol const* name() const { return name_; }
@@ -87,12 +132,18 @@ struct Var : Expr
 struct Ref : Expr
 {
   Ref(Symbol const* s)
-    : name_(s), var_(nullptr)
+    : Expr(ref_expr), name_(s), var_(nullptr)
   { }
 
   Ref(Symbol const* s, Var const* v)
-    : name_(s), var_(v)
-  { }
+    : Expr(ref_expr), name_(s), var_(v)
+  {
+    vars_ = v ? var_bit(v) : 0;
+  }
+
+  static constexpr Kind node_kind = ref_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { return v.visit(this); }
 
@@ -108,8 +159,14 @@ struct Ref : Expr
 struct Def : Expr
 {
   Def(Var const* v, Expr const* e)
-    : first(v), second(e)
-  { }
+    : Expr(def_expr), first(v), second(e)
+  {
+    vars_ = e->vars();
+  }
+
+  static constexpr Kind node_kind = def_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { return v.visit(this); }
 
@@ -125,8 +182,14 @@ struct Def : Expr
 struct Abs : Expr
 {
   Abs(Var const* v, Expr const* e)
-    : first(v), second(e)
-  { }
+    : Expr(abs_expr), first(v), second(e)
+  {
+    vars_ = e->vars();
+  }
+
+  static constexpr Kind node_kind = abs_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { return v.visit(this); }
 
@@ -142,8 +205,14 @@ struct Abs : Expr
 struct App : Expr
 {
   App(Expr const* e1, Expr const* e2)
-    : first(e1), second(e2)
-  { }
+    : Expr(app_expr), first(e1), second(e2)
+  {
+    vars_ = e1->vars() | e2->vars();
+  }
+
+  static constexpr Kind node_kind = app_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { return v.visit(this); }
 
@@ -159,8 +228,14 @@ struct App : Expr
 struct Seq : Expr
 {
   Seq(Expr const* e1, Expr const* e2)
-    : first(e1), second(e2)
-  { }
+    : Expr(seq_expr), first(e1), second(e2)
+  {
+    vars_ = e1->vars() | e2->vars();
+  }
+
+  static constexpr Kind node_kind = seq_expr;
+
+  static bool classof(Expr const* e) { return e->kind() == node_kind; }
 
   void accept(Visitor& v) const { return v.visit(this); }
 
@@ -173,38 +248,218 @@ struct Seq : Expr
 
 
 // -------------------------------------------------------------------------- //
-//                                Generic visitor
-
-// A parameterized visitor that dispatches to a function
-// object. F is the type of the function and T is its
-// return type.
-//
-// This class is never used directly. It is used only in
-// the apply function below.
-template<typename F, typename T>
-struct Basic_visitor : Visitor, Generic_visitor<F, T>
-{
-  Basic_visitor(F f)
-    : Generic_visitor<F, T>(f)
-  { }
+//                                  Dispatch
 
-  void visit(Var const* e) { this->invoke(e); }
-  void visit(Ref const* e) { this->invoke(e); }
-  void visit(Def const* e) { this->invoke(e); }
-  void visit(Abs const* e) { this->invoke(e); }
-  void visit(App const* e) { this->invoke(e); }
-  void visit(Seq const* e) { this->invoke(e); }
-};
+// The concrete expressions, for dispatch.
+using Expr_nodes = Node_list<Var, Ref, Def, Abs, App, Seq>;
 
 
-// Apply the function f to the type t.
+// Apply the function f to the expression e, switching on its kind.
 // The return type is that of the function object F.
 template<typename F, typename T = typename std::result_of<F(Var const*)>::type>
 inline T
 apply(Expr const* e, F fn)
 {
-  Basic_visitor<F, T> v(fn);
-  return accept(e, v);
+  return dispatch<Expr_nodes, Expr, F, T>(e, fn);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                                 Allocation
+
+// Allocate a node in the current arena. Nodes are released when
+// the arena scope in which they were created ends.
+template<typename T, typename... Args>
+inline T*
+make(Args&&... args)
+{
+  return Arena_scope::current().make<T>(std::forward<Args>(args)...);
+}
+
+
+} // namespace calc
+
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                                Hash-consing
+
+// References are the same when they have the same name and refer
+// to the same variable.
+template<>
+struct Node_hash<calc::Ref>
+{
+  std::size_t operator()(calc::Ref const& e) const
+  {
+    return hash_combine(std::hash<Symbol const*>()(e.name_), std::hash<calc::Var const*>()(e.var_));
+  }
+};
+
+
+template<>
+struct Node_equal<calc::Ref>
+{
+  bool operator()(calc::Ref const& a, calc::Ref const& b) const
+  {
+    return a.name_ == b.name_ && a.var_ == b.var_;
+  }
+};
+
+} // namespace lingo
+
+
+namespace calc
+{
+
+// Returns the factory of unique terms of type T that are made
+// outside of any term scope. These terms live until the program
+// ends, and are shared by all threads.
+template<typename T>
+inline Hashed_unique_factory<T>&
+term_factory()
+{
+  static Hashed_unique_factory<T> f;
+  return f;
+}
+
+
+// Returns the mutex guarding the factory of unique terms of type T,
+// so that files can be parsed by several threads.
+template<typename T>
+inline std::mutex&
+term_mutex()
+{
+  static std::mutex m;
+  return m;
+}
+
+
+// A term scope holds the unique terms, and the nodes, made by its
+// thread while it is the innermost scope. They are released when
+// the scope ends. A term is found in the enclosing scopes, and in
+// the factories outside of any scope, before it is made, so equal
+// terms have the same address for as long as they are live. Terms
+// made in a scope must not be used after it ends.
+//
+//    {
+//      Term_scope scope;
+//      ... // Terms made here are released at the end of the block
+//    }
+class Term_scope
+{
+public:
+  Term_scope()
+    : prev_(current_), scope_(nodes_)
+  {
+    current_ = this;
+  }
+
+  ~Term_scope() { current_ = prev_; }
+
+  Term_scope(Term_scope const&) = delete;
+  Term_scope& operator=(Term_scope const&) = delete;
+
+  template<typename T>
+  Hashed_unique_factory<T>* find() const;
+
+  template<typename T>
+  Hashed_unique_factory<T>& get();
+
+  Term_scope* enclosing() const { return prev_; }
+
+  // Returns the innermost scope of this thread, or null.
+  static Term_scope* current() { return current_; }
+
+private:
+  struct Table
+  {
+    virtual ~Table() { }
+  };
+
+  template<typename T>
+  struct Table_of : Table
+  {
+    Hashed_unique_factory<T> terms;
+  };
+
+  static std::size_t next_index();
+
+  template<typename T>
+  static std::size_t index();
+
+  Term_scope*                         prev_;
+  Arena_factory                       nodes_;
+  Arena_scope                         scope_;
+  std::vector<std::unique_ptr<Table>> tables_;
+
+  static thread_local Term_scope* current_;
+};
+
+
+// Returns the index of the table of terms of type T.
+template<typename T>
+inline std::size_t
+Term_scope::index()
+{
+  static std::size_t const n = next_index();
+  return n;
+}
+
+
+// Returns the table of terms of type T, or null if no such term
+// has been made in this scope.
+template<typename T>
+inline Hashed_unique_factory<T>*
+Term_scope::find() const
+{
+  std::size_t n = index<T>();
+  if (n < tables_.size() && tables_[n])
+    return &static_cast<Table_of<T>*>(tables_[n].get())->terms;
+  return nullptr;
+}
+
+
+// Returns the table of terms of type T, creating it if needed.
+template<typename T>
+inline Hashed_unique_factory<T>&
+Term_scope::get()
+{
+  std::size_t n = index<T>();
+  if (n >= tables_.size())
+    tables_.resize(n + 1);
+  if (!tables_[n])
+    tables_[n].reset(new Table_of<T>());
+  return static_cast<Table_of<T>*>(tables_[n].get())->terms;
+}
+
+
+// Returns the unique term of type T constructed from args.
+// Structurally identical terms are created once, so terms can be
+// compared by address. Sub-terms are compared by address, so they
+// must also be unique, except for variables, which are distinct
+// binders. The term is made in the current term scope, if any.
+template<typename T, typename... Args>
+inline T const*
+cons(Args&&... args)
+{
+  Term_scope* s = Term_scope::current();
+  if (!s) {
+    std::lock_guard<std::mutex> lock(term_mutex<T>());
+    return term_factory<T>().make(std::forward<Args>(args)...);
+  }
+  T t(std::forward<Args>(args)...);
+  for (Term_scope* p = s->enclosing(); p; p = p->enclosing())
+    if (Hashed_unique_factory<T>* f = p->find<T>())
+      if (T* x = f->find(t))
+        return x;
+  {
+    std::lock_guard<std::mutex> lock(term_mutex<T>());
+    if (T* x = term_factory<T>().find(t))
+      return x;
+  }
+  return s->get<T>().make(std::move(t));
 }
 
 
@@ -221,6 +476,25 @@ void print(std::ostream&, Seq const*);
 
 std::ostream& operator<<(std::ostream&, Expr const&);
 
+
+// -------------------------------------------------------------------------- //
+//                                Tree files
+//
+// Variables and references are saved as their names (see
+// lingo/serialize.hpp). Loaded references are unbound, so a loaded
+// program must be bound again (see bind_names). Other terms are
+// unique when they are loaded.
+
+void save_node_data(Node_writer&, Var const*);
+void save_node_data(Node_writer&, Ref const*);
+
+Var const* load_node(Node_reader&, Var const*);
+Ref const* load_node(Node_reader&, Ref const*);
+Def const* load_node(Node_reader&, Def const*, Var const*, Expr const*);
+Abs const* load_node(Node_reader&, Abs const*, Var const*, Expr const*);
+App const* load_node(Node_reader&, App const*, Expr const*, Expr const*);
+Seq const* load_node(Node_reader&, Seq const*, Expr const*, Expr const*);
+
 } // namespace calc
 
 #endif
@@ -0,0 +1,367 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "bytecode.hpp"
+#include "substitution.hpp"
+
+#include <lingo/statistics.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace calc
+{
+
+// -------------------------------------------------------------------------- //
+//                                Compilation
+
+namespace
+{
+
+// A variable that is not bound by any enclosing function.
+constexpr int unbound = -2;
+
+
+struct Compiler
+{
+  std::uint32_t term(Expr const* e)
+  {
+    prog.terms.push_back(e);
+    return prog.terms.size() - 1;
+  }
+
+  std::uint32_t global(Var const* v)
+  {
+    auto ins = globals.emplace(v, prog.globals.size());
+    if (ins.second)
+      prog.globals.push_back(v);
+    return ins.first->second;
+  }
+
+  int  resolve(Function*, Var const*);
+  void compile(Function*, Expr const*, bool);
+
+  Program&                                    prog;
+  std::unordered_map<Var const*, std::uint32_t> globals;
+};
+
+
+// Returns where the function f finds the variable v: its argument,
+// or a captured value. If v is bound by an enclosing function, it is
+// added to the captures of f. Returns unbound if no enclosing
+// function binds v.
+int
+Compiler::resolve(Function* f, Var const* v)
+{
+  if (!f->abs)
+    return unbound;
+  if (f->abs->var() == v)
+    return arg_slot;
+  for (std::size_t i = 0; i < f->captures.size(); ++i)
+    if (f->captures[i] == v)
+      return i;
+  int s = resolve(f->parent, v);
+  if (s == unbound)
+    return unbound;
+  f->captures.push_back(v);
+  f->sources.push_back(s);
+  return f->captures.size() - 1;
+}
+
+
+// Append the code for e to the function f. If tail is true, e is
+// the last expression evaluated by f, so an application replaces
+// the current call.
+void
+Compiler::compile(Function* f, Expr const* e, bool tail)
+{
+  std::vector<std::uint32_t>& code = f->code;
+  switch (e->kind()) {
+    case Expr::var_expr:
+      code.insert(code.end(), {op_term, term(e)});
+      break;
+
+    case Expr::ref_expr: {
+      Ref const* r = cast<Ref>(e);
+      int s = r->var() ? resolve(f, r->var()) : unbound;
+      if (s == arg_slot)
+        code.push_back(op_arg);
+      else if (s >= 0)
+        code.insert(code.end(), {op_env, std::uint32_t(s)});
+      else if (r->var())
+        code.insert(code.end(), {op_global, global(r->var()), term(e)});
+      else
+        code.insert(code.end(), {op_term, term(e)});
+      break;
+    }
+
+    // The evaluator binds a definition to its expression, which is
+    // evaluated, in an empty environment, by each reference. The
+    // expression is compiled as a function with no parameter (a
+    // thunk), called by op_global. The closure of an abstraction
+    // is the same for each reference, so it is created once.
+    case Expr::def_expr: {
+      Def const* d = cast<Def>(e);
+      prog.fns.emplace_back(new Function(nullptr, nullptr));
+      Function* t = prog.fns.back().get();
+      std::uint32_t n = prog.fns.size() - 1;
+      compile(t, d->expr(), true);
+      if (is<Abs>(d->expr())) {
+        code.insert(code.end(), t->code.begin(), t->code.end());
+      } else {
+        t->code.push_back(op_return);
+        code.insert(code.end(), {op_closure, n});
+      }
+      code.insert(code.end(), {op_define, global(d->var()), op_null});
+      break;
+    }
+
+    case Expr::abs_expr: {
+      Abs const* a = cast<Abs>(e);
+      prog.fns.emplace_back(new Function(a, f));
+      Function* g = prog.fns.back().get();
+      std::uint32_t n = prog.fns.size() - 1;
+      compile(g, a->expr(), true);
+      g->code.push_back(op_return);
+      code.insert(code.end(), {op_closure, n});
+      break;
+    }
+
+    case Expr::app_expr: {
+      App const* a = cast<App>(e);
+      compile(f, a->fn(), false);
+      compile(f, a->arg(), false);
+      code.insert(code.end(), {tail ? op_tail_call : op_call, term(e)});
+      break;
+    }
+
+    // Sequences nest to the left. The value of each operand but
+    // the last is printed.
+    case Expr::seq_expr: {
+      std::vector<Expr const*> rest;
+      while (Seq const* s = as<Seq>(e)) {
+        rest.push_back(s->right());
+        e = s->left();
+      }
+      compile(f, e, false);
+      code.push_back(op_print);
+      for (std::size_t i = rest.size() - 1; i != 0; --i) {
+        compile(f, rest[i], false);
+        code.push_back(op_print);
+      }
+      compile(f, rest[0], tail);
+      break;
+    }
+  }
+}
+
+} // namespace
+
+
+// Compile the program e.
+Program
+compile(Expr const* e)
+{
+  Program prog;
+  std::unique_ptr<Function> main(new Function(nullptr, nullptr));
+  Compiler c {prog, {}};
+  c.compile(main.get(), e, false);
+  main->code.push_back(op_halt);
+  prog.fns.push_back(std::move(main));
+  return prog;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                              Virtual machine
+
+// Returns a closure of f. Its captured values are found in the
+// argument and closure of the current call.
+Vm::Closure const*
+Vm::make_closure(Function const* f, Value arg, Closure const* env)
+{
+  std::size_t n = f->captures.size();
+  count_allocation();
+  void* p = closures_.allocate(sizeof(Closure) + n * sizeof(Value), alignof(Closure));
+  Closure* c = new (p) Closure {f};
+  Value* vs = const_cast<Value*>(c->values());
+  for (std::size_t i = 0; i < n; ++i) {
+    int s = f->sources[i];
+    vs[i] = s == arg_slot ? arg : env->values()[s];
+  }
+  return c;
+}
+
+
+// Run the program p, and return its result.
+//
+// Where the compiler supports computed goto (a GNU extension, also
+// implemented by Clang), instructions are dispatched by jumping
+// directly from the end of each to the code for the next (threaded
+// code), which avoids the shared branch of a switch. Otherwise, each
+// instruction returns to a switch.
+Expr const*
+Vm::operator()(Program const& p)
+{
+  // A suspended call.
+  struct Frame
+  {
+    std::uint32_t const* pc;
+    Closure const*       env;
+    Value                arg;
+  };
+
+  Evaluation_guard guard;
+  globals_.assign(p.globals.size(), Value {nullptr, nullptr});
+  defined_.assign(p.globals.size(), false);
+
+  std::vector<Value> stack;
+  std::vector<Frame> calls;
+  std::uint32_t const* pc = p.main()->code.data();
+  Closure const* env = nullptr;
+  Value arg {nullptr, nullptr};
+
+#if defined(__GNUC__)
+  static void* const labels[] = {
+    &&do_arg, &&do_env, &&do_global, &&do_term, &&do_null, &&do_closure,
+    &&do_call, &&do_tail_call, &&do_return, &&do_define, &&do_print, &&do_halt
+  };
+
+#define next() goto *labels[*pc++]
+
+  next();
+#else
+#define next() goto dispatch
+
+dispatch:
+  switch (*pc++) {
+    case op_arg:       goto do_arg;
+    case op_env:       goto do_env;
+    case op_global:    goto do_global;
+    case op_term:      goto do_term;
+    case op_null:      goto do_null;
+    case op_closure:   goto do_closure;
+    case op_call:      goto do_call;
+    case op_tail_call: goto do_tail_call;
+    case op_return:    goto do_return;
+    case op_define:    goto do_define;
+    case op_print:     goto do_print;
+    case op_halt:      goto do_halt;
+  }
+  lingo_unreachable("invalid instruction");
+#endif
+
+do_arg:
+  stack.push_back(arg);
+  next();
+
+do_env:
+  stack.push_back(env->values()[*pc++]);
+  next();
+
+do_global: {
+  std::uint32_t g = *pc++;
+  std::uint32_t t = *pc++;
+  if (!defined_[g]) {
+    stack.push_back({p.terms[t], nullptr});
+    next();
+  }
+  Value v = globals_[g];
+  if (v.clo && !v.clo->fn->abs) {
+    calls.push_back({pc, env, arg});
+    env = v.clo;
+    arg = {nullptr, nullptr};
+    pc = v.clo->fn->code.data();
+    next();
+  }
+  stack.push_back(v);
+  next();
+}
+
+do_term:
+  stack.push_back({p.terms[*pc++], nullptr});
+  next();
+
+do_null:
+  stack.push_back({nullptr, nullptr});
+  next();
+
+do_closure: {
+  Function const* f = p.fns[*pc++].get();
+  stack.push_back({nullptr, make_closure(f, arg, env)});
+  next();
+}
+
+do_call:
+  calls.push_back({pc + 1, env, arg});
+  // Fall through.
+
+do_tail_call: {
+  Value x = stack.back();
+  stack.pop_back();
+  Value f = stack.back();
+  stack.pop_back();
+  if (!f.clo) {
+    App const* a = cast<App>(p.terms[*pc]);
+    String msg = format("application of non-abstraction '{}'", *a->fn());
+    throw std::runtime_error(msg);
+  }
+  count_reduction();
+  env = f.clo;
+  arg = x;
+  pc = f.clo->fn->code.data();
+  next();
+}
+
+do_return: {
+  Frame const& f = calls.back();
+  pc = f.pc;
+  env = f.env;
+  arg = f.arg;
+  calls.pop_back();
+  next();
+}
+
+do_define: {
+  std::uint32_t g = *pc++;
+  globals_[g] = stack.back();
+  defined_[g] = true;
+  stack.pop_back();
+  next();
+}
+
+do_print:
+  {
+    // Terms made to print the value are released once it is printed.
+    // The scope ends before the jump to the next instruction, which
+    // would not destroy it.
+    Term_scope scope;
+    if (Expr const* r = reify(stack.back()))
+      std::cout << *r << '\n';
+  }
+  stack.pop_back();
+  next();
+
+do_halt:
+#undef next
+  return reify(stack.back());
+}
+
+
+// Returns the term denoted by v. The captured values of a closure
+// are substituted into its abstraction.
+Expr const*
+Vm::reify(Value v)
+{
+  if (!v.clo)
+    return v.term;
+  Function const* f = v.clo->fn;
+  Substitution subst;
+  for (std::size_t i = 0; i < f->captures.size(); ++i)
+    subst.emplace(f->captures[i], reify(v.clo->values()[i]));
+  return subst(f->abs);
+}
+
+
+} // namespace calc
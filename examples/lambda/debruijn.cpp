@@ -0,0 +1,336 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "debruijn.hpp"
+
+#include <lingo/environment.hpp>
+#include <lingo/statistics.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace calc
+{
+
+// -------------------------------------------------------------------------- //
+//                                 Lowering
+
+namespace
+{
+
+// Maps the variables bound by the abstractions that enclose the
+// expression being lowered to the depth of their binders. The
+// index of a reference is the number of binders between it and
+// its own, so lowering is linear in the size of the expression.
+using Scope = Scoped_environment<Var const*, int>;
+
+
+Term const*
+lower(Expr const* e, Value_map const* defs, Scope& scope)
+{
+  switch (e->kind()) {
+    case Expr::ref_expr: {
+      Ref const* r = cast<Ref>(e);
+      if (auto const* b = scope.lookup(r->var()))
+        return cons<Index_term>(int(scope.depth()) - b->second - 1);
+      if (defs && r->var()) {
+        if (Value_binding const* b = defs->lookup(r->var())) {
+          Scope inner;
+          return lower(b->second, defs, inner);
+        }
+      }
+      return cons<Free_term>(r);
+    }
+
+    case Expr::abs_expr: {
+      Abs const* a = cast<Abs>(e);
+      scope.push_scope();
+      scope.bind(a->var(), scope.depth() - 1);
+      Term const* t = lower(a->expr(), defs, scope);
+      scope.pop_scope();
+      return cons<Abs_term>(t);
+    }
+
+    case Expr::app_expr: {
+      App const* a = cast<App>(e);
+      Term const* t1 = lower(a->fn(), defs, scope);
+      Term const* t2 = lower(a->arg(), defs, scope);
+      return cons<App_term>(t1, t2);
+    }
+
+    default:
+      break;
+  }
+  String msg = format("cannot lower '{}'", *e);
+  throw std::runtime_error(msg);
+}
+
+} // namespace
+
+
+// Returns the nameless form of e. References to variables that are
+// defined in defs are replaced by the nameless form of their
+// definitions. Other references to variables that are not bound in
+// e are free.
+//
+// Only abstractions, applications, and references can be lowered.
+// Throws std::runtime_error if e contains a definition or sequence.
+Term const*
+lower(Expr const* e, Value_map const* defs)
+{
+  Scope scope;
+  return lower(e, defs, scope);
+}
+
+
+// Returns true if a and b differ only in the names of their bound
+// variables.
+bool
+alpha_equivalent(Expr const* a, Expr const* b)
+{
+  return lower(a) == lower(b);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                               Substitution
+//
+// Each operation returns a term unchanged when none of its free
+// indices are affected, without traversing it.
+
+
+// Add d to each index in t that is free above the cutoff c, i.e.,
+// that is not bound within the c innermost binders.
+Term const*
+shift(Term const* t, int d, int c)
+{
+  if (t->free_bound() <= c)
+    return t;
+  switch (t->kind()) {
+    case Term::index_term:
+      return cons<Index_term>(cast<Index_term>(t)->index() + d);
+    case Term::abs_term:
+      return cons<Abs_term>(shift(cast<Abs_term>(t)->body(), d, c + 1));
+    case Term::app_term: {
+      App_term const* a = cast<App_term>(t);
+      return cons<App_term>(shift(a->fn(), d, c), shift(a->arg(), d, c));
+    }
+    default:
+      return t;
+  }
+}
+
+
+namespace
+{
+
+// Replace the index j + c in t, where c is the number of binders
+// entered, with s shifted over those binders.
+Term const*
+subst(Term const* t, int j, Term const* s, int c)
+{
+  if (t->free_bound() <= j + c)
+    return t;
+  switch (t->kind()) {
+    case Term::index_term:
+      return cast<Index_term>(t)->index() == j + c ? shift(s, c) : t;
+    case Term::abs_term:
+      return cons<Abs_term>(subst(cast<Abs_term>(t)->body(), j, s, c + 1));
+    case Term::app_term: {
+      App_term const* a = cast<App_term>(t);
+      return cons<App_term>(subst(a->fn(), j, s, c), subst(a->arg(), j, s, c));
+    }
+    default:
+      return t;
+  }
+}
+
+
+// Replace the index c in t with s shifted over c binders, and
+// lower the indices above it by one. This is the body of a
+// beta reduction, where c is the number of binders entered.
+Term const*
+instantiate(Term const* t, Term const* s, int c)
+{
+  if (t->free_bound() <= c)
+    return t;
+  switch (t->kind()) {
+    case Term::index_term: {
+      int n = cast<Index_term>(t)->index();
+      return n == c ? shift(s, c) : cons<Index_term>(n - 1);
+    }
+    case Term::abs_term:
+      return cons<Abs_term>(instantiate(cast<Abs_term>(t)->body(), s, c + 1));
+    case Term::app_term: {
+      App_term const* a = cast<App_term>(t);
+      return cons<App_term>(instantiate(a->fn(), s, c), instantiate(a->arg(), s, c));
+    }
+    default:
+      return t;
+  }
+}
+
+} // namespace
+
+
+// Replace the index j in t with s.
+//
+//    [j->s]j = s
+//    [j->s]k = k for all k != j
+//    [j->s]\.t = \.[j+1 -> shift(s, 1)]t
+Term const*
+subst(Term const* t, int j, Term const* s)
+{
+  return subst(t, j, s, 0);
+}
+
+
+// Apply the abstraction t to s.
+//
+//    (\.t) s -> shift([0 -> shift(s, 1)]t, -1)
+Term const*
+beta(Abs_term const* t, Term const* s)
+{
+  return instantiate(t->body(), s, 0);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                                Evaluation
+
+// Evaluate t to a value, in the order of the evaluator: the function
+// of an application is evaluated, then its argument, and then the
+// body of the function with the argument substituted.
+Term const*
+eval(Term const* t)
+{
+  while (App_term const* a = as<App_term>(t)) {
+    Abs_term const* fn = as<Abs_term>(eval(a->fn()));
+    if (!fn) {
+      String msg = format("application of non-abstraction '{}'", *a->fn());
+      throw std::runtime_error(msg);
+    }
+    Term const* arg = eval(a->arg());
+    count_reduction();
+    t = beta(fn, arg);
+  }
+  return t;
+}
+
+
+namespace
+{
+
+// Reduce t to weak head normal form, in normal order.
+Term const*
+whnf(Term const* t)
+{
+  while (App_term const* a = as<App_term>(t)) {
+    Term const* f = whnf(a->fn());
+    Abs_term const* fn = as<Abs_term>(f);
+    if (!fn)
+      return f == a->fn() ? t : cons<App_term>(f, a->arg());
+    count_reduction();
+    t = beta(fn, a->arg());
+  }
+  return t;
+}
+
+
+// The normal forms of terms.
+using Normal_forms = std::unordered_map<Term const*, Term const*>;
+
+
+// Returns the normal form of t. The normal forms of the sub-terms
+// of t are saved in the cache.
+Term const*
+normalize(Term const* t, Normal_forms& cache)
+{
+  auto iter = cache.find(t);
+  if (iter != cache.end())
+    return iter->second;
+
+  Term const* r = whnf(t);
+  if (Abs_term const* a = as<Abs_term>(r))
+    r = cons<Abs_term>(normalize(a->body(), cache));
+  else if (App_term const* a = as<App_term>(r))
+    r = cons<App_term>(normalize(a->fn(), cache), normalize(a->arg(), cache));
+  cache.emplace(t, r);
+  return r;
+}
+
+} // namespace
+
+
+// Returns the beta normal form of t, reducing in normal order. This
+// does not terminate if t has no normal form. Because terms are
+// unique, the normal form of each sub-term is computed once. Terms
+// may be released by a term scope, so the normal forms are not kept
+// after t is normalized.
+Term const*
+normalize(Term const* t)
+{
+  Normal_forms cache;
+  return normalize(t, cache);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                               Normalizer
+
+// The items of a program are a left-nested sequence.
+Term const*
+Normalizer::operator()(Expr const* e)
+{
+  Evaluation_guard guard;
+  std::vector<Expr const*> items;
+  while (Seq const* s = as<Seq>(e)) {
+    items.push_back(s->right());
+    e = s->left();
+  }
+  items.push_back(e);
+
+  for (std::size_t i = items.size(); i != 1; --i) {
+    Term_scope scope;
+    if (Term const* t = item(items[i - 1]))
+      std::cout << *t << '\n';
+  }
+  return item(items[0]);
+}
+
+
+// Returns the normal form of the item e, or null if e is a
+// definition.
+Term const*
+Normalizer::item(Expr const* e)
+{
+  if (Def const* d = as<Def>(e)) {
+    defs_.bind(d->var(), d->expr());
+    return nullptr;
+  }
+  return normalize(lower(e, &defs_));
+}
+
+
+// -------------------------------------------------------------------------- //
+//                                 Printing
+
+std::ostream&
+operator<<(std::ostream& os, Term const& t)
+{
+  struct Fn
+  {
+    std::ostream& os;
+    void operator()(Index_term const* t) { os << t->index(); }
+    void operator()(Free_term const* t)  { os << *t->ref()->name(); }
+    void operator()(Abs_term const* t)   { os << "\\." << *t->body(); }
+    void operator()(App_term const* t)   { os << '(' << *t->fn() << ' ' << *t->arg() << ')'; }
+  };
+  apply(&t, Fn{os});
+  return os;
+}
+
+
+} // namespace calc
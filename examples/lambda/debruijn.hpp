@@ -0,0 +1,175 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef CALC_DEBRUIJN_HPP
+#define CALC_DEBRUIJN_HPP
+
+#include "ast.hpp"
+#include "evaluator.hpp"
+
+#include <algorithm>
+#include <iosfwd>
+
+namespace calc
+{
+
+// -------------------------------------------------------------------------- //
+//                                  Terms
+
+// A term is the nameless (de Bruijn) form of an expression. A bound
+// variable is replaced by its index: the number of abstractions
+// between the reference and its binder. The set of terms is:
+//
+//    t ::= n       -- indices
+//          x       -- free references
+//          \.t     -- abstractions
+//          t1 t2   -- applications
+//
+// Terms are unique (see cons), so alpha-equivalent expressions lower
+// to the same term, and can be compared by address.
+//
+// Each term records the number of the enclosing binders to which it
+// refers, so that shifting and substitution can skip closed subterms.
+struct Term
+{
+  enum Kind
+  {
+    index_term,
+    free_term,
+    abs_term,
+    app_term
+  };
+
+  Term(Kind k, int n)
+    : kind_(k), free_(n)
+  { }
+
+  Kind kind() const { return kind_; }
+
+  // Returns 1 + the greatest index that is free in the term, or 0
+  // if the term is closed.
+  int free_bound() const { return free_; }
+
+  Kind kind_;
+  int  free_;
+};
+
+
+// The index of a bound variable.
+struct Index_term : Term
+{
+  Index_term(int n)
+    : Term(index_term, n + 1), first(n)
+  { }
+
+  static constexpr Kind node_kind = index_term;
+
+  static bool classof(Term const* t) { return t->kind() == node_kind; }
+
+  int index() const { return first; }
+
+  int first;
+};
+
+
+// A reference to a variable that is not bound in the term.
+struct Free_term : Term
+{
+  Free_term(Ref const* r)
+    : Term(free_term, 0), first(r)
+  { }
+
+  static constexpr Kind node_kind = free_term;
+
+  static bool classof(Term const* t) { return t->kind() == node_kind; }
+
+  Ref const* ref() const { return first; }
+
+  Ref const* first;
+};
+
+
+// An abstraction. Its variable has index 0 in its body.
+struct Abs_term : Term
+{
+  Abs_term(Term const* t)
+    : Term(abs_term, std::max(t->free_bound() - 1, 0)), first(t)
+  { }
+
+  static constexpr Kind node_kind = abs_term;
+
+  static bool classof(Term const* t) { return t->kind() == node_kind; }
+
+  Term const* body() const { return first; }
+
+  Term const* first;
+};
+
+
+// The application of a term to an argument.
+struct App_term : Term
+{
+  App_term(Term const* t1, Term const* t2)
+    : Term(app_term, std::max(t1->free_bound(), t2->free_bound())), first(t1), second(t2)
+  { }
+
+  static constexpr Kind node_kind = app_term;
+
+  static bool classof(Term const* t) { return t->kind() == node_kind; }
+
+  Term const* fn() const  { return first; }
+  Term const* arg() const { return second; }
+
+  Term const* first;
+  Term const* second;
+};
+
+
+// The concrete terms, for dispatch.
+using Term_nodes = Node_list<Index_term, Free_term, Abs_term, App_term>;
+
+
+// Apply the function f to the term t, switching on its kind.
+template<typename F, typename T = typename std::result_of<F(Index_term const*)>::type>
+inline T
+apply(Term const* t, F fn)
+{
+  return dispatch<Term_nodes, Term, F, T>(t, fn);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                                Operations
+
+Term const* lower(Expr const*, Value_map const* = nullptr);
+bool        alpha_equivalent(Expr const*, Expr const*);
+
+Term const* shift(Term const*, int, int = 0);
+Term const* subst(Term const*, int, Term const*);
+Term const* beta(Abs_term const*, Term const*);
+
+Term const* eval(Term const*);
+Term const* normalize(Term const*);
+
+std::ostream& operator<<(std::ostream&, Term const&);
+
+
+// -------------------------------------------------------------------------- //
+//                               Normalizer
+
+// The normalizer reduces each item of a program to its beta normal
+// form, as a term. Definitions are expanded where they are
+// referenced. The normal form of each item but the last is printed,
+// and that of the last is returned. Definitions have no normal form.
+struct Normalizer
+{
+  Term const* operator()(Expr const*);
+  Term const* item(Expr const*);
+
+  Value_map defs_;
+};
+
+
+} // namespace calc
+
+#endif
@@ -4,8 +4,11 @@
 #include "evaluator.hpp"
 #include "substitution.hpp"
 
+#include <lingo/statistics.hpp>
+
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 namespace calc
 {
@@ -13,13 +16,26 @@ namespace calc
 Expr const*
 Evaluator::operator()(Expr const* e)
 {
+  Evaluation_guard guard;
   return eval(e);
 }
 
 
+// Evaluate e. Applications and sequences end by evaluating another
+// expression. Rather than recursing, the evaluator continues with
+// that expression, so tail positions run in constant stack space.
 Expr const*
 Evaluator::eval(Expr const* e)
 {
+  while (true) {
+    if (App const* a = as<App>(e))
+      e = step(a);
+    else if (Seq const* s = as<Seq>(e))
+      e = step(s);
+    else
+      break;
+  }
+
   struct Fn
   {
     Evaluator& eval;
@@ -62,7 +78,10 @@ Evaluator::eval(Ref const* e)
 }
 
 
-// Evaluating a definition does not produce a value.
+// Evaluating a definition does not produce a value. Note
+// that definitions are never created by substitution, so the
+// bound expression is a term of the program, which outlives the
+// scope in which the definition is evaluated.
 //
 // FIXME: This should produce result \x.x, which could
 // be interpreted as the unit value.
@@ -93,6 +112,16 @@ Evaluator::eval(Abs const* e)
 //    \x:T.t t2 ->* [x->v]t
 Expr const*
 Evaluator::eval(App const* e)
+{
+  return eval(step(e));
+}
+
+
+// Returns the expression to which the application e reduces:
+// the body of its function with the value of its argument
+// substituted.
+Expr const*
+Evaluator::step(App const* e)
 {
   Abs const* fn = as<Abs>(eval(e->fn()));
   if (!fn) {
@@ -102,13 +131,11 @@ Evaluator::eval(App const* e)
   Expr const* arg = eval(e->arg());
 
   // Sbustitute the argument into the abstraction.
+  count_reduction();
   Substitution subst {
     {fn->var(), arg}
   };
-  Expr const* result = subst(fn->expr());
-
-  // And recursively evaluate.
-  return eval(result);
+  return subst(fn->expr());
 }
 
 
@@ -121,16 +148,38 @@ Evaluator::eval(App const* e)
 //       S |- e2 ->* v
 //    ------------------- E-seq-2
 //    v ; e2 ->* v
-//
-// Note that the result of the left operand
-// is discarded.
 Expr const*
 Evaluator::eval(Seq const* e)
 {
-  // Print the result of the left operand (if it's not null).
-  if (Expr const* v = eval(e->left()))
-    std::cout << *v << '\n';
-  return eval(e->right());
+  return eval(step(e));
+}
+
+
+// Evaluate and print all but the last of the operands of the
+// sequence e, and return the last. Sequences nest to the left,
+// so the sequence is flattened first.
+//
+// Note that the result of each operand is discarded. Terms and
+// nodes created while evaluating it are released once it has been
+// printed (see Term_scope).
+Expr const*
+Evaluator::step(Seq const* e)
+{
+  std::vector<Expr const*> rest;
+  Expr const* first = e;
+  while (Seq const* s = as<Seq>(first)) {
+    rest.push_back(s->right());
+    first = s->left();
+  }
+  rest.push_back(first);
+
+  // Print the result of each operand (if it's not null).
+  for (std::size_t i = rest.size() - 1; i != 0; --i) {
+    Term_scope scope;
+    if (Expr const* v = eval(rest[i]))
+      std::cout << *v << '\n';
+  }
+  return rest[0];
 }
 
 
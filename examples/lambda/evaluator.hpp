@@ -36,6 +36,9 @@ struct Evaluator
   Expr const* eval(App const*);
   Expr const* eval(Seq const*);
 
+  Expr const* step(App const*);
+  Expr const* step(Seq const*);
+
   Value_map defs_;
 };
 
@@ -4,6 +4,8 @@
 #include "lexer.hpp"
 
 #include <lingo/error.hpp>
+#include <lingo/profile.hpp>
+#include <lingo/reserved.hpp>
 
 #include <cassert>
 #include <cctype>
@@ -22,18 +24,36 @@ Symbol_table symbols;
 // -------------------------------------------------------------------------- //
 // Tokens
 
+namespace
+{
+
+// The reserved spellings of the language. Punctuators are
+// recognized by this table, not by the symbol table.
+constexpr Reserved spellings[] = {
+  {"(", lparen_tok},
+  {")", rparen_tok},
+  {"\\", backslash_tok},
+  {".", dot_tok},
+  {"=", equal_tok},
+  {";", semicolon_tok},
+};
+
+constexpr auto tokens = make_reserved_table(spellings);
+
+Reserved_symbols<tokens.size()> reserved(tokens);
+
+} // namespace
+
+
 char const*
 get_spelling(Token_kind k)
 {
+  if (char const* s = tokens.spelling(k))
+    return s;
   switch (k) {
     case error_tok: return "<error>";
-    case lparen_tok: return "(";
-    case rparen_tok: return ")";
-    case backslash_tok: return "\\";
-    case dot_tok: return ".";
-    case equal_tok: return "=";
-    case semicolon_tok: return ";";
     case identifier_tok: return "<identifier>";
+    default: break;
   }
   lingo_unreachable();
 }
@@ -43,10 +63,13 @@ get_spelling(Token_kind k)
 // Lexing
 
 
+// Consume the current character as part of the lexeme. The
+// characters of a lexeme are not copied; they are viewed in
+// the input buffer when the token is formed.
 void
 Lexer::save()
 {
-  str_.put(cs_.get());
+  cs_.ignore();
 }
 
 
@@ -58,6 +81,7 @@ Lexer::scan()
     space();
 
     loc_ = cs_.location();
+    cs_.start();
     switch (cs_.peek()) {
     case '\0': return eof();
     case '(': return symbol1();
@@ -89,8 +113,7 @@ Lexer::error()
 void
 Lexer::space()
 {
-  while (is_space(cs_.peek()))
-    cs_.ignore();
+  cs_.skip_while(space_class);
 }
 
 
@@ -121,8 +144,7 @@ Token
 Lexer::identifier()
 {
   letter();
-  while (is_alpha(cs_.peek()))
-    letter();
+  cs_.skip_while(alpha_class);
   return on_identifier();
 }
 
@@ -130,7 +152,10 @@ Lexer::identifier()
 Token
 Lexer::on_symbol()
 {
-  Symbol const* sym = symbols.get(str_.take());
+  String_view str = cs_.lexeme();
+  Symbol const* sym = reserved.get(str);
+  if (!sym)
+    sym = symbols.get(str);
   return Token(loc_, sym);
 }
 
@@ -138,8 +163,7 @@ Lexer::on_symbol()
 Token
 Lexer::on_identifier()
 {
-  String str = str_.take();
-  Symbol* sym = symbols.put_identifier(identifier_tok, str);
+  Symbol* sym = symbols.put_identifier(identifier_tok, cs_.lexeme());
   return Token(loc_, sym);
 }
 
@@ -147,6 +171,7 @@ Lexer::on_identifier()
 void
 Lexer::operator()()
 {
+  lingo_profile("lex");
   while (Token tok = scan())
     ts_.put(tok);
 }
@@ -85,7 +85,6 @@ struct Lexer
 
   Character_stream& cs_;
   Token_stream&     ts_;
-  String_builder    str_;
   Location          loc_;
 };
 
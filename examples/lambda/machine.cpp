@@ -0,0 +1,188 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "machine.hpp"
+#include "substitution.hpp"
+
+#include <lingo/statistics.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace calc
+{
+
+// The items of a program are a left-nested sequence. They are
+// evaluated in order, and the environments created by each are
+// released once its value has been reified. The terms of each item
+// but the last are released once its value has been printed.
+Expr const*
+Machine::operator()(Expr const* e)
+{
+  Evaluation_guard guard;
+  std::vector<Expr const*> items;
+  while (Seq const* s = as<Seq>(e)) {
+    items.push_back(s->right());
+    e = s->left();
+  }
+  items.push_back(e);
+  std::reverse(items.begin(), items.end());
+
+  for (std::size_t i = 0; i + 1 < items.size(); ++i) {
+    Term_scope scope;
+    stack_.clear();
+    Expr const* r = reify(run(items[i], nullptr));
+    envs_.reset();
+    if (r)
+      std::cout << *r << '\n';
+  }
+  stack_.clear();
+  Expr const* result = reify(run(items.back(), nullptr));
+  envs_.reset();
+  return result;
+}
+
+
+// Evaluate e in the environment env.
+//
+// A reference to a variable bound in env evaluates to its value.
+// A reference to a definition evaluates the defined expression.
+// Abstractions evaluate to closures. Applications evaluate their
+// function and then their argument, and then the body of the
+// function in its environment, extended with the argument. If the
+// machine is lazy, the argument is evaluated when it is first
+// referenced.
+Machine::Value
+Machine::run(Expr const* e, Env const* env)
+{
+  std::size_t base = stack_.size();
+  Value v {nullptr, nullptr};
+  while (true) {
+    // Reduce e until it is a value.
+    if (e) {
+      switch (e->kind()) {
+        case Expr::var_expr:
+          v = {e, nullptr};
+          break;
+
+        case Expr::ref_expr: {
+          Ref const* r = cast<Ref>(e);
+          Env const* p = env;
+          while (p && p->var != r->var())
+            p = p->next;
+          if (p && !p->ready) {
+            stack_.push_back({Frame::update_frame, nullptr, p, {}});
+            e = p->value.term;
+            env = p->value.env;
+            continue;
+          }
+          if (p) {
+            v = p->value;
+            break;
+          }
+          if (r->var()) {
+            if (Value_binding const* b = defs_.lookup(r->var())) {
+              e = b->second;
+              env = nullptr;
+              continue;
+            }
+          }
+          v = {e, nullptr};
+          break;
+        }
+
+        case Expr::def_expr: {
+          Def const* d = cast<Def>(e);
+          defs_.bind(d->var(), d->expr());
+          v = {nullptr, nullptr};
+          break;
+        }
+
+        case Expr::abs_expr:
+          v = {e, env};
+          break;
+
+        case Expr::app_expr:
+          stack_.push_back({Frame::arg_frame, e, env, {}});
+          e = cast<App>(e)->fn();
+          continue;
+
+        case Expr::seq_expr:
+          stack_.push_back({Frame::seq_frame, e, env, {}});
+          e = cast<Seq>(e)->left();
+          continue;
+      }
+      e = nullptr;
+      continue;
+    }
+
+    // Give the value to the innermost frame.
+    if (stack_.size() == base)
+      return v;
+    Frame f = stack_.back();
+    stack_.pop_back();
+    switch (f.kind) {
+      case Frame::arg_frame: {
+        App const* a = cast<App>(f.term);
+        if (!v.term || !is<Abs>(v.term)) {
+          String msg = format("application of non-abstraction '{}'", *a->fn());
+          throw std::runtime_error(msg);
+        }
+        if (lazy_) {
+          Abs const* fn = cast<Abs>(v.term);
+          count_reduction();
+          count_allocation();
+          env = envs_.make<Env>(Env {fn->var(), {a->arg(), f.env}, v.env, false});
+          e = fn->expr();
+          break;
+        }
+        stack_.push_back({Frame::call_frame, a, nullptr, v});
+        e = a->arg();
+        env = f.env;
+        break;
+      }
+
+      case Frame::call_frame: {
+        Abs const* fn = cast<Abs>(f.fn.term);
+        count_reduction();
+        count_allocation();
+        env = envs_.make<Env>(Env {fn->var(), v, f.fn.env, true});
+        e = fn->expr();
+        break;
+      }
+
+      // The environment of the frame is the forced binding.
+      case Frame::update_frame:
+        f.env->value = v;
+        f.env->ready = true;
+        break;
+
+      case Frame::seq_frame:
+        if (Expr const* r = reify(v))
+          std::cout << *r << '\n';
+        e = cast<Seq>(f.term)->right();
+        env = f.env;
+        break;
+    }
+  }
+}
+
+
+// Returns the term denoted by v. The values of the variables in
+// its environment are substituted into its term. Inner bindings
+// hide outer bindings of the same variable.
+Expr const*
+Machine::reify(Value v)
+{
+  if (!v.env)
+    return v.term;
+  Substitution subst;
+  for (Env const* p = v.env; p; p = p->next)
+    if (!subst.count(p->var))
+      subst.emplace(p->var, reify(p->value));
+  return subst(v.term);
+}
+
+
+} // namespace calc
@@ -0,0 +1,94 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef CALC_MACHINE_HPP
+#define CALC_MACHINE_HPP
+
+#include "ast.hpp"
+#include "evaluator.hpp"
+
+#include <vector>
+
+namespace calc
+{
+
+
+// The machine is an alternative to the evaluator that never
+// rewrites terms. It is a CEK machine: the value of an abstraction
+// is a closure that pairs it with the environment in which it was
+// evaluated, and an application binds the variable of the closure
+// to its argument in that environment. The rest of the computation
+// is kept on an explicit stack of frames, so deeply nested
+// applications do not exhaust the call stack.
+//
+// The order of evaluation, and the results, are those of the
+// evaluator. A closure is converted back to a term, by substituting
+// the values in its environment, only when it is printed or
+// returned.
+//
+// If the machine is lazy, arguments are passed by need: an
+// application binds the variable of the closure to a thunk, its
+// argument and environment, which is evaluated when the variable
+// is first referenced, and then replaced by its value. Arguments
+// that are never referenced are never evaluated, and those that
+// are referenced many times are evaluated once.
+struct Machine
+{
+  struct Env;
+
+  // A value is an abstraction and its environment, or a term that
+  // cannot be reduced (e.g., an unbound reference). The term is
+  // null for definitions, which have no value.
+  struct Value
+  {
+    Expr const* term;
+    Env const*  env;
+  };
+
+  // A binding of a variable to a value, and the bindings of the
+  // enclosing environment. If the binding is not ready, its value
+  // is a thunk, which is updated when it is forced.
+  struct Env
+  {
+    Var const*    var;
+    mutable Value value;
+    Env const*    next;
+    mutable bool  ready;
+  };
+
+  // The remainder of a computation, waiting for a value.
+  struct Frame
+  {
+    enum Kind
+    {
+      arg_frame,  // Evaluate the argument of an application
+      call_frame, // Call the evaluated function
+      seq_frame,  // Print the value, and evaluate the right operand
+      update_frame // Replace the thunk of a binding by the value
+    };
+
+    Kind        kind;
+    Expr const* term;
+    Env const*  env;
+    Value       fn;
+  };
+
+  explicit Machine(bool lazy = false)
+    : lazy_(lazy)
+  { }
+
+  Expr const* operator()(Expr const*);
+
+  Value       run(Expr const*, Env const*);
+  Expr const* reify(Value);
+
+  bool               lazy_;
+  Value_map          defs_;
+  Arena_factory      envs_;
+  std::vector<Frame> stack_;
+};
+
+
+} // namespace calc
+
+#endif
@@ -4,61 +4,278 @@
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "evaluator.hpp"
+#include "machine.hpp"
+#include "bytecode.hpp"
+#include "debruijn.hpp"
 
+#include <lingo/cache.hpp>
 #include <lingo/file.hpp>
 #include <lingo/io.hpp>
 #include <lingo/error.hpp>
+#include <lingo/parsing.hpp>
+#include <lingo/profile.hpp>
+#include <lingo/statistics.hpp>
 
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 
 using namespace lingo;
 using namespace calc;
 
 
-// Initialize the token set used by the language.
-void
-init_tokens()
+// The evaluation options of the interpreter.
+struct Options
 {
-  symbols.put_symbol(lparen_tok, "(");
-  symbols.put_symbol(rparen_tok, ")");
-  symbols.put_symbol(backslash_tok, "\\");
-  symbols.put_symbol(dot_tok, ".");
-  symbols.put_symbol(equal_tok, "=");
-  symbols.put_symbol(semicolon_tok, ";");
-}
+  bool parallel = false;
+  bool machine = false;
+  bool lazy = false;
+  bool vm = false;
+  bool normalize = false;
+  Result_cache* cache = nullptr;
+};
 
 
+// Evaluate the program expr, printing its result. Returns the exit
+// status of the program.
 int
-main(int argc, char* argv[])
+evaluate(Expr const* expr, Options const& opts)
 {
-  init_colors();
-  init_tokens();
+  try {
+    lingo_profile("evaluate");
+    if (opts.normalize) {
+      Normalizer eval;
+      if (Term const* result = eval(expr))
+        std::cout << *result << '\n';
+      return 0;
+    }
+    Expr const* result;
+    if (opts.machine || opts.lazy) {
+      Machine eval(opts.lazy);
+      result = eval(expr);
+    } else if (opts.vm) {
+      Vm eval;
+      result = eval(compile(expr));
+    } else {
+      Evaluator eval;
+      result = eval(expr);
+    }
+    if (result)
+      std::cout << *result << '\n';
+  } catch (Budget_exceeded& err) {
+    error("{}", err.what());
+    return 1;
+  }
+  return 0;
+}
 
-  if (argc != 2) {
-    std::cerr << "usage: lambda <input-file>\n";
-    return -1;
+
+// Lex and parse the file f. Returns null after an error.
+Expr const*
+parse_file(File& f)
+{
+  Character_stream cs(f);
+  Token_stream ts;
+  Lexer lex(cs, ts);
+  lex();
+  if (error_count())
+    return nullptr;
+  try {
+    Parser parse(ts);
+    Expr const* expr = parse();
+    return error_count() ? nullptr : expr;
+  } catch (Parse_error&) {
+    return nullptr;
+  }
+}
+
+
+// Load the program of the file f and its diagnostics from the cache,
+// or parse it and save the result. Returns null after an error.
+Expr const*
+load_file(File& f, Result_cache& cache)
+{
+  Phase_timer t(evaluation_stats().parse_time);
+  Expr const* expr;
+  if (cache.load<Expr_nodes>(f, symbols, expr))
+    return expr ? bind_names(expr) : nullptr;
+
+  // Diagnostics are held until they have been saved.
+  std::vector<Diagnostic> diags;
+  {
+    Diagnostic_context cxt(suppress_diags);
+    expr = parse_file(f);
+    cache.save<Expr_nodes, Expr>(f, expr, cxt);
+    diags.assign(cxt.begin(), cxt.end());
+  }
+  for (Diagnostic const& d : diags)
+    emit_diagnostic(d);
+  return expr;
+}
+
+
+// Lex, parse, and evaluate the program in the file at path, reusing
+// the token stream and parser of earlier files. Returns the exit
+// status of the program.
+int
+process_file(char const* path, Token_stream& ts, Parser& parse, Options const& opts)
+{
+  File input(path);
+  if (opts.cache) {
+    Expr const* expr = load_file(input, *opts.cache);
+    flush_diagnostics();
+    if (!expr)
+      return error_count() ? 1 : 0;
+    int status = evaluate(expr, opts);
+    flush_diagnostics();
+    return status;
   }
 
-  File input(argv[1]);
   Character_stream cs(input);
-  Token_stream ts(input);
   Lexer lex(cs, ts);
-  Parser parse(ts);
+  ts.clear();
 
   // Transform characters into tokens.
-  lex();
+  {
+    Phase_timer t(evaluation_stats().lex_time);
+    lex();
+  }
+  flush_diagnostics();
   if (error_count())
     return -1;
 
   // Transform tokens into abstract syntax.
-  Expr const* expr = parse();
+  std::deque<Arena_factory> arenas;
+  Expr const* expr;
+  {
+    Phase_timer t(evaluation_stats().parse_time);
+    expr = opts.parallel ? parse_in_parallel(ts.tokens(), arenas) : parse();
+  }
+  flush_diagnostics();
   if (error_count())
     return 1;
   // std::cout << "Parsed:\n" << *expr << '\n';
 
-  Evaluator eval;
-  Expr const* result = eval(expr);
-  if (result)
-    std::cout << *result << '\n';
+  int status = evaluate(expr, opts);
+  flush_diagnostics();
+  return status;
+}
+
+
+// Lex and parse the files at paths using n threads, and then
+// evaluate their programs in order. The diagnostics of all files are
+// written before any program is evaluated. Returns the exit status
+// of the last failing program.
+int
+process_files(std::vector<Path> const& paths, std::size_t n, Options const& opts)
+{
+  std::deque<Arena_factory> arenas;
+  std::vector<Expr const*> exprs;
+  {
+    Phase_timer t(evaluation_stats().parse_time);
+    exprs = parse_files_in_parallel<Expr>(paths, arenas, parse_file, n);
+  }
+  flush_diagnostics();
+
+  int status = 0;
+  for (Expr const* expr : exprs) {
+    if (!expr)
+      status = 1;
+    else if (int s = evaluate(expr, opts))
+      status = s;
+    flush_diagnostics();
+  }
+  return status;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  init_colors();
+
+  // With --parallel, the top-level items of the program are
+  // parsed in parallel. With --machine, the program is evaluated
+  // by the machine instead of by substitution. With --lazy, it is
+  // evaluated by the machine, passing arguments by need. With --vm,
+  // it is compiled to bytecode and run by the virtual machine. With
+  // --normalize, each item is reduced to its beta normal form in de
+  // Bruijn form, which is printed (see debruijn.hpp).
+  //
+  // With --batch, each of the input files is evaluated in turn, and
+  // output is block buffered. With --jobs=n, the input files are
+  // lexed and parsed by n threads (0 for one per core) before they
+  // are evaluated in turn.
+  //
+  // With --cache=dir, the programs of the input files, and their
+  // diagnostics, are saved in the directory dir, and loaded from it
+  // when the text of a file has not changed (see lingo/cache.hpp).
+  // Files are parsed in turn.
+  //
+  // With --stats, the work done by evaluation and the time spent in
+  // each phase are printed at exit. The options --steps=n and
+  // --seconds=s limit evaluation. With --profile or --trace=file,
+  // the profile is written at exit (see lingo/profile.hpp).
+  Profile_options profile;
+  Options opts;
+  bool batch = false;
+  bool stats = false;
+  long jobs = -1;
+  std::unique_ptr<Result_cache> cache;
+  bool ok = true;
+  int arg = 1;
+  for (; ok && arg < argc && std::strncmp(argv[arg], "--", 2) == 0; ++arg) {
+    if (std::strcmp(argv[arg], "--parallel") == 0)
+      opts.parallel = true;
+    else if (std::strcmp(argv[arg], "--machine") == 0)
+      opts.machine = true;
+    else if (std::strcmp(argv[arg], "--lazy") == 0)
+      opts.lazy = true;
+    else if (std::strcmp(argv[arg], "--vm") == 0)
+      opts.vm = true;
+    else if (std::strcmp(argv[arg], "--normalize") == 0)
+      opts.normalize = true;
+    else if (std::strcmp(argv[arg], "--batch") == 0)
+      batch = true;
+    else if (std::strcmp(argv[arg], "--stats") == 0)
+      stats = true;
+    else if (std::strncmp(argv[arg], "--cache=", 8) == 0)
+      cache.reset(new Result_cache(argv[arg] + 8, "lambda-1"));
+    else if (std::strncmp(argv[arg], "--jobs=", 7) == 0) {
+      char* end;
+      jobs = std::strtol(argv[arg] + 7, &end, 10);
+      ok = end != argv[arg] + 7 && !*end && jobs >= 0;
+      batch = true;
+    } else
+      ok = set_evaluation_budget(argv[arg]) || profile.parse(argv[arg]);
+  }
+  opts.cache = cache.get();
+  if (!ok || arg == argc || (!batch && arg != argc - 1) || (cache && jobs >= 0)) {
+    std::cerr << "usage: lambda [--parallel] [--machine] [--lazy] [--vm] [--normalize] [--stats] [--steps=n] [--seconds=s] "
+                 "[--profile] [--trace=file] [--cache=dir] <input-file>\n"
+                 "       lambda --batch [--jobs=n] [options] <input-file>...\n";
+    return -1;
+  }
+
+  if (batch)
+    buffer_output();
+  int status = 0;
+  if (jobs >= 0) {
+    status = process_files({argv + arg, argv + argc}, jobs, opts);
+  } else {
+    Token_stream ts;
+    Parser parse(ts);
+    for (; arg < argc; ++arg) {
+      if (int s = process_file(argv[arg], ts, parse, opts))
+        status = s;
+      reset_diagnostics();
+    }
+  }
+  if (stats)
+    std::cerr << evaluation_stats();
+  return status;
 }
@@ -6,6 +6,8 @@
 #include "ast.hpp"
 
 #include <lingo/error.hpp>
+#include <lingo/profile.hpp>
+#include <lingo/parsing.hpp>
 
 #include <iostream>
 
@@ -33,6 +35,133 @@ token_spelling(Token_stream& ts)
 } // namespace
 
 
+// -------------------------------------------------------------------------- //
+// Name binding
+
+
+// Bind the symbol s to the variable v in the current scope,
+// saving the binding that it shadows.
+void
+Name_map::bind(Symbol const* s, Var const* v)
+{
+  Var const*& x = vars_[s];
+  saved_.emplace_back(s, x);
+  x = v;
+}
+
+
+// Enter a new scope.
+void
+Name_map::push()
+{
+  scopes_.push_back(saved_.size());
+}
+
+
+// Leave the current scope, restoring the bindings shadowed
+// by that scope in reverse order.
+void
+Name_map::pop()
+{
+  std::size_t n = scopes_.back();
+  scopes_.pop_back();
+  while (saved_.size() != n) {
+    Saved& b = saved_.back();
+    vars_.put(b.first, b.second);
+    saved_.pop_back();
+  }
+}
+
+
+namespace
+{
+
+// The binder binds the references of a program as the parser does.
+// A variable is in scope from its declaration to the end of the
+// abstraction that encloses it, or of the program. A definition's
+// own variable is in scope within its expression.
+struct Binder
+{
+  Expr const* bind(Expr const*);
+
+  Name_map names_;
+};
+
+
+// Returns e with each reference bound to the variable in scope, or
+// unbound if there is none. Returns e if no reference changes.
+Expr const*
+Binder::bind(Expr const* e)
+{
+  struct Fn
+  {
+    Binder& b;
+
+    Expr const* operator()(Var const* e) { return e; }
+
+    Expr const* operator()(Ref const* e)
+    {
+      Var const* v = b.names_.lookup(e->name());
+      return v == e->var() ? e : cons<Ref>(e->name(), v);
+    }
+
+    Expr const* operator()(Def const* e)
+    {
+      b.names_.bind(e->var()->name(), e->var());
+      Expr const* e1 = b.bind(e->expr());
+      return e1 == e->expr() ? e : cons<Def>(e->var(), e1);
+    }
+
+    Expr const* operator()(Abs const* e)
+    {
+      b.names_.push();
+      b.names_.bind(e->var()->name(), e->var());
+      Expr const* e1 = b.bind(e->expr());
+      b.names_.pop();
+      return e1 == e->expr() ? e : cons<Abs>(e->var(), e1);
+    }
+
+    Expr const* operator()(App const* e)
+    {
+      Expr const* e1 = b.bind(e->fn());
+      Expr const* e2 = b.bind(e->arg());
+      if (e1 == e->fn() && e2 == e->arg())
+        return e;
+      return cons<App>(e1, e2);
+    }
+
+    Expr const* operator()(Seq const* e)
+    {
+      Expr const* e1 = b.bind(e->left());
+      Expr const* e2 = b.bind(e->right());
+      if (e1 == e->left() && e2 == e->right())
+        return e;
+      return cons<Seq>(e1, e2);
+    }
+  };
+  return apply(e, Fn{*this});
+}
+
+} // namespace
+
+
+// Returns the program e with its references bound as the parser
+// would bind them. This is used for programs whose references were
+// saved by name (see ast.hpp).
+Expr const*
+bind_names(Expr const* e)
+{
+  Binder b;
+  b.names_.push();
+  Expr const* r = b.bind(e);
+  b.names_.pop();
+  return r;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Parsing support
+
 // Returns the first token of lookahead.
 Token_kind
 Parser::lookahead() const
@@ -55,10 +184,9 @@ Parser::match(Token_kind k)
   if (lookahead() == k)
     return ts_.get();
 
-  String msg = format("expected '{}' but got '{}'",
-                      get_spelling(k),
-                      token_spelling(ts_));
-  error(ts_.location(), msg);
+  error(ts_.location(), "expected '{}' but got '{}'",
+        get_spelling(k),
+        token_spelling(ts_));
   throw Parse_error("match");
 }
 
@@ -222,9 +350,29 @@ Parser::seq()
 }
 
 
+// item: expr [';']
+//
+// An item is a single top-level expression of a program, followed
+// by its separator. This is the program parsed by the parsers of
+// parse_in_parallel.
+Expr const*
+Parser::item()
+{
+  lingo_profile("parse item");
+  Expr const* e = expr();
+  match_if(semicolon_tok);
+  if (!ts_.eof()) {
+    error(ts_.location(), "expected ';' but got '{}'", token_spelling(ts_));
+    throw Parse_error("item");
+  }
+  return e;
+}
+
+
 Expr const*
 Parser::operator()()
 {
+  lingo_profile("parse");
   Environment env(*this);
   if (ts_.eof())
     return nullptr;
@@ -240,7 +388,7 @@ Var const*
 Parser::on_var(Token tok)
 {
   Symbol const* sym = tok.symbol();
-  Var* v = new Var(sym);
+  Var* v = make<Var>(sym);
   names_.bind(sym, v);
   return v;
 }
@@ -252,53 +400,54 @@ Expr const*
 Parser::on_id(Token tok)
 {
   Symbol const* sym = tok.symbol();
-  if (Name_binding const* bind = names_.lookup(sym))
-    return new Ref(sym, bind->second);
+  if (Var const* v = names_.lookup(sym))
+    return cons<Ref>(sym, v);
   else
-    return new Ref(sym);
+    return cons<Ref>(sym);
 }
 
 
 Expr const*
 Parser::on_def(Var const* v, Expr const* e)
 {
-  return new Def(v, e);
+  return cons<Def>(v, e);
 }
 
 
 Expr const*
 Parser::on_abs(Var const* v, Expr const* e)
 {
-  return new Abs(v, e);
+  return cons<Abs>(v, e);
 }
 
 
 Expr const*
 Parser::on_app(Expr const* e1, Expr const* e2)
 {
-  return new App(e1, e2);
+  return cons<App>(e1, e2);
 }
 
 
 Expr const*
 Parser::on_seq(Expr const* e1, Expr const* e2)
 {
-  return new Seq(e1, e2);
+  return cons<Seq>(e1, e2);
 }
 
 
 // Parse the given buffer.
 Expr const*
-parse(String const& str)
+parse(String str)
 {
-  Buffer buf(str);
+  Buffer buf(std::move(str));
   Character_stream cs(buf);
-  Token_stream ts(buf);
+  Token_stream ts;
   Lexer lex(cs, ts);
   Parser parse(ts);
 
   // Lex.
   lex();
+  flush_diagnostics();
   if (error_count()) {
     reset_diagnostics();
     return make_error_node<Expr>();
@@ -306,6 +455,7 @@ parse(String const& str)
 
   // Parse.
   Expr const* expr = parse();
+  flush_diagnostics();
   if (error_count()) {
     reset_diagnostics();
     return make_error_node<Expr>();
@@ -315,4 +465,140 @@ parse(String const& str)
 }
 
 
+// -------------------------------------------------------------------------- //
+//                            Parallel parsing
+
+namespace
+{
+
+// The resolver binds the references of the items of a program to
+// the definitions of earlier items. Each item is parsed on its own,
+// so a reference to a name defined by an earlier item is unbound
+// after parsing. Visiting the items in order binds that reference
+// to the definition that was in scope when it was parsed.
+//
+// Terms are unique, and an unbound reference may be shared with
+// items in which that name is still unbound, so references are not
+// bound in place. A bound reference is a new term, as are the terms
+// that enclose it.
+//
+// A definition that is not within an abstraction is declared in
+// the scope of the program. Its name is visible to later items.
+struct Resolver
+{
+  Expr const* resolve(Expr const*);
+  void declare();
+
+  Symbol_attribute<Var const*> vars_;  // Definitions of earlier items
+  std::vector<Var const*>      defs_;  // Definitions of the current item
+  int                          depth_ = 0;
+};
+
+
+// Returns e with its unbound references bound to the definitions
+// of earlier items. Returns e if no reference is bound.
+Expr const*
+Resolver::resolve(Expr const* e)
+{
+  struct Fn
+  {
+    Resolver& r;
+
+    Expr const* operator()(Var const* e) { return e; }
+
+    Expr const* operator()(Ref const* e)
+    {
+      if (!e->var()) {
+        if (Var const* v = r.vars_.get(e->name()))
+          return cons<Ref>(e->name(), v);
+      }
+      return e;
+    }
+
+    Expr const* operator()(Def const* e)
+    {
+      if (r.depth_ == 0)
+        r.defs_.push_back(e->var());
+      Expr const* e1 = r.resolve(e->expr());
+      return e1 == e->expr() ? e : cons<Def>(e->var(), e1);
+    }
+
+    Expr const* operator()(Abs const* e)
+    {
+      ++r.depth_;
+      Expr const* e1 = r.resolve(e->expr());
+      --r.depth_;
+      return e1 == e->expr() ? e : cons<Abs>(e->var(), e1);
+    }
+
+    Expr const* operator()(App const* e)
+    {
+      Expr const* e1 = r.resolve(e->fn());
+      Expr const* e2 = r.resolve(e->arg());
+      if (e1 == e->fn() && e2 == e->arg())
+        return e;
+      return cons<App>(e1, e2);
+    }
+
+    Expr const* operator()(Seq const* e)
+    {
+      Expr const* e1 = r.resolve(e->left());
+      Expr const* e2 = r.resolve(e->right());
+      if (e1 == e->left() && e2 == e->right())
+        return e;
+      return cons<Seq>(e1, e2);
+    }
+  };
+  return apply(e, Fn{*this});
+}
+
+
+// Declare the definitions of the current item for the items
+// that follow.
+void
+Resolver::declare()
+{
+  for (Var const* v : defs_)
+    vars_.put(v->name(), v);
+  defs_.clear();
+}
+
+
+} // namespace
+
+
+// Parse the tokens of a program in parallel, using n threads. This
+// is equivalent to parsing the tokens with a Parser.
+//
+// The program is split into top-level items at each semicolon that
+// is not enclosed by parentheses. The items are parsed in parallel,
+// each with a parser of its own, and the nodes of each thread are
+// allocated by a factory added to arenas. Names are then resolved
+// in a sequential pass over the items, and the items are joined
+// into a sequence. Nodes of that sequence are allocated in the
+// current arena.
+Expr const*
+parse_in_parallel(Token_seq const& toks, std::deque<Arena_factory>& arenas, std::size_t n)
+{
+  if (toks.empty())
+    return nullptr;
+  std::vector<std::size_t> splits =
+    split_tokens(toks, semicolon_tok, {lparen_tok}, {rparen_tok});
+  std::vector<Expr const*> items = lingo::parse_in_parallel<Expr>(
+    toks, splits, arenas, [](Token_stream& ts) {
+      Parser p(ts);
+      return p.item();
+    }, n);
+
+  Resolver r;
+  Expr const* e = nullptr;
+  for (Expr const* x : items) {
+    x = r.resolve(x);
+    r.declare();
+    e = e ? cons<Seq>(e, x) : x;
+  }
+  return e;
+}
+
+
 } // namespace calc
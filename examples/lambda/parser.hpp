@@ -7,7 +7,11 @@
 #include "lexer.hpp"
 #include "ast.hpp"
 
-#include <lingo/environment.hpp>
+#include <lingo/symbol.hpp>
+
+#include <deque>
+#include <utility>
+#include <vector>
 
 namespace calc
 {
@@ -25,9 +29,25 @@ struct Parse_error : std::runtime_error
 // The naming environment associates names with their
 // definitions. Note that a symbol can be bound to either
 // a variable (Var) or definition (Def).
-using Name_map = Environment<Symbol const*, Var const*>;
-using Name_binding = Name_map::Binding;
-using Name_stack = Stack<Name_map>;
+//
+// The innermost binding of each symbol is stored in a side
+// table indexed by symbol id. When a scope binds a name, the
+// binding it shadows is saved and then restored when the
+// scope is popped.
+struct Name_map
+{
+  using Saved = std::pair<Symbol const*, Var const*>;
+
+  Var const* lookup(Symbol const* s) const { return vars_.get(s); }
+  void       bind(Symbol const*, Var const*);
+
+  void push();
+  void pop();
+
+  Symbol_attribute<Var const*> vars_;
+  std::vector<Saved>           saved_;
+  std::vector<std::size_t>     scopes_;
+};
 
 
 // The parser is responsible for transforming a stream of tokens
@@ -50,6 +70,7 @@ struct Parser
   Expr const* app();
   Expr const* postfix();
   Expr const* seq();
+  Expr const* item();
   Expr const* binary();
   Expr const* expr();
 
@@ -70,7 +91,7 @@ struct Parser
   Token      accept();
 
   Token_stream& ts_;
-  Name_stack    names_;
+  Name_map      names_;
 
   // Name binding support.
   struct Environment {
@@ -90,7 +111,9 @@ struct Parser
 };
 
 
-Expr const* parse(String const&);
+Expr const* parse(String);
+Expr const* bind_names(Expr const*);
+Expr const* parse_in_parallel(Token_seq const&, std::deque<Arena_factory>&, std::size_t = 0);
 
 
 } // namespace calc
@@ -4,9 +4,29 @@
 #include "substitution.hpp"
 #include "ast.hpp"
 
+#include <lingo/statistics.hpp>
+
+#include <cstdint>
+
 namespace calc
 {
 
+namespace
+{
+
+// Returns the summary of the substituted variables (see Expr::vars).
+std::uint64_t
+summary(Substitution const& s)
+{
+  std::uint64_t n = 0;
+  for (auto const& x : s)
+    n |= var_bit(x.first);
+  return n;
+}
+
+} // namespace
+
+
 Expr const*
 Substitution::operator()(Expr const* e) const
 {
@@ -14,9 +34,15 @@ Substitution::operator()(Expr const* e) const
 }
 
 
+// Terms whose summaries share no bits with that of the substituted
+// variables reference none of them, and are returned unchanged,
+// without being traversed.
 Expr const*
 Substitution::subst(Expr const* e) const
 {
+  if (!(e->vars() & summary(*this)))
+    return e;
+
   struct Fn
   {
     Substitution const& subst;
@@ -53,8 +79,10 @@ Substitution::subst(Ref const* e) const
 {
   if (e->var()) {
     auto iter = find(e->var());
-    if (iter != end())
+    if (iter != end()) {
+      count_substitution();
       return iter->second;
+    }
   }
   return e;
 }
@@ -68,7 +96,10 @@ Substitution::subst(Def const* e) const
 {
   Var const* v = cast<Var>(subst(e->var()));
   Expr const* d = subst(e->expr());
-  return new Def(v, d);
+  if (v == e->var() && d == e->expr())
+    return e;
+  count_allocation();
+  return cons<Def>(v, d);
 }
 
 
@@ -77,7 +108,10 @@ Substitution::subst(Abs const* e) const
 {
   Var const* v = cast<Var>(subst(e->var()));
   Expr const* d = subst(e->expr());
-  return new Abs(v, d);
+  if (v == e->var() && d == e->expr())
+    return e;
+  count_allocation();
+  return cons<Abs>(v, d);
 }
 
 
@@ -86,7 +120,10 @@ Substitution::subst(App const* e) const
 {
   Expr const* e1 = subst(e->fn());
   Expr const* e2 = subst(e->arg());
-  return new App(e1, e2);
+  if (e1 == e->fn() && e2 == e->arg())
+    return e;
+  count_allocation();
+  return cons<App>(e1, e2);
 }
 
 
@@ -95,7 +132,10 @@ Substitution::subst(Seq const* e) const
 {
   Expr const* e1 = subst(e->left());
   Expr const* e2 = subst(e->right());
-  return new App(e1, e2);
+  if (e1 == e->left() && e2 == e->right())
+    return e;
+  count_allocation();
+  return cons<Seq>(e1, e2);
 }
 
 
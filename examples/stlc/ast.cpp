@@ -6,94 +6,44 @@
 #include "lingo/memory.hpp"
 #include "lingo/error.hpp"
 
+#include <atomic>
 #include <iostream>
-#include <set>
-#include <typeindex>
 
 namespace calc
 {
 
 // -------------------------------------------------------------------------- //
-// Ordering
+// Term scopes
 
-bool is_less(Type const*, Type const*);
+thread_local Term_scope* Term_scope::current_ = nullptr;
 
 
-bool
-is_less(Base_type const* a, Base_type const* b)
+// Returns a new index for the tables of a type of term.
+std::size_t
+Term_scope::next_index()
 {
-  std::less<Symbol const*> cmp;
-  return cmp(a->name(), b->name());
-}
-
-
-bool
-is_less(Arrow_type const* a, Arrow_type const* b)
-{
-  if (is_less(a->first, b->first))
-    return true;
-  if (is_less(b->first, a->first))
-    return false;
-  return is_less(a->second, b->second);
-}
-
-
-bool
-is_less(Type const* a, Type const* b)
-{
-  struct Fn
-  {
-    Type const* b;
-    bool operator()(Base_type const* a) const
-    {
-      return is_less(a, as<Base_type>(b));
-    }
-    bool operator()(Arrow_type const* a) const
-    {
-      return is_less(a, as<Arrow_type>(b));
-    }
-  };
-
-  std::type_index t1 = typeid(*a);
-  std::type_index t2 = typeid(*b);
-  if (t1 < t2)
-    return true;
-  if (t2 < t1)
-    return false;
-  lingo_assert(t1 == t2);
-  return apply(a, Fn{b});
+  static std::atomic<std::size_t> n(0);
+  return n++;
 }
 
 
 // -------------------------------------------------------------------------- //
 // Types
 
-
-struct Type_less
-{
-  template<typename T>
-  bool operator()(T const& a, T const& b) const
-  {
-    return is_less(&a, &b);
-  }
-};
-
-
+// Returns the unique base type named n.
 Type const*
-get_base_type(Symbol const* sym)
+get_base_type(Symbol const* n)
 {
-  static std::set<Base_type, Type_less> s;
-  auto iter = s.emplace(sym);
-  return &*iter.first;
+  return cons<Base_type>(n);
 }
 
 
+// Returns the unique arrow type t1 -> t2. The operands are unique,
+// so finding the type compares them by address, in constant time.
 Type const*
 get_arrow_type(Type const* t1, Type const* t2)
 {
-  static std::set<Arrow_type, Type_less> s;
-  auto iter = s.emplace(t1, t2);
-  return &*iter.first;
+  return cons<Arrow_type>(t1, t2);
 }
 
 
@@ -0,0 +1,119 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef CALC_BYTECODE_HPP
+#define CALC_BYTECODE_HPP
+
+#include "ast.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace calc
+{
+
+// -------------------------------------------------------------------------- //
+//                                 Bytecode
+
+// The instructions of the virtual machine. Each instruction is a
+// word, followed by its operands. Instructions operate on a stack
+// of values.
+enum Op : std::uint32_t
+{
+  op_arg,       // Push the argument of the current function
+  op_env,       // k: Push the kth captured value of the current closure
+  op_global,    // g t: Push (or call the thunk of) definition g, or term t if g is not defined
+  op_term,      // t: Push term t
+  op_null,      // Push the null value
+  op_closure,   // f: Push a closure of function f
+  op_call,      // t: Call the function below the argument; t is the application
+  op_tail_call, // t: As op_call, replacing the current call
+  op_return,    // Return the value on top of the stack to the caller
+  op_define,    // g: Pop the value of definition g
+  op_print,     // Pop and print a value
+  op_halt       // Stop, with the result on top of the stack
+};
+
+
+// Where a function finds a variable that it captures: the argument
+// of the enclosing function, or one of its captured values (k >= 0).
+constexpr int arg_slot = -1;
+
+
+// A compiled abstraction. Closures are flat: when one is created,
+// the values of the variables referenced by the function, other than
+// its parameter, are copied into it.
+struct Function
+{
+  Function(Abs const* a, Function* p)
+    : abs(a), parent(p)
+  { }
+
+  Abs const*                 abs;      // The source, or null for the program and thunks
+  Function*                  parent;   // The enclosing function
+  std::vector<Var const*>    captures; // The captured variables
+  std::vector<int>           sources;  // Where each is found in the parent
+  std::vector<std::uint32_t> code;
+};
+
+
+// A compiled program. The last function is the program itself.
+struct Program
+{
+  Function const* main() const { return fns.back().get(); }
+
+  std::vector<std::unique_ptr<Function>> fns;
+  std::vector<Expr const*>               terms;   // Term operands
+  std::vector<Var const*>                globals; // Defined variables
+};
+
+
+Program compile(Expr const*);
+
+
+// -------------------------------------------------------------------------- //
+//                              Virtual machine
+
+// The virtual machine runs a compiled program. The order of
+// evaluation, and the results, are those of the evaluator, except
+// that the argument of an application is evaluated before its
+// function is checked, and that a reference to a definition is
+// replaced by its value rather than its expression. A closure is converted back to a term, by
+// substituting its captured values, only when it is printed or
+// returned.
+struct Vm
+{
+  struct Closure;
+
+  // A value is a closure or a term that cannot be reduced (e.g.,
+  // an unbound reference). Both are null for definitions, which
+  // have no value.
+  struct Value
+  {
+    Expr const*    term;
+    Closure const* clo;
+  };
+
+  // A closure is followed by its captured values.
+  struct Closure
+  {
+    Function const* fn;
+
+    Value const* values() const { return reinterpret_cast<Value const*>(this + 1); }
+  };
+
+  Expr const* operator()(Program const&);
+
+  Closure const* make_closure(Function const*, Value, Closure const*);
+  Expr const*    reify(Value);
+
+  Arena              closures_;
+  std::vector<Value> globals_;
+  std::vector<bool>  defined_;
+};
+
+
+} // namespace calc
+
+#endif
@@ -4,6 +4,8 @@
 #include "lexer.hpp"
 
 #include <lingo/error.hpp>
+#include <lingo/profile.hpp>
+#include <lingo/reserved.hpp>
 
 #include <cassert>
 #include <cctype>
@@ -22,21 +24,41 @@ Symbol_table symbols;
 // -------------------------------------------------------------------------- //
 // Tokens
 
+namespace
+{
+
+// The reserved spellings of the language. Punctuators are
+// recognized by this table, not by the symbol table.
+constexpr Reserved spellings[] = {
+  {"(", lparen_tok},
+  {")", rparen_tok},
+  {"\\", backslash_tok},
+  {".", dot_tok},
+  {"=", equal_tok},
+  {":", colon_tok},
+  {";", semicolon_tok},
+  {"->", arrow_tok},
+};
+
+constexpr auto tokens = make_reserved_table(spellings);
+
+Reserved_symbols<tokens.size()> reserved(tokens);
+
+Punctuator_trie punctuators(reserved);
+
+} // namespace
+
+
 char const*
 get_spelling(Token_kind k)
 {
+  if (char const* s = tokens.spelling(k))
+    return s;
   switch (k) {
     case error_tok: return "<error>";
-    case lparen_tok: return "(";
-    case rparen_tok: return ")";
-    case backslash_tok: return "\\";
-    case dot_tok: return ".";
-    case equal_tok: return "=";
-    case colon_tok: return ":";
-    case semicolon_tok: return ";";
-    case arrow_tok: return "->";
     case identifier_tok: return "<identifier>";
     case integer_tok: return "<integer>";
+    default: break;
   }
   lingo_unreachable();
 }
@@ -46,10 +68,13 @@ get_spelling(Token_kind k)
 // Lexing
 
 
+// Consume the current character as part of the lexeme. The
+// characters of a lexeme are not copied; they are viewed in
+// the input buffer when the token is formed.
 void
 Lexer::save()
 {
-  str_.put(cs_.get());
+  cs_.ignore();
 }
 
 
@@ -61,22 +86,11 @@ Lexer::scan()
     space();
 
     loc_ = cs_.location();
+    cs_.start();
+    if (Symbol const* sym = punctuators.match(cs_))
+      return Token(loc_, sym);
     switch (cs_.peek()) {
     case '\0': return eof();
-    case '(': return symbol();
-    case ')': return symbol();
-    case '\\': return symbol();
-    case '.': return symbol();
-    case '=': return symbol();
-    case ':': return symbol();
-    case ';': return symbol();
-
-    case '-':
-      save();
-      if (cs_.peek() == '>')
-        return symbol();
-      else
-        error();
 
     default:
       if (is_alpha(cs_.peek()))
@@ -100,8 +114,7 @@ Lexer::error()
 void
 Lexer::space()
 {
-  while (is_space(cs_.peek()))
-    cs_.ignore();
+  cs_.skip_while(space_class);
 }
 
 
@@ -112,15 +125,6 @@ Lexer::eof()
 }
 
 
-// Save the last character of a symbol and process it.
-Token
-Lexer::symbol()
-{
-  save();
-  return on_symbol();
-}
-
-
 // letter ::= [a-z][A-Z]
 void
 Lexer::letter()
@@ -141,8 +145,7 @@ Token
 Lexer::identifier()
 {
   letter();
-  while (is_alpha(cs_.peek()))
-    letter();
+  cs_.skip_while(alpha_class);
   return on_identifier();
 }
 
@@ -151,25 +154,15 @@ Token
 Lexer::integer()
 {
   digit();
-  while (is_decimal_digit(cs_.peek()))
-    digit();
+  cs_.skip_while(digit_class);
   return on_identifier();
 }
 
 
-Token
-Lexer::on_symbol()
-{
-  Symbol const* sym = symbols.get(str_.take());
-  return Token(loc_, sym);
-}
-
-
 Token
 Lexer::on_identifier()
 {
-  String str = str_.take();
-  Symbol* sym = symbols.put_identifier(identifier_tok, str);
+  Symbol* sym = symbols.put_identifier(identifier_tok, cs_.lexeme());
   return Token(loc_, sym);
 }
 
@@ -177,8 +170,8 @@ Lexer::on_identifier()
 Token
 Lexer::on_integer()
 {
-  String str = str_.take();
-  int n = string_to_int<int>(str, 10);
+  String_view str = cs_.lexeme();
+  int n = string_to_int<int>(str.begin(), str.end(), 10);
   Symbol* sym = symbols.put_integer(integer_tok, str, n);
   return Token(loc_, sym);
 }
@@ -187,6 +180,7 @@ Lexer::on_integer()
 void
 Lexer::operator()()
 {
+  lingo_profile("lex");
   while (Token tok = scan())
     ts_.put(tok);
 }
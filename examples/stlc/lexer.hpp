@@ -72,7 +72,6 @@ struct Lexer
   // Scanners
   Token scan();
   Token eof();
-  Token symbol();
   Token identifier();
   Token integer();
 
@@ -83,7 +82,6 @@ struct Lexer
   void digit();
 
   // Semantic actions.
-  Token on_symbol();
   Token on_identifier();
   Token on_integer();
 
@@ -91,7 +89,6 @@ struct Lexer
 
   Character_stream& cs_;
   Token_stream&     ts_;
-  String_builder    str_;
   Location          loc_;
 };
 
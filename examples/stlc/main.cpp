@@ -4,68 +4,196 @@
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "evaluator.hpp"
+#include "bytecode.hpp"
 
 #include <lingo/file.hpp>
 #include <lingo/io.hpp>
 #include <lingo/error.hpp>
+#include <lingo/parsing.hpp>
+#include <lingo/profile.hpp>
+#include <lingo/statistics.hpp>
 
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <vector>
 
 
 using namespace lingo;
 using namespace calc;
 
 
-// Initialize the token set used by the language.
-void
-init_tokens()
+// Evaluate the program expr, printing its result. If vm is true,
+// the program is compiled to bytecode and run by the virtual
+// machine. Returns the exit status of the program.
+int
+evaluate(Expr const* expr, bool vm)
 {
-  symbols.put_symbol(lparen_tok, "(");
-  symbols.put_symbol(rparen_tok, ")");
-  symbols.put_symbol(backslash_tok, "\\");
-  symbols.put_symbol(dot_tok, ".");
-  symbols.put_symbol(equal_tok, "=");
-  symbols.put_symbol(colon_tok, ":");
-  symbols.put_symbol(semicolon_tok, ";");
-  symbols.put_symbol(arrow_tok, "->");
+  try {
+    lingo_profile("evaluate");
+    Expr const* result;
+    if (vm) {
+      Vm eval;
+      result = eval(compile(expr));
+    } else {
+      Evaluator eval;
+      result = eval(expr);
+    }
+    if (result)
+      std::cout << *result << '\n';
+  } catch (Budget_exceeded& err) {
+    error("{}", err.what());
+    return 1;
+  }
+  return 0;
 }
 
 
+// Lex, parse, and evaluate the program in the file at path, reusing
+// the token stream and parser of earlier files. Returns the exit
+// status of the program.
 int
-main(int argc, char* argv[])
+process_file(char const* path, Token_stream& ts, Parser& parse, bool vm)
 {
-  init_colors();
-  init_tokens();
-
-  if (argc != 2) {
-    std::cerr << "usage: lambda <input-file>\n";
-    return -1;
-  }
-
-  File input(argv[1]);
+  File input(path);
   Character_stream cs(input);
-  Token_stream ts(input);
   Lexer lex(cs, ts);
-  Parser parse(ts);
+  ts.clear();
 
   // Transform characters into tokens.
-  lex();
+  {
+    Phase_timer t(evaluation_stats().lex_time);
+    lex();
+  }
+  flush_diagnostics();
   if (error_count())
     return -1;
 
+  int status = 0;
   try {
     // Transform tokens into abstract syntax.
-    Expr const* expr = parse();
+    Expr const* expr;
+    {
+      Phase_timer t(evaluation_stats().parse_time);
+      expr = parse();
+    }
+    flush_diagnostics();
     if (error_count())
       return 1;
     // std::cout << "Parsed:\n" << *expr << '\n';
 
-    Evaluator eval;
-    Expr const* result = eval(expr);
-    if (result)
-      std::cout << *result << '\n';
+    status = evaluate(expr, vm);
   } catch (Translation_error&) {
+    flush_diagnostics();
     return 1;
   }
-  return 0;
+  flush_diagnostics();
+  return status;
+}
+
+
+// Lex and parse the files at paths using n threads, and then
+// evaluate their programs in order. The diagnostics of all files are
+// written before any program is evaluated. Returns the exit status
+// of the last failing program.
+int
+process_files(std::vector<Path> const& paths, std::size_t n, bool vm)
+{
+  auto parse_file = [](File& f) -> Expr const* {
+    Character_stream cs(f);
+    Token_stream ts;
+    Lexer lex(cs, ts);
+    lex();
+    if (error_count())
+      return nullptr;
+    try {
+      Parser parse(ts);
+      Expr const* expr = parse();
+      return error_count() ? nullptr : expr;
+    } catch (Translation_error&) {
+      return nullptr;
+    }
+  };
+
+  std::deque<Arena_factory> arenas;
+  std::vector<Expr const*> exprs;
+  {
+    Phase_timer t(evaluation_stats().parse_time);
+    exprs = parse_files_in_parallel<Expr>(paths, arenas, parse_file, n);
+  }
+  flush_diagnostics();
+
+  int status = 0;
+  for (Expr const* expr : exprs) {
+    if (!expr)
+      status = 1;
+    else if (int s = evaluate(expr, vm))
+      status = s;
+    flush_diagnostics();
+  }
+  return status;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  init_colors();
+
+  // With --batch, each of the input files is evaluated in turn, and
+  // output is block buffered. With --jobs=n, the input files are
+  // lexed and parsed by n threads (0 for one per core) before they
+  // are evaluated in turn. With --vm, programs are compiled to
+  // bytecode and run by the virtual machine.
+  //
+  // With --stats, the work done by evaluation and the time spent in
+  // each phase are printed at exit. The options --steps=n and
+  // --seconds=s limit evaluation. With --profile or --trace=file,
+  // the profile is written at exit (see lingo/profile.hpp).
+  Profile_options profile;
+  bool batch = false;
+  bool stats = false;
+  bool vm = false;
+  long jobs = -1;
+  bool ok = true;
+  int arg = 1;
+  for (; ok && arg < argc && std::strncmp(argv[arg], "--", 2) == 0; ++arg) {
+    if (std::strcmp(argv[arg], "--batch") == 0)
+      batch = true;
+    else if (std::strcmp(argv[arg], "--stats") == 0)
+      stats = true;
+    else if (std::strcmp(argv[arg], "--vm") == 0)
+      vm = true;
+    else if (std::strncmp(argv[arg], "--jobs=", 7) == 0) {
+      char* end;
+      jobs = std::strtol(argv[arg] + 7, &end, 10);
+      ok = end != argv[arg] + 7 && !*end && jobs >= 0;
+      batch = true;
+    } else
+      ok = set_evaluation_budget(argv[arg]) || profile.parse(argv[arg]);
+  }
+  if (!ok || arg == argc || (!batch && arg != argc - 1)) {
+    std::cerr << "usage: stlc [--vm] [--stats] [--steps=n] [--seconds=s] [--profile] [--trace=file] <input-file>\n"
+                 "       stlc --batch [--jobs=n] [options] <input-file>...\n";
+    return -1;
+  }
+
+  if (batch)
+    buffer_output();
+  int status = 0;
+  if (jobs >= 0) {
+    status = process_files({argv + arg, argv + argc}, jobs, vm);
+  } else {
+    Token_stream ts;
+    Parser parse(ts);
+    for (; arg < argc; ++arg) {
+      if (int s = process_file(argv[arg], ts, parse, vm))
+        status = s;
+      reset_diagnostics();
+    }
+  }
+  if (stats)
+    std::cerr << evaluation_stats();
+  return status;
 }
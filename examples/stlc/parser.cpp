@@ -6,6 +6,7 @@
 #include "ast.hpp"
 
 #include <lingo/error.hpp>
+#include <lingo/profile.hpp>
 
 #include <iostream>
 
@@ -33,6 +34,47 @@ token_spelling(Token_stream& ts)
 } // namespace
 
 
+// -------------------------------------------------------------------------- //
+// Name binding
+
+
+// Bind the symbol s to the variable v in the current scope,
+// saving the binding that it shadows.
+void
+Name_map::bind(Symbol const* s, Var const* v)
+{
+  Var const*& x = vars_[s];
+  saved_.emplace_back(s, x);
+  x = v;
+}
+
+
+// Enter a new scope.
+void
+Name_map::push()
+{
+  scopes_.push_back(saved_.size());
+}
+
+
+// Leave the current scope, restoring the bindings shadowed
+// by that scope in reverse order.
+void
+Name_map::pop()
+{
+  std::size_t n = scopes_.back();
+  scopes_.pop_back();
+  while (saved_.size() != n) {
+    Saved& b = saved_.back();
+    vars_.put(b.first, b.second);
+    saved_.pop_back();
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+// Parsing support
+
 // Returns the first token of lookahead.
 Token_kind
 Parser::lookahead() const
@@ -55,10 +97,9 @@ Parser::match(Token_kind k)
   if (lookahead() == k)
     return ts_.get();
 
-  String msg = format("expected '{}' but got '{}'",
-                      get_spelling(k),
-                      token_spelling(ts_));
-  error(ts_.location(), msg);
+  error(ts_.location(), "expected '{}' but got '{}'",
+        get_spelling(k),
+        token_spelling(ts_));
   throw Parse_error();
 }
 
@@ -287,13 +328,13 @@ Parser::seq()
 Expr const*
 Parser::operator()()
 {
+  lingo_profile("parse");
   Environment env(*this);
   if (ts_.eof())
     return nullptr;
   Expr const* e = seq();
   if (!ts_.eof()) {
-    String msg = format("expected end-of-input but got '{}'", ts_.peek());
-    error(ts_.location(), msg);
+    error(ts_.location(), "expected end-of-input but got '{}'", ts_.peek());
     throw Parse_error();
   }
   return e;
@@ -322,7 +363,7 @@ Var const*
 Parser::on_var(Token tok, Type const* t)
 {
   Symbol const* sym = tok.symbol();
-  Var* v = new Var(sym, t);
+  Var* v = make<Var>(sym, t);
   names_.bind(sym, v);
   return v;
 }
@@ -334,8 +375,8 @@ Expr const*
 Parser::on_id(Token tok)
 {
   Symbol const* sym = tok.symbol();
-  if (Name_binding const* bind = names_.lookup(sym))
-    return new Ref(sym, bind->second);
+  if (Var const* v = names_.lookup(sym))
+    return cons<Ref>(sym, v);
   error(ts_.location(), "no matching variable for '{}'", *sym);
   throw Name_error();
 }
@@ -358,7 +399,7 @@ Parser::on_def(Token tok, Expr const* e)
 {
   Type const* t = e->type();
   Var const* v = on_var(tok, t);
-  return new Def(v, e);
+  return cons<Def>(v, e);
 }
 
 
@@ -366,7 +407,7 @@ Parser::on_def(Token tok, Expr const* e)
 Expr const*
 Parser::on_decl(Var const* v)
 {
-  return new Decl(v);
+  return make<Decl>(v);
 }
 
 
@@ -377,7 +418,7 @@ Expr const*
 Parser::on_abs(Var const* v, Expr const* e)
 {
   Type const* t = get_arrow_type(v->type(), e->type());
-  return new Abs(t, v, e);
+  return cons<Abs>(t, v, e);
 }
 
 
@@ -405,7 +446,7 @@ Parser::on_app(Expr const* e1, Expr const* e2)
   }
 
   // The type of the expression shall be t2.
-  return new App(t2, e1, e2);
+  return cons<App>(t2, e1, e2);
 }
 
 
@@ -413,15 +454,15 @@ Parser::on_app(Expr const* e1, Expr const* e2)
 Expr const*
 Parser::on_seq(Expr const* e1, Expr const* e2)
 {
-  return new Seq(e1, e2);
+  return cons<Seq>(e1, e2);
 }
 
 
 // Parse the given buffer.
 Expr const*
-parse(String const& str)
+parse(String str)
 {
-  Buffer buf(str);
+  Buffer buf(std::move(str));
   Character_stream cs(buf);
   Token_stream ts(buf);
   Lexer lex(cs, ts);
@@ -429,6 +470,7 @@ parse(String const& str)
 
   // Lex.
   lex();
+  flush_diagnostics();
   if (error_count()) {
     reset_diagnostics();
     return make_error_node<Expr>();
@@ -436,6 +478,7 @@ parse(String const& str)
 
   // Parse.
   Expr const* expr = parse();
+  flush_diagnostics();
   if (error_count()) {
     reset_diagnostics();
     return make_error_node<Expr>();
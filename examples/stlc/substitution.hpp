@@ -6,7 +6,7 @@
 
 #include "ast.hpp"
 
-#include <unordered_map>
+#include <lingo/small_map.hpp>
 
 namespace calc
 {
@@ -16,10 +16,11 @@ namespace calc
 // an expression for an argument.
 
 // Note that the actual substitution rules are defined as
-// an application of this object as a function.
-struct Substitution : std::unordered_map<Var const*, Expr const*>
+// an application of this object as a function. Most substitutions
+// replace a single variable, so they are small maps.
+struct Substitution : Small_map<Var const*, Expr const*>
 {
-  using std::unordered_map<Var const*, Expr const*>::unordered_map;
+  using Small_map<Var const*, Expr const*>::Small_map;
 
   Expr const* operator()(Expr const*) const;
 
@@ -5,31 +5,161 @@
 
 #include "lingo/buffer.hpp"
 #include "lingo/error.hpp"
+#include "lingo/profile.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <system_error>
+
+#include <unistd.h>
 
 namespace lingo
 {
 
-// Initialize the buffer with the given text. Perform a cursory
-// analysis of the input in order to construct the line map
-// for the input source.
+// Initialize the buffer with the given text. Note that
+// this copies the string.
 Buffer::Buffer(String const& str)
-  : text_(str), lines_()
-{
-  char const *first = &text_.front();
-  char const *last = first + text_.size();
-  char const *iter = first;
-  int pos = 0;
-  int line = 0;
-  while (iter != last) {
-    if (*iter == '\n') {
-      lines_.emplace(pos, Line(++line, pos, first + pos, iter));
-      pos = iter - first + 1; // One past the newline.
-    }
-    ++iter;
+  : text_(str), base_(0), extent_(0)
+{
+  set_text(text_.c_str(), text_.c_str() + text_.size());
+}
+
+
+// Initialize the buffer with the given text. The string is
+// moved into the buffer, not copied.
+Buffer::Buffer(String&& str)
+  : text_(std::move(str)), base_(0), extent_(0)
+{
+  set_text(text_.c_str(), text_.c_str() + text_.size());
+}
+
+
+// Initialize an empty buffer. A derived class must call
+// set_text() to provide the text of the buffer.
+Buffer::Buffer()
+  : first_(nullptr), last_(nullptr), base_(0), extent_(0)
+{
+  set_text("", "");
+}
+
+
+Buffer::~Buffer()
+{
+  source_manager().release(base_);
+}
+
+
+// Set the text of the buffer to [first, last). The character
+// at last shall be null. The line map is built on demand, and
+// its first character is at the locus o. The buffer's range of
+// positions is kept if the text fits, and replaced otherwise.
+void
+Buffer::set_text(char const* first, char const* last, Locus o)
+{
+  lingo_profile("load buffer");
+  first_ = first;
+  last_ = last;
+  lines_.reset(first, last, o);
+  if (!base_ || std::size_t(last - first) > extent_)
+    reserve(last - first);
+}
+
+
+// Replace the buffer's range of positions with one that can
+// hold n characters. Locations in the old range no longer refer
+// to the buffer.
+void
+Buffer::reserve(std::size_t n)
+{
+  if (base_)
+    source_manager().release(base_);
+  base_ = source_manager().reserve(this, n);
+  extent_ = n;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Chunked buffers
+
+// Initialize a chunk with the text t, whose first character is
+// at the stream offset n and the locus l. The first c characters
+// were copied from the previous chunk.
+Chunk::Chunk(String&& t, std::size_t n, Locus l, std::size_t c)
+  : origin_(n), carried_(c)
+{
+  text_ = std::move(t);
+  set_text(text_.c_str(), text_.c_str() + text_.size(), l);
+}
+
+
+// Initialize the buffer to read from the input stream is. The
+// first block is read immediately.
+Chunked_buffer::Chunked_buffer(std::istream& is, std::size_t n)
+  : is_(&is), fd_(-1), block_(n)
+{
+  lingo_assert(n != 0);
+  cur_.reset(new Chunk(String(), 0, {1, 1}, 0));
+  refill(cur_->end());
+}
+
+
+// Initialize the buffer to read from the file descriptor fd.
+// The first block is read immediately.
+Chunked_buffer::Chunked_buffer(int fd, std::size_t n)
+  : is_(nullptr), fd_(fd), block_(n)
+{
+  lingo_assert(n != 0);
+  cur_.reset(new Chunk(String(), 0, {1, 1}, 0));
+  refill(cur_->end());
+}
+
+
+// Read up to n characters into p, returning the number read. A
+// return of 0 indicates the end of input.
+std::size_t
+Chunked_buffer::read(char* p, std::size_t n)
+{
+  if (is_) {
+    is_->read(p, n);
+    return is_->gcount();
+  }
+  while (true) {
+    ssize_t k = ::read(fd_, p, n);
+    if (k >= 0)
+      return k;
+    if (errno != EINTR)
+      throw std::system_error(errno, std::generic_category());
   }
-  lines_.emplace(pos, Line(++line, pos, first + pos, iter));
+}
+
+
+// Read the next block of input into a new chunk. The characters
+// of the current chunk in [keep, end()) are copied to the front of
+// the new chunk. The previous chunk is released, unless the kept
+// characters begin in the previous chunk (i.e., the current chunk
+// starts with a copied lexeme, all of which is kept). In that case,
+// the current chunk is released instead. Returns false,
+// leaving the current chunk unchanged, at the end of input.
+bool
+Chunked_buffer::refill(char const* keep)
+{
+  lingo_assert(cur_->begin() <= keep && keep <= cur_->end());
+  std::size_t carry = cur_->end() - keep;
+  String text;
+  text.resize(carry + block_);
+  std::copy(keep, cur_->end(), &text[0]);
+  std::size_t n = read(&text[carry], block_);
+  if (n == 0)
+    return false;
+  text.resize(carry + n);
+
+  int off = keep - cur_->begin();
+  std::size_t origin = cur_->origin() + off;
+  Locus loc = cur_->lines().locus(off);
+  if (off != 0 || cur_->carried() == 0)
+    prev_ = std::move(cur_);
+  cur_.reset(new Chunk(std::move(text), origin, loc, carry));
+  return true;
 }
 
 
@@ -8,7 +8,8 @@
 #include <lingo/line.hpp>
 #include <lingo/location.hpp>
 
-#include <map>
+#include <iosfwd>
+#include <memory>
 
 namespace lingo
 {
@@ -24,29 +25,138 @@ namespace lingo
 // memory buffers. In particular, a file is kind of buffer
 // that is read from disk.
 //
+// The text of a buffer is not necessarily owned by the buffer
+// object. A derived class can provide text stored elsewhere
+// (e.g., a memory-mapped file), as long as that text is
+// followed by a null character.
+//
+// Each buffer is assigned a range of positions by the source
+// manager when its text is set, and releases that range when
+// it is destroyed.
+//
+// Buffers cannot be copied since the line map refers to
+// characters in the buffer.
+//
 // TODO: Provide better integration with I/O streams, etc. to
 // avoid unnecessary copies.
 class Buffer
 {
 public:
   Buffer(String const& str);
+  Buffer(String&& str);
+
+  Buffer(Buffer const&) = delete;
+  Buffer& operator=(Buffer const&) = delete;
+
+  virtual ~Buffer();
 
-  virtual ~Buffer() { }
+  // Returns the global position of the first character.
+  Location::Position base() const { return base_; }
+
+  // Returns the location of the nth character.
+  Location location(int n) const { return Location::at(base_ + n); }
 
   // Returns the line map for the buffer.
   Line_map const& lines() const { return lines_; }
 
+  // Returns the locus and line of the character at offset n.
+  virtual Locus locus(int n) const { return lines_.locus(n); }
+  virtual Line  line(int n) const  { return lines_.line(n); }
+
+  // Store the loci of the sorted offsets in [first, last) in out.
+  virtual void resolve(int const* first, int const* last, Locus* out) const
+  {
+    lines_.resolve(first, last, out);
+  }
+
   // Iterators
-  char const* begin() const { return text_.c_str(); }
-  char const* end() const   { return begin() + text_.size(); }
+  char const* begin() const { return first_; }
+  char const* end() const   { return last_; }
 
   // String representation
-  String_view   rep() const { return {begin(), end()}; }
-  String const& str() const { return text_; }
+  String_view rep() const { return {begin(), end()}; }
+  String      str() const { return {begin(), end()}; }
 
 protected:
-  String   text_;
-  Line_map lines_;
+  Buffer();
+
+  void set_text(char const*, char const*, Locus = {1, 1});
+  void reserve(std::size_t);
+
+  String      text_;  // Owned text, if any
+  char const* first_; // The beginning of the text
+  char const* last_;  // The end of the text
+  Line_map    lines_;
+  Location::Position base_;   // The first global position
+  std::size_t        extent_; // The number of reserved positions, less 1
+};
+
+
+// -------------------------------------------------------------------------- //
+// Chunked buffers
+
+// A chunk is a block of text read from a stream of input. Its
+// origin is the stream offset of its first character, and its
+// line map begins at the locus of that character, so locations
+// within a chunk report the lines and columns of the stream.
+//
+// The first characters of a chunk may be copied from the previous
+// chunk.
+class Chunk : public Buffer
+{
+public:
+  Chunk(String&&, std::size_t, Locus, std::size_t);
+
+  // Returns the stream offset of the first character.
+  std::size_t origin() const { return origin_; }
+
+  // Returns the number of characters copied from the previous
+  // chunk.
+  std::size_t carried() const { return carried_; }
+
+private:
+  std::size_t origin_;
+  std::size_t carried_;
+};
+
+
+// A chunked buffer reads a stream of text in fixed-size blocks,
+// so that input can be lexed as it arrives and memory remains
+// bounded, no matter how large the input is.
+//
+// Only the current chunk and the one before it are resident.
+// When the current chunk is exhausted, refill() reads the
+// next block into a new chunk. The characters of the current
+// chunk from a given point (usually the start of the current
+// lexeme) are copied to the front of the new chunk, so that a
+// lexeme is always contiguous.
+//
+// Locations refer to positions in a chunk. The locations of
+// characters in the two resident chunks are valid; those in
+// earlier chunks no longer resolve to a buffer. When a lexeme
+// spans several chunks, the chunk in which it starts is kept,
+// so the location of the current lexeme remains valid.
+class Chunked_buffer
+{
+public:
+  static constexpr std::size_t default_block_size = 64 * 1024;
+
+  Chunked_buffer(std::istream&, std::size_t = default_block_size);
+  Chunked_buffer(int, std::size_t = default_block_size);
+
+  // Returns the chunk being read.
+  Chunk const& current() const { return *cur_; }
+
+  bool refill(char const*);
+
+private:
+  std::size_t read(char*, std::size_t);
+
+  std::istream*          is_;    // The input stream, if any
+  int                    fd_;    // The input file, if any
+  std::size_t            block_; // The block size
+  std::unique_ptr<Chunk> prev_;  // The previous chunk
+  std::unique_ptr<Chunk> cur_;   // The current chunk
 };
 
 
@@ -0,0 +1,318 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/cache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <unordered_map>
+
+namespace lingo
+{
+
+namespace
+{
+
+// A file of diagnostics is a magic number, the number of
+// diagnostics, and the diagnostics. The version of the format is
+// part of the stamp, so that results saved in an older format are
+// never found.
+constexpr char diag_magic[4] = {'L', 'D', 'I', 'A'};
+constexpr char cache_version[] = "lingo-cache-1:";
+
+
+// A temporary file that has not been written for this many seconds
+// was left by a process that stopped before renaming it.
+constexpr std::time_t stale_time = 60 * 60;
+
+
+[[noreturn]] void
+malformed()
+{
+  throw std::runtime_error("malformed cache entry");
+}
+
+
+// A location in the file f is its offset plus one. Other locations
+// are 0, and are not valid when they are read.
+void
+write_location(Node_writer& w, File const& f, Location l)
+{
+  if (l.buffer() == &f)
+    w.write_uint(l.offset() + 1);
+  else
+    w.write_uint(0);
+}
+
+
+Location
+read_location(Node_reader& r, File& f)
+{
+  std::uint64_t n = r.read_uint();
+  if (n == 0)
+    return Location();
+  if (n - 1 > std::uint64_t(f.end() - f.begin()))
+    malformed();
+  return Location(&f, n - 1);
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+//                             Diagnostics
+
+// A diagnostic is its kind, the kind of its location, the location
+// or the start and end of the region, and its message.
+void
+write_diagnostic(Node_writer& w, File const& f, Diagnostic const& d)
+{
+  w.write_uint(d.kind);
+  w.write_uint(d.info.kind);
+  if (d.info.kind == Diagnostic_info::loc_info) {
+    write_location(w, f, d.info.data.loc);
+  } else {
+    write_location(w, f, d.info.data.reg.start_location());
+    write_location(w, f, d.info.data.reg.end_location());
+  }
+  w.write_string(d.msg);
+}
+
+
+// Read a diagnostic in the file f. Throws std::runtime_error if
+// the diagnostic is malformed.
+Diagnostic
+read_diagnostic(Node_reader& r, File& f)
+{
+  std::uint64_t k = r.read_uint();
+  std::uint64_t i = r.read_uint();
+  if (k > note_diag || i > Diagnostic_info::reg_info)
+    malformed();
+  if (i == Diagnostic_info::loc_info) {
+    Location l = read_location(r, f);
+    return Diagnostic(Diagnostic_kind(k), l, r.read_string());
+  }
+  Location s = read_location(r, f);
+  Location e = read_location(r, f);
+  if (bool(s) != bool(e))
+    malformed();
+  return Diagnostic(Diagnostic_kind(k), Region(s, e), r.read_string());
+}
+
+
+// -------------------------------------------------------------------------- //
+//                               Caches
+
+// Create the directory of the cache, if needed, and remove results
+// until its size is within the limit.
+Result_cache::Result_cache(Path const& dir, String const& stamp, std::uint64_t limit)
+  : dir_(dir), limit_(limit), size_(0), hits_(0), misses_(0), saves_(0), evictions_(0)
+{
+  String s = cache_version + stamp;
+  stamp_ = hash_bytes(s.data(), s.size());
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(dir_, ec);
+  evict(limit_);
+}
+
+
+std::uint64_t
+Result_cache::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+
+Cache_key
+Result_cache::key(File const& f) const
+{
+  std::size_t n = f.end() - f.begin();
+  return {hash_bytes(f.begin(), n), stamp_, n};
+}
+
+
+Cache_stats
+Result_cache::stats() const
+{
+  Cache_stats s;
+  s.hits = hits_;
+  s.misses = misses_;
+  s.saves = saves_;
+  s.evictions = evictions_;
+  return s;
+}
+
+
+// Returns the path of the file of the result k with the given
+// extension.
+Path
+Result_cache::path(Cache_key const& k, char const* ext) const
+{
+  char name[64];
+  std::snprintf(name, sizeof(name), "%016llx%016llx-%llx%s",
+                (unsigned long long)k.text, (unsigned long long)k.stamp,
+                (unsigned long long)k.size, ext);
+  return dir_ / name;
+}
+
+
+// Returns a unique path for a partially written file.
+Path
+Result_cache::temporary() const
+{
+  return dir_ / boost::filesystem::unique_path("tmp-%%%%-%%%%-%%%%-%%%%");
+}
+
+
+// Read the diagnostics of the result k for the file f. Returns false
+// if there is no such result, or it is malformed.
+bool
+Result_cache::load_diagnostics(Cache_key const& k, File& f, std::vector<Diagnostic>& diags)
+{
+  File_mapping map(path(k, ".diag"));
+  if (map.size() < sizeof(diag_magic) || std::memcmp(map.data(), diag_magic, sizeof(diag_magic)))
+    return false;
+  try {
+    Node_reader r(map.data() + sizeof(diag_magic), map.data() + map.size(), 0, nullptr, 0);
+    std::uint64_t n = r.read_uint();
+    if (n > map.size())
+      return false;
+    diags.reserve(n);
+    for (std::uint64_t i = 0; i < n; ++i)
+      diags.push_back(read_diagnostic(r, f));
+  } catch (std::runtime_error&) {
+    return false;
+  }
+  return true;
+}
+
+
+// Write the n diagnostics in w as the result k, and rename the tree
+// file at tree to complete it. The diagnostics are renamed first,
+// since a result is found by its tree. Removes results if the cache
+// has grown beyond its limit.
+void
+Result_cache::commit(Cache_key const& k, Path const& tree, std::size_t n, Node_writer const& w)
+{
+  Node_writer count;
+  count.write_uint(n);
+  Path tmp = temporary();
+  try {
+    std::ofstream f(tmp.native(), std::ios::binary | std::ios::trunc);
+    f.write(diag_magic, sizeof(diag_magic));
+    f.write(count.data().data(), count.data().size());
+    f.write(w.data().data(), w.data().size());
+    f.close();
+    if (!f)
+      throw std::runtime_error("cannot write cache entry");
+    boost::filesystem::rename(tmp, path(k, ".diag"));
+  } catch (std::runtime_error&) {
+    boost::system::error_code ec;
+    boost::filesystem::remove(tmp, ec);
+    throw;
+  }
+  boost::filesystem::rename(tree, path(k, ".tree"));
+  ++saves_;
+
+  boost::system::error_code ec;
+  std::uint64_t bytes = boost::filesystem::file_size(path(k, ".diag"), ec);
+  bytes += boost::filesystem::file_size(path(k, ".tree"), ec);
+  bool full;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_ += bytes;
+    full = size_ > limit_;
+  }
+
+  // Remove more than is needed, so that the directory is not scanned
+  // on every save.
+  if (full)
+    evict(limit_ - limit_ / 4);
+}
+
+
+// Mark the result k as used now.
+void
+Result_cache::touch(Cache_key const& k)
+{
+  boost::system::error_code ec;
+  boost::filesystem::last_write_time(path(k, ".tree"), std::time(nullptr), ec);
+}
+
+
+// Remove the least recently used results until the total size of
+// the results is at most n. A result was last used when its tree was
+// last written. The directory is scanned, so that results saved by
+// other processes are counted. Stale temporary files are removed.
+void
+Result_cache::evict(std::uint64_t n)
+{
+  struct Entry
+  {
+    String        name;
+    std::time_t   time;
+    std::uint64_t size;
+  };
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  boost::system::error_code ec;
+  std::unordered_map<String, Entry> found;
+  std::vector<Path> stale;
+  std::time_t now = std::time(nullptr);
+  for (boost::filesystem::directory_iterator i(dir_, ec), last; !ec && i != last; i.increment(ec)) {
+    Path const& p = i->path();
+    if (p.filename().string().compare(0, 4, "tmp-") == 0) {
+      boost::system::error_code e;
+      std::time_t time = boost::filesystem::last_write_time(p, e);
+      if (!e && now - time > stale_time)
+        stale.push_back(p);
+      continue;
+    }
+    String ext = p.extension().string();
+    if (ext != ".tree" && ext != ".diag")
+      continue;
+    String name = p.stem().string();
+    std::uint64_t size = boost::filesystem::file_size(p, ec);
+    std::time_t time = boost::filesystem::last_write_time(p, ec);
+    if (ec) {
+      ec.clear();
+      continue;
+    }
+    auto ins = found.emplace(name, Entry{name, time, 0});
+    Entry& e = ins.first->second;
+    e.size += size;
+    if (ext == ".tree" || ins.second)
+      e.time = time;
+  }
+
+  for (Path const& p : stale)
+    boost::filesystem::remove(p, ec);
+
+  std::vector<Entry> entries;
+  std::uint64_t total = 0;
+  for (auto& x : found) {
+    total += x.second.size;
+    entries.push_back(std::move(x.second));
+  }
+  std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) {
+    return a.time != b.time ? a.time < b.time : a.name < b.name;
+  });
+  for (Entry const& e : entries) {
+    if (total <= n)
+      break;
+    boost::filesystem::remove(dir_ / (e.name + ".tree"), ec);
+    boost::filesystem::remove(dir_ / (e.name + ".diag"), ec);
+    total -= e.size;
+    ++evictions_;
+  }
+  size_ = total;
+}
+
+
+} // namespace lingo
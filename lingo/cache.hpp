@@ -0,0 +1,190 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_CACHE_HPP
+#define LINGO_CACHE_HPP
+
+// The cache module saves the results of processing a file -- its
+// tree, its symbols, and its diagnostics -- in a directory, so that
+// a later run over the same text can load them instead of lexing,
+// parsing, and checking the file again. Results are keyed by a hash
+// of the text of the file and a stamp that identifies the tool, so
+// a changed file, or a new version of the tool, misses the cache.
+//
+//    Result_cache cache(dir, "mytool-1.2");
+//    Expr const* e;
+//    if (!cache.load<Expr_nodes>(file, symbols, e)) {
+//      Diagnostic_context cxt(suppress_diags);
+//      e = parse(file);
+//      cache.save<Expr_nodes>(file, e, cxt);
+//    }
+//
+// Trees are saved as tree files (see serialize.hpp). Locations
+// within nodes are not saved, but those of diagnostics are, relative
+// to the file.
+
+#include <lingo/error.hpp>
+#include <lingo/file.hpp>
+#include <lingo/serialize.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                                 Keys
+
+// The key of a cached result: the hashes of the text and of the
+// stamp of the tool, and the size of the text.
+struct Cache_key
+{
+  std::uint64_t text;
+  std::uint64_t stamp;
+  std::uint64_t size;
+};
+
+
+// Counts the requests to a cache.
+struct Cache_stats
+{
+  Cache_stats()
+    : hits(0), misses(0), saves(0), evictions(0)
+  { }
+
+  // Returns the fraction of loads that were hits.
+  double hit_rate() const
+  {
+    std::size_t n = hits + misses;
+    return n ? double(hits) / n : 0.0;
+  }
+
+  std::size_t hits;
+  std::size_t misses;
+  std::size_t saves;
+  std::size_t evictions;
+};
+
+
+// -------------------------------------------------------------------------- //
+//                               Caches
+
+// A result cache stores each result as two files in its directory,
+// named by the key: a tree file, and a file of diagnostics. The
+// total size of the files is limited. When it is exceeded, the
+// results that were least recently saved or loaded are removed.
+//
+// A cache may be shared by several threads, and its directory by
+// several processes. Results are written to temporary files that
+// are renamed when complete, so a partial result is never loaded.
+// Errors in reading the cache are treated as misses, and errors in
+// writing it are ignored.
+class Result_cache
+{
+public:
+  static constexpr std::uint64_t default_limit = std::uint64_t(256) << 20;
+
+  Result_cache(Path const&, String const&, std::uint64_t = default_limit);
+
+  Path const&   directory() const { return dir_; }
+  std::uint64_t limit() const     { return limit_; }
+  std::uint64_t size() const;
+
+  Cache_key key(File const&) const;
+
+  template<typename L, typename T>
+  bool load(File&, Symbol_table&, T const*&);
+
+  template<typename L, typename T, typename Diags>
+  void save(File const&, T const*, Diags const&);
+
+  void        evict(std::uint64_t);
+  Cache_stats stats() const;
+
+private:
+  Path path(Cache_key const&, char const*) const;
+  Path temporary() const;
+
+  bool load_diagnostics(Cache_key const&, File&, std::vector<Diagnostic>&);
+  void commit(Cache_key const&, Path const&, std::size_t, Node_writer const&);
+  void touch(Cache_key const&);
+
+  Path                     dir_;
+  std::uint64_t            stamp_;
+  std::uint64_t            limit_;
+  mutable std::mutex       mutex_;
+  std::uint64_t            size_;  // The total size of the results
+  std::atomic<std::size_t> hits_;
+  std::atomic<std::size_t> misses_;
+  std::atomic<std::size_t> saves_;
+  std::atomic<std::size_t> evictions_;
+};
+
+
+void write_diagnostic(Node_writer&, File const&, Diagnostic const&);
+Diagnostic read_diagnostic(Node_reader&, File&);
+
+
+// Load the result for the text of the file f. L is the node list of
+// the hierarchy whose base is T. If the result is cached, its
+// symbols are interned in syms, its tree is built in the current
+// arena and assigned to t, and its diagnostics are emitted in the
+// current diagnostic context. Returns false if the result is not
+// cached.
+template<typename L, typename T>
+bool
+Result_cache::load(File& f, Symbol_table& syms, T const*& t)
+{
+  Cache_key k = key(f);
+  std::vector<Diagnostic> diags;
+  if (load_diagnostics(k, f, diags)) {
+    try {
+      Tree_file<L, T> tree(path(k, ".tree"), syms);
+      if (tree) {
+        t = tree.root();
+        for (Diagnostic const& d : diags)
+          emit_diagnostic(d);
+        touch(k);
+        ++hits_;
+        return true;
+      }
+    } catch (std::runtime_error&) { }
+  }
+  ++misses_;
+  return false;
+}
+
+
+// Save the tree t and the diagnostics diags as the result for the
+// text of the file f. The tree may be null, as when the file could
+// not be parsed. The diagnostics must have messages (see
+// Diagnostic_mode).
+template<typename L, typename T, typename Diags>
+void
+Result_cache::save(File const& f, T const* t, Diags const& diags)
+{
+  Cache_key k = key(f);
+  Node_writer w;
+  std::size_t n = 0;
+  for (Diagnostic const& d : diags) {
+    write_diagnostic(w, f, d);
+    ++n;
+  }
+  Path tmp = temporary();
+  try {
+    save_tree<L>(tmp, t);
+    commit(k, tmp, n, w);
+  } catch (std::runtime_error&) {
+    boost::system::error_code ec;
+    boost::filesystem::remove(tmp, ec);
+  }
+}
+
+
+} // namespace lingo
+
+#endif
@@ -6,6 +6,12 @@
 #include "lingo/character.hpp"
 #include "lingo/error.hpp"
 
+#if defined(__SSE2__)
+#  include <immintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
+
 // TODO: Let L be the number of lines in a file. The current
 // implementation maintains a mapping of lines using an
 // sorted structure to support line lookup of offsets. However,
@@ -56,4 +62,288 @@ Character_stream::get()
 }
 
 
+// -------------------------------------------------------------------------- //
+//                           Bulk scanning
+
+namespace
+{
+
+#if defined(__AVX2__)
+
+// Returns a vector whose bytes are set where the characters of v
+// are in [lo, lo + n). This biases the unsigned difference so that
+// a signed comparison can be used.
+inline __m256i
+in_range(__m256i v, char lo, int n)
+{
+  __m256i d = _mm256_add_epi8(v, _mm256_set1_epi8(char(-128 - lo)));
+  return _mm256_cmpgt_epi8(_mm256_set1_epi8(char(-128 + n)), d);
+}
+
+
+// Returns a vector whose bytes are set where the characters of v
+// belong to classes in m. This must agree with make_char_table().
+inline __m256i
+in_class(__m256i v, std::uint8_t m)
+{
+  __m256i r = _mm256_setzero_si256();
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  if (m & space_class) {
+    r = _mm256_or_si256(r, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    r = _mm256_or_si256(r, in_range(v, '\t', 5));
+  }
+  if (m & (alpha_class | identifier_class))
+    r = _mm256_or_si256(r, in_range(lower, 'a', 26));
+  if (m & (digit_class | hex_class | identifier_class))
+    r = _mm256_or_si256(r, in_range(v, '0', 10));
+  if (m & hex_class)
+    r = _mm256_or_si256(r, in_range(lower, 'a', 6));
+  if (m & identifier_class)
+    r = _mm256_or_si256(r, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+  return r;
+}
+
+
+// Returns the first position in [first, last) whose character
+// is not in any of the classes in m.
+char const*
+find_not_in_class(char const* first, char const* last, std::uint8_t m)
+{
+  while (last - first >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(first));
+    unsigned bits = ~unsigned(_mm256_movemask_epi8(in_class(v, m)));
+    if (bits)
+      return first + __builtin_ctz(bits);
+    first += 32;
+  }
+  while (first != last && has_char_class(*first, m))
+    ++first;
+  return first;
+}
+
+#elif defined(__SSE2__)
+
+inline __m128i
+in_range(__m128i v, char lo, int n)
+{
+  __m128i d = _mm_add_epi8(v, _mm_set1_epi8(char(-128 - lo)));
+  return _mm_cmplt_epi8(d, _mm_set1_epi8(char(-128 + n)));
+}
+
+
+inline __m128i
+in_class(__m128i v, std::uint8_t m)
+{
+  __m128i r = _mm_setzero_si128();
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  if (m & space_class) {
+    r = _mm_or_si128(r, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    r = _mm_or_si128(r, in_range(v, '\t', 5));
+  }
+  if (m & (alpha_class | identifier_class))
+    r = _mm_or_si128(r, in_range(lower, 'a', 26));
+  if (m & (digit_class | hex_class | identifier_class))
+    r = _mm_or_si128(r, in_range(v, '0', 10));
+  if (m & hex_class)
+    r = _mm_or_si128(r, in_range(lower, 'a', 6));
+  if (m & identifier_class)
+    r = _mm_or_si128(r, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+  return r;
+}
+
+
+char const*
+find_not_in_class(char const* first, char const* last, std::uint8_t m)
+{
+  while (last - first >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(first));
+    unsigned bits = ~unsigned(_mm_movemask_epi8(in_class(v, m))) & 0xffff;
+    if (bits)
+      return first + __builtin_ctz(bits);
+    first += 16;
+  }
+  while (first != last && has_char_class(*first, m))
+    ++first;
+  return first;
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+inline uint8x16_t
+in_range(uint8x16_t v, char lo, int n)
+{
+  return vcltq_u8(vsubq_u8(v, vdupq_n_u8(lo)), vdupq_n_u8(n));
+}
+
+
+inline uint8x16_t
+in_class(uint8x16_t v, std::uint8_t m)
+{
+  uint8x16_t r = vdupq_n_u8(0);
+  uint8x16_t lower = vorrq_u8(v, vdupq_n_u8(0x20));
+  if (m & space_class) {
+    r = vorrq_u8(r, vceqq_u8(v, vdupq_n_u8(' ')));
+    r = vorrq_u8(r, in_range(v, '\t', 5));
+  }
+  if (m & (alpha_class | identifier_class))
+    r = vorrq_u8(r, in_range(lower, 'a', 26));
+  if (m & (digit_class | hex_class | identifier_class))
+    r = vorrq_u8(r, in_range(v, '0', 10));
+  if (m & hex_class)
+    r = vorrq_u8(r, in_range(lower, 'a', 6));
+  if (m & identifier_class)
+    r = vorrq_u8(r, vceqq_u8(v, vdupq_n_u8('_')));
+  return r;
+}
+
+
+// NEON has no byte mask extraction, so whole blocks are
+// tested, and the block containing the end of the run is
+// finished by the scalar loop.
+char const*
+find_not_in_class(char const* first, char const* last, std::uint8_t m)
+{
+  while (last - first >= 16) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<std::uint8_t const*>(first));
+    if (vminvq_u8(in_class(v, m)) == 0)
+      break;
+    first += 16;
+  }
+  while (first != last && has_char_class(*first, m))
+    ++first;
+  return first;
+}
+
+#else
+
+char const*
+find_not_in_class(char const* first, char const* last, std::uint8_t m)
+{
+  while (first != last && has_char_class(*first, m))
+    ++first;
+  return first;
+}
+
+#endif
+
+} // namespace
+
+
+// Consume the run of characters that are in any of the
+// classes in the mask m.
+void
+Character_stream::skip_while(std::uint8_t m)
+{
+  first_ = find_not_in_class(first_, last_, m);
+}
+
+
+// Consume the run of characters that are in any of the
+// classes in the mask m, and return a view of that run.
+String_view
+Character_stream::scan_while(std::uint8_t m)
+{
+  char const* p = first_;
+  first_ = find_not_in_class(first_, last_, m);
+  return {p, first_};
+}
+
+
+// -------------------------------------------------------------------------- //
+//                              Unicode
+
+
+// Returns the location of the first invalid UTF-8 sequence in the
+// remaining text, or an invalid location if the text is valid.
+Location
+Character_stream::check_utf8() const
+{
+  char const* p = find_invalid_utf8(first_, last_);
+  if (p == last_)
+    return Location();
+  return buf_.location(p - base_);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                       Chunked character streams
+
+
+// Set the stream's pointers to the start of the current chunk.
+void
+Chunked_character_stream::reset()
+{
+  base_ = first_ = lex_ = chunk().begin();
+  last_ = chunk().end();
+}
+
+
+// Read the next chunk of input, carrying the current lexeme to
+// the new chunk. Returns false at the end of input.
+bool
+Chunked_character_stream::refill()
+{
+  int n = first_ - lex_;
+  if (!buf_.refill(lex_))
+    return false;
+  base_ = lex_ = chunk().begin();
+  first_ = lex_ + n;
+  last_ = chunk().end();
+  return true;
+}
+
+
+char
+Chunked_character_stream::peek()
+{
+  if (eof())
+    return 0;
+  return *first_;
+}
+
+
+// Returns the nth character past the current position, or the
+// null character if that is past the end of input.
+char
+Chunked_character_stream::peek(int n)
+{
+  while (n >= (last_ - first_))
+    if (!refill())
+      return 0;
+  return *(first_ + n);
+}
+
+
+char
+Chunked_character_stream::get()
+{
+  if (eof())
+    return 0;
+  return *first_++;
+}
+
+
+// Consume the run of characters that are in any of the classes
+// in the mask m, refilling as needed.
+void
+Chunked_character_stream::skip_while(std::uint8_t m)
+{
+  do
+    first_ = find_not_in_class(first_, last_, m);
+  while (first_ == last_ && refill());
+}
+
+
+// Consume the run of characters that are in any of the classes
+// in the mask m, and return a view of that run. The run is
+// contiguous, even if it spans chunks.
+String_view
+Chunked_character_stream::scan_while(std::uint8_t m)
+{
+  int n = first_ - lex_;
+  skip_while(m);
+  return {lex_ + n, first_};
+}
+
+
 } // namespace lingo
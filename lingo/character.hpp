@@ -7,6 +7,7 @@
 #include <lingo/location.hpp>
 #include <lingo/buffer.hpp>
 #include <lingo/string.hpp>
+#include <lingo/unicode.hpp>
 
 namespace lingo
 {
@@ -25,6 +26,25 @@ class Buffer;
 //
 // Note that as a general rule for streams, &s.peek() == s.begin().
 //
+// The skip_while() and scan_while() functions consume the run of
+// characters from the current position that belong to any of the
+// given character classes (see Char_class). These examine many
+// characters at a time, and are the preferred way of skipping
+// whitespace and scanning identifiers or numbers.
+//
+// The stream also tracks the start of the current lexeme. A lexer
+// calls start() at the first character of a token, consumes its
+// characters, and then calls lexeme() to get a view of those
+// characters in the underlying buffer. The characters are not
+// copied.
+//
+// The stream can also be read as a sequence of Unicode code points
+// when the text is UTF-8. A lexer calls check_utf8() once, which
+// validates the remaining text, and reports the location of the
+// first invalid sequence. After that, peek_code_point() and
+// get_code_point() decode code points without further checking.
+// ASCII characters take a single comparison.
+//
 // Hypothetically, the null() function is a mechanism for creating
 // a value that contextually evaluates to false upon default construction.
 // This is a stronger concept than the NullablePointer concept.
@@ -32,7 +52,13 @@ class Character_stream
 {
 public:
   Character_stream(Buffer& b)
-    : buf_(b), base_(b.begin()), first_(base_), last_(b.end())
+    : buf_(b), base_(b.begin()), first_(base_), last_(b.end()), lex_(base_)
+  { }
+
+  // Initialize a stream over the characters [first, last) of the
+  // buffer b. Offsets and locations are those of the buffer.
+  Character_stream(Buffer& b, char const* first, char const* last)
+    : buf_(b), base_(b.begin()), first_(first), last_(last), lex_(first)
   { }
 
   // Stream control
@@ -41,14 +67,29 @@ public:
   char peek(int) const;
   char get();
   void ignore()       { get(); }
+  void advance(int);
+  void reset(char const*, char const*);
+
+  // Bulk scanning
+  void        skip_while(std::uint8_t);
+  String_view scan_while(std::uint8_t);
+
+  // Unicode
+  Location check_utf8() const;
+  char32_t peek_code_point() const;
+  char32_t get_code_point();
 
   // Locations
   int      offset() const   { return first_ - base_; }
-  Location location() const { return Location(&buf_, offset()); }
+  Location location() const { return buf_.location(offset()); }
 
   // Buffer
   Buffer const& buffer() const { return buf_; }
 
+  // Lexemes
+  void        start()        { lex_ = first_; }
+  String_view lexeme() const { return {lex_, first_}; }
+
   // Iterators
   char const* begin() const { return first_; }
   char const* end() const { return last_; }
@@ -58,9 +99,119 @@ private:
   char const*   base_;  // The beginning of the stream
   char const*   first_; // Current character pointer
   char const*   last_;  // Past the end of the character buffer
+  char const*   lex_;   // The start of the current lexeme
+};
+
+
+// Advance the stream past the next n characters, which must
+// not be past the end of the stream.
+inline void
+Character_stream::advance(int n)
+{
+  lingo_assert(0 <= n && n <= last_ - first_);
+  first_ += n;
+}
+
+
+// Restart the stream over the characters [first, last) of its
+// buffer, so that one stream can read many records.
+inline void
+Character_stream::reset(char const* first, char const* last)
+{
+  first_ = lex_ = first;
+  last_ = last;
+}
+
+
+// Returns the code point at the current position, or 0 at the end
+// of the stream. The text shall be valid UTF-8 (see check_utf8()).
+inline char32_t
+Character_stream::peek_code_point() const
+{
+  char const* p = first_;
+  return eof() ? 0 : decode_utf8(p);
+}
+
+
+// Returns the code point at the current position and advances past
+// its encoding, or returns 0 at the end of the stream. The text
+// shall be valid UTF-8 (see check_utf8()).
+inline char32_t
+Character_stream::get_code_point()
+{
+  return eof() ? 0 : decode_utf8(first_);
+}
+
+
+// A chunked character stream provides the interface of a character
+// stream over a chunked buffer. When the characters of the current
+// chunk are exhausted, the stream refills the buffer, carrying the
+// current lexeme into the new chunk. Lexing can therefore begin
+// before the input has been read, and the lexer sees each lexeme
+// as a contiguous sequence of characters.
+//
+// A lexer must call start() at the beginning of each token, since
+// the characters from the start of the lexeme are retained when
+// the buffer is refilled.
+//
+// The offset() of the stream is the offset within the entire input.
+// Because input may need to be read, the stream functions are not
+// const.
+class Chunked_character_stream
+{
+public:
+  Chunked_character_stream(Chunked_buffer& b)
+    : buf_(b)
+  {
+    reset();
+  }
+
+  // Stream control
+  bool eof();
+  char peek();
+  char peek(int);
+  char get();
+  void ignore()       { get(); }
+
+  // Bulk scanning
+  void        skip_while(std::uint8_t);
+  String_view scan_while(std::uint8_t);
+
+  // Locations
+  std::size_t offset() const  { return chunk().origin() + (first_ - base_); }
+  Location    location() const { return chunk().location(first_ - base_); }
+
+  // Buffer
+  Chunk const& chunk() const { return buf_.current(); }
+
+  // Lexemes
+  void        start()        { lex_ = first_; }
+  String_view lexeme() const { return {lex_, first_}; }
+
+  // Iterators
+  char const* begin() const { return first_; }
+  char const* end() const   { return last_; }
+
+private:
+  void reset();
+  bool refill();
+
+  Chunked_buffer& buf_;   // The stream's source
+  char const*     base_;  // The beginning of the current chunk
+  char const*     first_; // Current character pointer
+  char const*     last_;  // Past the end of the current chunk
+  char const*     lex_;   // The start of the current lexeme
 };
 
 
+// Returns true if there are no more characters.
+inline bool
+Chunked_character_stream::eof()
+{
+  return first_ == last_ && !refill();
+}
+
+
 } // namespace lingo
 
 #endif
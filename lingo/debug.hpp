@@ -6,10 +6,12 @@
 
 #include <lingo/print.hpp>
 #include <lingo/node.hpp>
+#include <lingo/dispatch.hpp>
 
 #include <iosfwd>
 #include <sstream>
 #include <iterator>
+#include <type_traits>
 #include <vector>
 
 namespace lingo
@@ -90,6 +92,14 @@ debug(Printer& p, String_view s)
 }
 
 
+// Debug print an interned string.
+inline void
+debug(Printer& p, Interned_string s)
+{
+  print_chars(p, s.begin(), s.end());
+}
+
+
 // Debug print the given element, followed by a newline.
 // This function is provided as an entry point to the
 // usual debugging facilities.
@@ -296,6 +306,232 @@ debug(Printer& p, std::vector<T const*> const& v)
 }
 
 
+// -------------------------------------------------------------------------- //
+//                              Tree printing
+//
+// The tree printer writes the same text as the debug functions above,
+// for the tree of a closed hierarchy (see dispatch.hpp). It uses an
+// explicit stack instead of recursion, so that very deep trees (e.g.,
+// long left-nested sequences) can be printed. The stack holds the
+// pending actions of the nodes that are open: at most a few for each
+// level of the tree. Text is written to the printer's stream in
+// blocks as it is produced.
+//
+// As in traversal.hpp, the sub-terms of a node that are pointers
+// convertible to T const* are its children. Other sub-terms are
+// printed by calling debug.
+
+
+// Limits on the part of a tree that is printed. Nodes deeper than
+// the depth limit, and nodes after the first n, are printed as
+// "...". A limit of 0 is unlimited. The root has depth 1.
+struct Debug_limits
+{
+  Debug_limits()
+    : depth(0), nodes(0)
+  { }
+
+  std::size_t depth;
+  std::size_t nodes;
+};
+
+
+namespace debug_impl
+{
+
+template<typename L, typename T>
+struct Tree_printer
+{
+  using Action = void (*)(Tree_printer&, void const*, std::size_t);
+
+  // An action, its argument, and the depth of its node.
+  struct Task
+  {
+    Action      fn;
+    void const* arg;
+    std::size_t depth;
+  };
+
+  Tree_printer(Printer& p, Debug_limits const& lim)
+    : p(p), lim(lim), count(0), truncated(false)
+  { }
+
+  bool run(T const*);
+
+  void push(Action fn, void const* arg, std::size_t d) { stack.push_back({fn, arg, d}); }
+
+  // Push a sub-term of a node at depth d.
+  template<typename U>
+  typename std::enable_if<std::is_convertible<U const*, T const*>::value>::type
+  push_term(U const* const& x, std::size_t d)
+  {
+    push(node_action, static_cast<T const*>(x), d + 1);
+  }
+
+  template<typename U>
+  void push_term(U const& x, std::size_t d)
+  {
+    push(term_action<U>, &x, d);
+  }
+
+  // Push the sub-terms of u, separated by spaces, in reverse order.
+  template<typename U>
+  typename std::enable_if<is_nullary_node<U>()>::type
+  push_subterms(U const*, std::size_t)
+  { }
+
+  template<typename U>
+  typename std::enable_if<is_unary_node<U>()>::type
+  push_subterms(U const* u, std::size_t d)
+  {
+    push_term(u->first, d);
+  }
+
+  template<typename U>
+  typename std::enable_if<is_binary_node<U>()>::type
+  push_subterms(U const* u, std::size_t d)
+  {
+    push_term(u->second, d);
+    push(space_action, nullptr, d);
+    push_term(u->first, d);
+  }
+
+  template<typename U>
+  typename std::enable_if<is_ternary_node<U>()>::type
+  push_subterms(U const* u, std::size_t d)
+  {
+    push_term(u->third, d);
+    push(space_action, nullptr, d);
+    push_term(u->second, d);
+    push(space_action, nullptr, d);
+    push_term(u->first, d);
+  }
+
+  template<typename U>
+  typename std::enable_if<is_kary_node<U>()>::type
+  push_subterms(U const* u, std::size_t d)
+  {
+    auto first = u->begin();
+    auto last = u->end();
+    while (first != last) {
+      --last;
+      push_term(*last, d);
+      if (first != last)
+        push(space_action, nullptr, d);
+    }
+  }
+
+  // Print the opening of the node u, and push the actions that
+  // print its sub-terms and close it. The name of each node type
+  // is found once.
+  template<typename U>
+  void open(U const* u, std::size_t d)
+  {
+    static String const name = get_node_name(u);
+    print_chars(p, '(');
+    print_chars(p, name);
+    if (!is_nullary_node<U>())
+      print_space(p);
+    push(close_action, nullptr, d);
+    push_subterms(u, d);
+  }
+
+  struct Open_fn
+  {
+    template<typename U>
+    void operator()(U const* u) const { w.open(u, d); }
+
+    Tree_printer& w;
+    std::size_t   d;
+  };
+
+  static void node_action(Tree_printer&, void const*, std::size_t);
+
+  template<typename U>
+  static void term_action(Tree_printer& w, void const* x, std::size_t)
+  {
+    debug(w.p, *static_cast<U const*>(x));
+  }
+
+  static void space_action(Tree_printer& w, void const*, std::size_t)
+  {
+    print_space(w.p);
+  }
+
+  static void close_action(Tree_printer& w, void const*, std::size_t)
+  {
+    print_chars(w.p, ')');
+  }
+
+  Printer&            p;
+  Debug_limits const& lim;
+  std::size_t         count;     // Nodes printed
+  bool                truncated; // True if a node was not printed
+  std::vector<Task>   stack;
+};
+
+
+template<typename L, typename T>
+void
+Tree_printer<L, T>::node_action(Tree_printer& w, void const* x, std::size_t d)
+{
+  T const* t = static_cast<T const*>(x);
+  if (is_empty_node(t)) {
+    debug_null(w.p);
+    return;
+  }
+  if (is_error_node(t)) {
+    debug_error(w.p);
+    return;
+  }
+  if ((w.lim.depth && d > w.lim.depth) || (w.lim.nodes && w.count == w.lim.nodes)) {
+    print_chars(w.p, "...");
+    w.truncated = true;
+    return;
+  }
+  ++w.count;
+  dispatch<L>(t, Open_fn{w, d});
+}
+
+
+template<typename L, typename T>
+bool
+Tree_printer<L, T>::run(T const* t)
+{
+  push(node_action, t, 1);
+  while (!stack.empty()) {
+    Task x = stack.back();
+    stack.pop_back();
+    x.fn(*this, x.arg, x.depth);
+  }
+  return !truncated;
+}
+
+} // namespace debug_impl
+
+
+// Debug print the tree rooted at t, whose nodes are in the node list
+// L, within the given limits. Returns false if any part of the tree
+// was omitted.
+template<typename L, typename T>
+bool
+debug_tree(Printer& p, T const* t, Debug_limits const& lim = Debug_limits())
+{
+  return debug_impl::Tree_printer<L, T>(p, lim).run(t);
+}
+
+
+// Debug print the tree rooted at t, followed by a newline.
+template<typename L, typename T>
+bool
+debug_tree(T const* t, Debug_limits const& lim = Debug_limits())
+{
+  Printer p(default_debug_stream());
+  p.needs_newline = true;
+  return debug_tree<L>(p, t, lim);
+}
+
+
 } // namespace lingo
 
 #endif
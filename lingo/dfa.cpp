@@ -0,0 +1,145 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/dfa.hpp"
+#include "lingo/error.hpp"
+
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                            Character sets
+
+// Returns the set of characters in any of the classes in the
+// mask m (see Char_class).
+Char_set
+make_char_set(std::uint8_t m)
+{
+  Char_set s;
+  for (int c = 0; c < 256; ++c)
+    if (has_char_class(char(c), m))
+      s.set(c);
+  return s;
+}
+
+
+// Returns the set of characters in str.
+Char_set
+make_char_set(String_view str)
+{
+  Char_set s;
+  for (char c : str)
+    s.set(static_cast<unsigned char>(c));
+  return s;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                          Lexical specifications
+
+// Add a rule matching the spelling s, forming tokens of kind k.
+void
+Lexical_spec::literal(String_view s, int k)
+{
+  lingo_assert(s.size() != 0);
+  rules_.push_back({String(s.begin(), s.end()), {}, {}, k, true});
+}
+
+
+// Add a rule matching a character in the set f followed by any
+// number of characters in the set r, forming tokens of kind k.
+void
+Lexical_spec::rule(Char_set const& f, Char_set const& r, int k)
+{
+  rules_.push_back({String(), f, r, k, false});
+}
+
+
+// -------------------------------------------------------------------------- //
+//                            Lexical scanners
+
+namespace
+{
+
+// A state of the nondeterministic automaton is a rule and a
+// position in that rule. For a literal, the position is the
+// number of characters matched. For a class rule, it is 0 at
+// the start and 1 after the first character.
+using Nfa_state = std::pair<int, int>;
+
+// A state of the deterministic automaton is a set of states of
+// the nondeterministic automaton, sorted by rule. Each rule has
+// at most one position in a set.
+using Nfa_set = std::vector<Nfa_state>;
+
+} // namespace
+
+
+// Build the automaton for the rules of spec by subset construction.
+Lexical_dfa::Lexical_dfa(Lexical_spec const& spec)
+{
+  std::vector<Lexical_spec::Rule> const& rules = spec.rules_;
+  for (Lexical_spec::Rule const& r : rules)
+    kinds_.push_back(r.kind);
+
+  std::map<Nfa_set, State> ids;
+  std::vector<Nfa_set> sets;
+
+  // Returns the state for the set s, adding it if needed. The
+  // state accepts the first rule that is complete in s.
+  auto intern = [&](Nfa_set const& s) -> State {
+    auto iter = ids.find(s);
+    if (iter != ids.end())
+      return iter->second;
+    if (sets.size() > 0xffff)
+      throw std::length_error("lexical automaton has too many states");
+    State n = sets.size();
+    ids.emplace(s, n);
+    sets.push_back(s);
+    int acc = -1;
+    for (Nfa_state const& x : s) {
+      Lexical_spec::Rule const& r = rules[x.first];
+      if (r.lit ? std::size_t(x.second) == r.str.size() : x.second == 1) {
+        acc = x.first;
+        break;
+      }
+    }
+    accept_.push_back(acc);
+    next_.resize(sets.size() * 256, 0);
+    return n;
+  };
+
+  intern(Nfa_set());
+  Nfa_set start;
+  for (std::size_t i = 0; i < rules.size(); ++i)
+    start.emplace_back(i, 0);
+  intern(start);
+
+  for (std::size_t i = 1; i < sets.size(); ++i) {
+    Nfa_set s = sets[i];
+    for (int c = 0; c < 256; ++c) {
+      Nfa_set t;
+      for (Nfa_state const& x : s) {
+        Lexical_spec::Rule const& r = rules[x.first];
+        if (r.lit) {
+          std::size_t k = x.second;
+          if (k < r.str.size() && static_cast<unsigned char>(r.str[k]) == c)
+            t.emplace_back(x.first, k + 1);
+        } else if (x.second == 0 ? r.first[c] : r.rest[c]) {
+          t.emplace_back(x.first, 1);
+        }
+      }
+      State n = intern(t);
+      next_[i * 256 + c] = n;
+    }
+  }
+}
+
+
+} // namespace lingo
@@ -0,0 +1,163 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_DFA_HPP
+#define LINGO_DFA_HPP
+
+// The dfa module builds table-driven scanners from a declarative
+// specification of the tokens of a language. A lexer uses the
+// scanner to find the longest token at the current position of
+// its character stream, and then builds that token.
+
+#include <lingo/string.hpp>
+#include <lingo/reserved.hpp>
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                            Character sets
+
+// A set of characters.
+using Char_set = std::bitset<256>;
+
+Char_set make_char_set(std::uint8_t);
+Char_set make_char_set(String_view);
+
+
+// -------------------------------------------------------------------------- //
+//                          Lexical specifications
+
+// A lexical specification is a list of rules, each of which denotes
+// a set of lexemes and the kind of token they form. There are two
+// kinds of rules:
+//
+//    - a literal rule matches a fixed spelling, like a punctuator
+//      or keyword, and
+//    - a class rule matches a character in a first set followed by
+//      any number of characters in a rest set, like an identifier,
+//      a number, or a run of whitespace.
+//
+// When a lexeme is matched by several rules, the rule declared first
+// applies. Keywords should therefore be declared before the class
+// rule for identifiers.
+class Lexical_spec
+{
+  friend class Lexical_dfa;
+
+public:
+  void literal(String_view, int);
+  void rule(Char_set const&, Char_set const&, int);
+
+  template<std::size_t N>
+  void literals(Reserved_table<N> const&);
+
+private:
+  struct Rule
+  {
+    String   str;   // The spelling of a literal
+    Char_set first; // The first characters of a class rule
+    Char_set rest;  // The remaining characters of a class rule
+    int      kind;
+    bool     lit;
+  };
+
+  std::vector<Rule> rules_;
+};
+
+
+// Add a literal rule for each entry of a reserved table.
+template<std::size_t N>
+void
+Lexical_spec::literals(Reserved_table<N> const& t)
+{
+  for (std::size_t i = 0; i < t.size(); ++i)
+    literal(String_view(t[i].str, t[i].str + t[i].len), t[i].kind);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                            Lexical scanners
+
+// The result of a match: the kind of the longest token, and its
+// length. The length is 0 if no token matches.
+struct Lexical_match
+{
+  int kind;
+  int len;
+};
+
+
+// A lexical DFA recognizes the tokens of a lexical specification.
+// The automaton is built once by subset construction, and stored as
+// a transition table with one row of 256 entries for each state.
+// Scanning costs one table lookup per character, and the scanner
+// reports the longest match, remembering the last accepting state
+// that it passed.
+//
+// State 0 is the dead state, and state 1 is the start state.
+class Lexical_dfa
+{
+public:
+  using State = std::uint16_t;
+
+  Lexical_dfa(Lexical_spec const&);
+
+  std::size_t states() const { return accept_.size(); }
+
+  Lexical_match match(char const*, char const*) const;
+
+  template<typename Stream>
+  Lexical_match scan(Stream&) const;
+
+private:
+  std::vector<State> next_;   // Transitions, by state and character
+  std::vector<int>   accept_; // Accepted rule of each state, or -1
+  std::vector<int>   kinds_;  // Token kinds, by rule
+};
+
+
+// Returns the longest token at the start of [first, last).
+inline Lexical_match
+Lexical_dfa::match(char const* first, char const* last) const
+{
+  State const* next = next_.data();
+  int const* accept = accept_.data();
+  State s = 1;
+  int rule = -1;
+  int len = 0;
+  for (char const* p = first; p != last; ++p) {
+    s = next[s * 256 + static_cast<unsigned char>(*p)];
+    if (s == 0)
+      break;
+    if (accept[s] >= 0) {
+      rule = accept[s];
+      len = p - first + 1;
+    }
+  }
+  if (rule < 0)
+    return {invalid_tok, 0};
+  return {kinds_[rule], len};
+}
+
+
+// Match the longest token at the current position of the character
+// stream cs, and advance the stream past that token. The stream
+// must provide begin(), end(), and advance() (see Character_stream).
+template<typename Stream>
+inline Lexical_match
+Lexical_dfa::scan(Stream& cs) const
+{
+  Lexical_match m = match(cs.begin(), cs.end());
+  cs.advance(m.len);
+  return m;
+}
+
+
+} // namespace lingo
+
+#endif
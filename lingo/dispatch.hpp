@@ -0,0 +1,164 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_DISPATCH_HPP
+#define LINGO_DISPATCH_HPP
+
+// The dispatch module applies a function object to a node of a
+// closed hierarchy by switching on the node's kind. Unlike the
+// generic visitors (see utility.hpp), this requires no virtual
+// accept or visit functions, and the function's overloads can be
+// inlined into the switch.
+
+#include <lingo/assert.hpp>
+
+#include <cstddef>
+#include <type_traits>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                            Node lists
+
+// A node list is the set of concrete node types of a closed
+// hierarchy. The base class of the hierarchy must provide a member
+// function kind() that returns the kind of a node, and each type
+// in the list must provide a static constexpr member node_kind
+// (see node.hpp) that is the kind of its objects.
+//
+// Node kinds must be distinct values in the range [0, 64). They
+// need not be listed in order.
+template<typename... Ts>
+struct Node_list
+{
+  static constexpr std::size_t size = sizeof...(Ts);
+};
+
+
+// The maximum number of node kinds supported by dispatch.
+constexpr int max_dispatch_kinds = 64;
+
+
+namespace dispatch_impl
+{
+
+// The type in Ts whose node_kind is K, or void if there is none.
+template<int K, typename... Ts>
+struct node_of
+{
+  using type = void;
+};
+
+
+template<int K, typename T, typename... Ts>
+struct node_of<K, T, Ts...>
+{
+  using type = typename std::conditional<
+    int(T::node_kind) == K, T, typename node_of<K, Ts...>::type
+  >::type;
+};
+
+
+// The first type in Ts.
+template<typename T, typename... Ts>
+struct front
+{
+  using type = T;
+};
+
+
+template<typename L>
+struct node_list_front;
+
+
+template<typename... Ts>
+struct node_list_front<Node_list<Ts...>>
+{
+  using type = typename front<Ts...>::type;
+};
+
+
+// Call f with u as a pointer to the node type T.
+template<typename R, typename T, typename U, typename F>
+inline R
+call(U const* u, F& f, T*)
+{
+  return f(static_cast<T const*>(u));
+}
+
+
+// There is no node of this kind.
+template<typename R, typename U, typename F>
+[[noreturn]] inline R
+call(U const* u, F&, void*)
+{
+  lingo_unreachable("invalid node kind {}", int(u->kind()));
+}
+
+
+template<int K, typename R, typename U, typename F, typename... Ts>
+inline R
+call_kind(U const* u, F& f, Node_list<Ts...>)
+{
+  using T = typename node_of<K, Ts...>::type;
+  return call<R>(u, f, static_cast<T*>(nullptr));
+}
+
+} // namespace dispatch_impl
+
+
+// The type returned by dispatching the function F over the node
+// list L. This is the result of calling F with the first node type.
+template<typename L, typename F>
+using dispatch_result =
+  typename std::result_of<F&(typename dispatch_impl::node_list_front<L>::type const*)>::type;
+
+
+// Apply the function f to the node u, whose dynamic type is one
+// of the types in the node list L. The function is called with a
+// pointer to the dynamic type of u, selected by a switch on its
+// kind. The return type is that of the function applied to the
+// first type in the list, and each overload must return a type
+// convertible to it.
+//
+// The switch has a case for every possible kind, so the compiler
+// can lower it to a single jump table. The cases of kinds that
+// are not in L are unreachable.
+template<typename L, typename U, typename F, typename R = dispatch_result<L, F>>
+inline R
+dispatch(U const* u, F f)
+{
+  static_assert(L::size <= max_dispatch_kinds, "too many node kinds");
+
+#define lingo_dispatch_case(K) \
+  case K: return dispatch_impl::call_kind<K, R>(u, f, L());
+
+  switch (int(u->kind())) {
+    lingo_dispatch_case(0)  lingo_dispatch_case(1)  lingo_dispatch_case(2)  lingo_dispatch_case(3)
+    lingo_dispatch_case(4)  lingo_dispatch_case(5)  lingo_dispatch_case(6)  lingo_dispatch_case(7)
+    lingo_dispatch_case(8)  lingo_dispatch_case(9)  lingo_dispatch_case(10) lingo_dispatch_case(11)
+    lingo_dispatch_case(12) lingo_dispatch_case(13) lingo_dispatch_case(14) lingo_dispatch_case(15)
+    lingo_dispatch_case(16) lingo_dispatch_case(17) lingo_dispatch_case(18) lingo_dispatch_case(19)
+    lingo_dispatch_case(20) lingo_dispatch_case(21) lingo_dispatch_case(22) lingo_dispatch_case(23)
+    lingo_dispatch_case(24) lingo_dispatch_case(25) lingo_dispatch_case(26) lingo_dispatch_case(27)
+    lingo_dispatch_case(28) lingo_dispatch_case(29) lingo_dispatch_case(30) lingo_dispatch_case(31)
+    lingo_dispatch_case(32) lingo_dispatch_case(33) lingo_dispatch_case(34) lingo_dispatch_case(35)
+    lingo_dispatch_case(36) lingo_dispatch_case(37) lingo_dispatch_case(38) lingo_dispatch_case(39)
+    lingo_dispatch_case(40) lingo_dispatch_case(41) lingo_dispatch_case(42) lingo_dispatch_case(43)
+    lingo_dispatch_case(44) lingo_dispatch_case(45) lingo_dispatch_case(46) lingo_dispatch_case(47)
+    lingo_dispatch_case(48) lingo_dispatch_case(49) lingo_dispatch_case(50) lingo_dispatch_case(51)
+    lingo_dispatch_case(52) lingo_dispatch_case(53) lingo_dispatch_case(54) lingo_dispatch_case(55)
+    lingo_dispatch_case(56) lingo_dispatch_case(57) lingo_dispatch_case(58) lingo_dispatch_case(59)
+    lingo_dispatch_case(60) lingo_dispatch_case(61) lingo_dispatch_case(62) lingo_dispatch_case(63)
+  }
+
+#undef lingo_dispatch_case
+
+  lingo_unreachable("invalid node kind {}", int(u->kind()));
+}
+
+
+} // namespace lingo
+
+#endif
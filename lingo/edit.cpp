@@ -0,0 +1,331 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/edit.hpp"
+#include "lingo/error.hpp"
+
+#include <algorithm>
+
+namespace lingo
+{
+
+namespace
+{
+
+// The number of positions reserved beyond the size of the text.
+constexpr std::size_t reserve_slack = 4096;
+
+
+// Append the offsets of the newlines in s to v. The offsets are
+// relative to n.
+void
+find_newlines(std::vector<int>& v, String_view s, int n)
+{
+  for (int i = 0; i < s.size(); ++i)
+    if (s[i] == '\n')
+      v.push_back(n + i);
+}
+
+} // namespace
+
+
+// Initialize the buffer with the given text. Until the first
+// sync(), the character sequence of the buffer is the original
+// text itself.
+Edit_buffer::Edit_buffer(String str)
+  : orig_(std::move(str)), size_(orig_.size())
+{
+  find_newlines(orig_nl_, orig_, 0);
+  if (!orig_.empty())
+    pieces_.push_back(make_piece(false, 0, orig_.size()));
+  reserve(2 * size_ + reserve_slack);
+  set_text(orig_.c_str(), orig_.c_str() + orig_.size());
+}
+
+
+String const&
+Edit_buffer::source(Piece const& p) const
+{
+  return p.added ? added_ : orig_;
+}
+
+
+std::vector<int> const&
+Edit_buffer::newlines(Piece const& p) const
+{
+  return p.added ? added_nl_ : orig_nl_;
+}
+
+
+// Returns the number of newlines in the characters [a, b) of the
+// piece p.
+int
+Edit_buffer::count_lines(Piece const& p, int a, int b) const
+{
+  std::vector<int> const& nl = newlines(p);
+  auto first = std::lower_bound(nl.begin(), nl.end(), p.start + a);
+  auto last = std::lower_bound(first, nl.end(), p.start + b);
+  return last - first;
+}
+
+
+// Returns the offset of the last newline in the first k characters
+// of the piece p, or -1 if there is none.
+int
+Edit_buffer::last_newline(Piece const& p, int k) const
+{
+  std::vector<int> const& nl = newlines(p);
+  auto iter = std::lower_bound(nl.begin(), nl.end(), p.start + k);
+  if (iter == nl.begin() || *(iter - 1) < p.start)
+    return -1;
+  return *(iter - 1) - p.start;
+}
+
+
+// Returns the offset of the first newline at or after the kth
+// character of the piece p, or -1 if there is none.
+int
+Edit_buffer::first_newline(Piece const& p, int k) const
+{
+  std::vector<int> const& nl = newlines(p);
+  auto iter = std::lower_bound(nl.begin(), nl.end(), p.start + k);
+  if (iter == nl.end() || *iter >= p.start + p.len)
+    return -1;
+  return *iter - p.start;
+}
+
+
+// Returns a piece for the n characters at offset s in the
+// original or inserted text.
+Edit_buffer::Piece
+Edit_buffer::make_piece(bool a, int s, int n) const
+{
+  Piece p {a, s, n, 0};
+  p.lines = count_lines(p, 0, n);
+  return p;
+}
+
+
+// Ensure that a piece begins at the offset n, splitting the piece
+// that contains n if needed. Returns the index of that piece, or
+// the number of pieces if n is the end of the text.
+int
+Edit_buffer::split(int n)
+{
+  int acc = 0;
+  for (std::size_t i = 0; i < pieces_.size(); ++i) {
+    Piece& p = pieces_[i];
+    if (acc == n)
+      return i;
+    if (n < acc + p.len) {
+      int k = n - acc;
+      Piece q = make_piece(p.added, p.start + k, p.len - k);
+      p = make_piece(p.added, p.start, k);
+      pieces_.insert(pieces_.begin() + i + 1, q);
+      return i + 1;
+    }
+    acc += p.len;
+  }
+  return pieces_.size();
+}
+
+
+// Insert the text s at the offset n. When text is inserted just
+// after the previous insertion, as when typing, the piece holding
+// that insertion is extended.
+void
+Edit_buffer::insert(int n, String_view s)
+{
+  lingo_assert(0 <= n && std::size_t(n) <= size_);
+  if (s.size() == 0)
+    return;
+  int start = added_.size();
+  find_newlines(added_nl_, s, start);
+  added_.append(s.begin(), s.end());
+
+  int i = split(n);
+  Piece* prev = i > 0 ? &pieces_[i - 1] : nullptr;
+  if (prev && prev->added && prev->start + prev->len == start)
+    *prev = make_piece(true, prev->start, prev->len + s.size());
+  else
+    pieces_.insert(pieces_.begin() + i, make_piece(true, start, s.size()));
+
+  size_ += s.size();
+  log_.push_back({n, 0, int(s.size())});
+}
+
+
+// Erase the characters in [first, last).
+void
+Edit_buffer::erase(int first, int last)
+{
+  lingo_assert(0 <= first && first <= last && std::size_t(last) <= size_);
+  if (first == last)
+    return;
+  int i = split(first);
+  int j = split(last);
+  pieces_.erase(pieces_.begin() + i, pieces_.begin() + j);
+
+  size_ -= last - first;
+  log_.push_back({first, last - first, 0});
+}
+
+
+// Returns a copy of the current text.
+String
+Edit_buffer::text() const
+{
+  String s;
+  s.reserve(size_);
+  for (Piece const& p : pieces_)
+    s.append(source(p), p.start, p.len);
+  return s;
+}
+
+
+// Update the character sequence of the buffer to the current text.
+// The range of positions of the buffer is replaced only if the text
+// has grown past the reserved positions.
+void
+Edit_buffer::sync()
+{
+  if (size_ > extent_)
+    reserve(2 * size_ + reserve_slack);
+  text_ = text();
+  set_text(text_.c_str(), text_.c_str() + text_.size());
+}
+
+
+// Returns the locus of the character at offset n. This finds the
+// piece containing n, counting the newlines in the pieces before
+// it. The column is determined by the nearest preceding newline.
+Locus
+Edit_buffer::locus(int n) const
+{
+  lingo_assert(0 <= n && std::size_t(n) <= size_);
+  int acc = 0;
+  int line = 1;
+  std::size_t i = 0;
+  for (; i < pieces_.size() && acc + pieces_[i].len <= n; ++i) {
+    acc += pieces_[i].len;
+    line += pieces_[i].lines;
+  }
+
+  // Look for a newline in the piece containing n.
+  if (i < pieces_.size()) {
+    Piece const& p = pieces_[i];
+    int k = n - acc;
+    line += count_lines(p, 0, k);
+    int q = last_newline(p, k);
+    if (q >= 0)
+      return {line, k - q};
+  }
+
+  // Look for a newline in a preceding piece.
+  for (std::size_t j = i; j-- > 0;) {
+    Piece const& p = pieces_[j];
+    acc -= p.len;
+    if (p.lines)
+      return {line, n - acc - last_newline(p, p.len)};
+  }
+  return {line, n + 1};
+}
+
+
+// Store the loci of the sorted offsets in [first, last) in out.
+void
+Edit_buffer::resolve(int const* first, int const* last, Locus* out) const
+{
+  while (first != last)
+    *out++ = locus(*first++);
+}
+
+
+// Returns the line containing the character at offset n. The text
+// of the line is copied, and remains valid until the next call.
+Line
+Edit_buffer::line(int n) const
+{
+  Locus loc = locus(n);
+  int start = n - loc.second + 1;
+
+  line_.clear();
+  int acc = 0;
+  for (Piece const& p : pieces_) {
+    if (acc + p.len <= start) {
+      acc += p.len;
+      continue;
+    }
+    int k = std::max(start - acc, 0);
+    int q = first_newline(p, k);
+    String const& s = source(p);
+    line_.append(s, p.start + k, (q < 0 ? p.len : q) - k);
+    if (q >= 0)
+      break;
+    acc += p.len;
+  }
+  return Line(loc.first, start, line_.data(), line_.data() + line_.size());
+}
+
+
+// Returns the offset in the current text of the character at the
+// offset n in version v of the text. Characters that have been
+// erased are mapped to the offset of the erasure.
+int
+Edit_buffer::remap(int n, Version v) const
+{
+  lingo_assert(v <= log_.size());
+  for (auto iter = log_.begin() + v; iter != log_.end(); ++iter) {
+    Edit const& e = *iter;
+    if (n >= e.off + e.erased)
+      n += e.inserted - e.erased;
+    else if (n > e.off)
+      n = e.off;
+  }
+  return n;
+}
+
+
+// Returns the location in the current text of the location loc
+// in version v of the text.
+Location
+Edit_buffer::remap(Location loc, Version v) const
+{
+  lingo_assert(loc.buffer() == this);
+  return location(remap(loc.offset(), v));
+}
+
+
+// Returns a single edit that transforms version v of the text into
+// the current text. The edit replaces the smallest range of version
+// v that contains every change made since then. If no changes have
+// been made, the edit is empty.
+Edit_buffer::Edit
+Edit_buffer::changes(Version v) const
+{
+  lingo_assert(v <= log_.size());
+  if (v == log_.size())
+    return {0, 0, 0};
+
+  // Maintain the range [first, last) of the text that contains
+  // all changes, and the change in size.
+  int first = log_[v].off;
+  int last = first + log_[v].inserted;
+  int delta = log_[v].inserted - log_[v].erased;
+  for (auto iter = log_.begin() + v + 1; iter != log_.end(); ++iter) {
+    Edit const& e = *iter;
+    if (last >= e.off + e.erased)
+      last += e.inserted - e.erased;
+    else if (last > e.off)
+      last = e.off;
+    first = std::min(first, e.off);
+    last = std::max(last, e.off + e.inserted);
+    delta += e.inserted - e.erased;
+  }
+  return {first, last - delta - first, last - first};
+}
+
+
+} // namespace lingo
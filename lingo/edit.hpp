@@ -0,0 +1,117 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_EDIT_HPP
+#define LINGO_EDIT_HPP
+
+// The edit module provides an editable buffer for use by editors
+// and language servers, which change a buffer with every keystroke.
+
+#include <lingo/buffer.hpp>
+
+#include <vector>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+// Edit buffers
+
+// An edit buffer is a buffer whose text can be changed by inserting
+// and erasing characters. The text is represented by a piece table:
+// a sequence of pieces, each of which refers to a run of characters
+// in either the original text or an append-only buffer of inserted
+// text. An edit splits at most two pieces, so its cost depends on
+// the number of pieces, and not the length of the text.
+//
+// Each source of text records the offsets of its newlines, and each
+// piece caches the number of newlines it contains. Lines and columns
+// are computed from the pieces, so an edit does not rebuild the
+// lines of the buffer.
+//
+// The character sequence of the buffer (i.e., begin() and end())
+// reflects the text as of the most recent call to sync(), which
+// must be called before the buffer is lexed. Offsets passed to and
+// returned from the other members refer to the current text.
+//
+// Each edit is recorded in a log. A location or offset obtained at
+// some version of the text can be remapped to the same character in
+// the current text. The buffer reserves extra positions so that its
+// range of positions, and hence its locations, remain valid as the
+// text grows, until sync() needs more positions than were reserved.
+//
+// Edit buffers cannot be used concurrently.
+class Edit_buffer : public Buffer
+{
+public:
+  using Version = std::size_t;
+
+  // An edit replacing n characters at offset off with k
+  // characters.
+  struct Edit
+  {
+    int off;
+    int erased;
+    int inserted;
+  };
+
+  Edit_buffer(String);
+
+  // Returns the number of characters in the current text.
+  std::size_t size() const { return size_; }
+
+  // Returns the number of edits made to the buffer.
+  Version version() const { return log_.size(); }
+
+  // Editing
+  void insert(int, String_view);
+  void erase(int, int);
+
+  // Returns the current text.
+  String text() const;
+  void   sync();
+
+  // Lines and columns of the current text.
+  Locus locus(int) const override;
+  Line  line(int) const override;
+  void  resolve(int const*, int const*, Locus*) const override;
+
+  // Remapping
+  int      remap(int, Version) const;
+  Location remap(Location, Version) const;
+  Edit     changes(Version) const;
+
+private:
+  // A run of n characters starting at offset s in one of the
+  // sources of text, containing k newlines.
+  struct Piece
+  {
+    bool added;
+    int  start;
+    int  len;
+    int  lines;
+  };
+
+  String const&           source(Piece const&) const;
+  std::vector<int> const& newlines(Piece const&) const;
+
+  int   count_lines(Piece const&, int, int) const;
+  int   last_newline(Piece const&, int) const;
+  int   first_newline(Piece const&, int) const;
+  Piece make_piece(bool, int, int) const;
+  int   split(int);
+
+  String             orig_;     // The original text
+  String             added_;    // The inserted text
+  std::vector<int>   orig_nl_;  // Newlines in the original text
+  std::vector<int>   added_nl_; // Newlines in the inserted text
+  std::vector<Piece> pieces_;
+  std::vector<Edit>  log_;
+  std::size_t        size_;
+  mutable String     line_;     // The text of the last line()
+};
+
+
+} // namespace lingo
+
+#endif
@@ -4,8 +4,14 @@
 #ifndef LINGO_ENVIRONMENT_HPP
 #define LINGO_ENVIRONMENT_HPP
 
+#include <lingo/small_map.hpp>
+
 #include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace lingo
@@ -15,12 +21,14 @@ namespace lingo
 // Binding environment
 
 // The environment maintains all active bindings at
-// a certain point in the program.
+// a certain point in the program. Most environments are small,
+// so they are stored in a small map. Binding a name invalidates
+// the bindings returned by lookup.
 template<typename S, typename T>
-struct Environment : std::unordered_map<S, T>
+struct Environment : Small_map<S, T>
 {
 private:
-  using Map = std::unordered_map<S, T>;
+  using Map = Small_map<S, T>;
 
 public:
   using Name_type = S;
@@ -205,6 +213,302 @@ Stack<E>::lookup(Name_type const& n) -> Binding*
 }
 
 
+// -------------------------------------------------------------------------- //
+// Scoped environment
+
+// A scoped environment maintains the bindings of nested scopes in a
+// single table that maps each name to its innermost binding. When a
+// binding shadows another, the shadowed binding is saved on a stack,
+// and restored when its scope is popped. Lookup is a single hash
+// probe, however deeply scopes are nested, and pushing or popping
+// a scope takes time proportional to the bindings made in it.
+template<typename S, typename T>
+struct Scoped_environment
+{
+private:
+  using Map = std::unordered_map<S, T>;
+
+  // A binding replaced by an inner scope. If bound is false, the
+  // name had no binding.
+  struct Saved
+  {
+    S    name;
+    bool bound;
+    T    value;
+  };
+
+public:
+  using Name_type = S;
+  using Value_type = T;
+  using Binding = typename Map::value_type;
+
+  void push_scope();
+  void pop_scope();
+
+  Binding& bind(S const&, T const&);
+
+  Binding const* lookup(S const&) const;
+  Binding*       lookup(S const&);
+
+  // Returns the number of open scopes.
+  std::size_t depth() const { return scopes_.size(); }
+
+  Map                      map_;
+  std::vector<Saved>       saved_;
+  std::vector<std::size_t> scopes_;
+};
+
+
+// Enter a new scope.
+template<typename S, typename T>
+inline void
+Scoped_environment<S, T>::push_scope()
+{
+  scopes_.push_back(saved_.size());
+}
+
+
+// Leave the innermost scope, restoring the bindings that it
+// shadowed in reverse order.
+template<typename S, typename T>
+void
+Scoped_environment<S, T>::pop_scope()
+{
+  assert(!scopes_.empty());
+  std::size_t n = scopes_.back();
+  scopes_.pop_back();
+  while (saved_.size() != n) {
+    Saved& b = saved_.back();
+    if (b.bound)
+      map_.find(b.name)->second = std::move(b.value);
+    else
+      map_.erase(b.name);
+    saved_.pop_back();
+  }
+}
+
+
+// Bind the symbol to the entity in the innermost scope. Any existing
+// binding of the symbol is shadowed until that scope is popped.
+// Bindings made outside of any scope are never restored.
+template<typename S, typename T>
+auto
+Scoped_environment<S, T>::bind(S const& sym, T const& ent) -> Binding&
+{
+  auto ins = map_.emplace(sym, ent);
+  if (!scopes_.empty())
+    saved_.push_back({sym, !ins.second, ins.second ? ent : ins.first->second});
+  if (!ins.second)
+    ins.first->second = ent;
+  return *ins.first;
+}
+
+
+// Returns the innermost binding of the symbol, or nullptr if
+// it is not bound.
+template<typename S, typename T>
+inline auto
+Scoped_environment<S, T>::lookup(S const& sym) const -> Binding const*
+{
+  auto iter = map_.find(sym);
+  return iter == map_.end() ? nullptr : &*iter;
+}
+
+
+template<typename S, typename T>
+inline auto
+Scoped_environment<S, T>::lookup(S const& sym) -> Binding*
+{
+  auto iter = map_.find(sym);
+  return iter == map_.end() ? nullptr : &*iter;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Persistent environment
+
+// A persistent environment is an immutable map from names to values.
+// Binding a name returns a new environment, and leaves the original
+// unchanged, so that a closure can capture the environment in which
+// it was created without copying it.
+//
+// The environment is a hash array mapped trie: each level of the
+// tree consumes 5 bits of the hash of a name, and each node stores
+// only its populated children, indexed by a bitmap. Binding a name
+// copies only the nodes on the path to its binding, which is
+// logarithmic in the size of the environment, and shares the rest.
+template<typename S, typename T, typename H = std::hash<S>>
+struct Persistent_environment
+{
+  using Name_type = S;
+  using Value_type = T;
+  using Binding = std::pair<S, T>;
+
+  Persistent_environment()
+    : root_(), size_(0)
+  { }
+
+  Persistent_environment bind(S const&, T const&) const;
+
+  Binding const* lookup(S const&) const;
+
+  // Returns the number of bound names.
+  std::size_t size() const { return size_; }
+  bool        empty() const { return size_ == 0; }
+
+  template<typename F>
+  void for_each(F) const;
+
+private:
+  struct Node;
+  using Node_ptr = std::shared_ptr<Node const>;
+
+  static constexpr int bits = 5;
+  static constexpr int hash_bits = 8 * sizeof(std::size_t);
+
+  // A slot is a child node, or a binding and the hash of its name.
+  struct Slot
+  {
+    Node_ptr    child;
+    std::size_t hash;
+    Binding     binding;
+  };
+
+  // A node holds the slots indicated by its bitmap, in order. Names
+  // whose hashes are equal share a node below the last level, which
+  // holds its slots in a list.
+  struct Node
+  {
+    std::uint32_t     map;
+    std::vector<Slot> slots;
+  };
+
+  static Node_ptr insert(Node const*, Slot const&, int, bool&);
+
+  template<typename F>
+  static void for_each(Node const*, F&);
+
+  Persistent_environment(Node_ptr r, std::size_t n)
+    : root_(std::move(r)), size_(n)
+  { }
+
+  Node_ptr    root_;
+  std::size_t size_;
+};
+
+
+// Returns a copy of the node n (or a new node, if n is null) in which
+// the slot s is inserted at the level beginning with the given bit
+// of its hash. Sets added to true if the name of s was not bound.
+template<typename S, typename T, typename H>
+auto
+Persistent_environment<S, T, H>::insert(Node const* n, Slot const& s, int shift, bool& added)
+  -> Node_ptr
+{
+  std::shared_ptr<Node> r = n ? std::make_shared<Node>(*n) : std::make_shared<Node>(Node{0, {}});
+
+  // Below the last level, the names of all slots have the same hash.
+  if (shift >= hash_bits) {
+    for (Slot& x : r->slots) {
+      if (x.binding.first == s.binding.first) {
+        x.binding.second = s.binding.second;
+        return r;
+      }
+    }
+    r->slots.push_back(s);
+    added = true;
+    return r;
+  }
+
+  std::uint32_t bit = std::uint32_t(1) << ((s.hash >> shift) & 31);
+  std::size_t pos = __builtin_popcount(r->map & (bit - 1));
+  if (!(r->map & bit)) {
+    r->map |= bit;
+    r->slots.insert(r->slots.begin() + pos, s);
+    added = true;
+    return r;
+  }
+
+  Slot& x = r->slots[pos];
+  if (x.child) {
+    x.child = insert(x.child.get(), s, shift + bits, added);
+  } else if (x.hash == s.hash && x.binding.first == s.binding.first) {
+    x.binding.second = s.binding.second;
+  } else {
+    // Push the existing binding down a level, along with s.
+    bool ignored;
+    Node_ptr c = insert(nullptr, x, shift + bits, ignored);
+    x.child = insert(c.get(), s, shift + bits, added);
+  }
+  return r;
+}
+
+
+// Returns an environment in which the symbol is bound to the entity,
+// replacing any existing binding of the symbol.
+template<typename S, typename T, typename H>
+auto
+Persistent_environment<S, T, H>::bind(S const& sym, T const& ent) const
+  -> Persistent_environment
+{
+  bool added = false;
+  Slot s {nullptr, H()(sym), Binding(sym, ent)};
+  Node_ptr r = insert(root_.get(), s, 0, added);
+  return Persistent_environment(std::move(r), size_ + added);
+}
+
+
+// Returns the binding of the symbol, or nullptr if it is not bound.
+template<typename S, typename T, typename H>
+auto
+Persistent_environment<S, T, H>::lookup(S const& sym) const -> Binding const*
+{
+  std::size_t h = H()(sym);
+  Node const* n = root_.get();
+  for (int shift = 0; n; shift += bits) {
+    if (shift >= hash_bits) {
+      for (Slot const& x : n->slots)
+        if (x.binding.first == sym)
+          return &x.binding;
+      return nullptr;
+    }
+    std::uint32_t bit = std::uint32_t(1) << ((h >> shift) & 31);
+    if (!(n->map & bit))
+      return nullptr;
+    Slot const& x = n->slots[__builtin_popcount(n->map & (bit - 1))];
+    if (!x.child)
+      return x.hash == h && x.binding.first == sym ? &x.binding : nullptr;
+    n = x.child.get();
+  }
+  return nullptr;
+}
+
+
+// Call f for each binding, in an unspecified order.
+template<typename S, typename T, typename H>
+template<typename F>
+inline void
+Persistent_environment<S, T, H>::for_each(F f) const
+{
+  if (root_)
+    for_each(root_.get(), f);
+}
+
+
+template<typename S, typename T, typename H>
+template<typename F>
+void
+Persistent_environment<S, T, H>::for_each(Node const* n, F& f)
+{
+  for (Slot const& x : n->slots) {
+    if (x.child)
+      for_each(x.child.get(), f);
+    else
+      f(x.binding);
+  }
+}
+
+
 } // namespace lingo
 
 #endif
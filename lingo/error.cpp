@@ -4,9 +4,14 @@
 #include "config.hpp"
 
 #include "lingo/error.hpp"
+#include "lingo/file.hpp"
 #include "lingo/io.hpp"
+#include "lingo/profile.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <stdexcept>
 #include <stack>
 
@@ -16,20 +21,23 @@ namespace lingo
 namespace
 {
 
-// Print the source code location for a bound location
-// or span.
-void
-show_location(std::ostream& os, Diagnostic_info const& info)
+// Returns the start of the text the diagnostic refers to.
+inline Location
+start_of(Diagnostic_info const& info)
 {
-  if (info.kind == Diagnostic_info::loc_info) {
-    Location const& loc = info.data.loc;
-    if (loc)
-      os << bright_white(loc) << ':';
-  } else {
-    Region const& reg = info.data.reg;
-    if (reg)
-      os << bright_white(reg) << ':';
-  }
+  if (info.kind == Diagnostic_info::loc_info)
+    return info.data.loc;
+  return info.data.reg.start_location();
+}
+
+
+// Returns the end of the text the diagnostic refers to.
+inline Location
+end_of(Diagnostic_info const& info)
+{
+  if (info.kind == Diagnostic_info::loc_info)
+    return info.data.loc;
+  return info.data.reg.end_location();
 }
 
 
@@ -38,19 +46,18 @@ char const* indent_ = "|    ";
 
 
 // Show the line at which an error occurred along with a second
-// line showing the context. The location must be valid.
+// line showing the context.
 //
 // TODO: How much should we indent the context?
 //
 // TODO: Show line numbers in the context?
 void
-show_line(std::ostream& os, Location const& loc)
+show_line(std::ostream& os, Line const& line, Locus loc)
 {
-  Line const& line = loc.line();
   os << indent_ << line.str() << '\n';
 
   // Show the caret, but only if if the caret is valid.
-  int caret = loc.column_number();
+  int caret = loc.second;
   if (caret < 0)
     return;
   os << indent_ << std::string(caret - 1, ' ');
@@ -60,9 +67,8 @@ show_line(std::ostream& os, Location const& loc)
 
 // TODO: What if we have multiple lines in the region?
 void
-show_region(std::ostream& os, Region const& reg)
+show_region(std::ostream& os, Line const& line, Locus start, Locus end)
 {
-  Line const& line = reg.line();
   os << indent_ << line.str() << '\n';
 
   // TODO: Do something better than this. We could print
@@ -73,69 +79,215 @@ show_region(std::ostream& os, Region const& reg)
   //  > line3
   //
   // Where '>' serves as the caret.
-  if (reg.is_multiline()) {
+  if (start.first != end.first) {
     os << indent_ << "...";
     return;
   }
 
   // Show the underscore, but only if the start position is valid.
-  int start = reg.start_column_number() - 1;
-  int end = reg.end_column_number();
-  if (start < 0)
+  int first = start.second - 1;
+  int last = end.second;
+  if (first < 0)
     return;
-  os << indent_ << std::string(start, ' ');
-  os << bright_red(std::string(end - start, '~')) << '\n';
+  os << indent_ << std::string(first, ' ');
+  os << bright_red(std::string(last - first, '~')) << '\n';
 }
 
 
-} // namespace
+// Show the diagnostic, whose text starts and ends at the given
+// loci. Nothing is shown of text that has been released.
+void
+show(std::ostream& os, Diagnostic const& diag, Locus start, Locus end)
+{
+  Location loc = start_of(diag.info);
+  Buffer const* buf = loc.buffer();
+  os << diag.kind << ':';
+  if (buf) {
+    std::stringstream ss;
+    if (File const* f = as<File>(buf))
+      ss << f->path().string() << ':';
+    ss << start.first << ':' << start.second;
+    os << bright_white(ss.str()) << ':';
+  }
+  os << ' ' << diag.msg << '\n';
+  if (buf) {
+    Line line = buf->line(loc.position() - buf->base());
+    if (diag.info.kind == Diagnostic_info::loc_info)
+      show_line(os, line, start);
+    else
+      show_region(os, line, start, end);
+  }
+}
 
 
-std::ostream&
-operator<<(std::ostream& os, Diagnostic_kind k)
+char const*
+kind_name(Diagnostic_kind k)
 {
   switch (k) {
-    case error_diag: return os << bright_red("error");
-    case warning_diag: return os << bright_magenta("warning");
-    case note_diag: return os << bright_cyan("note");
+    case error_diag: return "error";
+    case warning_diag: return "warning";
+    case note_diag: return "note";
     default: break;
   }
   lingo_unreachable("unknown diagnostic kind '{}'", (int)k);
 }
 
 
+// Show the diagnostic as a single line of tab-separated fields.
 void
-show_context(std::ostream& os, Diagnostic_info const& info)
+show_compact(std::ostream& os, Diagnostic const& diag, Locus start, Locus end)
 {
-  if (info.kind == Diagnostic_info::loc_info) {
-    Location const& loc = info.data.loc;
-    if (loc) {
-      show_line(os, loc);
+  File const* f = start_of(diag.info).file();
+  os << kind_name(diag.kind) << '\t';
+  if (f)
+    os << f->path().string();
+  os << '\t' << start.first << '\t' << start.second
+     << '\t' << end.first << '\t' << end.second << '\t';
+  for (char c : diag.msg) {
+    switch (c) {
+      case '\\': os << "\\\\"; break;
+      case '\t': os << "\\t"; break;
+      case '\n': os << "\\n"; break;
+      default: os << c; break;
     }
-  } else {
-    Region const& reg = info.data.reg;
-    if (reg)
-      show_region(os, reg);
   }
+  os << '\n';
+}
+
+
+} // namespace
+
+
+std::ostream&
+operator<<(std::ostream& os, Diagnostic_kind k)
+{
+  switch (k) {
+    case error_diag: return os << bright_red(kind_name(k));
+    case warning_diag: return os << bright_magenta(kind_name(k));
+    case note_diag: return os << bright_cyan(kind_name(k));
+    default: break;
+  }
+  lingo_unreachable("unknown diagnostic kind '{}'", (int)k);
 }
 
 
+// Each end of the diagnostic's text is resolved once.
 std::ostream&
 operator<<(std::ostream& os, Diagnostic const& diag)
 {
-  os << diag.kind << ':';
-  show_location(os, diag.info);
-  os << ' ' << diag.msg << '\n';
-  show_context(os, diag.info);
+  Location start = start_of(diag.info);
+  Location end = end_of(diag.info);
+  Locus first = start.buffer() ? start.locus() : Locus(0, 0);
+  Locus last = first;
+  if (end != start)
+    last = end.buffer() ? end.locus() : Locus(0, 0);
+  show(os, diag, first, last);
   return os;
 }
 
 
+// -------------------------------------------------------------------------- //
+//                          Diagnostic sinks
+
+Stream_sink::Stream_sink(std::ostream& os, Diagnostic_format f, std::size_t n)
+  : os_(os), format_(f), limit_(n)
+{ }
+
+
+Stream_sink::~Stream_sink()
+{
+  flush_pending();
+}
+
+
+void
+Stream_sink::write(Diagnostic const& diag)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  diags_.push_back(diag);
+  if (diags_.size() >= limit_)
+    flush_pending();
+}
+
+
+void
+Stream_sink::flush()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  flush_pending();
+}
+
+
+// Resolve the locations of the pending diagnostics together, and
+// write their text in a single operation.
+void
+Stream_sink::flush_pending()
+{
+  if (diags_.empty())
+    return;
+  lingo_profile("write diagnostics");
+  std::vector<Location> locs;
+  locs.reserve(2 * diags_.size());
+  for (Diagnostic const& diag : diags_) {
+    locs.push_back(start_of(diag.info));
+    locs.push_back(end_of(diag.info));
+  }
+  std::vector<Locus> loci = resolve(locs);
+
+  std::stringstream ss;
+  ss.iword(ios_color_flag) = os_.iword(ios_color_flag);
+  for (std::size_t i = 0; i < diags_.size(); ++i) {
+    if (format_ == compact_diags)
+      show_compact(ss, diags_[i], loci[2 * i], loci[2 * i + 1]);
+    else
+      show(ss, diags_[i], loci[2 * i], loci[2 * i + 1]);
+  }
+  diags_.clear();
+
+  std::string text = ss.str();
+  os_.write(text.data(), text.size());
+  os_.flush();
+}
+
+
+namespace
+{
+
+std::atomic<Diagnostic_sink*> sink_(nullptr);
+
+
+} // namespace
+
+
+// Returns the sink to which diagnostics are reported. By default,
+// this writes text to std::cerr.
+Diagnostic_sink&
+diagnostic_sink()
+{
+  static Stream_sink cerr_sink(std::cerr);
+  Diagnostic_sink* s = sink_;
+  return s ? *s : cerr_sink;
+}
+
+
+// Report diagnostics to s, or to the default sink if s is null. The
+// current sink is flushed. Returns the previous sink, or null if
+// that was the default.
+Diagnostic_sink*
+set_diagnostic_sink(Diagnostic_sink* s)
+{
+  diagnostic_sink().flush();
+  return sink_.exchange(s);
+}
+
+
 namespace
 {
 
-// The diagnostic stack.
-std::stack<Diagnostic_context*> diags_;
+// The diagnostic stack. Each thread has its own stack, so that
+// work running on other threads can collect its diagnostics in
+// its own context.
+thread_local std::stack<Diagnostic_context*> diags_;
 
 
 // The root diagnostic context. Note that this self-registers
@@ -143,6 +295,15 @@ std::stack<Diagnostic_context*> diags_;
 Diagnostic_context root_;
 
 
+// Returns the current diagnostic context. A thread that has not
+// declared a context uses the root context.
+inline Diagnostic_context*
+current_context()
+{
+  return diags_.empty() ? &root_ : diags_.top();
+}
+
+
 } // namespace
 
 
@@ -156,8 +317,26 @@ Diagnostic::Diagnostic(Diagnostic_kind k, Region s, String const& m)
 { }
 
 
+// Format the message, if it was deferred.
+void
+Diagnostic::format_message()
+{
+  if (fmt) {
+    msg = fmt();
+    fmt = nullptr;
+  }
+}
+
+
 Diagnostic_context::Diagnostic_context(bool suppress)
-  : suppress_(suppress), errs_(0)
+  : suppress_(suppress), discard_(false), errs_(0)
+{
+  diags_.push(this);
+}
+
+
+Diagnostic_context::Diagnostic_context(Diagnostic_mode m)
+  : suppress_(m != report_diags), discard_(m == discard_diags), errs_(0)
 {
   diags_.push(this);
 }
@@ -169,17 +348,41 @@ Diagnostic_context::~Diagnostic_context()
 }
 
 
+Diagnostic_mode
+Diagnostic_context::mode() const
+{
+  if (discard_)
+    return discard_diags;
+  return suppress_ ? suppress_diags : report_diags;
+}
+
+
+// Format the deferred messages of the saved diagnostics. This does
+// not change what the diagnostics report, so it is done when the
+// context is inspected, even if it is const.
+void
+Diagnostic_context::format_messages() const
+{
+  auto& self = const_cast<Diagnostic_context&>(*this);
+  for (Diagnostic& d : static_cast<std::vector<Diagnostic>&>(self))
+    d.format_message();
+}
+
+
 // Emit a single diagnostic. If this context is suppressing
 // diagnostics, then save them for later.
 void
-Diagnostic_context::emit(Diagnostic const& diag)
+Diagnostic_context::emit(Diagnostic diag)
 {
+  lingo_count("diagnostics", 1);
   if (diag.kind == error_diag)
     ++ errs_;
-  if (suppress_)
-    push_back(diag);
-  else
-    std::cerr << diag;
+  if (suppress_) {
+    push_back(std::move(diag));
+  } else {
+    diag.format_message();
+    diagnostic_sink().write(diag);
+  }
 }
 
 
@@ -197,9 +400,59 @@ Diagnostic_context::reset()
 void
 Diagnostic_context::emit()
 {
+  lingo_profile("emit diagnostics");
   if (suppress_)
     for (Diagnostic const& diag : *this)
-      std::cerr << diag;
+      diagnostic_sink().write(diag);
+}
+
+
+// Emit the diagnostic in the current context. This is useful for
+// replaying diagnostics saved in another context.
+void
+emit_diagnostic(Diagnostic diag)
+{
+  current_context()->emit(std::move(diag));
+}
+
+
+// Emit, in the current context, the diagnostics collected by tasks
+// that ran concurrently. The order does not depend on the order in
+// which the tasks ran or finished. Diagnostics are ordered by their
+// source location: by buffer, in order of their creation, and then
+// by offset. A note stays with the diagnostic that precedes it, and
+// diagnostics without a location come last. Diagnostics at the same
+// location stay in the order they were collected.
+void
+merge_diagnostics(std::vector<std::vector<Diagnostic>> const& diags)
+{
+  // A group is a diagnostic and the notes that follow it, keyed by
+  // the position of its first diagnostic.
+  struct Group
+  {
+    Location::Position  pos;
+    Diagnostic const*   first;
+    Diagnostic const*   last;
+  };
+  std::vector<Group> groups;
+  for (std::vector<Diagnostic> const& d : diags) {
+    for (std::size_t i = 0; i < d.size(); ++i) {
+      if (d[i].kind == note_diag && i != 0) {
+        ++groups.back().last;
+        continue;
+      }
+      Location::Position p = start_of(d[i].info).position();
+      if (p == 0)
+        p = std::numeric_limits<Location::Position>::max();
+      groups.push_back({p, &d[i], &d[i] + 1});
+    }
+  }
+  std::stable_sort(groups.begin(), groups.end(), [](Group const& a, Group const& b) {
+    return a.pos < b.pos;
+  });
+  for (Group const& g : groups)
+    for (Diagnostic const* p = g.first; p != g.last; ++p)
+      emit_diagnostic(*p);
 }
 
 
@@ -208,7 +461,17 @@ Diagnostic_context::emit()
 void
 emit_diagnostics()
 {
-  diags_.top()->emit();
+  current_context()->emit();
+}
+
+
+// Write the diagnostics held by the sink. This should be done at
+// the end of each phase of processing, and before the source text
+// of its diagnostics is released.
+void
+flush_diagnostics()
+{
+  diagnostic_sink().flush();
 }
 
 
@@ -216,7 +479,7 @@ emit_diagnostics()
 void
 reset_diagnostics()
 {
-  diags_.top()->reset();
+  current_context()->reset();
 }
 
 
@@ -225,7 +488,24 @@ reset_diagnostics()
 int
 error_count()
 {
-  return diags_.top()->errors();
+  return current_context()->errors();
+}
+
+
+// Returns true if the message of a diagnostic emitted now would be
+// printed or saved. When it would not, there is no need to format it.
+bool
+would_report()
+{
+  return !current_context()->discards();
+}
+
+
+// Returns how the current diagnostic context handles diagnostics.
+Diagnostic_mode
+diagnostic_mode()
+{
+  return current_context()->mode();
 }
 
 
@@ -233,7 +513,7 @@ error_count()
 void
 error(Location loc, String const& msg)
 {
-  diags_.top()->emit({error_diag, loc, msg});
+  current_context()->emit({error_diag, loc, msg});
 }
 
 
@@ -241,7 +521,7 @@ error(Location loc, String const& msg)
 void
 error(Region span, String const& msg)
 {
-  diags_.top()->emit({error_diag, span, msg});
+  current_context()->emit({error_diag, span, msg});
 }
 
 
@@ -252,7 +532,7 @@ error(Region span, String const& msg)
 void
 warning(Location loc, String const& msg)
 {
-  diags_.top()->emit({warning_diag, loc, msg});
+  current_context()->emit({warning_diag, loc, msg});
 }
 
 
@@ -260,7 +540,7 @@ warning(Location loc, String const& msg)
 void
 warning(Region reg, String const& msg)
 {
-  diags_.top()->emit({warning_diag, reg, msg});
+  current_context()->emit({warning_diag, reg, msg});
 }
 
 
@@ -271,14 +551,14 @@ warning(Region reg, String const& msg)
 void
 note(Location loc, String const& msg)
 {
-  diags_.top()->emit({note_diag, loc, msg});
+  current_context()->emit({note_diag, loc, msg});
 }
 
 
 void
 note(Region reg, String const& msg)
 {
-  diags_.top()->emit({note_diag, reg, msg});
+  current_context()->emit({note_diag, reg, msg});
 }
 
 
@@ -11,8 +11,15 @@
 #include <lingo/buffer.hpp>
 #include <lingo/print.hpp>
 
+#include <atomic>
 #include <cstdio>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace lingo
@@ -72,37 +79,66 @@ struct Diagnostic_info
 // of existing at the same level. Or remove notes altogether.
 // Notes are informational and only provide context for
 // an error or warning.
+//
+// The message of a diagnostic saved in a suppressing context may be
+// deferred: fmt formats it, and msg is empty until it is formatted
+// (see Diagnostic_context).
 struct Diagnostic
 {
   Diagnostic(Diagnostic_kind, Location, String const&);
   Diagnostic(Diagnostic_kind, Region, String const&);
 
-  Diagnostic_kind kind;
-  Diagnostic_info info;
-  String          msg;
+  void format_message();
+
+  Diagnostic_kind         kind;
+  Diagnostic_info         info;
+  String                  msg;
+  std::function<String()> fmt; // Formats a deferred message
 };
 
 
 // Streaming
+std::ostream& operator<<(std::ostream&, Diagnostic_kind);
 std::ostream& operator<<(std::ostream&, Diagnostic const&);
 
 
+// How a diagnostic context handles the diagnostics emitted in it.
+enum Diagnostic_mode
+{
+  report_diags,   // Print diagnostics as they are emitted.
+  suppress_diags, // Save diagnostics, to be printed later.
+  discard_diags   // Save diagnostics without their messages.
+};
+
+
 // A diagnostic context is a record of all diagnostic messages that
 // have been emitted as part some processing phase.
 //
 // Note that diagnostics may be suppressed until later. This helps
-// to allow tentative processing.
+// to allow tentative processing. The messages of suppressed
+// diagnostics are formatted only when they are emitted or inspected,
+// so a context that is reset or destroyed does not format them.
+// Speculative processing, whose diagnostics are never shown, can
+// discard them instead; their messages are not kept at all.
 //
 // When a diagnostic context is declared (as a variable), it becomes
 // the active diagnostic context. When the declaration goes out of
 // scope, the previous context becomes active.
+//
+// Each thread has its own stack of active contexts. A thread that
+// has not declared a context reports to the root context, which is
+// shared by all threads; its error count is kept atomically. Work
+// that runs on several threads should collect its diagnostics in
+// contexts of its own, and merge them when it joins (see
+// merge_diagnostics()).
 class Diagnostic_context : std::vector<Diagnostic>
 {
 public:
   Diagnostic_context(bool = false);
+  Diagnostic_context(Diagnostic_mode);
   ~Diagnostic_context();
 
-  void emit(Diagnostic const&);
+  void emit(Diagnostic);
   void emit();
 
   void reset();
@@ -110,24 +146,123 @@ public:
   // Returns true if diagnostics are suppressed.
   bool quiet() const { return !suppress_; }
 
+  // Returns true if the messages of diagnostics are dropped.
+  bool discards() const { return discard_; }
+
+  // Returns how diagnostics are handled.
+  Diagnostic_mode mode() const;
+
   // Returns true if the context is error-free.
   bool ok() const    { return errs_ == 0; }
 
   // Returns the number of errors.
   int errors() const { return errs_; }
 
+  // Saved diagnostics. Their messages are formatted when they are
+  // inspected.
+  using const_iterator = std::vector<Diagnostic>::const_iterator;
+
+  const_iterator begin() const;
+  const_iterator end() const;
+
+private:
+  void format_messages() const;
+
+  bool             suppress_; // True if diagnostics are temporarily suppressed.
+  bool             discard_;  // True if messages are dropped.
+  std::atomic<int> errs_; // Actual error count.
+};
+
+
+inline Diagnostic_context::const_iterator
+Diagnostic_context::begin() const
+{
+  format_messages();
+  return std::vector<Diagnostic>::begin();
+}
+
+
+inline Diagnostic_context::const_iterator
+Diagnostic_context::end() const
+{
+  format_messages();
+  return std::vector<Diagnostic>::end();
+}
+
+
+// -------------------------------------------------------------------------- //
+//                          Diagnostic sinks
+
+// A diagnostic sink receives the diagnostics that are reported (not
+// suppressed). A sink may hold diagnostics until it is flushed. Since
+// a diagnostic refers to its source text by location, the sink must
+// be flushed before that text is released.
+class Diagnostic_sink
+{
+public:
+  virtual ~Diagnostic_sink() { }
+
+  virtual void write(Diagnostic const&) = 0;
+  virtual void flush() { }
+};
+
+
+// How diagnostics are written by a stream sink.
+enum Diagnostic_format
+{
+  text_diags,   // Messages with the source text they refer to.
+  compact_diags // One line of tab-separated fields per diagnostic.
+};
+
+
+// A stream sink writes diagnostics to an output stream. Diagnostics
+// are held until the sink is flushed, or until n are pending. Then
+// their locations are resolved in a single pass over the source,
+// and their text is written to the stream at once.
+//
+// In the compact format, each diagnostic is written as the line
+//
+//    kind  path  line  column  end-line  end-column  message
+//
+// where fields are separated by tabs. The path is empty if the text
+// is not from a file, and the line and column are 0 if there is no
+// location. Backslashes, tabs, and newlines in the message are
+// written as \\, \t, and \n.
+class Stream_sink : public Diagnostic_sink
+{
+public:
+  Stream_sink(std::ostream&, Diagnostic_format = text_diags, std::size_t n = 256);
+  ~Stream_sink();
+
+  void write(Diagnostic const&) override;
+  void flush() override;
+
 private:
-  bool suppress_; // True if diagnostics are temporarily suppressed.
-  int  errs_;     // Actual error count.
+  void flush_pending();
+
+  std::ostream&           os_;
+  Diagnostic_format       format_;
+  std::size_t             limit_;
+  std::vector<Diagnostic> diags_; // Pending diagnostics
+  std::mutex              mutex_;
 };
 
 
+Diagnostic_sink& diagnostic_sink();
+Diagnostic_sink* set_diagnostic_sink(Diagnostic_sink*);
+
+
 // -------------------------------------------------------------------------- //
 //                          Diagnostic interface
 
+void emit_diagnostic(Diagnostic);
 void emit_diagnostics();
+void merge_diagnostics(std::vector<std::vector<Diagnostic>> const&);
+void flush_diagnostics();
 void reset_diagnostics();
 int error_count();
+bool would_report();
+Diagnostic_mode diagnostic_mode();
 
 void error(Location, String const&);
 void error(Region, String const&);
@@ -139,6 +274,125 @@ void note(Location, String const&);
 void note(Region, String const&);
 
 
+// -------------------------------------------------------------------------- //
+//                          Deferred messages
+
+namespace diagnostic_impl
+{
+
+// A reference to an argument that is not copied.
+template<typename T>
+struct Ref_arg
+{
+  Ref_arg(T const& x)
+    : ptr(&x)
+  { }
+
+  T const* ptr;
+};
+
+
+// How an argument of type T is kept in a deferred message. Values
+// are copied, and C strings are copied into strings. Objects of
+// polymorphic or non-copyable class type, such as nodes, symbols,
+// and buffers, are referred to; they must outlive the formatting of
+// the message.
+template<typename T, bool = std::is_polymorphic<T>::value || !std::is_copy_constructible<T>::value>
+struct Kept_arg
+{
+  using type = T;
+};
+
+
+template<typename T>
+struct Kept_arg<T, true>
+{
+  using type = Ref_arg<T>;
+};
+
+
+template<>
+struct Kept_arg<char const*, false>
+{
+  using type = String;
+};
+
+
+template<>
+struct Kept_arg<char*, false>
+{
+  using type = String;
+};
+
+
+template<typename T>
+using kept_arg = typename Kept_arg<typename std::decay<T>::type>::type;
+
+
+template<typename T>
+inline T const&
+get_arg(T const& x)
+{
+  return x;
+}
+
+
+template<typename T>
+inline T const&
+get_arg(Ref_arg<T> const& x)
+{
+  return *x.ptr;
+}
+
+
+// Formats a message from its format string, which must be a
+// literal, and its kept arguments.
+template<typename... Ts>
+struct Deferred_message
+{
+  String operator()() const
+  {
+    return call(std::index_sequence_for<Ts...>());
+  }
+
+  template<std::size_t... I>
+  String call(std::index_sequence<I...>) const
+  {
+    return format(msg, get_arg(std::get<I>(args))...);
+  }
+
+  char const*       msg;
+  std::tuple<Ts...> args;
+};
+
+
+// Emit a diagnostic of kind k at l, whose message is formatted from
+// msg and args as the current context requires.
+template<typename L, typename... Args>
+inline void
+diagnose(Diagnostic_kind k, L l, char const* msg, Args&&... args)
+{
+  switch (diagnostic_mode()) {
+    case report_diags:
+      emit_diagnostic(Diagnostic(k, l, format(msg, std::forward<Args>(args)...)));
+      break;
+    case suppress_diags: {
+      Diagnostic d(k, l, String());
+      d.fmt = Deferred_message<kept_arg<Args>...> {
+        msg, std::tuple<kept_arg<Args>...>(std::forward<Args>(args)...)
+      };
+      emit_diagnostic(std::move(d));
+      break;
+    }
+    case discard_diags:
+      emit_diagnostic(Diagnostic(k, l, String()));
+      break;
+  }
+}
+
+} // namespace diagnostic_impl
+
+
 // -------------------------------------------------------------------------- //
 //                          Error messages
 //
@@ -151,7 +405,12 @@ void note(Region, String const&);
 // the sequence of values to be substituted into the string. This
 // uses the to_string() function defined in the print module to
 // render the final string, so each argument must have an appropriate
-// print() overload.
+// print() overload. The string is formatted at once only if the
+// current diagnostic context reports diagnostics. If it suppresses
+// them, formatting is deferred until the diagnostic is emitted or
+// inspected, and if it discards them, the string is never formatted
+// (see Diagnostic_mode). The arguments of a deferred message are
+// kept as described by Kept_arg.
 //
 // The error is emitted at the location maintained by the current
 // input context (see the buffer module).
@@ -176,7 +435,7 @@ template<typename... Args>
 inline void
 error(Location loc, char const* msg, Args&&... args)
 {
-  error(loc, format(msg, std::forward<Args>(args)...));
+  diagnostic_impl::diagnose(error_diag, loc, msg, std::forward<Args>(args)...);
 }
 
 
@@ -186,7 +445,7 @@ template<typename... Args>
 inline void
 error(Region reg, char const* msg, Args&&... args)
 {
-  error(reg, format(msg, std::forward<Args>(args)...));
+  diagnostic_impl::diagnose(error_diag, reg, msg, std::forward<Args>(args)...);
 }
 
 
@@ -195,7 +454,7 @@ template<typename... Args>
 inline void
 error(char const* msg, Args&&... args)
 {
-  error(Location(), format(msg, std::forward<Args>(args)...));
+  diagnostic_impl::diagnose(error_diag, Location(), msg, std::forward<Args>(args)...);
 }
 
 
@@ -209,7 +468,7 @@ template<typename... Args>
 inline void
 warning(Location loc, char const* msg, Args&&... args)
 {
-  warning(loc, format(msg, std::forward<Args>(args)...));
+  diagnostic_impl::diagnose(warning_diag, loc, msg, std::forward<Args>(args)...);
 }
 
 
@@ -219,7 +478,7 @@ template<typename... Args>
 inline void
 warning(Region reg, char const* msg, Args&&... args)
 {
-  warning(reg, format(msg, std::forward<Args>(args)...));
+  diagnostic_impl::diagnose(warning_diag, reg, msg, std::forward<Args>(args)...);
 }
 
 
@@ -228,7 +487,7 @@ template<typename... Args>
 inline void
 warning(char const* msg, Args&&... args)
 {
-  warning(Location(), format(msg, std::forward<Args>(args)...));
+  diagnostic_impl::diagnose(warning_diag, Location(), msg, std::forward<Args>(args)...);
 }
 
 
@@ -241,7 +500,7 @@ template<typename... Args>
 inline void
 note(Location loc, char const* msg, Args&&... args)
 {
-  note(loc, format(msg, std::forward<Args>(args)...));
+  diagnostic_impl::diagnose(note_diag, loc, msg, std::forward<Args>(args)...);
 }
 
 
@@ -251,7 +510,7 @@ template<typename... Args>
 inline void
 note(Region reg, char const* msg, Args&&... args)
 {
-  note(reg, format(msg, std::forward<Args>(args)...));
+  diagnostic_impl::diagnose(note_diag, reg, msg, std::forward<Args>(args)...);
 }
 
 
@@ -260,7 +519,7 @@ template<typename... Args>
 inline void
 note(char const* msg, Args&&... args)
 {
-  note(Location(), format(msg, std::forward<Args>(args)...));
+  diagnostic_impl::diagnose(note_diag, Location(), msg, std::forward<Args>(args)...);
 }
 
 
@@ -5,10 +5,18 @@
 
 #include "lingo/file.hpp"
 #include "lingo/error.hpp"
+#include "lingo/profile.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iterator>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace lingo
 {
 
@@ -33,19 +41,91 @@ read_file(Path const& p)
   return text;
 }
 
+
+// Returns the identity of the file at p, or throws an exception
+// if the file cannot be found.
+std::pair<std::uint64_t, std::uint64_t>
+identify(Path const& p)
+{
+  struct stat st;
+  if (::stat(p.c_str(), &st) != 0) {
+    boost::system::error_code ec(errno, boost::system::system_category());
+    throw boost::filesystem::filesystem_error("lingo::File_manager::open", p, ec);
+  }
+  return {st.st_dev, st.st_ino};
+}
+
 } // namespace
 
 
 File::File(Path const& p)
-  : Buffer(read_file(p)), path_(p), index_(0)
+  : File(p, 0)
 { }
 
 
 // Construct file with the given index. This will cache the
 // text of the file.
 File::File(Path const& p, int n)
-  : Buffer(read_file(p)), path_(p), index_(n)
-{ }
+  : path_(p), index_(n), map_(nullptr), map_size_(0)
+{
+  load();
+}
+
+
+File::~File()
+{
+  if (map_)
+    ::munmap(map_, map_size_);
+}
+
+
+// Load the text of the file, mapping it if it is large
+// enough. If the file cannot be mapped, it is read.
+void
+File::load()
+{
+  lingo_profile("load file");
+  int fd = ::open(path_.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    bool mapped = false;
+    if (::fstat(fd, &st) == 0 && std::size_t(st.st_size) > map_threshold)
+      mapped = map(fd, st.st_size);
+    ::close(fd);
+    if (mapped)
+      return;
+  }
+  text_ = read_file(path_);
+  set_text(text_.c_str(), text_.c_str() + text_.size());
+}
+
+
+// Map the n bytes of the file fd. This reserves a zero-filled
+// region large enough for the file and one more byte, and then
+// maps the file over the beginning of that region. The bytes
+// past the end of the file are zero, so the text is always
+// null-terminated, even when the size of the file is a multiple
+// of the page size. Returns false if the file cannot be mapped.
+bool
+File::map(int fd, std::size_t n)
+{
+  std::size_t page = ::sysconf(_SC_PAGESIZE);
+  std::size_t size = (n + 1 + page - 1) / page * page;
+  void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    return false;
+  void* q = ::mmap(p, n, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+  if (q == MAP_FAILED) {
+    ::munmap(p, size);
+    return false;
+  }
+  map_ = p;
+  map_size_ = size;
+
+  char const* first = static_cast<char const*>(p);
+  set_text(first, first + n);
+  return true;
+}
 
 
 namespace
@@ -65,21 +145,125 @@ file_manager()
 }
 
 
+// A set of files being loaded by background threads. Each thread
+// claims the next unclaimed path until none remain.
+struct File_manager::Prefetch
+{
+  std::vector<Path>                paths;
+  std::vector<std::promise<Loaded>> results;
+  std::atomic<std::size_t>         next{0};
+};
+
+
+File_manager::~File_manager()
+{
+  for (std::thread& t : workers_)
+    t.join();
+}
+
+
 // Open the file at the path indicated by `p`. If the file has already
 // been opened, then do nothing.
+//
+// Files are found first by the spelling of their path, which requires
+// no system calls. A new spelling is resolved to the file's identity
+// (device and inode), so that a file reached by different paths is
+// only loaded once.
+//
+// The lock is released while the file is identified and loaded.
 File&
 File_manager::open(Path const& p)
 {
-  Path real = canonical(p);
-  auto ins = lookup_.insert({p.native(), 0});
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto iter = lookup_.find(p.native());
+  if (iter != lookup_.end())
+    return *files_[iter->second];
+
+  // Adopt a prefetched file, waiting for it to be loaded.
+  auto wait = pending_.find(p.native());
+  if (wait != pending_.end()) {
+    std::future<Loaded> f = std::move(wait->second);
+    pending_.erase(wait);
+    lock.unlock();
+    Loaded l = f.get();
+    lock.lock();
+    return adopt(p, std::move(l));
+  }
+
+  lock.unlock();
+  File_id id = identify(p);
+  lock.lock();
+  auto known = ids_.find(id);
+  if (known != ids_.end()) {
+    lookup_.insert({p.native(), known->second});
+    return *files_[known->second];
+  }
+
+  lock.unlock();
+  Loaded l {std::unique_ptr<File>(new File(canonical(p), -1)), id};
+  lock.lock();
+  return adopt(p, std::move(l));
+}
+
+
+// Add the loaded file to the list of files, and record the
+// spelling p. If the same file was already opened through a
+// different spelling (or by another thread), the loaded file is
+// discarded. The lock must be held.
+File&
+File_manager::adopt(Path const& p, Loaded l)
+{
+  auto ins = ids_.insert({l.id, files_.size()});
   if (ins.second) {
-    File* file = new File(real, files_.size());
-    files_.push_back(file);
-    ins.first->second = file->index();
-    return *file;
-  } else {
-    int n = ins.first->second;
-    return *files_[n];
+    l.file->index_ = files_.size();
+    files_.push_back(l.file.release());
+  }
+  lookup_.insert({p.native(), ins.first->second});
+  return *files_[ins.first->second];
+}
+
+
+// Begin loading the files in paths on background threads. Paths
+// that have already been opened or prefetched are ignored.
+void
+File_manager::prefetch(std::vector<Path> const& paths)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto job = std::make_shared<Prefetch>();
+  job->paths.reserve(paths.size());
+  job->results.reserve(paths.size());
+  for (Path const& p : paths) {
+    if (lookup_.count(p.native()) || pending_.count(p.native()))
+      continue;
+    job->paths.push_back(p);
+    job->results.emplace_back();
+    pending_.emplace(p.native(), job->results.back().get_future());
+  }
+
+  std::size_t n = std::min<std::size_t>(prefetch_threads, job->paths.size());
+  for (std::size_t i = 0; i < n; ++i)
+    workers_.emplace_back(fetch, job);
+}
+
+
+// Load files from the prefetch job until none remain. Mapped
+// files are only paged in when read, so ask the system to
+// read them ahead.
+void
+File_manager::fetch(std::shared_ptr<Prefetch> job)
+{
+  std::size_t i;
+  while ((i = job->next++) < job->paths.size()) {
+    Path const& p = job->paths[i];
+    try {
+      File_id id = identify(p);
+      std::unique_ptr<File> f(new File(canonical(p), -1));
+      if (f->map_)
+        ::madvise(f->map_, f->map_size_, MADV_WILLNEED);
+      job->results[i].set_value({std::move(f), id});
+    } catch (...) {
+      job->results[i].set_exception(std::current_exception());
+    }
   }
 }
 
@@ -87,9 +271,38 @@ File_manager::open(Path const& p)
 File&
 File_manager::file(int n)
 {
-  lingo_assert(0 <= n && n << files_.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+  lingo_assert(0 <= n && n < (int)files_.size());
   return *files_[n];
 }
 
 
+// -------------------------------------------------------------------------- //
+// File mappings
+
+File_mapping::File_mapping(Path const& p)
+  : data_(nullptr), size_(0)
+{
+  int fd = ::open(p.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* q = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (q != MAP_FAILED) {
+      data_ = static_cast<char const*>(q);
+      size_ = st.st_size;
+    }
+  }
+  ::close(fd);
+}
+
+
+File_mapping::~File_mapping()
+{
+  if (data_)
+    ::munmap(const_cast<char*>(data_), size_);
+}
+
+
 } // namespace lingo
@@ -9,7 +9,13 @@
 
 #include <lingo/buffer.hpp>
 
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/filesystem.hpp>
@@ -33,12 +39,20 @@ using Path = boost::filesystem::path;
 // Represents a file system file. This object is primarily used
 // to house the text the file contains, providing long-term
 // storage for its text.
+//
+// Files larger than map_threshold bytes are memory-mapped, and
+// the text of the buffer refers directly to the mapping. The
+// mapping is followed by at least one zero-filled byte, so the
+// text is null-terminated. Smaller files are read into memory.
 class File : public Buffer
 {
   friend class File_manager;
 
 public:
+  static constexpr std::size_t map_threshold = 64 * 1024;
+
   File(Path const&);
+  ~File();
 
   // Returns the absolute path to the file.
   Path const& path() const { return path_; }
@@ -46,11 +60,42 @@ public:
   // Returns the file's index.
   int index() const { return index_; }
 
+  // Returns true if the text of the file is memory-mapped.
+  bool is_mapped() const { return map_; }
+
 private:
   Path        path_;
   int         index_;
+  void*       map_;      // The mapped region, if any
+  std::size_t map_size_; // The size of the mapped region
 
   File(Path const&, int);
+
+  void load();
+  bool map(int, std::size_t);
+};
+
+
+// -------------------------------------------------------------------------- //
+// File mappings
+
+// A read-only mapping of the contents of a file. The mapping is
+// empty if the file cannot be opened or mapped, or is empty.
+class File_mapping
+{
+public:
+  File_mapping(Path const&);
+  ~File_mapping();
+
+  File_mapping(File_mapping const&) = delete;
+  File_mapping& operator=(File_mapping const&) = delete;
+
+  char const* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+private:
+  char const* data_;
+  std::size_t size_;
 };
 
 
@@ -60,21 +105,71 @@ private:
 // The file manager provides a facility for globally managing
 // opened files. This effectively maintains a list of opened (note: not
 // open) files and a side-table for efficient path-based lookup.
+//
+// Files are looked up by the spelling of their path and by their
+// identity in the file system. Each spelling is resolved once.
+//
+// When the inputs are known in advance, prefetch() loads them on
+// background threads. A later call to open() adopts the loaded
+// file, waiting for it if necessary, and rethrows any error that
+// occurred while loading it.
+//
+// The manager may be used by several threads. Files are loaded
+// without holding its lock, so threads opening different files load
+// them concurrently. If two threads open the same file at once, both
+// may load it, but only one copy is kept.
 class File_manager
 {
 public:
+  static constexpr int prefetch_threads = 8;
+
+  File_manager() = default;
+  ~File_manager();
+
   File& open(char const*);
   File& open(std::string const&);
   File& open(Path const&);
 
+  void prefetch(std::vector<Path> const&);
+
   File& file(int);
 
 private:
+  // The identity of a file: its device and inode numbers.
+  using File_id = std::pair<std::uint64_t, std::uint64_t>;
+
+  struct File_id_hash
+  {
+    std::size_t operator()(File_id const& id) const
+    {
+      return id.first * 0x9e3779b97f4a7c15ull ^ id.second;
+    }
+  };
+
+  // A file that has been loaded but not yet added to the list.
+  struct Loaded
+  {
+    std::unique_ptr<File> file;
+    File_id               id;
+  };
+
+  struct Prefetch;
+
   using File_list = std::vector<File*>;
   using File_map  = std::unordered_map<std::string, int>;
+  using Id_map    = std::unordered_map<File_id, int, File_id_hash>;
+  using Wait_map  = std::unordered_map<std::string, std::future<Loaded>>;
+
+  static void fetch(std::shared_ptr<Prefetch>);
+
+  File& adopt(Path const&, Loaded);
 
-  File_list files_;
-  File_map  lookup_;
+  File_list                files_;
+  File_map                 lookup_;   // Files by spelled path
+  Id_map                   ids_;      // Files by identity
+  Wait_map                 pending_;  // Files being prefetched
+  std::vector<std::thread> workers_;
+  std::mutex               mutex_;
 };
 
 
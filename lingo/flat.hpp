@@ -0,0 +1,279 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_FLAT_HPP
+#define LINGO_FLAT_HPP
+
+// The flat module provides an alternative representation of
+// abstract syntax trees. Rather than linking heap-allocated nodes
+// by pointers, the nodes of a tree are stored in one contiguous
+// array, and refer to their children by 32-bit indices. The kinds
+// of nodes are stored in a parallel array.
+//
+// A flat tree is freed or copied as a whole, and its nodes are
+// laid out in the order they were built. Trees built bottom-up
+// (as by a recursive descent parser) are stored in postorder,
+// which is the order in which most analyses visit them.
+
+#include <lingo/location.hpp>
+#include <lingo/node.hpp>
+
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
+
+namespace lingo
+{
+
+template<typename K> class Flat_tree;
+template<typename K> struct Flat_node;
+
+
+// -------------------------------------------------------------------------- //
+//                              Flat trees
+
+// A flat tree stores nodes whose kinds are values of the
+// enumeration K. Each node has a location and three 32-bit
+// operands. An operand is the index of a child, or an immediate
+// value such as an integer or the index of an entry in a side
+// table (e.g., of symbols). Unused operands are none.
+//
+// The children of a k-ary node are stored in a separate array of
+// indices. The first two operands of a k-ary node are the offset
+// of its children in that array, and their number.
+template<typename K>
+class Flat_tree
+{
+public:
+  using Kind  = K;
+  using Index = std::uint32_t;
+
+  static constexpr Index none = 0xffffffff;
+
+  struct Record
+  {
+    Location loc;
+    Index    ops[3];
+  };
+
+  Index make(K, Location, Index = none, Index = none, Index = none);
+  Index make_list(K, Location, Index const*, Index const*);
+  Index make_list(K, Location, std::initializer_list<Index>);
+
+  K            kind(Index n) const             { return kinds_[n]; }
+  Location     location(Index n) const         { return recs_[n].loc; }
+  Index        operand(Index n, int k) const   { return recs_[n].ops[k]; }
+  Index const* children_begin(Index n) const   { return lists_.data() + recs_[n].ops[0]; }
+  Index const* children_end(Index n) const     { return children_begin(n) + recs_[n].ops[1]; }
+
+  Flat_node<K> node(Index n) const { return {this, n}; }
+  Flat_node<K> root() const        { return {this, empty() ? none : Index(size() - 1)}; }
+
+  bool        empty() const { return kinds_.empty(); }
+  std::size_t size() const  { return kinds_.size(); }
+
+  void reserve(std::size_t);
+  void clear();
+
+private:
+  std::vector<K>      kinds_;
+  std::vector<Record> recs_;
+  std::vector<Index>  lists_;
+};
+
+
+template<typename K>
+constexpr typename Flat_tree<K>::Index Flat_tree<K>::none;
+
+
+// Add a node of kind k with the operands a, b, and c, and return
+// its index. Children must be added before their parents.
+template<typename K>
+inline typename Flat_tree<K>::Index
+Flat_tree<K>::make(K k, Location loc, Index a, Index b, Index c)
+{
+  kinds_.push_back(k);
+  recs_.push_back({loc, {a, b, c}});
+  return Index(kinds_.size() - 1);
+}
+
+
+// Add a k-ary node of kind k, whose children are the indexes in
+// [first, last), and return its index.
+template<typename K>
+inline typename Flat_tree<K>::Index
+Flat_tree<K>::make_list(K k, Location loc, Index const* first, Index const* last)
+{
+  Index off = lists_.size();
+  lists_.insert(lists_.end(), first, last);
+  return make(k, loc, off, Index(last - first));
+}
+
+
+template<typename K>
+inline typename Flat_tree<K>::Index
+Flat_tree<K>::make_list(K k, Location loc, std::initializer_list<Index> list)
+{
+  return make_list(k, loc, list.begin(), list.end());
+}
+
+
+template<typename K>
+inline void
+Flat_tree<K>::reserve(std::size_t n)
+{
+  kinds_.reserve(n);
+  recs_.reserve(n);
+}
+
+
+template<typename K>
+inline void
+Flat_tree<K>::clear()
+{
+  kinds_.clear();
+  recs_.clear();
+  lists_.clear();
+}
+
+
+// -------------------------------------------------------------------------- //
+//                              Flat nodes
+
+// A reference to a node in a flat tree. A node reference is
+// empty when it refers to no node (i.e., its index is none).
+//
+// A node reference is nullary. To access the children of a node,
+// construct one of the views below, which satisfy the node concepts
+// of the corresponding arity (see node.hpp).
+template<typename K>
+struct Flat_node
+{
+  using Index = typename Flat_tree<K>::Index;
+
+  Flat_node()
+    : tree(nullptr), index(Flat_tree<K>::none)
+  { }
+
+  Flat_node(Flat_tree<K> const* t, Index n)
+    : tree(t), index(n)
+  { }
+
+  explicit operator bool() const { return index != Flat_tree<K>::none; }
+
+  K        kind() const          { return tree->kind(index); }
+  Location location() const      { return tree->location(index); }
+  Index    operand(int k) const  { return tree->operand(index, k); }
+
+  // Returns the child whose index is the kth operand.
+  Flat_node child(int k) const { return {tree, operand(k)}; }
+
+  Flat_tree<K> const* tree;
+  Index               index;
+};
+
+
+template<typename K>
+inline bool
+operator==(Flat_node<K> a, Flat_node<K> b)
+{
+  return a.tree == b.tree && a.index == b.index;
+}
+
+
+template<typename K>
+inline bool
+operator!=(Flat_node<K> a, Flat_node<K> b)
+{
+  return !(a == b);
+}
+
+
+// A view of a unary node.
+template<typename K>
+struct Flat_unary : Flat_node<K>
+{
+  explicit Flat_unary(Flat_node<K> n)
+    : Flat_node<K>(n), first(n.child(0))
+  { }
+
+  Flat_node<K> first;
+};
+
+
+// A view of a binary node.
+template<typename K>
+struct Flat_binary : Flat_node<K>
+{
+  explicit Flat_binary(Flat_node<K> n)
+    : Flat_node<K>(n), first(n.child(0)), second(n.child(1))
+  { }
+
+  Flat_node<K> first;
+  Flat_node<K> second;
+};
+
+
+// A view of a ternary node.
+template<typename K>
+struct Flat_ternary : Flat_node<K>
+{
+  explicit Flat_ternary(Flat_node<K> n)
+    : Flat_node<K>(n), first(n.child(0)), second(n.child(1)), third(n.child(2))
+  { }
+
+  Flat_node<K> first;
+  Flat_node<K> second;
+  Flat_node<K> third;
+};
+
+
+// An iterator over the children of a k-ary node.
+template<typename K>
+struct Flat_child_iterator
+{
+  using Index             = typename Flat_tree<K>::Index;
+  using value_type        = Flat_node<K>;
+  using reference         = Flat_node<K>;
+  using pointer           = void;
+  using difference_type   = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  Flat_child_iterator(Flat_tree<K> const* t, Index const* p)
+    : tree(t), ptr(p)
+  { }
+
+  Flat_node<K> operator*() const { return {tree, *ptr}; }
+
+  Flat_child_iterator& operator++()    { ++ptr; return *this; }
+  Flat_child_iterator  operator++(int) { Flat_child_iterator x = *this; ++ptr; return x; }
+
+  bool operator==(Flat_child_iterator const& x) const { return ptr == x.ptr; }
+  bool operator!=(Flat_child_iterator const& x) const { return ptr != x.ptr; }
+
+  Flat_tree<K> const* tree;
+  Index const*        ptr;
+};
+
+
+// A view of a k-ary node.
+template<typename K>
+struct Flat_kary : Flat_node<K>
+{
+  using iterator = Flat_child_iterator<K>;
+
+  explicit Flat_kary(Flat_node<K> n)
+    : Flat_node<K>(n)
+  { }
+
+  iterator begin() const { return {this->tree, this->tree->children_begin(this->index)}; }
+  iterator end() const   { return {this->tree, this->tree->children_end(this->index)}; }
+
+  std::size_t size() const { return this->operand(1); }
+};
+
+
+} // namespace lingo
+
+#endif
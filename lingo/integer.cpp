@@ -6,17 +6,193 @@
 #include "lingo/integer.hpp"
 #include "lingo/debug.hpp"
 
+#include <llvm/ADT/ArrayRef.h>
+
+#include <gmp.h>
+
 #include <memory>
+#include <vector>
 
 namespace lingo
 {
 
+// -------------------------------------------------------------------------- //
+//                            Unbounded integers
+
+// A GMP integer.
+struct Mpz
+{
+  Mpz() { mpz_init(z); }
+  ~Mpz() { mpz_clear(z); }
+
+  Mpz(Mpz const&) = delete;
+  Mpz& operator=(Mpz const&) = delete;
+
+  mpz_t z;
+};
+
+
+namespace
+{
+
+// The value of an unbounded integer as a GMP integer. Native values
+// are converted into a temporary.
+struct Mpz_ref
+{
+  Mpz_ref(Integer const& n)
+    : big(n.big())
+  {
+    if (!big) {
+      mpz_set_si(tmp.z, n.gets());
+      big = &tmp;
+    }
+  }
+
+  mpz_srcptr get() const { return big->z; }
+
+  Mpz const* big;
+  Mpz        tmp;
+};
+
+} // namespace
+
+
+// Set the value of an unbounded integer to the string representation
+// s in base r.
+void
+Integer::set(String const& s, int r)
+{
+  w_ = unbounded;
+  std::shared_ptr<Mpz> m = std::make_shared<Mpz>();
+  int err = mpz_set_str(m->z, s.c_str(), r);
+  lingo_assert(err == 0);
+  if (mpz_fits_slong_p(m->z)) {
+    n_ = mpz_get_si(m->z);
+    big_ = nullptr;
+  } else {
+    big_ = std::move(m);
+  }
+}
+
+
+// Compute the operation for integers that are wider than 64 bits, or
+// unbounded integers whose operands or result do not fit in 64 bits.
+void
+Integer::compute(Op op, Integer const& x)
+{
+  if (w_ != unbounded) {
+    llvm::APInt a = impl();
+    llvm::APInt b = x.impl();
+    switch (op) {
+      case add_op: set(a + b); break;
+      case sub_op: set(a - b); break;
+      case mul_op: set(a * b); break;
+      case div_op: set(a.sdiv(b)); break;
+      case rem_op: set(a.srem(b)); break;
+      case and_op: set(a & b); break;
+      case or_op: set(a | b); break;
+      case xor_op: set(a ^ b); break;
+      case shl_op: set(a.shl(b)); break;
+      case shr_op: set(a.ashr(b)); break;
+    }
+    return;
+  }
+
+  lingo_assert(x.w_ == unbounded);
+  Mpz_ref a(*this);
+  Mpz_ref b(x);
+  std::shared_ptr<Mpz> m = std::make_shared<Mpz>();
+  switch (op) {
+    case add_op: mpz_add(m->z, a.get(), b.get()); break;
+    case sub_op: mpz_sub(m->z, a.get(), b.get()); break;
+    case mul_op: mpz_mul(m->z, a.get(), b.get()); break;
+    case div_op:
+      lingo_assert(mpz_sgn(b.get()) != 0);
+      mpz_tdiv_q(m->z, a.get(), b.get());
+      break;
+    case rem_op:
+      lingo_assert(mpz_sgn(b.get()) != 0);
+      mpz_tdiv_r(m->z, a.get(), b.get());
+      break;
+    case and_op: mpz_and(m->z, a.get(), b.get()); break;
+    case or_op: mpz_ior(m->z, a.get(), b.get()); break;
+    case xor_op: mpz_xor(m->z, a.get(), b.get()); break;
+    case shl_op: mpz_mul_2exp(m->z, a.get(), x.getu()); break;
+    case shr_op: mpz_fdiv_q_2exp(m->z, a.get(), x.getu()); break;
+  }
+
+  // Values that fit are stored natively.
+  if (mpz_fits_slong_p(m->z)) {
+    n_ = mpz_get_si(m->z);
+    big_ = nullptr;
+  } else {
+    big_ = std::move(m);
+  }
+}
+
+
+// Compare integers, at least one of which is wider than 64 bits, or
+// unbounded and stored by GMP.
+int
+Integer::compare_big(Integer const& x) const
+{
+  if (w_ != unbounded) {
+    llvm::APInt a = impl();
+    llvm::APInt b = x.impl();
+    return a.slt(b) ? -1 : a.sgt(b);
+  }
+  lingo_assert(x.w_ == unbounded);
+  int c = mpz_cmp(Mpz_ref(*this).get(), Mpz_ref(x).get());
+  return (c > 0) - (c < 0);
+}
+
+
+// Returns the APInt of an unbounded integer stored by GMP, with one
+// more bit than its magnitude needs.
+llvm::APInt
+Integer::impl_big() const
+{
+  mpz_srcptr z = big_->z;
+  std::size_t n = mpz_sizeinbase(z, 2) + 1;
+  std::vector<std::uint64_t> words((n + 63) / 64);
+  mpz_export(words.data(), nullptr, -1, sizeof(std::uint64_t), 0, 0, z);
+  llvm::APInt r(n, llvm::ArrayRef<std::uint64_t>(words));
+  return mpz_sgn(z) < 0 ? -r : r;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                                Conversion
+
+
+// Returns the integer value of the literal in [first, last)
+// in base b. Literals that fit in 64 bits are converted by
+// string_to_int. Larger literals are converted by the string
+// constructor of Integer, with as many bits as needed.
+Integer
+string_to_integer(char const* first, char const* last, int b)
+{
+  try {
+    return Integer(string_to_int<std::int64_t>(first, last, b));
+  } catch (std::out_of_range&) {
+    String s(first, last);
+    int n = llvm::APInt::getBitsNeeded(s, b);
+    return Integer(n, s, b);
+  }
+}
+
 
 // Streaming
 std::ostream&
 operator<<(std::ostream& os, const Integer& n)
 {
-  return os << n.impl().toString(10, true);
+  if (n.bits() != Integer::unbounded)
+    return os << n.impl().toString(10, true);
+  if (!n.big())
+    return os << n.gets();
+  mpz_srcptr z = n.big()->z;
+  std::vector<char> s(mpz_sizeinbase(z, 10) + 2);
+  return os << mpz_get_str(s.data(), 10, z);
 }
 
 
@@ -14,31 +14,50 @@
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/Hashing.h>
 
+#include <cstdint>
+#include <memory>
+
 namespace lingo
 {
 
+struct Mpz;
+
+
 // Represents an arbitrary precision integer. The default interpretation
 // of this value is as a signed integer. However, unsigned variants can
 // also be constructed.
 //
+// An integer has a fixed number of bits, and arithmetic wraps, as for
+// llvm::APInt. Integers of at most 64 bits, which include nearly all
+// literals, are stored and computed natively. Only wider integers
+// are represented by an APInt.
+//
+// An unbounded integer (one constructed with unbounded bits) never
+// wraps. Its value is stored natively while it fits in 64 bits, and
+// by GMP otherwise. Arithmetic on unbounded integers checks for
+// overflow, and switches to GMP only when the result does not fit.
+//
 // TODO: Consider extending this to support byte ordering.
 class Integer
 {
 public:
+  // The number of bits of an unbounded integer.
+  static constexpr int unbounded = 0;
+
   Integer();
 
   // Copy semantics
-  Integer(Integer const&);
+  Integer(Integer const&) = default;
   Integer(llvm::APInt const&);
 
-  Integer& operator=(Integer const&);
+  Integer& operator=(Integer const&) = default;
   Integer& operator=(llvm::APInt const&);
 
   // Move semantics
-  Integer(Integer&&);
+  Integer(Integer&&) = default;
   Integer(llvm::APInt&&);
 
-  Integer& operator=(Integer&&);
+  Integer& operator=(Integer&&) = default;
   Integer& operator=(llvm::APInt&&);
 
   // Value construction.
@@ -76,71 +95,79 @@ public:
   // Truth value
   bool truth_value() const;
 
+  // Signed comparison
+  int compare(Integer const&) const;
+
   int bits() const;
   std::uint64_t getu() const;
   std::int64_t gets() const;
 
-  llvm::APInt const& impl() const;
+  llvm::APInt impl() const;
+
+  // Returns the big integer storing the value, or null if the value
+  // is not unbounded, or fits in 64 bits.
+  Mpz const* big() const { return big_.get(); }
 
 private:
-  llvm::APInt z;
+  static constexpr int small_bits = 64;
+
+  enum Op
+  {
+    add_op, sub_op, mul_op, div_op, rem_op,
+    and_op, or_op, xor_op, shl_op, shr_op
+  };
+
+  // Returns true if the value has at most 64 bits, and wraps.
+  bool is_small() const { return w_ != unbounded && w_ <= small_bits; }
+  bool is_small(Integer const& x) const { return is_small() && w_ == x.w_; }
+
+  // Returns true if this and x are unbounded, and stored natively.
+  bool is_native(Integer const& x) const
+  {
+    return w_ == unbounded && x.w_ == unbounded && !big_ && !x.big_;
+  }
+
+  void set(std::uint64_t);
+  void set(llvm::APInt const&);
+  void set(String const&, int);
+
+  void        compute(Op, Integer const&);
+  int         compare_big(Integer const&) const;
+  llvm::APInt impl_big() const;
+
+  int                        w_;   // The number of bits
+  std::int64_t               n_;   // The value, if small or native
+  llvm::APInt                z;    // The value, if wider than 64 bits
+  std::shared_ptr<Mpz const> big_; // The value, if unbounded and not native
 };
 
 
 // Initialize a 32-bit signed 0.
 inline
 Integer::Integer()
-  : z(32, 0, true)
-{ }
-
-
-// Copy initialize this object with x.
-inline
-Integer::Integer(Integer const& x)
-  : z(x.z)
+  : w_(32), n_(0)
 { }
 
 
 inline
 Integer::Integer(llvm::APInt const& n)
-  : z(n)
-{ }
-
-
-// Copy assign this object to the value of x.
-inline Integer&
-Integer::operator=(Integer const& x)
 {
-  z = x.z;
-  return *this;
+  set(n);
 }
 
 
 inline Integer&
 Integer::operator=(llvm::APInt const& n)
 {
-  z = n;
+  set(n);
   return *this;
 }
 
 
-inline
-Integer::Integer(Integer&& x)
-  : z(std::move(x.z))
-{ }
-
-
 inline
 Integer::Integer(llvm::APInt&& n)
-  : z(std::move(n))
-{ }
-
-
-inline Integer&
-Integer::operator=(Integer&& x)
 {
-  z = std::move(x.z);
-  return *this;
+  set(n);
 }
 
 
@@ -148,7 +175,7 @@ inline
 Integer&
 Integer::operator=(llvm::APInt&& n)
 {
-  z = std::move(n);
+  set(n);
   return *this;
 }
 
@@ -156,16 +183,20 @@ Integer::operator=(llvm::APInt&& n)
 // Initialize an integer with the (signed) value.
 inline
 Integer::Integer(std::int64_t n)
-  : z(32, n, true)
-{ }
+  : w_(32)
+{
+  set(n);
+}
 
 
-// Initialize an integer with the given value. The
-// value is considered signed if `s` is true.
+// Initialize an integer with the given value. The value
+// is truncated to 32 bits, so its signedness does not matter.
 inline
-Integer::Integer(std::uint64_t n, bool s)
-  : z(32, n, s)
-{ }
+Integer::Integer(std::uint64_t n, bool)
+  : w_(32)
+{
+  set(n);
+}
 
 
 // Initialize an integer value with `w` bits of
@@ -173,8 +204,17 @@ Integer::Integer(std::uint64_t n, bool s)
 // `s` is true.
 inline
 Integer::Integer(int w, std::uint64_t n, bool s)
-  : z(w, n, s)
-{ }
+  : w_(w)
+{
+  if (is_small())
+    set(n);
+  else if (w == unbounded && (s || std::int64_t(n) >= 0))
+    n_ = n;
+  else if (w == unbounded)
+    set(std::to_string(n), 10);
+  else
+    set(llvm::APInt(w, n, s));
+}
 
 
 // Initialize an 32-bit integer from the string representation
@@ -197,14 +237,44 @@ Integer::Integer(String const& s, int r)
 // in base r.
 inline
 Integer::Integer(int b, String const& s, int r)
-  : z(b, s, r)
-{ }
+{
+  if (b == unbounded)
+    set(s, r);
+  else
+    set(llvm::APInt(b, s, r));
+}
+
+
+// Set the value of a small integer to the low w_ bits of n.
+inline void
+Integer::set(std::uint64_t n)
+{
+  int s = small_bits - w_;
+  n_ = static_cast<std::int64_t>(n << s) >> s;
+}
+
+
+inline void
+Integer::set(llvm::APInt const& n)
+{
+  w_ = n.getBitWidth();
+  if (is_small())
+    n_ = n.getSExtValue();
+  else
+    z = n;
+}
 
 
 inline Integer&
 Integer::operator+=(Integer const& x)
 {
-  z += x.z;
+  std::int64_t r;
+  if (is_small(x))
+    set(std::uint64_t(n_) + std::uint64_t(x.n_));
+  else if (is_native(x) && !__builtin_add_overflow(n_, x.n_, &r))
+    n_ = r;
+  else
+    compute(add_op, x);
   return *this;
 }
 
@@ -212,7 +282,13 @@ Integer::operator+=(Integer const& x)
 inline Integer&
 Integer::operator-=(Integer const& x)
 {
-  z -= x.z;
+  std::int64_t r;
+  if (is_small(x))
+    set(std::uint64_t(n_) - std::uint64_t(x.n_));
+  else if (is_native(x) && !__builtin_sub_overflow(n_, x.n_, &r))
+    n_ = r;
+  else
+    compute(sub_op, x);
   return *this;
 }
 
@@ -220,33 +296,65 @@ Integer::operator-=(Integer const& x)
 inline Integer&
 Integer::operator*=(Integer const& x)
 {
-  z += x.z;
+  std::int64_t r;
+  if (is_small(x))
+    set(std::uint64_t(n_) * std::uint64_t(x.n_));
+  else if (is_native(x) && !__builtin_mul_overflow(n_, x.n_, &r))
+    n_ = r;
+  else
+    compute(mul_op, x);
   return *this;
 }
 
 
-// Signed division.
+// Signed division, rounding toward zero. The division of the least
+// integer by -1 wraps, unless the integers are unbounded.
 inline Integer&
 Integer::operator/=(Integer const& x)
 {
-  z = z.sdiv(x.z);
+  if (is_small(x) || is_native(x)) {
+    lingo_assert(x.n_ != 0);
+    if (x.n_ != -1)
+      n_ /= x.n_;
+    else if (is_small())
+      set(-std::uint64_t(n_));
+    else if (n_ != INT64_MIN)
+      n_ = -n_;
+    else
+      compute(div_op, x);
+  } else {
+    compute(div_op, x);
+  }
   return *this;
 }
 
 
-// Signed remainder
+// Signed remainder, with the sign of the dividend.
 inline Integer&
 Integer::operator%=(Integer const& x)
 {
-  z = z.srem(x.z);
+  if (is_small(x) || is_native(x)) {
+    lingo_assert(x.n_ != 0);
+    if (x.n_ == -1)
+      n_ = 0;
+    else
+      n_ %= x.n_;
+  } else {
+    compute(rem_op, x);
+  }
   return *this;
 }
 
 
+// Bitwise operations treat negative values as two's complement,
+// with infinitely many sign bits if unbounded.
 inline Integer&
 Integer::operator&=(Integer const& x)
 {
-  z &= x.z;
+  if (is_small(x) || is_native(x))
+    n_ &= x.n_;
+  else
+    compute(and_op, x);
   return *this;
 }
 
@@ -254,7 +362,10 @@ Integer::operator&=(Integer const& x)
 inline Integer&
 Integer::operator|=(Integer const& x)
 {
-  z |= x.z;
+  if (is_small(x) || is_native(x))
+    n_ |= x.n_;
+  else
+    compute(or_op, x);
   return *this;
 }
 
@@ -262,15 +373,30 @@ Integer::operator|=(Integer const& x)
 inline Integer&
 Integer::operator^=(Integer const& x)
 {
-  z &= x.z;
+  if (is_small(x) || is_native(x))
+    n_ ^= x.n_;
+  else
+    compute(xor_op, x);
   return *this;
 }
 
 
+// Shifting by at least the number of bits gives 0.
 inline Integer&
 Integer::operator<<=(Integer const& x)
 {
-  z = z.shl(x.z);
+  std::uint64_t s = x.getu();
+  if (is_small(x)) {
+    set(s < std::uint64_t(w_) ? std::uint64_t(n_) << s : 0);
+  } else if (is_native(x) && s < small_bits) {
+    std::int64_t r = std::uint64_t(n_) << s;
+    if (r >> s == n_)
+      n_ = r;
+    else
+      compute(shl_op, x);
+  } else {
+    compute(shl_op, x);
+  }
   return *this;
 }
 
@@ -279,16 +405,34 @@ Integer::operator<<=(Integer const& x)
 inline Integer&
 Integer::operator>>=(Integer const& x)
 {
-  z = z.ashr(x.z);
+  std::uint64_t s = x.getu();
+  if (is_small(x) || is_native(x)) {
+    int w = is_small() ? w_ : small_bits;
+    n_ = s < std::uint64_t(w) ? n_ >> s : (n_ < 0 ? -1 : 0);
+  } else {
+    compute(shr_op, x);
+  }
   return *this;
 }
 
 
+// Returns -1, 0, or 1 if the value is negative, zero, or positive.
+inline int
+Integer::sign() const
+{
+  if (w_ > small_bits)
+    return z.isNegative() ? -1 : z.isStrictlyPositive();
+  if (big_)
+    return compare_big(Integer(unbounded, 0, true));
+  return (n_ > 0) - (n_ < 0);
+}
+
+
 // Returns true if the value is strictly positive.
 inline bool
 Integer::is_positive() const
 {
-  return z.isStrictlyPositive();
+  return sign() > 0;
 }
 
 
@@ -296,7 +440,7 @@ Integer::is_positive() const
 inline bool
 Integer::is_negative() const
 {
-  return z.isNegative();
+  return sign() < 0;
 }
 
 
@@ -320,7 +464,19 @@ Integer::is_nonnegative() const
 inline bool
 Integer::truth_value() const
 {
-  return z.getBoolValue();
+  return w_ > small_bits ? z.getBoolValue() : big_ || n_ != 0;
+}
+
+
+// Returns -1, 0, or 1 if the value is less than, equal to, or
+// greater than that of x. Both integers shall have the same number
+// of bits.
+inline int
+Integer::compare(Integer const& x) const
+{
+  if (is_small(x) || is_native(x))
+    return (n_ > x.n_) - (n_ < x.n_);
+  return compare_big(x);
 }
 
 
@@ -328,30 +484,47 @@ Integer::truth_value() const
 inline int
 Integer::bits() const
 {
-  return z.getBitWidth();
+  return w_;
 }
 
 
-// Returns the value as an unsigned integer.
+// Returns the value as an unsigned integer. An unbounded integer
+// shall fit in 64 bits.
 inline std::uint64_t
 Integer::getu() const
 {
-  return z.getZExtValue();
+  if (w_ > small_bits)
+    return z.getZExtValue();
+  lingo_assert(!big_);
+  if (w_ == unbounded || w_ == small_bits)
+    return n_;
+  return std::uint64_t(n_) & ((std::uint64_t(1) << w_) - 1);
 }
 
 
-// Returns the value as a signed integer.
+// Returns the value as a signed integer. An unbounded integer
+// shall fit in 64 bits.
 inline std::int64_t
 Integer::gets() const
 {
-  return z.getSExtValue();
+  if (w_ > small_bits)
+    return z.getSExtValue();
+  lingo_assert(!big_);
+  return n_;
 }
 
 
-// Returns a reference to the underlying data.
-inline llvm::APInt const&
+// Returns the value as an APInt. The APInt of an unbounded integer
+// has 64 bits, or as many as its value needs.
+inline llvm::APInt
 Integer::impl() const
 {
+  if (is_small())
+    return llvm::APInt(w_, getu());
+  if (w_ == unbounded && !big_)
+    return llvm::APInt(small_bits, n_, true);
+  if (big_)
+    return impl_big();
   return z;
 }
 
@@ -361,7 +534,7 @@ Integer::impl() const
 inline bool
 operator==(Integer const& a, Integer const& b)
 {
-  return a.impl() == b.impl();
+  return a.compare(b) == 0;
 }
 
 
@@ -376,28 +549,28 @@ operator!=(Integer const& a, Integer const& b)
 inline bool
 operator<(Integer const& a, Integer const& b)
 {
-  return a.impl().slt(b.impl());
+  return a.compare(b) < 0;
 }
 
 
 inline bool
 operator>(Integer const& a, Integer const& b)
 {
-  return a.impl().sgt(b.impl());
+  return a.compare(b) > 0;
 }
 
 
 inline bool
 operator<=(Integer const& a, Integer const& b)
 {
-  return a.impl().sle(b.impl());
+  return a.compare(b) <= 0;
 }
 
 
 inline bool
 operator>=(Integer const& a, Integer const& b)
 {
-  return a.impl().sge(b.impl());
+  return a.compare(b) >= 0;
 }
 
 
@@ -440,7 +613,7 @@ operator%(Integer const& a, Integer const& b)
 inline Integer
 operator-(Integer const& x)
 {
-  return -x.impl();
+  return Integer(x.bits(), std::uint64_t(0), true) -= x;
 }
 
 
@@ -475,7 +648,7 @@ operator^(Integer const& a, Integer const& b)
 inline Integer
 operator~(Integer const& x)
 {
-  return ~x.impl();
+  return Integer(x.bits(), std::uint64_t(-1), true) ^= x;
 }
 
 
@@ -497,10 +670,16 @@ operator>>(Integer const& a, Integer const& b)
 inline std::size_t
 hash_value(Integer const& n)
 {
+  if (n.bits() <= 64 && !n.big())
+    return llvm::hash_combine(n.bits(), n.gets());
   return llvm::hash_value(n.impl());
 }
 
 
+// Conversion
+Integer string_to_integer(char const*, char const*, int);
+
+
 // Streaming
 std::ostream& operator<<(std::ostream&, Integer const&);
 
@@ -29,6 +29,19 @@ init_colors()
 }
 
 
+// Make the output device block buffered, with a buffer of n
+// bytes, for programs that write many short records. Standard
+// streams are no longer synchronized with C I/O. This must be
+// called before any input or output.
+void
+buffer_output(std::size_t n)
+{
+  static char* buf = new char[n];
+  std::ios_base::sync_with_stdio(false);
+  std::cout.rdbuf()->pubsetbuf(buf, n);
+}
+
+
 // Return true if color should be used for the given stream.
 //
 // NOTE: I use the iword of a stream to store the color to indicate
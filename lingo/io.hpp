@@ -11,6 +11,7 @@
 //
 // TODO: Support 256-color terminals.
 
+#include <cstddef>
 #include <iosfwd>
 
 namespace lingo
@@ -351,6 +352,7 @@ operator<<(std::ostream& os, Styled_text<T> const& txt)
 
 
 void init_colors();
+void buffer_output(std::size_t = 1 << 16);
 
 
 } // namespace lingo
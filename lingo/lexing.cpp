@@ -0,0 +1,49 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/lexing.hpp"
+
+#include <cstring>
+
+namespace lingo
+{
+
+// Returns the boundaries of about n chunks of the buffer. Each
+// boundary after the first is the start of a line at which the
+// split predicate holds, found by searching forward from evenly
+// spaced offsets. The first boundary is the beginning of the
+// buffer and the last is its end. Boundaries are strictly
+// increasing, so there may be fewer than n chunks.
+std::vector<char const*>
+split_buffer(Buffer const& buf, std::size_t n, Split_predicate const& safe)
+{
+  char const* first = buf.begin();
+  char const* last = buf.end();
+  std::size_t size = last - first;
+
+  std::vector<char const*> splits {first};
+  for (std::size_t i = 1; i < n; ++i) {
+    char const* p = std::max(first + size / n * i, splits.back());
+    while (p != last) {
+      void const* q = std::memchr(p, '\n', last - p);
+      if (!q) {
+        p = last;
+        break;
+      }
+      p = static_cast<char const*>(q) + 1;
+      if (p != last && safe(buf, p))
+        break;
+    }
+    if (p == last)
+      break;
+    if (p != splits.back())
+      splits.push_back(p);
+  }
+  splits.push_back(last);
+  return splits;
+}
+
+
+} // namespace lingo
@@ -0,0 +1,105 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_LEXING_HPP
+#define LINGO_LEXING_HPP
+
+// The lexing module provides drivers that run the lexer of a
+// language over a buffer.
+
+#include <lingo/character.hpp>
+#include <lingo/error.hpp>
+#include <lingo/token.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                            Parallel lexing
+
+// A split predicate determines whether a buffer can be split at
+// the start of a line. The predicate is given the first character
+// of that line. A split is safe when no token spans it, and when
+// lexing can begin there without knowing the preceding text (e.g.,
+// the line does not continue a comment or string literal).
+using Split_predicate = std::function<bool(Buffer const&, char const*)>;
+
+
+std::vector<char const*> split_buffer(Buffer const&, std::size_t, Split_predicate const&);
+
+
+// Lex the buffer in parallel using n threads, and return its tokens
+// in order. The buffer is split into about n chunks of similar size
+// at lines where the split predicate holds. Each chunk is lexed on
+// its own thread by calling lex with a character stream over that
+// chunk and an empty token stream. The tokens of each chunk are
+// then concatenated.
+//
+// Because chunks are lexed concurrently, the lexer must be safe to
+// run on several threads at once. In particular, it must intern its
+// symbols in a Concurrent_symbol_table. The diagnostics of each chunk
+// are collected while it is lexed, and merged in order of location
+// after all threads have finished (see merge_diagnostics). If lexing
+// a chunk throws an exception, the exception of the first such chunk
+// is then rethrown.
+//
+// If n is 0, the number of threads is the number of hardware
+// threads.
+template<typename Lex>
+Token_seq
+lex_in_parallel(Buffer& buf, Lex lex, Split_predicate const& safe, std::size_t n = 0)
+{
+  if (n == 0)
+    n = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<char const*> splits = split_buffer(buf, n, safe);
+  std::size_t chunks = splits.size() - 1;
+
+  std::vector<Token_seq> toks(chunks);
+  std::vector<std::vector<Diagnostic>> diags(chunks);
+  std::vector<std::exception_ptr> errs(chunks);
+  Diagnostic_mode mode = would_report() ? suppress_diags : discard_diags;
+  auto work = [&](std::size_t i) {
+    Diagnostic_context cxt(mode);
+    try {
+      Character_stream cs(buf, splits[i], splits[i + 1]);
+      Token_stream ts;
+      lex(cs, ts);
+      toks[i] = std::move(ts.tokens());
+    } catch (...) {
+      errs[i] = std::current_exception();
+    }
+    diags[i].assign(cxt.begin(), cxt.end());
+  };
+
+  // Lex the first chunk on this thread.
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < chunks; ++i)
+    threads.emplace_back(work, i);
+  work(0);
+  for (std::thread& t : threads)
+    t.join();
+  merge_diagnostics(diags);
+  for (std::exception_ptr& e : errs)
+    if (e)
+      std::rethrow_exception(e);
+
+  std::size_t size = 0;
+  for (Token_seq& s : toks)
+    size += s.size();
+  Token_seq result = std::move(toks[0]);
+  result.reserve(size);
+  for (std::size_t i = 1; i < chunks; ++i)
+    result.insert(result.end(), toks[i].begin(), toks[i].end());
+  return result;
+}
+
+
+} // namespace lingo
+
+#endif
@@ -6,17 +6,102 @@
 #include "lingo/line.hpp"
 #include "lingo/assert.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 namespace lingo
 {
 
 
+Line_map::Line_map()
+  : first_(nullptr), last_(nullptr), origin_(1, 1), next_(nullptr), hint_(0)
+{ }
+
+
+// Reset the line map for the text in [first, last), whose first
+// character is at the locus o. No part of the text is scanned
+// until it is queried.
+void
+Line_map::reset(char const* first, char const* last, Locus o)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  first_ = first;
+  last_ = last;
+  origin_ = o;
+  next_ = first;
+  hint_ = 0;
+  starts_.clear();
+  starts_.push_back(0);
+}
+
+
+// Scan lines until the line containing the offset n is known.
+// Newlines are found by memchr, which examines many characters
+// at a time. The mutex must be held.
+void
+Line_map::scan(int n) const
+{
+  while (next_ != last_ && next_ - first_ <= n) {
+    char const* p = static_cast<char const*>(std::memchr(next_, '\n', last_ - next_));
+    if (!p) {
+      next_ = last_;
+      break;
+    }
+    next_ = p + 1; // One past the newline.
+    starts_.push_back(next_ - first_);
+  }
+}
+
+
+// Returns the index of the line containing the offset n. The
+// mutex must be held.
+int
+Line_map::index(int n) const
+{
+  lingo_assert(!starts_.empty());
+  scan(n);
+
+  // Check the most recently found line.
+  std::size_t k = hint_;
+  if (k + 1 < starts_.size() && starts_[k] <= n && n < starts_[k + 1])
+    return k;
+
+  auto iter = std::upper_bound(starts_.begin(), starts_.end(), n);
+  hint_ = iter - starts_.begin() - 1;
+  return hint_;
+}
+
+
+// Returns the locus of the offset n on the line with index k.
+// The mutex must be held.
+Locus
+Line_map::locus(std::size_t k, int n) const
+{
+  if (k == 0)
+    return {origin_.first, origin_.second + n};
+  return {origin_.first + int(k), n - starts_[k] + 1};
+}
+
+
+// Returns the number of lines. This scans the entire text.
+std::size_t
+Line_map::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  scan(last_ - first_);
+  return starts_.size();
+}
+
+
 // Returns the line containing the character offset.
-Line const&
+Line
 Line_map::line(int n) const
 {
-  lingo_assert(!empty());
-  auto iter = --upper_bound(n);
-  return iter->second;
+  std::lock_guard<std::mutex> lock(mutex_);
+  int k = index(n);
+  int first = starts_[k];
+  int last = k + 1 < int(starts_.size()) ? starts_[k + 1] - 1 : last_ - first_;
+  return Line(origin_.first + k, first, first_ + first, first_ + last);
 }
 
 
@@ -24,8 +109,35 @@ Line_map::line(int n) const
 Locus
 Line_map::locus(int n) const
 {
-  Line const& l = line(n);
-  return {l.number(), n - l.offset() + 1};
+  std::lock_guard<std::mutex> lock(mutex_);
+  return locus(index(n), n);
+}
+
+
+// Store the loci of the offsets in [first, last) in out. The
+// offsets shall be sorted. The text is scanned once, up to the
+// last offset, and the lines are found in a single forward pass.
+void
+Line_map::resolve(int const* first, int const* last, Locus* out) const
+{
+  if (first == last)
+    return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  scan(*(last - 1));
+  std::size_t k = 0;
+  std::size_t n = starts_.size();
+  for (; first != last; ++first, ++out) {
+    lingo_assert(first == last - 1 || *first <= *(first + 1));
+    // Step over nearby lines, and search for distant ones.
+    if (k + 8 < n && starts_[k + 8] <= *first) {
+      auto iter = std::upper_bound(starts_.begin() + k + 8, starts_.end(), *first);
+      k = iter - starts_.begin() - 1;
+    } else {
+      while (k + 1 < n && starts_[k + 1] <= *first)
+        ++k;
+    }
+    *out = locus(k, *first);
+  }
 }
 
 
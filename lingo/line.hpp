@@ -7,7 +7,8 @@
 #include <lingo/utility.hpp>
 #include <lingo/string.hpp>
 
-#include <map>
+#include <mutex>
+#include <vector>
 
 namespace lingo
 {
@@ -47,11 +48,46 @@ public:
 
 
 // A line map associates an offset in the source code with
-// its underlying line of text.
-struct Line_map : std::map<int, Line>
+// its underlying line of text. The map is a sorted vector of
+// the offsets at which each line starts, so lines are found
+// by a binary search over contiguous memory.
+//
+// The map is built lazily. Text is scanned for newlines only as
+// far as the furthest offset that has been queried, so text that
+// is never the subject of a query costs nothing. Queries may be
+// made concurrently. The most recently found line is remembered,
+// since queries tend to be clustered, and resolve() finds the loci
+// of many sorted offsets in one pass.
+//
+// The text need not begin a line. The origin of the map is the
+// locus of its first character, which is (1, 1) unless the text
+// continues earlier text (see Chunk).
+class Line_map
 {
-  Locus       locus(int) const;
-  Line const& line(int) const;
+public:
+  Line_map();
+
+  void reset(char const*, char const*, Locus = {1, 1});
+
+  std::size_t size() const;
+
+  Locus locus(int) const;
+  Line  line(int) const;
+
+  void resolve(int const*, int const*, Locus*) const;
+
+private:
+  void  scan(int) const;
+  int   index(int) const;
+  Locus locus(std::size_t, int) const;
+
+  char const*              first_;  // The start of the text
+  char const*              last_;   // The end of the text
+  Locus                    origin_; // The locus of the first character
+  mutable char const*      next_;   // The first unscanned character
+  mutable std::size_t      hint_;   // The index of the last line found
+  mutable std::vector<int> starts_; // The offsets of scanned lines
+  mutable std::mutex       mutex_;
 };
 
 
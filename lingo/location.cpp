@@ -9,24 +9,134 @@
 #include "lingo/error.hpp"
 #include "lingo/utility.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 
 namespace lingo
 {
 
+// -------------------------------------------------------------------------- //
+//                            Source manager
+
+
+// Reserve a range of n + 1 positions for the buffer b and
+// return the first position in that range.
+Source_manager::Position
+Source_manager::reserve(Buffer* b, std::size_t n)
+{
+  std::lock_guard<std::shared_timed_mutex> lock(mutex_);
+  if (n >= std::numeric_limits<Position>::max() - next_)
+    throw std::length_error("source position space exhausted");
+  Position base = next_;
+  next_ += n + 1;
+  ranges_.push_back({base, next_, b});
+  return base;
+}
+
+
+// Release the range beginning at the base position p. Positions
+// in that range no longer refer to any buffer.
+void
+Source_manager::release(Position p)
+{
+  std::lock_guard<std::shared_timed_mutex> lock(mutex_);
+  auto cmp = [](Range const& r, Position p) { return r.base < p; };
+  auto iter = std::lower_bound(ranges_.begin(), ranges_.end(), p, cmp);
+  lingo_assert(iter != ranges_.end() && iter->base == p);
+  ranges_.erase(iter);
+}
+
+
+// Returns the buffer containing the position p, or nullptr if
+// no live buffer contains p.
+Buffer*
+Source_manager::buffer(Position p) const
+{
+  Position limit;
+  return buffer(p, limit);
+}
+
+
+// Returns the buffer containing the position p, or nullptr if
+// no live buffer contains p. The position past the end of the
+// buffer's range is stored in limit.
+Buffer*
+Source_manager::buffer(Position p, Position& limit) const
+{
+  std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+  auto cmp = [](Position p, Range const& r) { return p < r.base; };
+  auto iter = std::upper_bound(ranges_.begin(), ranges_.end(), p, cmp);
+  if (iter == ranges_.begin())
+    return nullptr;
+  --iter;
+  limit = iter->limit;
+  return p < iter->limit ? iter->buf : nullptr;
+}
+
+
+// Returns the global source manager. This is never destroyed
+// so that buffers released during static destruction do not
+// outlive it.
+Source_manager&
+source_manager()
+{
+  static Source_manager* sm = new Source_manager();
+  return *sm;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                            Locations
+
+
+// Initialize the location at offset n in the buffer b.
+Location::Location(Buffer* b, int n)
+  : pos_(b ? b->base() + n : 0)
+{ }
+
+
+// Returns the buffer containing the location, or nullptr if
+// the location is invalid or its buffer has been destroyed.
+Buffer const*
+Location::buffer() const
+{
+  return source_manager().buffer(pos_);
+}
+
+
+Buffer*
+Location::buffer()
+{
+  return source_manager().buffer(pos_);
+}
+
+
 // Returns the file associated with the location. If the location is
 // not sourced from a file, this returns nullptr.
 File const*
 Location::file() const
 {
-  return as<File>(buf_);
+  return as<File>(buffer());
 }
 
 
 File*
 Location::file()
 {
-  return as<File>(buf_);
+  return as<File>(buffer());
+}
+
+
+// Returns the offset of the location within its buffer, or
+// -1 if the location does not refer to a buffer.
+int
+Location::offset() const
+{
+  if (Buffer const* b = buffer())
+    return pos_ - b->base();
+  return -1;
 }
 
 
@@ -50,51 +160,79 @@ Location::column_number() const
 Locus
 Location::locus() const
 {
-  return buf_->lines().locus(off_);
+  Buffer const* b = buffer();
+  return b->locus(pos_ - b->base());
 }
 
 
-Line const&
+Line
 Location::line() const
 {
-  return buf_->lines().line(off_);
-}
-
-
-File const*
-Region::file() const
-{
-  return as<File>(buf_);
-}
-
-
-File*
-Region::file()
-{
-  return as<File>(buf_);
+  Buffer const* b = buffer();
+  return b->line(pos_ - b->base());
 }
 
 
 // FIXME: Guarantee that the start and end lines are the same.
-Line const&
+Line
 Region::line() const
 {
   lingo_assert(!is_multiline());
-  return buf_->lines().line(start_);
+  return start_.line();
 }
 
 
-Locus
-Region::start_locus() const
+// Store the loci of the locations in [first, last) in out. The
+// locations are sorted by position, so that the locations in each
+// buffer are grouped together and resolved in a single pass over
+// its lines. Invalid locations have the locus (0, 0).
+//
+// Each position is sorted together with its index, as one 64-bit
+// key, which is much faster than sorting indexes indirectly.
+void
+resolve(Location const* first, Location const* last, Locus* out)
 {
-  return buf_->lines().locus(start_);
+  std::size_t n = last - first;
+  std::vector<std::uint64_t> keys(n);
+  for (std::size_t i = 0; i < n; ++i)
+    keys[i] = std::uint64_t(first[i].position()) << 32 | i;
+  if (!std::is_sorted(keys.begin(), keys.end()))
+    std::sort(keys.begin(), keys.end());
+
+  auto pos = [&keys](std::size_t i) { return Location::Position(keys[i] >> 32); };
+  auto index = [&keys](std::size_t i) { return std::uint32_t(keys[i]); };
+
+  std::vector<int>   offs;
+  std::vector<Locus> locs;
+  std::size_t i = 0;
+  while (i != n) {
+    Location::Position limit = 0;
+    Buffer const* buf = source_manager().buffer(pos(i), limit);
+    if (!buf) {
+      out[index(i++)] = {0, 0};
+      continue;
+    }
+
+    // Gather the offsets of the locations in this buffer.
+    std::size_t j = i;
+    offs.clear();
+    while (j != n && pos(j) < limit)
+      offs.push_back(pos(j++) - buf->base());
+    locs.resize(offs.size());
+    buf->resolve(offs.data(), offs.data() + offs.size(), locs.data());
+    for (std::size_t k = 0; k < offs.size(); ++k)
+      out[index(i + k)] = locs[k];
+    i = j;
+  }
 }
 
 
-Locus
-Region::end_locus() const
+std::vector<Locus>
+resolve(std::vector<Location> const& locs)
 {
-  return buf_->lines().locus(end_);
+  std::vector<Locus> out(locs.size());
+  resolve(locs.data(), locs.data() + locs.size(), out.data());
+  return out;
 }
 
 
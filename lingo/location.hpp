@@ -10,7 +10,10 @@
 #include <lingo/assert.hpp>
 #include <lingo/utility.hpp>
 
+#include <cstdint>
 #include <iosfwd>
+#include <shared_mutex>
+#include <vector>
 
 namespace lingo
 {
@@ -20,58 +23,95 @@ class File;
 class Line;
 
 
-// The location class represents the position of text within a source file.
-// This is a pair: the file in which the text resides and the starting offset
-// of that text. Note that the ending offset is determined by the kind of
-// element: token, comment, etc.
-//
-// Note that for redirected input, the file may be null.
+// -------------------------------------------------------------------------- //
+//                            Source manager
+
+
+// The source manager assigns each buffer a contiguous range of
+// positions in a single 32-bit space. A buffer of n characters
+// is given n + 1 positions so that its end is also a valid
+// position. Ranges are allocated in increasing order, and never
+// reused, so the owner of a position is found by binary search.
 //
-// FIXME: I can make this a single character pointer, and then use external
-// data structures to map that back to a file, and then to a line and offset.
-// However, this will essentially require that I maintain files in a global
-// repository (i.e., file manager).
+// Position 0 is never allocated; it denotes an invalid location.
+class Source_manager
+{
+public:
+  using Position = std::uint32_t;
+
+  Position      reserve(Buffer*, std::size_t);
+  void          release(Position);
+
+  Buffer*       buffer(Position) const;
+  Buffer*       buffer(Position, Position&) const;
+
+private:
+  struct Range
+  {
+    Position base;
+    Position limit;
+    Buffer*  buf;
+  };
+
+  mutable std::shared_timed_mutex mutex_;
+  std::vector<Range>              ranges_;
+  Position                        next_ = 1;
+};
+
+
+Source_manager& source_manager();
+
+
+// -------------------------------------------------------------------------- //
+//                            Locations
+
+
+// The location class represents the position of text within a
+// source file. This is a single position in the source manager's
+// global space, from which the buffer containing the text and
+// the offset of that text within the buffer are recovered. Note
+// that the ending offset is determined by the kind of element:
+// token, comment, etc.
 class Location
 {
 public:
+  using Position = Source_manager::Position;
+
   Location()
-    : buf_(nullptr), off_(-1)
+    : pos_(0)
   { }
 
-  Location(int n)
-    : buf_(nullptr), off_(n)
-  { }
+  Location(Buffer*, int);
 
-  Location(Buffer* b, int n)
-    : buf_(b), off_(n)
-  { }
+  // Returns the location at the global position p.
+  static Location at(Position p) { Location l; l.pos_ = p; return l; }
 
-  Buffer const* buffer() const { return buf_; }
-  Buffer*       buffer()       { return buf_; }
+  Buffer const* buffer() const;
+  Buffer*       buffer();
 
   File const*   file() const;
   File*         file();
 
-  int           offset() const { return off_; }
+  Position      position() const { return pos_; }
+  int           offset() const;
   int           line_number() const;
   int           column_number() const;
   Locus         locus() const;
-  Line const&   line() const;
+  Line          line() const;
 
   // Convert to true when the location is valid. This
-  // is the case when the offset is not -1.
-  explicit operator bool() const { return off_ != -1; }
+  // is the case when the position is not 0.
+  explicit operator bool() const { return pos_ != 0; }
 
 private:
-  Buffer* buf_;
-  int     off_;
+  Position pos_;
 };
 
 
 inline bool
 operator==(Location a, Location b)
 {
-  return a.buffer() == b.buffer() && a.offset() == b.offset();
+  return a.position() == b.position();
 }
 
 
@@ -92,36 +132,36 @@ operator!=(Location a, Location b)
 struct Region
 {
   Region()
-    : buf_(nullptr), start_(-1), end_(-1)
+    : start_(), end_()
   { }
 
   Region(Buffer* b, int m, int n)
-    : buf_(b), start_(m), end_(n)
+    : start_(b, m), end_(b, n)
   { }
 
   // The locations shall be sourced from the same file.
   Region(Location s, Location e)
-    : buf_(s.buffer()), start_(s.offset()), end_(e.offset())
+    : start_(s), end_(e)
   {
-    lingo_assert(buf_ == e.buffer());
+    lingo_assert(s.buffer() == e.buffer());
   }
 
-  Buffer const* buffer() const { return buf_; }
-  Buffer*       buffer()       { return buf_; }
+  Buffer const* buffer() const { return start_.buffer(); }
+  Buffer*       buffer()       { return start_.buffer(); }
 
-  File const* file() const;
-  File*       file();
+  File const* file() const { return start_.file(); }
+  File*       file()       { return start_.file(); }
 
   // Returns the start and end offsets.
-  int start_offset() const { return start_; }
-  int end_offset() const   { return end_; }
+  int start_offset() const { return start_.offset(); }
+  int end_offset() const   { return end_.offset(); }
 
   // Returns the start and end source locations.
-  Location start_location() const { return {buf_, start_}; }
-  Location end_location() const   { return {buf_, end_}; }
+  Location start_location() const { return start_; }
+  Location end_location() const   { return end_; }
 
-  Locus start_locus() const;
-  Locus end_locus() const;
+  Locus start_locus() const { return start_.locus(); }
+  Locus end_locus() const   { return end_.locus(); }
   int   start_line_number() const;
   int   end_line_number() const;
   int   start_column_number() const;
@@ -129,18 +169,17 @@ struct Region
 
   // Returns the line of text associated with the region. Behavior
   // is defined only when is_multiline() is false.
-  Line const& line() const;
+  Line line() const;
 
   // Returns true if the region spans multiple lines of text.
   bool is_multiline() const;
 
   // Contextually converts to true iff both the start and
   // end are valid offsets.
-  explicit operator bool() const { return start_ != -1; }
+  explicit operator bool() const { return bool(start_); }
 
-  Buffer* buf_;
-  int     start_;
-  int     end_;
+  Location start_;
+  Location end_;
 };
 
 
@@ -181,6 +220,10 @@ Region::is_multiline() const
 
 
 
+void               resolve(Location const*, Location const*, Locus*);
+std::vector<Locus> resolve(std::vector<Location> const&);
+
+
 std::ostream& operator<<(std::ostream&, Location const&);
 std::ostream& operator<<(std::ostream&, Region const&);
 
@@ -5,34 +5,397 @@
 
 #include "lingo/memory.hpp"
 #include "lingo/error.hpp"
+#include "lingo/profile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <thread>
 
 namespace lingo
 {
 
+// -------------------------------------------------------------------------- //
+//                            Arena allocation
+
+Arena::Arena(std::size_t n)
+  : size_(n), chunks_(nullptr), first_(nullptr), last_(nullptr), bytes_(0)
+{ }
+
+
+Arena::~Arena()
+{
+  while (chunks_) {
+    Chunk* c = chunks_;
+    chunks_ = c->next;
+    std::free(c);
+  }
+}
+
+
+// Acquire a new chunk from the system that is large enough to
+// store `n` bytes aligned to `a` bytes, and allocate from that.
+// Requests larger than the default chunk size get a dedicated
+// chunk.
+void*
+Arena::allocate_chunk(std::size_t n, std::size_t a)
+{
+  std::size_t size = std::max(size_, sizeof(Chunk) + a - 1 + n);
+  Chunk* c = static_cast<Chunk*>(std::malloc(size));
+  if (!c)
+    throw std::bad_alloc();
+  c->next = chunks_;
+  c->size = size;
+  chunks_ = c;
+  first_ = reinterpret_cast<char*>(c) + sizeof(Chunk);
+  last_ = reinterpret_cast<char*>(c) + size;
+  return allocate(n, a);
+}
+
+
+// Release all memory allocated by the arena. The most recently
+// allocated chunk is retained so that a reset arena can be
+// reused without going back to the system.
+void
+Arena::reset()
+{
+  if (!chunks_)
+    return;
+  Chunk* keep = chunks_;
+  Chunk* c = keep->next;
+  while (c) {
+    Chunk* n = c->next;
+    std::free(c);
+    c = n;
+  }
+  keep->next = nullptr;
+  chunks_ = keep;
+  first_ = reinterpret_cast<char*>(keep) + sizeof(Chunk);
+  last_ = reinterpret_cast<char*>(keep) + keep->size;
+  bytes_ = 0;
+}
+
+
+// Run the destructors of all tracked objects, most recently
+// constructed first.
+void
+Arena_factory::destroy()
+{
+  while (dtors_) {
+    Dtor* d = dtors_;
+    dtors_ = d->next;
+    d->fn(d->obj);
+  }
+}
+
+
+// The factory of the innermost arena scope.
+thread_local Arena_factory* Arena_scope::current_ = nullptr;
+
+
+// The long-lived factory.
+Arena_factory&
+Arena_scope::global()
+{
+  static Arena_factory f;
+  return f;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                          Garbage collector
+
 namespace
 {
 
 // The garbage collector.
 Collecting_factory gc_;
 
+
+// The offset of the first slot within a slab.
+constexpr std::size_t slab_header = (sizeof(Slab) + Slab::min_slot - 1) & ~(Slab::min_slot - 1);
+
+
+using Clock = std::chrono::steady_clock;
+
+
+// Returns the number of seconds elapsed since `t`.
+inline double
+seconds_since(Clock::time_point t)
+{
+  return std::chrono::duration<double>(Clock::now() - t).count();
+}
+
+
+// Returns the number of bitmap words used by a slab.
+inline std::size_t
+bitmap_words(Slab const* s)
+{
+  return (s->count + 63) / 64;
+}
+
+
+// Returns true if the slot `n` of `s` holds an object.
+inline bool
+is_used(Slab const* s, std::size_t n)
+{
+  return s->used[n / 64] & (std::uint64_t(1) << (n % 64));
+}
+
+
 } // namespace
 
 
-// Declare a new GC root.
+// The state of the current thread.
+thread_local Collecting_factory::Thread* Collecting_factory::self_ = nullptr;
+
+
+Collecting_factory::Thread::Thread()
+  : prev(nullptr)
+  , next(nullptr)
+  , roots(nullptr)
+  , inhibit(0)
+  , count(0)
+  , size(0)
+  , objects(0)
+  , bytes(0)
+{
+  std::fill(cache, cache + num_classes, nullptr);
+}
+
+
+// Detach the thread when it exits.
+Collecting_factory::Thread::~Thread()
+{
+  gc().detach(*this);
+}
+
+
+// Initialize the size classes. Sizes up to 256 bytes are spaced
+// 16 bytes apart. Larger sizes are powers of 2, up to the maximum
+// object size.
+Collecting_factory::Collecting_factory()
+  : count_(0)
+  , objects_(0)
+  , bytes_(0)
+  , threads_(nullptr)
+  , attached_(0)
+  , parked_(0)
+  , stopping_(false)
+  , phase_(idle_phase)
+  , class_(0)
+  , slab_(0)
+  , freed_(false)
+  , recording_(false)
+  , live_bytes_(0)
+{
+  for (std::size_t n = 16; n <= 256; n += 16)
+    classes_.emplace_back(classes_.size(), n);
+  for (std::size_t n = 512; n <= max_object_size; n *= 2)
+    classes_.emplace_back(classes_.size(), n);
+  lingo_assert(classes_.size() == num_classes);
+}
+
+
+// Release all slabs. Note that objects that are still allocated
+// are not destroyed; their storage is simply returned to the system.
+Collecting_factory::~Collecting_factory()
+{
+  for (Size_class& c : classes_)
+    for (Slab* s : c.slabs)
+      std::free(s);
+}
+
+
+// Returns the size class index for objects of size `n`.
+std::size_t
+Collecting_factory::class_index(std::size_t n) const
+{
+  lingo_assert(n <= max_object_size);
+  if (n <= 256)
+    return (n + 15) / 16 - 1;
+  std::size_t i = 16;
+  std::size_t k = 512;
+  while (k < n) {
+    k *= 2;
+    ++i;
+  }
+  return i;
+}
+
+
+// Allocate a new slab for the given size class and thread its
+// slots onto the slab's free list.
+Slab*
+Collecting_factory::new_slab(Size_class& c)
+{
+  void* p;
+  if (posix_memalign(&p, Slab::size, Slab::size))
+    throw std::bad_alloc();
+  Slab* s = static_cast<Slab*>(p);
+  s->slot = c.slot;
+  s->count = (Slab::size - slab_header) / c.slot;
+  s->live = 0;
+  s->data = static_cast<char*>(p) + slab_header;
+  s->free = nullptr;
+  std::fill(s->used, s->used + Slab::words, 0);
+  std::fill(s->marks, s->marks + Slab::words, 0);
+  c.slabs.push_back(s);
+
+  // Thread slots in reverse so that allocation proceeds in
+  // increasing address order.
+  for (std::size_t i = s->count; i != 0; --i) {
+    void* slot = s->data + (i - 1) * s->slot;
+    *static_cast<void**>(slot) = s->free;
+    s->free = slot;
+  }
+  return s;
+}
+
+
+// Acquire a slab with unused slots for the thread `t` in the
+// size class `k`. The thread's counts are published at the
+// same time.
+Slab*
+Collecting_factory::acquire(Thread& t, std::size_t k)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  flush(t);
+  Size_class& c = classes_[k];
+  while (!c.available.empty()) {
+    Slab* s = c.available.back();
+    c.available.pop_back();
+    if (s->free)
+      return s;
+  }
+  return new_slab(c);
+}
+
+
+// Allocate a slot for an object of `n` bytes. This takes a slot
+// from a slab owned by the current thread.
+void*
+Collecting_factory::allocate(std::size_t n)
+{
+  Thread& t = thread();
+  std::size_t k = class_index(n);
+  Slab* s = t.cache[k];
+  if (!s || !s->free)
+    s = t.cache[k] = acquire(t, k);
+  void* p = s->free;
+  s->free = *static_cast<void**>(p);
+
+  std::size_t i = s->index(p);
+  s->used[i / 64] |= std::uint64_t(1) << (i % 64);
+  ++s->live;
+  ++t.count;
+  ++t.objects;
+  t.size += s->slot;
+  t.bytes += s->slot;
+  return p;
+}
+
+
+// Return the slot at `p` to its slab. This is used only when
+// the construction of an object fails, so the slab is owned by
+// the current thread.
+void
+Collecting_factory::deallocate(void* p)
+{
+  Thread& t = thread();
+  Slab* s = Slab::of(p);
+  std::size_t i = s->index(p);
+  s->used[i / 64] &= ~(std::uint64_t(1) << (i % 64));
+  --s->live;
+  --t.count;
+  --t.objects;
+  t.size -= s->slot;
+  t.bytes -= s->slot;
+  *static_cast<void**>(p) = s->free;
+  s->free = p;
+}
+
+
+// Rebuild the free lists of a size class after sweeping. Slabs
+// that no longer contain live objects are returned to the system,
+// except that one is retained for future allocations. Threads
+// give up their slabs in this class.
 void
-Collecting_factory::declare(Reach* r)
+Collecting_factory::refill(Size_class& c)
 {
-  lingo_assert(roots.count(r) == 0);
-  roots.insert({r, r});
+  for (Thread* t = threads_; t; t = t->next)
+    t->cache[c.index] = nullptr;
+
+  std::vector<Slab*> keep;
+  keep.reserve(c.slabs.size());
+  for (Slab* s : c.slabs) {
+    if (s->live == 0 && !keep.empty())
+      std::free(s);
+    else
+      keep.push_back(s);
+  }
+  c.slabs.swap(keep);
+
+  // Slabs are made available so that the lowest addresses are
+  // used first.
+  c.available.clear();
+  for (auto iter = c.slabs.rbegin(); iter != c.slabs.rend(); ++iter) {
+    Slab* s = *iter;
+    s->free = nullptr;
+    for (std::size_t i = s->count; i != 0; --i) {
+      std::size_t n = i - 1;
+      if (is_used(s, n))
+        continue;
+      void* slot = s->data + n * s->slot;
+      *static_cast<void**>(slot) = s->free;
+      s->free = slot;
+    }
+    if (s->free)
+      c.available.push_back(s);
+  }
 }
 
 
-// Un-declare a GC root.
+// Remove `r` from the list of roots waiting to be traversed by
+// an incremental collection and traverse it. Objects reachable
+// from it at the start of the collection may have been referred
+// to by objects allocated since.
 void
-Collecting_factory::undeclare(Reach* r)
+Collecting_factory::unpend(Reach* r)
 {
-  lingo_assert(roots.count(r) == 1);
-  roots.erase(r);
+  pending_[r->pending_ - 1] = nullptr;
+  r->pending_ = 0;
+  Mark_stack m;
+  r->reach(m);
+  m.drain();
+}
+
+
+// Grow the storage for a root's references.
+void
+Reach::grow()
+{
+  std::size_t n = size();
+  Collectable** p = new Collectable*[2 * n];
+  std::copy(first_, last_, p);
+  if (first_ != buf_)
+    delete [] first_;
+  first_ = p;
+  last_ = p + n;
+  limit_ = p + 2 * n;
+}
+
+
+// Mark `c` and every object reachable from it.
+void
+Collecting_factory::reach(Collectable* c)
+{
+  Mark_stack m;
+  m.visit(c);
+  m.drain();
 }
 
 
@@ -41,31 +404,177 @@ void
 Collecting_factory::mark()
 {
   // Make each object unreached.
-  for (Collectable* p : objects)
-    p->marked = false;
+  for (Size_class& c : classes_)
+    for (Slab* s : c.slabs)
+      std::fill(s->marks, s->marks + bitmap_words(s), 0);
 
   // Mark reachable objects.
-  for (auto& x : roots) {
-    x.second->reach();
+  if (policy_.mark_threads > 1) {
+    mark_parallel(policy_.mark_threads);
+    return;
+  }
+  Mark_stack m;
+  for (Thread* t = threads_; t; t = t->next)
+    for (Reach* r = t->roots; r; r = r->next_)
+      r->reach(m);
+  m.drain();
+}
+
+
+namespace
+{
+
+// A mark worker owns a private mark stack. When other workers may
+// be idle, part of that stack is moved to a shared queue, from
+// which other workers can steal.
+struct Mark_worker
+{
+  Mark_worker()
+    : shared(0)
+  { }
+
+  Mark_stack               stack;
+  std::mutex               mutex;
+  std::deque<Collectable*> queue;
+  std::atomic<std::size_t> shared; // The size of the queue
+};
+
+
+// The number of objects traced between checks for sharing.
+constexpr std::size_t share_interval = 64;
+
+
+} // namespace
+
+
+// Mark reachable objects using `n` threads. The roots are divided
+// among the workers, and each worker traces from its own stack.
+// An idle worker steals half of the shared objects of another.
+// Marking ends when every worker is idle and no work is shared.
+void
+Collecting_factory::mark_parallel(std::size_t n)
+{
+  std::unique_ptr<Mark_worker[]> ws(new Mark_worker[n]);
+  std::size_t k = 0;
+  for (Thread* t = threads_; t; t = t->next)
+    for (Reach* r = t->roots; r; r = r->next_)
+      r->reach(ws[k++ % n].stack);
+
+  std::atomic<std::size_t> idle(0);
+
+  // Move half of the objects of w's stack to its queue.
+  auto share = [](Mark_worker& w) {
+    std::vector<Collectable*>& v = w.stack.stack_;
+    std::size_t h = v.size() / 2;
+    std::lock_guard<std::mutex> lock(w.mutex);
+    w.queue.insert(w.queue.end(), v.begin(), v.begin() + h);
+    v.erase(v.begin(), v.begin() + h);
+    w.shared.store(w.queue.size(), std::memory_order_release);
+  };
+
+  // Move half of the objects in the queue of `v` to the stack
+  // of `w`. Returns true if any were moved.
+  auto take = [](Mark_worker& w, Mark_worker& v) {
+    if (v.shared.load(std::memory_order_acquire) == 0)
+      return false;
+    std::lock_guard<std::mutex> lock(v.mutex);
+    std::size_t h = (v.queue.size() + 1) / 2;
+    std::vector<Collectable*>& s = w.stack.stack_;
+    s.insert(s.end(), v.queue.begin(), v.queue.begin() + h);
+    v.queue.erase(v.queue.begin(), v.queue.begin() + h);
+    v.shared.store(v.queue.size(), std::memory_order_release);
+    return h != 0;
+  };
+
+  auto work = [&](std::size_t i) {
+    Mark_worker& w = ws[i];
+    while (true) {
+      std::size_t count = 0;
+      while (Collectable* c = w.stack.pop()) {
+        c->trace(w.stack);
+        if (++count % share_interval == 0 && w.stack.size() > 1 && w.shared == 0)
+          share(w);
+      }
+
+      // Look for more work, starting with our own queue.
+      bool found = false;
+      for (std::size_t j = 0; j < n && !found; ++j)
+        found = take(w, ws[(i + j) % n]);
+      if (found)
+        continue;
+
+      // Wait until work is shared or every worker is idle.
+      ++idle;
+      while (true) {
+        bool shared = false;
+        for (std::size_t j = 0; j < n && !shared; ++j)
+          shared = ws[j].shared != 0;
+        if (shared) {
+          --idle;
+          break;
+        }
+        if (idle == n)
+          return;
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < n; ++i)
+    threads.emplace_back(work, i);
+  work(0);
+  for (std::thread& t : threads)
+    t.join();
+
+  // Trace anything left behind by a worker that stopped while
+  // another was publishing work.
+  for (std::size_t i = 0; i < n; ++i) {
+    Mark_stack& m = ws[i].stack;
+    m.stack_.insert(m.stack_.end(), ws[i].queue.begin(), ws[i].queue.end());
+    m.drain();
   }
 }
 
 
+// Reclaim the unreachable objects in the slab `s`. An object is
+// garbage when its slot is in use but not marked. Returns true if
+// any object was reclaimed.
+bool
+Collecting_factory::sweep(Slab* s)
+{
+  bool freed = false;
+  std::size_t n = bitmap_words(s);
+  for (std::size_t w = 0; w < n; ++w) {
+    std::uint64_t dead = s->used[w] & ~s->marks[w];
+    if (!dead)
+      continue;
+    while (dead) {
+      std::size_t i = w * 64 + __builtin_ctzll(dead);
+      dead &= dead - 1;
+      Collectable* o = reinterpret_cast<Collectable*>(s->data + i * s->slot);
+      o->~Collectable();
+      --s->live;
+      --count_;
+      live_bytes_ -= s->slot;
+    }
+    s->used[w] &= s->marks[w];
+    freed = true;
+  }
+  return freed;
+}
+
+
 // Reclaim unreachable objects.
 void
 Collecting_factory::sweep()
 {
-  // FIXME: Is there an algorithm that does this? list::remove_if
-  // is close, but it won't delete the associated data.
-  auto iter = objects.begin();
-  while (iter != objects.end()) {
-    Collectable* o = *iter;
-    if (!o->marked) {
-      delete o;
-      iter = objects.erase(iter);
-    } else {
-      ++iter;
-    }
+  for (Size_class& c : classes_) {
+    bool freed = false;
+    for (Slab* s : c.slabs)
+      freed |= sweep(s);
+    if (freed)
+      refill(c);
   }
 }
 
@@ -74,11 +583,383 @@ Collecting_factory::sweep()
 // algorithm. We first traverse all roots, marking each
 // reachable object. Then, we traverse all objects,
 // deleting those that aren't marked.
+//
+// If an incremental collection is in progress, it is
+// completed first.
 void
 Collecting_factory::collect()
 {
-  mark();
-  sweep();
+  thread();
+  step(-1);
+  std::unique_lock<std::mutex> lock(mutex_);
+  stop(lock);
+  collect(nullptr);
+  resume();
+}
+
+
+// Perform a full collection. If `obj` is non-null, it is treated
+// as a root. The world must be stopped.
+void
+Collecting_factory::collect(Collectable* obj)
+{
+  lingo_profile("collect");
+  Clock::time_point t0 = Clock::now();
+  {
+    lingo_profile("mark");
+    mark();
+    if (obj)
+      reach(obj);
+  }
+  stats_.last_mark = seconds_since(t0);
+
+  Clock::time_point t1 = Clock::now();
+  {
+    lingo_profile("sweep");
+    sweep();
+  }
+  stats_.last_sweep = seconds_since(t1);
+
+  stats_.total_mark += stats_.last_mark;
+  stats_.total_sweep += stats_.last_sweep;
+  finish();
+}
+
+
+// Update counters at the end of a collection. The counts of
+// all threads have been published.
+void
+Collecting_factory::finish()
+{
+  objects_ = 0;
+  bytes_ = 0;
+  ++stats_.collections;
+  stats_.live_objects = count_;
+  stats_.live_bytes = live_bytes_;
+}
+
+
+// Returns the number of objects currently allocated.
+std::size_t
+Collecting_factory::objects() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::size_t n = count_;
+  for (Thread* t = threads_; t; t = t->next)
+    n += t->count;
+  return n;
+}
+
+
+// Set the collection policy. Any incremental collection that
+// is in progress is completed first.
+void
+Collecting_factory::set_policy(Collection_policy const& p)
+{
+  step(-1);
+  policy_ = p;
+}
+
+
+// Returns true if enough memory has been allocated since the
+// last collection to start a new one. This includes allocations
+// by the current thread that have not been published.
+bool
+Collecting_factory::should_collect() const
+{
+  Thread const& t = *self_;
+  if (policy_.objects && objects_ + t.objects >= policy_.objects)
+    return true;
+  if (policy_.bytes && bytes_ + t.bytes >= policy_.bytes)
+    return true;
+  return false;
+}
+
+
+// Perform automatic collection after the allocation of `obj`.
+// The new object is treated as a root for any collection that
+// is in progress or started here.
+void
+Collecting_factory::poll(Collectable* obj)
+{
+  if (phase_ != idle_phase)
+    reach(obj);
+  if (self_->inhibit)
+    return;
+  if (phase_ == idle_phase) {
+    if (!should_collect())
+      return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (policy_.mode == threshold_collection || attached_ > 1) {
+      stop(lock);
+      collect(obj);
+      resume();
+      return;
+    }
+    flush(*self_);
+    start();
+    reach(obj);
+  }
+  step(policy_.slice);
+}
+
+
+// Start an incremental collection. This requires that only one
+// thread is attached.
+void
+Collecting_factory::start()
+{
+  lingo_assert(attached_ == 1);
+  for (Size_class& c : classes_)
+    for (Slab* s : c.slabs)
+      std::fill(s->marks, s->marks + bitmap_words(s), 0);
+  pending_.clear();
+  for (Reach* r = threads_->roots; r; r = r->next_) {
+    pending_.push_back(r);
+    r->pending_ = pending_.size();
+  }
+  phase_ = mark_phase;
+  class_ = 0;
+  slab_ = 0;
+  freed_ = false;
+  objects_ = 0;
+  bytes_ = 0;
+  stats_.last_mark = 0;
+  stats_.last_sweep = 0;
+}
+
+
+// Perform up to `n` units of incremental work.
+void
+Collecting_factory::step(std::size_t n)
+{
+  while (n != 0 && phase_ != idle_phase) {
+    Clock::time_point t = Clock::now();
+    if (phase_ == mark_phase) {
+      if (pending_.empty()) {
+        phase_ = sweep_phase;
+        continue;
+      }
+      Reach* r = pending_.back();
+      pending_.pop_back();
+      if (!r)
+        continue;
+      r->pending_ = 0;
+      Mark_stack m;
+      r->reach(m);
+      m.drain();
+      --n;
+      double d = seconds_since(t);
+      stats_.last_mark += d;
+      stats_.total_mark += d;
+    } else {
+      Size_class& c = classes_[class_];
+      if (slab_ < c.slabs.size()) {
+        freed_ |= sweep(c.slabs[slab_++]);
+        --n;
+      } else {
+        if (freed_)
+          refill(c);
+        freed_ = false;
+        slab_ = 0;
+        if (++class_ == classes_.size())
+          end();
+      }
+      double d = seconds_since(t);
+      stats_.last_sweep += d;
+      stats_.total_sweep += d;
+    }
+  }
+}
+
+
+// Complete an incremental collection. Threads waiting to attach
+// are allowed to proceed. Note that the mutex must not be held.
+void
+Collecting_factory::end()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush(*threads_);
+    phase_ = idle_phase;
+    finish();
+  }
+  cv_.notify_all();
+}
+
+
+// Attach the thread `t` to the collector. This waits for any
+// collection in progress to complete.
+void
+Collecting_factory::attach(Thread& t)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this]() { return !stopping_ && phase_ == idle_phase; });
+  t.next = threads_;
+  if (threads_)
+    threads_->prev = &t;
+  threads_ = &t;
+  ++attached_;
+  self_ = &t;
+}
+
+
+// Detach the thread `t` from the collector. The thread's counts
+// are published and its slabs are made available to other
+// threads.
+void
+Collecting_factory::detach(Thread& t)
+{
+  if (self_ != &t)
+    return;
+  step(-1);
+  {
+    // The thread is parked while it waits so that it does not
+    // prevent a collection in progress.
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++parked_;
+    cv_.notify_all();
+    cv_.wait(lock, [this]() { return !stopping_; });
+    --parked_;
+    flush(t);
+    for (std::size_t k = 0; k < num_classes; ++k)
+      if (t.cache[k] && t.cache[k]->free)
+        classes_[k].available.push_back(t.cache[k]);
+    for (auto const& x : t.types) {
+      Allocation_stats& a = types_[x.first];
+      a.objects += x.second.objects;
+      a.bytes += x.second.bytes;
+    }
+    if (t.prev)
+      t.prev->next = t.next;
+    else
+      threads_ = t.next;
+    if (t.next)
+      t.next->prev = t.prev;
+    --attached_;
+    self_ = nullptr;
+  }
+  cv_.notify_all();
+}
+
+
+// Publish the counts of the thread `t`. The mutex must be held.
+void
+Collecting_factory::flush(Thread& t)
+{
+  count_ += t.count;
+  live_bytes_ += t.size;
+  objects_ += t.objects;
+  bytes_ += t.bytes;
+  t.count = t.size = t.objects = t.bytes = 0;
+}
+
+
+// Stop the world. The calling thread waits until every other
+// attached thread is parked. If another thread is already
+// collecting, the calling thread is parked until that
+// collection has finished.
+void
+Collecting_factory::stop(std::unique_lock<std::mutex>& lock)
+{
+  ++parked_;
+  cv_.notify_all();
+  cv_.wait(lock, [this]() { return !stopping_; });
+  stopping_ = true;
+  cv_.wait(lock, [this]() { return parked_ == attached_; });
+  for (Thread* t = threads_; t; t = t->next)
+    flush(*t);
+}
+
+
+// Resume the world after a collection. The mutex must be held.
+void
+Collecting_factory::resume()
+{
+  --parked_;
+  stopping_ = false;
+  cv_.notify_all();
+}
+
+
+// Park the current thread until the requested collection has
+// finished.
+void
+Collecting_factory::park()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  ++parked_;
+  cv_.notify_all();
+  cv_.wait(lock, [this]() { return !stopping_; });
+  --parked_;
+}
+
+
+// Record the allocation of an object of type `t` requiring `n`
+// bytes.
+void
+Collecting_factory::record(std::type_info const& t, std::size_t n)
+{
+  Allocation_stats& a = thread().types[&t];
+  ++a.objects;
+  a.bytes += n;
+}
+
+
+// Returns the current statistics. Per-type counts are keyed by
+// the name of the type. Note that the same type may have more
+// than one type_info object, so counts are merged by name.
+Collection_stats
+Collecting_factory::stats() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Collection_stats s = stats_;
+  auto merge = [&s](Thread::Type_map const& m) {
+    for (auto const& x : m) {
+      Allocation_stats& a = s.types[type_str(*x.first)];
+      a.objects += x.second.objects;
+      a.bytes += x.second.bytes;
+    }
+  };
+  merge(types_);
+  for (Thread* t = threads_; t; t = t->next)
+    merge(t->types);
+  return s;
+}
+
+
+// Reset all statistics.
+void
+Collecting_factory::reset_stats()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  types_.clear();
+  for (Thread* t = threads_; t; t = t->next)
+    t->types.clear();
+  stats_ = Collection_stats();
+}
+
+
+// Mark the current thread as safe for collection.
+Gc_safe_region::Gc_safe_region()
+{
+  Collecting_factory& f = gc();
+  f.thread();
+  {
+    std::lock_guard<std::mutex> lock(f.mutex_);
+    ++f.parked_;
+  }
+  f.cv_.notify_all();
+}
+
+
+// Wait for any collection in progress before resuming.
+Gc_safe_region::~Gc_safe_region()
+{
+  Collecting_factory& f = gc();
+  std::unique_lock<std::mutex> lock(f.mutex_);
+  f.cv_.wait(lock, [&f]() { return !f.stopping_; });
+  --f.parked_;
 }
 
 
@@ -90,4 +971,31 @@ gc()
 }
 
 
+// -------------------------------------------------------------------------- //
+//                            Statistics
+
+std::ostream&
+operator<<(std::ostream& os, Factory_stats const& s)
+{
+  return os << "hits: " << s.hits << ", "
+            << "misses: " << s.misses << ", "
+            << "hit rate: " << s.hit_rate();
+}
+
+
+std::ostream&
+operator<<(std::ostream& os, Collection_stats const& s)
+{
+  os << "collections: " << s.collections << '\n';
+  os << "live objects: " << s.live_objects << '\n';
+  os << "live bytes: " << s.live_bytes << '\n';
+  os << "mark time: " << s.last_mark << " (total " << s.total_mark << ")\n";
+  os << "sweep time: " << s.last_sweep << " (total " << s.total_sweep << ")\n";
+  for (auto const& x : s.types)
+    os << x.first << ": " << x.second.objects << " objects, "
+                          << x.second.bytes << " bytes\n";
+  return os;
+}
+
+
 } // namespace lingo
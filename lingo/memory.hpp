@@ -6,8 +6,21 @@
 
 #include <lingo/node.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
 #include <list>
+#include <map>
+#include <mutex>
+#include <new>
 #include <set>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
 #include <unordered_map>
 #include <vector>
 
@@ -16,14 +29,82 @@ namespace lingo
 
 class Integer;
 class String_view;
+class Interned_string;
 class Token;
 
+// -------------------------------------------------------------------------- //
+//                            Statistics
+
+// Counts the requests made of a factory that reuses objects. A hit
+// is a request satisfied by a previously created object.
+struct Factory_stats
+{
+  Factory_stats()
+    : hits(0), misses(0)
+  { }
+
+  // Returns the fraction of requests that were hits.
+  double hit_rate() const
+  {
+    std::size_t n = hits + misses;
+    return n ? double(hits) / n : 0.0;
+  }
+
+  std::size_t hits;
+  std::size_t misses;
+};
+
+
+// Counts the objects and bytes allocated for a type.
+struct Allocation_stats
+{
+  Allocation_stats()
+    : objects(0), bytes(0)
+  { }
+
+  std::size_t objects;
+  std::size_t bytes;
+};
+
+
+// Statistics collected by the garbage collector. Allocations
+// are recorded only when statistics are enabled. Times are in
+// seconds.
+struct Collection_stats
+{
+  using Type_map = std::map<std::string, Allocation_stats>;
+
+  Collection_stats()
+    : collections(0)
+    , live_objects(0)
+    , live_bytes(0)
+    , last_mark(0), last_sweep(0)
+    , total_mark(0), total_sweep(0)
+  { }
+
+  Type_map    types;        // Allocations per type, by type_str
+  std::size_t collections;  // Completed collections
+  std::size_t live_objects; // Objects surviving the last collection
+  std::size_t live_bytes;   // Bytes surviving the last collection
+  double      last_mark;    // Duration of the last mark phase
+  double      last_sweep;   // Duration of the last sweep phase
+  double      total_mark;
+  double      total_sweep;
+};
+
+
+std::ostream& operator<<(std::ostream&, Factory_stats const&);
+std::ostream& operator<<(std::ostream&, Collection_stats const&);
+
+
 // -------------------------------------------------------------------------- //
 //                            Factories
 
 // A unique factory will only allocate new objects if
 // they have not been previously created. A strict weak
 // order is used to determine the uniqueness of objects.
+//
+// See also Hashed_unique_factory.
 template<typename T, typename C>
 struct Unique_factory : std::set<T, C>
 {
@@ -32,8 +113,16 @@ struct Unique_factory : std::set<T, C>
   T* make(Args&&... args)
   {
     auto ins = this->emplace(std::forward<Args>(args)...);
+    if (ins.second)
+      ++stats_.misses;
+    else
+      ++stats_.hits;
     return const_cast<T*>(&*ins.first);
   }
+
+  Factory_stats const& stats() const { return stats_; }
+
+  Factory_stats stats_;
 };
 
 
@@ -52,12 +141,423 @@ struct Singleton_factory
   template<typename... Args>
   T* make(Args&&... args)
   {
-    if (!object)
+    if (!object) {
       object = new T(std::forward<Args>(args)...);
+      ++stats_.misses;
+    } else {
+      ++stats_.hits;
+    }
     return object;
   }
 
+  Factory_stats const& stats() const { return stats_; }
+
   T* object;
+  Factory_stats stats_;
+};
+
+
+// -------------------------------------------------------------------------- //
+//                            Arena allocation
+
+// An arena is a region of memory from which objects are allocated
+// by bumping a pointer. Memory is acquired from the system in large
+// chunks, and all of it is released at once when the arena is reset
+// or destroyed. Individual objects are never freed.
+//
+// Arenas are appropriate for data whose lifetime ends at a common
+// point, like the nodes of a tree that is discarded at the end of a
+// translation unit.
+class Arena
+{
+public:
+  static constexpr std::size_t default_chunk_size = 64 * 1024;
+
+  Arena(std::size_t = default_chunk_size);
+  ~Arena();
+
+  Arena(Arena const&) = delete;
+  Arena& operator=(Arena const&) = delete;
+
+  void* allocate(std::size_t, std::size_t = alignof(std::max_align_t));
+
+  void reset();
+
+  // Returns the number of bytes allocated from the arena since
+  // it was constructed or last reset.
+  std::size_t bytes_allocated() const { return bytes_; }
+
+private:
+  void* allocate_chunk(std::size_t, std::size_t);
+
+  // A chunk of memory acquired from the system. The chunk
+  // header immediately precedes the usable storage.
+  struct Chunk
+  {
+    Chunk*      next;
+    std::size_t size;
+  };
+
+  std::size_t size_;  // The default chunk size
+  Chunk*      chunks_; // The list of allocated chunks
+  char*       first_; // The next free byte of the current chunk
+  char*       last_;  // Past the end of the current chunk
+  std::size_t bytes_; // Total bytes allocated
+};
+
+
+// Allocate `n` bytes of storage aligned to `a` bytes. Note
+// that `a` must be a power of 2.
+inline void*
+Arena::allocate(std::size_t n, std::size_t a)
+{
+  std::uintptr_t p = reinterpret_cast<std::uintptr_t>(first_);
+  std::uintptr_t q = (p + a - 1) & ~(std::uintptr_t)(a - 1);
+  char* r = reinterpret_cast<char*>(q);
+  if (first_ && r + n <= last_) {
+    first_ = r + n;
+    bytes_ += n;
+    return r;
+  }
+  return allocate_chunk(n, a);
+}
+
+
+// The arena factory allocates objects in an arena. Objects are
+// destroyed in the reverse order of their construction when the
+// factory is reset or destroyed. Objects with trivial destructors
+// are not tracked.
+class Arena_factory
+{
+public:
+  Arena_factory(std::size_t n = Arena::default_chunk_size)
+    : arena_(n), dtors_(nullptr)
+  { }
+
+  ~Arena_factory() { destroy(); }
+
+  // Create an object of type T.
+  template<typename T, typename... Args>
+  T* make(Args&&... args)
+  {
+    void* p = arena_.allocate(sizeof(T), alignof(T));
+    T* obj = new (p) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value)
+      track(obj, [](void* q) { static_cast<T*>(q)->~T(); });
+    return obj;
+  }
+
+  // Destroy all objects and release all memory.
+  void reset()
+  {
+    destroy();
+    arena_.reset();
+  }
+
+  Arena&       arena()       { return arena_; }
+  Arena const& arena() const { return arena_; }
+
+private:
+  // A record of an object to be destroyed. These are allocated
+  // in the arena and form a stack of pending destructor calls.
+  struct Dtor
+  {
+    void (*fn)(void*);
+    void* obj;
+    Dtor* next;
+  };
+
+  void track(void* obj, void (*fn)(void*))
+  {
+    void* p = arena_.allocate(sizeof(Dtor), alignof(Dtor));
+    dtors_ = new (p) Dtor{fn, obj, dtors_};
+  }
+
+  void destroy();
+
+  Arena arena_;
+  Dtor* dtors_;
+};
+
+
+// An arena scope makes an arena factory the current factory for
+// its lifetime. Scopes nest, and the previous factory is restored
+// when the scope ends. When no scope is active, the current
+// factory is a long-lived factory whose objects are destroyed at
+// program exit.
+//
+// The current factory is maintained per thread. Note that the
+// long-lived factory is shared, and it is not safe to allocate
+// from it in more than one thread at a time.
+//
+// Arena scopes are used to release all of the objects created
+// during some phase of processing at once. Objects that must
+// outlive that phase are copied into the long-lived factory
+// within a scope for that factory.
+//
+//    Arena_factory f;
+//    Arena_scope s(f);
+//    ... // Allocations from Arena_scope::current() use f
+class Arena_scope
+{
+public:
+  Arena_scope(Arena_factory& f)
+    : prev_(current_)
+  {
+    current_ = &f;
+  }
+
+  ~Arena_scope() { current_ = prev_; }
+
+  Arena_scope(Arena_scope const&) = delete;
+  Arena_scope& operator=(Arena_scope const&) = delete;
+
+  // Returns the current factory.
+  static Arena_factory& current() { return current_ ? *current_ : global(); }
+
+  // Returns the long-lived factory.
+  static Arena_factory& global();
+
+private:
+  Arena_factory* prev_;
+
+  static thread_local Arena_factory* current_;
+};
+
+
+// -------------------------------------------------------------------------- //
+//                            Hash-consing
+
+// Combine the hash value `h` into the seed `s`.
+inline std::size_t
+hash_combine(std::size_t s, std::size_t h)
+{
+  return s ^ (h + 0x9e3779b97f4a7c15ull + (s << 6) + (s >> 2));
+}
+
+
+namespace node_hash_impl
+{
+
+template<typename T>
+inline std::size_t
+hash_term(T const& t)
+{
+  return std::hash<T>()(t);
+}
+
+
+template<typename T>
+inline typename std::enable_if<is_nullary_node<T>(), std::size_t>::type
+hash_node(T const& t)
+{
+  return std::hash<T>()(t);
+}
+
+
+template<typename T>
+inline typename std::enable_if<is_unary_node<T>(), std::size_t>::type
+hash_node(T const& t)
+{
+  return hash_term(t.first);
+}
+
+
+template<typename T>
+inline typename std::enable_if<is_binary_node<T>(), std::size_t>::type
+hash_node(T const& t)
+{
+  return hash_combine(hash_term(t.first), hash_term(t.second));
+}
+
+
+template<typename T>
+inline typename std::enable_if<is_ternary_node<T>(), std::size_t>::type
+hash_node(T const& t)
+{
+  std::size_t h = hash_term(t.first);
+  h = hash_combine(h, hash_term(t.second));
+  return hash_combine(h, hash_term(t.third));
+}
+
+
+template<typename T>
+inline typename std::enable_if<is_kary_node<T>(), std::size_t>::type
+hash_node(T const& t)
+{
+  std::size_t h = 0;
+  for (auto const& x : t)
+    h = hash_combine(h, hash_term(x));
+  return h;
+}
+
+
+template<typename T>
+inline typename std::enable_if<is_nullary_node<T>(), bool>::type
+equal_node(T const& a, T const& b)
+{
+  return a == b;
+}
+
+
+template<typename T>
+inline typename std::enable_if<is_unary_node<T>(), bool>::type
+equal_node(T const& a, T const& b)
+{
+  return a.first == b.first;
+}
+
+
+template<typename T>
+inline typename std::enable_if<is_binary_node<T>(), bool>::type
+equal_node(T const& a, T const& b)
+{
+  return a.first == b.first && a.second == b.second;
+}
+
+
+template<typename T>
+inline typename std::enable_if<is_ternary_node<T>(), bool>::type
+equal_node(T const& a, T const& b)
+{
+  return a.first == b.first && a.second == b.second && a.third == b.third;
+}
+
+
+template<typename T>
+inline typename std::enable_if<is_kary_node<T>(), bool>::type
+equal_node(T const& a, T const& b)
+{
+  return std::equal(a.begin(), a.end(), b.begin(), b.end());
+}
+
+} // namespace node_hash_impl
+
+
+// The default hash function for nodes is derived from the
+// structure of the node: the hash values of its sub-terms are
+// combined. Sub-terms that are node pointers are hashed by
+// identity, which is correct when those sub-terms have
+// themselves been uniqued. Nullary nodes are hashed with
+// std::hash.
+template<typename T>
+struct Node_hash
+{
+  std::size_t operator()(T const& t) const
+  {
+    return node_hash_impl::hash_node(t);
+  }
+};
+
+
+// The default equality for nodes compares sub-terms. Nullary
+// nodes are compared using ==.
+template<typename T>
+struct Node_equal
+{
+  bool operator()(T const& a, T const& b) const
+  {
+    return node_hash_impl::equal_node(a, b);
+  }
+};
+
+
+// A hashed unique factory is an alternative to the Unique_factory
+// that finds previously created objects using an open-addressing
+// hash table. Objects are allocated in an arena, so their addresses
+// are stable, and they are destroyed with the factory.
+//
+// The hash function H and equivalence relation E are applied to
+// objects of type T. By default, both are derived from the structure
+// of the node.
+template<typename T, typename H = Node_hash<T>, typename E = Node_equal<T>>
+class Hashed_unique_factory
+{
+public:
+  Hashed_unique_factory(H h = H(), E e = E())
+    : hash_(h), eq_(e), count_(0)
+  { }
+
+  Hashed_unique_factory(Hashed_unique_factory const&) = delete;
+  Hashed_unique_factory& operator=(Hashed_unique_factory const&) = delete;
+
+  // Create an object of type T, or return a previously created
+  // object that is equivalent to it. The candidate object is
+  // constructed on the stack and moved into the arena only when
+  // it is new.
+  template<typename... Args>
+  T* make(Args&&... args)
+  {
+    T tmp(std::forward<Args>(args)...);
+    std::size_t h = hash_(tmp);
+    if (4 * (count_ + 1) > 3 * table_.size())
+      grow();
+    Entry* e = probe(tmp, h);
+    if (!e->obj) {
+      e->hash = h;
+      e->obj = objects_.template make<T>(std::move(tmp));
+      ++count_;
+      ++stats_.misses;
+    } else {
+      ++stats_.hits;
+    }
+    return e->obj;
+  }
+
+  // Returns the previously created object that is equivalent to
+  // `t`, or null if there is none.
+  T* find(T const& t)
+  {
+    if (table_.empty())
+      return nullptr;
+    return probe(t, hash_(t))->obj;
+  }
+
+  // Returns the number of unique objects.
+  std::size_t size() const { return count_; }
+
+  Factory_stats const& stats() const { return stats_; }
+
+private:
+  struct Entry
+  {
+    std::size_t hash;
+    T*          obj;
+  };
+
+  // Returns the entry holding an object equal to `t`, or the
+  // empty entry where it would be inserted.
+  Entry* probe(T const& t, std::size_t h)
+  {
+    std::size_t mask = table_.size() - 1;
+    for (std::size_t i = h & mask; ; i = (i + 1) & mask) {
+      Entry& e = table_[i];
+      if (!e.obj || (e.hash == h && eq_(*e.obj, t)))
+        return &e;
+    }
+  }
+
+  void grow()
+  {
+    std::vector<Entry> old(table_.empty() ? 16 : 2 * table_.size(), Entry{0, nullptr});
+    old.swap(table_);
+    std::size_t mask = table_.size() - 1;
+    for (Entry& e : old) {
+      if (!e.obj)
+        continue;
+      std::size_t i = e.hash & mask;
+      while (table_[i].obj)
+        i = (i + 1) & mask;
+      table_[i] = e;
+    }
+  }
+
+  H                  hash_;
+  E                  eq_;
+  std::vector<Entry> table_;
+  std::size_t        count_;
+  Arena_factory      objects_;
+  Factory_stats      stats_;
 };
 
 
@@ -65,22 +565,154 @@ struct Singleton_factory
 //                          Garbage collector
 
 class Collecting_factory;
+class Mark_stack;
 class Reach;
 
 
 // Every object allocated through the garbage collector is
 // an instance of the Collectable type.
+//
+// Note that the mark state of a collectable object is not
+// stored in the object. It is kept in the mark bitmap of the
+// slab that contains the object.
 struct Collectable
 {
-  Collectable()
-    : marked(false)
+  virtual ~Collectable() { }
+
+  // Push the collectable objects referred to by this object
+  // onto the mark stack.
+  virtual void trace(Mark_stack&) = 0;
+};
+
+
+// Node types may derive from the Gc_header class to identify
+// themselves as collectable at compile time. The collector sets the
+// header when an object is allocated by Collecting_factory, so that
+// marking and root registration can find the object's slab without
+// a dynamic_cast. Objects of such types that are allocated by other
+// means (e.g., new) simply have a cleared header and are treated as
+// uncollected.
+struct Gc_header
+{
+  Gc_header()
+    : collected_(false)
   { }
 
-  virtual ~Collectable() { }
+  // Returns true if the object was allocated by the collector.
+  bool is_collected() const { return collected_; }
+
+  bool collected_;
+};
+
+
+// Returns true if T has an intrusive GC header.
+template<typename T>
+constexpr bool
+has_gc_header()
+{
+  return std::is_base_of<Gc_header, T>::value;
+}
+
+
+// A slab is a large, aligned block of memory that is divided
+// into slots of a single size. Each slab keeps two bitmaps at
+// its head: one recording which slots hold live objects, and
+// one recording which objects were reached during the mark
+// phase of garbage collection.
+//
+// Because slabs are aligned on their size, the slab containing
+// an object is found by masking the object's address.
+struct Slab
+{
+  static constexpr std::size_t size      = 64 * 1024;
+  static constexpr std::size_t min_slot  = 16;
+  static constexpr std::size_t max_slots = size / min_slot;
+  static constexpr std::size_t words     = max_slots / 64;
+
+  // Returns the slab containing the object at `p`.
+  static Slab* of(void const* p)
+  {
+    std::uintptr_t n = reinterpret_cast<std::uintptr_t>(p);
+    return reinterpret_cast<Slab*>(n & ~(std::uintptr_t)(size - 1));
+  }
+
+  // Returns the index of the slot containing `p`.
+  std::size_t index(void const* p) const
+  {
+    return (static_cast<char const*>(p) - data) / slot;
+  }
+
+  // Returns the start of the slot containing `p`. This is the
+  // address of the Collectable sub-object of the allocated object.
+  Collectable* object(void const* p) const
+  {
+    return reinterpret_cast<Collectable*>(data + index(p) * slot);
+  }
 
-  virtual void reach() = 0;
+  // Set the mark bit for the object at `p`. Returns true if
+  // the object was not previously marked. Note that the mark
+  // bit is set atomically, since marking may be done by several
+  // threads at once.
+  bool mark(void const* p)
+  {
+    std::size_t n = index(p);
+    std::uint64_t bit = std::uint64_t(1) << (n % 64);
+    std::uint64_t* word = &marks[n / 64];
+    if (__atomic_load_n(word, __ATOMIC_RELAXED) & bit)
+      return false;
+    return !(__atomic_fetch_or(word, bit, __ATOMIC_RELAXED) & bit);
+  }
+
+  std::size_t   slot;          // The size of each slot
+  std::size_t   count;         // The number of slots
+  std::size_t   live;          // The number of live objects
+  char*         data;          // The first slot
+  void*         free;          // The list of unused slots
+  std::uint64_t used[words];   // Slots containing objects
+  std::uint64_t marks[words];  // Objects reached during marking
+};
+
+
+// The mark stack holds collectable objects that have been marked,
+// but whose sub-terms have not yet been traced. Marking with an
+// explicit stack does not depend on the depth of the trees being
+// marked.
+class Mark_stack
+{
+public:
+  // Mark the object `c`. If it was not already marked, it is
+  // pushed onto the stack.
+  void visit(Collectable* c)
+  {
+    if (Slab::of(c)->mark(c))
+      stack_.push_back(c);
+  }
+
+  // Returns the next object to trace, or nullptr if the stack
+  // is empty.
+  Collectable* pop()
+  {
+    if (stack_.empty())
+      return nullptr;
+    Collectable* c = stack_.back();
+    stack_.pop_back();
+    return c;
+  }
+
+  // Trace objects until the stack is empty.
+  void drain()
+  {
+    while (Collectable* c = pop())
+      c->trace(*this);
+  }
+
+  bool        empty() const { return stack_.empty(); }
+  std::size_t size() const  { return stack_.size(); }
+
+private:
+  friend class Collecting_factory;
 
-  bool marked;
+  std::vector<Collectable*> stack_;
 };
 
 
@@ -89,148 +721,291 @@ struct Collectable
 // large number of types, especially nodes. This provides
 // a generic facility for traversing the common structure
 // of those nodes.
+//
+// Collectable objects are marked and pushed onto the mark
+// stack; their sub-terms are traced when they are popped.
+// Objects that were not allocated by the collector are
+// traversed immediately, since they may refer to collectable
+// objects.
 
 
 // Catch node pointers that do not have overloads.
 inline void
-mark(void const*) { }
+mark(Mark_stack&, void const*) { }
 
 
 // Do not mark arithmetic values.
 template<typename T>
 inline typename std::enable_if<std::is_arithmetic<T>::value>::type
-mark(T) { }
+mark(Mark_stack&, T) { }
 
 
 // Do not mark enumerations.
 template<typename T>
 inline typename std::enable_if<std::is_enum<T>::value>::type
-mark(T) { }
+mark(Mark_stack&, T) { }
 
 
 // Do not mark integers.
 inline void
-mark(Integer const&) { }
+mark(Mark_stack&, Integer const&) { }
 
 
 // Do not mark strings.
 inline void
-mark(String_view const&) { }
+mark(Mark_stack&, String_view const&) { }
+
+inline void
+mark(Mark_stack&, Interned_string const&) { }
 
 
 // Do not mark tokens.
 inline void
-mark(Token const&) { }
+mark(Mark_stack&, Token const&) { }
 
 
 // Mark a sequence of node pointers.
 template<typename T>
 inline void
-mark(std::vector<T const*> const& v)
+mark(Mark_stack& m, std::vector<T const*> const& v)
 {
   for (T const* t : v)
-    mark(t);
+    mark(m, t);
 }
 
 
+// Mark the object pointed to by `t` if it was allocated by the
+// garbage collector. Returns true if the sub-terms of `t` must
+// be traversed now, which is the case only for objects that
+// were not allocated by the collector. Empty and error nodes are
+// never traversed.
+//
+// When T has a GC header, this is a direct test of the header and
+// a write to the mark bitmap.
 template<typename T>
-inline void
-mark_this(T const* t)
+inline typename std::enable_if<has_gc_header<T>(), bool>::type
+mark_this(Mark_stack& m, T const* t)
 {
-  T* nc = const_cast<T*>(t);
-  if (Collectable* c = dynamic_cast<Collectable*>(nc))
-    c->marked = true;
+  if (!is_valid_node(t))
+    return false;
+  if (t->is_collected()) {
+    m.visit(Slab::of(t)->object(t));
+    return false;
+  }
+  return true;
 }
 
 
-// Mark a nullary node.
+// Otherwise, we have to determine dynamically whether the object
+// was allocated by the collector.
 template<typename T>
-inline typename std::enable_if<is_nullary_node<T>()>::type
-mark(T const* t)
+inline typename std::enable_if<!has_gc_header<T>() && std::is_polymorphic<T>::value, bool>::type
+mark_this(Mark_stack& m, T const* t)
+{
+  if (!is_valid_node(t))
+    return false;
+  if (Collectable const* c = dynamic_cast<Collectable const*>(t)) {
+    m.visit(const_cast<Collectable*>(c));
+    return false;
+  }
+  return true;
+}
+
+
+// Objects of non-polymorphic types without a GC header are never
+// allocated by the collector.
+template<typename T>
+inline typename std::enable_if<!has_gc_header<T>() && !std::is_polymorphic<T>::value, bool>::type
+mark_this(Mark_stack&, T const* t)
 {
-  mark_this(t);
+  return is_valid_node(t);
 }
 
 
-// Mark a unary node.
+// Mark the sub-terms of a nullary node.
+template<typename T>
+inline typename std::enable_if<is_nullary_node<T>()>::type
+mark_children(Mark_stack&, T const*)
+{ }
+
+
+// Mark the sub-terms of a unary node.
 template<typename T>
 inline typename std::enable_if<is_unary_node<T>()>::type
-mark(T const* t)
+mark_children(Mark_stack& m, T const* t)
 {
-  mark_this(t);
-  mark(t->first);
+  mark(m, t->first);
 }
 
 
-// Mark a binary node.
+// Mark the sub-terms of a binary node.
 template<typename T>
 inline typename std::enable_if<is_binary_node<T>()>::type
-mark(T const* t)
+mark_children(Mark_stack& m, T const* t)
 {
-  mark_this(t);
-  mark(t->first);
-  mark(t->second);
+  mark(m, t->first);
+  mark(m, t->second);
 }
 
 
-// Mark a ternary node.
+// Mark the sub-terms of a ternary node.
 template<typename T>
 inline typename std::enable_if<is_ternary_node<T>()>::type
-mark(T const* t)
+mark_children(Mark_stack& m, T const* t)
 {
-  mark_this(t);
-  mark(t->first);
-  mark(t->second);
-  mark(t->third);
+  mark(m, t->first);
+  mark(m, t->second);
+  mark(m, t->third);
 }
 
 
-// Mark a k-ary node.
+// Mark the sub-terms of a k-ary node. Each collectable sub-term
+// is a separate unit of work, so wide nodes are divided among
+// the threads marking in parallel.
 template<typename T>
 inline typename std::enable_if<is_kary_node<T>()>::type
-mark(T const* t)
+mark_children(Mark_stack& m, T const* t)
 {
-  mark_this(t);
   for (auto const* p : *t)
-    mark(p);
+    mark(m, p);
 }
 
 
+// Mark a node.
+template<typename T>
+inline void
+mark(Mark_stack& m, T const* t)
+{
+  if (mark_this(m, t))
+    mark_children(m, t);
+}
+
+
+// Determines when the garbage collector runs.
+//
+// In manual mode, the collector runs only when collect() is called.
+// Threshold mode runs a full collection when the number of objects
+// or bytes allocated since the last collection exceed the limits of
+// the policy. Incremental mode starts a collection at the same
+// point, but performs only a bounded amount of work on each
+// allocation until the collection is complete.
+enum Collection_mode
+{
+  manual_collection,
+  threshold_collection,
+  incremental_collection
+};
+
+
+// A collection policy configures automatic garbage collection.
+// A limit of 0 is ignored.
+//
+// The unit of incremental work is either the traversal of a single
+// root or the sweeping of a single slab. When more than one mark
+// thread is requested, full collections trace objects in parallel.
+//
+// Note that when collection is automatic, any allocation may reclaim
+// objects that are not reachable from a root. The object being
+// created is always preserved, but all others must be declared
+// with a Reach object, or automatic collection must be suspended
+// with No_collection.
+struct Collection_policy
+{
+  Collection_policy(Collection_mode m = manual_collection)
+    : mode(m), objects(0), bytes(0), slice(16), mark_threads(1)
+  { }
+
+  Collection_mode mode;
+  std::size_t     objects;      // Allocations between collections
+  std::size_t     bytes;        // Bytes allocated between collections
+  std::size_t     slice;        // Units of incremental work per allocation
+  std::size_t     mark_threads; // Threads used by the mark phase
+};
+
+
 // The garbage factory class tracks each object that it allocates.
 // At various phases of execution, the collect() function can be
 // used to reclaim unreferenced memory.
 //
 // The garbage factory is designed to collect nodes.
 //
+// Objects are allocated in slabs, segregated by size class. Each
+// slab maintains a free list of unused slots. Clearing marks
+// before a collection resets each slab's mark bitmap, and sweeping
+// scans the bitmaps for objects that are in use but unmarked.
+//
 // Note that the garbage collector is a global resource.
 //
-// TODO: The root set is not especially efficient since we have
-// to traverse it (it's an unordered map).
+// ## Threads
+//
+// Each thread that allocates objects or declares roots is attached
+// to the collector on first use and detached when it exits. A thread
+// allocates from slabs that it owns, so allocation does not require
+// locking. Slabs are acquired from the collector, and allocation
+// counts are published to it, in batches.
+//
+// Each thread has its own root set, which is an intrusive list of
+// Reach objects. Declaring and undeclaring a root only updates a
+// few pointers.
+//
+// Collection stops the world: the collecting thread waits until
+// every other attached thread has reached a safepoint (see
+// safepoint()) or is in a Gc_safe_region. Allocation is not a
+// safepoint, so threads are never stopped while building trees
+// whose nodes are not yet rooted. Incremental collection requires
+// a single attached thread; with more, automatic collection runs
+// full collections instead.
 class Collecting_factory
 {
-  // Make every T collectable.
+  // Make every T collectable. Note that Collectable is the first
+  // base so that the address of an object's slot is also the
+  // address of its Collectable sub-object.
   template<typename T>
-  struct Collectable_type : T, Collectable
+  struct Collectable_type : Collectable, T
   {
     template<typename... Args>
     Collectable_type(Args&&... args)
-      : T(std::forward<Args>(args)...), Collectable()
+      : Collectable(), T(std::forward<Args>(args)...)
     { }
 
-    void reach() override
+    void trace(Mark_stack& m) override
     {
-      using lingo::mark;
-      mark(this);
+      using lingo::mark_children;
+      mark_children(m, static_cast<T const*>(this));
     }
   };
 
 public:
+  // The size of the largest object that can be allocated.
+  static constexpr std::size_t max_object_size = 16 * 1024;
+
+  Collecting_factory();
+  ~Collecting_factory();
+
+  Collecting_factory(Collecting_factory const&) = delete;
+  Collecting_factory& operator=(Collecting_factory const&) = delete;
+
   // Create an object of type T. Note that T must be a node type.
   template<typename T, typename... Args>
   T* make(Args&&... args)
   {
-    Collectable_type<T>* obj = new Collectable_type<T>(std::forward<Args>(args)...);
-    objects.push_back(obj);
+    using U = Collectable_type<T>;
+    static_assert(sizeof(U) <= max_object_size, "object too large to collect");
+    static_assert(alignof(U) <= Slab::min_slot, "object is over-aligned");
+    void* p = allocate(sizeof(U));
+    U* obj;
+    try {
+      obj = new (p) U(std::forward<Args>(args)...);
+    } catch (...) {
+      deallocate(p);
+      throw;
+    }
+    lingo_assert(static_cast<Collectable*>(obj) == p);
+    set_header(obj);
+    if (recording_)
+      record(typeid(T), sizeof(U));
+    if (policy_.mode != manual_collection)
+      poll(obj);
     return obj;
   }
 
@@ -238,35 +1013,230 @@ public:
   void declare(Reach*);
   void undeclare(Reach*);
 
+  // Called when an object is added to a root. If a collection is
+  // in progress, the object is reached immediately.
+  void reached(Collectable* c)
+  {
+    if (phase_ != idle_phase)
+      reach(c);
+  }
+
   void collect();
 
+  // Wait for any collection requested by another thread. The
+  // calling thread's objects must be reachable from its roots.
+  void safepoint()
+  {
+    if (stopping_.load(std::memory_order_acquire))
+      park();
+  }
+
+  // Collection policy.
+  Collection_policy const& policy() const { return policy_; }
+  void set_policy(Collection_policy const&);
+
+  // Returns true if an incremental collection is in progress.
+  bool is_collecting() const { return phase_ != idle_phase; }
+
+  // Statistics. Per-type allocation counts are recorded only
+  // while statistics are enabled.
+  void enable_stats(bool b) { recording_ = b; }
+  bool stats_enabled() const { return recording_; }
+  Collection_stats stats() const;
+  void reset_stats();
+
+  // Returns the number of objects currently allocated.
+  std::size_t objects() const;
+
 private:
+  struct Thread;
+
+  void* allocate(std::size_t);
+  void  deallocate(void*);
+
   void mark();
+  void mark_parallel(std::size_t);
+  void reach(Collectable*);
   void sweep();
+  bool sweep(Slab*);
+
+  // Automatic collection.
+  void poll(Collectable*);
+  bool should_collect() const;
+  void start();
+  void step(std::size_t);
+  void collect(Collectable*);
+  void finish();
+  void record(std::type_info const&, std::size_t);
+  void unpend(Reach*);
+
+  // Thread management.
+  Thread& thread();
+  void    attach(Thread&);
+  void    detach(Thread&);
+  void    flush(Thread&);
+  void    park();
+  void    stop(std::unique_lock<std::mutex>&);
+  void    resume();
+  void    end();
+
+  // Record that an object was allocated by the collector.
+  template<typename T>
+  static typename std::enable_if<has_gc_header<T>()>::type
+  set_header(T* t) { static_cast<Gc_header*>(t)->collected_ = true; }
+
+  template<typename T>
+  static typename std::enable_if<!has_gc_header<T>()>::type
+  set_header(T*) { }
 
 private:
-  using Object_list = std::list<Collectable*>;
-  using Root_set = std::unordered_map<Reach*, Reach*>;
+  // The number of size classes.
+  static constexpr std::size_t num_classes = 22;
+
+  // A size class owns the slabs for objects of the same (rounded)
+  // size. Slabs that have unused slots and are not owned by any
+  // thread are available for allocation.
+  struct Size_class
+  {
+    Size_class(std::size_t k, std::size_t n)
+      : index(k), slot(n)
+    { }
+
+    std::size_t        index;
+    std::size_t        slot;
+    std::vector<Slab*> slabs;
+    std::vector<Slab*> available;
+  };
+
+  // The state of an attached thread. Allocation counts are
+  // published to the collector when the thread acquires a new
+  // slab and when the world is stopped.
+  struct Thread
+  {
+    Thread();
+    ~Thread();
+
+    Thread*     prev;
+    Thread*     next;
+    Reach*      roots;             // The most recently declared root
+    Slab*       cache[num_classes]; // The slab used for each class
+    std::size_t inhibit;           // Suspends automatic collection
+    std::size_t count;             // Objects allocated or freed
+    std::size_t size;              // Bytes allocated or freed
+    std::size_t objects;           // Objects allocated since the last cycle
+    std::size_t bytes;             // Bytes allocated since the last cycle
+
+    using Type_map = std::unordered_map<std::type_info const*, Allocation_stats>;
+    Type_map    types;
+  };
+
+  Slab* new_slab(Size_class&);
+  Slab* acquire(Thread&, std::size_t);
+  void  refill(Size_class&);
+
+  std::size_t class_index(std::size_t) const;
+  Size_class& size_class(std::size_t n) { return classes_[class_index(n)]; }
+
+  using Class_list = std::vector<Size_class>;
+
+  // The phases of an incremental collection.
+  enum Phase
+  {
+    idle_phase,
+    mark_phase,
+    sweep_phase
+  };
+
+  using Root_list = std::vector<Reach*>;
 
-  Object_list objects;
-  Root_set    roots;
+  Class_list  classes_;
+  std::size_t count_;
+
+  Collection_policy policy_;
+  std::size_t       objects_;  // Objects allocated since the last cycle
+  std::size_t       bytes_;    // Bytes allocated since the last cycle
+
+  // Attached threads.
+  mutable std::mutex      mutex_;
+  std::condition_variable cv_;
+  Thread*                 threads_;  // The list of attached threads
+  std::size_t             attached_; // The number of attached threads
+  std::size_t             parked_;   // Threads stopped for collection
+  std::atomic<bool>       stopping_; // True when a collection is requested
+
+  static thread_local Thread* self_;
+
+  // Incremental collection state.
+  Phase       phase_;
+  Root_list   pending_; // Roots not yet traversed
+  std::size_t class_;   // The size class being swept
+  std::size_t slab_;    // The next slab to sweep
+  bool        freed_;   // True if the size class had garbage
+
+  // Statistics.
+  bool             recording_;
+  std::size_t      live_bytes_; // Bytes in allocated slots
+  Thread::Type_map types_;      // Counts for detached threads
+  Collection_stats stats_;
+
+  friend class No_collection;
+  friend class Gc_safe_region;
 };
 
 
 Collecting_factory& gc();
 
 
+// Suspends automatic garbage collection by the current thread for
+// the lifetime of the object. This is useful when building trees
+// whose nodes are not yet reachable from a root.
+class No_collection
+{
+public:
+  No_collection() { ++gc().thread().inhibit; }
+  ~No_collection() { --gc().thread().inhibit; }
+
+  No_collection(No_collection const&) = delete;
+  No_collection& operator=(No_collection const&) = delete;
+};
+
+
+// Within a safe region, the current thread does not prevent other
+// threads from collecting garbage. This is used around long-running
+// work, like I/O, that does not allocate, declare roots, or access
+// collectable objects.
+class Gc_safe_region
+{
+public:
+  Gc_safe_region();
+  ~Gc_safe_region();
+
+  Gc_safe_region(Gc_safe_region const&) = delete;
+  Gc_safe_region& operator=(Gc_safe_region const&) = delete;
+};
+
+
 // The Reach class declares a new root into the garbage
 // collector. When this object is destroyed, it is no
 // longer a collection root.
 //
 // Note that a GC root will only store references to
-// Collectable objects.
-class Reach : std::vector<Collectable*>
+// Collectable objects. A small number of references are
+// stored within the root itself, so declaring a root does
+// not allocate memory.
+class Reach
 {
   friend class Collecting_factory;
 public:
+  static constexpr std::size_t inline_capacity = 4;
+
   Reach()
+    : prev_(nullptr)
+    , next_(nullptr)
+    , pending_(0)
+    , first_(buf_)
+    , last_(buf_)
+    , limit_(buf_ + inline_capacity)
   {
     gc().declare(this);
   }
@@ -292,8 +1262,13 @@ public:
   ~Reach()
   {
     gc().undeclare(this);
+    if (first_ != buf_)
+      delete [] first_;
   }
 
+  Reach(Reach const&) = delete;
+  Reach& operator=(Reach const&) = delete;
+
   // Declare `u` to be reachable.
   template<typename T>
   void operator()(T* t)
@@ -301,37 +1276,109 @@ public:
     declare(t);
   }
 
+  // Returns the number of objects referred to by the root.
+  std::size_t size() const { return last_ - first_; }
+
 private:
-  // Declare `t` as reachable. Note that this is only defined
-  // for pointers to objects of polymorphic type. Otherwise,
-  // don't track references.
+  // Add `c` to the root set.
+  void add(Collectable* c)
+  {
+    if (last_ == limit_)
+      grow();
+    *last_++ = c;
+    gc().reached(c);
+  }
+
+  void grow();
+
+  // Declare `t` as reachable. When T has a GC header, the object
+  // is located through its header.
+  template<typename T>
+  typename std::enable_if<has_gc_header<T>()>::type
+  declare(T* t)
+  {
+    if (is_valid_node(t) && t->is_collected())
+      add(Slab::of(t)->object(t));
+  }
+
+
+  // Otherwise, this is only defined for pointers to objects of
+  // polymorphic type. Other references are not tracked.
   template<typename T>
-  typename std::enable_if<std::is_polymorphic<T>::value>::type
+  typename std::enable_if<!has_gc_header<T>() && std::is_polymorphic<T>::value>::type
   declare(T* t)
   {
-    if (Collectable* obj = dynamic_cast<Collectable*>(t))
-      push_back(obj);
+    if (Collectable const* obj = dynamic_cast<Collectable const*>(t))
+      add(const_cast<Collectable*>(obj));
   }
 
 
   template<typename T>
-  typename std::enable_if<!std::is_polymorphic<T>::value>::type
+  typename std::enable_if<!has_gc_header<T>() && !std::is_polymorphic<T>::value>::type
   declare(T* t)
   {
   }
 
 
-  // Mark all nodes reachable from this root with
-  // the given value. This is used by the garbage
-  // collector.
-  void reach()
+  // Mark the objects of this root, pushing them onto the
+  // mark stack. This is used by the garbage collector.
+  void reach(Mark_stack& m)
   {
-    for (Collectable* r : *this)
-      r->reach();
+    for (Collectable** p = first_; p != last_; ++p)
+      m.visit(*p);
   }
+
+  Reach*        prev_;    // Adjacent roots
+  Reach*        next_;
+  std::size_t   pending_; // Position in the incremental work list
+  Collectable** first_;   // The referenced objects
+  Collectable** last_;
+  Collectable** limit_;
+  Collectable*  buf_[inline_capacity];
 };
 
 
+// Returns the state of the current thread, attaching it to
+// the collector if needed.
+inline Collecting_factory::Thread&
+Collecting_factory::thread()
+{
+  if (!self_) {
+    static thread_local Thread t;
+    attach(t);
+  }
+  return *self_;
+}
+
+
+// Declare a new GC root.
+inline void
+Collecting_factory::declare(Reach* r)
+{
+  Thread& t = thread();
+  r->next_ = t.roots;
+  if (t.roots)
+    t.roots->prev_ = r;
+  t.roots = r;
+}
+
+
+// Un-declare a GC root. If the root has not yet been traversed
+// by an incremental collection, it is traversed now.
+inline void
+Collecting_factory::undeclare(Reach* r)
+{
+  if (r->prev_)
+    r->prev_->next_ = r->next_;
+  else
+    thread().roots = r->next_;
+  if (r->next_)
+    r->next_->prev_ = r->prev_;
+  if (r->pending_)
+    unpend(r);
+}
+
+
 
 // -------------------------------------------------------------------------- //
 //                            Algorithms
@@ -227,12 +227,14 @@ has_end()
 } // namespace traits
 
 
-// Returns true if T is a Nullary_node.
+// Returns true if T is a Nullary_node. Note that k-ary nodes
+// have no accessor members, but are not nullary.
 template<typename T>
 constexpr bool
 is_nullary_node()
 {
-  return !traits::has_first<T>();
+  return !traits::has_first<T>()
+      && !(traits::has_begin<T>() && traits::has_end<T>());
 }
 
 
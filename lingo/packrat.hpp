@@ -0,0 +1,114 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_PACKRAT_HPP
+#define LINGO_PACKRAT_HPP
+
+// The packrat module provides memoization for backtracking
+// parsers. A production that is parsed speculatively, and may
+// be parsed again at the same position after backtracking, can
+// record its result so that the second parse is a lookup.
+
+#include <lingo/token.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                            Parse memos
+
+// A parse memo records the results of productions by production
+// id and the position in the token stream where they were parsed.
+// Each result is the node returned by the production, which may be
+// null or an error node, and the position after parsing.
+//
+// Memoization is enabled for a production by parsing it through
+// memoize(). When every production that can be retried at the same
+// position is memoized, speculative parsing takes linear time in the
+// number of tokens.
+//
+// A memo is valid only for the token stream it was used with, and
+// must be cleared if the contents of that stream change. Productions
+// whose results depend on state other than the stream position
+// (e.g., the current scope) should not be memoized.
+class Parse_memo
+{
+public:
+  using Position = Token_stream::Position;
+
+  // A memoized result.
+  struct Entry
+  {
+    void const* node;
+    Position    end;
+  };
+
+  Entry const* find(int, Position) const;
+  void         put(int, Position, void const*, Position);
+
+  template<typename T, typename F>
+  T const* memoize(int, Token_stream&, F);
+
+  std::size_t size() const { return map_.size(); }
+  void        clear()      { map_.clear(); }
+
+private:
+  static std::uint64_t key(int, Position);
+
+  std::unordered_map<std::uint64_t, Entry> map_;
+};
+
+
+// The key of production p at position n.
+inline std::uint64_t
+Parse_memo::key(int p, Position n)
+{
+  lingo_assert(0 <= p && p < (1 << 16) && n < (std::uint64_t(1) << 48));
+  return std::uint64_t(p) << 48 | n;
+}
+
+
+// Returns the result of production p at position n, or nullptr if
+// no result has been recorded.
+inline Parse_memo::Entry const*
+Parse_memo::find(int p, Position n) const
+{
+  auto iter = map_.find(key(p, n));
+  return iter == map_.end() ? nullptr : &iter->second;
+}
+
+
+// Record the result node of production p parsed from position n,
+// ending at position end.
+inline void
+Parse_memo::put(int p, Position n, void const* node, Position end)
+{
+  map_[key(p, n)] = {node, end};
+}
+
+
+// Parse the production p at the current position of the stream ts
+// by calling parse, unless its result at that position has already
+// been recorded. In that case, the stream is repositioned to the end
+// of the recorded parse and its result is returned.
+template<typename T, typename F>
+T const*
+Parse_memo::memoize(int p, Token_stream& ts, F parse)
+{
+  Position n = ts.position();
+  if (Entry const* e = find(p, n)) {
+    ts.reposition(e->end);
+    return static_cast<T const*>(e->node);
+  }
+  T const* r = parse();
+  put(p, n, r, ts.position());
+  return r;
+}
+
+
+} // namespace lingo
+
+#endif
@@ -0,0 +1,40 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/parsing.hpp"
+
+namespace lingo
+{
+
+// Returns the boundaries of the top-level chunks of toks. A chunk
+// ends just after each separator of kind sep that is not enclosed
+// by brackets, whose kinds are in the sets open and close. The first
+// boundary is 0, and the last is the number of tokens. No chunk is
+// empty, except when there are no tokens.
+//
+// Unmatched closing brackets are ignored. After an unmatched opening
+// bracket, there are no more boundaries; the parser of the last
+// chunk is expected to diagnose the error.
+std::vector<std::size_t>
+split_tokens(Token_seq const& toks, int sep, Token_set const& open, Token_set const& close)
+{
+  std::vector<std::size_t> splits {0};
+  int depth = 0;
+  for (std::size_t i = 0; i < toks.size(); ++i) {
+    int k = toks[i].kind();
+    if (open.contains(k))
+      ++depth;
+    else if (close.contains(k))
+      depth = std::max(depth - 1, 0);
+    else if (k == sep && depth == 0)
+      splits.push_back(i + 1);
+  }
+  if (splits.back() != toks.size() || splits.size() == 1)
+    splits.push_back(toks.size());
+  return splits;
+}
+
+
+} // namespace lingo
@@ -0,0 +1,176 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_PARSING_HPP
+#define LINGO_PARSING_HPP
+
+// The parsing module provides drivers that run the parser of a
+// language over a sequence of tokens, or over many files.
+
+#include <lingo/error.hpp>
+#include <lingo/file.hpp>
+#include <lingo/memory.hpp>
+#include <lingo/recovery.hpp>
+#include <lingo/token.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                            Parallel parsing
+
+std::vector<std::size_t> split_tokens(Token_seq const&, int, Token_set const&, Token_set const&);
+
+
+// Parse the chunks of toks in parallel using n threads, and return
+// the result of each chunk in order. The chunk i is the range of
+// tokens [splits[i], splits[i + 1]) (see split_tokens). Each chunk
+// is parsed by calling parse with a token stream over that chunk.
+//
+// Each thread allocates with a factory of its own, which is added
+// to arenas. The nodes of the results live as long as arenas. The
+// diagnostics of each chunk are collected while it is parsed, and
+// merged in order of location after all threads have finished (see
+// merge_diagnostics). If parsing a chunk throws an exception, the
+// exception of the first such chunk is then rethrown.
+//
+// Because chunks are parsed concurrently, the parser must not share
+// state between chunks. In particular, names that are declared in
+// one chunk cannot be looked up while parsing another. Those names
+// must be resolved after parsing, in a second pass over the results.
+//
+// If n is 0, the number of threads is the number of hardware
+// threads.
+template<typename T, typename Parse>
+std::vector<T const*>
+parse_in_parallel(Token_seq const& toks,
+                  std::vector<std::size_t> const& splits,
+                  std::deque<Arena_factory>& arenas,
+                  Parse parse,
+                  std::size_t n = 0)
+{
+  lingo_assert(!splits.empty() && splits.back() == toks.size());
+  std::size_t chunks = splits.size() - 1;
+  if (n == 0)
+    n = std::max(1u, std::thread::hardware_concurrency());
+  n = std::max<std::size_t>(1, std::min(n, chunks));
+
+  std::vector<T const*> result(chunks);
+  std::vector<std::vector<Diagnostic>> diags(chunks);
+  std::vector<std::exception_ptr> errs(chunks);
+  Diagnostic_mode mode = would_report() ? suppress_diags : discard_diags;
+  std::atomic<std::size_t> next(0);
+  auto work = [&](Arena_factory& f) {
+    Arena_scope scope(f);
+    for (std::size_t i; (i = next++) < chunks;) {
+      Diagnostic_context cxt(mode);
+      try {
+        Token_stream ts(Token_seq(toks.begin() + splits[i], toks.begin() + splits[i + 1]));
+        result[i] = parse(ts);
+      } catch (...) {
+        errs[i] = std::current_exception();
+      }
+      diags[i].assign(cxt.begin(), cxt.end());
+    }
+  };
+
+  // Chunks are taken in order by each thread as it becomes free,
+  // including this one.
+  for (std::size_t i = 0; i < n; ++i)
+    arenas.emplace_back();
+  std::size_t k = arenas.size() - n;
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < n; ++i)
+    threads.emplace_back(work, std::ref(arenas[k + i]));
+  work(arenas[k]);
+  for (std::thread& t : threads)
+    t.join();
+
+  merge_diagnostics(diags);
+  for (std::exception_ptr& e : errs)
+    if (e)
+      std::rethrow_exception(e);
+  return result;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                          Parallel file parsing
+
+// Parse the files at paths in parallel using n threads, and return
+// the result of each file in order. Each file is opened with the
+// file manager and parsed by calling parse with the file, which
+// lexes, parses, and checks it.
+//
+// As with parse_in_parallel, each thread allocates with a factory of
+// its own, which is added to arenas, and the diagnostics of each file
+// are collected while it is parsed. They are emitted in the order of
+// the files after all threads have finished. If parsing a file throws
+// an exception, the exception of the first such file is then
+// rethrown; parse should catch the errors from which the other files
+// can recover. The symbol tables and the file manager are shared by
+// all threads.
+//
+// If n is 0, the number of threads is the number of hardware
+// threads.
+template<typename T, typename Parse>
+std::vector<T const*>
+parse_files_in_parallel(std::vector<Path> const& paths,
+                        std::deque<Arena_factory>& arenas,
+                        Parse parse,
+                        std::size_t n = 0)
+{
+  std::size_t files = paths.size();
+  if (n == 0)
+    n = std::max(1u, std::thread::hardware_concurrency());
+  n = std::max<std::size_t>(1, std::min(n, files));
+
+  std::vector<T const*> result(files);
+  std::vector<std::vector<Diagnostic>> diags(files);
+  std::vector<std::exception_ptr> errs(files);
+  Diagnostic_mode mode = would_report() ? suppress_diags : discard_diags;
+  std::atomic<std::size_t> next(0);
+  auto work = [&](Arena_factory& f) {
+    Arena_scope scope(f);
+    for (std::size_t i; (i = next++) < files;) {
+      Diagnostic_context cxt(mode);
+      try {
+        result[i] = parse(file_manager().open(paths[i]));
+      } catch (...) {
+        errs[i] = std::current_exception();
+      }
+      diags[i].assign(cxt.begin(), cxt.end());
+    }
+  };
+
+  for (std::size_t i = 0; i < n; ++i)
+    arenas.emplace_back();
+  std::size_t k = arenas.size() - n;
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < n; ++i)
+    threads.emplace_back(work, std::ref(arenas[k + i]));
+  work(arenas[k]);
+  for (std::thread& t : threads)
+    t.join();
+
+  for (std::vector<Diagnostic> const& ds : diags)
+    for (Diagnostic const& d : ds)
+      emit_diagnostic(d);
+  for (std::exception_ptr& e : errs)
+    if (e)
+      std::rethrow_exception(e);
+  return result;
+}
+
+
+} // namespace lingo
+
+#endif
@@ -0,0 +1,164 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_PRECEDENCE_HPP
+#define LINGO_PRECEDENCE_HPP
+
+// The precedence module provides a generic parser for expressions
+// built from prefix and binary operators, driven by a table of
+// operator precedences.
+
+#include <lingo/node.hpp>
+#include <lingo/token.hpp>
+
+#include <functional>
+#include <vector>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                          Operator tables
+
+// The associativity of a binary operator.
+enum Associativity
+{
+  left_assoc,
+  right_assoc
+};
+
+
+// A precedence parser parses expressions of type T whose operators
+// are given by a table: for each token kind, its precedence, its
+// associativity, and a factory that builds the expression for the
+// operator and its operands. Higher precedences bind more tightly.
+// Primary expressions are parsed by a function given to parse().
+//
+// Parsing uses precedence climbing. A binary operator is found by
+// indexing the table with its token kind, and each operator costs
+// one iteration of a loop, so parsing an operand does not descend
+// through a function for each precedence level.
+//
+// If an operand is an error node (see make_error_node), the factory
+// is not called and the result is an error node.
+template<typename T>
+class Precedence_parser
+{
+public:
+  using Primary_fn = std::function<T const*()>;
+  using Prefix_fn  = std::function<T const*(Token, T const*)>;
+  using Binary_fn  = std::function<T const*(Token, T const*, T const*)>;
+
+  void prefix(int, int, Prefix_fn);
+  void binary(int, int, Associativity, Binary_fn);
+
+  T const* parse(Token_stream&, Primary_fn const&, int = 0) const;
+
+private:
+  struct Prefix
+  {
+    int       prec;
+    Prefix_fn make;
+  };
+
+  struct Binary
+  {
+    int           prec;
+    Associativity assoc;
+    Binary_fn     make;
+  };
+
+  template<typename Op>
+  static Op const* find(std::vector<Op> const&, int);
+
+  template<typename Op>
+  static Op& entry(std::vector<Op>&, int);
+
+  std::vector<Prefix> prefix_; // Prefix operators by token kind
+  std::vector<Binary> binary_; // Binary operators by token kind
+};
+
+
+// Returns the operator for the token kind k in the table ops, or
+// nullptr if there is none.
+template<typename T>
+template<typename Op>
+inline Op const*
+Precedence_parser<T>::find(std::vector<Op> const& ops, int k)
+{
+  if (k < 0 || std::size_t(k) >= ops.size() || !ops[k].make)
+    return nullptr;
+  return &ops[k];
+}
+
+
+// Returns the entry for the token kind k in the table ops, extending
+// the table as needed.
+template<typename T>
+template<typename Op>
+Op&
+Precedence_parser<T>::entry(std::vector<Op>& ops, int k)
+{
+  lingo_assert(k >= 0);
+  if (std::size_t(k) >= ops.size())
+    ops.resize(k + 1);
+  return ops[k];
+}
+
+
+// Add a prefix operator for the token kind k whose operand is
+// parsed at precedence p.
+template<typename T>
+void
+Precedence_parser<T>::prefix(int k, int p, Prefix_fn f)
+{
+  entry(prefix_, k) = {p, std::move(f)};
+}
+
+
+// Add a binary operator for the token kind k with precedence p
+// and associativity a.
+template<typename T>
+void
+Precedence_parser<T>::binary(int k, int p, Associativity a, Binary_fn f)
+{
+  entry(binary_, k) = {p, a, std::move(f)};
+}
+
+
+// Parse an expression whose binary operators have at least the
+// precedence min.
+template<typename T>
+T const*
+Precedence_parser<T>::parse(Token_stream& ts, Primary_fn const& primary, int min) const
+{
+  T const* e;
+  Token tok = ts.peek();
+  if (Prefix const* op = find(prefix_, tok.kind())) {
+    ts.get();
+    T const* arg = parse(ts, primary, op->prec);
+    e = is_error_node(arg) ? arg : op->make(tok, arg);
+  } else {
+    e = primary();
+  }
+
+  while (true) {
+    Token tok = ts.peek();
+    Binary const* op = find(binary_, tok.kind());
+    if (!op || op->prec < min)
+      break;
+    ts.get();
+    int p = op->assoc == left_assoc ? op->prec + 1 : op->prec;
+    T const* rhs = parse(ts, primary, p);
+    if (is_error_node(e) || is_error_node(rhs))
+      e = make_error_node<T>();
+    else
+      e = op->make(tok, e, rhs);
+  }
+  return e;
+}
+
+
+} // namespace lingo
+
+#endif
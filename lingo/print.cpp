@@ -5,6 +5,7 @@
 
 #include "lingo/print.hpp"
 
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 
@@ -12,39 +13,15 @@ namespace lingo
 {
 
 
-namespace
-{
-
-
-// Manage the last character printed to the
-// output stream.
-struct Last_char_guard
+// Write the pending text to the stream.
+void
+Print_buffer::flush()
 {
-  Last_char_guard(Printer& p, char c)
-    : printer(p), last(c)
-  { }
-
-
-  Last_char_guard(Printer& p, char const* str)
-    : printer(p), last(str[std::strlen(str) - 1])
-  { }
-
-
-  Last_char_guard(Printer& p, std::string const& str)
-    : printer(p), last(str[str.size() - 1])
-  { }
-
-  ~Last_char_guard()
-  {
-    printer.last = last;
+  if (os_ && !text_.empty()) {
+    os_->write(text_.data(), text_.size());
+    text_.clear();
   }
-
-  Printer& printer;
-  char     last;
-};
-
-
-} // namespace
+}
 
 
 Printer::~Printer()
@@ -59,52 +36,54 @@ Printer::~Printer()
 void
 print_chars(Printer& p, char c)
 {
-  Last_char_guard _(p, c);
-  p.os << c;
+  p.out.put(c);
+  p.last = c;
 }
 
 
 void
 print_chars(Printer& p, char const* s)
 {
-  Last_char_guard _(p, s);
-  p.os << s;
+  print_chars(p, s, s + std::strlen(s));
 }
 
 
+// Write the characters in [first, last) as a single range.
 void
 print_chars(Printer& p, char const* first, char const* last)
 {
   if (first == last)
     return;
-  Last_char_guard _(p, *(last -1));
-  while (first != last) {
-    print_chars(p, *first);
-    ++first;
-  }
+  p.out.write(first, last);
+  p.last = *(last - 1);
 }
 
 
 void
 print_chars(Printer& p, std::string const& s)
 {
-  Last_char_guard _(p, s);
-  p.os << s;
+  print_chars(p, s.data(), s.data() + s.size());
 }
 
 
 void
 print_value(Printer& p, std::intmax_t n)
 {
-  p.os << n;
+  char buf[32];
+  int k = std::snprintf(buf, sizeof(buf), "%jd", n);
+  p.out.write(buf, buf + k);
   p.last = '0'; // An artificial non-ws character
 }
 
 
+// Doubles are printed as they are by an output stream, with the
+// default precision of 6 digits.
 void
 print_value(Printer& p, double n)
 {
-  p.os << n;
+  char buf[32];
+  int k = std::snprintf(buf, sizeof(buf), "%g", n);
+  p.out.write(buf, buf + k);
   p.last = '0'; // An artificial non-ws character
 }
 
@@ -112,8 +91,8 @@ print_value(Printer& p, double n)
 void
 print_space(Printer& p)
 {
-  Last_char_guard _(p, ' ');
-  p.os << ' ';
+  p.out.put(' ');
+  p.last = ' ';
 }
 
 
@@ -121,7 +100,7 @@ print_space(Printer& p)
 void
 print_newline(Printer& p)
 {
-  p.os << '\n';
+  p.out.put('\n');
   if (p.depth)
     print_indent(p);
   else
@@ -133,8 +112,7 @@ print_newline(Printer& p)
 void
 print_indent(Printer& p)
 {
-  for (int n = 0; n < 2 * p.depth; ++n)
-    print_space(p);
+  p.out.put(2 * p.depth, ' ');
   p.last = ' ';
 }
 
@@ -147,4 +125,58 @@ default_print_stream()
 }
 
 
+// Returns the buffer into which to_string prints. Each thread has
+// its own buffer.
+Print_buffer&
+string_print_buffer()
+{
+  static thread_local Print_buffer buf;
+  return buf;
+}
+
+
+namespace
+{
+
+// The string stream of the current thread.
+std::stringstream&
+string_stream()
+{
+  static thread_local std::stringstream ss;
+  return ss;
+}
+
+
+thread_local bool string_stream_used_ = false;
+
+
+} // namespace
+
+
+String_stream::String_stream()
+{
+  if (string_stream_used_) {
+    own_.reset(new std::stringstream);
+    ss_ = own_.get();
+    return;
+  }
+  string_stream_used_ = true;
+  ss_ = &string_stream();
+}
+
+
+// Reset the shared stream for its next use: its text, its state,
+// and its formatting flags.
+String_stream::~String_stream()
+{
+  if (own_)
+    return;
+  static std::stringstream const plain;
+  ss_->str(String());
+  ss_->clear();
+  ss_->copyfmt(plain);
+  string_stream_used_ = false;
+}
+
+
 } // namespace lingo
@@ -33,27 +33,85 @@
 #include <lingo/string.hpp>
 
 #include <cstdint>
+#include <memory>
+#include <sstream>
 
 namespace lingo
 {
 
+// A print buffer collects the text written by printers. Text is
+// appended in ranges, and written to the underlying stream, if any,
+// in blocks of block_size characters. Any remaining text is written
+// when the buffer is flushed or destroyed. A buffer without a stream
+// only accumulates text.
+class Print_buffer
+{
+public:
+  static constexpr std::size_t block_size = 1 << 14;
+
+  Print_buffer()
+    : os_(nullptr)
+  { }
+
+  explicit Print_buffer(std::ostream& os)
+    : os_(&os)
+  { }
+
+  Print_buffer(Print_buffer const&) = delete;
+  Print_buffer& operator=(Print_buffer const&) = delete;
+
+  ~Print_buffer() { flush(); }
+
+  void put(char c)                          { text_ += c; spill(); }
+  void put(std::size_t n, char c)           { text_.append(n, c); spill(); }
+  void write(char const* f, char const* l)  { text_.append(f, l); spill(); }
+
+  // Returns the text that has not been written to the stream.
+  String const& str() const { return text_; }
+  std::size_t   size() const { return text_.size(); }
+
+  // Discard the text after the first n characters.
+  void truncate(std::size_t n) { text_.resize(n); }
+
+  void flush();
+
+private:
+  void spill()
+  {
+    if (os_ && text_.size() >= block_size)
+      flush();
+  }
+
+  std::ostream* os_;
+  String        text_;
+};
+
+
 // The printer class maintains information needed to format
-// the output of pretty printing functions.
+// the output of pretty printing functions. Text is written to
+// a print buffer, which is shared by copies of the printer. A
+// printer constructed over a stream has a buffer of its own,
+// which is flushed to that stream when the printer is destroyed.
 struct Printer
 {
   Printer(std::ostream& s)
-    : os(s), depth(0), needs_space(false), needs_newline(false)
+    : buf(s), out(buf), last(0), depth(0), needs_space(false), needs_newline(false)
+  { }
+
+  Printer(Print_buffer& b)
+    : out(b), last(0), depth(0), needs_space(false), needs_newline(false)
   { }
 
-  // Copy the output stream and indent depth, not the
+  // Copy the output buffer and indent depth, not the
   // formatting flags.
   Printer(Printer const& p)
-    : os(p.os), depth(p.depth), needs_space(false), needs_newline(false)
+    : out(p.out), last(0), depth(p.depth), needs_space(false), needs_newline(false)
   { }
 
   ~Printer();
 
-  std::ostream& os;   // The underlying output stream
+  Print_buffer  buf;  // The buffer of a printer over a stream
+  Print_buffer& out;  // The buffer written to
   char last;          // Last character written
   int depth;          // Indentation depth
   bool needs_space;   // Set to true to offset a printed term by space
@@ -80,6 +138,29 @@ undent(Printer& p)
 
 
 std::ostream& default_print_stream();
+Print_buffer& string_print_buffer();
+
+
+// Provides a string stream for to_string. Each thread reuses a
+// single stream, so that it is not created (and its buffer is not
+// allocated) for each string. A nested use on the same thread gets
+// a new stream.
+class String_stream
+{
+public:
+  String_stream();
+  ~String_stream();
+
+  String_stream(String_stream const&) = delete;
+  String_stream& operator=(String_stream const&) = delete;
+
+  std::ostream& stream() { return *ss_; }
+  String        str() const { return ss_->str(); }
+
+private:
+  std::stringstream*                 ss_;
+  std::unique_ptr<std::stringstream> own_;
+};
 
 
 // Core printing functions
@@ -145,6 +226,14 @@ print(Printer& p, String_view s)
 }
 
 
+// Print the interned string `s`.
+inline void
+print(Printer& p, Interned_string s)
+{
+  print_chars(p, s.begin(), s.end());
+}
+
+
 // Print the integral value `n`.
 template<typename T>
 inline typename std::enable_if<std::is_integral<T>::value, void>::type
@@ -177,14 +266,22 @@ print(Printer& p, double n)
 // resulting text.
 //
 // Requires that `print(p, x)` is well-formed.
+//
+// The text is printed into a buffer that is reused by each call on
+// the current thread.
 template<typename T, typename P>
 inline String
 to_string(T const& x, P print)
 {
-  std::stringstream ss;
-  Printer p(ss);
-  print(p, x);
-  return ss.str();
+  Print_buffer& buf = string_print_buffer();
+  std::size_t n = buf.size();
+  {
+    Printer p(buf);
+    print(p, x);
+  }
+  String s(buf.str(), n);
+  buf.truncate(n);
+  return s;
 }
 
 
@@ -196,8 +293,8 @@ template<typename T>
 inline String
 to_string(T const& x)
 {
-  std::stringstream ss;
-  ss << x;
+  String_stream ss;
+  ss.stream() << x;
   return ss.str();
 }
 
@@ -0,0 +1,316 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "profile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace lingo
+{
+
+namespace
+{
+
+using profile_impl::Tick;
+using profile_impl::Node;
+using profile_impl::Thread;
+
+using Clock = std::chrono::steady_clock;
+
+
+// The sites and thread profiles of the program. The time at which
+// the registry is created calibrates the tick counter.
+struct Registry
+{
+  Registry()
+    : start(Clock::now()), ticks(profile_impl::now())
+  { }
+
+  std::mutex                           mutex;
+  std::vector<char const*>             sites;
+  std::deque<std::unique_ptr<Thread>> threads;
+  Clock::time_point                    start;
+  Tick                                 ticks;
+};
+
+
+Registry&
+registry()
+{
+  static Registry r;
+  return r;
+}
+
+
+// Returns the number of seconds per tick. Ticks are measured
+// against the steady clock for at least 10ms.
+double
+seconds_per_tick()
+{
+  Registry& r = registry();
+  Clock::time_point t;
+  do
+    t = Clock::now();
+  while (t - r.start < std::chrono::milliseconds(10));
+  Tick n = profile_impl::now() - r.ticks;
+  return n ? std::chrono::duration<double>(t - r.start).count() / n : 1e-9;
+}
+
+
+// The merged trees of all threads.
+struct Merged_node
+{
+  int                      site;
+  std::uint64_t            calls;
+  Tick                     ticks;
+  std::vector<Merged_node> children;
+};
+
+
+void
+merge(Merged_node& m, Thread const& t, int n)
+{
+  Node const& x = t.nodes[n];
+  m.calls += x.calls;
+  m.ticks += x.ticks;
+  for (int c = x.first; c >= 0; c = t.nodes[c].next) {
+    int s = t.nodes[c].site;
+    Merged_node* y = nullptr;
+    for (Merged_node& z : m.children)
+      if (z.site == s)
+        y = &z;
+    if (!y) {
+      m.children.push_back({s, 0, 0, {}});
+      y = &m.children.back();
+    }
+    merge(*y, t, c);
+  }
+}
+
+
+void
+report(std::ostream& os, Merged_node const& m, int depth, double spt, double total)
+{
+  std::vector<char const*> const& sites = registry().sites;
+  for (Merged_node const& c : m.children) {
+    Tick self = c.ticks;
+    for (Merged_node const& d : c.children)
+      self -= std::min(self, d.ticks);
+    double t = c.ticks * spt;
+    std::string name(2 * depth, ' ');
+    name += sites[c.site];
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-40s %12llu %12.3f %12.3f %6.1f%%\n",
+                  name.c_str(), (unsigned long long)c.calls,
+                  t * 1e3, self * spt * 1e3, total > 0 ? 100 * t / total : 0.0);
+    os << line;
+    report(os, c, depth + 1, spt, total);
+  }
+}
+
+
+// Write s as a JSON string.
+void
+write_json(std::ostream& os, char const* s)
+{
+  os << '"';
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\')
+      os << '\\';
+    os << *s;
+  }
+  os << '"';
+}
+
+} // namespace
+
+
+namespace profile_impl
+{
+
+thread_local Thread* self;
+bool                 tracing;
+
+
+Thread::Thread(int n)
+  : tid(n), current(0)
+{
+  nodes.push_back({-1, -1, -1, -1, 0, 0});
+}
+
+
+// Create the profile of the current thread.
+Thread&
+attach()
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.threads.emplace_back(new Thread(r.threads.size() + 1));
+  self = r.threads.back().get();
+  return *self;
+}
+
+} // namespace profile_impl
+
+
+Profile_site::Profile_site(char const* s)
+  : name(s)
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  id = r.sites.size();
+  r.sites.push_back(s);
+}
+
+
+// When tracing, each region is recorded when it is left. This
+// should be set before profiled threads are started.
+void
+set_profile_tracing(bool b)
+{
+  profile_impl::tracing = b;
+}
+
+
+// Discard the times, counts, and traces of all threads. This must
+// not be called within a profiled region.
+void
+reset_profile()
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (auto& t : r.threads) {
+    t->nodes.resize(1);
+    t->nodes[0].first = -1;
+    t->current = 0;
+    t->counts.clear();
+    t->events.clear();
+  }
+}
+
+
+// Write the merged times of all regions, indented by nesting, and
+// the totals of all counters. Times are in milliseconds. The self
+// time of a region excludes that of the regions entered from it.
+void
+report_profile(std::ostream& os)
+{
+  double spt = seconds_per_tick();
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  Merged_node root {-1, 0, 0, {}};
+  std::vector<std::uint64_t> counts(r.sites.size());
+  for (auto const& t : r.threads) {
+    merge(root, *t, 0);
+    for (std::size_t i = 0; i < t->counts.size(); ++i)
+      counts[i] += t->counts[i];
+  }
+  double total = 0;
+  for (Merged_node const& c : root.children)
+    total += c.ticks * spt;
+  if (root.children.empty() && std::count(counts.begin(), counts.end(), 0) == (long)counts.size()) {
+    os << "no profile (configure with -DLINGO_PROFILE=ON)\n";
+    return;
+  }
+
+  char line[256];
+  std::snprintf(line, sizeof(line), "%-40s %12s %12s %12s %7s\n",
+                "region", "calls", "total (ms)", "self (ms)", "%");
+  os << line;
+  report(os, root, 0, spt, total);
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    if (!counts[i])
+      continue;
+    std::snprintf(line, sizeof(line), "%-40s %12llu\n",
+                  r.sites[i], (unsigned long long)counts[i]);
+    os << line;
+  }
+}
+
+
+// Write the recorded regions of all threads, and the totals of all
+// counters, in the Chrome trace event format. Times are in
+// microseconds from the start of profiling.
+void
+report_profile_trace(std::ostream& os)
+{
+  double us = seconds_per_tick() * 1e6;
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  os << "{\"traceEvents\":[";
+  char const* sep = "\n";
+  Tick last = r.ticks;
+  for (auto const& t : r.threads) {
+    for (profile_impl::Event const& e : t->events) {
+      char args[128];
+      std::snprintf(args, sizeof(args), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                    (e.start - r.ticks) * us, (e.end - e.start) * us, t->tid);
+      os << sep << "{\"name\":";
+      write_json(os, r.sites[e.site]);
+      os << args;
+      sep = ",\n";
+      last = std::max(last, e.end);
+    }
+  }
+  std::vector<std::uint64_t> counts(r.sites.size());
+  for (auto const& t : r.threads)
+    for (std::size_t i = 0; i < t->counts.size(); ++i)
+      counts[i] += t->counts[i];
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    if (!counts[i])
+      continue;
+    char args[128];
+    std::snprintf(args, sizeof(args), ",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"value\":%llu}}",
+                  (last - r.ticks) * us, (unsigned long long)counts[i]);
+    os << sep << "{\"name\":";
+    write_json(os, r.sites[i]);
+    os << args;
+    sep = ",\n";
+  }
+  os << "\n]}\n";
+}
+
+
+// Parse a command-line option. Returns false if the option is not
+// --profile or --trace=file.
+bool
+Profile_options::parse(char const* opt)
+{
+  if (std::strcmp(opt, "--profile") == 0) {
+    report = true;
+    return true;
+  }
+  if (std::strncmp(opt, "--trace=", 8) == 0 && opt[8]) {
+    trace = opt + 8;
+    set_profile_tracing(true);
+    return true;
+  }
+  return false;
+}
+
+
+Profile_options::~Profile_options()
+{
+  if (report)
+    report_profile(std::cerr);
+  if (!trace.empty()) {
+    std::ofstream f(trace);
+    report_profile_trace(f);
+  }
+}
+
+
+} // namespace lingo
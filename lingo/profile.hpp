@@ -0,0 +1,266 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_PROFILE_HPP
+#define LINGO_PROFILE_HPP
+
+// The profile module measures the time spent in regions of code, and
+// counts events, in each thread. Regions and counters are declared
+// with the lingo_profile and lingo_count macros:
+//
+//    void lex()
+//    {
+//      lingo_profile("lex");
+//      ...
+//      lingo_count("tokens", 1);
+//    }
+//
+// The macros expand to nothing unless LINGO_PROFILE is defined to 1,
+// which is done by configuring the build with -DLINGO_PROFILE=ON.
+// When enabled, a region costs two reads of the time stamp counter
+// and a short search of the regions entered from the enclosing one.
+//
+// The times of regions are accumulated in a tree of the regions
+// entered from each region, so that the same region reached along
+// different paths is timed separately. Direct recursion is collapsed
+// into the outermost call. The trees and counters of all threads are
+// merged when they are reported, either as an indented tree, or as a
+// trace in the Chrome trace event format.
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#else
+#  include <chrono>
+#endif
+
+#ifndef LINGO_PROFILE
+#  define LINGO_PROFILE 0
+#endif
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                                 Sites
+
+// A profile site names a region of code or a counter. Sites are
+// static objects, and each has a unique index.
+struct Profile_site
+{
+  explicit Profile_site(char const*);
+
+  char const* name;
+  int         id;
+};
+
+
+// -------------------------------------------------------------------------- //
+//                                Threads
+
+namespace profile_impl
+{
+
+using Tick = std::uint64_t;
+
+
+// Returns the current time in ticks, which are cycles of the time
+// stamp counter, if there is one, or else nanoseconds.
+inline Tick
+now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+// A region entered from its parent region. The children of a node
+// are linked through their next indexes. Node 0 is the root.
+struct Node
+{
+  int           site;
+  int           parent;
+  int           first;
+  int           next;
+  std::uint64_t calls;
+  Tick          ticks;
+};
+
+
+// A region of a trace, recorded when it is left.
+struct Event
+{
+  int  site;
+  Tick start;
+  Tick end;
+};
+
+
+// The profile of a thread. Profiles outlive their threads, so that
+// the work of each thread is reported.
+struct Thread
+{
+  Thread(int);
+
+  int  enter(int);
+  void leave(int, Tick, Tick);
+  void count(int, std::uint64_t);
+
+  int                        tid;
+  int                        current;
+  std::vector<Node>          nodes;
+  std::vector<std::uint64_t> counts;
+  std::vector<Event>         events;
+};
+
+
+extern thread_local Thread* self;
+extern bool                 tracing;
+
+Thread& attach();
+
+
+inline Thread&
+thread()
+{
+  return self ? *self : attach();
+}
+
+
+// Enter the region s from the current region, and return its node,
+// or -1 if s is the current region.
+inline int
+Thread::enter(int s)
+{
+  if (nodes[current].site == s)
+    return -1;
+  int n = nodes[current].first;
+  while (n >= 0 && nodes[n].site != s)
+    n = nodes[n].next;
+  if (n < 0) {
+    n = nodes.size();
+    nodes.push_back({s, current, -1, nodes[current].first, 0, 0});
+    nodes[current].first = n;
+  }
+  current = n;
+  return n;
+}
+
+
+inline void
+Thread::leave(int n, Tick start, Tick end)
+{
+  if (n < 0)
+    return;
+  Node& x = nodes[n];
+  ++x.calls;
+  x.ticks += end - start;
+  current = x.parent;
+  if (tracing)
+    events.push_back({x.site, start, end});
+}
+
+
+inline void
+Thread::count(int s, std::uint64_t n)
+{
+  if (s >= (int)counts.size())
+    counts.resize(s + 1);
+  counts[s] += n;
+}
+
+} // namespace profile_impl
+
+
+// -------------------------------------------------------------------------- //
+//                           Regions and counters
+
+// Times a region of code for its lifetime.
+class Profile_scope
+{
+public:
+  explicit Profile_scope(Profile_site const& s)
+    : t_(profile_impl::thread()), n_(t_.enter(s.id)), start_(profile_impl::now())
+  { }
+
+  ~Profile_scope() { t_.leave(n_, start_, profile_impl::now()); }
+
+  Profile_scope(Profile_scope const&) = delete;
+  Profile_scope& operator=(Profile_scope const&) = delete;
+
+private:
+  profile_impl::Thread& t_;
+  int                   n_;
+  profile_impl::Tick    start_;
+};
+
+
+// Add n to the counter s of the current thread.
+inline void
+profile_count(Profile_site const& s, std::uint64_t n = 1)
+{
+  profile_impl::thread().count(s.id, n);
+}
+
+
+#define lingo_profile_cat_(a, b) a##b
+#define lingo_profile_cat(a, b) lingo_profile_cat_(a, b)
+
+#if LINGO_PROFILE
+#  define lingo_profile(name) \
+     static ::lingo::Profile_site lingo_profile_cat(lingo_site_, __LINE__)(name); \
+     ::lingo::Profile_scope lingo_profile_cat(lingo_scope_, __LINE__)(lingo_profile_cat(lingo_site_, __LINE__))
+#  define lingo_count(name, n) \
+     do { \
+       static ::lingo::Profile_site lingo_site_(name); \
+       ::lingo::profile_count(lingo_site_, n); \
+     } while (0)
+#else
+#  define lingo_profile(name) ((void)0)
+#  define lingo_count(name, n) ((void)0)
+#endif
+
+
+// -------------------------------------------------------------------------- //
+//                                Reports
+
+// Reports must be made, and profiles reset, only while no other
+// thread is in a profiled region.
+
+void set_profile_tracing(bool);
+void reset_profile();
+
+void report_profile(std::ostream&);
+void report_profile_trace(std::ostream&);
+
+
+// The reports requested on the command line, which are written
+// when the options are destroyed. With --profile, the profile is
+// written to stderr. With --trace=file, regions are traced, and the
+// trace is written to the file.
+struct Profile_options
+{
+  Profile_options()
+    : report(false)
+  { }
+
+  ~Profile_options();
+
+  bool parse(char const*);
+
+  bool        report;
+  std::string trace;
+};
+
+
+} // namespace lingo
+
+#endif
@@ -6,17 +6,22 @@
 #include "lingo/real.hpp"
 #include "lingo/debug.hpp"
 
+#include <llvm/ADT/SmallString.h>
+
 #include <memory>
 
 namespace lingo
 {
 
 
-// Streaming
+// Streaming. Values are printed by APFloat, whether or not they are
+// doubles, so that both print the same way.
 std::ostream&
 operator<<(std::ostream& os, Real const& n)
 {
-  return os;
+  llvm::SmallString<32> s;
+  n.impl().toString(s);
+  return os << s.str().str();
 }
 
 
@@ -9,6 +9,8 @@
 
 #include <llvm/ADT/APFloat.h>
 
+#include <memory>
+
 namespace lingo
 {
 
@@ -16,6 +18,11 @@ namespace lingo
 // this represents an IEEE double precision value, but other models
 // are also supported.
 //
+// IEEE double precision values are stored and computed as a native
+// double, which gives the same results as APFloat (with the default
+// rounding mode) at hardware speed. Only values of other semantics
+// are represented by an APFloat.
+//
 // TODO: This class needs some TLC.
 class Real
 {
@@ -23,12 +30,12 @@ public:
   Real();
 
   // Copy semantics
-  Real(Real const&);
-  Real& operator=(Real const&);
+  Real(Real const&) = default;
+  Real& operator=(Real const&) = default;
 
   // Move semantics
-  Real(Real&&);
-  Real& operator=(Real&&);
+  Real(Real&&) = default;
+  Real& operator=(Real&&) = default;
 
   Real(llvm::APFloat const&);
   Real& operator=(llvm::APFloat const&);
@@ -43,11 +50,17 @@ public:
   // supported floating point semantics.
   explicit Real(double);
 
+  // Returns true if the value is an IEEE double.
+  bool is_double() const { return !f; }
 
-  llvm::APFloat const& impl() const;
+  double        getd() const;
+  llvm::APFloat impl() const;
 
 private:
-  llvm::APFloat f;
+  void set(llvm::APFloat const&);
+
+  double                               d; // The value, if a double
+  std::shared_ptr<llvm::APFloat const> f; // The value, otherwise
 };
 
 
@@ -55,66 +68,38 @@ private:
 // value to 0.0.
 inline
 Real::Real()
-  : f(0.0)
+  : d(0.0)
 { }
 
 
-// Copy initialize this object with x.
 inline
-Real::Real(Real const& x)
-  : f(x.f)
-{ }
-
-
-// Copy assign this object to the value of x.
-inline Real&
-Real::operator=(Real const& x)
-{
-  f = x.f;
-  return *this;
-}
-
-
-inline
-Real::Real(Real&& x)
-  : f(std::move(x.f))
-{ }
-
-
-inline Real&
-Real::operator=(Real&& x)
+Real::Real(llvm::APFloat const& n)
 {
-  f = std::move(x.f);
-  return *this;
+  set(n);
 }
 
 
-inline
-Real::Real(llvm::APFloat const& n)
-  : f(n)
-{ }
-
-
 inline
 Real&
 Real::operator=(llvm::APFloat const& n)
 {
-  f = n;
+  set(n);
   return *this;
 }
 
 
 inline
 Real::Real(llvm::APFloat&& n)
-  : f(std::move(n))
-{ }
+{
+  set(n);
+}
 
 
 inline
 Real&
 Real::operator=(llvm::APFloat&& n)
 {
-  f = std::move(n);
+  set(n);
   return *this;
 }
 
@@ -122,15 +107,37 @@ Real::operator=(llvm::APFloat&& n)
 // Initialize a floating point value with the (signed) value.
 inline
 Real::Real(double n)
-  : f(n)
+  : d(n)
 { }
 
 
-// Returns a reference to the underlying data.
-inline llvm::APFloat const&
+// Doubles are stored natively.
+inline void
+Real::set(llvm::APFloat const& n)
+{
+  if (&n.getSemantics() == &llvm::APFloat::IEEEdouble) {
+    d = n.convertToDouble();
+    f = nullptr;
+  } else {
+    f = std::make_shared<llvm::APFloat const>(n);
+  }
+}
+
+
+// Returns the value of an IEEE double.
+inline double
+Real::getd() const
+{
+  lingo_assert(is_double());
+  return d;
+}
+
+
+// Returns the value as an APFloat.
+inline llvm::APFloat
 Real::impl() const
 {
-  return f;
+  return f ? *f : llvm::APFloat(d);
 }
 
 
@@ -139,6 +146,8 @@ Real::impl() const
 inline bool
 operator==(Real const& a, Real const& b)
 {
+  if (a.is_double() && b.is_double())
+    return a.getd() == b.getd();
   return a.impl().compare(b.impl()) == llvm::APFloat::cmpEqual;
 }
 
@@ -154,6 +163,8 @@ operator!=(Real const& a, Real const& b)
 inline bool
 operator<(Real const& a, Real const& b)
 {
+  if (a.is_double() && b.is_double())
+    return a.getd() < b.getd();
   return a.impl().compare(b.impl()) == llvm::APFloat::cmpLessThan;
 }
 
@@ -161,6 +172,8 @@ operator<(Real const& a, Real const& b)
 inline bool
 operator>(Real const& a, Real const& b)
 {
+  if (a.is_double() && b.is_double())
+    return a.getd() > b.getd();
   return a.impl().compare(b.impl()) == llvm::APFloat::cmpGreaterThan;
 }
 
@@ -183,6 +196,8 @@ operator>=(Real const& a, Real const& b)
 inline Real
 operator+(Real const& a, Real const& b)
 {
+  if (a.is_double() && b.is_double())
+    return Real(a.getd() + b.getd());
   return a.impl() + b.impl();
 }
 
@@ -190,6 +205,8 @@ operator+(Real const& a, Real const& b)
 inline Real
 operator-(Real const& a, Real const& b)
 {
+  if (a.is_double() && b.is_double())
+    return Real(a.getd() - b.getd());
   return a.impl() - b.impl();
 }
 
@@ -197,6 +214,8 @@ operator-(Real const& a, Real const& b)
 inline Real
 operator*(Real const& a, Real const& b)
 {
+  if (a.is_double() && b.is_double())
+    return Real(a.getd() * b.getd());
   return a.impl() * b.impl();
 }
 
@@ -204,6 +223,8 @@ operator*(Real const& a, Real const& b)
 inline Real
 operator/(Real const& a, Real const& b)
 {
+  if (a.is_double() && b.is_double())
+    return Real(a.getd() / b.getd());
   return a.impl() / b.impl();
 }
 
@@ -214,7 +235,7 @@ inline Real
 operator-(Real const& x)
 {
   Real zero;
-  return zero - x.impl();
+  return zero - x;
 }
 
 
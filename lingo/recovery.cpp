@@ -0,0 +1,95 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/recovery.hpp"
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                              Token sets
+
+Token_set::Token_set(std::initializer_list<int> ks)
+{
+  for (int k : ks)
+    insert(k);
+}
+
+
+void
+Token_set::insert(int k)
+{
+  lingo_assert(k >= 0);
+  std::size_t n = k >> 6;
+  if (n >= bits_.size())
+    bits_.resize(n + 1);
+  bits_[n] |= std::uint64_t(1) << (k & 63);
+}
+
+
+Token_set&
+Token_set::operator|=(Token_set const& s)
+{
+  if (bits_.size() < s.bits_.size())
+    bits_.resize(s.bits_.size());
+  for (std::size_t i = 0; i < s.bits_.size(); ++i)
+    bits_[i] |= s.bits_[i];
+  return *this;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                            Parse recovery
+
+// If the current token has kind k, return it and advance the
+// stream. Otherwise, report that the token spelled s was expected,
+// and skip to a token of kind k or one in the follow set. If that
+// token has kind k, it is matched. Otherwise, this returns an
+// invalid token.
+Token
+Parse_recovery::expect(int k, char const* s, Token_set const& follow)
+{
+  if (ts_.peek().kind() != k) {
+    Token tok = ts_.peek();
+    diagnose("expected '{}' but got '{}'", s, tok ? tok.spelling() : "end-of-input");
+    Token_set stop = follow;
+    stop.insert(k);
+    synchronize(stop);
+    if (ts_.peek().kind() != k)
+      return Token();
+  }
+  recovering_ = false;
+  return ts_.get();
+}
+
+
+// Skip tokens until the current token is in the follow set or the
+// stream is at the end. Returns the number of tokens skipped.
+std::size_t
+Parse_recovery::synchronize(Token_set const& follow)
+{
+  std::size_t n = 0;
+  while (!ts_.eof() && !follow.contains(ts_.peek().kind())) {
+    ts_.get();
+    ++n;
+  }
+  return n;
+}
+
+
+// Report a syntax error at the current token, unless the parser
+// is already recovering from an error.
+void
+Parse_recovery::diagnose(String const& msg)
+{
+  if (!recovering_) {
+    error(ts_.location(), msg);
+    ++errs_;
+  }
+  recovering_ = true;
+}
+
+
+} // namespace lingo
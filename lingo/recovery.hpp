@@ -0,0 +1,138 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_RECOVERY_HPP
+#define LINGO_RECOVERY_HPP
+
+// The recovery module supports parsers that recover from syntax
+// errors without exceptions. A production that fails reports an
+// error, skips to a token that can follow it, and returns an error
+// node (see make_error_node). Its callers test the result with
+// is_error_node, or through the Required, Optional, and Nonempty
+// wrappers, and continue parsing. A single parse can therefore
+// diagnose many syntax errors.
+
+#include <lingo/error.hpp>
+#include <lingo/node.hpp>
+#include <lingo/token.hpp>
+
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                              Token sets
+
+// A set of token kinds. Follow sets are token sets. Token kinds
+// must be non-negative.
+class Token_set
+{
+public:
+  Token_set() = default;
+  Token_set(std::initializer_list<int>);
+
+  bool contains(int) const;
+  void insert(int);
+
+  Token_set& operator|=(Token_set const&);
+
+private:
+  std::vector<std::uint64_t> bits_;
+};
+
+
+// Returns true if the set contains the kind k. The set does not
+// contain invalid_tok.
+inline bool
+Token_set::contains(int k) const
+{
+  std::size_t n = k >> 6;
+  return k >= 0 && n < bits_.size() && (bits_[n] >> (k & 63) & 1);
+}
+
+
+// Returns the union of the sets a and b.
+inline Token_set
+operator|(Token_set a, Token_set const& b)
+{
+  return a |= b;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                            Parse recovery
+
+// The recovery state of a parser over a token stream. When a
+// production fails, recovery reports the error and skips tokens
+// until the current token is in the follow set given by the
+// production, which is expected to include the follow sets of
+// its callers.
+//
+// After an error, recovery suppresses further diagnostics until a
+// token is matched again by expect(). This avoids the cascade of
+// errors caused by the same mistake.
+class Parse_recovery
+{
+public:
+  Parse_recovery(Token_stream& ts)
+    : ts_(ts), recovering_(false), errs_(0)
+  { }
+
+  // Returns the number of syntax errors found.
+  int errors() const { return errs_; }
+
+  // Returns true if diagnostics are being suppressed.
+  bool recovering() const { return recovering_; }
+
+  Token expect(int, char const*, Token_set const&);
+
+  template<typename T>
+  T* fail(String const&, Token_set const&);
+
+  std::size_t synchronize(Token_set const&);
+  void        diagnose(String const&);
+
+  template<typename... Args>
+  void diagnose(char const*, Args&&...);
+
+private:
+  Token_stream& ts_;
+  bool          recovering_;
+  int           errs_;
+};
+
+
+// Report the error formatted from msg and args, unless the parser
+// is already recovering from an error. The message is not formatted
+// when it is not reported.
+template<typename... Args>
+inline void
+Parse_recovery::diagnose(char const* msg, Args&&... args)
+{
+  if (!recovering_) {
+    error(ts_.location(), msg, std::forward<Args>(args)...);
+    ++errs_;
+  }
+  recovering_ = true;
+}
+
+
+// Report the error msg, skip to a token in the follow set, and
+// return an error node of type T.
+template<typename T>
+inline T*
+Parse_recovery::fail(String const& msg, Token_set const& follow)
+{
+  diagnose(msg);
+  synchronize(follow);
+  return make_error_node<T>();
+}
+
+
+} // namespace lingo
+
+#endif
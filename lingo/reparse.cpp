@@ -0,0 +1,106 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/reparse.hpp"
+
+namespace lingo
+{
+
+constexpr std::size_t Syntax_map::npos;
+
+
+// Open an extent for the node of the production p, starting at
+// the token n. Returns the index of the extent.
+std::size_t
+Syntax_map::open(int p, std::size_t n)
+{
+  std::size_t parent = open_.empty() ? npos : open_.back();
+  open_.push_back(exts_.size());
+  exts_.push_back({nullptr, p, n, n, parent, 0});
+  return exts_.size() - 1;
+}
+
+
+// Close the extent i, which spans the node p, ending before the
+// token n. Extents are closed in the reverse order in which they
+// were opened.
+void
+Syntax_map::close(std::size_t i, void const* p, std::size_t n)
+{
+  lingo_assert(!open_.empty() && open_.back() == i);
+  open_.pop_back();
+  Extent& e = exts_[i];
+  e.node = p;
+  e.last = n;
+  e.end = exts_.size();
+}
+
+
+// Returns the smallest extent that contains the tokens [first,
+// last), or npos if there is none. Of extents that span the same
+// tokens, the innermost is chosen.
+std::size_t
+Syntax_map::find(std::size_t first, std::size_t last) const
+{
+  std::size_t n = npos;
+  for (std::size_t i = 0; i < exts_.size(); ++i) {
+    Extent const& e = exts_[i];
+    if (e.first <= first && last <= e.last)
+      if (n == npos || e.last - e.first <= exts_[n].last - exts_[n].first)
+        n = i;
+  }
+  return n;
+}
+
+
+// Replace the extent n and its nested extents with those of sub,
+// whose tokens start at the token first. The number of tokens has
+// changed by delta. The extents that enclose n, and those that
+// follow it, are adjusted.
+void
+Syntax_map::splice(std::size_t n, Syntax_map const& sub, std::size_t first, std::ptrdiff_t delta)
+{
+  lingo_assert(!sub.empty() && sub.exts_[0].end == sub.size());
+  std::size_t end = exts_[n].end;
+  std::size_t parent = exts_[n].parent;
+  std::ptrdiff_t shift = std::ptrdiff_t(sub.size()) - (end - n);
+
+  // Adjust the extents that enclose n, and those that follow it.
+  for (std::size_t i = parent; i != npos; i = exts_[i].parent) {
+    exts_[i].last += delta;
+    exts_[i].end += shift;
+  }
+  for (std::size_t i = end; i < exts_.size(); ++i) {
+    Extent& e = exts_[i];
+    e.first += delta;
+    e.last += delta;
+    e.end += shift;
+    if (e.parent != npos && e.parent >= end)
+      e.parent += shift;
+  }
+
+  std::vector<Extent> exts;
+  exts.reserve(sub.size());
+  for (Extent e : sub.exts_) {
+    e.first += first;
+    e.last += first;
+    e.parent = e.parent == npos ? parent : e.parent + n;
+    e.end += n;
+    exts.push_back(e);
+  }
+  exts_.erase(exts_.begin() + n, exts_.begin() + end);
+  exts_.insert(exts_.begin() + n, exts.begin(), exts.end());
+}
+
+
+void
+Syntax_map::clear()
+{
+  exts_.clear();
+  open_.clear();
+}
+
+
+} // namespace lingo
@@ -0,0 +1,236 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_REPARSE_HPP
+#define LINGO_REPARSE_HPP
+
+// The reparse module supports the incremental lexing and parsing
+// of an edit buffer. After an edit, only the tokens damaged by the
+// edit are lexed again, and only the smallest node that contains
+// those tokens is parsed again. The new node is spliced into the
+// previous tree, and every other subtree is reused.
+
+#include <lingo/character.hpp>
+#include <lingo/edit.hpp>
+#include <lingo/error.hpp>
+#include <lingo/node.hpp>
+#include <lingo/token.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <vector>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                            Incremental lexing
+
+// The damage to a sequence of tokens. The tokens [first, last) of
+// the previous sequence are replaced by count tokens.
+struct Token_damage
+{
+  std::ptrdiff_t delta() const { return std::ptrdiff_t(count) - (last - first); }
+
+  std::size_t first;
+  std::size_t last;
+  std::size_t count;
+};
+
+
+// Update the tokens toks, which were lexed from the text of buf
+// before the change e (see Edit_buffer::changes), to the current
+// text of buf, and return the damage. Tokens are lexed by calling
+// scan with a character stream, which returns the next token, or
+// an invalid token at the end of input.
+//
+// Lexing resumes at the start of the last token that precedes the
+// change, since that token may be extended by it. Lexing stops when
+// a new token after the change has the same symbol and the same
+// (shifted) offset as a previous token. The lexer must therefore
+// depend on no state other than its position in the text. The
+// locations of the remaining tokens are shifted by the change in
+// size, which does not lex them.
+//
+// The buffer must have been synchronized. If its range of positions
+// was replaced by the synchronization, the locations of the previous
+// tokens are lost, and all of the text is lexed again.
+template<typename Scan>
+Token_damage
+relex(Edit_buffer& buf, Edit_buffer::Edit const& e, Token_seq& toks, Scan scan)
+{
+  auto offset = [&](std::size_t i) { return toks[i].location().offset(); };
+  std::size_t size = toks.size();
+  std::size_t first = 0;
+  std::size_t sync = size;
+  if (size != 0 && toks.front().location().buffer() == &buf) {
+    auto iter = std::lower_bound(toks.begin(), toks.end(), e.off, [](Token const& t, int n) {
+      return t.location().offset() < n;
+    });
+    first = iter - toks.begin();
+    if (first != 0)
+      --first;
+    sync = first;
+  }
+  int delta = e.inserted - e.erased;
+  int start = first != 0 ? offset(first) : 0;
+
+  // Lex until the new tokens are synchronized with the old ones.
+  Character_stream cs(buf, buf.begin() + start, buf.end());
+  Token_seq fresh;
+  std::size_t last = size;
+  while (Token tok = scan(cs)) {
+    int n = tok.location().offset();
+    if (n >= e.off + e.inserted) {
+      while (sync != size && (offset(sync) < e.off + e.erased || offset(sync) + delta < n))
+        ++sync;
+      if (sync != size && offset(sync) + delta == n && toks[sync].symbol() == tok.symbol()) {
+        last = sync;
+        break;
+      }
+    }
+    fresh.push_back(tok);
+  }
+
+  for (std::size_t i = last; i != size; ++i)
+    toks[i] = Token(buf.location(offset(i) + delta), toks[i].symbol());
+  toks.erase(toks.begin() + first, toks.begin() + last);
+  toks.insert(toks.begin() + first, fresh.begin(), fresh.end());
+  return {first, last, fresh.size()};
+}
+
+
+// -------------------------------------------------------------------------- //
+//                              Syntax maps
+
+// A syntax map records the range of tokens spanned by each node
+// of a tree that can be parsed again on its own, and the production
+// that parsed it. The extents of a map form a tree, stored in
+// preorder.
+//
+// A parser records a node by opening an extent before it parses
+// the node, and closing the extent after, with the token positions
+// at those points. An extent is recorded by the caller of the
+// production that parses the node.
+//
+// Only nodes whose parse does not depend on the tokens around them
+// should be recorded, such as bracketed nodes, or the statements of
+// a block. The operands of an infix operator are not: the tokens of
+// an edit could bind more tightly to the operator than to those of
+// the operand.
+class Syntax_map
+{
+public:
+  static constexpr std::size_t npos = -1;
+
+  struct Extent
+  {
+    void const* node;
+    int         prod;
+    std::size_t first;  // The first token
+    std::size_t last;   // Past the last token
+    std::size_t parent; // The enclosing extent, or npos
+    std::size_t end;    // Past the last nested extent
+  };
+
+  std::size_t open(int, std::size_t);
+  void        close(std::size_t, void const*, std::size_t);
+
+  std::size_t find(std::size_t, std::size_t) const;
+
+  void splice(std::size_t, Syntax_map const&, std::size_t, std::ptrdiff_t);
+  void replace(std::size_t n, void const* p) { exts_[n].node = p; }
+
+  bool          empty() const                     { return exts_.empty(); }
+  std::size_t   size() const                      { return exts_.size(); }
+  Extent const& operator[](std::size_t n) const   { return exts_[n]; }
+
+  void clear();
+
+private:
+  std::vector<Extent>      exts_;
+  std::vector<std::size_t> open_;
+};
+
+
+// -------------------------------------------------------------------------- //
+//                            Incremental parsing
+
+// The result of a reparse. The node of the extent n was replaced.
+struct Reparse
+{
+  std::size_t index;
+  void const* old_node;
+  void const* new_node;
+};
+
+
+// Parse again the smallest node of map that contains the damage d
+// to the tokens toks, and update map. Returns true if the node was
+// parsed again, setting r.
+//
+// The node is parsed by calling parse with the production of its
+// extent, a token stream over its tokens, and a map in which the
+// nested extents are recorded. Parsing fails when parse throws an
+// exception, returns an error node, reports an error, or does not
+// consume all of the tokens. In that case, the enclosing node is
+// parsed instead. Diagnostics are suppressed while parsing.
+//
+// If no node contains the damage, or if the outermost node cannot
+// be parsed, this returns false, and the whole input should be
+// parsed again.
+template<typename T, typename Parse>
+bool
+reparse(Syntax_map& map, Token_seq const& toks, Token_damage const& d, Parse parse, Reparse& r)
+{
+  for (std::size_t i = map.find(d.first, d.last); i != Syntax_map::npos; i = map[i].parent) {
+    Syntax_map::Extent const& e = map[i];
+    std::size_t first = e.first;
+    std::size_t last = e.last + d.delta();
+    Token_stream ts(Token_seq(toks.begin() + first, toks.begin() + last));
+    Syntax_map sub;
+    Diagnostic_context cxt(discard_diags);
+    T const* node;
+    try {
+      sub.open(e.prod, 0);
+      node = parse(e.prod, ts, sub);
+    } catch (std::exception&) {
+      continue;
+    }
+    if (!is_valid_node(node) || !ts.eof() || !cxt.ok())
+      continue;
+    sub.close(0, node, ts.position());
+
+    r = {i, e.node, node};
+    map.splice(i, sub, first, d.delta());
+    return true;
+  }
+  return false;
+}
+
+
+// Splice the new node of the reparse r into the tree of map. Each
+// node that encloses the old node is rebuilt by calling rebuild
+// with that node, the old node that it contains, and its new node.
+// Returns the new outermost node.
+template<typename T, typename Rebuild>
+T const*
+splice(Syntax_map& map, Reparse const& r, Rebuild rebuild)
+{
+  T const* old = static_cast<T const*>(r.old_node);
+  T const* node = static_cast<T const*>(r.new_node);
+  for (std::size_t i = map[r.index].parent; i != Syntax_map::npos; i = map[i].parent) {
+    T const* p = static_cast<T const*>(map[i].node);
+    T const* q = rebuild(p, old, node);
+    map.replace(i, q);
+    old = p;
+    node = q;
+  }
+  return node;
+}
+
+
+} // namespace lingo
+
+#endif
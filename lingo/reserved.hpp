@@ -0,0 +1,464 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_RESERVED_HPP
+#define LINGO_RESERVED_HPP
+
+// The reserved module provides compile-time tables for the
+// fixed spellings of a language: its keywords and punctuators.
+// A table is built from a list of {spelling, token kind} pairs
+// and provides a perfect hash recognizer for those spellings
+// and the reverse mapping from token kinds to spellings.
+//
+// Lexers consult the table before falling back to the symbol
+// table, so reserved words are classified without probing
+// the hash table, and nothing is inserted at startup.
+//
+// A punctuator trie matches the longest punctuator at the
+// current position of a character stream in a single call.
+
+#include <lingo/token.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                          Reserved spellings
+
+
+// A reserved spelling associates a fixed string with
+// the kind of token it denotes.
+struct Reserved
+{
+  constexpr Reserved()
+    : str(""), len(0), kind(invalid_tok)
+  { }
+
+  template<std::size_t N>
+  constexpr Reserved(char const (&s)[N], int k)
+    : str(s), len(N - 1), kind(k)
+  { }
+
+  char const* str;
+  int         len;
+  int         kind;
+};
+
+
+// Returns the perfect hash of the characters in [first,
+// last) for the given seed. This is a 32-bit FNV-1a hash
+// whose initial state is perturbed by the seed.
+constexpr std::uint32_t
+reserved_hash(std::uint32_t seed, char const* first, char const* last)
+{
+  std::uint32_t h = 2166136261u ^ seed;
+  while (first != last) {
+    h ^= static_cast<unsigned char>(*first++);
+    h *= 16777619u;
+  }
+  return h ^ (h >> 15);
+}
+
+
+// Returns the number of slots in the hash table of a reserved
+// table with n entries. This is the smallest power of two not
+// less than 4n, which makes a perfect seed easy to find.
+constexpr std::size_t
+reserved_slots(std::size_t n)
+{
+  std::size_t k = 4;
+  while (k < 4 * n)
+    k *= 2;
+  return k;
+}
+
+
+// A reserved table is a compile-time mapping between the
+// spellings and token kinds of a language's keywords and
+// punctuators. The table is constructed by searching for a
+// seed that hashes every spelling to a distinct slot. Lookup
+// then computes one hash and compares one candidate.
+//
+// Use make_reserved_table to deduce the size of the table
+// from a list of entries. The table should be declared
+// constexpr. A list with duplicate spellings or for which
+// no seed can be found does not produce a constant.
+template<std::size_t N>
+class Reserved_table
+{
+  static constexpr std::size_t slots = reserved_slots(N);
+  static constexpr std::uint32_t max_seed = 1 << 16;
+
+public:
+  constexpr Reserved_table(Reserved const (&)[N]);
+
+  constexpr std::size_t size() const { return N; }
+  constexpr Reserved const& operator[](std::size_t n) const { return ents_[n]; }
+
+  constexpr int find(char const*, char const*) const;
+  int           find(String_view) const;
+
+  constexpr int kind(char const*, char const*) const;
+  int           kind(String_view) const;
+
+  constexpr char const* spelling(int) const;
+
+private:
+  constexpr bool place(std::uint32_t);
+  constexpr int  slot(char const*, char const*) const;
+
+  Reserved      ents_[N];   // Entries, in declaration order
+  int           hash_[slots]; // Entry index by hash, or -1
+  int           kind_[N];   // Entry indexes, sorted by kind
+  std::uint32_t seed_;
+};
+
+
+// Construct the table for the given entries.
+template<std::size_t N>
+constexpr
+Reserved_table<N>::Reserved_table(Reserved const (&ents)[N])
+  : ents_(), hash_(), kind_(), seed_(0)
+{
+  for (std::size_t i = 0; i < N; ++i)
+    ents_[i] = ents[i];
+
+  // Reject duplicate spellings. No seed can separate them.
+  for (std::size_t i = 0; i < N; ++i) {
+    for (std::size_t j = i + 1; j < N; ++j) {
+      Reserved const& a = ents_[i];
+      Reserved const& b = ents_[j];
+      if (a.len != b.len)
+        continue;
+      int k = 0;
+      while (k < a.len && a.str[k] == b.str[k])
+        ++k;
+      if (k == a.len)
+        throw std::logic_error("duplicate reserved spelling");
+    }
+  }
+
+  // Search for a perfect seed.
+  while (!place(seed_)) {
+    if (++seed_ == max_seed)
+      throw std::logic_error("no perfect hash for reserved spellings");
+  }
+
+  // Sort entry indexes by token kind for reverse lookup.
+  for (std::size_t i = 0; i < N; ++i) {
+    std::size_t j = i;
+    while (j != 0 && ents_[kind_[j - 1]].kind > ents_[i].kind) {
+      kind_[j] = kind_[j - 1];
+      --j;
+    }
+    kind_[j] = i;
+  }
+}
+
+
+// Try to place each entry in a distinct slot using the
+// given seed. Returns true if successful.
+template<std::size_t N>
+constexpr bool
+Reserved_table<N>::place(std::uint32_t seed)
+{
+  for (std::size_t i = 0; i < slots; ++i)
+    hash_[i] = -1;
+  for (std::size_t i = 0; i < N; ++i) {
+    char const* s = ents_[i].str;
+    std::size_t h = reserved_hash(seed, s, s + ents_[i].len) & (slots - 1);
+    if (hash_[h] != -1)
+      return false;
+    hash_[h] = i;
+  }
+  return true;
+}
+
+
+// Returns the index of the only entry that could be spelled
+// [first, last), or -1 if no entry hashes to that slot.
+template<std::size_t N>
+constexpr int
+Reserved_table<N>::slot(char const* first, char const* last) const
+{
+  return hash_[reserved_hash(seed_, first, last) & (slots - 1)];
+}
+
+
+// Returns the index of the entry spelled [first, last), or
+// -1 if the spelling is not reserved.
+template<std::size_t N>
+constexpr int
+Reserved_table<N>::find(char const* first, char const* last) const
+{
+  int n = slot(first, last);
+  if (n < 0)
+    return -1;
+  Reserved const& e = ents_[n];
+  if (e.len != last - first)
+    return -1;
+  for (int i = 0; i < e.len; ++i)
+    if (e.str[i] != first[i])
+      return -1;
+  return n;
+}
+
+
+template<std::size_t N>
+inline int
+Reserved_table<N>::find(String_view s) const
+{
+  return find(s.begin(), s.end());
+}
+
+
+// Returns the token kind of the spelling [first, last), or
+// invalid_tok if the spelling is not reserved.
+template<std::size_t N>
+constexpr int
+Reserved_table<N>::kind(char const* first, char const* last) const
+{
+  int n = find(first, last);
+  return n < 0 ? invalid_tok : ents_[n].kind;
+}
+
+
+template<std::size_t N>
+inline int
+Reserved_table<N>::kind(String_view s) const
+{
+  return kind(s.begin(), s.end());
+}
+
+
+// Returns the spelling of the token kind k or nullptr if
+// no reserved spelling has that kind. When several spellings
+// share a kind, one of them is returned.
+template<std::size_t N>
+constexpr char const*
+Reserved_table<N>::spelling(int k) const
+{
+  std::size_t lo = 0;
+  std::size_t hi = N;
+  while (lo < hi) {
+    std::size_t mid = lo + (hi - lo) / 2;
+    int m = ents_[kind_[mid]].kind;
+    if (m == k)
+      return ents_[kind_[mid]].str;
+    if (m < k)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return nullptr;
+}
+
+
+// Deduce the size of a reserved table from its entries.
+template<std::size_t N>
+constexpr Reserved_table<N>
+make_reserved_table(Reserved const (&ents)[N])
+{
+  return Reserved_table<N>(ents);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                          Reserved symbols
+
+
+// The reserved symbols of a table are the symbols returned
+// for its spellings during lexing. These are created once,
+// in the order of the table's entries, and are not entered
+// into any symbol table.
+template<std::size_t N>
+class Reserved_symbols
+{
+public:
+  Reserved_symbols(Reserved_table<N> const&);
+
+  Reserved_symbols(Reserved_symbols const&) = delete;
+  Reserved_symbols& operator=(Reserved_symbols const&) = delete;
+
+  Reserved_table<N> const& table() const { return table_; }
+
+  Symbol const* get(String_view) const;
+  Symbol const* get(char const*, char const*) const;
+
+private:
+  Reserved_table<N> const& table_;
+  std::vector<String>      strs_;
+  std::vector<Symbol>      syms_;
+};
+
+
+template<std::size_t N>
+Reserved_symbols<N>::Reserved_symbols(Reserved_table<N> const& t)
+  : table_(t)
+{
+  strs_.reserve(N);
+  syms_.reserve(N);
+  for (std::size_t i = 0; i < N; ++i) {
+    strs_.emplace_back(t[i].str, t[i].len);
+    syms_.emplace_back(t[i].kind, &strs_.back());
+  }
+}
+
+
+// Returns the symbol for the reserved spelling s, or nullptr
+// if s is not reserved.
+template<std::size_t N>
+inline Symbol const*
+Reserved_symbols<N>::get(String_view s) const
+{
+  int n = table_.find(s);
+  return n < 0 ? nullptr : &syms_[n];
+}
+
+
+template<std::size_t N>
+inline Symbol const*
+Reserved_symbols<N>::get(char const* first, char const* last) const
+{
+  return get(String_view(first, last));
+}
+
+
+// -------------------------------------------------------------------------- //
+//                            Punctuator tries
+
+
+// A punctuator trie maps spellings to symbols, and finds the
+// longest spelling at the start of a sequence of characters.
+// The first character selects a node from a table indexed by
+// that character. Each further character follows a link from
+// the previous node to one of its children, of which there are
+// usually very few.
+//
+// A trie built from reserved symbols contains the punctuators:
+// the spellings that do not start with an identifier character.
+class Punctuator_trie
+{
+public:
+  Punctuator_trie();
+
+  template<std::size_t N>
+  explicit Punctuator_trie(Reserved_symbols<N> const&);
+
+  void put(String_view, Symbol const*);
+
+  Symbol const* match(char const*, char const*, int&) const;
+
+  template<typename Stream>
+  Symbol const* match(Stream&) const;
+
+private:
+  // A node for a prefix of the spellings. Children are linked
+  // through next.
+  struct Node
+  {
+    Symbol const* sym;   // The symbol spelled by the prefix, if any
+    int           child; // The first child, or 0
+    int           next;  // The next sibling, or 0
+    char          c;     // The last character of the prefix
+  };
+
+  int               root_[256]; // Nodes by first character, or 0
+  std::vector<Node> nodes_;     // Node 0 is unused
+};
+
+
+inline
+Punctuator_trie::Punctuator_trie()
+  : root_(), nodes_(1)
+{ }
+
+
+template<std::size_t N>
+Punctuator_trie::Punctuator_trie(Reserved_symbols<N> const& syms)
+  : Punctuator_trie()
+{
+  Reserved_table<N> const& t = syms.table();
+  for (std::size_t i = 0; i < N; ++i) {
+    String_view s(t[i].str, t[i].str + t[i].len);
+    if (!is_identifier_char(s[0]))
+      put(s, syms.get(s));
+  }
+}
+
+
+// Associate the spelling s with the symbol sym.
+inline void
+Punctuator_trie::put(String_view s, Symbol const* sym)
+{
+  lingo_assert(s.size() != 0);
+  int* link = &root_[static_cast<unsigned char>(s[0])];
+  for (int i = 0; ; ) {
+    int n = *link;
+    if (n == 0) {
+      // Adding the node may move the link.
+      n = *link = nodes_.size();
+      nodes_.push_back({nullptr, 0, 0, s[i]});
+    }
+    if (++i == s.size()) {
+      nodes_[n].sym = sym;
+      return;
+    }
+    link = &nodes_[n].child;
+    while (*link && nodes_[*link].c != s[i])
+      link = &nodes_[*link].next;
+  }
+}
+
+
+// Returns the symbol of the longest spelling at the start of
+// [first, last), and sets len to its length. Returns nullptr
+// if no spelling matches.
+inline Symbol const*
+Punctuator_trie::match(char const* first, char const* last, int& len) const
+{
+  Symbol const* sym = nullptr;
+  len = 0;
+  if (first == last)
+    return nullptr;
+  char const* p = first;
+  int n = root_[static_cast<unsigned char>(*p)];
+  while (n) {
+    Node const& x = nodes_[n];
+    ++p;
+    if (x.sym) {
+      sym = x.sym;
+      len = p - first;
+    }
+    if (p == last)
+      break;
+    n = x.child;
+    while (n && nodes_[n].c != *p)
+      n = nodes_[n].next;
+  }
+  return sym;
+}
+
+
+// Returns the symbol of the longest spelling at the current
+// position of the character stream cs, and advances past it.
+// Returns nullptr if no spelling matches.
+template<typename Stream>
+inline Symbol const*
+Punctuator_trie::match(Stream& cs) const
+{
+  int len;
+  Symbol const* sym = match(cs.begin(), cs.end(), len);
+  cs.advance(len);
+  return sym;
+}
+
+
+} // namespace lingo
+
+#endif
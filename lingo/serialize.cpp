@@ -0,0 +1,325 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/serialize.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace lingo
+{
+
+namespace
+{
+
+// The layout of a tree file is a header, followed by the offsets
+// of the node records, the symbol table, and the node records. The
+// header and offsets are 4-byte aligned, so the offsets can be read
+// directly from a mapping.
+
+constexpr char          tree_magic[4] = {'L', 'T', 'R', 'E'};
+constexpr std::uint32_t tree_version = 1;
+
+
+struct Tree_header
+{
+  char          magic[4];
+  std::uint32_t version;
+  std::uint32_t nodes;  // The number of node records
+  std::uint32_t syms;   // The number of symbols
+  std::uint64_t table;  // The size of the symbol table
+  std::uint64_t data;   // The size of the node records
+};
+
+
+[[noreturn]] void
+malformed()
+{
+  throw std::runtime_error("malformed tree file");
+}
+
+
+// Write the symbol s to the symbol table w. Each symbol is its
+// class, token kind, and spelling, followed by its value.
+void
+write_symbol_entry(Node_writer& w, Symbol const& s)
+{
+  w.write_uint(s.cls());
+  w.write_int(s.token());
+  w.write_string(s.spelling());
+  switch (s.cls()) {
+    case Symbol::plain_sym:
+    case Symbol::identifier_sym:
+      break;
+    case Symbol::boolean_sym:
+      w.write_int(cast<Boolean_sym>(s).value());
+      break;
+    case Symbol::integer_sym:
+      w.write_int(cast<Integer_sym>(s).value());
+      break;
+    case Symbol::character_sym:
+      w.write_int(cast<Character_sym>(s).value());
+      break;
+    case Symbol::string_sym:
+      w.write_string(cast<String_sym>(s).value());
+      break;
+  }
+}
+
+
+// Read a symbol from the symbol table r, and intern it in syms.
+Symbol const*
+read_symbol_entry(Node_reader& r, Symbol_table& syms)
+{
+  std::uint64_t c = r.read_uint();
+  int k = r.read_int();
+  String s = r.read_string();
+  switch (c) {
+    case Symbol::plain_sym:
+      return syms.put_symbol(k, s);
+    case Symbol::identifier_sym:
+      return syms.put_identifier(k, s);
+    case Symbol::boolean_sym:
+      return syms.put_boolean(k, s, r.read_int());
+    case Symbol::integer_sym:
+      return syms.put_integer(k, s, r.read_int());
+    case Symbol::character_sym:
+      return syms.put_character(k, s, r.read_int());
+    case Symbol::string_sym:
+      return syms.put_string(k, s, r.read_string());
+  }
+  malformed();
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+//                            Node encoding
+
+void
+Node_writer::write_uint(std::uint64_t n)
+{
+  while (n >= 0x80) {
+    data_ += char(n | 0x80);
+    n >>= 7;
+  }
+  data_ += char(n);
+}
+
+
+// Signed integers are zigzag encoded, so that small negative
+// values are also short.
+void
+Node_writer::write_int(std::int64_t n)
+{
+  write_uint((std::uint64_t(n) << 1) ^ std::uint64_t(n >> 63));
+}
+
+
+void
+Node_writer::write_string(String const& s)
+{
+  write_uint(s.size());
+  data_ += s;
+}
+
+
+// A null symbol is 0. Otherwise, a symbol is its index in the
+// table plus one.
+void
+Node_writer::write_symbol(Symbol const* s)
+{
+  if (!s) {
+    write_uint(0);
+    return;
+  }
+  auto ins = ids_.emplace(s, syms_.size());
+  if (ins.second)
+    syms_.push_back(s);
+  write_uint(ins.first->second + 1);
+}
+
+
+// A null node is 0. Otherwise, a node is the distance back from
+// the current node. The node must already have been written.
+void
+Node_writer::write_node(void const* p)
+{
+  if (!p) {
+    write_uint(0);
+    return;
+  }
+  auto iter = nodes_.find(p);
+  lingo_assert(iter != nodes_.end());
+  write_uint(size() - 1 - iter->second);
+}
+
+
+// Begin the record of the node p, and return its index.
+Node_writer::Index
+Node_writer::start_node(void const* p)
+{
+  Index n = size();
+  offsets_.push_back(data_.size());
+  nodes_.emplace(p, n);
+  return n;
+}
+
+
+constexpr Node_reader::Index Node_reader::none;
+
+
+std::uint64_t
+Node_reader::read_uint()
+{
+  std::uint64_t n = 0;
+  for (int s = 0; s < 64; s += 7) {
+    if (first_ == last_)
+      malformed();
+    unsigned char c = *first_++;
+    n |= std::uint64_t(c & 0x7f) << s;
+    if (!(c & 0x80))
+      return n;
+  }
+  malformed();
+}
+
+
+std::int64_t
+Node_reader::read_int()
+{
+  std::uint64_t n = read_uint();
+  return std::int64_t(n >> 1) ^ -std::int64_t(n & 1);
+}
+
+
+String
+Node_reader::read_string()
+{
+  std::uint64_t n = read_uint();
+  if (n > std::uint64_t(last_ - first_))
+    malformed();
+  String s(first_, first_ + n);
+  first_ += n;
+  return s;
+}
+
+
+Symbol const*
+Node_reader::read_symbol()
+{
+  std::uint64_t n = read_uint();
+  if (n == 0)
+    return nullptr;
+  if (n > nsyms_)
+    malformed();
+  return syms_[n - 1];
+}
+
+
+// Returns the index of the referenced node, which must precede
+// the current node, or none.
+Node_reader::Index
+Node_reader::read_node()
+{
+  std::uint64_t n = read_uint();
+  if (n == 0)
+    return none;
+  if (n > node_)
+    malformed();
+  return node_ - Index(n);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                              Tree files
+
+void
+save_tree_file(Path const& p, Node_writer const& w)
+{
+  Node_writer tab;
+  for (Symbol const* s : w.symbols())
+    write_symbol_entry(tab, *s);
+
+  Tree_header h;
+  std::memcpy(h.magic, tree_magic, sizeof(h.magic));
+  h.version = tree_version;
+  h.nodes = w.size();
+  h.syms = w.symbols().size();
+  h.table = tab.data().size();
+  h.data = w.data().size();
+
+  std::ofstream f(p.native(), std::ios::binary | std::ios::trunc);
+  f.write(reinterpret_cast<char const*>(&h), sizeof(h));
+  f.write(reinterpret_cast<char const*>(w.offsets().data()), w.offsets().size() * sizeof(std::uint32_t));
+  f.write(tab.data().data(), tab.data().size());
+  f.write(w.data().data(), w.data().size());
+  f.close();
+  if (!f)
+    throw std::runtime_error("cannot write tree file '" + p.string() + "'");
+}
+
+
+Tree_image::Tree_image(Path const& p, Symbol_table& syms)
+  : map_(p), ok_(false), nodes_(0), offsets_(nullptr), data_(nullptr), size_(0)
+{
+  try {
+    ok_ = open(syms);
+  } catch (std::runtime_error&) {
+    ok_ = false;
+  }
+  if (!ok_) {
+    nodes_ = 0;
+    syms_.clear();
+  }
+}
+
+
+// Check the layout of the file and intern its symbols. Returns
+// false if the file is malformed.
+bool
+Tree_image::open(Symbol_table& syms)
+{
+  Tree_header h;
+  if (map_.size() < sizeof(h))
+    return false;
+  std::memcpy(&h, map_.data(), sizeof(h));
+  if (std::memcmp(h.magic, tree_magic, sizeof(h.magic)) || h.version != tree_version)
+    return false;
+  std::uint64_t idx = std::uint64_t(h.nodes) * sizeof(std::uint32_t);
+  if (h.table > map_.size() || h.data > map_.size())
+    return false;
+  if (map_.size() != sizeof(h) + idx + h.table + h.data)
+    return false;
+
+  offsets_ = reinterpret_cast<std::uint32_t const*>(map_.data() + sizeof(h));
+  char const* tab = map_.data() + sizeof(h) + idx;
+  data_ = tab + h.table;
+  size_ = h.data;
+  for (std::uint32_t i = 0; i < h.nodes; ++i)
+    if (offsets_[i] > size_ || (i && offsets_[i] < offsets_[i - 1]))
+      return false;
+
+  Node_reader r(tab, data_, 0, nullptr, 0);
+  syms_.reserve(h.syms);
+  for (std::uint32_t i = 0; i < h.syms; ++i)
+    syms_.push_back(read_symbol_entry(r, syms));
+  nodes_ = h.nodes;
+  return true;
+}
+
+
+// Returns a reader for the record of the node n.
+Node_reader
+Tree_image::reader(Index n) const
+{
+  lingo_assert(n < nodes_);
+  std::size_t last = n + 1 < nodes_ ? offsets_[n + 1] : size_;
+  return Node_reader(data_ + offsets_[n], data_ + last, n, syms_.data(), syms_.size());
+}
+
+
+} // namespace lingo
@@ -0,0 +1,622 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_SERIALIZE_HPP
+#define LINGO_SERIALIZE_HPP
+
+// The serialize module saves trees in a compact binary file, so
+// that later runs can load them instead of parsing again. The file
+// is mapped when it is loaded, and nodes are built only when they
+// are requested.
+
+#include <lingo/dispatch.hpp>
+#include <lingo/file.hpp>
+#include <lingo/memory.hpp>
+#include <lingo/node.hpp>
+#include <lingo/symbol.hpp>
+#include <lingo/traversal.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                            Node encoding
+
+// A node writer encodes the records of a tree file. Integers are
+// written as variable-length quantities (LEB128), so small values
+// take a single byte. Symbols are written as their index in the
+// symbol table of the file, and references to nodes as the distance
+// back to the referenced node, which always precedes the referring
+// node.
+class Node_writer
+{
+public:
+  using Index = std::uint32_t;
+
+  void write_uint(std::uint64_t);
+  void write_int(std::int64_t);
+  void write_string(String const&);
+  void write_symbol(Symbol const*);
+  void write_node(void const*);
+
+  Index start_node(void const*);
+  Index size() const { return offsets_.size(); }
+
+  String const&                 data() const    { return data_; }
+  std::vector<std::uint32_t> const& offsets() const { return offsets_; }
+  std::vector<Symbol const*> const& symbols() const { return syms_; }
+
+private:
+  String                                        data_;
+  std::vector<std::uint32_t>                    offsets_;
+  std::unordered_map<void const*, Index>        nodes_;
+  std::vector<Symbol const*>                    syms_;
+  std::unordered_map<Symbol const*, Index>      ids_;
+};
+
+
+// A node reader decodes the records of a tree file. It throws
+// std::runtime_error if a record is malformed.
+class Node_reader
+{
+public:
+  using Index = std::uint32_t;
+
+  Node_reader(char const* first, char const* last, Index n, Symbol const* const* syms, Index k)
+    : first_(first), last_(last), node_(n), syms_(syms), nsyms_(k)
+  { }
+
+  std::uint64_t read_uint();
+  std::int64_t  read_int();
+  String        read_string();
+  Symbol const* read_symbol();
+  Index         read_node();
+
+  // The index of the node whose record is read, and the index
+  // for a null reference.
+  Index node() const { return node_; }
+
+  static constexpr Index none = 0xffffffff;
+
+private:
+  char const*          first_;
+  char const*          last_;
+  Index                node_;
+  Symbol const* const* syms_;
+  Index                nsyms_;
+};
+
+
+// -------------------------------------------------------------------------- //
+//                              Terms
+//
+// The sub-terms of a node (see node.hpp) are written in order:
+// first, second, and third, or the number of elements followed by
+// each element. A sub-term that is a node of the tree is written
+// as a reference. Other sub-terms are written by write_term and read
+// by read_term, which are overloaded for integers, enumerations,
+// strings, and symbols. Languages can overload them, found by
+// argument-dependent lookup, for other types.
+
+
+// A tag that selects the overload of read_term for the type T.
+template<typename T>
+struct Term_tag
+{ };
+
+
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value>::type
+write_term(Node_writer& w, T n)
+{
+  if (std::is_signed<T>::value)
+    w.write_int(n);
+  else
+    w.write_uint(n);
+}
+
+
+template<typename T>
+inline typename std::enable_if<std::is_enum<T>::value>::type
+write_term(Node_writer& w, T n)
+{
+  w.write_int(static_cast<std::int64_t>(n));
+}
+
+
+inline void
+write_term(Node_writer& w, String const& s)
+{
+  w.write_string(s);
+}
+
+
+template<typename T>
+inline typename std::enable_if<std::is_base_of<Symbol, T>::value>::type
+write_term(Node_writer& w, T const* s)
+{
+  w.write_symbol(s);
+}
+
+
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value, T>::type
+read_term(Node_reader& r, Term_tag<T>)
+{
+  if (std::is_signed<T>::value)
+    return T(r.read_int());
+  else
+    return T(r.read_uint());
+}
+
+
+template<typename T>
+inline typename std::enable_if<std::is_enum<T>::value, T>::type
+read_term(Node_reader& r, Term_tag<T>)
+{
+  return T(r.read_int());
+}
+
+
+inline String
+read_term(Node_reader& r, Term_tag<String>)
+{
+  return r.read_string();
+}
+
+
+// Read a symbol of the class T. The symbol must have that class.
+template<typename T>
+inline typename std::enable_if<std::is_base_of<Symbol, T>::value, T const*>::type
+read_term(Node_reader& r, Term_tag<T const*>)
+{
+  Symbol const* s = r.read_symbol();
+  if (s && !is<T>(s))
+    throw std::runtime_error("malformed tree file");
+  return static_cast<T const*>(s);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                              Node data
+//
+// Data of a node that is not a sub-term, such as the value of a
+// literal, is written by save_node_data after its sub-terms. By
+// default, there is none.
+//
+// A node is built by load_node, which is given the sub-terms read
+// from its record, and reads any data that follows them. By
+// default, the node is allocated in the current arena (see
+// Arena_scope), and constructed from its sub-terms (for a k-ary
+// node, the vector of its elements). Node types that have other
+// constructors or data overload both functions for a pointer to
+// that type.
+
+
+template<typename T>
+inline void
+save_node_data(Node_writer&, T const*)
+{ }
+
+
+template<typename T, typename... Args>
+inline T const*
+load_node(Node_reader&, T const*, Args&&... args)
+{
+  return Arena_scope::current().make<T>(std::forward<Args>(args)...);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                              Tree files
+
+// A tree file contains the nodes of a tree in post-order, so that
+// each node follows its sub-terms. Each node is a record containing
+// its kind, its sub-terms, and its data (see above). An index gives
+// the offset of each record, so that a node can be read without
+// reading the nodes that precede it. The symbols of the tree are
+// stored once, in a table that precedes the index.
+//
+// Nodes that are shared within a tree are saved once, and are
+// shared when the tree is loaded.
+
+
+namespace serialize_impl
+{
+
+// The sub-term x is a node of the hierarchy whose base is B.
+template<typename B, typename X>
+using is_node_ref = std::integral_constant<bool,
+  std::is_pointer<X>::value && std::is_convertible<X, B const*>::value>;
+
+
+template<typename B, typename X>
+inline void
+write_subterm(Node_writer& w, X const& x, std::true_type)
+{
+  w.write_node(x);
+}
+
+
+template<typename B, typename X>
+inline void
+write_subterm(Node_writer& w, X const& x, std::false_type)
+{
+  write_term(w, x);
+}
+
+
+template<typename B, typename X>
+inline void
+write_subterm(Node_writer& w, X const& x)
+{
+  write_subterm<B>(w, x, is_node_ref<B, X>());
+}
+
+
+template<typename B, typename T>
+inline typename std::enable_if<is_nullary_node<T>()>::type
+write_subterms(Node_writer&, T const*)
+{ }
+
+
+template<typename B, typename T>
+inline typename std::enable_if<is_unary_node<T>()>::type
+write_subterms(Node_writer& w, T const* t)
+{
+  write_subterm<B>(w, t->first);
+}
+
+
+template<typename B, typename T>
+inline typename std::enable_if<is_binary_node<T>()>::type
+write_subterms(Node_writer& w, T const* t)
+{
+  write_subterm<B>(w, t->first);
+  write_subterm<B>(w, t->second);
+}
+
+
+template<typename B, typename T>
+inline typename std::enable_if<is_ternary_node<T>()>::type
+write_subterms(Node_writer& w, T const* t)
+{
+  write_subterm<B>(w, t->first);
+  write_subterm<B>(w, t->second);
+  write_subterm<B>(w, t->third);
+}
+
+
+template<typename B, typename T>
+inline typename std::enable_if<is_kary_node<T>()>::type
+write_subterms(Node_writer& w, T const* t)
+{
+  std::uint64_t n = 0;
+  for (auto i = t->begin(); i != t->end(); ++i)
+    ++n;
+  w.write_uint(n);
+  for (auto const& x : *t)
+    write_subterm<B>(w, x);
+}
+
+
+template<typename B>
+struct Write_fn
+{
+  template<typename T>
+  void operator()(T const* t) const
+  {
+    w.write_uint(std::uint64_t(T::node_kind));
+    write_subterms<B>(w, t);
+    save_node_data(w, t);
+  }
+
+  Node_writer& w;
+};
+
+
+// The type of a sub-term, without references or cv-qualifiers.
+template<typename X>
+using term_type = typename std::decay<X>::type;
+
+
+// The types of the sub-terms of T, and of the elements of a k-ary
+// node.
+template<typename T> using first_of   = term_type<decltype(std::declval<T>().first)>;
+template<typename T> using second_of  = term_type<decltype(std::declval<T>().second)>;
+template<typename T> using third_of   = term_type<decltype(std::declval<T>().third)>;
+template<typename T> using element_of = term_type<decltype(*std::declval<T>().begin())>;
+
+
+// Reads the sub-terms of nodes of the hierarchy L whose base is B
+// from the records of a tree file. When a referenced node has not
+// been built, it is added to missing, and a null pointer is
+// returned instead.
+template<typename L, typename B>
+struct Subterm_reader
+{
+  template<typename X>
+  X read(Node_reader& r, std::true_type)
+  {
+    Node_reader::Index n = r.read_node();
+    if (n == Node_reader::none)
+      return nullptr;
+    if (!nodes[n])
+      missing.push_back(n);
+    return static_cast<X>(nodes[n]);
+  }
+
+  template<typename X>
+  X read(Node_reader& r, std::false_type)
+  {
+    return read_term(r, Term_tag<X>());
+  }
+
+  template<typename X>
+  X read(Node_reader& r)
+  {
+    return read<X>(r, is_node_ref<B, X>());
+  }
+
+  std::vector<B const*> const&     nodes;
+  std::vector<Node_reader::Index>& missing;
+};
+
+
+template<typename L, typename B, typename T>
+inline typename std::enable_if<is_nullary_node<T>(), T const*>::type
+read_node(Node_reader& r, Subterm_reader<L, B>&, T const* t, bool build)
+{
+  return build ? load_node(r, t) : nullptr;
+}
+
+
+template<typename L, typename B, typename T>
+inline typename std::enable_if<is_unary_node<T>(), T const*>::type
+read_node(Node_reader& r, Subterm_reader<L, B>& s, T const* t, bool build)
+{
+  auto x1 = s.template read<first_of<T>>(r);
+  return build ? load_node(r, t, std::move(x1)) : nullptr;
+}
+
+
+template<typename L, typename B, typename T>
+inline typename std::enable_if<is_binary_node<T>(), T const*>::type
+read_node(Node_reader& r, Subterm_reader<L, B>& s, T const* t, bool build)
+{
+  auto x1 = s.template read<first_of<T>>(r);
+  auto x2 = s.template read<second_of<T>>(r);
+  return build ? load_node(r, t, std::move(x1), std::move(x2)) : nullptr;
+}
+
+
+template<typename L, typename B, typename T>
+inline typename std::enable_if<is_ternary_node<T>(), T const*>::type
+read_node(Node_reader& r, Subterm_reader<L, B>& s, T const* t, bool build)
+{
+  auto x1 = s.template read<first_of<T>>(r);
+  auto x2 = s.template read<second_of<T>>(r);
+  auto x3 = s.template read<third_of<T>>(r);
+  return build ? load_node(r, t, std::move(x1), std::move(x2), std::move(x3)) : nullptr;
+}
+
+
+template<typename L, typename B, typename T>
+inline typename std::enable_if<is_kary_node<T>(), T const*>::type
+read_node(Node_reader& r, Subterm_reader<L, B>& s, T const* t, bool build)
+{
+  std::uint64_t n = r.read_uint();
+  std::vector<element_of<T>> xs;
+  for (std::uint64_t i = 0; i < n; ++i)
+    xs.push_back(s.template read<element_of<T>>(r));
+  return build ? load_node(r, t, std::move(xs)) : nullptr;
+}
+
+
+// Read the record of the node of kind K from r. If build is true,
+// the node is built. Otherwise, the missing sub-terms are found.
+template<int K, typename L, typename B, typename... Ts>
+inline B const*
+read_kind(Node_reader& r, Subterm_reader<L, B>& s, bool build, Node_list<Ts...>)
+{
+  using T = typename dispatch_impl::node_of<K, Ts...>::type;
+  return read_kind(r, s, build, static_cast<T*>(nullptr));
+}
+
+
+template<typename L, typename B, typename T>
+inline B const*
+read_kind(Node_reader& r, Subterm_reader<L, B>& s, bool build, T* t)
+{
+  return read_node(r, s, static_cast<T const*>(t), build);
+}
+
+
+template<typename L, typename B>
+[[noreturn]] inline B const*
+read_kind(Node_reader&, Subterm_reader<L, B>&, bool, void*)
+{
+  throw std::runtime_error("malformed tree file");
+}
+
+
+template<typename L, typename B>
+B const*
+read_record(Node_reader& r, Subterm_reader<L, B>& s, bool build)
+{
+  static_assert(L::size <= max_dispatch_kinds, "too many node kinds");
+  std::uint64_t k = r.read_uint();
+
+#define lingo_read_case(K) \
+  case K: return read_kind<K>(r, s, build, L());
+
+  switch (k) {
+    lingo_read_case(0)  lingo_read_case(1)  lingo_read_case(2)  lingo_read_case(3)
+    lingo_read_case(4)  lingo_read_case(5)  lingo_read_case(6)  lingo_read_case(7)
+    lingo_read_case(8)  lingo_read_case(9)  lingo_read_case(10) lingo_read_case(11)
+    lingo_read_case(12) lingo_read_case(13) lingo_read_case(14) lingo_read_case(15)
+    lingo_read_case(16) lingo_read_case(17) lingo_read_case(18) lingo_read_case(19)
+    lingo_read_case(20) lingo_read_case(21) lingo_read_case(22) lingo_read_case(23)
+    lingo_read_case(24) lingo_read_case(25) lingo_read_case(26) lingo_read_case(27)
+    lingo_read_case(28) lingo_read_case(29) lingo_read_case(30) lingo_read_case(31)
+    lingo_read_case(32) lingo_read_case(33) lingo_read_case(34) lingo_read_case(35)
+    lingo_read_case(36) lingo_read_case(37) lingo_read_case(38) lingo_read_case(39)
+    lingo_read_case(40) lingo_read_case(41) lingo_read_case(42) lingo_read_case(43)
+    lingo_read_case(44) lingo_read_case(45) lingo_read_case(46) lingo_read_case(47)
+    lingo_read_case(48) lingo_read_case(49) lingo_read_case(50) lingo_read_case(51)
+    lingo_read_case(52) lingo_read_case(53) lingo_read_case(54) lingo_read_case(55)
+    lingo_read_case(56) lingo_read_case(57) lingo_read_case(58) lingo_read_case(59)
+    lingo_read_case(60) lingo_read_case(61) lingo_read_case(62) lingo_read_case(63)
+  }
+
+#undef lingo_read_case
+
+  throw std::runtime_error("malformed tree file");
+}
+
+} // namespace serialize_impl
+
+
+void save_tree_file(Path const&, Node_writer const&);
+
+
+// Write the tree rooted at t to the file at p. L is the node list
+// of the hierarchy whose base is T (see dispatch.hpp). Throws
+// std::runtime_error if the file cannot be written.
+template<typename L, typename T>
+void
+save_tree(Path const& p, T const* t)
+{
+  // Order the nodes so that each follows its children. A node is
+  // pushed twice: first to push its children, and then to write it.
+  Node_writer w;
+  std::vector<std::pair<T const*, bool>> stack;
+  std::vector<T const*> kids;
+  std::unordered_map<T const*, bool> seen;
+  if (is_valid_node(t))
+    stack.emplace_back(t, false);
+  while (!stack.empty()) {
+    std::pair<T const*, bool> x = stack.back();
+    stack.pop_back();
+    if (x.second) {
+      w.start_node(x.first);
+      dispatch<L>(x.first, serialize_impl::Write_fn<T>{w});
+      continue;
+    }
+    if (!seen.emplace(x.first, true).second)
+      continue;
+    stack.emplace_back(x.first, true);
+    kids.clear();
+    traversal_impl::push_children<L>(kids, x.first);
+    for (T const* k : kids)
+      stack.emplace_back(k, false);
+  }
+  save_tree_file(p, w);
+}
+
+
+// The image of a tree file. The file is mapped, and its symbols
+// are interned when it is opened. The index and records of its
+// nodes are read directly from the mapping.
+//
+// If the file does not exist or is malformed, the image is invalid
+// and has no nodes.
+class Tree_image
+{
+public:
+  using Index = Node_reader::Index;
+
+  Tree_image(Path const&, Symbol_table&);
+
+  explicit operator bool() const { return ok_; }
+
+  Index       size() const { return nodes_; }
+  Node_reader reader(Index) const;
+
+private:
+  bool open(Symbol_table&);
+
+  File_mapping               map_;
+  bool                       ok_;
+  Index                      nodes_;
+  std::uint32_t const*       offsets_;
+  char const*                data_;
+  std::size_t                size_;
+  std::vector<Symbol const*> syms_;
+};
+
+
+// A loaded tree. L is the node list of the hierarchy whose base
+// is T. Each node is built the first time it, or a node that
+// contains it, is requested. Nodes are allocated in the current
+// arena (see load_node).
+//
+// If the file does not exist or is malformed, the tree is invalid
+// and has no nodes. Building a node throws std::runtime_error if its
+// record is malformed.
+template<typename L, typename T>
+class Tree_file
+{
+public:
+  using Index = Node_reader::Index;
+
+  Tree_file(Path const& p, Symbol_table& syms)
+    : image_(p, syms), nodes_(image_.size(), nullptr)
+  { }
+
+  explicit operator bool() const { return bool(image_); }
+
+  std::size_t size() const { return nodes_.size(); }
+  T const*    node(Index);
+  T const*    root()       { return size() ? node(size() - 1) : nullptr; }
+
+private:
+  Tree_image            image_;
+  std::vector<T const*> nodes_;
+};
+
+
+// Returns the node n, building it and its sub-terms if needed.
+template<typename L, typename T>
+T const*
+Tree_file<L, T>::node(Index n)
+{
+  lingo_assert(n < nodes_.size());
+
+  // Each node refers only to nodes that precede it. The sub-terms
+  // of a node are built before it, using an explicit stack.
+  std::vector<Index> stack {n};
+  std::vector<Index> missing;
+  serialize_impl::Subterm_reader<L, T> s {nodes_, missing};
+  while (!stack.empty()) {
+    Index i = stack.back();
+    if (nodes_[i]) {
+      stack.pop_back();
+      continue;
+    }
+    Node_reader r = image_.reader(i);
+    missing.clear();
+    serialize_impl::read_record(r, s, false);
+    if (missing.empty()) {
+      r = image_.reader(i);
+      nodes_[i] = serialize_impl::read_record(r, s, true);
+      stack.pop_back();
+    } else {
+      stack.insert(stack.end(), missing.begin(), missing.end());
+    }
+  }
+  return nodes_[n];
+}
+
+
+} // namespace lingo
+
+#endif
@@ -0,0 +1,267 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_SMALL_MAP_HPP
+#define LINGO_SMALL_MAP_HPP
+
+// The small map module provides an associative container for maps
+// that are usually small, like the substitution of an argument for
+// a parameter or the bindings of a local scope. Up to N entries are
+// stored in an array inside the map, and found by linear search,
+// so that such maps never allocate. A map that grows beyond N
+// entries moves them into a hash table.
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                               Small maps
+
+// A map from keys K to values V that stores up to N entries in
+// place. Keys are compared by equality; H hashes them once the map
+// is large. The interface is a subset of that of unordered_map.
+// Inserting into, or erasing from, a map invalidates its iterators.
+template<typename K, typename V, std::size_t N = 8, typename H = std::hash<K>>
+class Small_map
+{
+  using Map = std::unordered_map<K, V, H>;
+
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using value_type = std::pair<K const, V>;
+  using size_type = std::size_t;
+
+  // An iterator refers to an entry in the array, or (if the array
+  // pointer is null) to an entry in the hash table.
+  template<typename P, typename I>
+  struct Iter
+  {
+    using value_type = typename Small_map::value_type;
+    using reference = P&;
+    using pointer = P*;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    Iter(P* p)
+      : p(p), i()
+    { }
+
+    Iter(I i)
+      : p(nullptr), i(i)
+    { }
+
+    template<typename Q, typename J>
+    Iter(Iter<Q, J> const& x)
+      : p(x.p), i(x.i)
+    { }
+
+    P& operator*() const  { return p ? *p : *i; }
+    P* operator->() const { return &**this; }
+
+    Iter& operator++()
+    {
+      if (p)
+        ++p;
+      else
+        ++i;
+      return *this;
+    }
+
+    Iter operator++(int)
+    {
+      Iter x = *this;
+      ++*this;
+      return x;
+    }
+
+    bool operator==(Iter const& x) const { return p == x.p && (p || i == x.i); }
+    bool operator!=(Iter const& x) const { return !(*this == x); }
+
+    P* p;
+    I  i;
+  };
+
+  using iterator = Iter<value_type, typename Map::iterator>;
+  using const_iterator = Iter<value_type const, typename Map::const_iterator>;
+
+  Small_map()
+    : n_(0)
+  { }
+
+  Small_map(std::initializer_list<value_type> list)
+    : n_(0)
+  {
+    for (value_type const& x : list)
+      insert(x);
+  }
+
+  Small_map(Small_map const& x)
+    : n_(0)
+  {
+    for (value_type const& y : x)
+      insert(y);
+  }
+
+  Small_map(Small_map&& x)
+    : n_(0), big_(std::move(x.big_))
+  {
+    for (std::size_t i = 0; i < x.n_; ++i)
+      new (slot(i)) value_type(std::move(*x.slot(i)));
+    n_ = x.n_;
+    x.clear();
+  }
+
+  ~Small_map() { clear(); }
+
+  Small_map& operator=(Small_map const& x)
+  {
+    if (this != &x) {
+      clear();
+      for (value_type const& y : x)
+        insert(y);
+    }
+    return *this;
+  }
+
+  Small_map& operator=(Small_map&& x)
+  {
+    if (this != &x) {
+      clear();
+      big_ = std::move(x.big_);
+      for (std::size_t i = 0; i < x.n_; ++i)
+        new (slot(i)) value_type(std::move(*x.slot(i)));
+      n_ = x.n_;
+      x.clear();
+    }
+    return *this;
+  }
+
+  // Returns true if the entries are in the hash table.
+  bool is_large() const { return big_ != nullptr; }
+
+  size_type size() const { return big_ ? big_->size() : n_; }
+  bool      empty() const { return size() == 0; }
+
+  iterator       begin()       { return big_ ? iterator(big_->begin()) : iterator(slot(0)); }
+  iterator       end()         { return big_ ? iterator(big_->end()) : iterator(slot(n_)); }
+  const_iterator begin() const { return big_ ? const_iterator(cbig()->begin()) : const_iterator(slot(0)); }
+  const_iterator end() const   { return big_ ? const_iterator(cbig()->end()) : const_iterator(slot(n_)); }
+
+  iterator       find(K const&);
+  const_iterator find(K const& k) const { return const_cast<Small_map*>(this)->find(k); }
+  size_type      count(K const& k) const { return find(k) != end(); }
+
+  std::pair<iterator, bool> insert(value_type const&);
+
+  template<typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args)
+  {
+    return insert(value_type(std::forward<Args>(args)...));
+  }
+
+  size_type erase(K const&);
+  void      clear();
+
+private:
+  value_type*       slot(std::size_t i)       { return reinterpret_cast<value_type*>(&buf_[i]); }
+  value_type const* slot(std::size_t i) const { return reinterpret_cast<value_type const*>(&buf_[i]); }
+  Map const*        cbig() const              { return big_.get(); }
+
+  using Storage = typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type;
+
+  std::size_t          n_;
+  Storage              buf_[N];
+  std::unique_ptr<Map> big_;
+};
+
+
+template<typename K, typename V, std::size_t N, typename H>
+auto
+Small_map<K, V, N, H>::find(K const& k) -> iterator
+{
+  if (big_)
+    return big_->find(k);
+  for (std::size_t i = 0; i < n_; ++i)
+    if (slot(i)->first == k)
+      return slot(i);
+  return end();
+}
+
+
+// Insert x if its key is not in the map. Returns an iterator to the
+// entry with that key, and true if x was inserted. When the array is
+// full, its entries are moved into a hash table.
+template<typename K, typename V, std::size_t N, typename H>
+auto
+Small_map<K, V, N, H>::insert(value_type const& x) -> std::pair<iterator, bool>
+{
+  if (big_) {
+    auto ins = big_->insert(x);
+    return {ins.first, ins.second};
+  }
+  iterator iter = find(x.first);
+  if (iter != end())
+    return {iter, false};
+  if (n_ < N) {
+    new (slot(n_)) value_type(x);
+    return {slot(n_++), true};
+  }
+  std::unique_ptr<Map> m(new Map(2 * N));
+  for (std::size_t i = 0; i < n_; ++i)
+    m->emplace(std::move(*slot(i)));
+  clear();
+  big_ = std::move(m);
+  auto ins = big_->insert(x);
+  return {ins.first, true};
+}
+
+
+// Remove the entry with key k, if any. Returns the number of entries
+// removed. The last entry of the array takes the place of the
+// removed entry.
+template<typename K, typename V, std::size_t N, typename H>
+auto
+Small_map<K, V, N, H>::erase(K const& k) -> size_type
+{
+  if (big_)
+    return big_->erase(k);
+  for (std::size_t i = 0; i < n_; ++i) {
+    if (slot(i)->first == k) {
+      slot(i)->~value_type();
+      if (i != --n_) {
+        new (slot(i)) value_type(std::move(*slot(n_)));
+        slot(n_)->~value_type();
+      }
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+// Remove all entries. The map is small again.
+template<typename K, typename V, std::size_t N, typename H>
+void
+Small_map<K, V, N, H>::clear()
+{
+  big_.reset();
+  for (std::size_t i = 0; i < n_; ++i)
+    slot(i)->~value_type();
+  n_ = 0;
+}
+
+
+} // namespace lingo
+
+#endif
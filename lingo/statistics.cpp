@@ -0,0 +1,244 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "statistics.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace lingo
+{
+
+namespace
+{
+
+constexpr std::size_t no_limit = std::numeric_limits<std::size_t>::max();
+
+
+// Add the counts of now less those of start to the counts of s.
+void
+merge(Evaluation_stats& s, Evaluation_stats const& now, Evaluation_stats const& start)
+{
+  s.evaluations += now.evaluations - start.evaluations;
+  s.steps += now.steps - start.steps;
+  s.reductions += now.reductions - start.reductions;
+  s.substitutions += now.substitutions - start.substitutions;
+  s.allocations += now.allocations - start.allocations;
+  s.lex_time += now.lex_time - start.lex_time;
+  s.parse_time += now.parse_time - start.parse_time;
+  s.eval_time += now.eval_time - start.eval_time;
+}
+
+
+// Enter the shared evaluation e in the thread whose state is s and
+// which has taken n steps. If the evaluation has a budget, it is
+// checked at the next step.
+void
+join(Evaluation_state& s, Shared_evaluation& e, std::size_t n)
+{
+  s.shared = &e;
+  s.charged = n;
+  s.limit = e.timed || e.last != no_limit - 1 ? n : no_limit;
+}
+
+
+// Restore the state s of the thread, which has taken n steps, when
+// it leaves a shared evaluation. Within an evaluation, the budget is
+// checked at the next step.
+void
+restore(Evaluation_state& s, Evaluation_state const& saved, std::size_t n)
+{
+  s = saved;
+  s.limit = s.depth || s.shared ? n : no_limit;
+}
+
+
+// Charge the steps of the thread whose state is s to its shared
+// evaluation, and check the budget of that evaluation.
+void
+check_shared_budget(Evaluation_state& s, std::size_t n)
+{
+  Shared_evaluation& e = *s.shared;
+  std::size_t total = e.steps.fetch_add(n - s.charged) + (n - s.charged);
+  s.charged = n;
+  if (total > e.last)
+    throw Budget_exceeded("evaluation exceeded its step budget");
+  if (e.timed && Evaluation_state::Clock::now() > e.deadline)
+    throw Budget_exceeded("evaluation exceeded its time budget");
+  s.limit = n + std::min(e.last - total + 1, budget_check_interval);
+}
+
+} // namespace
+
+
+namespace statistics_impl
+{
+
+thread_local Evaluation_stats stats;
+thread_local Evaluation_state state {no_limit, no_limit, {}, {}, false, 0, nullptr, 0};
+
+} // namespace statistics_impl
+
+
+void
+reset_evaluation_stats()
+{
+  evaluation_stats() = Evaluation_stats();
+}
+
+
+std::ostream&
+operator<<(std::ostream& os, Evaluation_stats const& s)
+{
+  os << "evaluations:   " << s.evaluations << '\n';
+  os << "steps:         " << s.steps << '\n';
+  os << "reductions:    " << s.reductions << '\n';
+  os << "substitutions: " << s.substitutions << '\n';
+  os << "allocations:   " << s.allocations << '\n';
+  os << "lex time:      " << s.lex_time << "s\n";
+  os << "parse time:    " << s.parse_time << "s\n";
+  os << "eval time:     " << s.eval_time << "s\n";
+  return os;
+}
+
+
+// Returns the budget of evaluations.
+Evaluation_budget&
+evaluation_budget()
+{
+  static Evaluation_budget b;
+  return b;
+}
+
+
+// Sets the evaluation budget from a command-line option of the form
+// --steps=n or --seconds=s. Returns false if the option is not one
+// of those, or its value is invalid.
+bool
+set_evaluation_budget(char const* opt)
+{
+  char* end;
+  if (std::strncmp(opt, "--steps=", 8) == 0) {
+    unsigned long long n = std::strtoull(opt + 8, &end, 10);
+    if (end == opt + 8 || *end)
+      return false;
+    evaluation_budget().steps = n;
+    return true;
+  }
+  if (std::strncmp(opt, "--seconds=", 10) == 0) {
+    double s = std::strtod(opt + 10, &end);
+    if (end == opt + 10 || *end || s < 0)
+      return false;
+    evaluation_budget().seconds = s;
+    return true;
+  }
+  return false;
+}
+
+
+// Called when the step count reaches the limit of the current
+// evaluation: either the step budget is exhausted, or it is time
+// to check the clock.
+void
+check_evaluation_budget()
+{
+  Evaluation_state& s = evaluation_state();
+  std::size_t n = evaluation_stats().steps;
+  if (s.shared)
+    return check_shared_budget(s, n);
+  if (n > s.last)
+    throw Budget_exceeded("evaluation exceeded its step budget");
+  if (s.timed && Evaluation_state::Clock::now() > s.deadline)
+    throw Budget_exceeded("evaluation exceeded its time budget");
+  s.limit = s.last + 1;
+  if (s.timed)
+    s.limit = std::min(s.limit, n + budget_check_interval);
+}
+
+
+Evaluation_guard::Evaluation_guard()
+{
+  Evaluation_state& s = evaluation_state();
+  if (s.depth++)
+    return;
+  Evaluation_budget const& b = evaluation_budget();
+  std::size_t n = evaluation_stats().steps;
+  s.start = Evaluation_state::Clock::now();
+  s.last = b.steps ? std::min(n + b.steps, no_limit - 1) : no_limit - 1;
+  s.timed = b.seconds > 0;
+  if (s.timed)
+    s.deadline = s.start + std::chrono::duration_cast<Evaluation_state::Clock::duration>(
+      std::chrono::duration<double>(b.seconds));
+  s.limit = s.last + 1;
+  if (s.timed)
+    s.limit = std::min(s.limit, n + budget_check_interval);
+}
+
+
+Evaluation_guard::~Evaluation_guard()
+{
+  Evaluation_state& s = evaluation_state();
+  if (--s.depth)
+    return;
+  Evaluation_stats& st = evaluation_stats();
+  st.eval_time += std::chrono::duration<double>(Evaluation_state::Clock::now() - s.start).count();
+  ++st.evaluations;
+  s.limit = no_limit;
+}
+
+
+// Share the current evaluation of this thread, if any. Outside of
+// an evaluation, the work of other threads is counted but not
+// limited.
+Shared_evaluation::Shared_evaluation()
+  : steps(evaluation_stats().steps), last(no_limit - 1), timed(false)
+{
+  Evaluation_state& s = evaluation_state();
+  if (s.depth) {
+    last = s.last;
+    timed = s.timed;
+    deadline = s.deadline;
+  }
+  saved = s;
+  join(s, *this, steps);
+}
+
+
+Shared_evaluation::~Shared_evaluation()
+{
+  Evaluation_stats& st = evaluation_stats();
+  merge(st, counts, Evaluation_stats());
+  restore(evaluation_state(), saved, st.steps);
+}
+
+
+// Work done by this thread within the shared evaluation is nested
+// in it.
+Shared_evaluation_guard::Shared_evaluation_guard(Shared_evaluation& e)
+  : shared(e), start(evaluation_stats()), saved(evaluation_state())
+{
+  Evaluation_state& s = evaluation_state();
+  ++s.depth;
+  join(s, e, start.steps);
+}
+
+
+Shared_evaluation_guard::~Shared_evaluation_guard()
+{
+  Evaluation_stats& st = evaluation_stats();
+  shared.steps += st.steps - evaluation_state().charged;
+  {
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    merge(shared.counts, st, start);
+  }
+  st = start;
+  restore(evaluation_state(), saved, st.steps);
+}
+
+
+} // namespace lingo
@@ -0,0 +1,260 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_STATISTICS_HPP
+#define LINGO_STATISTICS_HPP
+
+// The statistics module counts the work done by evaluators, limits
+// the work done by each evaluation, and times the phases of a
+// program. Counters are maintained per thread, and the budget is
+// shared by all threads. The work of several threads can be charged
+// to one evaluation (see Shared_evaluation).
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <mutex>
+#include <stdexcept>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+//                               Counters
+
+// Counts the work done by evaluations, and the time spent in each
+// phase of processing. Times are in seconds.
+struct Evaluation_stats
+{
+  Evaluation_stats()
+    : evaluations(0), steps(0), reductions(0), substitutions(0), allocations(0)
+    , lex_time(0), parse_time(0), eval_time(0)
+  { }
+
+  std::size_t evaluations;   // Completed or aborted evaluations
+  std::size_t steps;         // Steps of evaluation, of any kind
+  std::size_t reductions;    // Beta reductions
+  std::size_t substitutions; // Variables replaced by substitution
+  std::size_t allocations;   // Objects created by evaluation
+  double      lex_time;
+  double      parse_time;
+  double      eval_time;
+};
+
+
+namespace statistics_impl
+{
+
+extern thread_local Evaluation_stats stats;
+
+} // namespace statistics_impl
+
+
+// Returns the counters of the current thread.
+inline Evaluation_stats&
+evaluation_stats()
+{
+  return statistics_impl::stats;
+}
+
+
+void reset_evaluation_stats();
+
+std::ostream& operator<<(std::ostream&, Evaluation_stats const&);
+
+
+// -------------------------------------------------------------------------- //
+//                               Budgets
+
+// Limits the number of steps taken by, and the time spent in, each
+// evaluation. A limit of 0 is unlimited. The budget is set for all
+// threads, before evaluations start.
+struct Evaluation_budget
+{
+  Evaluation_budget()
+    : steps(0), seconds(0)
+  { }
+
+  std::size_t steps;
+  double      seconds;
+};
+
+
+Evaluation_budget& evaluation_budget();
+bool               set_evaluation_budget(char const*);
+
+
+// Thrown when an evaluation exceeds its budget.
+struct Budget_exceeded : std::runtime_error
+{
+  using std::runtime_error::runtime_error;
+};
+
+
+// The number of steps between checks of the time budget.
+constexpr std::size_t budget_check_interval = 1024;
+
+
+struct Shared_evaluation;
+
+
+// Evaluation state for the current thread.
+struct Evaluation_state
+{
+  using Clock = std::chrono::steady_clock;
+
+  std::size_t        limit;   // The step at which to check the budget
+  std::size_t        last;    // The last step allowed by the budget
+  Clock::time_point  start;
+  Clock::time_point  deadline;
+  bool               timed;
+  int                depth;   // Nested evaluations
+  Shared_evaluation* shared;  // The evaluation shared with other threads
+  std::size_t        charged; // Steps charged to the shared evaluation
+};
+
+
+namespace statistics_impl
+{
+
+extern thread_local Evaluation_state state;
+
+} // namespace statistics_impl
+
+
+inline Evaluation_state&
+evaluation_state()
+{
+  return statistics_impl::state;
+}
+
+
+void check_evaluation_budget();
+
+
+// An evaluation guard starts an evaluation for its lifetime. The
+// steps counted and the time spent are charged against the budget
+// of the outermost evaluation. Nested guards have no effect.
+struct Evaluation_guard
+{
+  Evaluation_guard();
+  ~Evaluation_guard();
+};
+
+
+// A shared evaluation lets other threads work on the evaluation of
+// the thread that creates it. Each of those threads enters it with
+// a Shared_evaluation_guard. The steps of all threads are charged to
+// the budget of that evaluation, and when the shared evaluation is
+// destroyed, the counts of the other threads are added to those of
+// its thread. Those threads must have left it by then.
+//
+//    Shared_evaluation shared;
+//    std::thread t([&]() {
+//      Shared_evaluation_guard g(shared);
+//      ... // Evaluate
+//    });
+//    ... // Evaluate
+//    t.join();
+//
+// Steps are charged at most budget_check_interval at a time, so the
+// threads may take a few more steps than the budget allows before
+// the evaluation is stopped.
+struct Shared_evaluation
+{
+  using Clock = Evaluation_state::Clock;
+
+  Shared_evaluation();
+  ~Shared_evaluation();
+
+  Shared_evaluation(Shared_evaluation const&) = delete;
+  Shared_evaluation& operator=(Shared_evaluation const&) = delete;
+
+  std::atomic<std::size_t> steps;    // Steps charged by all threads
+  std::size_t              last;     // The last step allowed by the budget
+  Clock::time_point        deadline;
+  bool                     timed;
+  std::mutex               mutex;
+  Evaluation_stats         counts;   // Counts of the other threads
+  Evaluation_state         saved;    // State of the creating thread
+};
+
+
+// Enters a shared evaluation in the current thread for its lifetime.
+// The counts of the thread while in the evaluation are moved to the
+// shared evaluation when it leaves.
+struct Shared_evaluation_guard
+{
+  Shared_evaluation_guard(Shared_evaluation&);
+  ~Shared_evaluation_guard();
+
+  Shared_evaluation& shared;
+  Evaluation_stats   start;
+  Evaluation_state   saved;
+};
+
+
+// Count a step of evaluation. Throws Budget_exceeded if the current
+// evaluation has exceeded its budget.
+inline void
+count_step()
+{
+  if (++evaluation_stats().steps >= evaluation_state().limit)
+    check_evaluation_budget();
+}
+
+
+// Count a beta reduction, which is also a step.
+inline void
+count_reduction()
+{
+  ++evaluation_stats().reductions;
+  count_step();
+}
+
+
+inline void
+count_substitution()
+{
+  ++evaluation_stats().substitutions;
+}
+
+
+inline void
+count_allocation()
+{
+  ++evaluation_stats().allocations;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                                Timers
+
+// A phase timer adds the time of its lifetime to a total.
+//
+//    {
+//      Phase_timer t(evaluation_stats().parse_time);
+//      ... // Parse
+//    }
+struct Phase_timer
+{
+  using Clock = std::chrono::steady_clock;
+
+  Phase_timer(double& t)
+    : total(t), start(Clock::now())
+  { }
+
+  ~Phase_timer()
+  {
+    total += std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  double&           total;
+  Clock::time_point start;
+};
+
+
+} // namespace lingo
+
+#endif
@@ -4,8 +4,14 @@
 #include "config.hpp"
 
 #include "lingo/string.hpp"
+#include "lingo/memory.hpp"
 
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 namespace lingo
 {
@@ -23,17 +29,389 @@ operator<<(std::ostream& os, String_view s)
 }
 
 
-// Returns the a hash value for the characters in the symbol.
-// Adapted from an algorithm in Stroustrup's book (not sure
-// which, found the reference on StackOverflow).
+namespace
+{
+
+// Constants for the string hash function.
+constexpr std::uint64_t hash_k0 = 0xa0761d6478bd642full;
+constexpr std::uint64_t hash_k1 = 0xe7037ed1a0b428dbull;
+constexpr std::uint64_t hash_k2 = 0x8ebc6af09c88c6e3ull;
+constexpr std::uint64_t hash_k3 = 0x589965cc75374cc3ull;
+
+
+// Returns the 128-bit product of a and b, folded to 64 bits.
+inline std::uint64_t
+hash_mix(std::uint64_t a, std::uint64_t b)
+{
+  unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+  return static_cast<std::uint64_t>(r) ^ static_cast<std::uint64_t>(r >> 64);
+}
+
+
+// Unaligned loads of 8 and 4 bytes.
+inline std::uint64_t
+hash_load8(char const* p)
+{
+  std::uint64_t n;
+  std::memcpy(&n, p, 8);
+  return n;
+}
+
+
+inline std::uint64_t
+hash_load4(char const* p)
+{
+  std::uint32_t n;
+  std::memcpy(&n, p, 4);
+  return n;
+}
+
+
+// Load 1 to 3 bytes as an integer.
+inline std::uint64_t
+hash_load3(char const* p, std::size_t n)
+{
+  unsigned char const* s = reinterpret_cast<unsigned char const*>(p);
+  return (std::uint64_t(s[0]) << 16) | (std::uint64_t(s[n >> 1]) << 8) | s[n - 1];
+}
+
+} // namespace
+
+
+// Returns a hash value for the n bytes starting at p. This is
+// the wyhash function. Keys of up to 16 bytes, which includes
+// most identifiers, are hashed with at most four loads, which
+// may overlap, and two multiplications. Longer keys are read
+// 16 or 48 bytes at a time.
+std::size_t
+hash_bytes(char const* p, std::size_t n)
+{
+  std::uint64_t seed = hash_mix(hash_k0, hash_k1);
+  std::uint64_t a;
+  std::uint64_t b;
+  if (n <= 16) {
+    if (n >= 4) {
+      std::size_t k = (n >> 3) << 2;
+      a = (hash_load4(p) << 32) | hash_load4(p + k);
+      b = (hash_load4(p + n - 4) << 32) | hash_load4(p + n - 4 - k);
+    } else if (n > 0) {
+      a = hash_load3(p, n);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    std::size_t i = n;
+    if (i > 48) {
+      std::uint64_t s1 = seed;
+      std::uint64_t s2 = seed;
+      do {
+        seed = hash_mix(hash_load8(p) ^ hash_k1, hash_load8(p + 8) ^ seed);
+        s1 = hash_mix(hash_load8(p + 16) ^ hash_k2, hash_load8(p + 24) ^ s1);
+        s2 = hash_mix(hash_load8(p + 32) ^ hash_k3, hash_load8(p + 40) ^ s2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= s1 ^ s2;
+    }
+    while (i > 16) {
+      seed = hash_mix(hash_load8(p) ^ hash_k1, hash_load8(p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+    a = hash_load8(p + i - 16);
+    b = hash_load8(p + i - 8);
+  }
+  unsigned __int128 r = static_cast<unsigned __int128>(a ^ hash_k1) * (b ^ seed);
+  a = static_cast<std::uint64_t>(r);
+  b = static_cast<std::uint64_t>(r >> 64);
+  return hash_mix(a ^ hash_k0 ^ n, b ^ hash_k1);
+}
+
+
+// Returns a hash value for the characters in the view.
 std::size_t
 String_view::hash() const
 {
-  std::size_t h = 0;
-  char const* p = first;
-  while (p != last)
-    h = h << 1 ^ *p++;
-  return h;
+  return hash_bytes(first, last - first);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                          Integer conversion
+
+namespace
+{
+
+// Returns true if all 8 bytes of x are decimal digits.
+inline bool
+are_decimal_digits(std::uint64_t x)
+{
+  std::uint64_t a = x & 0xf0f0f0f0f0f0f0f0ull;
+  std::uint64_t b = ((x + 0x0606060606060606ull) & 0xf0f0f0f0f0f0f0f0ull) >> 4;
+  return (a | b) == 0x3333333333333333ull;
+}
+
+
+// Returns the value of the 8 decimal digits in x, where the
+// first digit is in the lowest byte. Adjacent digits are
+// combined pairwise in three multiplications.
+inline std::uint64_t
+decimal_value(std::uint64_t x)
+{
+  x -= 0x3030303030303030ull;
+  x = (x * 10 + (x >> 8)) & 0x00ff00ff00ff00ffull;
+  x = (x * 100 + (x >> 16)) & 0x0000ffff0000ffffull;
+  x = (x * 10000 + (x >> 32)) & 0x00000000ffffffffull;
+  return x;
+}
+
+
+// Convert the decimal digits in [first, last) to n. Any 19
+// digits fit in 64 bits, so overflow is only checked for
+// longer sequences.
+Digits_status
+parse_decimal(char const* first, char const* last, std::uint64_t& r)
+{
+  char const* begin = first;
+  bool check = last - first > 19;
+  std::uint64_t n = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (last - first >= 8) {
+    std::uint64_t x;
+    std::memcpy(&x, first, 8);
+    if (!are_decimal_digits(x))
+      break;
+    if (!check) {
+      n = n * 100000000 + decimal_value(x);
+    } else {
+      if (__builtin_mul_overflow(n, std::uint64_t(100000000), &n))
+        return digits_overflow;
+      if (__builtin_add_overflow(n, decimal_value(x), &n))
+        return digits_overflow;
+    }
+    first += 8;
+  }
+
+  // Convert the last 1 to 7 digits of a long literal using the
+  // last 8 bytes, replacing the digits already converted by 0s.
+  std::size_t k = last - first;
+  if (k != 0 && k < 8 && first - begin >= 8 - std::ptrdiff_t(k)) {
+    static constexpr std::uint64_t pow10[8] = {
+      1, 10, 100, 1000, 10000, 100000, 1000000, 10000000
+    };
+    std::uint64_t x;
+    std::memcpy(&x, last - 8, 8);
+    unsigned shift = 8 * (8 - k);
+    x = (x >> shift << shift) | (0x3030303030303030ull >> (64 - shift));
+    if (are_decimal_digits(x)) {
+      if (!check) {
+        n = n * pow10[k] + decimal_value(x);
+      } else {
+        if (__builtin_mul_overflow(n, pow10[k], &n))
+          return digits_overflow;
+        if (__builtin_add_overflow(n, decimal_value(x), &n))
+          return digits_overflow;
+      }
+      first = last;
+    }
+  }
+#endif
+  for (; first != last; ++first) {
+    unsigned d = char_value(*first);
+    if (d >= 10)
+      return digits_invalid;
+    if (!check) {
+      n = n * 10 + d;
+    } else {
+      if (__builtin_mul_overflow(n, std::uint64_t(10), &n))
+        return digits_overflow;
+      if (__builtin_add_overflow(n, std::uint64_t(d), &n))
+        return digits_overflow;
+    }
+  }
+  r = n;
+  return digits_ok;
+}
+
+
+// Convert the hexadecimal digits in [first, last) to n. Blocks
+// of 8 digits are combined into 32 bits before being added to
+// the result, so overflow is checked once per block.
+Digits_status
+parse_hexadecimal(char const* first, char const* last, std::uint64_t& r)
+{
+  std::uint64_t n = 0;
+  while (last - first >= 8) {
+    std::uint32_t x = 0;
+    int bad = 0;
+    for (int i = 0; i < 8; ++i) {
+      int d = char_value(first[i]);
+      bad |= d & ~0xf;
+      x = x << 4 | (d & 0xf);
+    }
+    if (bad)
+      break;
+    if (n >> 32)
+      return digits_overflow;
+    n = n << 32 | x;
+    first += 8;
+  }
+  for (; first != last; ++first) {
+    int d = char_value(*first);
+    if (d >= 16)
+      return digits_invalid;
+    if (n >> 60)
+      return digits_overflow;
+    n = n << 4 | d;
+  }
+  r = n;
+  return digits_ok;
+}
+
+} // namespace
+
+
+// Convert the digits in [first, last) in base b to the unsigned
+// value n. The base must be 10 or 16. There must be at least
+// one digit, and the sequence shall not include a sign.
+Digits_status
+parse_digits(char const* first, char const* last, int b, std::uint64_t& n)
+{
+  lingo_assert(b == 10 || b == 16);
+  if (first == last)
+    return digits_invalid;
+  if (b == 10)
+    return parse_decimal(first, last, n);
+  else
+    return parse_hexadecimal(first, last, n);
+}
+
+
+// -------------------------------------------------------------------------- //
+//                          Interned strings
+
+namespace
+{
+
+// The string pool stores entries in fixed-size blocks that
+// never move, so entries can be read without a lock while
+// other threads intern new strings. The id of a string is the
+// index of its entry.
+//
+// The pool holds at most max_blocks * block_size strings.
+struct String_pool
+{
+  static constexpr std::uint32_t block_bits = 12;
+  static constexpr std::uint32_t block_size = 1u << block_bits;
+  static constexpr std::uint32_t max_blocks = 1u << 14;
+
+  using Map = std::unordered_map<String_view, std::uint32_t, String_view_hash, String_view_eq>;
+
+  String_pool();
+
+  std::uint32_t intern(String_view);
+  Interned_entry const& entry(std::uint32_t n) const;
+
+  mutable std::shared_timed_mutex mutex_;
+  Map                             ids_;
+  Arena                           chars_;
+  std::uint32_t                   count_;
+  std::atomic<Interned_entry*>    blocks_[max_blocks];
+};
+
+
+// Initialize the pool with the empty string, whose id is 0.
+String_pool::String_pool()
+  : count_(0)
+{
+  for (std::atomic<Interned_entry*>& b : blocks_)
+    b.store(nullptr, std::memory_order_relaxed);
+  intern(String_view("", ""));
+}
+
+
+// Returns the id of the string s, adding it to the pool if
+// needed.
+std::uint32_t
+String_pool::intern(String_view s)
+{
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    auto iter = ids_.find(s);
+    if (iter != ids_.end())
+      return iter->second;
+  }
+
+  std::lock_guard<std::shared_timed_mutex> lock(mutex_);
+  auto iter = ids_.find(s);
+  if (iter != ids_.end())
+    return iter->second;
+
+  std::uint32_t n = count_;
+  std::uint32_t b = n >> block_bits;
+  lingo_assert(b < max_blocks);
+  Interned_entry* block = blocks_[b].load(std::memory_order_relaxed);
+  if (!block) {
+    block = new Interned_entry[block_size];
+    blocks_[b].store(block, std::memory_order_release);
+  }
+
+  // Copy the characters into the pool.
+  char* str = static_cast<char*>(chars_.allocate(s.size() + 1, 1));
+  std::memcpy(str, s.begin(), s.size());
+  str[s.size()] = 0;
+
+  // Publish the entry. Readers only see the id after the lock
+  // is released, so the entry is visible to them.
+  Interned_entry& e = block[n & (block_size - 1)];
+  e.str = str;
+  e.len = s.size();
+  e.hash = s.hash();
+  ids_.emplace(String_view(str, str + s.size()), n);
+  ++count_;
+  return n;
+}
+
+
+inline Interned_entry const&
+String_pool::entry(std::uint32_t n) const
+{
+  Interned_entry const* block = blocks_[n >> block_bits].load(std::memory_order_acquire);
+  return block[n & (block_size - 1)];
+}
+
+
+// The string pool is created on first use. It is never
+// destroyed so that interned strings remain valid during
+// the destruction of other static objects.
+String_pool&
+string_pool()
+{
+  static String_pool* pool = new String_pool();
+  return *pool;
+}
+
+
+} // namespace
+
+
+Interned_string::Interned_string(String_view s)
+  : id_(string_pool().intern(s))
+{ }
+
+
+Interned_entry const&
+get_interned_entry(std::uint32_t n)
+{
+  return string_pool().entry(n);
+}
+
+
+std::ostream&
+operator<<(std::ostream& os, Interned_string s)
+{
+  return os << s.view();
 }
 
 
@@ -11,6 +11,7 @@
 
 #include <cstdint>
 #include <algorithm>
+#include <functional>
 #include <iosfwd>
 #include <iterator>
 #include <limits>
@@ -73,6 +74,98 @@ struct digits<char32_t>
 } // namespace
 
 
+// -------------------------------------------------------------------------- //
+//                         Character classes
+
+// The classes of characters in the basic character set. These
+// are bit flags; a character may be in several classes.
+enum Char_class : std::uint8_t
+{
+  space_class      = 0x01, // [ \t\n\v\f\r]
+  alpha_class      = 0x02, // [a-zA-Z]
+  digit_class      = 0x04, // [0-9]
+  hex_class        = 0x08, // [0-9a-fA-F]
+  identifier_class = 0x10, // [a-zA-Z0-9_]
+};
+
+
+// A table of the classes and digit values of each character.
+// Digit values are those of [0-9A-Z] in base 36, ignoring
+// case, and 0xff for all other characters. Characters outside
+// of the basic character set belong to no class.
+struct Char_table
+{
+  std::uint8_t cls[256];
+  std::uint8_t val[256];
+};
+
+
+constexpr Char_table
+make_char_table()
+{
+  Char_table t {};
+  for (int c = 0; c < 256; ++c) {
+    std::uint8_t k = 0;
+    std::uint8_t v = 0xff;
+    if (c == ' ' || (c >= '\t' && c <= '\r'))
+      k |= space_class;
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+      k |= alpha_class | identifier_class;
+    if (c >= '0' && c <= '9') {
+      k |= digit_class | hex_class | identifier_class;
+      v = c - '0';
+    }
+    if (c >= 'a' && c <= 'z')
+      v = c - 'a' + 10;
+    if (c >= 'A' && c <= 'Z')
+      v = c - 'A' + 10;
+    if ((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))
+      k |= hex_class;
+    if (c == '_')
+      k |= identifier_class;
+    t.cls[c] = k;
+    t.val[c] = v;
+  }
+  return t;
+}
+
+
+constexpr Char_table char_table = make_char_table();
+
+
+// Returns the classes of the character c.
+constexpr std::uint8_t
+char_class(char c)
+{
+  return char_table.cls[static_cast<unsigned char>(c)];
+}
+
+
+// Returns true if c is in any of the classes in the mask m.
+constexpr bool
+has_char_class(char c, std::uint8_t m)
+{
+  return char_class(c) & m;
+}
+
+
+// Returns the base-36 digit value of c, or 0xff if c is not a
+// digit in any base.
+constexpr int
+char_value(char c)
+{
+  return char_table.val[static_cast<unsigned char>(c)];
+}
+
+
+// -------------------------------------------------------------------------- //
+//                     Character predicates
+
+// Note that each predicate has an overload for char that
+// uses the character table. The generic versions use the
+// classic locale.
+
+
 // Returns true if c is the horizontal whitespace.
 // Note that vertical tabs and carriage returns
 // are considered horizontal white space.
@@ -84,6 +177,13 @@ is_space(CharT c)
 }
 
 
+inline bool
+is_space(char c)
+{
+  return has_char_class(c, space_class);
+}
+
+
 // Returns true if c is alphabetical.
 template<typename CharT>
 inline bool
@@ -93,6 +193,22 @@ is_alpha(CharT c)
 }
 
 
+inline bool
+is_alpha(char c)
+{
+  return has_char_class(c, alpha_class);
+}
+
+
+// Returns true if c can continue an identifier. That is, c
+// is a letter, digit, or underscore.
+inline bool
+is_identifier_char(char c)
+{
+  return has_char_class(c, identifier_class);
+}
+
+
 // Returns true if c is the newline character.
 template<typename CharT>
 inline bool
@@ -112,6 +228,14 @@ is_digit(CharT c, int base)
 }
 
 
+inline bool
+is_digit(char c, int base)
+{
+  lingo_assert(base > 0 && base <= 36);
+  return char_value(c) < base;
+}
+
+
 // Returns true if c is in the class [01].
 template<typename CharT>
 inline bool
@@ -139,6 +263,13 @@ is_decimal_digit(CharT c)
 }
 
 
+inline bool
+is_decimal_digit(char c)
+{
+  return has_char_class(c, digit_class);
+}
+
+
 // Returns true if c is a hexadecimal digit.
 template<typename CharT>
 inline bool
@@ -148,6 +279,13 @@ is_hexadecimal_digit(CharT c)
 }
 
 
+inline bool
+is_hexadecimal_digit(char c)
+{
+  return has_char_class(c, hex_class);
+}
+
+
 // Returns the integral value of character c in the specified base, or -1 if
 // c is not a valid digit.
 template<typename CharT>
@@ -162,6 +300,15 @@ digit_value(CharT c, int base)
 }
 
 
+inline int
+digit_value(char c, int base)
+{
+  lingo_assert(base > 0 && base <= 36);
+  int n = char_value(c);
+  return n < base ? n : -1;
+}
+
+
 // Returns the integer value of the string in [first, last),
 // which contains an integer representation in base b. If no
 // conversion could be performed, or if [first, last) contains
@@ -215,6 +362,68 @@ string_to_int(I first, I last, int b)
 }
 
 
+// The result of converting a sequence of digits.
+enum Digits_status
+{
+  digits_ok,        // The digits were converted
+  digits_invalid,   // A character is not a digit
+  digits_overflow,  // The value does not fit in 64 bits
+};
+
+
+Digits_status parse_digits(char const*, char const*, int, std::uint64_t&);
+
+
+// An overload of string_to_int for character ranges. Decimal
+// and hexadecimal literals are converted 8 digits at a time,
+// and overflow is detected exactly. Other bases and result
+// types wider than 64 bits use the general algorithm.
+template<typename T>
+T
+string_to_int(char const* first, char const* last, int b)
+{
+  static_assert(std::is_integral<T>::value, "");
+  if (sizeof(T) > sizeof(std::uint64_t) || (b != 10 && b != 16))
+    return string_to_int<T, char const*>(first, last, b);
+
+  bool neg = false;
+  if (first != last) {
+    if (*first == '+') {
+      ++first;
+    } else if (*first == '-') {
+      neg = true;
+      ++first;
+    }
+  }
+
+  std::uint64_t n;
+  switch (parse_digits(first, last, b, n)) {
+    case digits_ok:
+      break;
+    case digits_invalid:
+      throw std::invalid_argument("lingo::string_to_int");
+    case digits_overflow:
+      throw std::out_of_range("lingo::string_to_int");
+  }
+
+  using U = typename std::make_unsigned<T>::type;
+  U max = std::numeric_limits<T>::max();
+  if (!neg) {
+    if (n > max)
+      throw std::out_of_range("lingo::string_to_int");
+    return static_cast<T>(n);
+  }
+
+  // The magnitude of the least value of a signed type is one
+  // more than its greatest value.
+  if (n == 0)
+    return 0;
+  if (!std::is_signed<T>::value || n - 1 > max)
+    throw std::out_of_range("lingo::string_to_int");
+  return static_cast<T>(-static_cast<T>(n - 1) - 1);
+}
+
+
 // Returns the integer value of the null-terminated string str,
 // which contains an integer representation in base b. If no
 // conversion could be performed, or if str contains any
@@ -247,6 +456,10 @@ string_to_int(std::basic_string<CharT> const& str, int b)
 // -------------------------------------------------------------------------- //
 //                            String view
 
+// Returns a hash value for the n bytes starting at p.
+std::size_t hash_bytes(char const*, std::size_t);
+
+
 // A view of a string in a source file. A string view is
 // represented as a pair of pointers into text owned by
 // another object.
@@ -261,6 +474,10 @@ public:
     : first(s), last(s + std::char_traits<char>::length(s))
   { }
 
+  String_view(String const& s)
+    : first(s.data()), last(s.data() + s.size())
+  { }
+
   int size() const { return last - first; }
   std::size_t hash() const;
   std::string str() const { return {first, last}; }
@@ -331,6 +548,118 @@ struct String_view_eq
 };
 
 
+// -------------------------------------------------------------------------- //
+//                          Interned strings
+
+
+// An entry in the string pool. The characters of an interned
+// string are stored in the pool, followed by a null character.
+struct Interned_entry
+{
+  char const*   str;
+  std::uint32_t len;
+  std::size_t   hash;
+};
+
+
+Interned_entry const& get_interned_entry(std::uint32_t);
+
+
+// An interned string is a handle to a unique string in a global
+// string pool. The handle is a 32-bit id, so two interned strings
+// are equal exactly when their ids are, and the hash of the
+// string is computed only once, when it is interned. Access to
+// the characters does not copy them.
+//
+// The pool is never emptied, and it is safe to intern strings
+// from multiple threads. The default interned string is the
+// empty string.
+class Interned_string
+{
+public:
+  Interned_string()
+    : id_(0)
+  { }
+
+  explicit Interned_string(String_view);
+  explicit Interned_string(char const* s)
+    : Interned_string(String_view(s))
+  { }
+
+  std::uint32_t id() const { return id_; }
+
+  std::size_t hash() const { return entry().hash; }
+  int         size() const { return entry().len; }
+  bool        empty() const { return id_ == 0; }
+
+  char const* c_str() const { return entry().str; }
+  String_view view() const;
+  String      str() const;
+
+  char const* begin() const { return entry().str; }
+  char const* end() const { return begin() + size(); }
+
+private:
+  Interned_entry const& entry() const { return get_interned_entry(id_); }
+
+  std::uint32_t id_;
+};
+
+
+inline String_view
+Interned_string::view() const
+{
+  Interned_entry const& e = entry();
+  return {e.str, e.str + e.len};
+}
+
+
+inline String
+Interned_string::str() const
+{
+  Interned_entry const& e = entry();
+  return {e.str, e.len};
+}
+
+
+// Identity equality
+inline bool
+operator==(Interned_string a, Interned_string b)
+{
+  return a.id() == b.id();
+}
+
+
+inline bool
+operator!=(Interned_string a, Interned_string b)
+{
+  return a.id() != b.id();
+}
+
+
+// Interned strings are ordered by id, not lexicographically.
+inline bool
+operator<(Interned_string a, Interned_string b)
+{
+  return a.id() < b.id();
+}
+
+
+// Streaming
+std::ostream& operator<<(std::ostream&, Interned_string);
+
+
+// Returns the precomputed hash of an interned string.
+struct Interned_string_hash
+{
+  std::size_t
+  operator()(Interned_string s) const
+  {
+    return s.hash();
+  }
+};
+
+
 // -------------------------------------------------------------------------- //
 //                          String builder
 
@@ -347,8 +676,9 @@ class String_builder
 public:
   String_builder();
 
-  String str() const;
-  String take();
+  String      str() const;
+  String_view view() const;
+  String      take();
 
   void put(char c);
   void put(char const*);
@@ -371,9 +701,7 @@ String_builder::String_builder()
 }
 
 
-// FIXME: This should return a string view, but until
-// we can efficiently hash-compare a string view against
-// a string, it won't matter.
+// Returns a copy of the string in the builder.
 inline String
 String_builder::str() const
 {
@@ -381,6 +709,15 @@ String_builder::str() const
 }
 
 
+// Returns a view of the string in the builder. The view is
+// invalidated when the builder is modified.
+inline String_view
+String_builder::view() const
+{
+  return String_view(buf_, buf_ + len_);
+}
+
+
 // Return the string in the builder and then reset it.
 inline String
 String_builder::take()
@@ -429,7 +766,6 @@ String_builder::put(char const* first, char const* last)
 inline void
 String_builder::clear()
 {
-  std::fill(buf_, buf_ + init_size, 0);
   len_ = 0;
 }
 
@@ -445,6 +781,7 @@ class Stringbuf
 public:
   Stringbuf() = default;
   Stringbuf(String const&);
+  Stringbuf(String&&);
   Stringbuf(std::istream& is);
 
   void assign(std::istream& is);
@@ -465,6 +802,14 @@ Stringbuf::Stringbuf(String const& s)
 { }
 
 
+// Initialize the string buffer by taking the given
+// string. This does not copy the string.
+inline
+Stringbuf::Stringbuf(String&& s)
+  : buf_(std::move(s))
+{ }
+
+
 // Returns an iterator to the beginning of the string
 // buffer.
 inline char const*
@@ -484,4 +829,14 @@ Stringbuf::end() const
 
 } // namespace lingo
 
+
+namespace std
+{
+
+template<>
+struct hash<lingo::Interned_string> : lingo::Interned_string_hash
+{ };
+
+} // namespace std
+
 #endif
@@ -5,11 +5,27 @@
 
 #include "lingo/symbol.hpp"
 
+#include <atomic>
 #include <iostream>
 
 namespace lingo
 {
 
+namespace
+{
+
+// The id of the next symbol.
+std::atomic<std::uint32_t> next_id_(0);
+
+} // namespace
+
+
+std::uint32_t
+make_symbol_id()
+{
+  return next_id_.fetch_add(1, std::memory_order_relaxed);
+}
+
 
 std::ostream&
 operator<<(std::ostream& os, Symbol const& sym)
@@ -6,9 +6,13 @@
 
 #include <lingo/utility.hpp>
 #include <lingo/string.hpp>
+#include <lingo/memory.hpp>
 
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <typeinfo>
+#include <vector>
 
 namespace lingo
 {
@@ -27,25 +31,63 @@ struct Character_sym;
 struct String_sym;
 
 
+// Returns a new symbol id. Ids are allocated sequentially,
+// starting at 0, for all symbols in the program.
+std::uint32_t make_symbol_id();
+
+
 // The base class of all symbols of a language. By itself, this
 // class is capable of representing symbols that have no other
 // attributes. Examples include punctuators and operators.
+//
+// Each symbol has a dense id assigned when it is created.
+// Attributes of a symbol can be stored in a Symbol_attribute,
+// which is indexed by that id.
+//
+// The class of a symbol is stored with it, so that the derived
+// symbols can be recognized without dynamic_cast (see classof
+// in utility.hpp).
 struct Symbol
 {
   friend struct Symbol_table;
+  friend struct Concurrent_symbol_table;
+
+  // The classes of symbols.
+  enum Class
+  {
+    plain_sym,
+    identifier_sym,
+    boolean_sym,
+    integer_sym,
+    character_sym,
+    string_sym
+  };
 
   explicit Symbol(int k)
-    : str_(nullptr), tok_(k)
+    : str_(nullptr), tok_(k), cls_(plain_sym), id_(make_symbol_id())
+  { }
+
+  Symbol(int k, String const* s)
+    : str_(s), tok_(k), cls_(plain_sym), id_(make_symbol_id())
   { }
 
   virtual ~Symbol() { }
 
   String const& spelling() const { return *str_; }
   int           token() const    { return tok_; }
+  Class         cls() const      { return cls_; }
+  std::uint32_t id() const       { return id_; }
+
+protected:
+  Symbol(Class c, int k)
+    : str_(nullptr), tok_(k), cls_(c), id_(make_symbol_id())
+  { }
 
 private:
   String const* str_; // The textual representation.
   int           tok_; // The associated token kind.
+  Class         cls_; // The class of symbol.
+  std::uint32_t id_;  // The unique id of the symbol.
 };
 
 
@@ -55,8 +97,10 @@ private:
 struct Identifier_sym : Symbol
 {
   Identifier_sym(int k)
-    : Symbol(k)
+    : Symbol(identifier_sym, k)
   { }
+
+  static bool classof(Symbol const* s) { return s->cls() == identifier_sym; }
 };
 
 
@@ -64,9 +108,11 @@ struct Identifier_sym : Symbol
 struct Boolean_sym : Symbol
 {
   Boolean_sym(int k, bool b)
-    : Symbol(k), value_(b)
+    : Symbol(boolean_sym, k), value_(b)
   { }
 
+  static bool classof(Symbol const* s) { return s->cls() == boolean_sym; }
+
   bool value() const { return value_; }
 
   bool value_;
@@ -84,9 +130,11 @@ struct Boolean_sym : Symbol
 struct Integer_sym : Symbol
 {
   Integer_sym(int k, int n)
-    : Symbol(k), value_(n)
+    : Symbol(integer_sym, k), value_(n)
   { }
 
+  static bool classof(Symbol const* s) { return s->cls() == integer_sym; }
+
   int value() const { return value_; }
 
   int value_;
@@ -106,9 +154,11 @@ struct Integer_sym : Symbol
 struct Character_sym : Symbol
 {
   Character_sym(int k, int n)
-    : Symbol(k), value_(n)
+    : Symbol(character_sym, k), value_(n)
   { }
 
+  static bool classof(Symbol const* s) { return s->cls() == character_sym; }
+
   int value() const { return value_; }
 
   int value_;
@@ -124,9 +174,11 @@ struct Character_sym : Symbol
 struct String_sym : Symbol
 {
   String_sym(int k, String const& s)
-    : Symbol(k), value_(s)
+    : Symbol(string_sym, k), value_(s)
   { }
 
+  static bool classof(Symbol const* s) { return s->cls() == string_sym; }
+
   String const& value() const { return value_; }
 
   String value_;
@@ -137,6 +189,102 @@ struct String_sym : Symbol
 std::ostream& operator<<(std::ostream&, Symbol const&);
 
 
+// -------------------------------------------------------------------------- //
+//                         Symbol attributes
+
+
+// A symbol attribute associates a value of type T with
+// symbols. This is a side table indexed by symbol id, so
+// access is an array lookup. Symbols that have not been
+// given a value have the default value of the attribute.
+template<typename T>
+class Symbol_attribute
+{
+public:
+  explicit Symbol_attribute(T const& x = T())
+    : def_(x)
+  { }
+
+  bool has(Symbol const*) const;
+
+  T const& get(Symbol const*) const;
+  T const& operator[](Symbol const* s) const { return get(s); }
+  T&       operator[](Symbol const*);
+
+  void put(Symbol const*, T const&);
+  void reset(Symbol const*);
+  void clear();
+
+  T const& default_value() const { return def_; }
+
+private:
+  T              def_;
+  std::vector<T> vals_;
+};
+
+
+// Returns true if a value has been stored for s. Note that
+// this is only true if that value is not the default.
+template<typename T>
+inline bool
+Symbol_attribute<T>::has(Symbol const* s) const
+{
+  return s->id() < vals_.size() && !(vals_[s->id()] == def_);
+}
+
+
+// Returns the value of the attribute for s.
+template<typename T>
+inline T const&
+Symbol_attribute<T>::get(Symbol const* s) const
+{
+  if (s->id() < vals_.size())
+    return vals_[s->id()];
+  else
+    return def_;
+}
+
+
+// Returns a reference to the value of the attribute for s,
+// extending the table if needed.
+template<typename T>
+inline T&
+Symbol_attribute<T>::operator[](Symbol const* s)
+{
+  if (s->id() >= vals_.size())
+    vals_.resize(s->id() + 1, def_);
+  return vals_[s->id()];
+}
+
+
+// Set the value of the attribute for s.
+template<typename T>
+inline void
+Symbol_attribute<T>::put(Symbol const* s, T const& x)
+{
+  (*this)[s] = x;
+}
+
+
+// Restore the default value of the attribute for s.
+template<typename T>
+inline void
+Symbol_attribute<T>::reset(Symbol const* s)
+{
+  if (s->id() < vals_.size())
+    vals_[s->id()] = def_;
+}
+
+
+// Restore the default value for all symbols.
+template<typename T>
+inline void
+Symbol_attribute<T>::clear()
+{
+  vals_.clear();
+}
+
+
 // -------------------------------------------------------------------------- //
 //                           Symbol table
 
@@ -144,35 +292,33 @@ std::ostream& operator<<(std::ostream&, Symbol const&);
 // The symbol table maintains a mapping of
 // unique string values to their corresponding
 // symbols.
-struct Symbol_table : std::unordered_map<std::string, Symbol*>
+//
+// Symbols are found by the characters of their spelling,
+// so looking up a symbol does not allocate memory. The
+// spelling of a symbol is copied into the table only when
+// the symbol is first inserted. Both spellings and symbols
+// are allocated in an arena owned by the table.
+struct Symbol_table : std::unordered_map<String_view, Symbol*, String_view_hash, String_view_eq>
 {
-  ~Symbol_table();
-
   template<typename T, typename... Args>
-  Symbol* put(int, String const&, Args&&...);
+  Symbol* put(int, String_view, Args&&...);
 
   template<typename T, typename... Args>
   Symbol* put(int, char const*, char const*, Args&&...);
 
-  Symbol* put_symbol(int, String const&);
-  Symbol* put_identifier(int, String const&);
-  Symbol* put_boolean(int, String const&, bool);
-  Symbol* put_integer(int, String const&, int);
-  Symbol* put_character(int, String const&, int);
-  Symbol* put_string(int, String const&, String const&);
-
-  Symbol const* get(String const&) const;
-  Symbol const* get(char const*) const;
-};
+  Symbol* put_symbol(int, String_view);
+  Symbol* put_identifier(int, String_view);
+  Symbol* put_boolean(int, String_view, bool);
+  Symbol* put_integer(int, String_view, int);
+  Symbol* put_character(int, String_view, int);
+  Symbol* put_string(int, String_view, String const&);
 
+  Symbol const* get(String_view) const;
+  Symbol const* get(char const*, char const*) const;
 
-// Delete allocated resources.
-inline
-Symbol_table::~Symbol_table()
-{
-  for (auto const& x : *this)
-    delete x.second;
-}
+private:
+  Arena_factory storage_;
+};
 
 
 // Insert a new symbol into the table. The spelling of the symbol
@@ -187,18 +333,18 @@ Symbol_table::~Symbol_table()
 // symbol shall be the same as T.
 template<typename T, typename... Args>
 Symbol*
-Symbol_table::put(int k, String const& s, Args&&... args)
-{
-  auto x = emplace(s, nullptr);
-  auto iter = x.first;
-  Symbol*& sym = iter->second;
-  if (x.second) {
-    sym = new T(k, std::forward<Args>(args)...);
-    sym->str_ = &iter->first;
-  } else {
-    lingo_assert(is<T>(sym));
+Symbol_table::put(int k, String_view s, Args&&... args)
+{
+  auto iter = find(s);
+  if (iter != end()) {
+    lingo_assert(is<T>(iter->second));
+    return iter->second;
   }
-  return iter->second;
+  String const* str = storage_.make<String>(s.begin(), s.end());
+  Symbol* sym = storage_.make<T>(k, std::forward<Args>(args)...);
+  sym->str_ = str;
+  emplace(String_view(*str), sym);
+  return sym;
 }
 
 
@@ -208,41 +354,40 @@ template<typename T, typename... Args>
 inline Symbol*
 Symbol_table::put(int k, char const* first, char const* last, Args&&... args)
 {
-  String s(first, last);
-  return this->template put<T>(k, s, std::forward<Args>(args)...);
+  return this->template put<T>(k, String_view(first, last), std::forward<Args>(args)...);
 }
 
 
 inline Symbol*
-Symbol_table::put_symbol(int k, String const& s)
+Symbol_table::put_symbol(int k, String_view s)
 {
   return put<Symbol>(k, s);
 }
 
 
 inline Symbol*
-Symbol_table::put_identifier(int k, String const& s)
+Symbol_table::put_identifier(int k, String_view s)
 {
   return put<Identifier_sym>(k, s);
 }
 
 
 inline Symbol*
-Symbol_table::put_boolean(int k, String const& s, bool b)
+Symbol_table::put_boolean(int k, String_view s, bool b)
 {
   return put<Boolean_sym>(k, s, b);
 }
 
 
 inline Symbol*
-Symbol_table::put_integer(int k, String const& s, int n)
+Symbol_table::put_integer(int k, String_view s, int n)
 {
   return put<Integer_sym>(k, s, n);
 }
 
 
 inline Symbol*
-Symbol_table::put_character(int k, String const& s, int c)
+Symbol_table::put_character(int k, String_view s, int c)
 {
   return put<Integer_sym>(k, s, c);
 }
@@ -252,7 +397,7 @@ Symbol_table::put_character(int k, String const& s, int c)
 // character set is given in s1, and whose spelling in the
 // execution character set is given in s2.
 inline Symbol*
-Symbol_table::put_string(int k, String const& s1, String const& s2)
+Symbol_table::put_string(int k, String_view s1, String const& s2)
 {
   return put<String_sym>(k, s1, s2);
 }
@@ -261,7 +406,7 @@ Symbol_table::put_string(int k, String const& s1, String const& s2)
 // Returns the symbol with the given spelling or
 // nullptr if no such symbol exists.
 inline Symbol const*
-Symbol_table::get(String const& s) const
+Symbol_table::get(String_view s) const
 {
   auto iter = find(s);
   if (iter != end())
@@ -271,19 +416,222 @@ Symbol_table::get(String const& s) const
 }
 
 
-// Returns the symbol with the given spelling or
+// Returns the symbol with the spelling [first, last) or
 // nullptr if no such symbol exists.
 inline Symbol const*
-Symbol_table::get(char const* s) const
+Symbol_table::get(char const* first, char const* last) const
 {
-  auto iter = find(s);
-  if (iter != end())
+  return get(String_view(first, last));
+}
+
+
+// -------------------------------------------------------------------------- //
+//                      Concurrent symbol table
+
+
+// The concurrent symbol table is a symbol table that many
+// threads can search and insert into at once. Each spelling
+// still has exactly one symbol.
+//
+// The table is divided into shards selected by the hash of
+// a spelling. Each shard is guarded by a reader-writer lock
+// and owns the arena for its spellings and symbols. Lookups
+// of existing symbols take only a shared lock. Insertion takes
+// the exclusive lock and searches again before inserting. The
+// address of a symbol never changes, so tokens referring to
+// that symbol can be shared across threads.
+struct Concurrent_symbol_table
+{
+  // The number of shards. This must agree with the shift
+  // in index().
+  static constexpr std::size_t num_shards = 64;
+
+  template<typename T, typename... Args>
+  Symbol* put(int, String_view, Args&&...);
+
+  template<typename T, typename... Args>
+  Symbol* put(int, char const*, char const*, Args&&...);
+
+  Symbol* put_symbol(int, String_view);
+  Symbol* put_identifier(int, String_view);
+  Symbol* put_boolean(int, String_view, bool);
+  Symbol* put_integer(int, String_view, int);
+  Symbol* put_character(int, String_view, int);
+  Symbol* put_string(int, String_view, String const&);
+
+  Symbol const* get(String_view) const;
+  Symbol const* get(char const*, char const*) const;
+
+  std::size_t size() const;
+
+private:
+  using Map = std::unordered_map<String_view, Symbol*, String_view_hash, String_view_eq>;
+
+  // Shards are aligned to separate cache lines so that
+  // threads using different shards do not contend.
+  struct alignas(64) Shard
+  {
+    mutable std::shared_timed_mutex mutex;
+    Map                             map;
+    Arena_factory                   storage;
+  };
+
+  static std::size_t index(String_view);
+
+  Shard&       shard(String_view);
+  Shard const& shard(String_view) const;
+
+  Shard shards_[num_shards];
+};
+
+
+// Returns the index of the shard responsible for the spelling
+// s. The hash is scrambled by a multiplicative hash, and the
+// shard is selected by its high bits. The map in each shard
+// uses the low bits to select buckets.
+inline std::size_t
+Concurrent_symbol_table::index(String_view s)
+{
+  std::uint64_t h = s.hash() * 0x9e3779b97f4a7c15ull;
+  return h >> 58;
+}
+
+
+inline Concurrent_symbol_table::Shard&
+Concurrent_symbol_table::shard(String_view s)
+{
+  return shards_[index(s)];
+}
+
+
+inline Concurrent_symbol_table::Shard const&
+Concurrent_symbol_table::shard(String_view s) const
+{
+  return shards_[index(s)];
+}
+
+
+// Insert a new symbol into the table or return the existing
+// symbol with the spelling s. The requirements are the same
+// as for Symbol_table::put.
+template<typename T, typename... Args>
+Symbol*
+Concurrent_symbol_table::put(int k, String_view s, Args&&... args)
+{
+  Shard& sh = shard(s);
+
+  // Optimistically search for an existing symbol.
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(sh.mutex);
+    auto iter = sh.map.find(s);
+    if (iter != sh.map.end()) {
+      lingo_assert(is<T>(iter->second));
+      return iter->second;
+    }
+  }
+
+  // Another thread may have inserted the symbol after the
+  // shared lock was released, so search again.
+  std::lock_guard<std::shared_timed_mutex> lock(sh.mutex);
+  auto iter = sh.map.find(s);
+  if (iter != sh.map.end()) {
+    lingo_assert(is<T>(iter->second));
+    return iter->second;
+  }
+  String const* str = sh.storage.make<String>(s.begin(), s.end());
+  Symbol* sym = sh.storage.make<T>(k, std::forward<Args>(args)...);
+  sym->str_ = str;
+  sh.map.emplace(String_view(*str), sym);
+  return sym;
+}
+
+
+template<typename T, typename... Args>
+inline Symbol*
+Concurrent_symbol_table::put(int k, char const* first, char const* last, Args&&... args)
+{
+  return this->template put<T>(k, String_view(first, last), std::forward<Args>(args)...);
+}
+
+
+inline Symbol*
+Concurrent_symbol_table::put_symbol(int k, String_view s)
+{
+  return put<Symbol>(k, s);
+}
+
+
+inline Symbol*
+Concurrent_symbol_table::put_identifier(int k, String_view s)
+{
+  return put<Identifier_sym>(k, s);
+}
+
+
+inline Symbol*
+Concurrent_symbol_table::put_boolean(int k, String_view s, bool b)
+{
+  return put<Boolean_sym>(k, s, b);
+}
+
+
+inline Symbol*
+Concurrent_symbol_table::put_integer(int k, String_view s, int n)
+{
+  return put<Integer_sym>(k, s, n);
+}
+
+
+inline Symbol*
+Concurrent_symbol_table::put_character(int k, String_view s, int c)
+{
+  return put<Integer_sym>(k, s, c);
+}
+
+
+inline Symbol*
+Concurrent_symbol_table::put_string(int k, String_view s1, String const& s2)
+{
+  return put<String_sym>(k, s1, s2);
+}
+
+
+// Returns the symbol with the given spelling or nullptr if
+// no such symbol exists.
+inline Symbol const*
+Concurrent_symbol_table::get(String_view s) const
+{
+  Shard const& sh = shard(s);
+  std::shared_lock<std::shared_timed_mutex> lock(sh.mutex);
+  auto iter = sh.map.find(s);
+  if (iter != sh.map.end())
     return iter->second;
   else
     return nullptr;
 }
 
 
+inline Symbol const*
+Concurrent_symbol_table::get(char const* first, char const* last) const
+{
+  return get(String_view(first, last));
+}
+
+
+// Returns the number of symbols in the table. This is
+// only a snapshot when other threads are inserting.
+inline std::size_t
+Concurrent_symbol_table::size() const
+{
+  std::size_t n = 0;
+  for (Shard const& sh : shards_) {
+    std::shared_lock<std::shared_timed_mutex> lock(sh.mutex);
+    n += sh.map.size();
+  }
+  return n;
+}
+
+
 } // namespace lingo
 
 #endif
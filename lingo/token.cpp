@@ -23,4 +23,70 @@ operator<<(std::ostream& os, Token tok)
 }
 
 
+// Returns the index of the first token of kind k at or after
+// the nth token, or size() if there is none.
+std::size_t
+Token_store::find(std::size_t n, int k) const
+{
+  Kind x = k == invalid_tok ? invalid_kind : Kind(k);
+  auto iter = std::find(kinds_.begin() + n, kinds_.end(), x);
+  return iter - kinds_.begin();
+}
+
+
+// Returns the index of the token of kind close that matches
+// the nth token, which has kind open, or size() if it is not
+// matched. Brackets of other kinds are not considered.
+std::size_t
+Token_store::match(std::size_t n, int open, int close) const
+{
+  lingo_assert(kind(n) == open);
+  Kind const* p = kinds_.data();
+  std::size_t depth = 0;
+  for (std::size_t i = n; i != kinds_.size(); ++i) {
+    if (p[i] == open)
+      ++depth;
+    else if (p[i] == close && --depth == 0)
+      return i;
+  }
+  return kinds_.size();
+}
+
+
+// Read tokens from the source until the nth token past the current
+// position is buffered. Returns false if the source is exhausted
+// first, or if the stream has no source.
+bool
+Token_stream::fill(std::size_t n) const
+{
+  if (!src_)
+    return false;
+  discard();
+  while (pos_ - base_ + n >= buf_.size()) {
+    Token tok = src_();
+    if (!tok) {
+      src_ = nullptr;
+      return false;
+    }
+    buf_.push_back(tok);
+  }
+  return true;
+}
+
+
+// Discard the consumed tokens that are not held by a marker, when
+// there are at least as many as the window.
+void
+Token_stream::discard() const
+{
+  Position lo = pos_;
+  for (Position p : pins_)
+    lo = std::min(lo, p);
+  if (lo - base_ < window_)
+    return;
+  buf_.erase(buf_.begin(), buf_.begin() + (lo - base_));
+  base_ = lo;
+}
+
+
 } // namespace lingo
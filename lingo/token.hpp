@@ -6,9 +6,13 @@
 
 #include <lingo/symbol.hpp>
 #include <lingo/location.hpp>
+#include <lingo/profile.hpp>
 
-#include <list>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <iosfwd>
+#include <vector>
 
 namespace lingo
 {
@@ -165,66 +169,233 @@ std::ostream& operator<<(std::ostream&, Token);
 // Token buffer
 
 
-// A token buffer is a finite sequence of tokens. Note that tokens are
-// maintained in a linked list so that modifications during parsing won't
-// invalidate iterators.
-using Token_seq = std::list<Token>;
+// A token buffer is a finite sequence of tokens. Tokens are stored
+// contiguously. Token streams refer to tokens by their index in the
+// buffer, so appending tokens does not invalidate stream positions.
+using Token_seq = std::vector<Token>;
+
+
+// A token store is a sequence of tokens kept as separate arrays of
+// token kinds, source positions, and symbols. Scans that depend only
+// on the kinds of tokens, like matching brackets or skipping over a
+// declaration, touch only the array of kinds, at 2 bytes per token.
+// Indexing the store yields a Token.
+//
+// Token kinds must be in the range [0, 65535), or invalid_tok.
+class Token_store
+{
+public:
+  using Kind = std::uint16_t;
+
+  // The stored kind of invalid tokens.
+  static constexpr Kind invalid_kind = 0xffff;
+
+  std::size_t size() const  { return kinds_.size(); }
+  bool        empty() const { return kinds_.empty(); }
+
+  void reserve(std::size_t);
+  void push_back(Token);
+
+  Token operator[](std::size_t) const;
+
+  // Columns
+  Kind const*   kinds() const { return kinds_.data(); }
+  int           kind(std::size_t) const;
+  Location      location(std::size_t) const;
+  Symbol const* symbol(std::size_t) const;
+
+  // Kind scans
+  std::size_t find(std::size_t, int) const;
+  std::size_t match(std::size_t, int, int) const;
+
+private:
+  std::vector<Kind>               kinds_;
+  std::vector<Location::Position> positions_;
+  std::vector<Symbol const*>      symbols_;
+};
+
+
+inline void
+Token_store::reserve(std::size_t n)
+{
+  kinds_.reserve(n);
+  positions_.reserve(n);
+  symbols_.reserve(n);
+}
+
+
+// Append the token to the store.
+inline void
+Token_store::push_back(Token tok)
+{
+  int k = tok.kind();
+  lingo_assert(k == invalid_tok || (0 <= k && k < invalid_kind));
+  kinds_.push_back(k == invalid_tok ? invalid_kind : Kind(k));
+  positions_.push_back(tok.location().position());
+  symbols_.push_back(tok.symbol());
+}
+
+
+// Returns the nth token.
+inline Token
+Token_store::operator[](std::size_t n) const
+{
+  return Token(location(n), symbols_[n]);
+}
+
+
+// Returns the kind of the nth token, without reading its symbol.
+inline int
+Token_store::kind(std::size_t n) const
+{
+  Kind k = kinds_[n];
+  return k == invalid_kind ? invalid_tok : k;
+}
+
+
+inline Location
+Token_store::location(std::size_t n) const
+{
+  return Location::at(positions_[n]);
+}
+
+
+inline Symbol const*
+Token_store::symbol(std::size_t n) const
+{
+  return symbols_[n];
+}
 
 
 // -------------------------------------------------------------------------- //
 //                            Token stream
 
+// A token source produces tokens on demand, returning an invalid
+// token at the end of input. A lexer's scan() function can be used
+// as a token source.
+using Token_source = std::function<Token()>;
+
+
 // A token stream provides a stream interface to a token buffer. Note
 // that tokens in the stream can be source from multiple input buffers.
+//
+// The position of the stream is the index of the current token, which
+// can be saved and restored to backtrack.
+//
+// A stream constructed with a token source reads tokens only as they
+// are needed by peek() and get(), so parsing can begin before lexing
+// is complete. Consumed tokens are discarded once more than a window
+// of them have accumulated, keeping the buffer bounded on large
+// inputs. A position can be restored only while it is held by a
+// Marker, which retains the tokens from that position. In this mode,
+// tokens() returns only the buffered tokens.
 class Token_stream
 {
 public:
-  using Position = Token_seq::iterator;
+  using Position = std::size_t;
+
+  class Marker;
+
+  static constexpr std::size_t default_window = 256;
 
   Token_stream();
   Token_stream(Token_seq const&);
+  Token_stream(Token_seq&&);
+  Token_stream(Token_source, std::size_t = default_window);
 
   bool eof() const;
   Token peek() const;
   Token peek(int) const;
   Token get();
   void put(Token);
+  void clear();
 
   Token_seq const& tokens() const { return buf_; }
   Token_seq&       tokens()       { return buf_; }
 
   Location location() const;
 
-  // FIXME: Use iterators, begin, and end instead
-  // of a stream position.
   Position position() const;
   void     reposition(Position);
 
 // private:
-  Token_seq buf_;   // The underlying token buffer
-  Position pos_;    // The current input/output position.
+  bool buffered(std::size_t) const;
+  bool fill(std::size_t) const;
+  void discard() const;
+
+  mutable Token_seq     buf_;    // The underlying token buffer
+  mutable Position      base_;   // The position of the first buffered token
+  Position              pos_;    // The current input/output position.
+  mutable Token_source  src_;    // The source of tokens, if any
+  std::size_t           window_; // Consumed tokens retained before discarding
+  std::vector<Position> pins_;   // Positions held by markers
+};
+
+
+// A marker holds the position of a token stream at the time of its
+// construction. The tokens from that position are retained until the
+// marker is destroyed, so that the stream can be repositioned there.
+class Token_stream::Marker
+{
+public:
+  Marker(Token_stream&);
+  ~Marker();
+
+  Marker(Marker const&) = delete;
+  Marker& operator=(Marker const&) = delete;
+
+  Position position() const { return pos_; }
+  void     restore()        { ts_.reposition(pos_); }
+
+private:
+  Token_stream& ts_;
+  Position      pos_;
 };
 
 
 // Initialize a token stream with an empty token buffer.
 inline
 Token_stream::Token_stream()
-  : buf_(), pos_(buf_.begin())
+  : buf_(), base_(0), pos_(0), window_(0)
 { }
 
 
 // Initialize a token stream with the given token buffer.
 inline
 Token_stream::Token_stream(Token_seq const& toks)
-  : buf_(toks), pos_(buf_.begin())
+  : buf_(toks), base_(0), pos_(0), window_(0)
 { }
 
 
+// Initialize a token stream by moving the given token buffer.
+inline
+Token_stream::Token_stream(Token_seq&& toks)
+  : buf_(std::move(toks)), base_(0), pos_(0), window_(0)
+{ }
+
+
+// Initialize a token stream that reads tokens from the source src,
+// retaining up to n consumed tokens.
+inline
+Token_stream::Token_stream(Token_source src, std::size_t n)
+  : buf_(), base_(0), pos_(0), src_(std::move(src)), window_(n)
+{ }
+
+
+// Returns true if the nth token past the current position is in the
+// buffer, reading from the token source if needed.
+inline bool
+Token_stream::buffered(std::size_t n) const
+{
+  return pos_ - base_ + n < buf_.size() || fill(n);
+}
+
+
 // Returns true if the stream is at the end of the file.
 inline bool
 Token_stream::eof() const
 {
-  return pos_ == buf_.end();
+  return !buffered(0);
 }
 
 
@@ -236,26 +407,21 @@ Token_stream::peek() const
   if (eof())
     return Token();
   else
-    return *pos_;
+    return buf_[pos_ - base_];
 }
 
 
-// Returns the nth token past the current position.
+// Returns the nth token past the current position. This
+// takes constant time for any n. If the nth token is past
+// the end of input, this returns an invalid token.
 inline Token
 Token_stream::peek(int n) const
 {
-  // Get the nth token, but restore the stream position
-  // afterwards. Note that this will gracefully handle
-  // an eof during lookahead.
-  Position i = pos_;
-  while (i != buf_.end() && n) {
-    ++i;
-    --n;
-  }
-  if (i == buf_.end())
+  lingo_assert(n >= 0);
+  if (!buffered(n))
     return Token();
   else
-    return *i;
+    return buf_[pos_ - base_ + n];
 }
 
 
@@ -267,25 +433,35 @@ Token_stream::get()
   if (eof())
     return Token();
   else
-    return *pos_++;
+    return buf_[pos_++ - base_];
 }
 
 
-// Puts the given token at the end of the stream.
+// Puts the given token at the end of the stream. If the
+// stream is at the end, the token becomes the current token.
 inline void
 Token_stream::put(Token tok)
 {
+  lingo_count("tokens", 1);
   buf_.push_back(tok);
+}
+
 
-  // Make sure that the pos_ isn't pointing past
-  // then end after insertion into an empty list.
-  if (pos_ == buf_.end())
-    pos_ = buf_.begin();
+// Remove all tokens from the stream, keeping the storage of the
+// buffer, so that the stream can be reused for the next input. No
+// marker may be held.
+inline void
+Token_stream::clear()
+{
+  lingo_assert(pins_.empty());
+  buf_.clear();
+  base_ = 0;
+  pos_ = 0;
 }
 
 
-// Returns the current position of the stream. This
-// effectively an iterator into the buffer.
+// Returns the current position of the stream. This is
+// the index of the current token in the stream.
 inline Token_stream::Position
 Token_stream::position() const
 {
@@ -298,6 +474,7 @@ Token_stream::position() const
 inline void
 Token_stream::reposition(Position p)
 {
+  lingo_assert(base_ <= p && p <= base_ + buf_.size());
   pos_ = p;
 }
 
@@ -310,6 +487,25 @@ Token_stream::location() const
 }
 
 
+// Hold the current position of the stream.
+inline
+Token_stream::Marker::Marker(Token_stream& ts)
+  : ts_(ts), pos_(ts.position())
+{
+  ts_.pins_.push_back(pos_);
+}
+
+
+// Release the position. Markers are usually released in the
+// reverse order of their construction.
+inline
+Token_stream::Marker::~Marker()
+{
+  auto iter = std::find(ts_.pins_.rbegin(), ts_.pins_.rend(), pos_);
+  ts_.pins_.erase(std::next(iter).base());
+}
+
+
 } // namespace lingo
 
 #endif
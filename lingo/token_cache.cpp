@@ -0,0 +1,250 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/token_cache.hpp"
+#include "lingo/error.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace lingo
+{
+
+namespace
+{
+
+// The layout of a cache file is a header, followed by the
+// symbol records, the token records, and the string table.
+// All records are 4-byte aligned, so the file can be read
+// directly from a mapping.
+
+constexpr char          cache_magic[4] = {'L', 'T', 'O', 'K'};
+constexpr std::uint32_t cache_version = 1;
+
+// No symbol, or no location.
+constexpr std::uint32_t none = 0xffffffff;
+
+
+struct Cache_header
+{
+  char          magic[4];
+  std::uint32_t version;
+  std::uint64_t hash;   // The hash of the buffer's text
+  std::uint64_t size;   // The size of the buffer's text
+  std::uint32_t syms;   // The number of symbol records
+  std::uint32_t toks;   // The number of token records
+  std::uint32_t chars;  // The size of the string table
+  std::uint32_t pad;
+};
+
+
+// The classes of symbols.
+enum Symbol_class : std::uint32_t
+{
+  plain_sym,
+  identifier_sym,
+  boolean_sym,
+  integer_sym,
+  character_sym,
+  string_sym,
+};
+
+
+// A symbol. The spelling, and the value of string symbols, are
+// ranges of the string table.
+struct Symbol_record
+{
+  std::uint32_t cls;
+  std::int32_t  kind;
+  std::int32_t  value;
+  std::uint32_t str;
+  std::uint32_t len;
+  std::uint32_t val;
+  std::uint32_t vlen;
+};
+
+
+struct Token_record
+{
+  std::uint32_t sym;
+  std::uint32_t off;
+};
+
+
+// Returns the hash of the text of the buffer.
+inline std::uint64_t
+text_hash(Buffer const& buf)
+{
+  return hash_bytes(buf.begin(), buf.end() - buf.begin());
+}
+
+
+// Append s to the string table, and return its offset.
+std::uint32_t
+add_string(String& tab, String const& s)
+{
+  std::uint32_t n = tab.size();
+  tab.append(s);
+  return n;
+}
+
+
+// Returns the record for the symbol s.
+Symbol_record
+make_record(Symbol const& s, String& tab)
+{
+  Symbol_record r {plain_sym, s.token(), 0, 0, 0, 0, 0};
+  r.str = add_string(tab, s.spelling());
+  r.len = s.spelling().size();
+  if (is<Identifier_sym>(&s)) {
+    r.cls = identifier_sym;
+  } else if (auto b = as<Boolean_sym>(&s)) {
+    r.cls = boolean_sym;
+    r.value = b->value();
+  } else if (auto n = as<Integer_sym>(&s)) {
+    r.cls = integer_sym;
+    r.value = n->value();
+  } else if (auto c = as<Character_sym>(&s)) {
+    r.cls = character_sym;
+    r.value = c->value();
+  } else if (auto str = as<String_sym>(&s)) {
+    r.cls = string_sym;
+    r.val = add_string(tab, str->value());
+    r.vlen = str->value().size();
+  }
+  return r;
+}
+
+
+// Intern the symbol of the record r, whose strings are in tab.
+// Returns nullptr if the record is malformed.
+Symbol const*
+intern(Symbol_table& syms, Symbol_record const& r, char const* tab, std::size_t n)
+{
+  if (r.str > n || r.len > n - r.str || r.val > n || r.vlen > n - r.val)
+    return nullptr;
+  String_view s(tab + r.str, tab + r.str + r.len);
+  switch (r.cls) {
+    case plain_sym:
+      return syms.put_symbol(r.kind, s);
+    case identifier_sym:
+      return syms.put_identifier(r.kind, s);
+    case boolean_sym:
+      return syms.put_boolean(r.kind, s, r.value);
+    case integer_sym:
+      return syms.put_integer(r.kind, s, r.value);
+    case character_sym:
+      return syms.put_character(r.kind, s, r.value);
+    case string_sym:
+      return syms.put_string(r.kind, s, String(tab + r.val, r.vlen));
+  }
+  return nullptr;
+}
+
+} // namespace
+
+
+// Write the tokens lexed from buf to the file at p. Throws
+// std::runtime_error if the file cannot be written.
+void
+save_tokens(Path const& p, Buffer const& buf, Token_seq const& toks)
+{
+  std::unordered_map<Symbol const*, std::uint32_t> ids;
+  std::vector<Symbol_record> syms;
+  std::vector<Token_record> recs;
+  String tab;
+  recs.reserve(toks.size());
+  for (Token const& tok : toks) {
+    Token_record r {none, none};
+    if (Symbol const* s = tok.symbol()) {
+      auto ins = ids.emplace(s, syms.size());
+      if (ins.second)
+        syms.push_back(make_record(*s, tab));
+      r.sym = ins.first->second;
+    }
+    if (Location loc = tok.location()) {
+      lingo_assert(loc.buffer() == &buf);
+      r.off = loc.offset();
+    }
+    recs.push_back(r);
+  }
+
+  Cache_header h;
+  std::memcpy(h.magic, cache_magic, sizeof(h.magic));
+  h.version = cache_version;
+  h.hash = text_hash(buf);
+  h.size = buf.end() - buf.begin();
+  h.syms = syms.size();
+  h.toks = recs.size();
+  h.chars = tab.size();
+  h.pad = 0;
+
+  std::ofstream f(p.native(), std::ios::binary | std::ios::trunc);
+  f.write(reinterpret_cast<char const*>(&h), sizeof(h));
+  f.write(reinterpret_cast<char const*>(syms.data()), syms.size() * sizeof(Symbol_record));
+  f.write(reinterpret_cast<char const*>(recs.data()), recs.size() * sizeof(Token_record));
+  f.write(tab.data(), tab.size());
+  f.close();
+  if (!f)
+    throw std::runtime_error("cannot write token cache '" + p.string() + "'");
+}
+
+
+// Append the tokens of buf saved in the file at p to toks,
+// interning their symbols in syms. Returns false, leaving
+// toks unchanged, if the file does not exist, is malformed,
+// or was written for different text.
+bool
+load_tokens(Path const& p, Buffer const& buf, Symbol_table& syms, Token_seq& toks)
+{
+  File_mapping m(p);
+  if (m.size() < sizeof(Cache_header))
+    return false;
+  Cache_header h;
+  std::memcpy(&h, m.data(), sizeof(h));
+  if (std::memcmp(h.magic, cache_magic, sizeof(h.magic)) || h.version != cache_version)
+    return false;
+  std::uint64_t n = sizeof(h) +
+                    std::uint64_t(h.syms) * sizeof(Symbol_record) +
+                    std::uint64_t(h.toks) * sizeof(Token_record) +
+                    h.chars;
+  if (m.size() != n)
+    return false;
+  std::size_t len = buf.end() - buf.begin();
+  if (h.size != len || h.hash != text_hash(buf))
+    return false;
+
+  auto srecs = reinterpret_cast<Symbol_record const*>(m.data() + sizeof(h));
+  auto trecs = reinterpret_cast<Token_record const*>(srecs + h.syms);
+  auto tab = reinterpret_cast<char const*>(trecs + h.toks);
+
+  // Intern the symbols in bulk.
+  std::vector<Symbol const*> ptrs(h.syms);
+  syms.reserve(syms.size() + h.syms);
+  for (std::uint32_t i = 0; i < h.syms; ++i) {
+    ptrs[i] = intern(syms, srecs[i], tab, h.chars);
+    if (!ptrs[i])
+      return false;
+  }
+
+  // Check every token before appending any.
+  for (std::uint32_t i = 0; i < h.toks; ++i) {
+    Token_record const& r = trecs[i];
+    if ((r.sym != none && r.sym >= h.syms) || (r.off != none && r.off > len))
+      return false;
+  }
+  toks.reserve(toks.size() + h.toks);
+  for (std::uint32_t i = 0; i < h.toks; ++i) {
+    Token_record const& r = trecs[i];
+    Location loc = r.off == none ? Location() : buf.location(r.off);
+    toks.emplace_back(loc, r.sym == none ? nullptr : ptrs[r.sym]);
+  }
+  return true;
+}
+
+
+} // namespace lingo
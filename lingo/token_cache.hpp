@@ -0,0 +1,39 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_TOKEN_CACHE_HPP
+#define LINGO_TOKEN_CACHE_HPP
+
+// The token cache module saves the tokens lexed from a buffer
+// in a compact binary file, so that later runs over the same
+// text can load the tokens instead of lexing again.
+
+#include <lingo/file.hpp>
+#include <lingo/token.hpp>
+
+namespace lingo
+{
+
+// -------------------------------------------------------------------------- //
+// Token cache
+
+// A token cache file contains the symbols and tokens lexed from
+// the text of a buffer, and the hash and size of that text. Each
+// distinct symbol is stored once, with its kind, its attributes,
+// and its spelling in a table of strings. Each token is stored as
+// the index of its symbol and its offset in the buffer.
+//
+// When the cache is loaded, the spellings are re-interned in a
+// symbol table, and tokens are rebuilt with locations in the
+// buffer. The cache is loaded only if it was written for text
+// identical to that of the buffer.
+//
+// The tokens of a cache must all be located in the buffer, or
+// have no location.
+void save_tokens(Path const&, Buffer const&, Token_seq const&);
+bool load_tokens(Path const&, Buffer const&, Symbol_table&, Token_seq&);
+
+
+} // namespace lingo
+
+#endif
@@ -0,0 +1,397 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef LINGO_TRAVERSAL_HPP
+#define LINGO_TRAVERSAL_HPP
+
+// The traversal module provides generic algorithms over the nodes
+// of a tree. The children of a node are found through the node
+// concepts (see node.hpp), so the algorithms need no code specific
+// to a language.
+//
+// Each algorithm is given the node list of a closed hierarchy (see
+// dispatch.hpp) and the root of a tree, whose static type T is the
+// base class of that hierarchy. The sub-terms of each node that are
+// pointers convertible to T const* are its children. Other sub-terms
+// (e.g., symbols, or nodes of another hierarchy) are not visited.
+// Empty and error nodes are never visited.
+//
+// Nodes are visited in preorder using an explicit stack, so the
+// depth of a tree is not limited by the depth of the call stack.
+// The parallel algorithms divide that stack among threads.
+
+#include <lingo/dispatch.hpp>
+#include <lingo/node.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace lingo
+{
+
+namespace traversal_impl
+{
+
+// Push the sub-term x onto the stack s if it is a child.
+template<typename T, typename U>
+inline typename std::enable_if<std::is_convertible<U const*, T const*>::value>::type
+push_child(std::vector<T const*>& s, U const* x)
+{
+  if (is_valid_node(x))
+    s.push_back(x);
+}
+
+
+template<typename T, typename U>
+inline void
+push_child(std::vector<T const*>&, U const&)
+{ }
+
+
+template<typename T, typename U>
+inline typename std::enable_if<is_nullary_node<U>()>::type
+push_subterms(std::vector<T const*>&, U const*)
+{ }
+
+
+// Children are pushed in reverse order, so that they are popped
+// in order.
+template<typename T, typename U>
+inline typename std::enable_if<is_unary_node<U>()>::type
+push_subterms(std::vector<T const*>& s, U const* u)
+{
+  push_child(s, u->first);
+}
+
+
+template<typename T, typename U>
+inline typename std::enable_if<is_binary_node<U>()>::type
+push_subterms(std::vector<T const*>& s, U const* u)
+{
+  push_child(s, u->second);
+  push_child(s, u->first);
+}
+
+
+template<typename T, typename U>
+inline typename std::enable_if<is_ternary_node<U>()>::type
+push_subterms(std::vector<T const*>& s, U const* u)
+{
+  push_child(s, u->third);
+  push_child(s, u->second);
+  push_child(s, u->first);
+}
+
+
+template<typename T, typename U>
+inline typename std::enable_if<is_kary_node<U>()>::type
+push_subterms(std::vector<T const*>& s, U const* u)
+{
+  std::size_t n = s.size();
+  for (auto const& x : *u)
+    push_child(s, x);
+  std::reverse(s.begin() + n, s.end());
+}
+
+
+template<typename T>
+struct Push_children_fn
+{
+  template<typename U>
+  void operator()(U const* u) const { push_subterms(s, u); }
+
+  std::vector<T const*>& s;
+};
+
+
+// Push the children of t onto s.
+template<typename L, typename T>
+inline void
+push_children(std::vector<T const*>& s, T const* t)
+{
+  dispatch<L>(t, Push_children_fn<T>{s});
+}
+
+
+// A worker of a parallel traversal owns a private stack of nodes.
+// When other workers may be idle, the oldest part of that stack,
+// which holds the largest subtrees, is moved to a shared queue from
+// which other workers can steal.
+template<typename T>
+struct Walk_worker
+{
+  Walk_worker()
+    : shared(0)
+  { }
+
+  std::vector<T const*>    stack;
+  std::mutex               mutex;
+  std::deque<T const*>     queue;
+  std::atomic<std::size_t> shared; // The size of the queue
+  std::exception_ptr       error;
+};
+
+
+// The number of nodes visited between checks for sharing.
+constexpr std::size_t walk_share_interval = 64;
+
+// The number of children of a node at which they are shared
+// immediately.
+constexpr std::size_t walk_fork_width = 16;
+
+
+// Visit the nodes of the tree rooted at t using n threads. Each
+// node is visited by calling visit with the index of the worker
+// and the node. If visit returns false, the traversal stops as
+// soon as each worker notices. If visit throws an exception, the
+// traversal stops and the exception is rethrown.
+//
+// If n is 0, the number of threads is the number of hardware
+// threads.
+template<typename L, typename T, typename Visit>
+void
+walk_in_parallel(T const* t, std::size_t n, Visit visit)
+{
+  if (n == 0)
+    n = std::max(1u, std::thread::hardware_concurrency());
+  if (!is_valid_node(t))
+    return;
+
+  using Worker = Walk_worker<T>;
+  std::unique_ptr<Worker[]> ws(new Worker[n]);
+  ws[0].stack.push_back(t);
+  std::atomic<std::size_t> idle(0);
+  std::atomic<bool> stop(false);
+
+  // Move the older half of the nodes of w's stack to its queue.
+  auto share = [](Worker& w) {
+    std::vector<T const*>& v = w.stack;
+    std::size_t h = v.size() / 2;
+    std::lock_guard<std::mutex> lock(w.mutex);
+    w.queue.insert(w.queue.end(), v.begin(), v.begin() + h);
+    v.erase(v.begin(), v.begin() + h);
+    w.shared.store(w.queue.size(), std::memory_order_release);
+  };
+
+  // Move half of the nodes in the queue of v to the stack of w.
+  // Returns true if any were moved.
+  auto take = [](Worker& w, Worker& v) {
+    if (v.shared.load(std::memory_order_acquire) == 0)
+      return false;
+    std::lock_guard<std::mutex> lock(v.mutex);
+    std::size_t h = (v.queue.size() + 1) / 2;
+    w.stack.insert(w.stack.end(), v.queue.begin(), v.queue.begin() + h);
+    v.queue.erase(v.queue.begin(), v.queue.begin() + h);
+    v.shared.store(v.queue.size(), std::memory_order_release);
+    return h != 0;
+  };
+
+  auto work = [&](std::size_t i) {
+    Worker& w = ws[i];
+    try {
+      while (true) {
+        std::size_t count = 0;
+        while (!w.stack.empty() && !stop) {
+          T const* x = w.stack.back();
+          w.stack.pop_back();
+          if (!visit(i, x)) {
+            stop = true;
+            return;
+          }
+          std::size_t k = w.stack.size();
+          push_children<L>(w.stack, x);
+          bool wide = w.stack.size() - k >= walk_fork_width;
+          if ((wide || ++count % walk_share_interval == 0) && w.stack.size() > 1 && w.shared == 0)
+            share(w);
+        }
+        if (stop)
+          return;
+
+        // Look for more work, starting with our own queue.
+        bool found = false;
+        for (std::size_t j = 0; j < n && !found; ++j)
+          found = take(w, ws[(i + j) % n]);
+        if (found)
+          continue;
+
+        // Wait until work is shared or every worker is idle.
+        ++idle;
+        while (true) {
+          bool shared = false;
+          for (std::size_t j = 0; j < n && !shared; ++j)
+            shared = ws[j].shared != 0;
+          if (shared && !stop) {
+            --idle;
+            break;
+          }
+          if (idle == n || stop)
+            return;
+          std::this_thread::yield();
+        }
+      }
+    } catch (...) {
+      w.error = std::current_exception();
+      stop = true;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < n; ++i)
+    threads.emplace_back(work, i);
+  work(0);
+  for (std::thread& x : threads)
+    x.join();
+
+  for (std::size_t i = 0; i < n; ++i)
+    if (ws[i].error)
+      std::rethrow_exception(ws[i].error);
+  if (stop)
+    return;
+
+  // Visit anything left behind by a worker that stopped while
+  // another was publishing work.
+  std::vector<T const*>& s = ws[0].stack;
+  for (std::size_t i = 0; i < n; ++i)
+    s.insert(s.end(), ws[i].queue.begin(), ws[i].queue.end());
+  while (!s.empty()) {
+    T const* x = s.back();
+    s.pop_back();
+    if (!visit(0, x))
+      return;
+    push_children<L>(s, x);
+  }
+}
+
+} // namespace traversal_impl
+
+
+// -------------------------------------------------------------------------- //
+//                          Sequential traversal
+
+// Call f for each node of the tree rooted at t, in preorder.
+template<typename L, typename T, typename F>
+void
+for_each_node(T const* t, F f)
+{
+  std::vector<T const*> s;
+  traversal_impl::push_child(s, t);
+  while (!s.empty()) {
+    T const* x = s.back();
+    s.pop_back();
+    f(x);
+    traversal_impl::push_children<L>(s, x);
+  }
+}
+
+
+// Returns the first node of the tree rooted at t, in preorder, that
+// satisfies pred, or nullptr if there is none.
+template<typename L, typename T, typename P>
+T const*
+find_if_node(T const* t, P pred)
+{
+  std::vector<T const*> s;
+  traversal_impl::push_child(s, t);
+  while (!s.empty()) {
+    T const* x = s.back();
+    s.pop_back();
+    if (pred(x))
+      return x;
+    traversal_impl::push_children<L>(s, x);
+  }
+  return nullptr;
+}
+
+
+// Returns the reduction of init and the transformed value of each
+// node of the tree rooted at t, in preorder.
+template<typename L, typename T, typename R, typename Reduce, typename Transform>
+R
+transform_reduce_nodes(T const* t, R init, Reduce reduce, Transform transform)
+{
+  for_each_node<L>(t, [&](T const* x) { init = reduce(init, transform(x)); });
+  return init;
+}
+
+
+// -------------------------------------------------------------------------- //
+//                           Parallel traversal
+//
+// The parallel algorithms visit nodes on n threads, in no particular
+// order. The functions they are given must be safe to call from
+// several threads at once. If n is 0, the number of threads is the
+// number of hardware threads.
+//
+// Each thread works through a part of the tree, and forks the rest
+// for idle threads to steal: the largest pending subtrees, and the
+// children of wide k-ary nodes.
+
+
+// Call f for each node of the tree rooted at t.
+template<typename L, typename T, typename F>
+void
+for_each_node_in_parallel(T const* t, F f, std::size_t n = 0)
+{
+  traversal_impl::walk_in_parallel<L>(t, n, [&](std::size_t, T const* x) {
+    f(x);
+    return true;
+  });
+}
+
+
+// Returns a node of the tree rooted at t that satisfies pred, or
+// nullptr if there is none. If several nodes satisfy pred, any one
+// of them may be returned.
+template<typename L, typename T, typename P>
+T const*
+find_if_node_in_parallel(T const* t, P pred, std::size_t n = 0)
+{
+  std::atomic<T const*> r(nullptr);
+  traversal_impl::walk_in_parallel<L>(t, n, [&](std::size_t, T const* x) {
+    if (!pred(x))
+      return true;
+    T const* p = nullptr;
+    r.compare_exchange_strong(p, x);
+    return false;
+  });
+  return r;
+}
+
+
+// Returns the reduction of init and the transformed value of each
+// node of the tree rooted at t. Because the values are reduced in
+// no particular order, reduce must be associative and commutative.
+template<typename L, typename T, typename R, typename Reduce, typename Transform>
+R
+transform_reduce_nodes_in_parallel(T const* t, R init, Reduce reduce, Transform transform, std::size_t n = 0)
+{
+  if (n == 0)
+    n = std::max(1u, std::thread::hardware_concurrency());
+
+  // Each worker reduces the nodes it visits.
+  std::vector<std::unique_ptr<R>> ps(n);
+  traversal_impl::walk_in_parallel<L>(t, n, [&](std::size_t i, T const* x) {
+    std::unique_ptr<R>& p = ps[i];
+    if (p)
+      *p = reduce(*p, transform(x));
+    else
+      p.reset(new R(transform(x)));
+    return true;
+  });
+  for (std::unique_ptr<R>& p : ps)
+    if (p)
+      init = reduce(init, *p);
+  return init;
+}
+
+
+} // namespace lingo
+
+#endif
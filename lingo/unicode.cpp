@@ -5,12 +5,25 @@
 
 #include "lingo/unicode.hpp"
 
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
+#include <mutex>
 #include <stdexcept>
+#include <string>
 #include <system_error>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <iconv.h>
+#include <strings.h>
+
+#if defined(__SSE2__)
+#  include <immintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
 
 #define kBufferSize 4096
 
@@ -35,6 +48,495 @@ const char* encoding_names[] = {
   "UTF-32LE"
 };
 
+
+// -------------------------------------------------------------------------- //
+//                         Built-in transcoders
+//
+// The built-in transcoders convert between the Unicode encodings by
+// decoding and encoding one code point at a time. For byte-oriented
+// sources, runs of ASCII characters are found many bytes at a time, and
+// are copied or widened directly.
+
+using Result = Character_set_converter::Result;
+
+
+// Bits of the byte order state of a conversion.
+enum Byte_order_state : unsigned
+{
+  source_known = 1, // The source byte order has been determined
+  source_big   = 2, // The source is big-endian
+  mark_written = 4  // The target byte order mark has been written
+};
+
+
+// The outcome of decoding or encoding a single code point.
+enum Code_status
+{
+  code_ok,         // The code point was decoded or encoded
+  code_incomplete, // Insufficient input or output
+  code_illegal     // Invalid input, or the code point cannot be encoded
+};
+
+
+// Returns the built-in encoding with the given name, or -1 if
+// there is no such encoding.
+int
+native_encoding(const char* name)
+{
+  for (int i = 0; i < int(sizeof(encoding_names) / sizeof(*encoding_names)); ++i)
+    if (::strcasecmp(name, encoding_names[i]) == 0)
+      return i;
+  return -1;
+}
+
+
+// Returns true if the encoding may be preceded by a byte order mark.
+inline bool
+is_marked(int e)
+{
+  return e == UTF16_encoding || e == UTF32_encoding;
+}
+
+
+// Returns true if the encoding is written as a sequence of bytes.
+inline bool
+is_bytewise(int e)
+{
+  return e == ASCII_encoding || e == UTF8_encoding;
+}
+
+
+// Returns true if the target encoding is big-endian. Unmarked
+// targets are written in platform byte order.
+inline bool
+is_big_target(int e)
+{
+  return e == UTF16_big_endian_encoding
+      || e == UTF32_big_endian_encoding
+      || (is_marked(e) && WORDS_BIGENDIAN);
+}
+
+
+// Returns true if the source encoding is big-endian. The byte
+// order of a marked source is recorded in the state.
+inline bool
+is_big_source(int e, unsigned state)
+{
+  return e == UTF16_big_endian_encoding
+      || e == UTF32_big_endian_encoding
+      || (is_marked(e) && (state & source_big));
+}
+
+
+inline char32_t
+load16(const unsigned char* p, bool big)
+{
+  return big ? (p[0] << 8 | p[1]) : (p[1] << 8 | p[0]);
+}
+
+
+inline char32_t
+load32(const unsigned char* p, bool big)
+{
+  return big ? (char32_t(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3])
+             : (char32_t(p[3]) << 24 | p[2] << 16 | p[1] << 8 | p[0]);
+}
+
+
+inline void
+store16(unsigned char* q, char32_t c, bool big)
+{
+  q[big ? 0 : 1] = c >> 8;
+  q[big ? 1 : 0] = c;
+}
+
+
+inline void
+store32(unsigned char* q, char32_t c, bool big)
+{
+  q[big ? 0 : 3] = c >> 24;
+  q[big ? 1 : 2] = c >> 16;
+  q[big ? 2 : 1] = c >> 8;
+  q[big ? 3 : 0] = c;
+}
+
+
+// Decode the code point at the start of [p, end) in the encoding e,
+// storing it in c. The pointer p is advanced only if a code point is
+// decoded.
+Code_status
+decode(int e, bool big, const unsigned char*& p, const unsigned char* end, char32_t& c)
+{
+  std::size_t avail = end - p;
+  switch (e) {
+    case ASCII_encoding:
+      if (p[0] >= 0x80)
+        return code_illegal;
+      c = *p++;
+      return code_ok;
+
+    case UTF8_encoding: {
+      unsigned b = p[0];
+      int n;
+      if (b < 0x80) {
+        c = *p++;
+        return code_ok;
+      } else if (b >= 0xc2 && b <= 0xdf) {
+        n = 2;
+        c = b & 0x1f;
+      } else if ((b & 0xf0) == 0xe0) {
+        n = 3;
+        c = b & 0x0f;
+      } else if (b >= 0xf0 && b <= 0xf4) {
+        n = 4;
+        c = b & 0x07;
+      } else {
+        return code_illegal;
+      }
+      for (int i = 1; i < n; ++i) {
+        if (std::size_t(i) == avail)
+          return code_incomplete;
+        if ((p[i] & 0xc0) != 0x80)
+          return code_illegal;
+        c = c << 6 | (p[i] & 0x3f);
+      }
+      // Reject overlong encodings, surrogates, and values past the
+      // maximum code point.
+      if (n == 3 && (c < 0x800 || (c >= 0xd800 && c <= 0xdfff)))
+        return code_illegal;
+      if (n == 4 && (c < 0x10000 || c > UNICODE_MAX))
+        return code_illegal;
+      p += n;
+      return code_ok;
+    }
+
+    case UTF16_encoding:
+    case UTF16_big_endian_encoding:
+    case UTF16_little_endian_encoding: {
+      if (avail < 2)
+        return code_incomplete;
+      char32_t u = load16(p, big);
+      if (u >= 0xdc00 && u <= 0xdfff)
+        return code_illegal;
+      if (u < 0xd800 || u > 0xdbff) {
+        c = u;
+        p += 2;
+        return code_ok;
+      }
+      if (avail < 4)
+        return code_incomplete;
+      char32_t v = load16(p + 2, big);
+      if (v < 0xdc00 || v > 0xdfff)
+        return code_illegal;
+      c = 0x10000 + ((u - 0xd800) << 10) + (v - 0xdc00);
+      p += 4;
+      return code_ok;
+    }
+
+    default: {
+      if (avail < 4)
+        return code_incomplete;
+      char32_t u = load32(p, big);
+      if (u > UNICODE_MAX || (u >= 0xd800 && u <= 0xdfff))
+        return code_illegal;
+      c = u;
+      p += 4;
+      return code_ok;
+    }
+  }
+}
+
+
+// Encode the code point c in the encoding e at the start of [q, end).
+// The pointer q is advanced only if the code point is encoded.
+Code_status
+encode(int e, bool big, char32_t c, unsigned char*& q, unsigned char* end)
+{
+  std::size_t avail = end - q;
+  switch (e) {
+    case ASCII_encoding:
+      if (c >= 0x80)
+        return code_illegal;
+      if (avail < 1)
+        return code_incomplete;
+      *q++ = c;
+      return code_ok;
+
+    case UTF8_encoding:
+      if (c < 0x80) {
+        if (avail < 1)
+          return code_incomplete;
+        *q++ = c;
+      } else if (c < 0x800) {
+        if (avail < 2)
+          return code_incomplete;
+        *q++ = 0xc0 | c >> 6;
+        *q++ = 0x80 | (c & 0x3f);
+      } else if (c < 0x10000) {
+        if (avail < 3)
+          return code_incomplete;
+        *q++ = 0xe0 | c >> 12;
+        *q++ = 0x80 | (c >> 6 & 0x3f);
+        *q++ = 0x80 | (c & 0x3f);
+      } else {
+        if (avail < 4)
+          return code_incomplete;
+        *q++ = 0xf0 | c >> 18;
+        *q++ = 0x80 | (c >> 12 & 0x3f);
+        *q++ = 0x80 | (c >> 6 & 0x3f);
+        *q++ = 0x80 | (c & 0x3f);
+      }
+      return code_ok;
+
+    case UTF16_encoding:
+    case UTF16_big_endian_encoding:
+    case UTF16_little_endian_encoding:
+      if (c < 0x10000) {
+        if (avail < 2)
+          return code_incomplete;
+        store16(q, c, big);
+        q += 2;
+      } else {
+        if (avail < 4)
+          return code_incomplete;
+        c -= 0x10000;
+        store16(q, 0xd800 + (c >> 10), big);
+        store16(q + 2, 0xdc00 + (c & 0x3ff), big);
+        q += 4;
+      }
+      return code_ok;
+
+    default:
+      if (avail < 4)
+        return code_incomplete;
+      store32(q, c, big);
+      q += 4;
+      return code_ok;
+  }
+}
+
+
+// Returns the length of the run of ASCII characters at the start
+// of [p, end).
+std::size_t
+ascii_run(const unsigned char* p, const unsigned char* end)
+{
+  const unsigned char* first = p;
+#if defined(__SSE2__)
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    unsigned bits = _mm_movemask_epi8(v);
+    if (bits)
+      return p - first + __builtin_ctz(bits);
+    p += 16;
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  while (end - p >= 16) {
+    if (vmaxvq_u8(vld1q_u8(p)) >= 0x80)
+      break;
+    p += 16;
+  }
+#endif
+  while (p != end && *p < 0x80)
+    ++p;
+  return p - first;
+}
+
+
+// Copy the run of ASCII characters at the start of [p, end) to the
+// target encoding e, as far as the output permits. The loops that
+// widen characters are simple enough to be vectorized.
+void
+copy_ascii(int e, bool big, const unsigned char*& p, const unsigned char* end, unsigned char*& q, unsigned char* q_end)
+{
+  std::size_t n = ascii_run(p, end);
+  if (is_bytewise(e)) {
+    n = std::min<std::size_t>(n, q_end - q);
+    std::memcpy(q, p, n);
+    q += n;
+  } else if (e == UTF16_encoding || e == UTF16_big_endian_encoding || e == UTF16_little_endian_encoding) {
+    n = std::min<std::size_t>(n, (q_end - q) / 2);
+    for (std::size_t i = 0; i < n; ++i)
+      store16(q + 2 * i, p[i], big);
+    q += 2 * n;
+  } else {
+    n = std::min<std::size_t>(n, (q_end - q) / 4);
+    for (std::size_t i = 0; i < n; ++i)
+      store32(q + 4 * i, p[i], big);
+    q += 4 * n;
+  }
+  p += n;
+}
+
+
+// Convert the characters in [p, end) from the encoding `from` to
+// the encoding `to`, writing to [q, q_end). On return, p and q
+// indicate the first unconverted character and the end of the
+// output.
+Result
+native_convert(int from, int to, unsigned& state, const unsigned char*& p, const unsigned char* end, unsigned char*& q, unsigned char* q_end)
+{
+  bool big_target = is_big_target(to);
+  while (p != end) {
+    // Determine the byte order of a marked source from its byte
+    // order mark, if any. Otherwise, the source is big-endian.
+    if (is_marked(from) && !(state & source_known)) {
+      std::size_t n = from == UTF16_encoding ? 2 : 4;
+      if (std::size_t(end - p) < n)
+        return Character_set_converter::partial;
+      char32_t c = n == 2 ? load16(p, true) : load32(p, true);
+      if (c == 0xfeff) {
+        state |= source_big;
+        p += n;
+      } else if ((n == 2 && c == 0xfffe) || (n == 4 && c == 0xfffe0000)) {
+        p += n;
+      } else {
+        state |= source_big;
+      }
+      state |= source_known;
+      continue;
+    }
+
+    // Write the byte order mark of a marked target.
+    if (is_marked(to) && !(state & mark_written)) {
+      if (encode(to, big_target, 0xfeff, q, q_end) != code_ok)
+        return Character_set_converter::partial;
+      state |= mark_written;
+    }
+
+    if (is_bytewise(from) && *p < 0x80) {
+      const unsigned char* p0 = p;
+      copy_ascii(to, big_target, p, end, q, q_end);
+      if (p != p0)
+        continue;
+    }
+
+    const unsigned char* p0 = p;
+    char32_t c;
+    Code_status s = decode(from, is_big_source(from, state), p, end, c);
+    if (s == code_incomplete)
+      return Character_set_converter::partial;
+    if (s == code_illegal)
+      return Character_set_converter::error;
+    s = encode(to, big_target, c, q, q_end);
+    if (s != code_ok) {
+      p = p0;
+      return s == code_incomplete ? Character_set_converter::partial : Character_set_converter::error;
+    }
+  }
+  return Character_set_converter::ok;
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+//                             UTF-8 validation
+
+// Skip runs of ASCII characters in bulk, and check each multi-byte
+// sequence with the UTF-8 decoder of the built-in transcoders.
+const char*
+find_invalid_utf8(const char* first, const char* last)
+{
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(first);
+  const unsigned char* end = reinterpret_cast<const unsigned char*>(last);
+  while (true) {
+    p += ascii_run(p, end);
+    if (p == end)
+      return last;
+    char32_t c;
+    if (decode(UTF8_encoding, false, p, end, c) != code_ok)
+      return reinterpret_cast<const char*>(p);
+  }
+}
+
+
+namespace
+{
+
+// -------------------------------------------------------------------------- //
+//                           Descriptor pool
+
+// The descriptor pool retains the iconv descriptors of closed
+// converters, for each pair of encodings. At most max_free
+// descriptors are retained for each pair.
+class Descriptor_pool
+{
+public:
+  static constexpr std::size_t max_free = 16;
+
+  iconv_t acquire(const char*, const char*, int&);
+  void    release(iconv_t, int);
+
+private:
+  struct Entry
+  {
+    std::string          from;
+    std::string          to;
+    std::vector<iconv_t> free;
+  };
+
+  std::mutex                           mutex_;
+  std::unordered_map<std::string, int> keys_;
+  std::vector<Entry>                   entries_;
+};
+
+
+// Returns a descriptor converting from `from` to `to`, opening a new
+// descriptor if none is available. The key of the pair is stored
+// in key.
+iconv_t
+Descriptor_pool::acquire(const char* from, const char* to, int& key)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string name = std::string(from) + '\0' + to;
+    auto ins = keys_.insert({name, entries_.size()});
+    if (ins.second)
+      entries_.push_back({from, to, {}});
+    key = ins.first->second;
+    Entry& e = entries_[key];
+    if (!e.free.empty()) {
+      iconv_t cd = e.free.back();
+      e.free.pop_back();
+      return cd;
+    }
+  }
+  iconv_t cd = iconv_open(to, from);
+  if (cd == iconv_t(-1))
+    throw std::system_error(errno, std::generic_category());
+  return cd;
+}
+
+
+// Reset the descriptor and return it to the pool, or close it if
+// enough descriptors are already retained for its key.
+void
+Descriptor_pool::release(iconv_t cd, int key)
+{
+  iconv(cd, nullptr, nullptr, nullptr, nullptr);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<iconv_t>& free = entries_[key].free;
+    if (free.size() < max_free) {
+      free.push_back(cd);
+      return;
+    }
+  }
+  if (iconv_close(cd) == -1)
+    throw std::system_error(errno, std::generic_category());
+}
+
+
+// Returns the global descriptor pool. This is never destroyed, so
+// converters may be closed during static destruction.
+Descriptor_pool&
+descriptor_pool()
+{
+  static Descriptor_pool* pool = new Descriptor_pool();
+  return *pool;
+}
+
 } // namespace
 
 
@@ -46,7 +548,7 @@ get_encoding_name(Encoding code)
 
 
 Character_set_converter::Character_set_converter() noexcept
-  : m_rep(reinterpret_cast<void*>(-1))
+  : m_rep(reinterpret_cast<void*>(-1)), m_key(-1), m_from(-1), m_to(-1), m_state(0)
 {}
 
 
@@ -66,20 +568,29 @@ Character_set_converter::Character_set_converter(const char* fromcode, const cha
 
 Character_set_converter::Character_set_converter(Character_set_converter&& c) noexcept
   : m_rep(std::exchange(c.m_rep, reinterpret_cast<void*>(-1)))
+  , m_key(std::exchange(c.m_key, -1))
+  , m_from(std::exchange(c.m_from, -1))
+  , m_to(std::exchange(c.m_to, -1))
+  , m_state(std::exchange(c.m_state, 0))
 {}
 
 
 Character_set_converter::~Character_set_converter()
 {
-  if (is_open())
-    iconv_close(reinterpret_cast<iconv_t>(m_rep));
+  if (m_rep != reinterpret_cast<void*>(-1)) {
+    try {
+      descriptor_pool().release(reinterpret_cast<iconv_t>(m_rep), m_key);
+    } catch (...) { }
+  }
 }
 
 
 Character_set_converter&
 Character_set_converter::operator=(Character_set_converter&& c) noexcept
 {
-  m_rep = std::exchange(c.m_rep, reinterpret_cast<void*>(-1));
+  // The previous descriptor, if any, is released by the temporary.
+  Character_set_converter tmp(std::move(c));
+  swap(tmp);
   return *this;
 }
 
@@ -87,17 +598,34 @@ Character_set_converter::operator=(Character_set_converter&& c) noexcept
 bool
 Character_set_converter::is_open() const
 {
-  return m_rep != reinterpret_cast<void*>(-1);
+  return m_rep != reinterpret_cast<void*>(-1) || m_from >= 0;
+}
+
+
+// Returns true if the conversion is performed by a built-in
+// transcoder.
+bool
+Character_set_converter::is_native() const
+{
+  return m_from >= 0;
 }
 
 
+// Open the converter. A built-in transcoder is used when both
+// encodings are supported, and iconv is used otherwise.
 void
 Character_set_converter::open(const char* fromcode, const char* tocode)
 {
   if (!is_open()) {
-    iconv_t cd = iconv_open(tocode, fromcode);
-    if (cd == iconv_t(-1))
-      throw std::system_error(errno, std::generic_category());
+    int from = native_encoding(fromcode);
+    int to = native_encoding(tocode);
+    if (from >= 0 && to >= 0) {
+      m_from = from;
+      m_to = to;
+      m_state = 0;
+      return;
+    }
+    iconv_t cd = descriptor_pool().acquire(fromcode, tocode, m_key);
     m_rep = reinterpret_cast<void*>(cd);
   }
 }
@@ -106,10 +634,13 @@ Character_set_converter::open(const char* fromcode, const char* tocode)
 void
 Character_set_converter::close()
 {
-  if (is_open()) {
-    if (iconv_close(reinterpret_cast<iconv_t>(m_rep)) == -1)
-      throw std::system_error(errno, std::generic_category());
+  if (is_native()) {
+    m_from = m_to = -1;
+    m_state = 0;
+  } else if (is_open()) {
+    iconv_t cd = reinterpret_cast<iconv_t>(m_rep);
     m_rep = reinterpret_cast<void*>(-1);
+    descriptor_pool().release(cd, m_key);
   }
 }
 
@@ -117,6 +648,10 @@ Character_set_converter::close()
 void
 Character_set_converter::reset()
 {
+  if (is_native()) {
+    m_state = 0;
+    return;
+  }
   std::size_t n_conv = iconv(reinterpret_cast<iconv_t>(m_rep), nullptr, nullptr, nullptr, nullptr);
   if (n_conv == std::size_t(-1))
     throw std::system_error(errno, std::generic_category());
@@ -128,6 +663,13 @@ Character_set_converter::reset_bytes(char* to, char* to_end, char*& to_next)
 {
   lingo_assert(to <= to_end);
 
+  // The Unicode encodings have no shift sequences.
+  if (is_native()) {
+    m_state = 0;
+    to_next = to;
+    return ok;
+  }
+
   Result result = ok;
 
   char* out_buf = to;
@@ -156,6 +698,17 @@ Character_set_converter::convert_bytes(const char* from, const char* from_end, c
   lingo_assert(from <= from_end);
   lingo_assert(to <= to_end);
 
+  if (is_native()) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(from);
+    unsigned char* out = reinterpret_cast<unsigned char*>(to);
+    Result r = native_convert(m_from, m_to, m_state, in,
+                              reinterpret_cast<const unsigned char*>(from_end),
+                              out, reinterpret_cast<unsigned char*>(to_end));
+    from_next = reinterpret_cast<const char*>(in);
+    to_next = reinterpret_cast<char*>(out);
+    return r;
+  }
+
   Result result = ok;
 
   ICONV_CONST char* in_buf = const_cast<ICONV_CONST char*>(from);
@@ -194,6 +747,25 @@ Character_set_converter::converted_byte_length(const char* from, const char* fro
 
   char temp_buf[kBufferSize];
 
+  // Convert into the temporary buffer until the input is consumed,
+  // or an error or incomplete character is found.
+  if (is_native()) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(from);
+    const unsigned char* in_end = reinterpret_cast<const unsigned char*>(from_end);
+    unsigned char* temp = reinterpret_cast<unsigned char*>(temp_buf);
+    while (true) {
+      unsigned char* out = temp;
+      Result r = native_convert(m_from, m_to, m_state, in, in_end, out, temp + kBufferSize);
+      result += out - temp;
+      if (r == ok)
+        return result;
+      if (r == error || out == temp) {
+        errno = EILSEQ;
+        return result;
+      }
+    }
+  }
+
   ICONV_CONST char* in_buf = const_cast<ICONV_CONST char*>(from);
   std::size_t in_bytes = from_end - from;
 
@@ -241,10 +813,28 @@ Character_set_converter::converted_byte_length(const char* from, const char* fro
 }
 
 
+// Returns an estimate of the number of bytes produced by converting
+// n bytes of input. The estimate assumes that each character in the
+// source is a single code unit, and is used to size output buffers.
+std::size_t
+Character_set_converter::estimated_byte_length(std::size_t n) const
+{
+  if (is_native()) {
+    auto unit = [](int e) { return is_bytewise(e) ? 1 : e <= UTF16_little_endian_encoding ? 2 : 4; };
+    return n / unit(m_from) * unit(m_to) + 4;
+  }
+  return n + 16;
+}
+
+
 void
 Character_set_converter::swap(Character_set_converter& c) noexcept
 {
   std::swap(m_rep, c.m_rep);
+  std::swap(m_key, c.m_key);
+  std::swap(m_from, c.m_from);
+  std::swap(m_to, c.m_to);
+  std::swap(m_state, c.m_state);
 }
 
 
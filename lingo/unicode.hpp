@@ -63,6 +63,53 @@ template<typename UCharT, typename CharT>
 UCharT to_unescaped(const CharT* str, CharT** str_end);
 
 
+// Unescape a sequence of characters.
+//
+// This function appends the characters in [first, last) to out, replacing
+// each escape sequence with its unescaped character value, as if by
+// to_unescaped. The characters between escape sequences are found by
+// searching for the next backslash and are appended in bulk. Escape
+// sequences do not extend past last.
+//
+// The function throws the same exceptions as to_unescaped, and also throws
+// std::out_of_range if a character that is not part of an escape sequence
+// is outside the range of UCharT. When an exception is thrown, out holds
+// what it held before the call followed by the unescaped characters that
+// precede the offending character or escape sequence.
+template<typename UCharT, typename CharT>
+void unescape(const CharT* first, const CharT* last, std::basic_string<UCharT>& out);
+
+
+// Returns a pointer to the first byte of the first invalid or incomplete
+// UTF-8 sequence in [first, last), or last if the text is valid UTF-8.
+// Overlong sequences, surrogates, and values greater than UNICODE_MAX are
+// invalid. Runs of ASCII characters are checked many bytes at a time.
+const char* find_invalid_utf8(const char* first, const char* last);
+
+
+// Decode the UTF-8 sequence at the start of str, and advance str past
+// that sequence. The sequence shall be valid (see find_invalid_utf8).
+inline char32_t
+decode_utf8(const char*& str)
+{
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(str);
+  char32_t c = p[0];
+  if (c < 0x80) {
+    ++str;
+  } else if (c < 0xe0) {
+    c = (c & 0x1f) << 6 | (p[1] & 0x3f);
+    str += 2;
+  } else if (c < 0xf0) {
+    c = (c & 0x0f) << 12 | (p[1] & 0x3f) << 6 | (p[2] & 0x3f);
+    str += 3;
+  } else {
+    c = (c & 0x07) << 18 | (p[1] & 0x3f) << 12 | (p[2] & 0x3f) << 6 | (p[3] & 0x3f);
+    str += 4;
+  }
+  return c;
+}
+
+
 // -------------------------------------------------------------------------- //
 //                         Character set conversion
 
@@ -104,6 +151,17 @@ const char* get_encoding_name(Encoding code);
 
 
 // Encapsulates conversion of character strings from one encoding to another.
+//
+// When both encodings are among the Unicode encodings (and ASCII) listed in
+// Encoding, conversion is performed by built-in transcoders. Otherwise, the
+// conversion is performed by iconv. The built-in transcoders follow iconv's
+// conventions: an unmarked UTF-16 or UTF-32 source is big-endian unless it
+// begins with a byte order mark, and an unmarked UTF-16 or UTF-32 target is
+// written in platform byte order, preceded by a byte order mark.
+//
+// Opening an iconv descriptor is expensive. Descriptors are therefore
+// drawn from a global, thread-safe pool keyed by the pair of encodings,
+// and are reset and returned to the pool when the converter is closed.
 class Character_set_converter
 {
 public:
@@ -127,6 +185,7 @@ public:
   Character_set_converter& operator=(Character_set_converter&& c) noexcept;
 
   bool is_open() const;
+  bool is_native() const;
   void open(const char* fromcode, const char* tocode);
   void close();
 
@@ -135,6 +194,7 @@ public:
   Result reset_bytes(char* to, char* to_end, char*& to_next);
   Result convert_bytes(const char* from, const char* from_end, const char*& from_next, char* to, char* to_end, char*& to_next);
   std::size_t converted_byte_length(const char* from, const char* from_end);
+  std::size_t estimated_byte_length(std::size_t n) const;
 
   template<typename TargetT>
   Result reset(TargetT* to, TargetT* to_end, TargetT*& to_next);
@@ -154,13 +214,23 @@ public:
   template<typename TargetT, typename SourceT>
   std::basic_string<TargetT> convert(const std::basic_string<SourceT>& str);
 
+  template<typename TargetT, typename SourceT>
+  void convert(const SourceT* str, typename std::basic_string<SourceT>::size_type n, std::basic_string<TargetT>& out);
+
+  template<typename TargetT, typename SourceT>
+  void convert(const std::basic_string<SourceT>& str, std::basic_string<TargetT>& out);
+
   template<typename TargetT, typename InputIterator>
   std::basic_string<TargetT> convert(InputIterator first, InputIterator last);
 
   void swap(Character_set_converter& c) noexcept;
 
 private:
-  void* m_rep;
+  void*    m_rep;    // The iconv descriptor, if any
+  int      m_key;    // The pool key of the descriptor
+  int      m_from;   // The built-in source encoding, or -1
+  int      m_to;     // The built-in target encoding, or -1
+  unsigned m_state;  // The byte order state of a built-in conversion
 };
 
 
@@ -6,7 +6,7 @@
 
 #include <lingo/string.hpp>
 
-#include <memory>
+#include <cstring>
 #include <type_traits>
 
 #define DIV_CEIL(a, b) (((a) + (b) - 1) / (b))
@@ -146,6 +146,147 @@ to_unescaped(const CharT* str, CharT** str_end)
 }
 
 
+namespace unescaping
+{
+
+// Returns a pointer to the first backslash in [first, last), or last if there
+// is none.
+template<typename CharT>
+inline const CharT*
+find_backslash(const CharT* first, const CharT* last)
+{
+  return std::find(first, last, static_cast<CharT>('\\'));
+}
+
+
+inline const char*
+find_backslash(const char* first, const char* last)
+{
+  const void* p = std::memchr(first, '\\', last - first);
+  return p ? static_cast<const char*>(p) : last;
+}
+
+
+// Returns the value of the digit c in base 8 or 16, or -1 if c is not a digit
+// in that base.
+template<typename CharT>
+inline int
+digit(CharT c, int base)
+{
+  int d = -1;
+  if (c >= '0' && c <= '9')
+    d = c - '0';
+  else if (c >= 'a' && c <= 'f')
+    d = c - 'a' + 10;
+  else if (c >= 'A' && c <= 'F')
+    d = c - 'A' + 10;
+  return d < base ? d : -1;
+}
+
+
+// Accumulate up to n digits in the given base from [p, last), advancing p
+// past them. At least one digit is required.
+template<typename CharT>
+std::uint32_t
+digits(const CharT*& p, const CharT* last, int n, int base)
+{
+  std::uint32_t v = 0;
+  const CharT* start = p;
+  for (int d; n != 0 && p != last && (d = digit(*p, base)) >= 0; --n, ++p)
+    v = v * base + d;
+  if (p == start)
+    throw std::invalid_argument("lingo::unescape");
+  return v;
+}
+
+
+// Decode the escape sequence at p, which points past its backslash, and
+// advance p past the sequence. Hexadecimal and octal escapes denote
+// code units, and are truncated to the unsigned type of UCharT.
+template<typename UCharT, typename CharT>
+UCharT
+escape(const CharT*& p, const CharT* last)
+{
+  typedef typename std::make_unsigned<UCharT>::type unsigned_type;
+
+  if (p == last)
+    throw std::invalid_argument("lingo::unescape");
+  std::uint32_t v;
+  switch (*p++) {
+    case static_cast<CharT>('\''): return static_cast<UCharT>('\'');
+    case static_cast<CharT>('\"'): return static_cast<UCharT>('\"');
+    case static_cast<CharT>('\?'): return static_cast<UCharT>('\?');
+    case static_cast<CharT>('\\'): return static_cast<UCharT>('\\');
+    case static_cast<CharT>('a'): return static_cast<UCharT>('\a');
+    case static_cast<CharT>('b'): return static_cast<UCharT>('\b');
+    case static_cast<CharT>('f'): return static_cast<UCharT>('\f');
+    case static_cast<CharT>('n'): return static_cast<UCharT>('\n');
+    case static_cast<CharT>('r'): return static_cast<UCharT>('\r');
+    case static_cast<CharT>('t'): return static_cast<UCharT>('\t');
+    case static_cast<CharT>('v'): return static_cast<UCharT>('\v');
+    case static_cast<CharT>('x'):
+      v = digits(p, last, 2, 16);
+      return static_cast<UCharT>(static_cast<unsigned_type>(v));
+    case static_cast<CharT>('u'):
+      v = digits(p, last, 4, 16);
+      break;
+    case static_cast<CharT>('U'):
+      v = digits(p, last, 8, 16);
+      if (v > UNICODE_MAX)
+        throw std::out_of_range("lingo::unescape");
+      break;
+    default:
+      --p;
+      v = digits(p, last, 3, 8);
+      return static_cast<UCharT>(static_cast<unsigned_type>(v));
+  }
+
+  // Universal character names must be representable.
+  if (v > static_cast<std::uint32_t>(std::numeric_limits<UCharT>::max()))
+    throw std::out_of_range("lingo::unescape");
+  return static_cast<UCharT>(v);
+}
+
+} // namespace unescaping
+
+
+template<typename UCharT, typename CharT>
+void
+unescape(const CharT* first, const CharT* last, std::basic_string<UCharT>& out)
+{
+  typedef std::numeric_limits<CharT> source_limits;
+  typedef std::numeric_limits<UCharT> target_limits;
+
+  // True when every source character is a target character, so that runs
+  // can be appended without checking each character. The limits are
+  // compared as the widest types of their signedness, since the
+  // character types may differ in signedness.
+  constexpr bool widening =
+    std::intmax_t(source_limits::min()) >= std::intmax_t(target_limits::min()) &&
+    std::uintmax_t(source_limits::max()) <= std::uintmax_t(target_limits::max());
+
+  out.reserve(out.size() + (last - first));
+  while (first != last) {
+    const CharT* p = unescaping::find_backslash(first, last);
+    if (widening) {
+      out.append(first, p);
+    } else {
+      for (const CharT* q = first; q != p; ++q) {
+        if (std::intmax_t(*q) < std::intmax_t(target_limits::min()) ||
+            (*q > 0 && std::uintmax_t(*q) > std::uintmax_t(target_limits::max())))
+          throw std::out_of_range("lingo::unescape");
+        out.push_back(static_cast<UCharT>(*q));
+      }
+    }
+    if (p == last)
+      break;
+    ++p;
+    out.push_back(unescaping::escape<UCharT>(p, last));
+    first = p;
+  }
+}
+
+
 // -------------------------------------------------------------------------- //
 //                         Character set conversion
 
@@ -182,44 +323,83 @@ Character_set_converter::convert(SourceT c)
 }
 
 
+// Convert the string str of n characters, and append the result to
+// out. The output is written directly into out, which is grown as
+// needed, starting from an estimate of the converted length. This
+// makes a single pass over the input, and lets the caller reuse the
+// storage of out across many conversions.
+//
+// If out is not empty, the result is appended at the end of its
+// last code unit.
 template<typename TargetT, typename SourceT>
-std::basic_string<TargetT>
-Character_set_converter::convert(const SourceT* str, typename std::basic_string<SourceT>::size_type n)
+void
+Character_set_converter::convert(const SourceT* str, typename std::basic_string<SourceT>::size_type n, std::basic_string<TargetT>& out)
 {
+  // The number of bytes of free space at which a partial conversion
+  // is taken to mean that the output is full.
+  constexpr std::size_t min_room = 16;
+
   if (n == std::basic_string<SourceT>::npos)
     n = std::char_traits<SourceT>::length(str);
 
-  const std::size_t in_buf_size = n;
-  const SourceT* in_buf = str;
-  const SourceT* in_buf_next;
+  const char* in = reinterpret_cast<const char*>(str);
+  const char* in_end = in + n * sizeof(SourceT);
 
-  const std::size_t out_buf_size = converted_length<TargetT>(in_buf, in_buf + in_buf_size);
-  // Wrap out_buf in a std::unique_ptr for exception safety.
-  std::unique_ptr<TargetT[]> out_buf_ptr(new TargetT[out_buf_size]);
-  TargetT* out_buf = out_buf_ptr.get();
-  TargetT* out_buf_next;
+  const std::size_t start = out.size();
+  std::size_t used = start * sizeof(TargetT);
+  std::size_t cap = used + estimated_byte_length(in_end - in) + min_room;
 
   // Reset to initial shift state first.
   reset();
-  // Perform character set conversion.
-  Result conversion_result = convert(in_buf, in_buf + in_buf_size, in_buf_next, out_buf, out_buf + out_buf_size, out_buf_next);
 
-  switch (conversion_result) {
-    case ok:
+  // Perform character set conversion, growing the output when it
+  // is full. A partial conversion with room to spare stops at an
+  // incomplete character, which is ignored.
+  while (true) {
+    out.resize(DIV_CEIL(cap, sizeof(TargetT)));
+    char* base = reinterpret_cast<char*>(&out[0]);
+    char* to_next;
+    Result r = convert_bytes(in, in_end, in, base + used, base + cap, to_next);
+    used = to_next - base;
+    if (r == error) {
+      out.resize(start);
+      throw std::invalid_argument("lingo::Character_set_converter::convert");
+    }
+    if (r == ok || cap - used >= min_room)
       break;
-    case partial:
-      // Write the termination/reset character sequence.
-      conversion_result = reset(out_buf_next, out_buf + out_buf_size, out_buf_next);
-      lingo_assert(conversion_result == ok);
+    cap *= 2;
+  }
+
+  // Write the termination/reset character sequence.
+  while (true) {
+    char* base = reinterpret_cast<char*>(&out[0]);
+    char* to_next;
+    Result r = reset_bytes(base + used, base + cap, to_next);
+    used = to_next - base;
+    if (r == ok)
       break;
-    case error:
-      throw std::invalid_argument("lingo::Character_set_converter::convert");
+    cap *= 2;
+    out.resize(DIV_CEIL(cap, sizeof(TargetT)));
   }
 
-  std::basic_string<TargetT> result;
-  result.reserve(out_buf_size);
-  result.assign(reinterpret_cast<TargetT*>(out_buf), out_buf_size);
+  out.resize(DIV_CEIL(used, sizeof(TargetT)));
+}
+
+
+template<typename TargetT, typename SourceT>
+inline void
+Character_set_converter::convert(const std::basic_string<SourceT>& str, std::basic_string<TargetT>& out)
+{
+  convert(str.data(), str.size(), out);
+}
+
 
+template<typename TargetT, typename SourceT>
+std::basic_string<TargetT>
+Character_set_converter::convert(const SourceT* str, typename std::basic_string<SourceT>::size_type n)
+{
+  std::basic_string<TargetT> result;
+  convert(str, n, result);
   return result;
 }
 
@@ -7,6 +7,7 @@
 #include <lingo/assert.hpp>
 
 #include <string>
+#include <type_traits>
 #include <typeinfo>
 #include <utility>
 
@@ -31,6 +32,73 @@ type_str(T const& t)
 
 // -------------------------------------------------------------------------- //
 // Dynamic type information
+//
+// A class hierarchy can replace dynamic_cast with a cheaper test by
+// storing a kind tag in its base class. Each class T of the hierarchy
+// then defines a static member function
+//
+//    static bool classof(Base const* p);
+//
+// that returns true when the object p has dynamic type T (or a type
+// derived from T), usually by comparing p's kind with a single value
+// or a range of values. When T::classof accepts a pointer to U, the
+// functions is, as, and cast use it. Otherwise, they fall back to
+// dynamic_cast.
+
+
+// Detect the static member T::classof(u), where u has type U const*.
+template<typename T, typename U>
+struct has_classof
+{
+  template<typename X>
+  static std::true_type f(decltype(X::classof(std::declval<U const*>()))*);
+
+  template<typename X>
+  static std::false_type f(...);
+
+  static constexpr bool value = decltype(f<T>(nullptr))::value;
+};
+
+
+namespace dynamic_type_impl
+{
+
+template<typename T, typename U>
+inline bool
+is(U const* u, std::true_type)
+{
+  return u && T::classof(u);
+}
+
+
+template<typename T, typename U>
+inline bool
+is(U const* u, std::false_type)
+{
+  return dynamic_cast<T const*>(u);
+}
+
+
+template<typename T, typename U>
+inline T const*
+as(U const* u, std::true_type)
+{
+  return u && T::classof(u) ? static_cast<T const*>(u) : nullptr;
+}
+
+
+template<typename T, typename U>
+inline T const*
+as(U const* u, std::false_type)
+{
+  return dynamic_cast<T const*>(u);
+}
+
+
+template<typename T, typename U>
+using use_classof = std::integral_constant<bool, has_classof<T, U>::value>;
+
+} // namespace dynamic_type_impl
 
 
 // Returns true if the object pointed to by `u` has the dynamic type `T`.
@@ -38,7 +106,7 @@ template<typename T, typename U>
 inline bool
 is(U const* u)
 {
-  return dynamic_cast<T const*>(u);
+  return dynamic_type_impl::is<T>(u, dynamic_type_impl::use_classof<T, U>());
 }
 
 
@@ -46,7 +114,7 @@ template<typename T, typename U>
 inline bool
 is(U* u)
 {
-  return dynamic_cast<T*>(u);
+  return is<T>(static_cast<U const*>(u));
 }
 
 
@@ -54,7 +122,7 @@ template<typename T, typename U>
 inline bool
 is(U const& u)
 {
-  return dynamic_cast<T const*>(&u);
+  return is<T>(&u);
 }
 
 
@@ -62,7 +130,7 @@ template<typename T, typename U>
 inline bool
 is(U& u)
 {
-  return dynamic_cast<T*>(&u);
+  return is<T>(static_cast<U const*>(&u));
 }
 
 
@@ -147,7 +215,7 @@ template<typename T, typename U>
 inline T*
 as(U* u)
 {
-  return dynamic_cast<T*>(u);
+  return const_cast<T*>(as<T>(static_cast<U const*>(u)));
 }
 
 
@@ -155,7 +223,7 @@ template<typename T, typename U>
 inline T const*
 as(U const* u)
 {
-  return dynamic_cast<T const*>(u);
+  return dynamic_type_impl::as<T>(u, dynamic_type_impl::use_classof<T, U>());
 }
 
 
@@ -165,7 +233,9 @@ template<typename T, typename U>
 inline T&
 as(U& u)
 {
-  return dynamic_cast<T&>(u);
+  if (T* t = as<T>(&u))
+    return *t;
+  throw std::bad_cast();
 }
 
 
@@ -173,7 +243,9 @@ template<typename T, typename U>
 inline T const&
 as(U const& u)
 {
-  return dynamic_cast<T const&>(u);
+  if (T const* t = as<T>(&u))
+    return *t;
+  throw std::bad_cast();
 }
 
 
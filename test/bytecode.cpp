@@ -0,0 +1,132 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "parser.hpp"
+#include "evaluator.hpp"
+#include "bytecode.hpp"
+#include "debruijn.hpp"
+
+#include "lingo/assert.hpp"
+#include "lingo/memory.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace lingo;
+using namespace calc;
+
+
+char const* prelude =
+  "true = \\a.\\b.a;\n"
+  "false = \\a.\\b.b;\n"
+  "and = \\p.\\q.p q p;\n"
+  "or = \\p.\\q.p p q;\n"
+  "not = \\p.p (\\a.\\b.b) (\\a.\\b.a);\n"
+  "zero = \\f.\\x.x;\n"
+  "succ = \\n.\\f.\\x.f (n f x);\n"
+  "plus = \\m.\\n.\\f.\\x.m f (n f x);\n"
+  "mult = \\m.\\n.\\f.m (n f);\n"
+  "pair = \\a.\\b.\\s.s a b;\n"
+  "fst = \\p.p (\\a.\\b.a);\n"
+  "snd = \\p.p (\\a.\\b.b);\n";
+
+
+String
+show(Expr const* e)
+{
+  std::stringstream ss;
+  ss << *e;
+  return ss.str();
+}
+
+
+// Returns true if the program s has the same value when it is
+// evaluated and when it is compiled and run by the virtual machine.
+// The evaluator leaves references to definitions in its values,
+// where the virtual machine has their values, so those are compared
+// by their normal forms.
+bool
+agree(String const& s)
+{
+  Expr const* e = parse(s);
+  lingo_assert(e && !is_error_node(e));
+  Evaluator eval;
+  Expr const* v1 = eval(e);
+  Vm vm;
+  Expr const* v2 = vm(compile(e));
+  if (!v1 || !v2)
+    return v1 == v2;
+  if (alpha_equivalent(v1, v2))
+    return true;
+  return normalize(lower(v1, &eval.defs_)) == normalize(lower(v2));
+}
+
+
+// Closed programs, and programs with free variables, have the same
+// values under the evaluator and the virtual machine.
+void
+test_terms()
+{
+  char const* progs[] = {
+    "\\x.x;",
+    "(\\x.x) (\\y.y);",
+    "(\\x.\\y.x) (\\a.a) (\\b.b);",
+    "(\\f.\\x.f (f x)) (\\y.y);",
+    "(\\x.\\y.y x) (\\a.a) (\\b.\\c.b c);",
+    "(\\x.\\y.x y) (\\z.\\w.z w);",
+    "(\\x.\\y.\\z.x z (y z)) (\\a.\\b.a) (\\a.\\b.a);",
+    "x;",
+    "(\\x.x) y;",
+    "(\\x.\\y.x) (\\z.y);",
+    "(\\x.\\y.\\z.x y z) (\\a.\\b.\\c.a c) (\\q.q);",
+  };
+  for (char const* p : progs)
+    lingo_assert(agree(p));
+
+  // Both fail to apply a non-abstraction.
+  Expr const* e = parse("(\\x.x) y z;");
+  int errs = 0;
+  try { Evaluator()(e); } catch (std::runtime_error&) { ++errs; }
+  try { Vm()(compile(e)); } catch (std::runtime_error&) { ++errs; }
+  lingo_assert(errs == 2);
+}
+
+
+// Programs with definitions have the same values under the evaluator
+// and the virtual machine, including the values of definitions that
+// refer to earlier ones.
+void
+test_programs()
+{
+  char const* items[] = {
+    "and true false;",
+    "or false true;",
+    "not (and true true);",
+    "or (not true) (and true true);",
+    "plus (succ zero) (succ zero);",
+    "mult (succ (succ zero)) (plus (succ zero) (succ zero));",
+    "fst (pair true false);",
+    "snd (pair zero (succ zero));",
+    "two = succ (succ zero);\nplus two two;",
+    "id = \\x.x;\nid id;\nid (succ zero);",
+  };
+  for (char const* i : items)
+    lingo_assert(agree(String(prelude) + i));
+
+  // The values are also printed the same way.
+  String p = String(prelude) + "and true true;";
+  Vm vm;
+  lingo_assert(show(Evaluator()(parse(p))) == show(vm(compile(parse(p)))));
+}
+
+
+int
+main()
+{
+  Arena_factory nodes;
+  Arena_scope scope(nodes);
+  test_terms();
+  test_programs();
+}
@@ -0,0 +1,309 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/cache.hpp"
+
+#include <ctime>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+using namespace lingo;
+
+enum
+{
+  identifier_tok
+};
+
+
+struct Expr
+{
+  enum Kind
+  {
+    int_expr,
+    var_expr,
+    add_expr
+  };
+
+  Expr(Kind k)
+    : kind_(k)
+  { }
+
+  Kind kind() const { return kind_; }
+
+  Kind kind_;
+};
+
+
+struct Int : Expr
+{
+  static constexpr Kind node_kind = int_expr;
+
+  Int(int n)
+    : Expr(node_kind), value(n)
+  { }
+
+  int value;
+};
+
+
+struct Var : Expr
+{
+  static constexpr Kind node_kind = var_expr;
+
+  Var(Identifier_sym const* n)
+    : Expr(node_kind), first(n)
+  { }
+
+  Identifier_sym const* first;
+};
+
+
+struct Add : Expr
+{
+  static constexpr Kind node_kind = add_expr;
+
+  Add(Expr const* e1, Expr const* e2)
+    : Expr(node_kind), first(e1), second(e2)
+  { }
+
+  Expr const* first;
+  Expr const* second;
+};
+
+
+using Expr_nodes = Node_list<Int, Var, Add>;
+
+
+void
+save_node_data(Node_writer& w, Int const* e)
+{
+  write_term(w, e->value);
+}
+
+
+Int const*
+load_node(Node_reader& r, Int const*)
+{
+  return Arena_scope::current().make<Int>(read_term(r, Term_tag<int>()));
+}
+
+
+// Returns a printed form of the tree rooted at e.
+std::string
+show(Expr const* e)
+{
+  if (!e)
+    return "_";
+  switch (e->kind()) {
+    case Expr::int_expr:
+      return std::to_string(static_cast<Int const*>(e)->value);
+    case Expr::var_expr:
+      return static_cast<Var const*>(e)->first->spelling();
+    case Expr::add_expr: {
+      Add const* a = static_cast<Add const*>(e);
+      return "(" + show(a->first) + " + " + show(a->second) + ")";
+    }
+  }
+  return "?";
+}
+
+
+// The directory of the cache, and the files whose results are
+// cached.
+struct Fixture
+{
+  Fixture()
+    : dir(boost::filesystem::temp_directory_path() /
+          ("lingo-cache-" + std::to_string(::getpid())))
+  { }
+
+  ~Fixture()
+  {
+    boost::filesystem::remove_all(dir);
+    for (Path const& p : paths)
+      boost::filesystem::remove(p);
+  }
+
+  // Write a source file with the text s, and return its path.
+  Path source(std::string const& s)
+  {
+    paths.push_back(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+    std::ofstream f(paths.back().native());
+    f << s;
+    return paths.back();
+  }
+
+  Path              dir;
+  std::vector<Path> paths;
+};
+
+
+// A loaded result has the tree, symbols, and diagnostics of the
+// saved result.
+void
+test_round_trip()
+{
+  Fixture fx;
+  File file(fx.source("x + 12\nx\n"));
+  {
+    Symbol_table syms;
+    Arena_factory f;
+    Arena_scope scope(f);
+    Expr const* x = f.make<Var>(cast<Identifier_sym>(syms.put_identifier(identifier_tok, "x")));
+    Expr const* e = f.make<Add>(x, f.make<Int>(12));
+
+    Diagnostic_context cxt(suppress_diags);
+    error(Location(&file, 4), "bad literal");
+    warning(Region(&file, 7, 8), "unused");
+    note(Location(), "somewhere");
+
+    Result_cache cache(fx.dir, "test-1");
+    Expr const* t = nullptr;
+    lingo_assert(!cache.load<Expr_nodes>(file, syms, t));
+    cache.save<Expr_nodes>(file, e, cxt);
+    lingo_assert(cache.stats().misses == 1);
+    lingo_assert(cache.stats().saves == 1);
+    lingo_assert(cache.size() > 0);
+  }
+
+  Symbol_table syms;
+  Arena_factory f;
+  Arena_scope scope(f);
+  Result_cache cache(fx.dir, "test-1");
+  lingo_assert(cache.size() > 0);
+  Expr const* t = nullptr;
+  {
+    Diagnostic_context cxt(suppress_diags);
+    lingo_assert(cache.load<Expr_nodes>(file, syms, t));
+    lingo_assert(show(t) == "(x + 12)");
+    lingo_assert(static_cast<Var const*>(static_cast<Add const*>(t)->first)->first == syms.get("x"));
+
+    lingo_assert(cxt.errors() == 1);
+    std::vector<Diagnostic> ds(cxt.begin(), cxt.end());
+    lingo_assert(ds.size() == 3);
+    lingo_assert(ds[0].kind == error_diag && ds[0].msg == "bad literal");
+    lingo_assert(ds[0].info.data.loc.buffer() == &file);
+    lingo_assert(ds[0].info.data.loc.offset() == 4);
+    lingo_assert(ds[1].kind == warning_diag && ds[1].info.kind == Diagnostic_info::reg_info);
+    lingo_assert(ds[1].info.data.reg.start_offset() == 7);
+    lingo_assert(ds[1].info.data.reg.end_offset() == 8);
+    lingo_assert(ds[2].kind == note_diag && !ds[2].info.data.loc);
+  }
+  lingo_assert(cache.stats().hits == 1);
+
+  // A different tool, or different text, misses.
+  Result_cache other(fx.dir, "test-2");
+  lingo_assert(!other.load<Expr_nodes>(file, syms, t));
+  File changed(fx.source("x + 13\nx\n"));
+  lingo_assert(!cache.load<Expr_nodes>(changed, syms, t));
+
+  // A null tree is a result.
+  cache.save<Expr_nodes, Expr>(changed, nullptr, std::vector<Diagnostic>());
+  t = f.make<Int>(0);
+  lingo_assert(cache.load<Expr_nodes>(changed, syms, t));
+  lingo_assert(!t);
+}
+
+
+// The least recently used results are removed when the cache
+// exceeds its limit.
+void
+test_evict()
+{
+  Fixture fx;
+  Symbol_table syms;
+  Arena_factory f;
+  Arena_scope scope(f);
+  std::vector<Diagnostic> none;
+
+  Result_cache cache(fx.dir, "test-1");
+  std::vector<std::unique_ptr<File>> files;
+  for (int i = 0; i < 8; ++i) {
+    files.emplace_back(new File(fx.source(std::to_string(i))));
+    cache.save<Expr_nodes, Expr>(*files[i], f.make<Int>(i), none);
+  }
+  std::uint64_t entry = cache.size() / 8;
+
+  // Make file i used at time i, and then use the first file.
+  std::time_t now = std::time(nullptr);
+  for (int i = 0; i < 8; ++i) {
+    Cache_key k = cache.key(*files[i]);
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx%016llx-%llx.tree",
+                  (unsigned long long)k.text, (unsigned long long)k.stamp,
+                  (unsigned long long)k.size);
+    boost::filesystem::last_write_time(fx.dir / name, now - 100 + i);
+  }
+  Expr const* t;
+  lingo_assert(cache.load<Expr_nodes>(*files[0], syms, t));
+
+  cache.evict(4 * entry);
+  lingo_assert(cache.size() == 4 * entry);
+  lingo_assert(cache.stats().evictions == 4);
+  lingo_assert(cache.load<Expr_nodes>(*files[0], syms, t) && show(t) == "0");
+  for (int i = 1; i < 5; ++i)
+    lingo_assert(!cache.load<Expr_nodes>(*files[i], syms, t));
+  for (int i = 5; i < 8; ++i)
+    lingo_assert(cache.load<Expr_nodes>(*files[i], syms, t) && show(t) == std::to_string(i));
+
+  // A cache opened with a smaller limit is trimmed.
+  Result_cache small(fx.dir, "test-1", 2 * entry);
+  lingo_assert(small.size() == 2 * entry);
+
+  // Temporary files left by a failed process are removed, but not
+  // those that may still be written.
+  Path old = fx.dir / "tmp-old";
+  Path recent = fx.dir / "tmp-recent";
+  std::ofstream(old.native()) << "partial";
+  std::ofstream(recent.native()) << "partial";
+  boost::filesystem::last_write_time(old, now - 2 * 60 * 60);
+  small.evict(2 * entry);
+  lingo_assert(!boost::filesystem::exists(old));
+  lingo_assert(boost::filesystem::exists(recent));
+  lingo_assert(small.size() == 2 * entry);
+}
+
+
+// Malformed results are misses.
+void
+test_malformed()
+{
+  Fixture fx;
+  Symbol_table syms;
+  Arena_factory f;
+  Arena_scope scope(f);
+  File file(fx.source("abc"));
+
+  Result_cache cache(fx.dir, "test-1");
+  Diagnostic_context cxt(suppress_diags);
+  error(Location(&file, 1), "oops");
+  cache.save<Expr_nodes, Expr>(file, f.make<Int>(1), cxt);
+
+  boost::filesystem::directory_iterator i(fx.dir);
+  Path diag = i->path().extension() == ".diag" ? i->path() : (++i)->path();
+  std::string data;
+  {
+    std::ifstream in(diag.native(), std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream out(diag.native(), std::ios::binary | std::ios::trunc);
+    out << data.substr(0, data.size() - 1);
+  }
+  Expr const* t;
+  lingo_assert(!cache.load<Expr_nodes>(file, syms, t));
+  lingo_assert(cache.stats().misses == 1);
+}
+
+
+int
+main()
+{
+  test_round_trip();
+  test_evict();
+  test_malformed();
+}
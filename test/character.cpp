@@ -0,0 +1,211 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/character.hpp"
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace lingo;
+
+
+// Returns the length of the run at the start of s whose
+// characters are in the classes in m.
+std::size_t
+run_length(String const& s, std::size_t n, std::uint8_t m)
+{
+  std::size_t k = n;
+  while (k != s.size() && has_char_class(s[k], m))
+    ++k;
+  return k - n;
+}
+
+
+// The bulk scanners agree with the character table for runs
+// of every length and alignment.
+void
+test_scan()
+{
+  std::uint8_t masks[] = {
+    space_class,
+    alpha_class,
+    digit_class,
+    hex_class,
+    identifier_class,
+    space_class | digit_class,
+  };
+
+  std::minstd_rand gen;
+  char const* chars = " \t\n\r\v\f_09afgzAFGZ+-(\x80\xff";
+  for (int len = 0; len < 100; ++len) {
+    for (std::uint8_t m : masks) {
+      String text;
+      for (int i = 0; i < len; ++i)
+        text += chars[gen() % std::char_traits<char>::length(chars)];
+
+      // Make some long runs.
+      if (len > 40)
+        text.replace(3, 35, 35, m & space_class ? ' ' : '7');
+
+      Buffer buf(text);
+      for (std::size_t n = 0; n <= text.size(); ++n) {
+        Character_stream cs(buf);
+        for (std::size_t i = 0; i < n; ++i)
+          cs.ignore();
+        String_view v = cs.scan_while(m);
+        lingo_assert(v.begin() == buf.begin() + n);
+        lingo_assert(std::size_t(v.size()) == run_length(text, n, m));
+        lingo_assert(cs.offset() == int(n + v.size()));
+
+        Character_stream cs2(buf);
+        for (std::size_t i = 0; i < n; ++i)
+          cs2.ignore();
+        cs2.skip_while(m);
+        lingo_assert(cs2.offset() == cs.offset());
+      }
+    }
+  }
+}
+
+
+// A token produced by the lexers below.
+struct Tok
+{
+  String      str;
+  std::size_t off;
+  Locus       loc;
+};
+
+
+// Lex identifiers and single punctuators, skipping spaces.
+template<typename Stream>
+std::vector<Tok>
+lex(Stream& cs)
+{
+  std::vector<Tok> toks;
+  while (true) {
+    cs.skip_while(space_class);
+    if (cs.eof())
+      break;
+    std::size_t off = cs.offset();
+    Location loc = cs.location();
+    cs.start();
+    if (is_identifier_char(cs.peek()))
+      cs.skip_while(identifier_class);
+    else
+      cs.ignore();
+    toks.push_back({cs.lexeme().str(), off, loc.locus()});
+  }
+  return toks;
+}
+
+
+// A chunked stream produces the same lexemes, offsets, and
+// loci as a stream over the whole buffer, for any block size.
+void
+test_chunked()
+{
+  String text;
+  std::minstd_rand gen;
+  char const* chars = "  \n\tabcxyz_019+(";
+  for (int i = 0; i < 2000; ++i)
+    text += chars[gen() % std::char_traits<char>::length(chars)];
+  text.replace(100, 300, 300, 'q');
+
+  Buffer buf(text);
+  Character_stream cs(buf);
+  std::vector<Tok> expect = lex(cs);
+
+  for (std::size_t n : {1, 2, 7, 64, 4096}) {
+    std::istringstream is(text);
+    Chunked_buffer cb(is, n);
+    Chunked_character_stream ccs(cb);
+    std::vector<Tok> toks = lex(ccs);
+    lingo_assert(toks.size() == expect.size());
+    for (std::size_t i = 0; i < toks.size(); ++i) {
+      lingo_assert(toks[i].str == expect[i].str);
+      lingo_assert(toks[i].off == expect[i].off);
+      lingo_assert(toks[i].loc == expect[i].loc);
+    }
+    lingo_assert(ccs.eof() && ccs.peek() == 0 && ccs.get() == 0);
+  }
+
+  // Read from a pipe.
+  int fds[2];
+  lingo_assert(::pipe(fds) == 0);
+  lingo_assert(::write(fds[1], text.data(), text.size()) == ssize_t(text.size()));
+  ::close(fds[1]);
+  Chunked_buffer cb(fds[0], 13);
+  Chunked_character_stream ccs(cb);
+  std::vector<Tok> toks = lex(ccs);
+  ::close(fds[0]);
+  lingo_assert(toks.size() == expect.size());
+  lingo_assert(toks.back().str == expect.back().str);
+  lingo_assert(toks.back().loc == expect.back().loc);
+}
+
+
+// The UTF-8 validator finds the first invalid sequence after runs
+// of ASCII of every length, and valid text decodes to its code points.
+void
+test_utf8()
+{
+  char const* bad[] = {
+    "\x80",             // Continuation byte
+    "\xc0\xaf",         // Overlong encoding
+    "\xe0\x80\xaf",     // Overlong encoding
+    "\xed\xa0\x80",     // Surrogate
+    "\xf4\x90\x80\x80", // Past the maximum code point
+    "\xf8",             // Invalid lead byte
+    "\xe2\x82",         // Incomplete sequence
+  };
+  for (int n = 0; n < 70; ++n) {
+    String ascii(n, 'a');
+    String text = ascii + "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80" + ascii;
+    Buffer ok(text);
+    Character_stream cs(ok);
+    lingo_assert(!cs.check_utf8());
+
+    std::u32string cps;
+    while (!cs.eof())
+      cps += cs.get_code_point();
+    lingo_assert(cps == std::u32string(n, 'a') + U"\u00e9\u20ac\U0001f600" + std::u32string(n, 'a'));
+
+    for (char const* b : bad) {
+      Buffer buf(text + b);
+      Character_stream cs(buf);
+      lingo_assert(cs.check_utf8() == buf.location(text.size()));
+    }
+  }
+}
+
+
+// A stream can be reset to read another range of its buffer.
+void
+test_reset()
+{
+  Buffer buf("ab\ncd\n");
+  Character_stream cs(buf, buf.begin(), buf.begin() + 2);
+  lingo_assert(cs.get() == 'a' && cs.get() == 'b' && cs.eof());
+  cs.reset(buf.begin() + 3, buf.begin() + 5);
+  cs.start();
+  lingo_assert(cs.location() == buf.location(3));
+  cs.advance(2);
+  lingo_assert(cs.lexeme().str() == "cd" && cs.eof());
+}
+
+
+int
+main()
+{
+  test_scan();
+  test_reset();
+  test_chunked();
+  test_utf8();
+}
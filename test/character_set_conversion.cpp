@@ -4,12 +4,182 @@
 #include "config.hpp"
 
 #include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <iconv.h>
 
 #include "lingo/assert.hpp"
 #include "lingo/unicode.hpp"
 
+using namespace lingo;
+
+
+// Convert the bytes of s with iconv. Returns false if the input is
+// invalid or incomplete.
+bool
+iconv_convert(const char* from, const char* to, const std::string& s, std::string& out)
+{
+  iconv_t cd = iconv_open(to, from);
+  lingo_assert(cd != iconv_t(-1));
+  char buf[8192];
+  char* in = const_cast<char*>(s.data());
+  std::size_t in_n = s.size();
+  char* q = buf;
+  std::size_t out_n = sizeof(buf);
+  std::size_t r = iconv(cd, &in, &in_n, &q, &out_n);
+  iconv_close(cd);
+  out.assign(buf, q);
+  return r != std::size_t(-1);
+}
+
+
+// Convert the bytes of s with a (built-in) converter, in small
+// pieces of output.
+bool
+native_convert(Encoding from, Encoding to, const std::string& s, std::string& out)
+{
+  Character_set_converter c(from, to);
+  lingo_assert(c.is_native());
+  out.clear();
+  const char* p = s.data();
+  const char* end = p + s.size();
+  while (true) {
+    char buf[7];
+    char* q;
+    auto r = c.convert_bytes(p, end, p, buf, buf + sizeof(buf), q);
+    out.append(buf, q);
+    if (r == Character_set_converter::ok)
+      return true;
+    if (r == Character_set_converter::error || q == buf)
+      return false;
+  }
+}
+
+
+// The built-in transcoders agree with iconv for random text, and
+// reject the same invalid input.
+void
+test_native()
+{
+  Encoding codes[] = {
+    UTF8_encoding,
+    UTF16_encoding,
+    UTF16_big_endian_encoding,
+    UTF16_little_endian_encoding,
+    UTF32_encoding,
+    UTF32_big_endian_encoding,
+    UTF32_little_endian_encoding,
+  };
+
+  std::minstd_rand gen;
+  char32_t samples[] = {U'a', U'z', U'\n', 0x7f, 0x80, 0xe9, 0x7ff, 0x800, 0xd7ff, 0xe000, 0xfeff, 0xffff, 0x10000, 0x1f4a9, 0x10ffff};
+  for (int i = 0; i < 50; ++i) {
+    std::u32string text;
+    for (int k = gen() % 100; k >= 0; --k)
+      text += samples[gen() % (sizeof(samples) / sizeof(*samples))];
+    std::string utf32(reinterpret_cast<const char*>(text.data()), text.size() * 4);
+
+    for (Encoding from : codes) {
+      std::string src;
+      lingo_assert(iconv_convert("UTF-32LE", get_encoding_name(from), utf32, src));
+      for (Encoding to : codes) {
+        std::string expect, out;
+        lingo_assert(iconv_convert(get_encoding_name(from), get_encoding_name(to), src, expect));
+        lingo_assert(native_convert(from, to, src, out));
+        lingo_assert(out == expect);
+      }
+    }
+  }
+
+  // ASCII is a subset of UTF-8.
+  std::string out;
+  lingo_assert(native_convert(ASCII_encoding, UTF16_little_endian_encoding, "ab", out));
+  lingo_assert(out == std::string("a\0b\0", 4));
+  lingo_assert(!native_convert(ASCII_encoding, UTF8_encoding, "\xc3\xa9", out));
+  lingo_assert(!native_convert(UTF8_encoding, ASCII_encoding, "\xc3\xa9", out));
+
+  // Invalid and incomplete input.
+  const char* invalid[] = {
+    "\x80", "\xc0\x80", "\xc3", "\xe0\x80\x80", "\xed\xa0\x80",
+    "\xf4\x90\x80\x80", "\xf8\x80\x80\x80\x80", "a\xffb",
+  };
+  for (const char* s : invalid) {
+    std::string expect;
+    lingo_assert(!iconv_convert("UTF-8", "UTF-16LE", s, expect));
+    lingo_assert(!native_convert(UTF8_encoding, UTF16_little_endian_encoding, s, out));
+    lingo_assert(out == expect);
+  }
+  lingo_assert(!native_convert(UTF16_little_endian_encoding, UTF8_encoding, std::string("\x00\xdc", 2), out));
+  lingo_assert(!native_convert(UTF16_little_endian_encoding, UTF8_encoding, std::string("\x00\xd8\x41\x00", 4), out));
+  lingo_assert(!native_convert(UTF32_little_endian_encoding, UTF8_encoding, std::string("\x00\x00\x11\x00", 4), out));
+}
+
+
+// String conversions grow their output as needed, and can append
+// to a caller's string.
+void
+test_append()
+{
+  std::string in;
+  for (int i = 0; i < 1000; ++i)
+    in += i % 3 ? "a" : u8"\U0001f34c";
+
+  Character_set_converter c(UTF8_encoding, UTF32_little_endian_encoding);
+  std::u32string s = c.convert<char32_t>(in);
+  lingo_assert(s.size() == 1000);
+  lingo_assert(s[0] == U'\U0001f34c' && s[1] == U'a');
+
+  Character_set_converter d(UTF32_little_endian_encoding, UTF8_encoding);
+  std::string out = "x";
+  d.convert(s, out);
+  d.convert(s, out);
+  lingo_assert(out == "x" + in + in);
+
+  // Conversion through iconv.
+  Character_set_converter e("UTF-8", "ISO-8859-1");
+  lingo_assert(!e.is_native());
+  std::string latin;
+  e.convert(std::string(u8"caf\u00e9"), latin);
+  lingo_assert(latin == "caf\xe9");
+}
+
+
+// Converters may be opened and closed repeatedly, and concurrently,
+// reusing pooled descriptors.
+void
+test_pool()
+{
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([] {
+      for (int i = 0; i < 1000; ++i) {
+        Character_set_converter c("UTF-8", "ISO-8859-1");
+        std::string out = c.convert<char>(std::string(u8"\u00e9t\u00e9"));
+        lingo_assert(out == "\xe9t\xe9");
+      }
+    });
+  }
+  for (std::thread& t : threads)
+    t.join();
+
+  Character_set_converter a("UTF-8", "ISO-8859-1");
+  Character_set_converter b("ISO-8859-1", "UTF-8");
+  a = std::move(b);
+  lingo_assert(a.convert<char>(std::string("\xe9")) == u8"\u00e9");
+  a.close();
+  lingo_assert(!a.is_open());
+}
+
+
 int main()
 {
+  test_native();
+  test_pool();
+  test_append();
+
   // Sample text is "I can eat glass, and it does not hurt me." in
   // Vietnamese from http://www.columbia.edu/~fdc/utf8/.
   const std::string in_str = u8"Tôi có thể ăn thủy tinh mà không hại gì.";
@@ -0,0 +1,153 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "parser.hpp"
+#include "evaluator.hpp"
+#include "debruijn.hpp"
+
+#include "lingo/assert.hpp"
+#include "lingo/memory.hpp"
+
+#include <sstream>
+
+using namespace lingo;
+using namespace calc;
+
+
+char const* prelude =
+  "true = \\a.\\b.a;\n"
+  "false = \\a.\\b.b;\n"
+  "and = \\p.\\q.p q p;\n"
+  "or = \\p.\\q.p p q;\n"
+  "not = \\p.p (\\a.\\b.b) (\\a.\\b.a);\n"
+  "zero = \\f.\\x.x;\n"
+  "succ = \\n.\\f.\\x.f (n f x);\n"
+  "plus = \\m.\\n.\\f.\\x.m f (n f x);\n";
+
+
+// Returns the last item of the program s.
+Expr const*
+last(String const& s)
+{
+  Expr const* e = parse(s);
+  lingo_assert(e && !is_error_node(e));
+  while (Seq const* q = as<Seq>(e))
+    e = q->right();
+  return e;
+}
+
+
+String
+show(Term const* t)
+{
+  std::stringstream ss;
+  ss << *t;
+  return ss.str();
+}
+
+
+// Expressions that differ in the names of bound variables lower
+// to the same term.
+void
+test_alpha()
+{
+  lingo_assert(alpha_equivalent(last("\\x.x;"), last("\\y.y;")));
+  lingo_assert(alpha_equivalent(last("\\x.\\y.x y;"), last("\\a.\\b.a b;")));
+  lingo_assert(!alpha_equivalent(last("\\x.\\y.x;"), last("\\x.\\y.y;")));
+  lingo_assert(!alpha_equivalent(last("\\x.z;"), last("\\x.x;")));
+  lingo_assert(show(lower(last("\\x.\\y.x (\\z.z y);"))) == "\\.\\.(1 \\.(0 1))");
+}
+
+
+// Evaluating a term agrees with the evaluator, and normalizing it
+// agrees with normalizing the value of the evaluator.
+void
+test_eval()
+{
+  char const* progs[] = {
+    "(\\x.x) (\\y.y);",
+    "(\\x.\\y.x) (\\a.a) (\\b.b);",
+    "(\\f.\\x.f (f x)) (\\y.y);",
+    "(\\x.\\y.y x) (\\a.a) (\\b.\\c.b c);",
+    "(\\x.\\y.x y) (\\z.\\w.z w);",
+  };
+  for (char const* p : progs) {
+    Expr const* e = last(p);
+    Evaluator eval;
+    Expr const* v = eval(e);
+    lingo_assert(lower(v) == calc::eval(lower(e)));
+    lingo_assert(normalize(lower(v)) == normalize(lower(e)));
+  }
+
+  // Capture is avoided: the free y is not bound by the inner binder.
+  Expr const* e = last("(\\x.\\y.x) (\\z.y);");
+  Expr const* v = Evaluator()(e);
+  lingo_assert(lower(v) == calc::eval(lower(e)));
+  lingo_assert(show(calc::eval(lower(e))) == "\\.\\.y");
+}
+
+
+// Programs with definitions normalize to the same terms as the
+// values of the evaluator.
+void
+test_normalizer()
+{
+  char const* items[] = {
+    "and true false;",
+    "or false true;",
+    "not (and true true);",
+    "or (not true) (and true true);",
+  };
+  for (char const* i : items) {
+    String p = String(prelude) + i;
+    Evaluator eval;
+    Expr const* v = eval(parse(p));
+    Normalizer norm;
+    lingo_assert(norm(parse(p)) == normalize(lower(v, &eval.defs_)));
+  }
+
+  // Numerals normalize under binders, which the evaluator does not.
+  Normalizer norm;
+  Term const* two = norm(parse(String(prelude) + "plus (succ zero) (succ zero);"));
+  lingo_assert(show(two) == "\\.\\.(1 (1 0))");
+  lingo_assert(norm(parse(String(prelude) + "succ (succ zero);")) == two);
+}
+
+
+// Terms made in a term scope are found in the enclosing scopes, and
+// the scope of normalized items does not affect the result.
+void
+test_scope()
+{
+  Abs const* id = cast<Abs>(last("\\x.x;"));
+  {
+    Term_scope outer;
+    App const* a = cons<App>(id, id);
+    {
+      Term_scope inner;
+      lingo_assert(cons<Abs>(id->var(), id->expr()) == id);
+      lingo_assert(cons<App>(id, id) == a);
+      lingo_assert(Term_scope::current() == &inner);
+    }
+    lingo_assert(Term_scope::current() == &outer);
+  }
+  lingo_assert(!Term_scope::current());
+
+  Normalizer norm;
+  Term const* t = norm(parse(String(prelude) + "succ zero;\nsucc (succ zero);"));
+  lingo_assert(show(t) == "\\.\\.(1 (1 0))");
+}
+
+
+int
+main()
+{
+  Arena_factory nodes;
+  Arena_scope scope(nodes);
+  test_alpha();
+  test_eval();
+  test_normalizer();
+  test_scope();
+}
@@ -0,0 +1,188 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/debug.hpp"
+
+#include <deque>
+#include <sstream>
+#include <vector>
+
+using namespace lingo;
+
+
+struct Name
+{
+  char const* str;
+};
+
+
+void
+debug(Printer& p, Name const* n)
+{
+  print_chars(p, n->str);
+}
+
+
+struct Expr
+{
+  enum Kind
+  {
+    int_expr,
+    neg_expr,
+    add_expr,
+    let_expr,
+    list_expr
+  };
+
+  Expr(Kind k)
+    : kind_(k)
+  { }
+
+  virtual ~Expr() { }
+
+  Kind kind() const { return kind_; }
+
+  Kind kind_;
+};
+
+
+struct Int : Expr
+{
+  static constexpr Kind node_kind = int_expr;
+
+  Int(int n)
+    : Expr(node_kind), first(n)
+  { }
+
+  int first;
+};
+
+
+struct Neg : Expr
+{
+  static constexpr Kind node_kind = neg_expr;
+
+  Neg(Expr const* e)
+    : Expr(node_kind), first(e)
+  { }
+
+  Expr const* first;
+};
+
+
+struct Add : Expr
+{
+  static constexpr Kind node_kind = add_expr;
+
+  Add(Expr const* e1, Expr const* e2)
+    : Expr(node_kind), first(e1), second(e2)
+  { }
+
+  Expr const* first;
+  Expr const* second;
+};
+
+
+struct Let : Expr
+{
+  static constexpr Kind node_kind = let_expr;
+
+  Let(Name const* n, Expr const* e1, Expr const* e2)
+    : Expr(node_kind), first(n), second(e1), third(e2)
+  { }
+
+  Name const* first;
+  Expr const* second;
+  Expr const* third;
+};
+
+
+struct List : Expr
+{
+  static constexpr Kind node_kind = list_expr;
+
+  List()
+    : Expr(node_kind)
+  { }
+
+  std::vector<Expr const*>::const_iterator begin() const { return elems.begin(); }
+  std::vector<Expr const*>::const_iterator end() const   { return elems.end(); }
+
+  std::vector<Expr const*> elems;
+};
+
+
+using Expr_nodes = Node_list<Int, Neg, Add, Let, List>;
+
+
+// Prints the tree rooted at e, within the given limits.
+String
+show(Expr const* e, Debug_limits lim = Debug_limits())
+{
+  std::stringstream ss;
+  {
+    Printer p(ss);
+    debug_tree<Expr_nodes>(p, e, lim);
+  }
+  return ss.str();
+}
+
+
+// Sub-terms are printed in order, and limits elide the nodes that
+// exceed them.
+void
+test_print()
+{
+  Name x {"x"};
+  Int one(1), two(2), three(3);
+  Neg neg(&two);
+  Add add(&one, &neg);
+  List list;
+  list.elems = {&three, nullptr, make_error_node<Expr>()};
+  Let let(&x, &add, &list);
+
+  lingo_assert(show(&let) == "(Let x (Add (Int 1) (Neg (Int 2))) (List (Int 3) <null> <error>))");
+
+  Debug_limits lim;
+  lim.depth = 2;
+  lingo_assert(show(&let, lim) == "(Let x (Add ... ...) (List ... <null> <error>))");
+
+  lim = Debug_limits();
+  lim.nodes = 3;
+  lingo_assert(show(&let, lim) == "(Let x (Add (Int 1) ...) ...)");
+
+  std::stringstream ss;
+  Printer p(ss);
+  lingo_assert(debug_tree<Expr_nodes>(p, (Expr const*)&add));
+  lingo_assert(!debug_tree<Expr_nodes>(p, (Expr const*)&add, lim));
+}
+
+
+// Deep trees do not exhaust the call stack.
+void
+test_deep()
+{
+  std::deque<Int> ints;
+  std::deque<Add> adds;
+  ints.emplace_back(0);
+  Expr const* e = &ints.back();
+  for (int i = 1; i <= 1000000; ++i) {
+    ints.emplace_back(i % 10);
+    adds.emplace_back(e, &ints.back());
+    e = &adds.back();
+  }
+  String s = show(e);
+  lingo_assert(s.size() == 1000000 * 14 + 7);
+  lingo_assert(s.compare(0, 10, "(Add (Add ") == 0);
+  lingo_assert(s.compare(s.size() - 9, 9, " (Int 0))") == 0);
+}
+
+
+int
+main()
+{
+  test_print();
+  test_deep();
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/dfa.hpp"
+#include "lingo/character.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lingo;
+
+enum
+{
+  let_tok,
+  in_tok,
+  lparen_tok,
+  rparen_tok,
+  arrow_tok,
+  minus_tok,
+  equal_tok,
+  equal_equal_tok,
+  identifier_tok,
+  integer_tok,
+  space_tok
+};
+
+
+constexpr Reserved spellings[] = {
+  {"let", let_tok},
+  {"in", in_tok},
+  {"(", lparen_tok},
+  {")", rparen_tok},
+  {"->", arrow_tok},
+  {"-", minus_tok},
+  {"=", equal_tok},
+  {"==", equal_equal_tok},
+};
+
+constexpr auto reserved = make_reserved_table(spellings);
+
+
+// Returns the length of the lexeme at the start of [first, last)
+// matched by a class rule.
+int
+class_match(Char_set const& f, Char_set const& r, char const* first, char const* last)
+{
+  char const* p = first;
+  if (p == last || !f[static_cast<unsigned char>(*p)])
+    return 0;
+  ++p;
+  while (p != last && r[static_cast<unsigned char>(*p)])
+    ++p;
+  return p - first;
+}
+
+
+// The scanner finds the longest match of the first rule that
+// matches, for random text.
+void
+test_match()
+{
+  Char_set id_first = make_char_set(alpha_class) | make_char_set("_");
+  Char_set id_rest = make_char_set(identifier_class);
+  Char_set digits = make_char_set(digit_class);
+  Char_set space = make_char_set(space_class);
+
+  Lexical_spec spec;
+  spec.literals(reserved);
+  spec.rule(id_first, id_rest, identifier_tok);
+  spec.rule(digits, digits, integer_tok);
+  spec.rule(space, space, space_tok);
+  Lexical_dfa dfa(spec);
+
+  auto match = [&](String const& s) {
+    return dfa.match(s.data(), s.data() + s.size());
+  };
+  lingo_assert(match("let x").kind == let_tok);
+  lingo_assert(match("letter").kind == identifier_tok && match("letter").len == 6);
+  lingo_assert(match("->").kind == arrow_tok && match("-x").kind == minus_tok);
+  lingo_assert(match("===").kind == equal_equal_tok && match("===").len == 2);
+  lingo_assert(match("1234abc").kind == integer_tok && match("1234abc").len == 4);
+  lingo_assert(match("$").kind == invalid_tok && match("$").len == 0);
+  lingo_assert(match("").len == 0);
+
+  std::minstd_rand gen;
+  char const* chars = "letin()->=_xz09 \t$";
+  for (int i = 0; i < 20000; ++i) {
+    String s;
+    for (int n = gen() % 8; n != 0; --n)
+      s += chars[gen() % std::char_traits<char>::length(chars)];
+    char const* first = s.data();
+    char const* last = first + s.size();
+
+    // Find the longest match by trying each rule in order.
+    int kind = invalid_tok;
+    int len = 0;
+    for (std::size_t k = 0; k < reserved.size(); ++k) {
+      int n = reserved[k].len;
+      if (n > len && s.compare(0, n, reserved[k].str, n) == 0) {
+        kind = reserved[k].kind;
+        len = n;
+      }
+    }
+    int n;
+    if ((n = class_match(id_first, id_rest, first, last)) > len) {
+      kind = identifier_tok;
+      len = n;
+    }
+    if ((n = class_match(digits, digits, first, last)) > len) {
+      kind = integer_tok;
+      len = n;
+    }
+    if ((n = class_match(space, space, first, last)) > len) {
+      kind = space_tok;
+      len = n;
+    }
+
+    Lexical_match m = dfa.match(first, last);
+    lingo_assert(m.kind == kind && m.len == len);
+  }
+
+  // Scan the tokens of a buffer.
+  Buffer buf("let f = (x) -> x in f 42");
+  Character_stream cs(buf);
+  std::vector<int> kinds;
+  while (!cs.eof()) {
+    cs.start();
+    Lexical_match m = dfa.scan(cs);
+    lingo_assert(m.len == cs.lexeme().size());
+    if (m.kind != space_tok)
+      kinds.push_back(m.kind);
+  }
+  std::vector<int> expect {
+    let_tok, identifier_tok, equal_tok, lparen_tok, identifier_tok,
+    rparen_tok, arrow_tok, identifier_tok, in_tok, identifier_tok,
+    integer_tok
+  };
+  lingo_assert(kinds == expect);
+}
+
+
+int
+main()
+{
+  test_match();
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/dispatch.hpp"
+
+#include <stdexcept>
+
+using namespace lingo;
+
+
+// A closed hierarchy of expressions. The kinds are not dense,
+// and the node list is not in the order of their kinds.
+struct Expr
+{
+  enum Kind
+  {
+    int_expr = 3,
+    add_expr = 0,
+    neg_expr = 7
+  };
+
+  Expr(Kind k)
+    : kind_(k)
+  { }
+
+  Kind kind() const { return kind_; }
+
+  Kind kind_;
+};
+
+
+struct Int : Expr
+{
+  static constexpr Kind node_kind = int_expr;
+
+  Int(int n)
+    : Expr(node_kind), value(n)
+  { }
+
+  int value;
+};
+
+
+struct Add : Expr
+{
+  static constexpr Kind node_kind = add_expr;
+
+  Add(Expr const* e1, Expr const* e2)
+    : Expr(node_kind), first(e1), second(e2)
+  { }
+
+  Expr const* first;
+  Expr const* second;
+};
+
+
+struct Neg : Expr
+{
+  static constexpr Kind node_kind = neg_expr;
+
+  Neg(Expr const* e)
+    : Expr(node_kind), first(e)
+  { }
+
+  Expr const* first;
+};
+
+
+using Expr_nodes = Node_list<Int, Add, Neg>;
+
+
+struct Eval_fn
+{
+  int operator()(Int const* e) const { return e->value; }
+  int operator()(Add const* e) const { return dispatch<Expr_nodes>(e->first, *this) + dispatch<Expr_nodes>(e->second, *this); }
+  int operator()(Neg const* e) const { return -dispatch<Expr_nodes>(e->first, *this); }
+};
+
+
+// Counts the nodes of each kind.
+struct Count_fn
+{
+  void operator()(Int const*) { ++ints; }
+  void operator()(Add const*) { ++adds; }
+  void operator()(Neg const*) { ++negs; }
+
+  int& ints;
+  int& adds;
+  int& negs;
+};
+
+
+void
+test_dispatch()
+{
+  Int one(1);
+  Int two(2);
+  Neg neg(&two);
+  Add add(&one, &neg);
+  Expr const* exprs[] = {&one, &two, &neg, &add};
+  lingo_assert(dispatch<Expr_nodes>(exprs[3], Eval_fn{}) == -1);
+  lingo_assert(dispatch<Expr_nodes>(exprs[0], Eval_fn{}) == 1);
+
+  int ints = 0, adds = 0, negs = 0;
+  Count_fn count{ints, adds, negs};
+  for (Expr const* e : exprs)
+    dispatch<Expr_nodes>(e, count);
+  lingo_assert(ints == 2 && adds == 1 && negs == 1);
+
+  // A kind that is not in the list is unreachable.
+  Expr bad((Expr::Kind)5);
+  bool thrown = false;
+  try {
+    dispatch<Expr_nodes>(&bad, Eval_fn{});
+  } catch (std::runtime_error&) {
+    thrown = true;
+  }
+  lingo_assert(thrown);
+}
+
+
+int
+main()
+{
+  test_dispatch();
+}
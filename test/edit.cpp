@@ -0,0 +1,127 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/edit.hpp"
+
+#include <random>
+
+using namespace lingo;
+
+
+// Check that the buffer agrees with a buffer built from the
+// same text.
+void
+check(Edit_buffer const& buf, String const& text)
+{
+  lingo_assert(buf.size() == text.size());
+  lingo_assert(buf.text() == text);
+  Buffer ref(text);
+  for (std::size_t n = 0; n <= text.size(); ++n) {
+    lingo_assert(buf.locus(n) == ref.locus(n));
+    Line a = buf.line(n);
+    Line b = ref.line(n);
+    lingo_assert(a.number() == b.number());
+    lingo_assert(a.offset() == b.offset());
+    lingo_assert(a.str().str() == b.str().str());
+  }
+}
+
+
+// Random edits agree with the same edits on a string.
+void
+test_edits()
+{
+  std::minstd_rand gen;
+  char const* chars = "ab\n";
+  String text = "first\nsecond\n\nthird";
+  Edit_buffer buf(text);
+  check(buf, text);
+  for (int i = 0; i < 300; ++i) {
+    int n = gen() % (text.size() + 1);
+    if (gen() % 3) {
+      String s;
+      for (int k = gen() % 5; k >= 0; --k)
+        s += chars[gen() % 3];
+      buf.insert(n, s);
+      text.insert(n, s);
+    } else {
+      int m = n + gen() % (text.size() - n + 1);
+      buf.erase(n, m);
+      text.erase(n, m - n);
+    }
+    check(buf, text);
+  }
+
+  // The character sequence is updated by sync().
+  buf.sync();
+  lingo_assert(buf.str() == text);
+  lingo_assert(int(buf.lines().size()) == buf.line(text.size()).number());
+}
+
+
+// Locations are remapped through the edit log.
+void
+test_remap()
+{
+  Edit_buffer buf("abc def ghi");
+  Location d = buf.location(4);
+  Location g = buf.location(8);
+  Edit_buffer::Version v = buf.version();
+
+  buf.insert(0, "xx");  // xxabc def ghi
+  buf.erase(6, 10);     // xxabc ghi
+  lingo_assert(buf.remap(d, v).offset() == 6);
+  lingo_assert(buf.remap(g, v).offset() == 6);
+  lingo_assert(buf.remap(0, v) == 2);
+  lingo_assert(buf.remap(g, v + 1).offset() == 6);
+
+  // Typing extends a location's buffer without changing it.
+  for (char c = 'a'; c != 'z'; ++c)
+    buf.insert(buf.size(), String(1, c));
+  buf.sync();
+  lingo_assert(d.buffer() == &buf);
+  lingo_assert(buf.remap(d, v).locus() == Locus(1, 7));
+}
+
+
+// The changes since a version replace a range of that version
+// with a range of the current text.
+void
+test_changes()
+{
+  std::minstd_rand gen(7);
+  String orig = "abcdefghijklmnopqrstuvwxyz";
+  Edit_buffer buf(orig);
+  lingo_assert(buf.changes(0).erased == 0 && buf.changes(0).inserted == 0);
+  for (int i = 0; i < 500; ++i) {
+    int n = buf.size();
+    int k = gen() % (n + 1);
+    if (gen() % 2)
+      buf.insert(k, String(gen() % 4 + 1, 'A' + i % 26));
+    else
+      buf.erase(k, std::min(n, k + int(gen() % 4)));
+
+    Edit_buffer::Edit e = buf.changes(0);
+    String text = buf.text();
+    lingo_assert(e.off + e.erased <= int(orig.size()));
+    lingo_assert(orig.compare(0, e.off, text, 0, e.off) == 0);
+    lingo_assert(orig.substr(e.off + e.erased) == text.substr(e.off + e.inserted));
+  }
+
+  Edit_buffer::Version v = buf.version();
+  buf.insert(3, "xyz");
+  buf.erase(1, 4);
+  Edit_buffer::Edit e = buf.changes(v);
+  lingo_assert(e.off == 1 && e.erased == 2 && e.inserted == 2);
+}
+
+
+int
+main()
+{
+  test_edits();
+  test_remap();
+  test_changes();
+}
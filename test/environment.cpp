@@ -0,0 +1,89 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/assert.hpp"
+#include "lingo/environment.hpp"
+
+#include <map>
+#include <string>
+
+using namespace lingo;
+
+
+// Inner scopes shadow bindings, which are restored when
+// the scope is popped.
+void
+test_scoped()
+{
+  Scoped_environment<std::string, int> env;
+  env.bind("x", 0);
+  env.push_scope();
+  env.bind("x", 1);
+  env.bind("y", 2);
+  env.push_scope();
+  env.bind("x", 3);
+  env.bind("x", 4);
+  lingo_assert(env.depth() == 2);
+  lingo_assert(env.lookup("x")->second == 4);
+  lingo_assert(env.lookup("y")->second == 2);
+
+  env.pop_scope();
+  lingo_assert(env.lookup("x")->second == 1);
+  env.pop_scope();
+  lingo_assert(env.lookup("x")->second == 0);
+  lingo_assert(!env.lookup("y"));
+  lingo_assert(env.depth() == 0);
+}
+
+
+// All names hash to the same value, to exercise collisions.
+struct Bad_hash
+{
+  std::size_t operator()(int) const { return 42; }
+};
+
+
+// Binding a name leaves the original environment unchanged.
+template<typename H>
+void
+test_persistent()
+{
+  using Env = Persistent_environment<int, int, H>;
+  std::vector<Env> envs {Env()};
+  std::map<int, int> model;
+  for (int i = 0; i < 2000; ++i) {
+    int k = (i * 7919) % 1500;
+    envs.push_back(envs.back().bind(k, i));
+  }
+  for (int i = 0; i < 2000; ++i) {
+    int k = (i * 7919) % 1500;
+    model[k] = i;
+    Env const& e = envs[i + 1];
+    lingo_assert(e.size() == model.size());
+    lingo_assert(e.lookup(k)->second == i);
+    if (i % 100 == 0) {
+      for (auto const& b : model)
+        lingo_assert(e.lookup(b.first)->second == b.second);
+      lingo_assert(!e.lookup(-1));
+    }
+  }
+  lingo_assert(envs[0].empty() && !envs[0].lookup(0));
+
+  std::size_t n = 0;
+  envs.back().for_each([&](std::pair<int, int> const& b) {
+    lingo_assert(model[b.first] == b.second);
+    ++n;
+  });
+  lingo_assert(n == model.size());
+}
+
+
+int
+main()
+{
+  test_scoped();
+  test_persistent<std::hash<int>>();
+  test_persistent<Bad_hash>();
+}
@@ -0,0 +1,206 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/error.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace lingo;
+
+
+// Counts the number of times it, or a copy, is printed.
+struct Counted
+{
+  int* n;
+};
+
+
+std::ostream&
+operator<<(std::ostream& os, Counted const& x)
+{
+  ++*x.n;
+  return os << "counted";
+}
+
+
+// Diagnostics in a discarding context are counted and saved, but
+// their messages are not formatted.
+void
+test_discard()
+{
+  int n = 0;
+  Counted x {&n};
+  Diagnostic_context cxt(discard_diags);
+  lingo_assert(!would_report());
+  error("error: {}", x);
+  warning("warning: {}", x);
+  note("note: {}", x);
+  lingo_assert(n == 0);
+  lingo_assert(cxt.errors() == 1);
+  int k = 0;
+  for (Diagnostic const& d : cxt) {
+    lingo_assert(d.msg.empty());
+    ++k;
+  }
+  lingo_assert(k == 3);
+  lingo_assert(n == 0);
+}
+
+
+// Diagnostics in a suppressing context are saved, and their messages
+// are formatted only when they are inspected or emitted.
+void
+test_suppress()
+{
+  int n = 0;
+  Counted x {&n};
+  {
+    Diagnostic_context cxt(suppress_diags);
+    for (int i = 0; i < 100; ++i)
+      error(Location(), "error: {} {}", x, "text");
+    lingo_assert(cxt.errors() == 100);
+    cxt.reset();
+  }
+  lingo_assert(n == 0);
+
+  Diagnostic_context cxt(suppress_diags);
+  lingo_assert(would_report());
+  {
+    // The arguments are copied, so they need not outlive the call.
+    String s = "local";
+    error("error: {} {}", x, s);
+  }
+  lingo_assert(n == 0);
+  lingo_assert(cxt.errors() == 1);
+  for (Diagnostic const& d : cxt)
+    lingo_assert(d.msg == "error: counted local");
+  lingo_assert(n == 1);
+
+  // Messages are formatted once.
+  for (Diagnostic const& d : cxt)
+    lingo_assert(d.msg == "error: counted local");
+  lingo_assert(n == 1);
+
+  // A reporting context formats at once.
+  {
+    Diagnostic_context inner(report_diags);
+    Stream_sink sink(std::cout);
+    Diagnostic_sink* prev = set_diagnostic_sink(&sink);
+    note("note: {}", x);
+    lingo_assert(n == 2);
+    set_diagnostic_sink(prev);
+  }
+
+  // A nested context reports only if it does not discard.
+  {
+    Diagnostic_context inner(discard_diags);
+    lingo_assert(!would_report());
+  }
+  lingo_assert(would_report());
+}
+
+
+// A stream sink writes nothing until it is flushed.
+void
+test_sink()
+{
+  Buffer buf("ab\ncd ef\n");
+  std::stringstream text;
+  std::stringstream compact;
+  Stream_sink ts(text);
+  Stream_sink cs(compact, compact_diags);
+  Diagnostic d1(error_diag, Region(&buf, 6, 7), "bad\tname");
+  Diagnostic d2(warning_diag, Location(), "no location");
+  ts.write(d1);
+  cs.write(d1);
+  cs.write(d2);
+  lingo_assert(text.str().empty());
+  lingo_assert(compact.str().empty());
+
+  ts.flush();
+  cs.flush();
+  lingo_assert(text.str() == "error:2:4: bad\tname\n|    cd ef\n|       ~~\n");
+  lingo_assert(compact.str() ==
+    "error\t\t2\t4\t2\t5\tbad\\tname\n"
+    "warning\t\t0\t0\t0\t0\tno location\n");
+
+  // Reported diagnostics go to the current sink.
+  Diagnostic_sink* prev = set_diagnostic_sink(&cs);
+  compact.str("");
+  error(Location(&buf, 0), "first");
+  lingo_assert(compact.str().empty());
+  flush_diagnostics();
+  lingo_assert(compact.str() == "error\t\t1\t1\t1\t1\tfirst\n");
+  set_diagnostic_sink(prev);
+  reset_diagnostics();
+}
+
+
+// Merged diagnostics are ordered by location, regardless of the
+// order in which they were collected.
+void
+test_merge()
+{
+  Buffer b1("aaaa");
+  Buffer b2("bbbb");
+  std::vector<std::vector<Diagnostic>> diags {
+    {
+      Diagnostic(error_diag, Location(&b2, 1), "b2:1"),
+      Diagnostic(note_diag, Location(&b1, 0), "note"),
+      Diagnostic(error_diag, Location(), "none"),
+    },
+    {
+      Diagnostic(warning_diag, Location(&b1, 3), "b1:3"),
+      Diagnostic(error_diag, Location(&b2, 1), "b2:1 again"),
+    },
+    {
+      Diagnostic(error_diag, Location(&b1, 2), "b1:2"),
+    },
+  };
+
+  Diagnostic_context cxt(suppress_diags);
+  merge_diagnostics(diags);
+  std::vector<String> msgs;
+  for (Diagnostic const& d : cxt)
+    msgs.push_back(d.msg);
+  lingo_assert(msgs == std::vector<String>({"b1:2", "b1:3", "b2:1", "note", "b2:1 again", "none"}));
+  lingo_assert(cxt.errors() == 4);
+}
+
+
+// Errors reported by threads without contexts are all counted.
+void
+test_threads()
+{
+  std::stringstream ss;
+  Stream_sink sink(ss, compact_diags);
+  Diagnostic_sink* prev = set_diagnostic_sink(&sink);
+  reset_diagnostics();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i)
+    threads.emplace_back([]() {
+      for (int j = 0; j < 1000; ++j)
+        error("error");
+    });
+  for (std::thread& t : threads)
+    t.join();
+  lingo_assert(error_count() == 4000);
+  reset_diagnostics();
+  set_diagnostic_sink(prev);
+}
+
+
+int
+main()
+{
+  test_discard();
+  test_suppress();
+  test_sink();
+  test_merge();
+  test_threads();
+}
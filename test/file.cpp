@@ -0,0 +1,256 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/file.hpp"
+
+#include <fstream>
+#include <thread>
+
+using namespace lingo;
+
+
+// Write a file of n characters containing a line every
+// 64 characters, and return its path.
+Path
+make_file(std::size_t n)
+{
+  Path p = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::ofstream f(p.native());
+  for (std::size_t i = 0; i < n; ++i)
+    f.put(i % 64 == 63 ? '\n' : 'a' + i % 26);
+  return p;
+}
+
+
+void
+test_load(std::size_t n, bool mapped)
+{
+  Path p = make_file(n);
+  {
+    File f(p);
+    lingo_assert(f.is_mapped() == mapped);
+    lingo_assert(std::size_t(f.end() - f.begin()) == n);
+    lingo_assert(*f.end() == 0);
+    lingo_assert(f.begin()[0] == 'a');
+    lingo_assert(f.begin()[n - 1] == ((n - 1) % 64 == 63 ? '\n' : char('a' + (n - 1) % 26)));
+    lingo_assert(f.lines().size() == n / 64 + 1);
+  }
+  remove(p);
+}
+
+
+// Offsets are resolved to lines and columns.
+void
+test_lines()
+{
+  Buffer buf("ab\n\ncde\nf");
+  Line_map const& lines = buf.lines();
+  lingo_assert(lines.locus(0) == Locus(1, 1));
+  lingo_assert(lines.locus(2) == Locus(1, 3));
+  lingo_assert(lines.locus(3) == Locus(2, 1));
+  lingo_assert(lines.locus(6) == Locus(3, 3));
+  lingo_assert(lines.locus(8) == Locus(4, 1));
+  lingo_assert(lines.line(1).str().str() == "ab");
+  lingo_assert(lines.line(3).str().str() == "");
+  lingo_assert(lines.line(7).str().str() == "cde");
+  lingo_assert(lines.line(8).str().str() == "f");
+  lingo_assert(lines.line(8).number() == 4);
+  lingo_assert(lines.line(8).offset() == 8);
+
+  lingo_assert(lines.size() == 4);
+
+  // Queries that precede the scanned lines, and those that
+  // extend them, both work.
+  Buffer buf2("a\nb\nc\nd");
+  Location loc(&buf2, 4);
+  lingo_assert(loc.line_number() == 3 && loc.column_number() == 1);
+  lingo_assert(Location(&buf2, 0).line_number() == 1);
+  lingo_assert(Location(&buf2, 6).line_number() == 4);
+  lingo_assert(Location(&buf2, 2).line_number() == 2);
+  lingo_assert(buf2.lines().size() == 4);
+}
+
+
+// Locations are single positions from which the buffer
+// and offset are recovered.
+void
+test_locations()
+{
+  lingo_assert(sizeof(Location) == 4);
+  lingo_assert(!Location());
+  lingo_assert(Location().buffer() == nullptr);
+
+  Buffer a("abc");
+  Buffer b("");
+  Buffer c("de\nf");
+  lingo_assert(a.base() < b.base() && b.base() < c.base());
+
+  // The end of each buffer is a distinct location.
+  lingo_assert(Location(&a, 3).buffer() == &a);
+  lingo_assert(Location(&a, 3).offset() == 3);
+  lingo_assert(Location(&b, 0).buffer() == &b);
+  lingo_assert(Location(&c, 0).buffer() == &c);
+  lingo_assert(Location(&c, 4).offset() == 4);
+  lingo_assert(Location(&c, 3).locus() == Locus(2, 1));
+
+  Region r(&c, 0, 2);
+  lingo_assert(sizeof(Region) == 8);
+  lingo_assert(r.buffer() == &c);
+  lingo_assert(r.start_offset() == 0 && r.end_offset() == 2);
+
+  // Locations in a destroyed buffer no longer resolve.
+  Location loc;
+  {
+    Buffer d("xyz");
+    loc = Location(&d, 1);
+    lingo_assert(loc.buffer() == &d);
+  }
+  lingo_assert(loc.buffer() == nullptr);
+  lingo_assert(loc.offset() == -1);
+  lingo_assert(Location(&c, 1).buffer() == &c);
+}
+
+
+// Batch resolution agrees with resolving each location.
+void
+test_resolve()
+{
+  String text;
+  for (int i = 0; i < 500; ++i)
+    text += i % 7 == 0 ? '\n' : 'a';
+  Buffer a(text);
+  Buffer b("x\ny\nz");
+
+  std::vector<Location> locs;
+  for (int i = 0; i < 1000; ++i)
+    locs.push_back(Location(&a, (i * 7919) % text.size()));
+  for (int i = 0; i < 5; ++i)
+    locs.push_back(Location(&b, i));
+  locs.push_back(Location());
+  locs.push_back(Location(&a, 0));
+
+  std::vector<Locus> loci = resolve(locs);
+  lingo_assert(loci.size() == locs.size());
+  for (std::size_t i = 0; i < locs.size(); ++i) {
+    Locus l = locs[i] ? locs[i].locus() : Locus(0, 0);
+    lingo_assert(loci[i] == l);
+  }
+}
+
+
+// Different spellings of a file's path open the same file.
+void
+test_open()
+{
+  Path p = make_file(100);
+  Path q = p.parent_path() / "." / p.filename();
+  File& f1 = open_file(p.native());
+  File& f2 = open_file(p.native());
+  File& f3 = open_file(q.native());
+  lingo_assert(&f1 == &f2 && &f1 == &f3);
+  lingo_assert(&file_manager().file(f1.index()) == &f1);
+  remove(p);
+
+  bool thrown = false;
+  try {
+    open_file(p.native());
+  } catch (boost::filesystem::filesystem_error&) {
+    thrown = true;
+  }
+  lingo_assert(!thrown); // Already opened.
+
+  Path r = make_file(10);
+  remove(r);
+  try {
+    open_file(r.native());
+  } catch (boost::filesystem::filesystem_error&) {
+    thrown = true;
+  }
+  lingo_assert(thrown);
+}
+
+
+// Prefetched files are adopted by open, and errors are
+// reported when the file is opened.
+void
+test_prefetch()
+{
+  std::vector<Path> paths;
+  for (int i = 0; i < 20; ++i)
+    paths.push_back(make_file(100 + i * 5000));
+  Path missing = make_file(1);
+  remove(missing);
+  paths.push_back(missing);
+
+  file_manager().prefetch(paths);
+  file_manager().prefetch(paths);
+  for (int i = 0; i < 20; ++i) {
+    File& f = open_file(paths[i].native());
+    lingo_assert(std::size_t(f.end() - f.begin()) == std::size_t(100 + i * 5000));
+    lingo_assert(&file_manager().file(f.index()) == &f);
+    lingo_assert(&open_file(paths[i].native()) == &f);
+    remove(paths[i]);
+  }
+
+  bool thrown = false;
+  try {
+    open_file(missing.native());
+  } catch (boost::filesystem::filesystem_error&) {
+    thrown = true;
+  }
+  lingo_assert(thrown);
+}
+
+
+// Threads opening the same files share one copy of each. Files are
+// identified by inode, so the files are kept until the other tests
+// are done, and their inodes are not reused.
+std::vector<Path>
+test_threads()
+{
+  std::vector<Path> paths;
+  for (int i = 0; i < 20; ++i)
+    paths.push_back(make_file(100 + i));
+  file_manager().prefetch({paths.begin(), paths.begin() + 10});
+
+  std::vector<std::vector<File*>> files(8);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t)
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 20; ++i)
+        files[t].push_back(&open_file(paths[(i + t) % 20].native()));
+    });
+  for (std::thread& t : threads)
+    t.join();
+
+  for (int t = 0; t < 8; ++t)
+    for (int i = 0; i < 20; ++i) {
+      File* f = files[t][i];
+      lingo_assert(f == &open_file(paths[(i + t) % 20].native()));
+      lingo_assert(std::size_t(f->end() - f->begin()) == std::size_t(100 + (i + t) % 20));
+    }
+  return paths;
+}
+
+
+int
+main()
+{
+  std::vector<Path> paths = test_threads();
+  test_lines();
+  test_locations();
+  test_resolve();
+  test_open();
+  test_prefetch();
+  test_load(100, false);
+  test_load(File::map_threshold, false);
+
+  // A file whose size is a multiple of the page size is still
+  // null-terminated.
+  test_load(File::map_threshold + 4096, true);
+  test_load(File::map_threshold + 12345, true);
+  for (Path const& p : paths)
+    remove(p);
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/flat.hpp"
+
+using namespace lingo;
+
+enum Kind
+{
+  int_expr,
+  neg_expr,
+  add_expr,
+  if_expr,
+  sum_expr
+};
+
+
+using Tree = Flat_tree<Kind>;
+using Node = Flat_node<Kind>;
+
+
+static_assert(is_nullary_node<Node>(), "");
+static_assert(is_unary_node<Flat_unary<Kind>>(), "");
+static_assert(is_binary_node<Flat_binary<Kind>>(), "");
+static_assert(is_ternary_node<Flat_ternary<Kind>>(), "");
+static_assert(is_kary_node<Flat_kary<Kind>>(), "");
+static_assert(!is_nullary_node<Flat_kary<Kind>>(), "");
+
+
+// Evaluates an expression. The value of an integer is its
+// first operand.
+int
+eval(Node n)
+{
+  switch (n.kind()) {
+    case int_expr:
+      return n.operand(0);
+    case neg_expr:
+      return -eval(Flat_unary<Kind>(n).first);
+    case add_expr: {
+      Flat_binary<Kind> b(n);
+      return eval(b.first) + eval(b.second);
+    }
+    case if_expr: {
+      Flat_ternary<Kind> t(n);
+      return eval(t.first) ? eval(t.second) : eval(t.third);
+    }
+    case sum_expr: {
+      int r = 0;
+      for (Node c : Flat_kary<Kind>(n))
+        r += eval(c);
+      return r;
+    }
+  }
+  return 0;
+}
+
+
+void
+test_flat()
+{
+  Tree tree;
+  lingo_assert(tree.empty() && !tree.root());
+
+  // sum(if 1 then 2 else 3, -(4 + 5), 6)
+  Tree::Index one = tree.make(int_expr, {}, 1);
+  Tree::Index two = tree.make(int_expr, {}, 2);
+  Tree::Index three = tree.make(int_expr, {}, 3);
+  Tree::Index cond = tree.make(if_expr, {}, one, two, three);
+  Tree::Index four = tree.make(int_expr, {}, 4);
+  Tree::Index five = tree.make(int_expr, {}, 5);
+  Tree::Index add = tree.make(add_expr, {}, four, five);
+  Tree::Index neg = tree.make(neg_expr, {}, add);
+  Tree::Index six = tree.make(int_expr, {}, 6);
+  Tree::Index sum = tree.make_list(sum_expr, {}, {cond, neg, six});
+
+  lingo_assert(tree.size() == 10);
+  lingo_assert(tree.root().index == sum);
+  lingo_assert(Flat_kary<Kind>(tree.root()).size() == 3);
+  lingo_assert(Flat_binary<Kind>(tree.node(add)).second == tree.node(five));
+  lingo_assert(!tree.node(one).child(1));
+  lingo_assert(eval(tree.root()) == 2 - 9 + 6);
+
+  // A copy of a tree is independent of the original.
+  Tree copy = tree;
+  tree.clear();
+  lingo_assert(tree.empty());
+  lingo_assert(eval(copy.root()) == -1);
+}
+
+
+int
+main()
+{
+  test_flat();
+}
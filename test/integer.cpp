@@ -0,0 +1,145 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/integer.hpp"
+
+#include <cstdint>
+#include <sstream>
+
+using namespace lingo;
+
+
+// Check each operation on small integers against the same
+// operation on APInts of the same width.
+void
+check(int w, std::int64_t a, std::int64_t b)
+{
+  Integer x(w, a, true);
+  Integer y(w, b, true);
+  llvm::APInt p(w, a, true);
+  llvm::APInt q(w, b, true);
+  lingo_assert(x.impl() == p && y.impl() == q);
+
+  lingo_assert((x + y).impl() == p + q);
+  lingo_assert((x - y).impl() == p - q);
+  lingo_assert((x * y).impl() == p * q);
+  if (q != 0) {
+    lingo_assert((x / y).impl() == p.sdiv(q));
+    lingo_assert((x % y).impl() == p.srem(q));
+  }
+  lingo_assert((x & y).impl() == (p & q));
+  lingo_assert((x | y).impl() == (p | q));
+  lingo_assert((x ^ y).impl() == (p ^ q));
+  lingo_assert((-x).impl() == -p);
+  lingo_assert((~x).impl() == ~p);
+  lingo_assert((x < y) == p.slt(q));
+  lingo_assert((x == y) == (p == q));
+  lingo_assert(x.gets() == p.getSExtValue());
+  lingo_assert(x.getu() == p.getZExtValue());
+  lingo_assert(x.sign() == (p.isNegative() ? -1 : p.isStrictlyPositive()));
+
+  Integer s(w, std::uint64_t(b & 127), false);
+  llvm::APInt t(w, b & 127);
+  lingo_assert((x << s).impl() == p.shl(t));
+  lingo_assert((x >> s).impl() == p.ashr(t));
+}
+
+
+void
+test_small()
+{
+  std::int64_t vals[] = {
+    0, 1, -1, 2, -7, 42, 1000003, INT32_MAX, INT32_MIN,
+    INT64_MAX, INT64_MIN, 0x123456789, -0x987654321
+  };
+  for (int w : {8, 32, 63, 64})
+    for (std::int64_t a : vals)
+      for (std::int64_t b : vals)
+        check(w, a, b);
+
+  // Literals are 32 bits, and arithmetic wraps.
+  Integer m(std::int64_t(INT32_MAX));
+  lingo_assert(m.bits() == 32);
+  lingo_assert((m + Integer(std::int64_t(1))).gets() == INT32_MIN);
+  lingo_assert(Integer(std::int64_t(6)) * Integer(std::int64_t(7)) == Integer(std::int64_t(42)));
+}
+
+
+void
+test_wide()
+{
+  // Wider integers are computed by APInt.
+  Integer x(128, "170141183460469231731687303715884105727", 10);
+  Integer one(128, 1, true);
+  lingo_assert(x.bits() == 128 && x.is_positive());
+  lingo_assert((x + one).is_negative());
+  lingo_assert((x + one) - one == x);
+  lingo_assert(hash_value(x) == hash_value(Integer(x.impl())));
+}
+
+
+String
+str(Integer const& n)
+{
+  std::stringstream ss;
+  ss << n;
+  return ss.str();
+}
+
+
+void
+test_unbounded()
+{
+  auto u = [](std::int64_t n) { return Integer(Integer::unbounded, n, true); };
+
+  // Values that fit in 64 bits are native, and overflow promotes.
+  Integer m = u(INT64_MAX);
+  lingo_assert(!m.big() && m.bits() == Integer::unbounded);
+  Integer p = m + u(1);
+  lingo_assert(p.big() && p.is_positive());
+  lingo_assert(str(p) == "9223372036854775808");
+  lingo_assert(p - u(1) == m && !(p - u(1)).big());
+  lingo_assert(p > m && -p == u(INT64_MIN) && !(-p).big());
+  lingo_assert(-p - u(1) < u(INT64_MIN) && (-p - u(1)).is_negative());
+  lingo_assert(u(INT64_MIN) / u(-1) == p);
+  lingo_assert(u(INT64_MIN) % u(-1) == u(0));
+
+  // Factorials do not wrap.
+  Integer f = u(1);
+  for (int i = 1; i <= 30; ++i)
+    f *= u(i);
+  lingo_assert(str(f) == "265252859812191058636308480000000");
+  for (int i = 30; i >= 1; --i)
+    f /= u(i);
+  lingo_assert(f == u(1) && !f.big());
+
+  // Division rounds toward zero, as for native integers.
+  Integer b(Integer::unbounded, "-100000000000000000000007", 10);
+  lingo_assert(str(b / u(10)) == "-10000000000000000000000");
+  lingo_assert(b % u(10) == u(-7));
+
+  // Shifts and bitwise operations are two's complement.
+  Integer t = u(1) << u(100);
+  lingo_assert(str(t) == "1267650600228229401496703205376");
+  lingo_assert((t >> u(99)) == u(2));
+  lingo_assert((-t >> u(200)) == u(-1));
+  lingo_assert(((t | u(5)) & u(7)) == u(5));
+  lingo_assert((t ^ t) == u(0) && (~t) == -t - u(1));
+  lingo_assert(u(-3) << u(2) == u(-12));
+
+  // Equal values hash equally, whichever way they were computed.
+  lingo_assert(hash_value(t) == hash_value(u(1) << u(100)));
+  lingo_assert(t.impl() == llvm::APInt(102, 1).shl(100));
+  lingo_assert((-t).impl() == -llvm::APInt(102, 1).shl(100));
+}
+
+
+int
+main()
+{
+  test_small();
+  test_wide();
+  test_unbounded();
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/lexing.hpp"
+
+#include <random>
+#include <string>
+
+using namespace lingo;
+
+enum
+{
+  word_tok,
+};
+
+
+Concurrent_symbol_table syms;
+
+
+// Lex the words of a stream. A word is a run of characters
+// that are not spaces.
+void
+lex_words(Character_stream& cs, Token_stream& ts)
+{
+  while (true) {
+    cs.skip_while(space_class);
+    if (cs.eof())
+      break;
+    Location loc = cs.location();
+    cs.start();
+    while (!cs.eof() && !is_space(cs.peek()))
+      cs.ignore();
+    ts.put(Token(loc, syms.put_identifier(word_tok, cs.lexeme())));
+  }
+}
+
+
+// A line that starts with a space continues the previous
+// line, and cannot be split.
+bool
+safe_split(Buffer const&, char const* p)
+{
+  return *p != ' ';
+}
+
+
+// Parallel lexing produces the same tokens as lexing the
+// whole buffer, for any number of threads.
+void
+test_parallel()
+{
+  std::minstd_rand gen;
+  String text;
+  char const* words[] = {"a", "bc", "def", "\n", "\n ", "  "};
+  for (int i = 0; i < 20000; ++i) {
+    text += words[gen() % 6];
+    text += ' ';
+  }
+  Buffer buf(text);
+
+  Character_stream cs(buf);
+  Token_stream ts;
+  lex_words(cs, ts);
+  Token_seq const& expect = ts.tokens();
+
+  for (std::size_t n : {1, 2, 3, 8, 64}) {
+    std::vector<char const*> splits = split_buffer(buf, n, safe_split);
+    lingo_assert(splits.front() == buf.begin() && splits.back() == buf.end());
+    for (std::size_t i = 1; i + 1 < splits.size(); ++i)
+      lingo_assert(splits[i][-1] == '\n' && splits[i][0] != ' ');
+
+    Token_seq toks = lex_in_parallel(buf, lex_words, safe_split, n);
+    lingo_assert(toks.size() == expect.size());
+    for (std::size_t i = 0; i < toks.size(); ++i) {
+      lingo_assert(toks[i].symbol() == expect[i].symbol());
+      lingo_assert(toks[i].location() == expect[i].location());
+    }
+  }
+
+  // A buffer with no safe split is one chunk.
+  Buffer one("x\n y\n z");
+  lingo_assert(split_buffer(one, 8, safe_split).size() == 2);
+  lingo_assert(lex_in_parallel(one, lex_words, safe_split, 8).size() == 3);
+}
+
+
+int
+main()
+{
+  test_parallel();
+}
@@ -0,0 +1,373 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/memory.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace lingo;
+
+int destroyed = 0;
+
+struct Node
+{
+  Node(int n)
+    : first(n)
+  { }
+
+  ~Node() { ++destroyed; }
+
+  int first;
+};
+
+
+struct alignas(64) Wide
+{
+  char data[100];
+};
+
+
+void
+test_arena()
+{
+  Arena_factory f(256);
+  Node* a = f.make<Node>(1);
+  Node* b = f.make<Node>(2);
+  lingo_assert(a->first == 1 && b->first == 2);
+  lingo_assert(a != b);
+
+  // Over-aligned and oversized objects.
+  for (int i = 0; i < 10; ++i) {
+    Wide* w = f.make<Wide>();
+    lingo_assert(reinterpret_cast<std::uintptr_t>(w) % 64 == 0);
+  }
+
+  // Objects are destroyed on reset.
+  f.reset();
+  lingo_assert(destroyed == 2);
+  lingo_assert(f.arena().bytes_allocated() == 0);
+
+  // The arena is reusable after a reset.
+  for (int i = 0; i < 1000; ++i)
+    f.make<Node>(i);
+}
+
+
+// A collectable binary node.
+struct Cons
+{
+  Cons(Cons const* a, Cons const* b)
+    : first(a), second(b)
+  { }
+
+  virtual ~Cons() { }
+
+  Cons const* first;
+  Cons const* second;
+};
+
+
+void
+test_gc()
+{
+  Collecting_factory& f = gc();
+  std::size_t base = f.objects();
+  {
+    Cons* shared = f.make<Cons>(nullptr, nullptr);
+    Cons* a = f.make<Cons>(shared, shared);
+    Cons* b = f.make<Cons>(a, nullptr);
+    Reach r(b);
+    for (int i = 0; i < 10000; ++i)
+      f.make<Cons>(nullptr, nullptr);
+    lingo_assert(f.objects() == base + 10003);
+
+    // Only the objects reachable from b survive.
+    f.collect();
+    lingo_assert(f.objects() == base + 3);
+    lingo_assert(b->first == a && a->first == shared);
+
+    // Reclaimed slots are reused.
+    for (int i = 0; i < 100; ++i)
+      f.make<Cons>(b, nullptr);
+    f.collect();
+    lingo_assert(f.objects() == base + 3);
+
+    // Roots need not be destroyed in the reverse order of
+    // their construction.
+    Reach* x = new Reach(f.make<Cons>(nullptr, nullptr));
+    Reach* y = new Reach(f.make<Cons>(nullptr, nullptr));
+    delete x;
+    f.collect();
+    lingo_assert(f.objects() == base + 4);
+    delete y;
+    f.collect();
+    lingo_assert(f.objects() == base + 3);
+  }
+
+  // Without roots, everything is reclaimed.
+  f.collect();
+  lingo_assert(f.objects() == base);
+}
+
+
+// A node that identifies itself through an intrusive GC header
+// rather than by being polymorphic.
+struct Pair : Gc_header
+{
+  Pair(Pair const* a, Pair const* b)
+    : first(a), second(b)
+  { }
+
+  Pair const* first;
+  Pair const* second;
+};
+
+
+void
+test_gc_header()
+{
+  Collecting_factory& f = gc();
+  std::size_t base = f.objects();
+  {
+    Pair* leaf = f.make<Pair>(nullptr, nullptr);
+    lingo_assert(leaf->is_collected());
+
+    // An uncollected node in the middle of a collected tree
+    // is traversed, but not reclaimed.
+    Pair local(leaf, nullptr);
+    lingo_assert(!local.is_collected());
+    Pair* root = f.make<Pair>(&local, leaf);
+    Reach r(root);
+    for (int i = 0; i < 1000; ++i)
+      f.make<Pair>(root, nullptr);
+
+    f.collect();
+    lingo_assert(f.objects() == base + 2);
+    lingo_assert(root->first == &local && local.first == leaf);
+  }
+  f.collect();
+  lingo_assert(f.objects() == base);
+}
+
+
+// A uniqued binary node.
+struct Term
+{
+  Term(int n, Term const* t)
+    : first(n), second(t)
+  { }
+
+  int first;
+  Term const* second;
+};
+
+
+void
+test_unique()
+{
+  Hashed_unique_factory<Term> f;
+  Term const* t = nullptr;
+  for (int i = 0; i < 1000; ++i)
+    t = f.make(i, t);
+  lingo_assert(f.size() == 1000);
+
+  // Rebuilding the same chain finds the same objects.
+  Term const* u = nullptr;
+  for (int i = 0; i < 1000; ++i)
+    u = f.make(i, u);
+  lingo_assert(t == u);
+  lingo_assert(f.size() == 1000);
+  lingo_assert(f.make(0, nullptr) != f.make(1, nullptr));
+  lingo_assert(f.stats().hits == 1001);
+  lingo_assert(f.stats().misses == 1001);
+
+  // Finding an object does not create it.
+  lingo_assert(f.find(Term(999, t->second)) == t);
+  lingo_assert(!f.find(Term(1000, t)));
+  lingo_assert(f.size() == 1001);
+  lingo_assert(!Hashed_unique_factory<Term>().find(Term(0, nullptr)));
+}
+
+
+void
+test_stats()
+{
+  Collecting_factory& f = gc();
+  f.reset_stats();
+  f.enable_stats(true);
+  {
+    Reach r(f.make<Cons>(nullptr, nullptr));
+    for (int i = 0; i < 10; ++i)
+      f.make<Pair>(nullptr, nullptr);
+    f.collect();
+  }
+  f.enable_stats(false);
+  f.make<Cons>(nullptr, nullptr);
+  f.collect();
+
+  Collection_stats s = f.stats();
+  lingo_assert(s.collections == 2);
+  lingo_assert(s.live_objects == f.objects());
+  lingo_assert(s.types["Cons"].objects == 1);
+  lingo_assert(s.types["Pair"].objects == 10);
+  lingo_assert(s.types["Pair"].bytes >= 10 * sizeof(Pair));
+}
+
+
+// Build a list of `n` nodes.
+Cons const*
+make_list(int n)
+{
+  Cons const* l = nullptr;
+  Reach r;
+  for (int i = 0; i < n; ++i) {
+    l = gc().make<Cons>(nullptr, l);
+    r(l);
+  }
+  return l;
+}
+
+
+// Returns the length of a list.
+int
+length(Cons const* l)
+{
+  int n = 0;
+  for (; l; l = l->second)
+    ++n;
+  return n;
+}
+
+
+void
+test_policy(Collection_mode m)
+{
+  Collecting_factory& f = gc();
+  std::size_t base = f.objects();
+  Collection_policy p(m);
+  p.objects = 500;
+  p.slice = 4;
+  f.set_policy(p);
+  {
+    Cons const* l = make_list(100);
+    Reach r(l);
+
+    // Garbage is reclaimed without explicit collection.
+    for (int i = 0; i < 10000; ++i)
+      f.make<Cons>(l, nullptr);
+    lingo_assert(f.objects() < base + 1000);
+
+    // Lists built during collection are preserved.
+    for (int i = 0; i < 10; ++i) {
+      Cons const* k = make_list(100);
+      lingo_assert(length(k) == 100);
+    }
+    lingo_assert(length(l) == 100);
+  }
+  f.set_policy(Collection_policy());
+  f.collect();
+  lingo_assert(f.objects() == base);
+}
+
+
+// Build lists in several threads while the main thread collects.
+void
+test_threads()
+{
+  Collecting_factory& f = gc();
+  std::size_t base = f.objects();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < 50; ++j) {
+        Cons const* l = make_list(100);
+        Reach r(l);
+        for (int k = 0; k < 100; ++k)
+          gc().make<Cons>(l, nullptr);
+        gc().safepoint();
+        lingo_assert(length(l) == 100);
+      }
+    });
+  }
+  for (int i = 0; i < 20; ++i)
+    f.collect();
+  {
+    // Do not block collections by other threads while joining.
+    Gc_safe_region safe;
+    for (std::thread& t : threads)
+      t.join();
+  }
+  f.collect();
+  lingo_assert(f.objects() == base);
+}
+
+
+// A node with many sub-terms.
+struct Many
+{
+  using Seq = std::vector<Cons const*>;
+
+  Many(Seq const& s)
+    : seq(s)
+  { }
+
+  virtual ~Many() { }
+
+  Seq::const_iterator begin() const { return seq.begin(); }
+  Seq::const_iterator end() const   { return seq.end(); }
+
+  Seq seq;
+};
+
+
+void
+test_mark(std::size_t threads)
+{
+  Collecting_factory& f = gc();
+  std::size_t base = f.objects();
+  Collection_policy p;
+  p.mark_threads = threads;
+  f.set_policy(p);
+  {
+    // A very deep list does not exhaust the stack.
+    Cons const* l = nullptr;
+    for (int i = 0; i < 1000000; ++i)
+      l = f.make<Cons>(nullptr, l);
+    Reach r1(l);
+
+    // A very wide node is divided among threads.
+    Many::Seq seq;
+    for (int i = 0; i < 10000; ++i)
+      seq.push_back(f.make<Cons>(f.make<Cons>(nullptr, nullptr), nullptr));
+    Reach r2(f.make<Many>(seq));
+
+    for (int i = 0; i < 1000; ++i)
+      f.make<Cons>(nullptr, nullptr);
+    f.collect();
+    lingo_assert(f.objects() == base + 1000000 + 20001);
+  }
+  f.set_policy(Collection_policy());
+  f.collect();
+  lingo_assert(f.objects() == base);
+}
+
+
+int
+main()
+{
+  test_arena();
+  test_gc();
+  test_gc_header();
+  test_unique();
+  test_policy(threshold_collection);
+  test_policy(incremental_collection);
+  test_stats();
+  test_threads();
+  test_mark(1);
+  test_mark(4);
+  lingo_assert(destroyed == 1002);
+}
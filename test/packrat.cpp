@@ -0,0 +1,146 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/packrat.hpp"
+#include "lingo/node.hpp"
+
+#include <string>
+
+using namespace lingo;
+
+enum
+{
+  lparen_tok,
+  rparen_tok,
+  a_tok,
+  x_tok,
+  y_tok
+};
+
+enum
+{
+  s_prod,
+  a_prod
+};
+
+
+struct Node
+{
+  int n;
+};
+
+
+// A backtracking parser for the grammar
+//
+//    s ::= a 'x' | a 'y'
+//    a ::= '(' s ')' | 'a'
+//
+// which tries both alternatives of s from the same position.
+// Without memoization, the number of parses of a doubles with
+// each level of nesting.
+struct Parser
+{
+  Parser(Token_stream& ts, bool m)
+    : ts(ts), memo(m), calls(0)
+  { }
+
+  Node const*
+  s()
+  {
+    if (!memo)
+      return parse_s();
+    return table.memoize<Node>(s_prod, ts, [this]() { return parse_s(); });
+  }
+
+  Node const*
+  parse_s()
+  {
+    Token_stream::Position p = ts.position();
+    for (int k : {x_tok, y_tok}) {
+      Node const* n = a();
+      if (is_valid_node(n) && ts.peek().kind() == k) {
+        ts.get();
+        return n;
+      }
+      ts.reposition(p);
+    }
+    return make_error_node<Node>();
+  }
+
+  Node const*
+  a()
+  {
+    if (!memo)
+      return parse_a();
+    return table.memoize<Node>(a_prod, ts, [this]() { return parse_a(); });
+  }
+
+  Node const*
+  parse_a()
+  {
+    ++calls;
+    if (ts.peek().kind() == a_tok) {
+      ts.get();
+      return &leaf;
+    }
+    if (ts.peek().kind() != lparen_tok)
+      return make_error_node<Node>();
+    ts.get();
+    Node const* n = s();
+    if (!is_valid_node(n) || ts.peek().kind() != rparen_tok)
+      return make_error_node<Node>();
+    ts.get();
+    return n;
+  }
+
+  Token_stream& ts;
+  Parse_memo    table;
+  bool          memo;
+  int           calls;
+  Node          leaf {0};
+};
+
+
+// Memoization produces the same parse in linear time.
+void
+test_memo()
+{
+  Symbol_table syms;
+  Symbol const* l = syms.put_symbol(lparen_tok, "(");
+  Symbol const* r = syms.put_symbol(rparen_tok, ")");
+  Symbol const* a = syms.put_symbol(a_tok, "a");
+  Symbol const* y = syms.put_symbol(y_tok, "y");
+
+  // (((a y) y) y) y, nested n deep.
+  int const n = 12;
+  Token_seq toks;
+  for (int i = 0; i < n; ++i)
+    toks.emplace_back(Location(), l);
+  toks.emplace_back(Location(), a);
+  for (int i = 0; i < n; ++i) {
+    toks.emplace_back(Location(), y);
+    toks.emplace_back(Location(), r);
+  }
+  toks.emplace_back(Location(), y);
+
+  Token_stream ts1(toks);
+  Parser p1(ts1, false);
+  lingo_assert(is_valid_node(p1.s()) && ts1.eof());
+
+  Token_stream ts2(toks);
+  Parser p2(ts2, true);
+  lingo_assert(is_valid_node(p2.s()) && ts2.eof());
+
+  lingo_assert(p1.calls >= (1 << n));
+  lingo_assert(p2.calls == n + 1);
+  lingo_assert(p2.table.find(a_prod, 0)->end == ts2.tokens().size() - 1);
+}
+
+
+int
+main()
+{
+  test_memo();
+}
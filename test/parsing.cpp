@@ -0,0 +1,242 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/parsing.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+using namespace lingo;
+
+enum
+{
+  a_tok,
+  b_tok,
+  semicolon_tok,
+  lparen_tok,
+  rparen_tok
+};
+
+
+struct Node
+{
+  int n;
+};
+
+
+// Counts the a's of a chunk. A 'b' is an error, reported with the
+// number of a's that precede it.
+Node const*
+parse_chunk(Token_stream& ts)
+{
+  int n = 0;
+  for (; !ts.eof(); ts.get()) {
+    int k = ts.peek().kind();
+    if (k == a_tok)
+      ++n;
+    if (k == b_tok) {
+      error(Location(), std::to_string(n));
+      throw std::runtime_error(std::to_string(n));
+    }
+  }
+  return Arena_scope::current().make<Node>(Node {n});
+}
+
+
+struct Tokens
+{
+  Tokens()
+  {
+    a = syms.put_symbol(a_tok, "a");
+    b = syms.put_symbol(b_tok, "b");
+    semi = syms.put_symbol(semicolon_tok, ";");
+    lparen = syms.put_symbol(lparen_tok, "(");
+    rparen = syms.put_symbol(rparen_tok, ")");
+  }
+
+  void add(Symbol const* s) { toks.emplace_back(Location(), s); }
+
+  Symbol_table syms;
+  Symbol const* a;
+  Symbol const* b;
+  Symbol const* semi;
+  Symbol const* lparen;
+  Symbol const* rparen;
+  Token_seq toks;
+};
+
+
+std::vector<std::size_t>
+split(Token_seq const& toks)
+{
+  return split_tokens(toks, semicolon_tok, {lparen_tok}, {rparen_tok});
+}
+
+
+// Chunks end after top-level separators.
+void
+test_split()
+{
+  Tokens t;
+  lingo_assert(split(t.toks) == std::vector<std::size_t>({0, 0}));
+
+  // a ; ( a ; a ) ; a
+  for (Symbol const* s : {t.a, t.semi, t.lparen, t.a, t.semi, t.a, t.rparen, t.semi, t.a})
+    t.add(s);
+  lingo_assert(split(t.toks) == std::vector<std::size_t>({0, 2, 8, 9}));
+
+  // ... ; ) a ; ( a ;
+  for (Symbol const* s : {t.semi, t.rparen, t.a, t.semi, t.lparen, t.a, t.semi})
+    t.add(s);
+  lingo_assert(split(t.toks) == std::vector<std::size_t>({0, 2, 8, 10, 13, 16}));
+}
+
+
+// Chunks are parsed in order, with their own factories.
+void
+test_parallel()
+{
+  Tokens t;
+  int const n = 1000;
+  for (int i = 0; i < n; ++i) {
+    t.add(t.lparen);
+    for (int j = 0; j < i % 7; ++j) {
+      t.add(t.a);
+      t.add(t.semi);
+    }
+    t.add(t.rparen);
+    t.add(t.semi);
+  }
+
+  std::deque<Arena_factory> arenas;
+  std::vector<Node const*> nodes =
+    parse_in_parallel<Node>(t.toks, split(t.toks), arenas, parse_chunk, 4);
+  lingo_assert(arenas.size() == 4);
+  lingo_assert(nodes.size() == n);
+  for (int i = 0; i < n; ++i)
+    lingo_assert(nodes[i]->n == i % 7);
+}
+
+
+// Diagnostics without locations are emitted in chunk order, and the
+// exception of the first failing chunk is rethrown.
+void
+test_errors()
+{
+  Tokens t;
+  for (int i = 0; i < 100; ++i) {
+    for (int j = 0; j < i; ++j)
+      t.add(t.a);
+    if (i % 10 == 3)
+      t.add(t.b);
+    t.add(t.semi);
+  }
+
+  Diagnostic_context cxt(true);
+  std::deque<Arena_factory> arenas;
+  std::string what;
+  try {
+    parse_in_parallel<Node>(t.toks, split(t.toks), arenas, parse_chunk, 8);
+  } catch (std::runtime_error& err) {
+    what = err.what();
+  }
+  lingo_assert(what == "3");
+  lingo_assert(cxt.errors() == 10);
+  int i = 3;
+  for (Diagnostic const& d : cxt) {
+    lingo_assert(d.msg == std::to_string(i));
+    i += 10;
+  }
+}
+
+
+// Counts the a's of a file. A 'b' is an error, from which the file
+// recovers, and a 'c' is an error from which it does not.
+Node const*
+parse_file(File& f)
+{
+  int n = 0;
+  for (char const* p = f.begin(); p != f.end(); ++p) {
+    if (*p == 'a')
+      ++n;
+    if (*p == 'b') {
+      error(Location(), std::to_string(n));
+      return nullptr;
+    }
+    if (*p == 'c') {
+      error(Location(), std::to_string(n));
+      throw std::runtime_error(std::to_string(n));
+    }
+  }
+  return Arena_scope::current().make<Node>(Node {n});
+}
+
+
+// Files are parsed in order, and their diagnostics are emitted in
+// the order of the files.
+void
+test_files()
+{
+  std::vector<Path> paths;
+  for (int i = 0; i < 50; ++i) {
+    paths.push_back(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+    std::ofstream f(paths.back().native());
+    f << std::string(i, 'a');
+    if (i % 10 == 3)
+      f << 'b';
+  }
+
+  {
+    Diagnostic_context cxt(true);
+    std::deque<Arena_factory> arenas;
+    std::vector<Node const*> nodes = parse_files_in_parallel<Node>(paths, arenas, parse_file, 4);
+    lingo_assert(arenas.size() == 4);
+    lingo_assert(nodes.size() == 50);
+    for (int i = 0; i < 50; ++i)
+      lingo_assert(i % 10 == 3 ? !nodes[i] : nodes[i]->n == i);
+    lingo_assert(cxt.errors() == 5);
+    int i = 3;
+    for (Diagnostic const& d : cxt) {
+      lingo_assert(d.msg == std::to_string(i));
+      i += 10;
+    }
+  }
+
+  // The exception of the first failing file is rethrown.
+  std::vector<Path> more;
+  for (int i = 0; i < 10; ++i) {
+    more.push_back(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+    std::ofstream f(more.back().native());
+    f << std::string(i, 'a') << (i % 4 == 2 ? "c" : "");
+  }
+  {
+    Diagnostic_context cxt(true);
+    std::deque<Arena_factory> arenas;
+    std::string what;
+    try {
+      parse_files_in_parallel<Node>(more, arenas, parse_file, 3);
+    } catch (std::runtime_error& err) {
+      what = err.what();
+    }
+    lingo_assert(what == "2");
+    lingo_assert(cxt.errors() == 2);
+  }
+
+  for (Path const& p : paths)
+    remove(p);
+  for (Path const& p : more)
+    remove(p);
+}
+
+
+int
+main()
+{
+  test_split();
+  test_parallel();
+  test_errors();
+  test_files();
+}
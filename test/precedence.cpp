@@ -0,0 +1,145 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/precedence.hpp"
+
+#include <deque>
+#include <string>
+
+using namespace lingo;
+
+enum
+{
+  plus_tok,
+  minus_tok,
+  star_tok,
+  caret_tok,
+  equal_tok,
+  name_tok,
+  lparen_tok,
+  rparen_tok,
+};
+
+
+// An expression is represented by its fully parenthesized
+// spelling.
+struct Expr
+{
+  String str;
+};
+
+
+// Parses expressions with assignment (=, right associative),
+// addition (+ and -), multiplication (*), exponentiation (^, right
+// associative), and negation, which binds tighter than all binary
+// operators other than ^.
+struct Parser
+{
+  Parser(Symbol_table& syms, char const* text)
+  {
+    for (char const* p = text; *p; ++p) {
+      int k;
+      switch (*p) {
+        case '+': k = plus_tok; break;
+        case '-': k = minus_tok; break;
+        case '*': k = star_tok; break;
+        case '^': k = caret_tok; break;
+        case '=': k = equal_tok; break;
+        case '(': k = lparen_tok; break;
+        case ')': k = rparen_tok; break;
+        default: k = name_tok; break;
+      }
+      ts.put(Token(Location(), syms.put_symbol(k, String_view(p, p + 1))));
+    }
+
+    auto bin = [this](Token tok, Expr const* a, Expr const* b) {
+      return make("(" + a->str + tok.spelling() + b->str + ")");
+    };
+    ops.binary(equal_tok, 1, right_assoc, bin);
+    ops.binary(plus_tok, 2, left_assoc, bin);
+    ops.binary(minus_tok, 2, left_assoc, bin);
+    ops.binary(star_tok, 3, left_assoc, bin);
+    ops.binary(caret_tok, 5, right_assoc, bin);
+    ops.prefix(minus_tok, 5, [this](Token tok, Expr const* e) {
+      return make("(" + tok.spelling() + e->str + ")");
+    });
+  }
+
+  Expr const*
+  make(String const& s)
+  {
+    exprs.push_back({s});
+    return &exprs.back();
+  }
+
+  Expr const*
+  primary()
+  {
+    Token tok = ts.peek();
+    if (tok.kind() == name_tok) {
+      ts.get();
+      return make(tok.spelling());
+    }
+    if (tok.kind() == lparen_tok) {
+      ts.get();
+      Expr const* e = expr();
+      if (ts.peek().kind() != rparen_tok)
+        return make_error_node<Expr>();
+      ts.get();
+      return e;
+    }
+    return make_error_node<Expr>();
+  }
+
+  Expr const*
+  expr()
+  {
+    return ops.parse(ts, [this]() { return primary(); });
+  }
+
+  Token_stream            ts;
+  Precedence_parser<Expr> ops;
+  std::deque<Expr>        exprs;
+};
+
+
+// Returns the parenthesized form of the expression in text, or
+// "<error>" if it cannot be parsed.
+String
+parse(char const* text)
+{
+  Symbol_table syms;
+  Parser p(syms, text);
+  Expr const* e = p.expr();
+  if (is_error_node(e))
+    return "<error>";
+  lingo_assert(p.ts.eof());
+  return e->str;
+}
+
+
+void
+test_parse()
+{
+  lingo_assert(parse("a") == "a");
+  lingo_assert(parse("a+b*c") == "(a+(b*c))");
+  lingo_assert(parse("a*b+c") == "((a*b)+c)");
+  lingo_assert(parse("a-b-c") == "((a-b)-c)");
+  lingo_assert(parse("a^b^c") == "(a^(b^c))");
+  lingo_assert(parse("a=b=c+d") == "(a=(b=(c+d)))");
+  lingo_assert(parse("-a*b") == "((-a)*b)");
+  lingo_assert(parse("-a^b") == "(-(a^b))");
+  lingo_assert(parse("--a") == "(-(-a))");
+  lingo_assert(parse("(a+b)*c") == "((a+b)*c)");
+  lingo_assert(parse("a+") == "<error>");
+  lingo_assert(parse("a*(b+)") == "<error>");
+}
+
+
+int
+main()
+{
+  test_parse();
+}
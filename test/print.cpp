@@ -0,0 +1,94 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/print.hpp"
+
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+using namespace lingo;
+
+
+struct Item
+{
+  int n;
+};
+
+
+void
+print(Printer& p, Item const& x)
+{
+  print(p, "item");
+  print(p, x.n);
+}
+
+
+std::ostream&
+operator<<(std::ostream& os, Item const& x)
+{
+  // Streaming an item uses to_string, as streaming a node does.
+  return os << '<' << to_string(x, [](Printer& p, Item const& x) { print(p, x); }) << '>';
+}
+
+
+// A printer writes its text to the stream when it is destroyed, or
+// when a block of text is complete.
+void
+test_printer()
+{
+  std::stringstream ss;
+  {
+    Printer p(ss);
+    print(p, "abc");
+    print(p, ' ');
+    print(p, 42);
+    print(p, 1.5);
+    lingo_assert(ss.str().empty());
+  }
+  lingo_assert(ss.str() == "abc 421.5");
+
+  ss.str("");
+  {
+    Printer p(ss);
+    std::vector<Item> items {{1}, {2}, {3}};
+    print(p, "list");
+    print_nested(p, items);
+    print_list(p, items);
+    p.needs_newline = true;
+  }
+  lingo_assert(ss.str() == "list\n  item1\n  item2\n  item3\nitem1, item2, item3\n");
+
+  ss.str("");
+  {
+    Printer p(ss);
+    String s(Print_buffer::block_size + 1, 'x');
+    print(p, s);
+    lingo_assert(ss.str() == s);
+  }
+}
+
+
+// Strings are printed into a shared buffer, which is not disturbed
+// by nested uses.
+void
+test_to_string()
+{
+  Item x {7};
+  lingo_assert(to_string(x) == "<item7>");
+  lingo_assert(to_string("{} and {}", x, 3) == "<item7> and 3");
+
+  // Formatting flags do not carry over to the next string.
+  lingo_assert(to_string(std::setw(4)) == "");
+  lingo_assert(to_string(255) == "255");
+}
+
+
+int
+main()
+{
+  test_printer();
+  test_to_string();
+}
@@ -0,0 +1,153 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+// Enable the instrumentation of this test, whether or not the
+// library was built with it.
+#undef LINGO_PROFILE
+#define LINGO_PROFILE 1
+
+#include "lingo/assert.hpp"
+#include "lingo/profile.hpp"
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace lingo;
+
+
+void
+leaf()
+{
+  lingo_profile("leaf");
+  lingo_count("leaves", 1);
+}
+
+
+void
+recurse(int n)
+{
+  lingo_profile("recurse");
+  if (n)
+    recurse(n - 1);
+  else
+    leaf();
+}
+
+
+void
+work()
+{
+  lingo_profile("work");
+  for (int i = 0; i < 3; ++i)
+    leaf();
+  recurse(100);
+}
+
+
+// Returns the line of the report for the given region, or the
+// empty string.
+std::string
+line(std::string const& report, std::string const& name)
+{
+  std::istringstream ss(report);
+  for (std::string s; std::getline(ss, s); )
+    if (s.compare(0, name.size() + 1, name + ' ') == 0)
+      return s;
+  return "";
+}
+
+
+// Returns the number of calls in a line of the report.
+int
+calls(std::string const& s)
+{
+  std::istringstream ss(s);
+  std::string name;
+  int n = -1;
+  ss >> name >> n;
+  return n;
+}
+
+
+void
+test_report()
+{
+  reset_profile();
+  work();
+  std::stringstream ss;
+  report_profile(ss);
+  std::string r = ss.str();
+
+  // Regions are indented by the region from which they are entered.
+  // Direct recursion is collapsed.
+  lingo_assert(calls(line(r, "work")) == 1);
+  lingo_assert(calls(line(r, "  leaf")) == 3);
+  lingo_assert(calls(line(r, "  recurse")) == 1);
+  lingo_assert(calls(line(r, "    leaf")) == 1);
+  lingo_assert(calls(line(r, "leaves")) == 4);
+}
+
+
+// The profiles of all threads are merged.
+void
+test_threads()
+{
+  reset_profile();
+  std::vector<std::thread> ts;
+  for (int i = 0; i < 4; ++i)
+    ts.emplace_back(work);
+  for (std::thread& t : ts)
+    t.join();
+  work();
+  std::stringstream ss;
+  report_profile(ss);
+  std::string r = ss.str();
+  lingo_assert(calls(line(r, "work")) == 5);
+  lingo_assert(calls(line(r, "leaves")) == 20);
+}
+
+
+void
+test_trace()
+{
+  reset_profile();
+  set_profile_tracing(true);
+  work();
+  set_profile_tracing(false);
+  std::stringstream ss;
+  report_profile_trace(ss);
+  std::string r = ss.str();
+  lingo_assert(r.compare(0, 15, "{\"traceEvents\":") == 0);
+
+  // Each region is an event, except for recursive calls.
+  int n = 0;
+  for (std::size_t i = r.find("\"ph\":\"X\""); i != std::string::npos; i = r.find("\"ph\":\"X\"", i + 1))
+    ++n;
+  lingo_assert(n == 6);
+  lingo_assert(r.find("{\"name\":\"leaves\",\"ph\":\"C\"") != std::string::npos);
+}
+
+
+void
+test_options()
+{
+  Profile_options opts;
+  lingo_assert(opts.parse("--profile") && opts.report);
+  lingo_assert(!opts.parse("--trace="));
+  lingo_assert(!opts.parse("--stats"));
+  opts.report = false;
+}
+
+
+int
+main()
+{
+  test_report();
+  test_threads();
+  test_trace();
+  test_options();
+}
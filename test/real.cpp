@@ -0,0 +1,88 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/real.hpp"
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+using namespace lingo;
+
+
+String
+str(Real const& x)
+{
+  std::stringstream ss;
+  ss << x;
+  return ss.str();
+}
+
+
+// Returns true if x and y are the same value, or both NaN. The
+// payloads of NaNs differ between APFloat and the hardware.
+bool
+same(Real const& x, llvm::APFloat const& y)
+{
+  llvm::APFloat a = x.impl();
+  return a.isNaN() ? y.isNaN() : a.bitwiseIsEqual(y);
+}
+
+
+// Doubles are computed natively, with the results of APFloat.
+void
+test_double()
+{
+  double vals[] = {
+    0.0, -0.0, 1.0, -2.5, 0.1, 1e300, 1e-310,
+    std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN()
+  };
+  for (double a : vals) {
+    for (double b : vals) {
+      Real x(a);
+      Real y(b);
+      llvm::APFloat p(a);
+      llvm::APFloat q(b);
+      lingo_assert(x.is_double() && y.is_double());
+      lingo_assert(same(x + y, p + q));
+      lingo_assert(same(x - y, p - q));
+      lingo_assert(same(x * y, p * q));
+      lingo_assert(same(x / y, p / q));
+      lingo_assert((x == y) == (p.compare(q) == llvm::APFloat::cmpEqual));
+      lingo_assert((x < y) == (p.compare(q) == llvm::APFloat::cmpLessThan));
+      lingo_assert(str(x) == str(Real(p)));
+    }
+  }
+
+  // Negation subtracts from zero.
+  lingo_assert(!std::signbit((-Real(0.0)).getd()));
+  lingo_assert((-Real(2.0)).getd() == -2.0);
+
+  // An APFloat double is stored natively.
+  lingo_assert(Real(llvm::APFloat(0.5)).is_double());
+  lingo_assert(str(Real(0.5)) == "0.5");
+}
+
+
+// Other semantics are computed by APFloat.
+void
+test_other()
+{
+  Real x(llvm::APFloat(1.5f));
+  Real y(llvm::APFloat(0.25f));
+  lingo_assert(!x.is_double());
+  lingo_assert((x + y).impl().convertToFloat() == 1.75f);
+  lingo_assert(x > y && !(x == y));
+  lingo_assert(str(x * y) == "0.375");
+}
+
+
+int
+main()
+{
+  test_double();
+  test_other();
+}
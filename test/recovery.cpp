@@ -0,0 +1,132 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/recovery.hpp"
+#include "lingo/error.hpp"
+
+#include <deque>
+#include <vector>
+
+using namespace lingo;
+
+enum
+{
+  lparen_tok,
+  rparen_tok,
+  semicolon_tok,
+  identifier_tok
+};
+
+
+struct Item
+{
+  Symbol const* id;
+};
+
+
+// A parser for the grammar
+//
+//    list ::= item [';' item]*
+//    item ::= '(' identifier ')'
+struct Parser
+{
+  Parser(Token_stream& ts)
+    : ts(ts), rec(ts)
+  { }
+
+  Item const*
+  item(Token_set const& follow)
+  {
+    Token_set f = follow | Token_set{rparen_tok};
+    if (!rec.expect(lparen_tok, "(", f | Token_set{identifier_tok}))
+      return rec.fail<Item>("expected item", follow);
+    Token id = rec.expect(identifier_tok, "identifier", f);
+    if (!rec.expect(rparen_tok, ")", follow))
+      return make_error_node<Item>();
+    if (!id)
+      return make_error_node<Item>();
+    items.push_back({id.symbol()});
+    return &items.back();
+  }
+
+  std::vector<Item const*>
+  list()
+  {
+    std::vector<Item const*> v;
+    Token_set follow {semicolon_tok};
+    v.push_back(item(follow));
+    while (!ts.eof()) {
+      rec.expect(semicolon_tok, ";", follow);
+      v.push_back(item(follow));
+    }
+    return v;
+  }
+
+  Token_stream&    ts;
+  Parse_recovery   rec;
+  std::deque<Item> items;
+};
+
+
+// Returns the tokens for the given text, where each character
+// is a token.
+Token_seq
+tokenize(Symbol_table& syms, char const* text)
+{
+  Token_seq toks;
+  for (char const* p = text; *p; ++p) {
+    String_view s(p, p + 1);
+    switch (*p) {
+      case '(': toks.emplace_back(Location(), syms.put_symbol(lparen_tok, s)); break;
+      case ')': toks.emplace_back(Location(), syms.put_symbol(rparen_tok, s)); break;
+      case ';': toks.emplace_back(Location(), syms.put_symbol(semicolon_tok, s)); break;
+      default: toks.emplace_back(Location(), syms.put_identifier(identifier_tok, s)); break;
+    }
+  }
+  return toks;
+}
+
+
+// A parse with syntax errors continues to the end of input,
+// producing error nodes for the items that fail, and reporting
+// one error for each mistake.
+void
+test_recovery()
+{
+  Symbol_table syms;
+
+  Token_stream ok(tokenize(syms, "(a);(b);(c)"));
+  Parser p1(ok);
+  std::vector<Item const*> v1 = p1.list();
+  lingo_assert(v1.size() == 3 && p1.rec.errors() == 0);
+  for (Item const* i : v1)
+    lingo_assert(is_valid_node(i));
+
+  // The second item is missing its identifier, and the third is
+  // not an item. The fourth is missing its semicolon, so the next
+  // item is skipped. The fifth has extra tokens, which are skipped,
+  // and the last is not closed.
+  Token_stream bad(tokenize(syms, "(a);();x);(c)(d);(efg);(h"));
+  Parser p2(bad);
+  std::vector<Item const*> v2 = p2.list();
+  lingo_assert(bad.eof());
+  lingo_assert(v2.size() == 6);
+  lingo_assert(is_valid_node(v2[0]));
+  lingo_assert(is_error_node(v2[1]));
+  lingo_assert(is_error_node(v2[2]));
+  lingo_assert(is_valid_node(v2[3]) && v2[3]->id->spelling() == "c");
+  lingo_assert(is_valid_node(v2[4]) && v2[4]->id->spelling() == "e");
+  lingo_assert(is_error_node(v2[5]));
+
+  // The missing '(' and the invalid item are one error.
+  lingo_assert(p2.rec.errors() == 5);
+}
+
+
+int
+main()
+{
+  test_recovery();
+}
@@ -0,0 +1,253 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/reparse.hpp"
+#include "lingo/memory.hpp"
+
+#include <random>
+#include <stdexcept>
+
+using namespace lingo;
+
+enum
+{
+  lbracket_tok,
+  rbracket_tok,
+  identifier_tok
+};
+
+enum
+{
+  list_prod
+};
+
+
+Symbol_table syms;
+Arena_factory arena;
+
+
+// Returns the next token of the language of nested lists of
+// identifiers, like [a [b c] d].
+Token
+scan(Character_stream& cs)
+{
+  while (!cs.eof() && cs.peek() == ' ')
+    cs.get();
+  if (cs.eof())
+    return Token();
+  Location loc = cs.location();
+  cs.start();
+  char c = cs.get();
+  if (c == '[')
+    return Token(loc, syms.put_symbol(lbracket_tok, "["));
+  if (c == ']')
+    return Token(loc, syms.put_symbol(rbracket_tok, "]"));
+  while (!cs.eof() && cs.peek() != ' ' && cs.peek() != '[' && cs.peek() != ']')
+    cs.get();
+  return Token(loc, syms.put_identifier(identifier_tok, cs.lexeme()));
+}
+
+
+Token_seq
+lex(Buffer& buf)
+{
+  Character_stream cs(buf);
+  Token_seq toks;
+  while (Token tok = scan(cs))
+    toks.push_back(tok);
+  return toks;
+}
+
+
+struct List
+{
+  std::vector<List const*> lists;
+  std::vector<Symbol const*> ids;
+};
+
+
+bool
+operator==(List const& a, List const& b)
+{
+  if (a.ids != b.ids || a.lists.size() != b.lists.size())
+    return false;
+  for (std::size_t i = 0; i < a.lists.size(); ++i)
+    if (!(*a.lists[i] == *b.lists[i]))
+      return false;
+  return true;
+}
+
+
+// list ::= '[' {identifier | list} ']'
+//
+// Nested lists are recorded in the syntax map.
+List const*
+parse_list(Token_stream& ts, Syntax_map& map)
+{
+  if (ts.eof() || ts.get().kind() != lbracket_tok)
+    throw std::runtime_error("expected '['");
+  List* l = arena.make<List>();
+  while (!ts.eof() && ts.peek().kind() != rbracket_tok) {
+    if (ts.peek().kind() == lbracket_tok) {
+      std::size_t n = map.open(list_prod, ts.position());
+      List const* x = parse_list(ts, map);
+      map.close(n, x, ts.position());
+      l->lists.push_back(x);
+    } else {
+      l->ids.push_back(ts.get().symbol());
+    }
+  }
+  if (ts.eof())
+    throw std::runtime_error("expected ']'");
+  ts.get();
+  return l;
+}
+
+
+// Returns a copy of p in which old is replaced by x.
+List const*
+rebuild(List const* p, List const* old, List const* x)
+{
+  List* l = arena.make<List>(*p);
+  std::replace(l->lists.begin(), l->lists.end(), old, x);
+  return l;
+}
+
+
+// A document, which is reparsed after each edit.
+struct Document
+{
+  Document(String const& s)
+    : buf(s)
+  {
+    toks = lex(buf);
+    parse();
+  }
+
+  // Parse the whole buffer. Returns false if it is invalid.
+  bool parse()
+  {
+    map.clear();
+    root = nullptr;
+    try {
+      Token_stream ts(toks);
+      std::size_t n = map.open(list_prod, 0);
+      root = parse_list(ts, map);
+      map.close(n, root, ts.position());
+      if (!ts.eof())
+        root = nullptr;
+    } catch (std::runtime_error&) {
+      root = nullptr;
+    }
+    if (!root)
+      map.clear();
+    return root;
+  }
+
+  // Returns true if the update reused the previous tree.
+  bool update()
+  {
+    Edit_buffer::Edit e = buf.changes(version);
+    version = buf.version();
+    buf.sync();
+    damage = relex(buf, e, toks, scan);
+    auto fn = [](int, Token_stream& ts, Syntax_map& m) { return parse_list(ts, m); };
+    Reparse r;
+    if (reparse<List>(map, toks, damage, fn, r)) {
+      root = splice<List>(map, r, rebuild);
+      return true;
+    }
+    parse();
+    return false;
+  }
+
+  Edit_buffer          buf;
+  Edit_buffer::Version version = 0;
+  Token_seq            toks;
+  Syntax_map           map;
+  List const*          root;
+  Token_damage         damage;
+};
+
+
+// Checks that tokens are the same as those lexed from scratch.
+void
+check_tokens(Document& doc)
+{
+  Token_seq ref = lex(doc.buf);
+  lingo_assert(ref.size() == doc.toks.size());
+  for (std::size_t i = 0; i < ref.size(); ++i) {
+    lingo_assert(ref[i].symbol() == doc.toks[i].symbol());
+    lingo_assert(ref[i].location() == doc.toks[i].location());
+  }
+}
+
+
+// An edit within a nested list reparses that list, and
+// reuses its siblings.
+void
+test_reparse()
+{
+  Document doc("[a [b c] [d [e]] f]");
+  List const* root = doc.root;
+  List const* first = root->lists[0];
+  List const* inner = root->lists[1]->lists[0];
+
+  doc.buf.insert(14, " g");  // [a [b c] [d [e g]] f]
+  lingo_assert(doc.update());
+  check_tokens(doc);
+  lingo_assert(doc.damage.count <= 3);
+  lingo_assert(doc.root != root);
+  lingo_assert(doc.root->lists[0] == first);
+  lingo_assert(doc.root->lists[1]->lists[0] != inner);
+  lingo_assert(doc.root->lists[1]->lists[0]->ids.size() == 2);
+
+  // An unbalanced document is parsed from scratch.
+  doc.buf.erase(7, 8);       // [a [b c [d [e g]] f]
+  lingo_assert(!doc.update() && !doc.root);
+  doc.buf.insert(7, "]");
+  lingo_assert(!doc.update() && doc.root);
+}
+
+
+// Incremental updates agree with parsing from scratch. Edits are
+// made within the outermost list, and keep its brackets balanced.
+void
+test_random()
+{
+  std::minstd_rand gen(42);
+  char const* pieces[] = {" ", "a", "bc", " [x y] ", "[]"};
+  Document doc("[a [b c] [d [e]] f [g [h [i j] k] l] m]");
+  int reused = 0;
+  for (int i = 0; i < 2000; ++i) {
+    int n = doc.buf.size();
+    int k = 1 + gen() % (n - 1);
+    if (gen() % 3) {
+      doc.buf.insert(k, pieces[gen() % 5]);
+    } else {
+      String text = doc.buf.text();
+      int j = std::min(n, k + int(gen() % 3));
+      if (text.find_first_of("[]", k) < std::size_t(j))
+        continue;
+      doc.buf.erase(k, j);
+    }
+    reused += doc.update();
+    check_tokens(doc);
+
+    Document ref(doc.buf.text());
+    lingo_assert(bool(ref.root) == bool(doc.root));
+    if (ref.root)
+      lingo_assert(*ref.root == *doc.root);
+  }
+  lingo_assert(reused > 1000);
+}
+
+
+int
+main()
+{
+  test_reparse();
+  test_random();
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/reserved.hpp"
+
+#include <cstring>
+
+using namespace lingo;
+
+enum
+{
+  lparen_tok,
+  arrow_tok,
+  minus_tok,
+  if_tok,
+  else_tok,
+  while_tok,
+  return_tok,
+  identifier_tok,
+};
+
+
+constexpr Reserved spellings[] = {
+  {"while", while_tok},
+  {"(", lparen_tok},
+  {"->", arrow_tok},
+  {"-", minus_tok},
+  {"if", if_tok},
+  {"else", else_tok},
+  {"return", return_tok},
+};
+
+constexpr auto tokens = make_reserved_table(spellings);
+
+// Classification and reverse lookup are constant expressions.
+static_assert(tokens.kind("->", "->" + 2) == arrow_tok, "");
+static_assert(tokens.kind("-", "-" + 1) == minus_tok, "");
+static_assert(tokens.kind("els", "els" + 3) == invalid_tok, "");
+static_assert(tokens.spelling(if_tok)[0] == 'i', "");
+static_assert(tokens.spelling(identifier_tok) == nullptr, "");
+
+
+void
+test_table()
+{
+  for (Reserved const& e : spellings) {
+    lingo_assert(tokens.kind(String_view(e.str)) == e.kind);
+    lingo_assert(std::strcmp(tokens.spelling(e.kind), e.str) == 0);
+  }
+  lingo_assert(tokens.find("whilst") == -1);
+  lingo_assert(tokens.find("") == -1);
+}
+
+
+void
+test_symbols()
+{
+  Reserved_symbols<tokens.size()> reserved(tokens);
+
+  char const* text = "return x";
+  Symbol const* sym = reserved.get(text, text + 6);
+  lingo_assert(sym && sym->token() == return_tok);
+  lingo_assert(sym->spelling() == "return");
+  lingo_assert(reserved.get("return") == sym);
+  lingo_assert(!reserved.get(text + 7, text + 8));
+}
+
+
+// The punctuator trie finds the longest punctuator, and
+// does not contain keywords.
+void
+test_punctuators()
+{
+  Reserved_symbols<tokens.size()> reserved(tokens);
+  Punctuator_trie trie(reserved);
+
+  char const* text = "->-(x";
+  int len;
+  Symbol const* sym = trie.match(text, text + 5, len);
+  lingo_assert(sym == reserved.get("->") && len == 2);
+  lingo_assert(trie.match(text, text + 1, len) == reserved.get("-") && len == 1);
+  lingo_assert(trie.match(text + 2, text + 5, len)->token() == minus_tok);
+  lingo_assert(trie.match(text + 3, text + 5, len)->token() == lparen_tok);
+  lingo_assert(!trie.match(text + 4, text + 5, len) && len == 0);
+  lingo_assert(!trie.match("if", "if" + 2, len));
+
+  // Longer spellings with a common prefix, and a prefix that is
+  // not itself a punctuator.
+  Symbol_table syms;
+  char const* puncts[] = {"<", "<<", "<<=", "<=", "<=>", "...", ".*"};
+  for (char const* p : puncts)
+    trie.put(p, syms.put_symbol(0, p));
+  for (char const* p : puncts) {
+    std::size_t n = std::strlen(p);
+    lingo_assert(trie.match(p, p + n, len) == syms.get(p) && len == int(n));
+  }
+  lingo_assert(trie.match("<<<", "<<<" + 3, len) == syms.get("<<") && len == 2);
+  lingo_assert(!trie.match("..", "..", len) && !trie.match("..", ".." + 2, len));
+}
+
+
+int
+main()
+{
+  test_table();
+  test_symbols();
+  test_punctuators();
+}
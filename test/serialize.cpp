@@ -0,0 +1,273 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/serialize.hpp"
+
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+using namespace lingo;
+
+enum
+{
+  identifier_tok
+};
+
+
+struct Expr
+{
+  enum Kind
+  {
+    int_expr,
+    var_expr,
+    neg_expr,
+    add_expr,
+    if_expr,
+    list_expr
+  };
+
+  Expr(Kind k)
+    : kind_(k)
+  { }
+
+  Kind kind() const { return kind_; }
+
+  Kind kind_;
+};
+
+
+struct Int : Expr
+{
+  static constexpr Kind node_kind = int_expr;
+
+  Int(int n)
+    : Expr(node_kind), value(n)
+  { }
+
+  int value;
+};
+
+
+struct Var : Expr
+{
+  static constexpr Kind node_kind = var_expr;
+
+  Var(Identifier_sym const* n)
+    : Expr(node_kind), first(n)
+  { }
+
+  Identifier_sym const* first;
+};
+
+
+struct Neg : Expr
+{
+  static constexpr Kind node_kind = neg_expr;
+
+  Neg(Expr const* e)
+    : Expr(node_kind), first(e)
+  { }
+
+  Expr const* first;
+};
+
+
+struct Add : Expr
+{
+  static constexpr Kind node_kind = add_expr;
+
+  Add(Expr const* e1, Expr const* e2)
+    : Expr(node_kind), first(e1), second(e2)
+  { }
+
+  Expr const* first;
+  Expr const* second;
+};
+
+
+struct If : Expr
+{
+  static constexpr Kind node_kind = if_expr;
+
+  If(Expr const* e1, Expr const* e2, Expr const* e3)
+    : Expr(node_kind), first(e1), second(e2), third(e3)
+  { }
+
+  Expr const* first;
+  Expr const* second;
+  Expr const* third;
+};
+
+
+struct List : Expr
+{
+  static constexpr Kind node_kind = list_expr;
+
+  List(std::vector<Expr const*> const& v)
+    : Expr(node_kind), elems(v)
+  { }
+
+  std::vector<Expr const*>::const_iterator begin() const { return elems.begin(); }
+  std::vector<Expr const*>::const_iterator end() const   { return elems.end(); }
+
+  std::vector<Expr const*> elems;
+};
+
+
+using Expr_nodes = Node_list<Int, Var, Neg, Add, If, List>;
+using Expr_tree  = Tree_file<Expr_nodes, Expr>;
+
+
+// The value of an integer is not a sub-term.
+void
+save_node_data(Node_writer& w, Int const* e)
+{
+  write_term(w, e->value);
+}
+
+
+Int const*
+load_node(Node_reader& r, Int const*)
+{
+  return Arena_scope::current().make<Int>(read_term(r, Term_tag<int>()));
+}
+
+
+// Returns a printed form of the tree rooted at e.
+std::string
+show(Expr const* e)
+{
+  if (!e)
+    return "_";
+  switch (e->kind()) {
+    case Expr::int_expr:
+      return std::to_string(static_cast<Int const*>(e)->value);
+    case Expr::var_expr:
+      return static_cast<Var const*>(e)->first->spelling();
+    case Expr::neg_expr:
+      return "-" + show(static_cast<Neg const*>(e)->first);
+    case Expr::add_expr: {
+      Add const* a = static_cast<Add const*>(e);
+      return "(" + show(a->first) + " + " + show(a->second) + ")";
+    }
+    case Expr::if_expr: {
+      If const* i = static_cast<If const*>(e);
+      return "if " + show(i->first) + " " + show(i->second) + " " + show(i->third);
+    }
+    case Expr::list_expr: {
+      std::string s = "[";
+      for (Expr const* x : *static_cast<List const*>(e))
+        s += show(x) + ";";
+      return s + "]";
+    }
+  }
+  return "?";
+}
+
+
+// A loaded tree has the structure and symbols of the saved tree,
+// and shares the nodes that were shared.
+void
+test_round_trip()
+{
+  Path path = boost::filesystem::temp_directory_path() /
+              ("lingo-tree-" + std::to_string(::getpid()));
+
+  std::string text;
+  {
+    Symbol_table syms;
+    Arena_factory f;
+    Arena_scope scope(f);
+    Expr const* x = f.make<Var>(cast<Identifier_sym>(syms.put_identifier(identifier_tok, "x")));
+    Expr const* big = f.make<Int>(-123456789);
+    Expr const* sum = f.make<Add>(x, big);
+    Expr const* neg = f.make<Neg>(sum);
+    Expr const* cond = f.make<If>(x, neg, nullptr);
+    Expr const* list = f.make<List>(std::vector<Expr const*> {cond, sum, f.make<Int>(0), x});
+    text = show(list);
+    save_tree<Expr_nodes>(path, list);
+  }
+
+  Symbol_table syms;
+  Arena_factory f;
+  Arena_scope scope(f);
+  Expr_tree tree(path, syms);
+  lingo_assert(tree);
+  lingo_assert(tree.size() == 7);
+
+  // Nodes are built lazily, in any order.
+  Expr const* sum = tree.node(2);
+  lingo_assert(show(sum) == "(x + -123456789)");
+  Expr const* root = tree.root();
+  lingo_assert(show(root) == text);
+  lingo_assert(root == tree.root());
+
+  List const* list = static_cast<List const*>(root);
+  lingo_assert(list->elems[1] == sum);
+  lingo_assert(static_cast<Add const*>(sum)->first == static_cast<If const*>(list->elems[0])->first);
+  lingo_assert(static_cast<Var const*>(list->elems[3])->first == syms.get("x"));
+
+  boost::filesystem::remove(path);
+  lingo_assert(!Expr_tree(path, syms));
+}
+
+
+// Malformed files are not loaded, and malformed records are
+// diagnosed when they are read.
+void
+test_malformed()
+{
+  Path path = boost::filesystem::temp_directory_path() /
+              ("lingo-tree-" + std::to_string(::getpid()));
+  {
+    Arena_factory f;
+    Expr const* e = f.make<Neg>(f.make<Int>(1));
+    save_tree<Expr_nodes>(path, e);
+  }
+
+  std::string data;
+  {
+    std::ifstream in(path.native(), std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  auto rewrite = [&](std::string const& s) {
+    std::ofstream out(path.native(), std::ios::binary | std::ios::trunc);
+    out << s;
+  };
+
+  Symbol_table syms;
+  Arena_factory f;
+  Arena_scope scope(f);
+
+  // A truncated file.
+  rewrite(data.substr(0, data.size() - 1));
+  lingo_assert(!Expr_tree(path, syms));
+
+  // A record with a bad kind.
+  std::string bad = data;
+  bad[bad.size() - 2] = 42;
+  rewrite(bad);
+  Expr_tree tree(path, syms);
+  lingo_assert(tree);
+  bool thrown = false;
+  try {
+    tree.root();
+  } catch (std::runtime_error&) {
+    thrown = true;
+  }
+  lingo_assert(thrown);
+
+  boost::filesystem::remove(path);
+}
+
+
+int
+main()
+{
+  test_round_trip();
+  test_malformed();
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/assert.hpp"
+#include "lingo/small_map.hpp"
+
+#include <map>
+#include <string>
+
+using namespace lingo;
+
+using Map = Small_map<int, std::string, 4>;
+
+
+// Returns true if m has the same entries as the model.
+bool
+same(Map const& m, std::map<int, std::string> const& model)
+{
+  if (m.size() != model.size())
+    return false;
+  std::size_t n = 0;
+  for (auto const& x : m) {
+    auto iter = model.find(x.first);
+    if (iter == model.end() || iter->second != x.second)
+      return false;
+    ++n;
+  }
+  return n == model.size();
+}
+
+
+// Small maps are searched in place.
+void
+test_small()
+{
+  Map m {{1, "a"}, {2, "b"}};
+  lingo_assert(!m.is_large() && m.size() == 2);
+  lingo_assert(m.find(1)->second == "a");
+  lingo_assert(m.count(2) && !m.count(3));
+
+  auto ins = m.emplace(1, "c");
+  lingo_assert(!ins.second && ins.first->second == "a");
+  ins.first->second = "c";
+  lingo_assert(m.find(1)->second == "c");
+
+  lingo_assert(m.erase(1) == 1 && m.erase(1) == 0);
+  lingo_assert(same(m, {{2, "b"}}));
+}
+
+
+// Large maps move into a hash table, and behave the same.
+void
+test_large()
+{
+  Map m;
+  std::map<int, std::string> model;
+  for (int i = 0; i < 100; ++i) {
+    int k = (i * 37) % 23;
+    if (i % 3 == 0) {
+      lingo_assert(m.erase(k) == model.erase(k));
+    } else {
+      std::string v = std::to_string(i);
+      lingo_assert(m.emplace(k, v).second == model.emplace(k, v).second);
+    }
+    lingo_assert(same(m, model));
+  }
+  lingo_assert(m.is_large());
+
+  Map c = m;
+  lingo_assert(same(c, model));
+  Map d = std::move(c);
+  lingo_assert(same(d, model) && c.empty());
+
+  m.clear();
+  lingo_assert(!m.is_large() && m.empty() && m.begin() == m.end());
+  m = d;
+  lingo_assert(same(m, model));
+
+  Map s {{1, "a"}};
+  m = std::move(s);
+  lingo_assert(same(m, {{1, "a"}}) && !m.is_large());
+}
+
+
+int
+main()
+{
+  test_small();
+  test_large();
+}
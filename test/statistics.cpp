@@ -0,0 +1,170 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/assert.hpp"
+#include "lingo/statistics.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace lingo;
+
+
+// Count n steps in an evaluation. Returns false if the
+// evaluation exceeds its budget.
+bool
+run(std::size_t n)
+{
+  try {
+    Evaluation_guard g;
+    for (std::size_t i = 0; i < n; ++i)
+      count_reduction();
+    return true;
+  } catch (Budget_exceeded&) {
+    return false;
+  }
+}
+
+
+void
+test_counters()
+{
+  reset_evaluation_stats();
+  lingo_assert(run(10));
+  count_substitution();
+  count_allocation();
+  Evaluation_stats const& s = evaluation_stats();
+  lingo_assert(s.evaluations == 1 && s.steps == 10 && s.reductions == 10);
+  lingo_assert(s.substitutions == 1 && s.allocations == 1);
+}
+
+
+// Each evaluation has its own budget.
+void
+test_steps()
+{
+  evaluation_budget().steps = 100;
+  lingo_assert(run(100));
+  lingo_assert(run(100));
+  lingo_assert(!run(101));
+
+  // Steps outside of an evaluation are not limited.
+  for (int i = 0; i < 1000; ++i)
+    count_step();
+  lingo_assert(run(50));
+
+  // Nested evaluations are charged to the outermost.
+  {
+    Evaluation_guard g;
+    lingo_assert(run(60));
+    lingo_assert(!run(60));
+  }
+  evaluation_budget().steps = 0;
+  lingo_assert(run(1000));
+}
+
+
+void
+test_time()
+{
+  evaluation_budget().seconds = 0.01;
+  lingo_assert(!run(std::size_t(-1)));
+  lingo_assert(run(10));
+  evaluation_budget().seconds = 0;
+
+  double t = 0;
+  {
+    Phase_timer p(t);
+    run(100000);
+  }
+  lingo_assert(t > 0);
+}
+
+
+void
+test_options()
+{
+  lingo_assert(set_evaluation_budget("--steps=42"));
+  lingo_assert(evaluation_budget().steps == 42);
+  lingo_assert(set_evaluation_budget("--seconds=1.5"));
+  lingo_assert(evaluation_budget().seconds == 1.5);
+  lingo_assert(!set_evaluation_budget("--steps=x"));
+  lingo_assert(!set_evaluation_budget("--steps="));
+  lingo_assert(!set_evaluation_budget("--machine"));
+  evaluation_budget() = Evaluation_budget();
+}
+
+
+// Count n reductions in each of k threads sharing the current
+// evaluation. Returns the number of threads whose work exceeded
+// the budget.
+int
+run_shared(int k, std::size_t n)
+{
+  Shared_evaluation shared;
+  std::vector<std::thread> ts;
+  std::atomic<int> failed(0);
+  for (int i = 0; i < k; ++i)
+    ts.emplace_back([&]() {
+      Shared_evaluation_guard g(shared);
+      try {
+        for (std::size_t j = 0; j < n; ++j)
+          count_reduction();
+      } catch (Budget_exceeded&) {
+        ++failed;
+      }
+    });
+  for (std::thread& t : ts)
+    t.join();
+  return failed;
+}
+
+
+// The work of threads sharing an evaluation is limited by its
+// budget, and counted by the thread that shares it.
+void
+test_shared()
+{
+  reset_evaluation_stats();
+  evaluation_budget().steps = 10000;
+  {
+    Evaluation_guard g;
+    lingo_assert(run_shared(4, 2000) == 0);
+    lingo_assert(evaluation_stats().steps == 8000);
+    lingo_assert(evaluation_stats().reductions == 8000);
+
+    // The rest of the budget is shared. Steps are charged in
+    // batches, so each thread exceeds a batch.
+    lingo_assert(run_shared(4, 5000) > 0);
+    bool exceeded = false;
+    try {
+      count_step();
+    } catch (Budget_exceeded&) {
+      exceeded = true;
+    }
+    lingo_assert(exceeded);
+  }
+  lingo_assert(evaluation_stats().evaluations == 1);
+
+  // Without a budget, work is counted but not limited.
+  evaluation_budget().steps = 0;
+  {
+    Evaluation_guard g;
+    lingo_assert(run_shared(4, 100000) == 0);
+  }
+  lingo_assert(run_shared(2, 10) == 0);
+  lingo_assert(evaluation_stats().reductions > 8000 + 400000 + 20);
+}
+
+
+int
+main()
+{
+  test_counters();
+  test_steps();
+  test_time();
+  test_options();
+  test_shared();
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "parser.hpp"
+#include "evaluator.hpp"
+#include "bytecode.hpp"
+
+#include "lingo/assert.hpp"
+#include "lingo/memory.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace lingo;
+using namespace calc;
+
+
+char const* prelude =
+  "true : Bool;\n"
+  "false : Bool;\n"
+  "0 : Int;\n"
+  "idb = \\x:Bool.x;\n"
+  "idz = \\x:Int.x;\n"
+  "kb = \\x:Bool.\\y:Bool.x;\n"
+  "app = \\f:Bool->Bool.\\x:Bool.f x;\n"
+  "twice = \\f:Bool->Bool.\\x:Bool.f (f x);\n";
+
+
+String
+show(Expr const* e)
+{
+  if (!e)
+    return "_";
+  std::stringstream ss;
+  ss << *e;
+  return ss.str();
+}
+
+
+// Returns the value of the program s under the evaluator.
+String
+evaluate(String const& s)
+{
+  Expr const* e = parse(s);
+  lingo_assert(e);
+  return show(Evaluator()(e));
+}
+
+
+// Returns the value of the program s under the virtual machine.
+String
+run(String const& s)
+{
+  Expr const* e = parse(s);
+  lingo_assert(e);
+  Vm vm;
+  return show(vm(compile(e)));
+}
+
+
+// Typed programs have the same values under the evaluator and the
+// virtual machine.
+void
+test_programs()
+{
+  char const* items[] = {
+    "idb true;",
+    "kb false true;",
+    "app idb false;",
+    "twice idb true;",
+    "twice (kb true) false;",
+    "app (\\x:Bool.kb x x) true;",
+    "idz 0;",
+    "kb;",
+    "kb true;",
+    "\\f:Bool->Bool.f;",
+    "x : Bool -> Bool;\nx;",
+    "y : Bool;",
+  };
+  for (char const* i : items) {
+    String p = String(prelude) + i;
+    lingo_assert(evaluate(p) == run(p));
+  }
+
+  // A reference to a definition is replaced by its value.
+  lingo_assert(run(String(prelude) + "t = idb true;\nt;") == "true");
+
+  // Both fail to apply a declared function.
+  String p = String(prelude) + "f : Bool -> Bool;\nf true;";
+  int errs = 0;
+  try { evaluate(p); } catch (std::runtime_error&) { ++errs; }
+  try { run(p); } catch (std::runtime_error&) { ++errs; }
+  lingo_assert(errs == 2);
+}
+
+
+int
+main()
+{
+  Arena_factory nodes;
+  Arena_scope scope(nodes);
+  test_programs();
+}
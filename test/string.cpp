@@ -5,8 +5,131 @@
 
 #include "lingo/string.hpp"
 
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+
+// Interned strings with the same characters are the same
+// string, whatever buffer they were interned from.
+void
+test_interned()
+{
+  using lingo::Interned_string;
+
+  char const* text = "abc abc abd";
+  Interned_string a(lingo::String_view(text, text + 3));
+  Interned_string b(lingo::String_view(text + 4, text + 7));
+  Interned_string c(lingo::String_view(text + 8, text + 11));
+  lingo_assert(a == b);
+  lingo_assert(a != c);
+  lingo_assert(a.hash() == lingo::String_view("abc").hash());
+  lingo_assert(a.str() == "abc" && a.size() == 3);
+  lingo_assert(a.c_str() != text && a.c_str()[3] == 0);
+  lingo_assert(Interned_string().empty());
+  lingo_assert(Interned_string("") == Interned_string());
+
+  std::unordered_set<Interned_string> set {a, b, c};
+  lingo_assert(set.size() == 2);
+
+  // Strings interned by different threads agree.
+  std::vector<Interned_string> xs(1000), ys(1000);
+  std::thread t([&]() {
+    for (int i = 0; i < 1000; ++i)
+      xs[i] = Interned_string(lingo::String(std::to_string(i)));
+  });
+  for (int i = 0; i < 1000; ++i)
+    ys[i] = Interned_string(lingo::String(std::to_string(i)));
+  t.join();
+  for (int i = 0; i < 1000; ++i) {
+    lingo_assert(xs[i] == ys[i]);
+    lingo_assert(xs[i].str() == std::to_string(i));
+  }
+}
+
+
+// The character table agrees with the classic locale.
+void
+test_char_table()
+{
+  std::locale const& loc = std::locale::classic();
+  for (int i = 0; i < 256; ++i) {
+    char c = i;
+    lingo_assert(lingo::is_space(c) == std::isspace(c, loc));
+    lingo_assert(lingo::is_alpha(c) == std::isalpha(c, loc));
+    lingo_assert(lingo::is_decimal_digit(c) == std::isdigit(c, loc));
+    lingo_assert(lingo::is_hexadecimal_digit(c) == std::isxdigit(c, loc));
+    lingo_assert(lingo::is_identifier_char(c) == (std::isalnum(c, loc) || c == '_'));
+    for (int b = 1; b <= 36; ++b)
+      lingo_assert(lingo::digit_value(c, b) == lingo::digit_value<wchar_t>(c, b));
+  }
+  static_assert(lingo::char_value('z') == 35, "");
+  static_assert(lingo::has_char_class('\t', lingo::space_class), "");
+}
+
+
+// The fast conversion of character ranges agrees with the
+// general algorithm.
+void
+test_fast_int()
+{
+  std::minstd_rand gen;
+  char const* digits = "0123456789abcdefABCDEF";
+  for (int i = 0; i < 20000; ++i) {
+    std::string str;
+    if (gen() % 4 == 0)
+      str += "+-"[gen() % 2];
+    int b = gen() % 2 ? 10 : 16;
+    int len = gen() % 20;
+    for (int k = 0; k < len; ++k)
+      str += digits[gen() % (b == 10 ? 10 : 22)];
+    if (gen() % 16 == 0 && !str.empty())
+      str[gen() % str.size()] = 'x';
+
+    char const* p = str.c_str();
+    for (int t = 0; t < 3; ++t) {
+      std::string fast, slow;
+      try {
+        if (t == 0)
+          fast = std::to_string(lingo::string_to_int<int>(p, p + str.size(), b));
+        else if (t == 1)
+          fast = std::to_string(lingo::string_to_int<std::int64_t>(p, p + str.size(), b));
+        else
+          fast = std::to_string(lingo::string_to_int<std::uint64_t>(p, p + str.size(), b));
+      }
+      catch (std::invalid_argument&) { fast = "invalid"; }
+      catch (std::out_of_range&) { fast = "range"; }
+      try {
+        if (t == 0)
+          slow = std::to_string(lingo::string_to_int<int>(str.begin(), str.end(), b));
+        else if (t == 1)
+          slow = std::to_string(lingo::string_to_int<std::int64_t>(str.begin(), str.end(), b));
+        else
+          slow = std::to_string(lingo::string_to_int<std::uint64_t>(str.begin(), str.end(), b));
+      }
+      catch (std::invalid_argument&) { slow = "invalid"; }
+      catch (std::out_of_range&) { slow = "range"; }
+
+      // The general algorithm does not detect overflow of its
+      // 64-bit accumulator, nor negative unsigned 64-bit values,
+      // so only compare when neither can happen.
+      if (len < 16 && !(t == 2 && str[0] == '-'))
+        lingo_assert(fast == slow);
+    }
+  }
+  lingo_assert(lingo::string_to_int<std::int64_t>("-9223372036854775808", 10) == INT64_MIN);
+  lingo_assert(lingo::string_to_int<std::uint64_t>("18446744073709551615", 10) == UINT64_MAX);
+  lingo_assert(lingo::string_to_int<std::uint64_t>("123456789abcdef0", 16) == 0x123456789abcdef0ull);
+}
+
+
 int main()
 {
+  test_interned();
+  test_char_table();
+  test_fast_int();
+
   lingo_assert(!lingo::is_digit('2', 2));
   lingo_assert(!lingo::is_digit('f', 10));
   lingo_assert(lingo::is_digit('9', 10));
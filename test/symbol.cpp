@@ -0,0 +1,150 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/symbol.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace lingo;
+
+enum
+{
+  lparen_tok,
+  identifier_tok,
+  integer_tok
+};
+
+
+void
+test_lookup()
+{
+  Symbol_table syms;
+  syms.put_symbol(lparen_tok, "(");
+
+  // Symbols are found by the characters in a buffer.
+  char const* text = "(abc abc 42";
+  Symbol const* p = syms.get(text, text + 1);
+  lingo_assert(p && p->token() == lparen_tok);
+  lingo_assert(!syms.get(text + 1, text + 4));
+
+  // The first insertion copies the spelling. Later insertions
+  // find the same symbol.
+  Symbol* a = syms.put_identifier(identifier_tok, String_view(text + 1, text + 4));
+  Symbol* b = syms.put_identifier(identifier_tok, String_view(text + 5, text + 8));
+  lingo_assert(a == b);
+  lingo_assert(a->spelling() == "abc");
+  lingo_assert(a->spelling().data() != text + 1);
+  lingo_assert(syms.get("abc") == a);
+  lingo_assert(syms.get(String("abc")) == a);
+
+  Symbol* n = syms.put_integer(integer_tok, String_view(text + 9, text + 11), 42);
+  lingo_assert(static_cast<Integer_sym*>(n)->value() == 42);
+  lingo_assert(syms.size() == 3);
+}
+
+
+// Symbols have dense ids that index attribute tables.
+void
+test_attribute()
+{
+  Symbol_table syms;
+  Symbol* a = syms.put_identifier(identifier_tok, "a");
+  Symbol* b = syms.put_identifier(identifier_tok, "b");
+  lingo_assert(b->id() == a->id() + 1);
+  lingo_assert(syms.put_identifier(identifier_tok, "a")->id() == a->id());
+
+  Symbol_attribute<int> depth(-1);
+  lingo_assert(depth[a] == -1 && !depth.has(a));
+  depth.put(b, 2);
+  lingo_assert(depth[b] == 2 && depth.has(b));
+  lingo_assert(depth[a] == -1);
+  depth.reset(b);
+  lingo_assert(!depth.has(b));
+
+  Symbol* c = syms.put_identifier(identifier_tok, "c");
+  lingo_assert(depth.get(c) == -1);
+  ++depth[c];
+  lingo_assert(depth[c] == 0);
+}
+
+
+// The class of a symbol determines its dynamic type without
+// dynamic_cast.
+void
+test_classof()
+{
+  Symbol_table syms;
+  Symbol const* p = syms.put_symbol(lparen_tok, "(");
+  Symbol const* a = syms.put_identifier(identifier_tok, "a");
+  Symbol const* n = syms.put_integer(integer_tok, "1", 1);
+  static_assert(has_classof<Integer_sym, Symbol>::value, "");
+  static_assert(!has_classof<Symbol, Symbol>::value, "");
+
+  lingo_assert(p->cls() == Symbol::plain_sym);
+  lingo_assert(is<Identifier_sym>(a) && !is<Identifier_sym>(p));
+  lingo_assert(!is<Integer_sym>(a) && is<Integer_sym>(*n));
+  lingo_assert(as<Integer_sym>(n)->value() == 1);
+  lingo_assert(!as<Integer_sym>(a));
+  lingo_assert(!is<Identifier_sym>((Symbol const*)nullptr));
+  lingo_assert(is<Symbol>(n));
+
+  bool thrown = false;
+  try {
+    as<Integer_sym>(*a);
+  } catch (std::bad_cast&) {
+    thrown = true;
+  }
+  lingo_assert(thrown);
+}
+
+
+// Many threads interning the same spellings agree on one
+// symbol per spelling.
+void
+test_concurrent()
+{
+  constexpr int num_threads = 4;
+  constexpr int num_names = 1000;
+
+  std::vector<std::string> names;
+  for (int i = 0; i < num_names; ++i)
+    names.push_back("x" + std::to_string(i));
+
+  Concurrent_symbol_table syms;
+  std::vector<std::vector<Symbol*>> seen(num_threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < num_names; ++i) {
+        int n = (i * (t + 1)) % num_names;
+        seen[t].push_back(syms.put_identifier(identifier_tok, names[n]));
+      }
+    });
+  }
+  for (std::thread& t : threads)
+    t.join();
+
+  lingo_assert(syms.size() == num_names);
+  for (int t = 0; t < num_threads; ++t) {
+    for (int i = 0; i < num_names; ++i) {
+      int n = (i * (t + 1)) % num_names;
+      Symbol const* sym = seen[t][i];
+      lingo_assert(syms.get(names[n]) == sym);
+      lingo_assert(sym->spelling() == names[n]);
+    }
+  }
+}
+
+
+int
+main()
+{
+  test_lookup();
+  test_attribute();
+  test_classof();
+  test_concurrent();
+}
@@ -0,0 +1,178 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/token.hpp"
+
+using namespace lingo;
+
+enum
+{
+  identifier_tok,
+  integer_tok,
+  lparen_tok,
+  rparen_tok
+};
+
+
+// Tokens put into the stream are read in order, and
+// saved positions remain valid as tokens are added.
+void
+test_stream()
+{
+  Symbol_table syms;
+  Symbol const* a = syms.put_identifier(identifier_tok, "a");
+  Symbol const* n = syms.put_integer(integer_tok, "1", 1);
+
+  Token_stream ts;
+  lingo_assert(ts.eof());
+  lingo_assert(!ts.peek() && !ts.get());
+
+  // A token put at the end of the stream becomes the
+  // current token.
+  ts.put(Token({}, a));
+  lingo_assert(!ts.eof());
+  lingo_assert(ts.peek().symbol() == a);
+
+  Token_stream::Position p = ts.position();
+  for (int i = 0; i < 1000; ++i)
+    ts.put(Token({}, i % 2 ? a : n));
+  lingo_assert(ts.peek(1).symbol() == n);
+  lingo_assert(ts.peek(1000).symbol() == a);
+  lingo_assert(!ts.peek(1001));
+
+  int k = 0;
+  while (ts.get())
+    ++k;
+  lingo_assert(k == 1001);
+  lingo_assert(ts.eof());
+
+  // Backtrack to the saved position.
+  ts.reposition(p);
+  lingo_assert(ts.get().symbol() == a);
+  lingo_assert(ts.get().symbol() == n);
+  lingo_assert(ts.position() == p + 2);
+
+  // A cleared stream is empty, and can be reused.
+  ts.clear();
+  lingo_assert(ts.eof() && ts.position() == 0);
+  ts.put(Token({}, n));
+  lingo_assert(ts.get().symbol() == n && ts.eof());
+}
+
+
+// Lookahead at any distance, including past the end of
+// input, does not move the stream.
+void
+test_lookahead()
+{
+  Symbol_table syms;
+  Symbol const* a = syms.put_identifier(identifier_tok, "a");
+  Symbol const* n = syms.put_integer(integer_tok, "1", 1);
+
+  Token_seq toks;
+  for (int i = 0; i < 8; ++i)
+    toks.push_back(Token({}, i % 4 == 3 ? n : a));
+  Token_stream ts(std::move(toks));
+
+  while (!ts.eof()) {
+    Token_stream::Position p = ts.position();
+    for (int k = 0; k < 12; ++k) {
+      int kind = invalid_tok;
+      if (p + k < 8)
+        kind = (p + k) % 4 == 3 ? integer_tok : identifier_tok;
+      lingo_assert(ts.peek(k).kind() == kind);
+    }
+    lingo_assert(ts.position() == p);
+    ts.get();
+  }
+}
+
+
+// A stream with a token source reads tokens on demand, and
+// retains consumed tokens only within its window or while they
+// are held by a marker.
+void
+test_source()
+{
+  Symbol_table syms;
+  Symbol const* a = syms.put_identifier(identifier_tok, "a");
+  Symbol const* n = syms.put_integer(integer_tok, "1", 1);
+
+  int count = 0;
+  auto src = [&]() -> Token {
+    if (count == 10000)
+      return Token();
+    return Token({}, count++ % 2 ? n : a);
+  };
+  Token_stream ts(src, 16);
+  lingo_assert(count == 0);
+  lingo_assert(ts.peek(3).symbol() == n);
+  lingo_assert(count == 4);
+
+  // Scan half of the input, keeping the buffer bounded.
+  for (int i = 0; i < 5000; ++i) {
+    lingo_assert(ts.get().kind() == (i % 2 ? integer_tok : identifier_tok));
+    lingo_assert(ts.tokens().size() <= 16 + 4);
+  }
+
+  // A marker retains the tokens from its position.
+  {
+    Token_stream::Marker m(ts);
+    for (int i = 0; i < 100; ++i)
+      ts.get();
+    lingo_assert(ts.tokens().size() >= 100);
+    m.restore();
+    lingo_assert(ts.position() == 5000);
+    lingo_assert(ts.get().symbol() == a);
+  }
+
+  int k = 5001;
+  while (ts.get())
+    ++k;
+  lingo_assert(k == 10000 && count == 10000);
+  lingo_assert(ts.eof() && !ts.peek(5));
+}
+
+
+// The token store yields the tokens put into it, and scans
+// token kinds without reading symbols.
+void
+test_store()
+{
+  Symbol_table syms;
+  Symbol const* a = syms.put_identifier(identifier_tok, "a");
+  Symbol const* l = syms.put_symbol(lparen_tok, "(");
+  Symbol const* r = syms.put_symbol(rparen_tok, ")");
+
+  // a ( a ( ) a ) ) <invalid>
+  Symbol const* text[] = {a, l, a, l, r, a, r, r, nullptr};
+  Token_store ts;
+  for (int i = 0; i < 9; ++i)
+    ts.push_back(Token(Location::at(i + 1), text[i]));
+  lingo_assert(ts.size() == 9);
+  for (int i = 0; i < 9; ++i) {
+    lingo_assert(ts[i].symbol() == text[i]);
+    lingo_assert(ts[i].location() == Location::at(i + 1));
+    lingo_assert(ts.kind(i) == ts[i].kind());
+  }
+  lingo_assert(ts.kind(8) == invalid_tok);
+
+  lingo_assert(ts.find(0, lparen_tok) == 1);
+  lingo_assert(ts.find(2, lparen_tok) == 3);
+  lingo_assert(ts.find(4, lparen_tok) == 9);
+  lingo_assert(ts.find(0, invalid_tok) == 8);
+  lingo_assert(ts.match(1, lparen_tok, rparen_tok) == 6);
+  lingo_assert(ts.match(3, lparen_tok, rparen_tok) == 4);
+}
+
+
+int
+main()
+{
+  test_stream();
+  test_lookahead();
+  test_source();
+  test_store();
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/token_cache.hpp"
+
+#include <string>
+
+#include <unistd.h>
+
+using namespace lingo;
+
+enum
+{
+  lparen_tok,
+  identifier_tok,
+  integer_tok,
+  string_tok
+};
+
+
+// Tokens loaded from a cache have the kinds, attributes, and
+// locations of the saved tokens, and their symbols are interned
+// in the symbol table.
+void
+test_cache()
+{
+  Path path = boost::filesystem::temp_directory_path() /
+              ("lingo-tokens-" + std::to_string(::getpid()));
+
+  Buffer buf("(abc 42 \"hi\" abc");
+  Token_seq toks;
+  {
+    Symbol_table syms;
+    toks.emplace_back(buf.location(0), syms.put_symbol(lparen_tok, "("));
+    toks.emplace_back(buf.location(1), syms.put_identifier(identifier_tok, "abc"));
+    toks.emplace_back(buf.location(5), syms.put_integer(integer_tok, "42", 42));
+    toks.emplace_back(buf.location(8), syms.put_string(string_tok, "\"hi\"", "hi"));
+    toks.emplace_back(buf.location(13), syms.get("abc"));
+    toks.emplace_back();
+    save_tokens(path, buf, toks);
+
+    Token_seq out;
+    lingo_assert(load_tokens(path, buf, syms, out));
+    lingo_assert(out.size() == toks.size());
+    for (std::size_t i = 0; i < toks.size(); ++i) {
+      lingo_assert(out[i].symbol() == toks[i].symbol());
+      lingo_assert(out[i].location() == toks[i].location());
+    }
+  }
+
+  // Load into a different symbol table.
+  Symbol_table syms;
+  Token_seq out;
+  lingo_assert(load_tokens(path, buf, syms, out));
+  lingo_assert(out.size() == toks.size());
+  lingo_assert(out[1].symbol() == out[4].symbol());
+  lingo_assert(out[1].identifier_symbol() && out[1].spelling() == "abc");
+  lingo_assert(out[2].integer_symbol()->value() == 42);
+  lingo_assert(out[3].string_symbol()->value() == "hi");
+  lingo_assert(out[3].location() == buf.location(8));
+  lingo_assert(!out[5] && !out[5].location());
+
+  // A cache is not loaded for different text.
+  Buffer other("(abc 43 \"hi\" abc");
+  lingo_assert(!load_tokens(path, other, syms, out));
+  lingo_assert(out.size() == toks.size());
+
+  boost::filesystem::remove(path);
+  lingo_assert(!load_tokens(path, buf, syms, out));
+}
+
+
+int
+main()
+{
+  test_cache();
+}
@@ -0,0 +1,222 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "lingo/traversal.hpp"
+
+#include <atomic>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+using namespace lingo;
+
+
+struct Name
+{
+  char const* str;
+};
+
+
+struct Expr
+{
+  enum Kind
+  {
+    int_expr,
+    neg_expr,
+    add_expr,
+    let_expr,
+    list_expr
+  };
+
+  Expr(Kind k)
+    : kind_(k)
+  { }
+
+  Kind kind() const { return kind_; }
+
+  Kind kind_;
+};
+
+
+struct Int : Expr
+{
+  static constexpr Kind node_kind = int_expr;
+
+  Int(int n)
+    : Expr(node_kind), value(n)
+  { }
+
+  int value;
+};
+
+
+struct Neg : Expr
+{
+  static constexpr Kind node_kind = neg_expr;
+
+  Neg(Expr const* e)
+    : Expr(node_kind), first(e)
+  { }
+
+  Expr const* first;
+};
+
+
+struct Add : Expr
+{
+  static constexpr Kind node_kind = add_expr;
+
+  Add(Expr const* e1, Expr const* e2)
+    : Expr(node_kind), first(e1), second(e2)
+  { }
+
+  Expr const* first;
+  Expr const* second;
+};
+
+
+// The name of a let is not a child.
+struct Let : Expr
+{
+  static constexpr Kind node_kind = let_expr;
+
+  Let(Name const* n, Expr const* e1, Expr const* e2)
+    : Expr(node_kind), first(n), second(e1), third(e2)
+  { }
+
+  Name const* first;
+  Expr const* second;
+  Expr const* third;
+};
+
+
+struct List : Expr
+{
+  static constexpr Kind node_kind = list_expr;
+
+  List()
+    : Expr(node_kind)
+  { }
+
+  std::vector<Expr const*>::const_iterator begin() const { return elems.begin(); }
+  std::vector<Expr const*>::const_iterator end() const   { return elems.end(); }
+
+  std::vector<Expr const*> elems;
+};
+
+
+using Expr_nodes = Node_list<Int, Neg, Add, Let, List>;
+
+
+// The value of an integer, or 0.
+int
+value(Expr const* e)
+{
+  if (e->kind() == Expr::int_expr)
+    return static_cast<Int const*>(e)->value;
+  return 0;
+}
+
+
+// Children are visited in order, after their parents.
+void
+test_preorder()
+{
+  Name x {"x"};
+  Int one(1), two(2), three(3), four(4);
+  Neg neg(&two);
+  Add add(&one, &neg);
+  List list;
+  list.elems = {&three, nullptr, &four};
+  Let let(&x, &add, &list);
+
+  std::vector<Expr const*> order;
+  for_each_node<Expr_nodes>((Expr const*)&let, [&](Expr const* e) { order.push_back(e); });
+  std::vector<Expr const*> expect {&let, &add, &one, &neg, &two, &list, &three, &four};
+  lingo_assert(order == expect);
+
+  auto is_even = [](Expr const* e) { return value(e) && value(e) % 2 == 0; };
+  lingo_assert(find_if_node<Expr_nodes>((Expr const*)&let, is_even) == &two);
+  lingo_assert(!find_if_node<Expr_nodes>((Expr const*)&let, [](Expr const* e) { return value(e) > 4; }));
+
+  auto plus = [](int a, int b) { return a + b; };
+  lingo_assert(transform_reduce_nodes<Expr_nodes>((Expr const*)&let, 0, plus, value) == 10);
+}
+
+
+// A tree that is a long chain of negations, with a wide list at its
+// bottom. Each list element is an addition of two integers.
+Expr const*
+make_tree(std::deque<Int>& ints, std::deque<Add>& adds, List& list, std::deque<Neg>& negs)
+{
+  for (int i = 0; i < 10000; ++i) {
+    ints.emplace_back(i);
+    ints.emplace_back(1);
+    adds.emplace_back(&ints[ints.size() - 2], &ints.back());
+    list.elems.push_back(&adds.back());
+  }
+  Expr const* e = &list;
+  for (int i = 0; i < 1000000; ++i) {
+    negs.emplace_back(e);
+    e = &negs.back();
+  }
+  return e;
+}
+
+
+// Deep trees do not exhaust the call stack, and parallel traversals
+// agree with sequential ones.
+void
+test_parallel()
+{
+  std::deque<Int> ints;
+  std::deque<Add> adds;
+  std::deque<Neg> negs;
+  List list;
+  Expr const* root = make_tree(ints, adds, list, negs);
+  std::size_t size = ints.size() + adds.size() + negs.size() + 1;
+
+  std::size_t count = 0;
+  for_each_node<Expr_nodes>(root, [&](Expr const*) { ++count; });
+  lingo_assert(count == size);
+
+  auto plus = [](long a, long b) { return a + b; };
+  auto val = [](Expr const* e) { return long(value(e)); };
+  long sum = transform_reduce_nodes<Expr_nodes>(root, 0L, plus, val);
+  lingo_assert(sum == 10000L * 9999 / 2 + 10000);
+
+  for (std::size_t n : {1, 2, 4, 0}) {
+    std::atomic<std::size_t> c(0);
+    for_each_node_in_parallel<Expr_nodes>(root, [&](Expr const*) { ++c; }, n);
+    lingo_assert(c == size);
+
+    lingo_assert(transform_reduce_nodes_in_parallel<Expr_nodes>(root, 0L, plus, val, n) == sum);
+
+    auto pred = [](Expr const* e) { return value(e) == 1234; };
+    Expr const* e = find_if_node_in_parallel<Expr_nodes>(root, pred, n);
+    lingo_assert(e && value(e) == 1234);
+    lingo_assert(!find_if_node_in_parallel<Expr_nodes>(root, [](Expr const* e) { return value(e) < 0; }, n));
+  }
+
+  // Exceptions are propagated to the caller.
+  bool thrown = false;
+  try {
+    for_each_node_in_parallel<Expr_nodes>(root, [&](Expr const* e) {
+      if (value(e) == 5000)
+        throw std::runtime_error("found");
+    }, 4);
+  } catch (std::runtime_error&) {
+    thrown = true;
+  }
+  lingo_assert(thrown);
+}
+
+
+int
+main()
+{
+  test_preorder();
+  test_parallel();
+}
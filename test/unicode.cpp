@@ -4,6 +4,7 @@
 #include "config.hpp"
 
 #include <iostream>
+#include <string>
 #include <utility>
 
 #include "lingo/assert.hpp"
@@ -152,5 +153,50 @@ int main()
     lingo_unreachable("lingo::to_unescaped() unexpectedly failed.");
   }
 
+  // Bulk unescaping agrees with unescaping one sequence at a time, for
+  // escape sequences between runs of unescaped text.
+  for (int n = 0; n < 40; n += 13) {
+    const std::string run(n, 'z');
+    std::string text;
+    std::u32string expected;
+    for (const auto& valid_escape_sequence : valid_escape_sequences) {
+      text += run;
+      text += valid_escape_sequence.first;
+      expected += std::u32string(run.begin(), run.end());
+      expected += valid_escape_sequence.second;
+    }
+    std::u32string value = U"=";
+    lingo::unescape(text.data(), text.data() + text.size(), value);
+    lingo_assert(value == U"=" + expected);
+  }
+
+  for (const char* invalid_escape_sequence : invalid_escape_sequences) {
+    try {
+      const std::string text = std::string("abc") + invalid_escape_sequence;
+      std::u32string value;
+      lingo::unescape(text.data(), text.data() + text.size(), value);
+      lingo_unreachable("lingo::unescape() unexpectedly succeeded.");
+    }
+    catch (const std::invalid_argument&) {}
+  }
+
+  // Escape sequences end at the end of the range.
+  {
+    const char* text = "\\x4142";
+    std::string value;
+    lingo::unescape(text, text + 4, value);
+    lingo_assert(value == "A");
+  }
+
+  try {
+    const char16_t* text = u"ab\u03c0";
+    std::string value;
+    lingo::unescape(text, text + 2, value);
+    lingo_assert(value == "ab");
+    lingo::unescape(text, text + 3, value);
+    lingo_unreachable("lingo::unescape() unexpectedly succeeded.");
+  }
+  catch (const std::out_of_range&) {}
+
   return 0;
 }